@@ -124,8 +124,10 @@ std::vector<BufferInfo> ExtractTempBufferInfos(
 }
 
 // Add (from,to) rewrite pairs based on the given shape.  These rewrite pairs
-// are used to generate methods for args and results.
-Status AddRewritesForShape(int i, const xla::Shape& shape,
+// are used to generate methods for args and results.  If dynamic_batch is true,
+// the first dimension of the shape is the maximum batch size, and the element
+// count is computed from the batch size at runtime.
+Status AddRewritesForShape(int i, const xla::Shape& shape, bool dynamic_batch,
                            std::vector<std::pair<string, string>>* rewrites) {
   string type;
   TF_RETURN_IF_ERROR(XLATypeToCpp(shape.element_type(), &type));
@@ -144,12 +146,16 @@ Status AddRewritesForShape(int i, const xla::Shape& shape,
       count *= shape.dimensions(dim);
     }
   }
+  string count_code = absl::StrCat(count);
+  if (dynamic_batch && shape.dimensions(0) > 0) {
+    count_code = absl::StrCat("batch_size() * ", count / shape.dimensions(0));
+  }
   rewrites->push_back({"{{I}}", absl::StrCat(i)});
   rewrites->push_back({"{{TYPE}}", type});
   rewrites->push_back({"{{DIM_VARS}}", absl::StrJoin(dim_vars, ", ")});
   rewrites->push_back({"{{DIM_SIZES}}", dim_sizes});
   rewrites->push_back({"{{INDICES}}", indices});
-  rewrites->push_back({"{{COUNT}}", absl::StrCat(count)});
+  rewrites->push_back({"{{COUNT}}", count_code});
   return Status::OK();
 }
 
@@ -174,16 +180,20 @@ Status GenArgMethods(const tf2xla::Config& config,
                      const CompileResult& compile_result, string* methods) {
   size_t num_args = ps.parameters_size();
   // feed_size() + variable_size() is the maximum number of args as an
-  // implementation may not create an argument for an unused variable.
-  if (config.feed_size() + config.variable_size() < num_args) {
+  // implementation may not create an argument for an unused variable.  The
+  // batch size is an extra argument if any feed has a dynamic batch.
+  const int num_batch_size_args = HasDynamicBatch(config) ? 1 : 0;
+  if (config.feed_size() + num_batch_size_args + config.variable_size() <
+      num_args) {
     return errors::InvalidArgument(
         "mismatch between feed_size(", config.feed_size(), ")+variable_size(",
         config.variable_size(), ") and num_args(", num_args, ")");
   }
   for (int i = 0; i < config.feed_size(); ++i) {
     std::vector<std::pair<string, string>> rewrites;
-    TF_RETURN_IF_ERROR(
-        AddRewritesForShape(i, xla::Shape(ps.parameters(i)), &rewrites));
+    TF_RETURN_IF_ERROR(AddRewritesForShape(i, xla::Shape(ps.parameters(i)),
+                                           config.feed(i).dynamic_batch(),
+                                           &rewrites));
     const string code = R"(
   void set_arg{{NAME}}_data(const void* data) {
     set_arg_data({{I}}, data);
@@ -238,8 +248,12 @@ Status GenResultMethods(const tf2xla::Config& config,
   }
   for (int i = 0; i < config.fetch_size(); ++i) {
     std::vector<std::pair<string, string>> rewrites;
-    TF_RETURN_IF_ERROR(AddRewritesForShape(
-        i, xla::Shape(ps.result().tuple_shapes(i)), &rewrites));
+    // XLA infers which results have a dynamic batch from the feeds.
+    const xla::Shape shape(ps.result().tuple_shapes(i));
+    const bool dynamic_batch =
+        shape.rank() > 0 && shape.is_dynamic_dimension(0);
+    TF_RETURN_IF_ERROR(
+        AddRewritesForShape(i, shape, dynamic_batch, &rewrites));
     string code = R"(
   {{TYPE}}* result{{NAME}}_data() {
     return static_cast<{{TYPE}}*>(result_data({{I}}));
@@ -274,10 +288,13 @@ Status GenResultMethods(const tf2xla::Config& config,
 Status GenVariableMethods(const tf2xla::Config& config,
                           const xla::ProgramShapeProto& ps, string* methods) {
   size_t num_args = ps.parameters_size();
-  for (int i = config.feed_size(); i < num_args; ++i) {
+  const int first_variable =
+      config.feed_size() + (HasDynamicBatch(config) ? 1 : 0);
+  for (int i = first_variable; i < num_args; ++i) {
     std::vector<std::pair<string, string>> rewrites;
-    TF_RETURN_IF_ERROR(
-        AddRewritesForShape(i, xla::Shape(ps.parameters(i)), &rewrites));
+    TF_RETURN_IF_ERROR(AddRewritesForShape(i, xla::Shape(ps.parameters(i)),
+                                           /*dynamic_batch=*/false,
+                                           &rewrites));
     const string code = R"(
   void set_var_{{NAME}}_data({{MAYBE_CONST}}{{TYPE}}* data) {
     set_arg_data({{I}}, data);
@@ -303,7 +320,7 @@ Status GenVariableMethods(const tf2xla::Config& config,
     return {{COUNT}};
   }
 )";
-    const tf2xla::Variable& var = config.variable(i - config.feed_size());
+    const tf2xla::Variable& var = config.variable(i - first_variable);
     rewrites.emplace_back("{{MAYBE_CONST}}", var.readonly() ? "const " : "");
     *methods += RewriteWithName(
         var.name().empty() ? var.node_name() : var.name(), code, rewrites);
@@ -311,6 +328,61 @@ Status GenVariableMethods(const tf2xla::Config& config,
   return Status::OK();
 }
 
+// Generate methods, members and the constructor body for the batch size, if
+// any feed has a dynamic batch.  The batch size arg always points at a member
+// of the generated class, so that it is set in every AllocMode.
+void GenBatchSizeCode(const tf2xla::Config& config, string* methods,
+                      string* members, string* constructor_body) {
+  *constructor_body = "{}";
+  if (!HasDynamicBatch(config)) {
+    return;
+  }
+  int64 max_batch_size = 0;
+  std::vector<string> feed_names;
+  for (int i = 0; i < config.feed_size(); ++i) {
+    const tf2xla::Feed& feed = config.feed(i);
+    if (feed.dynamic_batch()) {
+      max_batch_size = feed.shape().dim(0).size();
+      feed_names.push_back(
+          absl::StrCat("arg", feed.name().empty() ? absl::StrCat(i)
+                                                  : "_" + feed.name()));
+    }
+  }
+  *methods = absl::StrReplaceAll(R"(
+  // Batch size methods.  The args {{FEED_NAMES}} have a dynamic
+  // batch: their buffers are allocated for kMaxBatchSize rows, but Run only
+  // reads the first batch_size() rows.  Likewise, results computed from them
+  // only have their first batch_size() rows written.  The _size and _count
+  // methods of these args and results account for the current batch size.
+  static constexpr ::tensorflow::int32 kMaxBatchSize = {{MAX_BATCH_SIZE}};
+
+  // Sets the batch size for subsequent calls to Run, and returns true if it
+  // is in the range [0, kMaxBatchSize].  Otherwise the batch size is left
+  // unchanged, so that Run never reads or writes past the buffers.  Defaults
+  // to kMaxBatchSize.
+  bool set_batch_size(::tensorflow::int32 batch_size) {
+    if (batch_size < 0 || batch_size > kMaxBatchSize) return false;
+    batch_size_ = batch_size;
+    return true;
+  }
+  ::tensorflow::int32 batch_size() const {
+    return batch_size_;
+  }
+)",
+      {{"{{FEED_NAMES}}", absl::StrJoin(feed_names, ", ")},
+       {"{{MAX_BATCH_SIZE}}", absl::StrCat(max_batch_size)}});
+  *members = absl::StrReplaceAll(R"(
+  // The positional argument holding the batch size, which points at
+  // batch_size_.
+  static constexpr size_t kBatchSizeArgIndex = {{BATCH_SIZE_ARG_INDEX}};
+  ::tensorflow::int32 batch_size_ = kMaxBatchSize;
+)",
+      {{"{{BATCH_SIZE_ARG_INDEX}}", absl::StrCat(config.feed_size())}});
+  *constructor_body = R"({
+    set_arg_data(kBatchSizeArgIndex, &batch_size_);
+  })";
+}
+
 // Generates code implementing {Arg,Result}Names(), where T is one of
 // tf2xla::{Feed,Fetch,Variable}. Each feed or fetch name results in a C-style
 // string literal in the array, with nullptr terminating the array.
@@ -417,6 +489,9 @@ Status GenerateHeader(const CodegenOpts& opts, const tf2xla::Config& config,
   TF_RETURN_IF_ERROR(GenArgMethods(config, ps, compile_result, &methods_arg));
   TF_RETURN_IF_ERROR(GenResultMethods(config, ps, &methods_result));
   TF_RETURN_IF_ERROR(GenVariableMethods(config, ps, &methods_variable));
+  string methods_batch_size, members_batch_size, constructor_body;
+  GenBatchSizeCode(config, &methods_batch_size, &members_batch_size,
+                   &constructor_body);
   const size_t arg_bytes_aligned =
       xla::cpu_function_runtime::AlignedBufferBytes(
           buffer_infos_for_args.data(), buffer_infos_for_args.size(),
@@ -575,7 +650,7 @@ class {{CLASS}} final : public tensorflow::XlaCompiledCpuFunction {
 
   {{CLASS}}(AllocMode alloc_mode =
             AllocMode::ARGS_VARIABLES_RESULTS_PROFILES_AND_TEMPS)
-      : XlaCompiledCpuFunction(StaticData(), alloc_mode) {}
+      : XlaCompiledCpuFunction(StaticData(), alloc_mode) {{CONSTRUCTOR_BODY}}
 
   {{CLASS}}(const {{CLASS}}&) = delete;
   {{CLASS}}& operator=(const {{CLASS}}&) = delete;
@@ -639,10 +714,12 @@ class {{CLASS}} final : public tensorflow::XlaCompiledCpuFunction {
   // buffer is not const (and thus the const can be safely const-cast'ed away)
   // unless `set_var_X_data` is called with a pointer to constant storage.
 {{METHODS_VARIABLE}}
+{{METHODS_BATCH_SIZE}}
 
  private:
   // Number of buffers for the compiled computation.
   static constexpr size_t kNumBuffers = {{NUM_BUFFERS}};
+{{MEMBERS_BATCH_SIZE}}
 
   static const ::xla::cpu_function_runtime::BufferInfo* BufferInfos() {
     static const ::xla::cpu_function_runtime::BufferInfo
@@ -700,6 +777,7 @@ class {{CLASS}} final : public tensorflow::XlaCompiledCpuFunction {
       {"{{ARG_INDEX_TABLE}}", absl::StrJoin(arg_index_table, ", ")},
       {"{{ASSIGN_PROFILE_COUNTERS_SIZE}}", assign_profile_counters_size},
       {"{{CLASS}}", opts.class_name},
+      {"{{CONSTRUCTOR_BODY}}", constructor_body},
       {"{{DECLS_FROM_OBJ_FILE}}",
        absl::StrJoin(metadata_result.header_variable_decls, "\n")},
       {"{{ENTRY}}", compile_result.entry_point},
@@ -711,6 +789,8 @@ class {{CLASS}} final : public tensorflow::XlaCompiledCpuFunction {
       {"{{METHODS_ARG}}\n", methods_arg},
       {"{{METHODS_RESULT}}\n", methods_result},
       {"{{METHODS_VARIABLE}}\n", methods_variable},
+      {"{{METHODS_BATCH_SIZE}}\n", methods_batch_size},
+      {"{{MEMBERS_BATCH_SIZE}}\n", members_batch_size},
       {"{{NS_END}}\n", ns_end},
       {"{{NS_START}}\n", ns_start},
       {"{{PROGRAM_SHAPE}}", xla::ShapeUtil::HumanString(xla::ProgramShape(ps))},
@@ -264,6 +264,81 @@ TEST(CodegenTest, Golden) {
   CompareWithGoldenFile("tensorflow/compiler/aot/codegen_test_h.golden", header,
                         true);
 }
+
+TEST(CodegenTest, DynamicBatch) {
+  LLVMInitializeX86Target();
+  LLVMInitializeX86TargetInfo();
+  LLVMInitializeX86TargetMC();
+  LLVMInitializeX86AsmPrinter();
+
+  CodegenOpts opts;
+  opts.class_name = "MyClass";
+  opts.target_triple = "x86_64-pc-linux";
+  tf2xla::Config config;
+  tf2xla::Feed* feed = config.add_feed();
+  feed->mutable_id()->set_node_name("feed0");
+  feed->mutable_shape()->add_dim()->set_size(8);
+  feed->mutable_shape()->add_dim()->set_size(2);
+  feed->set_name("myfeed");
+  feed->set_dynamic_batch(true);
+  feed = config.add_feed();
+  feed->mutable_id()->set_node_name("feed1");
+  feed->mutable_shape()->add_dim()->set_size(4);
+  tf2xla::Fetch* fetch = config.add_fetch();
+  fetch->mutable_id()->set_node_name("fetch0");
+  fetch->set_name("myfetch");
+  CompileResult compile_result;
+  compile_result.aot.reset(new xla::cpu::CpuAotCompilationResult(
+      {},
+      {BufferInfo::MakeEntryParameter(/*size=*/64, /*param_number=*/0),
+       BufferInfo::MakeEntryParameter(/*size=*/16, /*param_number=*/1),
+       BufferInfo::MakeEntryParameter(/*size=*/4, /*param_number=*/2),
+       BufferInfo::MakeTempBuffer(8), BufferInfo::MakeTempBuffer(104)},
+      3, {}));
+  compile_result.program_shape =
+      xla::ShapeUtil::MakeProgramShape(
+          {
+              xla::ShapeUtil::MakeShape(xla::F32, {8, 2}, {true, false}),
+              xla::ShapeUtil::MakeShape(xla::F32, {4}),
+              xla::ShapeUtil::MakeShape(xla::S32, {}),
+          },
+          xla::ShapeUtil::MakeTupleShape({
+              xla::ShapeUtil::MakeShape(xla::F32, {8, 3}, {true, false}),
+          }))
+          .ToProto();
+  compile_result.entry_point = "entry_point";
+  compile_result.pointer_size = 8;
+
+  MetadataResult metadata_result;
+  TF_ASSERT_OK(GenerateMetadata(opts, compile_result, &metadata_result));
+  string header;
+  TF_ASSERT_OK(
+      GenerateHeader(opts, config, compile_result, metadata_result, &header));
+
+  EXPECT_TRUE(absl::StrContains(
+      header, "static constexpr ::tensorflow::int32 kMaxBatchSize = 8;"));
+  EXPECT_TRUE(absl::StrContains(
+      header, "static constexpr size_t kBatchSizeArgIndex = 2;"));
+  EXPECT_TRUE(absl::StrContains(
+      header, "set_arg_data(kBatchSizeArgIndex, &batch_size_);"));
+  EXPECT_TRUE(absl::StrContains(
+      header, R"(bool set_batch_size(::tensorflow::int32 batch_size) {
+    if (batch_size < 0 || batch_size > kMaxBatchSize) return false;
+    batch_size_ = batch_size;
+    return true;
+  })"));
+  // The sizes of the args and results with a dynamic batch depend on the batch
+  // size, while the others are fixed.
+  EXPECT_TRUE(absl::StrContains(header, R"(int arg_myfeed_size() const {
+    return batch_size() * 2 * sizeof(float);
+  })"));
+  EXPECT_TRUE(absl::StrContains(header, R"(int arg1_count() const {
+    return 4;
+  })"));
+  EXPECT_TRUE(absl::StrContains(header, R"(int result_myfetch_count() const {
+    return batch_size() * 3;
+  })"));
+}
 }  // namespace
 }  // namespace tfcompile
 }  // namespace tensorflow
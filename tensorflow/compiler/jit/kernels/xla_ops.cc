@@ -30,6 +30,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/client/local_client.h"
 #include "tensorflow/compiler/xla/executable_run_options.h"
 #include "tensorflow/compiler/xla/service/compiler.h"
+#include "tensorflow/compiler/xla/service/executable.h"
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
@@ -92,8 +93,16 @@ XlaPlatformInfo PlatformInfoFromContext(OpKernelConstruction* ctx) {
         xla_device_metadata->client()->backend().memory_allocator();
   }
 
-  return XlaPlatformInfo(device_type, platform_id, xla_device_metadata,
-                         custom_allocator);
+  se::Platform* platform = nullptr;
+  if (platform_id != nullptr) {
+    auto platform_or = se::MultiPlatformManager::PlatformWithId(platform_id);
+    if (platform_or.ok()) {
+      platform = platform_or.ValueOrDie();
+    }
+  }
+
+  return XlaPlatformInfo(device_type, platform_id, platform,
+                         xla_device_metadata, custom_allocator);
 }
 
 // A closure describing how to run a compiled version of a TensorFlow function.
@@ -192,9 +201,12 @@ se::DeviceMemoryAllocator* GetAllocator(
   }
   if (!ctx->op_device_context()) {
     // Stream is not set for the host platform.
-    se::Platform* platform =
-        se::MultiPlatformManager::PlatformWithId(platform_info.platform_id())
-            .ValueOrDie();
+    se::Platform* platform = platform_info.platform();
+    if (platform == nullptr) {
+      platform =
+          se::MultiPlatformManager::PlatformWithId(platform_info.platform_id())
+              .ValueOrDie();
+    }
     tf_allocator_adapter->emplace(ctx->device()->GetAllocator({}), platform);
     return &tf_allocator_adapter->value();
   }
@@ -204,6 +216,57 @@ se::DeviceMemoryAllocator* GetAllocator(
   return &tf_allocator_adapter->value();
 }
 
+// Runs `executable` on the host platform, donating to it the buffers of the
+// inputs that are dead after the computation and that it may alias with its
+// outputs.
+xla::StatusOr<xla::ScopedShapedBuffer> RunOnHostWithDonatedInputs(
+    OpKernelContext* ctx, xla::LocalExecutable* executable,
+    const XlaCompiler::CompilationResult* kernel,
+    const std::map<int, OptionalTensor>& variables,
+    int missing_ctx_input_prefix,
+    XlaComputationLaunchContext* launch_context,
+    const xla::ExecutableRunOptions& run_options) {
+  std::vector<const xla::Shape*> argument_host_shapes;
+  argument_host_shapes.reserve(launch_context->arguments().size());
+  for (const xla::ShapedBuffer* argument : launch_context->arguments()) {
+    argument_host_shapes.push_back(&argument->on_host_shape());
+  }
+  TF_ASSIGN_OR_RETURN(
+      xla::ExecutionOutput execution_output,
+      executable->Run(
+          argument_host_shapes,
+          launch_context->PopulateExecutionInputs(
+              ctx, kernel, variables, missing_ctx_input_prefix,
+              executable->executable()->module().input_output_alias_config()),
+          run_options));
+  // The input tensors keep ownership of donated buffers that the executable
+  // did not reuse.
+  for (se::OwningDeviceMemory& buffer :
+       execution_output.ConsumeToBeReleased()) {
+    buffer.Release();
+  }
+  return execution_output.ConsumeResult();
+}
+
+// Returns whether the executor would let `ctx` forward input `input` to one of
+// its outputs, see OpKernelContext::forward_input(), so that the input's
+// buffer can be donated to the computation.
+bool CanForwardInputToAnOutput(OpKernelContext* ctx, int input) {
+  const Tensor& tensor = ctx->input(input);
+  for (int output = 0; output < ctx->num_outputs(); ++output) {
+    if (ctx->expected_output_dtype(output) != tensor.dtype() ||
+        ctx->output_memory_type(output) != ctx->input_memory_type(input)) {
+      continue;
+    }
+    if (ctx->forward_input(input, output, tensor.dtype(), tensor.shape(),
+                           ctx->output_memory_type(output),
+                           ctx->output_alloc_attr(output)) != nullptr) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 XlaLocalLaunchBase::XlaLocalLaunchBase(OpKernelConstruction* ctx,
@@ -277,8 +340,8 @@ static Status BuildCompilationCache(OpKernelContext* ctx,
 static Status CompileToLocalExecutable(
     OpKernelContext* ctx, const NameAttrList& function, bool has_ref_vars,
     const XlaPlatformInfo& platform_info, absl::Span<const int> resources,
-    absl::Span<const int> constants, bool lazy, xla::LocalClient** client,
-    std::map<int, OptionalTensor>* variables,
+    absl::Span<const int> constants, bool lazy, bool donate_inputs,
+    xla::LocalClient** client, std::map<int, OptionalTensor>* variables,
     const XlaCompiler::CompilationResult** kernel,
     xla::LocalExecutable** executable) {
   // We store information about the JIT-compiled XLA computation
@@ -324,6 +387,9 @@ static Status CompileToLocalExecutable(
   // passthrough parameters without performing a copy.
   options.alias_passthrough_params =
       !has_ref_vars && !platform_info.is_on_xla_device();
+  // Outputs may reuse the buffers of dead inputs of the same shape, which are
+  // donated at run time.
+  options.alias_donated_params = donate_inputs;
 
   std::map<int, Tensor> constant_args;
   for (int i : constants) {
@@ -338,6 +404,16 @@ static Status CompileToLocalExecutable(
   std::vector<XlaCompiler::Argument> args;
   TF_RETURN_IF_ERROR(XlaComputationLaunchContext::BuildXlaCompilerArguments(
       constant_args, *variables, ctx, &args));
+  if (donate_inputs) {
+    // Only inputs that can be donated now are aliased with outputs, and the
+    // cache keys the executable on them. An input that is still live would
+    // otherwise be copied on every run, for an output that would just as well
+    // be allocated.
+    for (int i = 0; i < args.size(); ++i) {
+      args[i].may_donate = args[i].kind == XlaCompiler::Argument::kParameter &&
+                           CanForwardInputToAnOutput(ctx, i);
+    }
+  }
   return cache->Compile(options, function, args, compile_options,
                         lazy ? XlaCompilationCache::CompileMode::kLazy
                              : XlaCompilationCache::CompileMode::kStrict,
@@ -353,11 +429,17 @@ void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
   xla::LocalExecutable* executable;
   std::map<int, OptionalTensor> variables;
 
+  // On the host, inputs that are dead after the op are donated to the
+  // computation.
+  const bool donate_inputs =
+      platform_info_.platform_id() == se::host::kHostPlatformId &&
+      !platform_info_.is_on_xla_device();
+
   {
     Status s = CompileToLocalExecutable(
         ctx, function_, /*has_ref_vars=*/has_ref_vars_, platform_info_,
-        resources_, constants_, /*lazy=*/false, &client, &variables, &kernel,
-        &executable);
+        resources_, constants_, /*lazy=*/false, donate_inputs, &client,
+        &variables, &kernel, &executable);
     OP_REQUIRES_OK(ctx, s);
   }
 
@@ -399,7 +481,12 @@ void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
   auto start_time = env->NowMicros();
 
   xla::StatusOr<xla::ScopedShapedBuffer> run_result;
-  if (!stream || platform_info_.platform_id() == se::host::kHostPlatformId) {
+  if (donate_inputs) {
+    run_result = RunOnHostWithDonatedInputs(
+        ctx, executable, kernel, variables, /*missing_ctx_input_prefix=*/0,
+        &launch_context, run_options);
+  } else if (!stream ||
+             platform_info_.platform_id() == se::host::kHostPlatformId) {
     run_result = executable->Run(launch_context.arguments(), run_options);
   } else {
     run_result = executable->RunAsync(launch_context.arguments(), run_options);
@@ -506,9 +593,12 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
       cannot_compile_cluster) {
     executable = nullptr;
   } else {
+    // The inputs are also inputs of the _XlaRun op, so whether they are dead
+    // is not known here, and they are not donated.
     Status status = CompileToLocalExecutable(
         ctx, function_, has_ref_vars_, platform_info_, resources_, constants_,
-        /*lazy=*/!must_compile_, &client, &variables, &kernel, &executable);
+        /*lazy=*/!must_compile_, /*donate_inputs=*/false, &client, &variables,
+        &kernel, &executable);
     if (must_compile_ || status.code() != error::UNIMPLEMENTED) {
       OP_REQUIRES_OK(ctx, status);
     }
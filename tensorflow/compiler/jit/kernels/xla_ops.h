@@ -39,10 +39,12 @@ class XlaPlatformInfo {
   XlaPlatformInfo(XlaPlatformInfo&&) = default;
   explicit XlaPlatformInfo(const DeviceType device_type,
                            se::Platform::Id platform_id,
+                           se::Platform* platform,
                            const XlaDevice::Metadata* xla_device_metadata,
                            se::DeviceMemoryAllocator* device_allocator)
       : device_type_(device_type),
         platform_id_(platform_id),
+        platform_(platform),
         xla_device_metadata_(xla_device_metadata),
         device_allocator_(device_allocator) {}
 
@@ -63,6 +65,11 @@ class XlaPlatformInfo {
   // xla_device_metadata() is not nullptr.
   se::Platform::Id platform_id() const { return platform_id_; }
 
+  // The platform with id platform_id(), looked up once when the op is
+  // constructed so that launches don't search the platform registry. This may
+  // be null if the platform isn't registered.
+  se::Platform* platform() const { return platform_; }
+
   // This may be null if the op this XlaPlatformInfo is for was not placed on an
   // XLA device.
   const XlaDevice::Metadata* xla_device_metadata() const {
@@ -73,6 +80,7 @@ class XlaPlatformInfo {
  private:
   DeviceType device_type_;
   se::Platform::Id platform_id_;
+  se::Platform* platform_ = nullptr;
 
   // xla_device_metadata_ lives in the tensorflow::DeviceBase in which the
   // XlaLaunch/_XlaCompile/_XlaRun op is placed and thus does not die before the
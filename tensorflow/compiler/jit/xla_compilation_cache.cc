@@ -89,12 +89,17 @@ string XlaCompilationCache::Signature::HumanString() const {
   for (const auto& v : arg_values) {
     absl::StrAppend(&result, "; ", v.DebugString());
   }
+
+  if (!donated_args.empty()) {
+    absl::StrAppend(&result, "; donated ", absl::StrJoin(donated_args, ","));
+  }
   return result;
 }
 
 bool XlaCompilationCache::Signature::operator==(const Signature& other) const {
   if (name != other.name) return false;
   if (arg_shapes != other.arg_shapes) return false;
+  if (donated_args != other.donated_args) return false;
 
   if (arg_values.size() != other.arg_values.size()) return false;
   for (int i = 0; i < arg_values.size(); ++i) {
@@ -107,46 +112,47 @@ bool XlaCompilationCache::Signature::operator==(const Signature& other) const {
   return true;
 }
 
-uint64 XlaCompilationCache::Signature::Hash::operator()(
-    const XlaCompilationCache::Signature& signature) const {
-  uint64 h = std::hash<string>()(signature.name);
-  for (const auto& arg : signature.arg_shapes) {
-    h = Hash64Combine(h, std::hash<int>()(static_cast<int>(arg.first)));
-    h = Hash64Combine(h, std::hash<int>()(arg.second.size()));
-    for (int dim : arg.second) {
-      h = Hash64Combine(h, std::hash<int>()(dim));
-    }
-  }
-  for (const auto& arg : signature.arg_values) {
-    h = Hash64Combine(
-        h, Hash64(arg.tensor_data().data(), arg.tensor_data().size()));
-  }
-  return h;
-}
-
 xla::StatusOr<XlaCompilationCache::Signature>
 XlaCompilationCache::BuildSignature(
     const NameAttrList& function,
     absl::Span<const XlaCompiler::Argument> args) {
   Signature signature;
   signature.name = Canonicalize(function.name(), AttrSlice(&function.attr()));
+  uint64 h = std::hash<string>()(signature.name);
 
-  for (const XlaCompiler::Argument& arg : args) {
+  for (int i = 0; i < args.size(); ++i) {
+    const XlaCompiler::Argument& arg = args[i];
     switch (arg.kind) {
-      case XlaCompiler::Argument::kConstant:
+      case XlaCompiler::Argument::kConstant: {
         signature.arg_values.push_back(arg.constant_value);
+        const StringPiece data = arg.constant_value.tensor_data();
+        h = Hash64Combine(h, Hash64(data.data(), data.size()));
         break;
+      }
       case XlaCompiler::Argument::kParameter:
-      case XlaCompiler::Argument::kResource:
+      case XlaCompiler::Argument::kResource: {
         signature.arg_shapes.emplace_back(arg.type,
                                           arg.DimensionSizesAsInlinedVector());
+        const absl::InlinedVector<int64, 4>& dims =
+            signature.arg_shapes.back().second;
+        h = Hash64Combine(h, std::hash<int>()(static_cast<int>(arg.type)));
+        h = Hash64Combine(h, std::hash<int>()(dims.size()));
+        for (int64 dim : dims) {
+          h = Hash64Combine(h, std::hash<int64>()(dim));
+        }
+        if (arg.may_donate) {
+          signature.donated_args.push_back(i);
+          h = Hash64Combine(h, std::hash<int>()(i));
+        }
         break;
+      }
       default:
         return errors::InvalidArgument(
             "Unhandled argument kind in XlaCompilationCache: ",
             arg.HumanString());
     }
   }
+  signature.hash = h;
   return std::move(signature);
 }
 
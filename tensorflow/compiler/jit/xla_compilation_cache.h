@@ -107,10 +107,21 @@ class XlaCompilationCache : public ResourceBase {
     // compilation, ordered by argument number. Tensors must be in host memory.
     absl::InlinedVector<Tensor, 4> arg_values;
 
+    // Argument numbers of the parameters whose buffers the caller may donate,
+    // which the compiled computation may alias with its outputs.
+    absl::InlinedVector<int, 4> donated_args;
+
+    // Hash of the fields above, accumulated by BuildSignature as it appends
+    // them, so that looking up a signature in the cache doesn't walk the
+    // arguments a second time.
+    uint64 hash = 0;
+
     bool operator==(const Signature& other) const;
 
     struct Hash {
-      uint64 operator()(const Signature& signature) const;
+      uint64 operator()(const Signature& signature) const {
+        return signature.hash;
+      }
     };
 
     // Returns a human-readable description of the signature.
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/compiler/jit/xla_compilation_cache.h"
 
 #include "tensorflow/compiler/tf2xla/shape_util.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -52,6 +53,56 @@ TEST(XlaCompilationCacheTest, SignatureEquality) {
   }
 }
 
+TEST(XlaCompilationCacheTest, SignatureHash) {
+  NameAttrList fn;
+  fn.set_name("afunction");
+  std::vector<XlaCompiler::Argument> args(2);
+  args[0].kind = XlaCompiler::Argument::kParameter;
+  args[0].type = DT_FLOAT;
+  args[0].shape = TensorShape({4, 8});
+  args[1].kind = XlaCompiler::Argument::kConstant;
+  args[1].type = DT_INT32;
+  args[1].shape = TensorShape({2});
+  args[1].constant_value = test::AsTensor<int32>({1, 2});
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s1,
+                          XlaCompilationCache::BuildSignature(fn, args));
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s2,
+                          XlaCompilationCache::BuildSignature(fn, args));
+
+  args[0].shape = TensorShape({8, 4});
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s3,
+                          XlaCompilationCache::BuildSignature(fn, args));
+
+  args[0].shape = TensorShape({4, 8});
+  args[1].constant_value = test::AsTensor<int32>({1, 3});
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s4,
+                          XlaCompilationCache::BuildSignature(fn, args));
+
+  XlaCompilationCache::Signature::Hash hash;
+  EXPECT_EQ(hash(s1), hash(s2));
+  EXPECT_NE(hash(s1), hash(s3));
+  EXPECT_NE(hash(s1), hash(s4));
+}
+
+TEST(XlaCompilationCacheTest, SignatureDistinguishesDonatedArgs) {
+  NameAttrList fn;
+  fn.set_name("afunction");
+  std::vector<XlaCompiler::Argument> args(1);
+  args[0].kind = XlaCompiler::Argument::kParameter;
+  args[0].type = DT_FLOAT;
+  args[0].shape = TensorShape({4, 8});
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s1,
+                          XlaCompilationCache::BuildSignature(fn, args));
+
+  args[0].may_donate = true;
+  TF_ASSERT_OK_AND_ASSIGN(XlaCompilationCache::Signature s2,
+                          XlaCompilationCache::BuildSignature(fn, args));
+
+  XlaCompilationCache::Signature::Hash hash;
+  EXPECT_FALSE(s1 == s2);
+  EXPECT_NE(hash(s1), hash(s2));
+}
+
 static void BM_BuildSignature(int iters, int n_args) {
   NameAttrList fn;
   fn.set_name("afunction");
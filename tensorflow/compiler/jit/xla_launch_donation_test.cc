@@ -0,0 +1,112 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Tests that XlaLaunch on the host computes an output in the buffer of an
+// input that is dead after the op, and that an input that is still live
+// costs neither a copy nor an allocation besides the output.
+
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/function.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr int64 kNumElements = 1024;
+
+class XlaLaunchDonationTest : public OpsTestBase {
+ protected:
+  XlaLaunchDonationTest() { EnableCPUAllocatorStats(true); }
+  ~XlaLaunchDonationTest() override { EnableCPUAllocatorStats(false); }
+
+  // Creates an XlaLaunch of a cluster that negates its input.
+  void MakeNegateLaunch() {
+    TF_ASSERT_OK(flib_def_->AddFunctionDef(FunctionDefHelper::Define(
+        "Negate", {"x: float"}, {"y: float"}, {},
+        {{{"y"}, "Neg", {"x"}, {{"T", DT_FLOAT}}}})));
+    NameAttrList function;
+    function.set_name("Negate");
+    TF_ASSERT_OK(NodeDefBuilder("launch", "XlaLaunch")
+                     .Input(FakeInput(DataTypeVector()))
+                     .Input(FakeInput(DataTypeVector({DT_FLOAT})))
+                     .Input(FakeInput(0, DT_RESOURCE))
+                     .Attr("Tresults", DataTypeVector({DT_FLOAT}))
+                     .Attr("function", function)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Replaces the input of the launch with a new tensor of ones, which only
+  // the op refers to.
+  void ResetInput() {
+    for (Tensor* tensor : tensors_) {
+      delete tensor;
+    }
+    tensors_.clear();
+    inputs_.clear();
+    AddInput<float>(TensorShape({kNumElements}), [](int) { return 1.0f; });
+  }
+
+  int64 NumAllocs() { return allocator()->GetStats()->num_allocs; }
+
+  Tensor Expected(float value) {
+    return test::AsTensor<float>(std::vector<float>(kNumElements, value));
+  }
+};
+
+TEST_F(XlaLaunchDonationTest, DeadInputIsReused) {
+  MakeNegateLaunch();
+  // The first run compiles the cluster.
+  ResetInput();
+  TF_ASSERT_OK(RunOpKernel());
+
+  ResetInput();
+  const void* input_data = mutable_input(0).tensor->data();
+  const int64 num_allocs = NumAllocs();
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(NumAllocs(), num_allocs);
+  EXPECT_EQ(GetOutput(0)->data(), input_data);
+  test::ExpectTensorEqual<float>(Expected(-1.0f), *GetOutput(0));
+}
+
+TEST_F(XlaLaunchDonationTest, LiveInputIsNotCopied) {
+  MakeNegateLaunch();
+  ResetInput();
+  Tensor live_input = *mutable_input(0).tensor;
+  TF_ASSERT_OK(RunOpKernel());
+
+  // The computation was compiled without aliasing the live input with the
+  // output, so a run only allocates the output, and leaves the input as is.
+  ResetInput();
+  live_input = *mutable_input(0).tensor;
+  const int64 num_allocs = NumAllocs();
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(NumAllocs(), num_allocs + 1);
+  EXPECT_NE(GetOutput(0)->data(), live_input.data());
+  test::ExpectTensorEqual<float>(Expected(-1.0f), *GetOutput(0));
+  test::ExpectTensorEqual<float>(Expected(1.0f), live_input);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,119 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks the per-step overhead of running a small elementwise graph on the
+// CPU without XLA (arg 0) and as an auto-clustered XLA computation (arg 1).
+// For clusters this small, the time is dominated by launching the cluster
+// rather than by the computation. The test checks that both agree.
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/cc/framework/ops.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/compiler/jit/flags.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+namespace {
+
+GraphDef CreateGraphDef() {
+  Scope root = Scope::NewRootScope().ExitOnError().WithAssignedDevice(
+      "/job:localhost/replica:0/task:0/device:CPU:0");
+  Output a = ops::Placeholder(root.WithOpName("A"), DT_FLOAT);
+  Output b = ops::Placeholder(root.WithOpName("B"), DT_FLOAT);
+  Output x = ops::Mul(root.WithOpName("mul_0"), a, b);
+  x = ops::Add(root.WithOpName("add_0"), x, a);
+  x = ops::Tanh(root.WithOpName("tanh"), x);
+  x = ops::Mul(root.WithOpName("mul_1"), x, b);
+  x = ops::Sub(root.WithOpName("out"), x, a);
+
+  GraphDef graph_def;
+  root.graph()->ToGraphDef(&graph_def);
+  return graph_def;
+}
+
+std::unique_ptr<Session> CreateSession(bool use_xla) {
+  SessionOptions options;
+  options.config.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_global_jit_level(use_xla ? OptimizerOptions::ON_2
+                                     : OptimizerOptions::OFF);
+  std::unique_ptr<Session> session(NewSession(options));
+  TF_CHECK_OK(session->Create(CreateGraphDef()));
+  return session;
+}
+
+std::vector<std::pair<string, Tensor>> CreateInputs(int64 num_elements) {
+  Tensor a(DT_FLOAT, TensorShape({num_elements}));
+  Tensor b(DT_FLOAT, TensorShape({num_elements}));
+  for (int64 i = 0; i < num_elements; ++i) {
+    a.flat<float>()(i) = 0.25f * (i % 7);
+    b.flat<float>()(i) = 1.0f - 0.125f * (i % 5);
+  }
+  return {{"A", a}, {"B", b}};
+}
+
+TEST(XlaLaunchOverheadTest, XlaMatchesTensorFlow) {
+  std::vector<std::pair<string, Tensor>> inputs = CreateInputs(64);
+  std::vector<Tensor> expected;
+  TF_ASSERT_OK(CreateSession(/*use_xla=*/false)
+                   ->Run(inputs, {"out:0"}, /*target_node_names=*/{},
+                         &expected));
+  std::unique_ptr<Session> session = CreateSession(/*use_xla=*/true);
+  // The first run compiles the cluster, the following ones reuse it.
+  for (int i = 0; i < 3; ++i) {
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(
+        session->Run(inputs, {"out:0"}, /*target_node_names=*/{}, &outputs));
+    test::ExpectClose(expected[0], outputs[0], /*atol=*/1e-5,
+                      /*rtol=*/1e-5);
+  }
+}
+
+void BM_SmallClusterStep(int iters, int use_xla) {
+  testing::StopTiming();
+  std::unique_ptr<Session> session = CreateSession(use_xla != 0);
+  std::vector<std::pair<string, Tensor>> inputs = CreateInputs(16);
+  std::vector<Tensor> outputs;
+  // Warm up, which compiles the cluster.
+  TF_CHECK_OK(
+      session->Run(inputs, {"out:0"}, /*target_node_names=*/{}, &outputs));
+
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(
+        session->Run(inputs, {"out:0"}, /*target_node_names=*/{}, &outputs));
+  }
+  testing::StopTiming();
+}
+BENCHMARK(BM_SmallClusterStep)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::GetMarkForCompilationPassFlags()->tf_xla_cpu_global_jit = true;
+  ::testing::InitGoogleTest(&argc, argv);
+  tensorflow::testing::RunBenchmarks();
+  return RUN_ALL_TESTS();
+}
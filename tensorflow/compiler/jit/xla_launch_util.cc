@@ -246,6 +246,86 @@ void XlaComputationLaunchContext::PopulateInputs(
   }
 }
 
+// Returns the op output that is returned from the XLA output which may alias
+// XLA parameter `param`, or -1 if there is none.
+static int FindOpOutputAliasingParameter(
+    const XlaCompiler::CompilationResult* kernel,
+    const xla::HloInputOutputAliasConfig& input_output_alias, int param) {
+  int xla_output = -1;
+  input_output_alias.ForEachAlias(
+      [&](const xla::ShapeIndex& output_index,
+          const xla::HloInputOutputAliasConfig::Alias& alias) {
+        if (alias.parameter_number == param && alias.parameter_index.empty()) {
+          xla_output = output_index.empty() ? 0 : output_index[0];
+        }
+      });
+  if (xla_output < 0) {
+    return -1;
+  }
+  // Constant outputs are not computed by XLA, as in PopulateOutputs(). The
+  // XLA outputs past the op outputs are resource updates.
+  int output_num = 0;
+  for (int i = 0; i < kernel->outputs.size(); ++i) {
+    if (kernel->outputs[i].is_constant) {
+      continue;
+    }
+    if (output_num == xla_output) {
+      return i;
+    }
+    ++output_num;
+  }
+  return -1;
+}
+
+std::vector<xla::ExecutionInput>
+XlaComputationLaunchContext::PopulateExecutionInputs(
+    OpKernelContext* ctx, const XlaCompiler::CompilationResult* kernel,
+    const std::map<int, OptionalTensor>& variables,
+    int missing_ctx_input_prefix,
+    const xla::HloInputOutputAliasConfig& input_output_alias) {
+  std::vector<xla::ExecutionInput> arguments;
+  arguments.reserve(arg_ptrs_.size());
+  for (int i = 0; i < arg_ptrs_.size(); ++i) {
+    const ShapedBuffer& arg = *arg_ptrs_[i];
+    int arg_num = kernel->input_mapping[i];
+    int ctx_input = arg_num - missing_ctx_input_prefix;
+    // Resource variables are never donated: other ops may read the variable
+    // while the computation runs. Otherwise an input is donated under the
+    // same conditions as the executor lets an op forward it to the output
+    // that reuses it: see OpKernelContext::forward_input().
+    bool donate = false;
+    if (!arg.on_device_shape().IsTuple() && variables.count(arg_num) == 0) {
+      int output = FindOpOutputAliasingParameter(kernel, input_output_alias, i);
+      if (output >= 0 && kernel->outputs[output].type != DT_RESOURCE) {
+        const XlaCompiler::OutputDescription& description =
+            kernel->outputs[output];
+        donate = ctx->forward_input(ctx_input, output, description.type,
+                                    description.shape,
+                                    ctx->output_memory_type(output),
+                                    ctx->output_alloc_attr(output)) != nullptr;
+      }
+    }
+    xla::ExecutionInput argument(arg.on_device_shape());
+    for (const auto& index_buffer : arg.buffers()) {
+      if (donate) {
+        VLOG(2) << "Donating the buffer of input " << ctx_input;
+        // The input tensor keeps ownership of its buffer, which is reclaimed
+        // from the result in PopulateOutputs(), or released by the
+        // ExecutionInput if the execution fails before using it.
+        argument.SetUnownedBuffer(
+            index_buffer.first,
+            xla::MaybeOwningDeviceMemory(se::OwningDeviceMemory(
+                index_buffer.second, arg.device_ordinal(), xla_allocator_)));
+      } else {
+        argument.SetBuffer(index_buffer.first,
+                           xla::MaybeOwningDeviceMemory(index_buffer.second));
+      }
+    }
+    arguments.push_back(std::move(argument));
+  }
+  return arguments;
+}
+
 static bool MustAliasOutput(
     const xla::HloInputOutputAliasConfig& input_output_alias, int output_num) {
   xla::ShapeIndex output_index;
@@ -289,6 +369,34 @@ static const Tensor* FindAliasedTensorForOutput(
   return nullptr;
 }
 
+// Returns the input tensor whose donated buffer the executable reused for
+// `output_buffer`, nullptr if there is none. Such an output may alias its
+// input (kSystemAlias), and is computed into a fresh buffer if the input was
+// not donated.
+static const Tensor* FindDonatedTensorForOutput(
+    int output_num, OpKernelContext* ctx, int missing_ctx_input_prefix,
+    const xla::HloInputOutputAliasConfig& input_output_alias,
+    absl::Span<const int> input_mapping, se::DeviceMemoryBase output_buffer) {
+  xla::ShapeIndex output_index;
+  if (input_output_alias.shape().IsTuple()) {
+    output_index = {output_num};
+  }
+  absl::optional<xla::HloInputOutputAliasConfig::Alias> alias =
+      input_output_alias.GetAliasedParameter(output_index);
+  if (!alias || alias->kind != xla::HloInputOutputAliasConfig::kSystemAlias) {
+    return nullptr;
+  }
+  int tf_param =
+      input_mapping[alias->parameter_number] - missing_ctx_input_prefix;
+  const Tensor* input_tensor = &ctx->input(tf_param);
+  if (input_tensor->dtype() == DT_RESOURCE ||
+      XlaTensor::DeviceMemoryFromTensor(*input_tensor).opaque() !=
+          output_buffer.opaque()) {
+    return nullptr;
+  }
+  return input_tensor;
+}
+
 // Construct the tensor for given type and buffer.
 static Tensor MakeTensor(DataType dtype, const TensorShape& shape,
                          se::DeviceMemoryBase buffer, Allocator* allocator) {
@@ -313,6 +421,11 @@ static Tensor GetOrCreateTensorForOutput(
           input_mapping, resource_var_snapshots)) {
     return *aliased_tensor;
   }
+  if (const Tensor* donated_tensor = FindDonatedTensorForOutput(
+          output_num, ctx, missing_ctx_input_prefix, input_output_alias,
+          input_mapping, output_buffer)) {
+    return *donated_tensor;
+  }
   return MakeTensor(output_dtype, output_shape, output_buffer,
                     output_allocator);
 }
@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/compiler/jit/xla_tensor.h"
 #include "tensorflow/compiler/tf2xla/xla_compiler.h"
 #include "tensorflow/compiler/xla/client/local_client.h"
+#include "tensorflow/compiler/xla/service/executable.h"
 #include "tensorflow/compiler/xla/service/shaped_buffer.h"
 #include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/resource_var.h"
@@ -160,6 +161,20 @@ class XlaComputationLaunchContext {
   // called.
   const std::vector<xla::ShapedBuffer*>& arguments() const { return arg_ptrs_; }
 
+  // Returns the argument list as ExecutionInputs which donate to the
+  // executable the buffers of the parameters that may alias an output in
+  // `input_output_alias` and whose input tensors could be forwarded to the
+  // op outputs returned from those outputs, as checked by
+  // OpKernelContext::forward_input(), so that the executable can compute
+  // those outputs in place. The remaining buffers are not owned by the
+  // ExecutionInputs. Only valid after PopulateInputs() has been called with
+  // the same arguments.
+  std::vector<xla::ExecutionInput> PopulateExecutionInputs(
+      OpKernelContext* ctx, const XlaCompiler::CompilationResult* kernel,
+      const std::map<int, OptionalTensor>& variables,
+      int missing_ctx_input_prefix,
+      const xla::HloInputOutputAliasConfig& input_output_alias);
+
  private:
   xla::LocalClient* client_;
   se::DeviceMemoryAllocator* xla_allocator_;
@@ -247,6 +247,24 @@ Status CreateXlaArgs(const Graph& graph,
 
 void PopulateXlaArgs(const tf2xla::Config& config,
                      std::vector<XlaCompiler::Argument>* xla_args) {
+  // The feeds with a dynamic batch have their first dimension bound to a scalar
+  // batch size argument following the feeds. XLA then only computes on the
+  // leading batch size rows of the bounded buffers.
+  if (HasDynamicBatch(config)) {
+    const int32 batch_size_arg_num = config.feed_size();
+    for (int i = 0; i < config.feed_size(); ++i) {
+      if (config.feed(i).dynamic_batch()) {
+        (*xla_args)[i].dynamic_dim_to_arg_num_map[0] = batch_size_arg_num;
+      }
+    }
+    XlaCompiler::Argument arg;
+    arg.kind = XlaCompiler::Argument::kParameter;
+    arg.type = DT_INT32;
+    arg.shape = TensorShape();
+    arg.name = "batch_size";
+    xla_args->insert(xla_args->begin() + batch_size_arg_num, std::move(arg));
+  }
+
   // Populate arguments with resource variables from the config. The variables
   // get turned into inputs and outputs.
   for (const tf2xla::Variable& variable : config.variable()) {
@@ -29,7 +29,9 @@ namespace tensorflow {
 Status CreateXlaArgs(const Graph& graph,
                      std::vector<XlaCompiler::Argument>* xla_args);
 
-// Populate xla_args for the given XLA config.
+// Populate xla_args for the given XLA config. If any feed has a dynamic batch,
+// this binds the first dimension of those feeds to a batch size argument that
+// is inserted after the feeds.
 void PopulateXlaArgs(const tf2xla::Config& config,
                      std::vector<XlaCompiler::Argument>* xla_args);
 
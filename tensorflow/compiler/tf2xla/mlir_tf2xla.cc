@@ -108,6 +108,10 @@ Status ConvertGraphDefToXlaViaMlir(
     GraphDef graph_def, const tf2xla::Config& config,
     xla::XlaComputation* computation, absl::string_view debug_info_filename,
     absl::string_view debug_info_path_begin_marker) {
+  if (HasDynamicBatch(config)) {
+    return errors::Unimplemented(
+        "Feeds with a dynamic batch are not supported by the MLIR bridge");
+  }
   // AddPlaceholdersForFeeds prepares for PruneGraphDefInto and serves two
   // purposes: (1) It creates a placeholder node for each feed, so that
   // PruneGraphDefInfo can prune away the node containing the feed. (2) It
@@ -21,6 +21,7 @@ limitations under the License.
 #include <set>
 #include <unordered_map>
 
+#include "absl/algorithm/container.h"
 #include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/tf2xla/sharding_util.h"
 #include "tensorflow/compiler/tf2xla/tf2xla.pb.h"
@@ -310,6 +311,24 @@ Status ValidateConfig(const tf2xla::Config& config) {
     TF_RETURN_IF_ERROR(ValidateTensorId(feed.id()));
     TF_RETURN_IF_ERROR(TensorShape::IsValidShape(feed.shape()));
     TF_RETURN_IF_ERROR(CheckNameDuplicates("feed", feed.name(), &names));
+    if (feed.dynamic_batch() &&
+        (feed.shape().dim_size() == 0 || feed.shape().dim(0).size() <= 0)) {
+      return errors::InvalidArgument(
+          "feed with a dynamic batch must have a positive first dimension: ",
+          TensorIdToString(feed.id()));
+    }
+  }
+  int64 max_batch_size = -1;
+  for (const tf2xla::Feed& feed : config.feed()) {
+    if (!feed.dynamic_batch()) {
+      continue;
+    }
+    if (max_batch_size >= 0 && feed.shape().dim(0).size() != max_batch_size) {
+      return errors::InvalidArgument(
+          "feeds with a dynamic batch must have the same first dimension, got ",
+          max_batch_size, " and ", feed.shape().dim(0).size());
+    }
+    max_batch_size = feed.shape().dim(0).size();
   }
   TF_RETURN_IF_ERROR(CheckFeedFetchNameConflicts("feed", names));
   names.clear();
@@ -324,6 +343,12 @@ Status ValidateConfig(const tf2xla::Config& config) {
   return Status::OK();
 }
 
+bool HasDynamicBatch(const tf2xla::Config& config) {
+  return absl::c_any_of(config.feed(), [](const tf2xla::Feed& feed) {
+    return feed.dynamic_batch();
+  });
+}
+
 Status AddPlaceholdersForFeeds(
     const tf2xla::Config& config, const OpRegistryInterface* op_registry,
     std::unordered_map<string, string>* feed_remapping, GraphDef* graph_def) {
@@ -33,6 +33,10 @@ namespace tensorflow {
 // ValidateConfig returns OK iff config is valid.
 Status ValidateConfig(const tf2xla::Config& config);
 
+// Returns true iff any feed of config has a dynamic batch, in which case the
+// batch size is passed as an input argument following the feeds.
+bool HasDynamicBatch(const tf2xla::Config& config);
+
 // Modifies <graph_def> to include placeholders for each fed tensor, and
 // update references to the fed tensors to refer to the placeholders.
 // The existing nodes referenced by the feeds are not removed or modified
@@ -109,6 +109,32 @@ TEST(ValidateConfig, BadFetchOutputIndex) {
   ExpectErrorContains(ValidateConfig(config), "output_index must be positive");
 }
 
+TEST(ValidateConfig, BadDynamicBatchScalarFeed) {
+  tf2xla::Config config;
+  tf2xla::Feed* feed = config.add_feed();
+  feed->mutable_id()->set_node_name("foo");
+  feed->set_dynamic_batch(true);
+  tf2xla::Fetch* fetch = config.add_fetch();
+  fetch->mutable_id()->set_node_name("bar");
+  ExpectErrorContains(ValidateConfig(config),
+                      "must have a positive first dimension");
+}
+
+TEST(ValidateConfig, BadDynamicBatchSizeMismatch) {
+  tf2xla::Config config;
+  tf2xla::Feed* feed = config.add_feed();
+  feed->mutable_id()->set_node_name("foo");
+  feed->mutable_shape()->add_dim()->set_size(8);
+  feed->set_dynamic_batch(true);
+  feed = config.add_feed();
+  feed->mutable_id()->set_node_name("bar");
+  feed->mutable_shape()->add_dim()->set_size(16);
+  feed->set_dynamic_batch(true);
+  tf2xla::Fetch* fetch = config.add_fetch();
+  fetch->mutable_id()->set_node_name("baz");
+  ExpectErrorContains(ValidateConfig(config), "must have the same first");
+}
+
 TEST(ValidateConfig, DuplicateFeedName) {
   tf2xla::Config config;
   tf2xla::Feed* feed = config.add_feed();
@@ -35,6 +35,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/client/client_library.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_input_output_alias_config.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/common_runtime/device.h"
@@ -396,6 +397,54 @@ Status BuildComputation(
   return Status::OK();
 }
 
+// Sets up a may-alias (kSystemAlias) pair between each array output of
+// `result` and the first unaliased parameter argument of the same shape that
+// the caller may donate.
+Status AliasOutputsWithSameShapedParameters(
+    const std::vector<XlaCompiler::Argument>& args,
+    XlaCompiler::CompilationResult* result) {
+  const xla::Shape& output_shape = result->xla_output_shape;
+  xla::HloModuleProto* module = result->computation->mutable_proto();
+  TF_ASSIGN_OR_RETURN(xla::HloInputOutputAliasConfig config,
+                      xla::HloInputOutputAliasConfig::CreateFromProto(
+                          output_shape, module->input_output_alias()));
+  std::vector<xla::ShapeIndex> output_indices;
+  if (output_shape.IsTuple()) {
+    for (int64 i = 0; i < output_shape.tuple_shapes_size(); ++i) {
+      output_indices.push_back({i});
+    }
+  } else {
+    output_indices.push_back({});
+  }
+  bool changed = false;
+  for (const xla::ShapeIndex& output_index : output_indices) {
+    const xla::Shape& subshape =
+        xla::ShapeUtil::GetSubshape(output_shape, output_index);
+    if (!subshape.IsArray() || config.OutputHasAlias(output_index)) {
+      continue;
+    }
+    for (int64 param = 0; param < result->xla_input_shapes.size(); ++param) {
+      const XlaCompiler::Argument& arg = args[result->input_mapping[param]];
+      if (arg.kind != XlaCompiler::Argument::kParameter || !arg.may_donate ||
+          config.ParameterHasAlias(param, /*param_index=*/{}) ||
+          !xla::Shape::Equal()(result->xla_input_shapes[param], subshape)) {
+        continue;
+      }
+      VLOG(2) << "Output " << output_index.ToString()
+              << " may alias parameter " << param;
+      TF_RETURN_IF_ERROR(config.SetUpAlias(
+          output_index, param, /*param_index=*/{},
+          xla::HloInputOutputAliasConfig::kSystemAlias));
+      changed = true;
+      break;
+    }
+  }
+  if (changed) {
+    *module->mutable_input_output_alias() = config.ToProto();
+  }
+  return Status::OK();
+}
+
 }  // namespace
 
 bool XlaCompiler::Argument::operator==(
@@ -429,6 +478,9 @@ bool XlaCompiler::Argument::operator==(
   if (is_same_data_across_replicas != other.is_same_data_across_replicas) {
     return false;
   }
+  if (may_donate != other.may_donate) {
+    return false;
+  }
   return constant_value.tensor_data() == other.constant_value.tensor_data();
 }
 
@@ -462,7 +514,7 @@ string XlaCompiler::Argument::HumanString() const {
       return output;
     }
     case kParameter:
-      return absl::StrCat("kind=parameter", common);
+      return absl::StrCat("kind=parameter", common, " may_donate=", may_donate);
     case kTensorList:
       return absl::StrCat("kind=tensorlist", common);
     case kToken:
@@ -1298,6 +1350,10 @@ Status XlaCompiler::CompileGraph(
       options.alias_resource_update, &builder, result->computation.get(),
       &num_computation_outputs, &num_nonconst_outputs, &result->outputs,
       &result->resource_updates, &result->xla_output_shape));
+  if (options_.alias_donated_params && options.is_entry_computation &&
+      !options.use_tuple_arg) {
+    TF_RETURN_IF_ERROR(AliasOutputsWithSameShapedParameters(real_args, result));
+  }
 
   VLOG(2) << "Outputs: total: " << context->retvals().size()
           << " nonconstant: " << num_nonconst_outputs;
@@ -175,6 +175,11 @@ class XlaCompiler {
     // Whether this argument will receive the same data across all replicas.
     bool is_same_data_across_replicas = false;
 
+    // For a kParameter, whether the caller may donate its buffer at run time.
+    // With Options::alias_donated_params, only such parameters may alias an
+    // output.
+    bool may_donate = false;
+
     bool operator==(const Argument& other) const;
 
     // Returns a human-readable summary of the argument.
@@ -352,6 +357,13 @@ class XlaCompiler {
     // Alias input and output buffers for parameters that are passed-through XLA
     // modules without being changed.
     bool alias_passthrough_params = false;
+
+    // Alias each array output of an entry computation with a distinct
+    // parameter argument of the same shape whose `may_donate` is set, as a
+    // may-alias pair. The output is then computed in place in the parameter
+    // buffer if the caller donates that buffer at run time, and in a copy of
+    // the parameter otherwise.
+    bool alias_donated_params = false;
   };
 
   explicit XlaCompiler(Options options);
@@ -35,6 +35,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/literal.h"
 #include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_input_output_alias_config.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/compiler/xla/tests/literal_test_util.h"
@@ -236,9 +237,68 @@ TEST_F(XlaCompilerTest, Simple) {
   EXPECT_TRUE(xla::LiteralTestUtil::Equal(expected_literal, actual_literal));
 }
 
+// Tests that with alias_donated_params, each output may alias the first
+// unaliased parameter of the same shape that may be donated.
+TEST_F(XlaCompilerTest, AliasDonatedParams) {
+  Scope scope = Scope::NewRootScope().ExitOnError();
+  auto a = ops::_Arg(scope.WithOpName("A"), DT_INT32, 0);
+  auto b = ops::_Arg(scope.WithOpName("B"), DT_INT32, 1);
+  auto c = ops::Add(scope.WithOpName("C"), a, a);
+  auto d = ops::Neg(scope.WithOpName("D"), a);
+  auto e = ops::Neg(scope.WithOpName("E"), b);
+  auto f = ops::_Retval(scope.WithOpName("F"), c, 0);
+  auto g = ops::_Retval(scope.WithOpName("G"), d, 1);
+  auto h = ops::_Retval(scope.WithOpName("H"), e, 2);
+  auto i = ops::_Arg(scope.WithOpName("I"), DT_INT32, 2);
+  auto j = ops::Neg(scope.WithOpName("J"), i);
+  auto k = ops::_Retval(scope.WithOpName("K"), j, 3);
+  std::unique_ptr<Graph> graph(new Graph(OpRegistry::Global()));
+  TF_ASSERT_OK(scope.ToGraph(graph.get()));
+
+  std::vector<XlaCompiler::Argument> args(3);
+  args[0].kind = XlaCompiler::Argument::kParameter;
+  args[0].type = DT_INT32;
+  args[0].shape = TensorShape({2});
+  args[0].may_donate = true;
+  args[1].kind = XlaCompiler::Argument::kParameter;
+  args[1].type = DT_INT32;
+  args[1].shape = TensorShape({3});
+  args[1].may_donate = true;
+  args[2].kind = XlaCompiler::Argument::kParameter;
+  args[2].type = DT_INT32;
+  args[2].shape = TensorShape({3});
+
+  XlaCompiler::Options options = DefaultOptions();
+  options.alias_donated_params = true;
+  XlaCompiler compiler(options);
+
+  XlaCompiler::CompilationResult result;
+  TF_ASSERT_OK(compiler.CompileGraph(XlaCompiler::CompileOptions(), "alias",
+                                     std::move(graph), args, &result));
+
+  TF_ASSERT_OK_AND_ASSIGN(
+      xla::HloInputOutputAliasConfig config,
+      xla::HloInputOutputAliasConfig::CreateFromProto(
+          result.xla_output_shape,
+          result.computation->proto().input_output_alias()));
+  absl::optional<xla::HloInputOutputAliasConfig::Alias> alias =
+      config.GetAliasedParameter({0});
+  ASSERT_TRUE(alias.has_value());
+  EXPECT_EQ(alias->parameter_number, 0);
+  EXPECT_EQ(alias->kind, xla::HloInputOutputAliasConfig::kSystemAlias);
+  // Parameter 0 is already aliased with output 0.
+  EXPECT_FALSE(config.OutputHasAlias({1}));
+  alias = config.GetAliasedParameter({2});
+  ASSERT_TRUE(alias.has_value());
+  EXPECT_EQ(alias->parameter_number, 1);
+  // Parameter 1 is already aliased, and parameter 2 may not be donated.
+  EXPECT_FALSE(config.OutputHasAlias({3}));
+}
+
 // Tests compilation of a graph where the _Retval node is not necessarily last
 // amongst the graph nodes in construction order, and always_return_tuple is
 // false. Regression test for bug where the wrong value was returned.
+
 TEST_F(XlaCompilerTest, OutOfOrderGraph) {
   Scope scope = Scope::NewRootScope().ExitOnError();
   auto a = ops::_Arg(scope.WithOpName("A"), DT_INT32, 0);
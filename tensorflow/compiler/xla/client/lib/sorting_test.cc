@@ -16,7 +16,9 @@ limitations under the License.
 #include "tensorflow/compiler/xla/client/lib/sorting.h"
 
 #include <limits>
+#include <numeric>
 
+#include "tensorflow/compiler/xla/array2d.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/test.h"
 #include "tensorflow/compiler/xla/tests/client_library_test_base.h"
@@ -76,6 +78,56 @@ XLA_TEST_F(SortingTest, TopKFullSortWithDuplicates) {
   ComputeAndCompareR1<int>(&builder, {2, 3, 0, 1, 4}, {a_data.get()});
 }
 
+XLA_TEST_F(SortingTest, TopK10From100000WithDuplicates) {
+  XlaBuilder builder(TestName());
+  const int kSize = 100000;
+  std::vector<int> inputs(kSize);
+  for (int i = 0; i < kSize; ++i) {
+    inputs[i] = (i * 7919) % 1000;
+  }
+  XlaOp a;
+  auto a_data = CreateR1Parameter<int>(inputs, 0, "a", &builder, &a);
+  xla::GetTupleElement(xla::TopK(a, 10), 1);
+
+  // The indices of equal values are in ascending order.
+  std::vector<int> indices(kSize);
+  std::iota(indices.begin(), indices.end(), 0);
+  std::stable_sort(indices.begin(), indices.end(),
+                   [&](int lhs, int rhs) { return inputs[lhs] > inputs[rhs]; });
+  indices.resize(10);
+  ComputeAndCompareR1<int>(&builder, indices, {a_data.get()});
+}
+
+XLA_TEST_F(SortingTest, TopKFullSortOfManyRows) {
+  XlaBuilder builder(TestName());
+  const int kRows = 4;
+  const int kSize = 50000;
+  std::mt19937 eng;
+  std::uniform_real_distribution<float> u_dist(0.0, 100.0);
+  Array2D<float> inputs(kRows, kSize);
+  for (int row = 0; row < kRows; ++row) {
+    for (int i = 0; i < kSize; ++i) {
+      inputs(row, i) = u_dist(eng);
+    }
+  }
+  XlaOp a;
+  auto a_data = CreateR2Parameter<float>(inputs, 0, "a", &builder, &a);
+  xla::GetTupleElement(xla::TopK(a, kSize), 0);
+
+  Array2D<float> expected(kRows, kSize);
+  for (int row = 0; row < kRows; ++row) {
+    std::vector<float> values(kSize);
+    for (int i = 0; i < kSize; ++i) {
+      values[i] = inputs(row, i);
+    }
+    absl::c_sort(values, std::greater<float>());
+    for (int i = 0; i < kSize; ++i) {
+      expected(row, i) = values[i];
+    }
+  }
+  ComputeAndCompareR2<float>(&builder, expected, {a_data.get()});
+}
+
 XLA_TEST_F(SortingTest, TopK3From8Values2Partitions) {
   XlaBuilder builder(TestName());
   auto x =
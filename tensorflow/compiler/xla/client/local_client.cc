@@ -178,10 +178,24 @@ StatusOr<ScopedShapedBuffer> LocalExecutable::Run(
   }
   TF_ASSIGN_OR_RETURN(auto options_and_stream,
                       RunHelper(argument_shapes, run_options));
-  ExecutableRunOptions options = options_and_stream.first.run_options();
-  options.set_device_ordinal(-1);
-  auto result = RunAsync(arguments, options);
-  Status block_status = options.stream()->BlockHostUntilDone();
+  auto result =
+      RunAsyncWithValidatedOptions(arguments, options_and_stream.first);
+  Status block_status =
+      options_and_stream.first.stream()->BlockHostUntilDone();
+  TF_RETURN_IF_ERROR(result.status());
+  TF_RETURN_IF_ERROR(block_status);
+  return result;
+}
+
+StatusOr<ExecutionOutput> LocalExecutable::Run(
+    absl::Span<Shape const* const> argument_host_shapes,
+    std::vector<ExecutionInput> arguments, ExecutableRunOptions run_options) {
+  TF_ASSIGN_OR_RETURN(auto options_and_stream,
+                      RunHelper(argument_host_shapes, run_options));
+  auto result = RunAsyncWithValidatedOptions(
+      argument_host_shapes, std::move(arguments), options_and_stream.first);
+  Status block_status =
+      options_and_stream.first.stream()->BlockHostUntilDone();
   TF_RETURN_IF_ERROR(result.status());
   TF_RETURN_IF_ERROR(block_status);
   return result;
@@ -238,6 +252,12 @@ StatusOr<ScopedShapedBuffer> LocalExecutable::RunAsync(
   }
   TF_ASSIGN_OR_RETURN(auto options_and_stream,
                       RunHelper(argument_shapes, run_options));
+  return RunAsyncWithValidatedOptions(arguments, options_and_stream.first);
+}
+
+StatusOr<ScopedShapedBuffer> LocalExecutable::RunAsyncWithValidatedOptions(
+    const absl::Span<const ShapedBuffer* const> arguments,
+    const ServiceExecutableRunOptions& run_options) {
   se::Stream* stream = run_options.stream();
 
   std::shared_ptr<HloSnapshot> snapshot;
@@ -245,9 +265,9 @@ StatusOr<ScopedShapedBuffer> LocalExecutable::RunAsync(
     snapshot = DumpArguments(backend_, executable_.get(), arguments, stream);
   }
 
-  TF_ASSIGN_OR_RETURN(ScopedShapedBuffer outputs,
-                      executable_->ExecuteAsyncOnStreamWrapper(
-                          &options_and_stream.first, arguments));
+  TF_ASSIGN_OR_RETURN(
+      ScopedShapedBuffer outputs,
+      executable_->ExecuteAsyncOnStreamWrapper(&run_options, arguments));
 
   // Transfer the outputs and save the snapshot to disk.
   if (snapshot) {
@@ -272,14 +292,22 @@ static ShapedBuffer MaybeOwningShapeTreeToShapedBuffer(
 StatusOr<ExecutionOutput> LocalExecutable::RunAsync(
     absl::Span<Shape const* const> argument_host_shapes,
     std::vector<ExecutionInput> arguments, ExecutableRunOptions run_options) {
+  TF_ASSIGN_OR_RETURN(auto options_and_stream,
+                      RunHelper(argument_host_shapes, run_options));
+  return RunAsyncWithValidatedOptions(
+      argument_host_shapes, std::move(arguments), options_and_stream.first);
+}
+
+StatusOr<ExecutionOutput> LocalExecutable::RunAsyncWithValidatedOptions(
+    absl::Span<Shape const* const> argument_host_shapes,
+    std::vector<ExecutionInput> arguments,
+    const ServiceExecutableRunOptions& run_options) {
   if (argument_host_shapes.size() != arguments.size()) {
     return InvalidArgument(
         "Number of argument host shapes not equal to number of arguments (%d "
         "vs %d)",
         argument_host_shapes.size(), arguments.size());
   }
-  TF_ASSIGN_OR_RETURN(auto options_and_stream,
-                      RunHelper(argument_host_shapes, run_options));
   se::Stream* stream = run_options.stream();
 
   std::shared_ptr<HloSnapshot> snapshot;
@@ -301,7 +329,7 @@ StatusOr<ExecutionOutput> LocalExecutable::RunAsync(
 
   TF_ASSIGN_OR_RETURN(ExecutionOutput outputs,
                       executable_->ExecuteAsyncOnStreamWrapper(
-                          &options_and_stream.first, std::move(arguments)));
+                          &run_options, std::move(arguments)));
 
   // Transfer the outputs and save the snapshot to disk.
   if (snapshot) {
@@ -57,6 +57,12 @@ class LocalExecutable {
       const absl::Span<const ShapedBuffer* const> arguments,
       ExecutableRunOptions run_options);
 
+  // Similar to Run(), but allows for donating argument buffers to the
+  // executable.
+  StatusOr<ExecutionOutput> Run(
+      absl::Span<Shape const* const> argument_host_shapes,
+      std::vector<ExecutionInput> arguments, ExecutableRunOptions run_options);
+
   // Similar to RunAsync(), but allows for donating argument buffers to the
   // executable.
   StatusOr<ExecutionOutput> RunAsync(
@@ -85,6 +91,16 @@ class LocalExecutable {
       const absl::Span<const Shape* const> argument_shapes,
       ExecutableRunOptions run_options);
 
+  // Implementations of RunAsync() that take the options returned by
+  // RunHelper(), so that Run() validates its arguments and options only once.
+  StatusOr<ScopedShapedBuffer> RunAsyncWithValidatedOptions(
+      const absl::Span<const ShapedBuffer* const> arguments,
+      const ServiceExecutableRunOptions& run_options);
+  StatusOr<ExecutionOutput> RunAsyncWithValidatedOptions(
+      absl::Span<Shape const* const> argument_host_shapes,
+      std::vector<ExecutionInput> arguments,
+      const ServiceExecutableRunOptions& run_options);
+
   // The ordinal of the device which this executable was compiled for. The
   // executable can run on all equivalent devices (as determined by
   // Backend::devices_equivalent).
@@ -73,6 +73,8 @@ DebugOptions DefaultDebugOptionsIgnoringFlags() {
   opts.set_xla_gpu_deterministic_reductions(false);
   opts.set_xla_cpu_enable_xprof_traceme(true);
   opts.set_xla_gpu_unsafe_fallback_to_driver_on_ptxas_not_found(false);
+  opts.set_xla_cpu_persistent_cache_max_size_bytes(1LL << 30);
+  opts.set_xla_cpu_parallel_codegen_split_count(1);
 
   return opts;
 }
@@ -137,6 +139,13 @@ static void AllocateFlags() {
     };
   };
 
+  auto int64_setter_for = [](void (DebugOptions::*member_setter)(int64)) {
+    return [member_setter](int64 value) {
+      (flag_values->*member_setter)(value);
+      return true;
+    };
+  };
+
   auto string_setter_for =
       [](void (DebugOptions::*member_setter)(const string& value)) {
         return [member_setter](const string& value) {
@@ -571,6 +580,68 @@ static void AllocateFlags() {
       "that falling back to the driver can have drawbacks like using more "
       "memory and/or other bugs during compilation, so we recommend setting "
       "this flag to false."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_persistent_cache_dir",
+      string_setter_for(&DebugOptions::set_xla_cpu_persistent_cache_dir),
+      flag_values->xla_cpu_persistent_cache_dir(),
+      "Directory where XLA:CPU persists the machine code it compiles, to be "
+      "reused by later compilations of the same modules, including by other "
+      "processes. Disabled if empty."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_persistent_cache_max_size_bytes",
+      int64_setter_for(
+          &DebugOptions::set_xla_cpu_persistent_cache_max_size_bytes),
+      flag_values->xla_cpu_persistent_cache_max_size_bytes(),
+      "Size above which the least recently written entries of "
+      "xla_cpu_persistent_cache_dir are deleted."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_parallel_codegen_split_count",
+      int32_setter_for(&DebugOptions::set_xla_cpu_parallel_codegen_split_count),
+      flag_values->xla_cpu_parallel_codegen_split_count(),
+      "Number of LLVM modules the IR of an XLA:CPU module is split into, to "
+      "be optimized and compiled concurrently. 1 disables the splitting."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_parallel_task_core_gflops",
+      int32_setter_for(&DebugOptions::set_xla_cpu_parallel_task_core_gflops),
+      flag_values->xla_cpu_parallel_task_core_gflops(),
+      "Arithmetic throughput of one core in GFLOP/s, which the XLA:CPU cost "
+      "model for parallel tasks uses. 0 uses a default."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_parallel_task_core_memory_bandwidth_gbs",
+      int32_setter_for(
+          &DebugOptions::set_xla_cpu_parallel_task_core_memory_bandwidth_gbs),
+      flag_values->xla_cpu_parallel_task_core_memory_bandwidth_gbs(),
+      "Memory bandwidth of one core in GB/s, which the XLA:CPU cost model for "
+      "parallel tasks uses. 0 uses a default."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_parallel_task_memory_bandwidth_gbs",
+      int32_setter_for(
+          &DebugOptions::set_xla_cpu_parallel_task_memory_bandwidth_gbs),
+      flag_values->xla_cpu_parallel_task_memory_bandwidth_gbs(),
+      "Memory bandwidth of the whole host in GB/s, which caps the parallel "
+      "speedup of memory bound instructions. 0 means it scales with the "
+      "number of cores."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_parallel_task_legacy_cost_model",
+      bool_setter_for(
+          &DebugOptions::set_xla_cpu_parallel_task_legacy_cost_model),
+      flag_values->xla_cpu_parallel_task_legacy_cost_model(),
+      "Splits XLA:CPU instructions into parallel tasks with the flops per "
+      "byte heuristic instead of the throughput cost model."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_packed_gemm_max_dimension",
+      int32_setter_for(&DebugOptions::set_xla_cpu_packed_gemm_max_dimension),
+      flag_values->xla_cpu_packed_gemm_max_dimension(),
+      "Lowers XLA:CPU matrix-matrix dots whose dimensions are at most this "
+      "size to a packed GEMM in LLVM IR instead of calling Eigen. 0 disables "
+      "this."));
+  flag_objects->push_back(tensorflow::Flag(
+      "xla_cpu_fusion_profile_path",
+      string_setter_for(&DebugOptions::set_xla_cpu_fusion_profile_path),
+      flag_values->xla_cpu_fusion_profile_path(),
+      "File that XLA:CPU records the measured cycles of HLO instructions in "
+      "when xla_hlo_profile is set, and reads back to tune fusion and "
+      "parallel task assignment. Disabled if empty."));
   ParseFlagsFromEnvAndDieIfUnknown("XLA_FLAGS", *flag_objects);
 }
 
@@ -186,6 +186,13 @@ StatusOr<bool> Backend::devices_equivalent(int device_ordinal_a,
   // bit crude but works for GPUs which is the important case where we compile
   // an executable for one GPU and want to know if it will run (well) on
   // another.
+  //
+  // Executables almost always run on the device they were built for, so that
+  // case skips looking up the device descriptions.
+  if (device_ordinal_a == device_ordinal_b) {
+    TF_RETURN_IF_ERROR(stream_executor(device_ordinal_a).status());
+    return true;
+  }
   TF_ASSIGN_OR_RETURN(se::StreamExecutor * executor_a,
                       stream_executor(device_ordinal_a));
   TF_ASSIGN_OR_RETURN(se::StreamExecutor * executor_b,
@@ -18,7 +18,10 @@ limitations under the License.
 #include <stddef.h>
 #include <string.h>
 
+#include <algorithm>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -29,6 +32,7 @@ limitations under the License.
 #include "absl/base/call_once.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/optional.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/IR/Function.h"
@@ -38,6 +42,7 @@ limitations under the License.
 #include "llvm/IR/Verifier.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
@@ -66,9 +71,12 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/cpu/cpu_layout_assignment.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
+#include "tensorflow/compiler/xla/service/cpu/fusion_profile.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/ir_emitter.h"
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
+#include "tensorflow/compiler/xla/service/cpu/partial_sort_assignment.h"
+#include "tensorflow/compiler/xla/service/cpu/persistent_compilation_cache.h"
 #include "tensorflow/compiler/xla/service/cpu/simple_orc_jit.h"
 #include "tensorflow/compiler/xla/service/dfs_hlo_visitor_with_default.h"
 #include "tensorflow/compiler/xla/service/dot_decomposer.h"
@@ -115,7 +123,12 @@ limitations under the License.
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/compiler/xla/xla_data.pb.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/dynamic_annotations.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace xla {
 namespace cpu {
@@ -240,7 +253,8 @@ class CollectProfileCandidates : public DfsHloVisitorWithDefault {
 
 Status CpuCompiler::RunHloPassesThroughLayoutAssn(
     HloModule* module, bool /*is_aot_compile*/,
-    LLVMTargetMachineFeatures* target_machine_features) {
+    LLVMTargetMachineFeatures* target_machine_features,
+    const FusionProfile* fusion_profile) {
   HloPassPipeline pipeline("HLO passes through layout assignment");
   pipeline.AddInvariantChecker<HloVerifier>(/*layout_sensitive=*/false,
                                             /*allow_mixed_precision=*/false);
@@ -334,14 +348,15 @@ Status CpuCompiler::RunHloPassesThroughLayoutAssn(
       module->mutable_entry_computation_layout(),
       LayoutAssignment::InstructionCanChangeLayout, target_machine_features);
 
-  pipeline.AddPass<CpuInstructionFusion>();
+  pipeline.AddPass<CpuInstructionFusion>(fusion_profile);
 
   return pipeline.Run(module).status();
 }
 
 Status CpuCompiler::RunHloPassesAfterLayoutAssn(
     HloModule* module, bool is_aot_compile,
-    LLVMTargetMachineFeatures* target_machine_features) {
+    LLVMTargetMachineFeatures* target_machine_features,
+    const FusionProfile* fusion_profile) {
   HloPassPipeline pipeline("HLO passes after layout assignment");
   // After layout assignment, use a layout-sensitive verifier.
 
@@ -381,7 +396,8 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
     // binary size (and most AOT applications are single-threaded).
     // TODO(b/29630486) Support multi-threaded AOT.
     pipeline.AddPass<ParallelTaskAssigner>(
-        max_parallelism, ShapeSizeBytesFunction(), target_machine_features);
+        max_parallelism, ShapeSizeBytesFunction(), target_machine_features,
+        fusion_profile);
   }
   // Copy insertion should be performed immediately before IR emission to
   // avoid inserting unnecessary copies (later pass adds an instruction which
@@ -392,16 +408,36 @@ Status CpuCompiler::RunHloPassesAfterLayoutAssn(
   pipeline.AddPass<HloDCE>();
   pipeline.AddPass<CopyInsertion>();
   pipeline.AddPass<HloDCE>();
+  // Only annotates sorts, so it runs last to see the final users of each sort.
+  pipeline.AddPass<PartialSortAssignment>();
   return pipeline.Run(module).status();
 }
 
 Status CpuCompiler::RunHloPasses(HloModule* module, bool is_aot_compile,
                                  llvm::TargetMachine* target_machine) {
   LLVMTargetMachineFeatures target_machine_features(target_machine);
-  TF_RETURN_IF_ERROR(RunHloPassesThroughLayoutAssn(module, is_aot_compile,
-                                                   &target_machine_features));
+  // The profile only tunes performance, so compilation goes on without it if
+  // it can't be read.
+  absl::optional<FusionProfile> fusion_profile;
+  const string& fusion_profile_path =
+      module->config().debug_options().xla_cpu_fusion_profile_path();
+  if (!fusion_profile_path.empty()) {
+    StatusOr<FusionProfile> loaded = FusionProfile::Load(fusion_profile_path);
+    if (loaded.ok()) {
+      fusion_profile = std::move(loaded).ValueOrDie();
+    } else {
+      LOG(WARNING) << "Ignoring XLA:CPU fusion profile " << fusion_profile_path
+                   << ": " << loaded.status();
+    }
+  }
+  const FusionProfile* fusion_profile_ptr =
+      fusion_profile.has_value() && !fusion_profile->empty() ? &*fusion_profile
+                                                             : nullptr;
+  TF_RETURN_IF_ERROR(RunHloPassesThroughLayoutAssn(
+      module, is_aot_compile, &target_machine_features, fusion_profile_ptr));
   return RunHloPassesAfterLayoutAssn(module, is_aot_compile,
-                                     &target_machine_features);
+                                     &target_machine_features,
+                                     fusion_profile_ptr);
 }
 
 namespace {
@@ -589,6 +625,65 @@ struct OrcJITPostCompilationHook {
   const HloModule* module;
 };
 
+// The object files compiled for a module, possibly from several threads.
+struct CompiledObjectFiles {
+  tensorflow::mutex mu;
+  std::vector<string> files TF_GUARDED_BY(mu);
+};
+
+// Adds the machine code stored under 'key' in 'cache' to 'jit' and returns the
+// name of its entry function, or nullopt if there is no entry usable for the
+// buffer assignment whose fingerprint is 'buffer_assignment_fingerprint'.
+absl::optional<string> LoadFromPersistentCache(
+    PersistentCompilationCache* cache, const string& key,
+    uint64 buffer_assignment_fingerprint, SimpleOrcJIT* jit) {
+  absl::optional<CompilationCacheEntryProto> entry = cache->Lookup(key);
+  if (!entry) {
+    return absl::nullopt;
+  }
+  if (entry->buffer_assignment_fingerprint() != buffer_assignment_fingerprint) {
+    LOG(WARNING) << "Recompiling " << key << " from " << cache->directory()
+                 << " whose buffer assignment changed.";
+    return absl::nullopt;
+  }
+
+  std::vector<SimpleOrcJIT::VModuleKeyT> module_keys;
+  auto add_object_files = [&]() -> llvm::Error {
+    for (const string& object_file : entry->object_files()) {
+      llvm::Expected<SimpleOrcJIT::VModuleKeyT> module_key =
+          jit->AddObjectFile(llvm::MemoryBuffer::getMemBufferCopy(
+              object_file, entry->entry_function_name()));
+      if (!module_key) {
+        return module_key.takeError();
+      }
+      module_keys.push_back(*module_key);
+    }
+    // Link the objects now, rather than when the executable is created, so
+    // that code that can't be linked in this process is recompiled.
+    llvm::JITSymbol symbol =
+        jit->FindCompiledSymbol(entry->entry_function_name());
+    if (llvm::Error error = symbol.takeError()) {
+      return error;
+    }
+    if (!symbol) {
+      return llvm::make_error<llvm::StringError>(
+          "Symbol " + entry->entry_function_name() + " not found",
+          llvm::inconvertibleErrorCode());
+    }
+    return symbol.getAddress().takeError();
+  };
+  if (llvm::Error error = add_object_files()) {
+    LOG(WARNING) << "Deleting " << key << " from " << cache->directory()
+                 << ": " << llvm::toString(std::move(error));
+    for (SimpleOrcJIT::VModuleKeyT module_key : module_keys) {
+      jit->RemoveModule(module_key);
+    }
+    cache->Remove(key);
+    return absl::nullopt;
+  }
+  return entry->entry_function_name();
+}
+
 }  // namespace
 
 StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
@@ -616,14 +711,59 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
       mlir_context.getRegisteredDialect<mlir::LLVM::LLVMDialect>()
           ->getLLVMContext());
 
+  // Cache these flags here since we'll want to access them after the module's
+  // ownership is std::moved.
+  const bool embed_ir_in_executable =
+      module->config().debug_options().xla_embed_ir_in_executable();
+
+  // The persistent cache only holds machine code, so it is skipped when the
+  // IR is observed, or the executable needs the profile counters of the
+  // instructions.
+  const string& persistent_cache_dir =
+      module->config().debug_options().xla_cpu_persistent_cache_dir();
+  std::unique_ptr<PersistentCompilationCache> persistent_cache;
+  if (!persistent_cache_dir.empty() && !embed_ir_in_executable &&
+      !module->config().hlo_profiling_enabled() &&
+      !user_pre_optimization_hook_ && !user_post_optimization_hook_) {
+    persistent_cache = absl::make_unique<PersistentCompilationCache>(
+        persistent_cache_dir, module->config()
+                                  .debug_options()
+                                  .xla_cpu_persistent_cache_max_size_bytes());
+  }
+
+  // The parts of a module whose code is generated in parallel are optimized
+  // separately, so this is skipped when the IR of the whole module is
+  // observed.
+  const int parallel_codegen_split_count =
+      DumpingEnabledForHloModule(*module) || user_pre_optimization_hook_ ||
+              user_post_optimization_hook_
+          ? 1
+          : module->config()
+                .debug_options()
+                .xla_cpu_parallel_codegen_split_count();
+
+  // Receives the object files of the module, to be stored in the persistent
+  // cache. Parts of the module may be compiled concurrently.
+  auto object_files = std::make_shared<CompiledObjectFiles>();
+  std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook =
+      OrcJITPostCompilationHook::Create(module.get());
+  if (persistent_cache != nullptr) {
+    post_codegen_hook = [post_codegen_hook, object_files](
+                            const llvm::object::ObjectFile& obj_file) {
+      post_codegen_hook(obj_file);
+      tensorflow::mutex_lock lock(object_files->mu);
+      object_files->files.emplace_back(obj_file.getData().data(),
+                                       obj_file.getData().size());
+    };
+  }
+
   auto jit = absl::make_unique<SimpleOrcJIT>(
       CompilerTargetOptions(module->config()),
       CodeGenOptLevel(module->config()),
       options::OptimizeForSizeRequested(module->config()),
       module->config().debug_options().xla_llvm_disable_expensive_passes(),
       llvm_ir::GetCpuFastMathFlags(module->config()), pre_optimization_ir_hook,
-      post_optimization_ir_hook,
-      OrcJITPostCompilationHook::Create(module.get()));
+      post_optimization_ir_hook, std::move(post_codegen_hook));
   llvm_module->setDataLayout(jit->data_layout());
   llvm_module->setTargetTriple(jit->target_triple().getTriple());
 
@@ -640,11 +780,6 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
 
   std::unique_ptr<Executable> cpu_executable;
 
-  // Cache these flags here since we'll want to access them after the module's
-  // ownership is std::moved.
-  const bool embed_ir_in_executable =
-      module->config().debug_options().xla_embed_ir_in_executable();
-
   // Select an order for emitting the HLO instructions for each
   // computation. Using this sequence enables tighter buffer liveness analysis
   // and reduced memory usage (as compared to using DependencyHloOrdering).
@@ -662,6 +797,29 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
                           /*allocate_buffers_for_constants=*/true));
   DumpHloModuleIfEnabled(*module, *assignment, "after_optimizations");
 
+  // Reuse the machine code of a previous compilation of the same module,
+  // possibly by another process, which skips IR emission and LLVM.
+  string persistent_cache_key;
+  uint64 buffer_assignment_fingerprint = 0;
+  if (persistent_cache != nullptr) {
+    persistent_cache_key = PersistentCompilationCache::ComputeKey(
+        *module, *jit->target_machine());
+    buffer_assignment_fingerprint =
+        PersistentCompilationCache::FingerprintBufferAssignment(*assignment);
+    absl::optional<string> cached_function_name = LoadFromPersistentCache(
+        persistent_cache.get(), persistent_cache_key,
+        buffer_assignment_fingerprint, jit.get());
+    if (cached_function_name) {
+      VLOG(1) << "Loaded " << module->name() << " from "
+              << persistent_cache->directory();
+      cpu_executable.reset(new CpuExecutable(
+          std::move(jit), std::move(assignment), std::move(module),
+          *cached_function_name, std::move(hlo_profile_printer_data),
+          std::move(hlo_profile_index_map)));
+      return std::move(cpu_executable);
+    }
+  }
+
   // Each computation is a single function.  Emit all embedded computations
   // before the entry computation. The order of computations returned from
   // GetEmbeddedComputations guarantees that a called computation occurs
@@ -718,7 +876,34 @@ StatusOr<std::unique_ptr<Executable>> CpuCompiler::RunBackend(
   TF_RETURN_IF_ERROR(VerifyLlvmModule(*llvm_module));
 
   // JIT compile the LLVM IR module to in-memory machine code.
-  jit->AddModule(std::move(llvm_module));
+  if (parallel_codegen_split_count > 1) {
+    tensorflow::thread::ThreadPool thread_pool(
+        tensorflow::Env::Default(), "xla_cpu_parallel_codegen",
+        std::min(parallel_codegen_split_count,
+                 tensorflow::port::MaxParallelism()));
+    jit->AddModuleInParallel(std::move(llvm_module),
+                             parallel_codegen_split_count, &thread_pool);
+  } else {
+    jit->AddModule(std::move(llvm_module));
+  }
+
+  if (persistent_cache != nullptr) {
+    CompilationCacheEntryProto entry;
+    entry.set_key(persistent_cache_key);
+    entry.set_entry_function_name(function_name);
+    {
+      tensorflow::mutex_lock lock(object_files->mu);
+      for (string& object_file : object_files->files) {
+        entry.add_object_files(std::move(object_file));
+      }
+    }
+    entry.set_buffer_assignment_fingerprint(buffer_assignment_fingerprint);
+    Status status = persistent_cache->Insert(entry);
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to store " << module->name() << " in "
+                   << persistent_cache->directory() << ": " << status;
+    }
+  }
   cpu_executable.reset(new CpuExecutable(
       std::move(jit), std::move(assignment), std::move(module), function_name,
       std::move(hlo_profile_printer_data), std::move(hlo_profile_index_map)));
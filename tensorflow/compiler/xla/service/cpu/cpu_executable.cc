@@ -23,6 +23,8 @@ limitations under the License.
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
@@ -30,6 +32,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/computation_layout.h"
 #include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_input_output_alias_config.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/logical_buffer.h"
 #include "tensorflow/compiler/xla/service/maybe_owning_device_memory.h"
@@ -73,6 +76,38 @@ CpuExecutable::CpuExecutable(
       reinterpret_cast<ComputeFunctionType>(cantFail(sym.getAddress()));
   VLOG(1) << "compute_function_ at address "
           << reinterpret_cast<void*>(compute_function_);
+  result_slices_status_ = ComputeResultSlices();
+  if (has_module()) {
+    const string& fusion_profile_path =
+        module().config().debug_options().xla_cpu_fusion_profile_path();
+    if (!fusion_profile_path.empty()) {
+      fusion_profile_recorder_ = absl::make_unique<FusionProfileRecorder>(
+          fusion_profile_path, &module());
+    }
+  }
+}
+
+Status CpuExecutable::ComputeResultSlices() {
+  if (GetRootValueSet().IsAmbiguous()) {
+    return Unimplemented("Points-to set of root instruction is ambiguous");
+  }
+  TF_ASSIGN_OR_RETURN(result_slice_,
+                      assignment_->GetUniqueTopLevelOutputSlice());
+  result_slices_ = ShapeTree<BufferAllocation::Slice>(result_shape());
+  for (auto& p : result_slices_) {
+    const HloValueSet& sources = GetRootValueSet().element(p.first);
+    // The points to set is unambiguous so the set should be a
+    // singleton.
+    CHECK_EQ(1, sources.values().size());
+    const HloValue* value_source = sources.values()[0];
+    // The source for this result buffer can be a nested buffer such as
+    // a tuple element. The source instruction should have a
+    // non-parameter buffer assigned.
+    TF_ASSIGN_OR_RETURN(p.second,
+                        assignment_->GetUniqueSlice(value_source->instruction(),
+                                                    value_source->index()));
+  }
+  return Status::OK();
 }
 
 static StatusOr<MaybeOwningDeviceMemory> MemoryForAllocation(
@@ -126,9 +161,7 @@ StatusOr<std::vector<MaybeOwningDeviceMemory>> CpuExecutable::CreateBufferTable(
                                         device_ordinal));
   }
 
-  TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice result_slice,
-                      assignment_->GetUniqueTopLevelOutputSlice());
-  VLOG(3) << "result index: " << result_slice.index();
+  VLOG(3) << "result index: " << result_slice_.index();
   return std::move(buffers);
 }
 
@@ -165,9 +198,7 @@ Status CpuExecutable::ExecuteComputeFunction(
     buffer_pointers.push_back(
         const_cast<void*>(buffer.AsDeviceMemoryBase().opaque()));
   }
-  TF_ASSIGN_OR_RETURN(const BufferAllocation::Slice result_slice,
-                      assignment_->GetUniqueTopLevelOutputSlice());
-  void* result_buffer = buffer_pointers[result_slice.index()];
+  void* result_buffer = buffer_pointers[result_slice_.index()];
   if (VLOG_IS_ON(3)) {
     VLOG(3) << "Executing compute function:";
     VLOG(3) << absl::StrFormat(
@@ -205,10 +236,47 @@ Status CpuExecutable::ExecuteComputeFunction(
   return Status::OK();
 }
 
+Status CpuExecutable::CopyUndonatedAliasedArguments(
+    se::Stream* stream, se::DeviceMemoryAllocator* memory_allocator,
+    absl::Span<ExecutionInput> arguments,
+    std::vector<ShapeIndex>* copied_outputs) {
+  return module().input_output_alias_config().ForEachAliasWithStatus(
+      [&](const ShapeIndex& output_index,
+          const HloInputOutputAliasConfig::Alias& alias) -> Status {
+        // A user alias must alias, so the caller expects the computation to
+        // write into its buffer.
+        if (alias.kind != HloInputOutputAliasConfig::kSystemAlias) {
+          return Status::OK();
+        }
+        TF_RET_CHECK(alias.parameter_number < arguments.size());
+        MaybeOwningDeviceMemory* buffer =
+            arguments[alias.parameter_number].MutableBuffer(
+                alias.parameter_index);
+        se::DeviceMemoryBase argument_buffer = buffer->AsDeviceMemoryBase();
+        if (buffer->HasOwnership() || argument_buffer.size() == 0) {
+          return Status::OK();
+        }
+        VLOG(3) << "Copying undonated parameter " << alias.parameter_number
+                << " at shape index " << alias.parameter_index.ToString()
+                << " aliased with output " << output_index.ToString();
+        TF_ASSIGN_OR_RETURN(
+            se::OwningDeviceMemory copy,
+            memory_allocator->Allocate(stream->parent()->device_ordinal(),
+                                       argument_buffer.size()));
+        se::DeviceMemoryBase copy_buffer = *copy;
+        stream->ThenMemcpy(&copy_buffer, argument_buffer,
+                           argument_buffer.size());
+        *buffer = MaybeOwningDeviceMemory(std::move(copy));
+        copied_outputs->push_back(output_index);
+        return Status::OK();
+      });
+}
+
 StatusOr<ExecutionOutput> CpuExecutable::CreateResultShapedBuffer(
     const ServiceExecutableRunOptions* run_options,
     absl::Span<MaybeOwningDeviceMemory> buffers,
-    absl::Span<ExecutionInput> arguments) {
+    absl::Span<ExecutionInput> arguments,
+    absl::Span<const ShapeIndex> copied_outputs) {
   se::Stream* stream = run_options->stream();
   ExecutionOutput result(/*on_host_shape=*/result_shape(),
                          /*on_device_shape=*/result_shape(),
@@ -223,12 +291,6 @@ StatusOr<ExecutionOutput> CpuExecutable::CreateResultShapedBuffer(
   for (auto& p : result.MutableResult()->buffers()) {
     const ShapeIndex& index = p.first;
     se::DeviceMemoryBase& result_buffer = p.second;
-    const HloValueSet& sources = this->GetRootValueSet().element(index);
-    // The points to set is unambiguous so the set should be a
-    // singleton.
-    CHECK_EQ(1, sources.values().size());
-    const HloValue* value_source = sources.values()[0];
-    HloInstruction* src = value_source->instruction();
 
     // TODO(cheshire): duplication with other backends.
     absl::optional<HloInputOutputAliasConfig::Alias> alias =
@@ -247,28 +309,26 @@ StatusOr<ExecutionOutput> CpuExecutable::CreateResultShapedBuffer(
         se::DeviceMemoryBase argument_buffer = owning->Release();
         *maybe_owning_memory = argument_buffer;
         result_buffer = argument_buffer;
-        if (alias->kind == HloInputOutputAliasConfig::kUserAlias) {
-          // This is a user alias, so a must alias. The caller is giving us the
-          // input buffer, but in case of error of the execute call, we should
-          // not be releasing it as it contains valid data (for example, it is a
-          // parameter which the user wants us to alias, in a gradient update
-          // computation). So we store the index into the result in the aliased
-          // vactor, which will be fed to the ExecutionOutput, which will be
-          // using the indices to drop the addresses from its own
-          // ScopedShapedBuffer result, if the ExecutionOutput is not committed.
+        // The caller is giving us the input buffer, but in case of error of
+        // the execute call, we should not be releasing it as it contains
+        // valid data (for example, it is a parameter which the user wants us
+        // to alias, in a gradient update computation), or is still owned by
+        // the caller (for example, a donated TF tensor). This holds for user
+        // and system aliases alike. So we store the index into the result in
+        // the aliased vector, which will be fed to the ExecutionOutput, which
+        // will be using the indices to drop the addresses from its own
+        // ScopedShapedBuffer result, if the ExecutionOutput is not committed.
+        // Copies made by CopyUndonatedAliasedArguments() belong to us, and
+        // are released with the result.
+        if (!absl::c_linear_search(copied_outputs, index)) {
           result.AddAliasedIndex(index);
         }
       }
     }
 
     if (result_buffer.is_null()) {
-      // The source for this result buffer can be a nested buffer such as
-      // a tuple element. The source instruction should have a
-      // non-parameter buffer assigned.
-      TF_ASSIGN_OR_RETURN(
-          const BufferAllocation::Slice slice,
-          this->assignment_->GetUniqueSlice(src, value_source->index()));
-      const BufferAllocation::Index buffer_index = slice.index();
+      const BufferAllocation::Index buffer_index =
+          result_slices_.element(index).index();
       MaybeOwningDeviceMemory& buffer = buffers[buffer_index];
       if (absl::optional<se::OwningDeviceMemory> owned_buffer =
               buffer.Release()) {
@@ -287,9 +347,7 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
     const ServiceExecutableRunOptions* run_options,
     std::vector<ExecutionInput> arguments,
     HloExecutionProfile* hlo_execution_profile) {
-  if (GetRootValueSet().IsAmbiguous()) {
-    return Unimplemented("Points-to set of root instruction is ambiguous");
-  }
+  TF_RETURN_IF_ERROR(result_slices_status_);
 
   if (hlo_module_) {
     const HloComputation* entry_comp = hlo_module_->entry_computation();
@@ -312,6 +370,9 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
       run_options->stream()->implementation());
   se::Stream* stream = run_options->stream();
   se::DeviceMemoryAllocator* memory_allocator = run_options->allocator();
+  std::vector<ShapeIndex> copied_outputs;
+  TF_RETURN_IF_ERROR(CopyUndonatedAliasedArguments(
+      stream, memory_allocator, absl::MakeSpan(arguments), &copied_outputs));
   TF_ASSIGN_OR_RETURN(
       std::vector<MaybeOwningDeviceMemory> buffers,
       CreateBufferTable(memory_allocator, stream->parent()->device_ordinal(),
@@ -320,7 +381,7 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
   TF_ASSIGN_OR_RETURN(
       ExecutionOutput result,
       CreateResultShapedBuffer(run_options, absl::MakeSpan(buffers),
-                               absl::MakeSpan(arguments)));
+                               absl::MakeSpan(arguments), copied_outputs));
 
   // Logically we want this lambda to capture `buffers` by move, ultimately our
   // functor needs to be wrapped in an std::function, and that requires its
@@ -342,6 +403,11 @@ StatusOr<ExecutionOutput> CpuExecutable::ExecuteAsyncOnStream(
       // return a failed Status asynchronously.
       TF_CHECK_OK(executable->ExecuteComputeFunction(
           &run_options.run_options(), *task_buffers, hlo_execution_profile));
+      if (hlo_execution_profile != nullptr &&
+          executable->fusion_profile_recorder_ != nullptr) {
+        executable->fusion_profile_recorder_->AddExecutionProfile(
+            *hlo_execution_profile);
+      }
     }
   };
   host_stream->EnqueueTask(
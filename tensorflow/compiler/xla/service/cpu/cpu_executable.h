@@ -24,6 +24,7 @@ limitations under the License.
 
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
+#include "tensorflow/compiler/xla/service/cpu/fusion_profile.h"
 #include "tensorflow/compiler/xla/service/cpu/simple_orc_jit.h"
 #include "tensorflow/compiler/xla/service/executable.h"
 #include "tensorflow/compiler/xla/service/hlo_dataflow_analysis.h"
@@ -31,6 +32,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/shaped_buffer.h"
+#include "tensorflow/compiler/xla/shape_tree.h"
 #include "tensorflow/compiler/xla/statusor.h"
 #include "tensorflow/compiler/xla/types.h"
 #include "tensorflow/core/platform/macros.h"
@@ -105,6 +107,16 @@ class CpuExecutable : public Executable {
       se::DeviceMemoryAllocator* memory_allocator, int device_ordinal,
       absl::Span<ExecutionInput const> arguments);
 
+  // Replaces the arguments that may alias an output (kSystemAlias) but whose
+  // buffers were not donated by the caller with owned copies, so that the
+  // computation, which writes such outputs in place, leaves the caller's
+  // buffers unchanged. Appends the output indices of the copies to
+  // `copied_outputs`.
+  Status CopyUndonatedAliasedArguments(
+      se::Stream* stream, se::DeviceMemoryAllocator* memory_allocator,
+      absl::Span<ExecutionInput> arguments,
+      std::vector<ShapeIndex>* copied_outputs);
+
   // Calls the generated function performing the computation with the given
   // arguments using the supplied buffers.
   Status ExecuteComputeFunction(
@@ -115,16 +127,23 @@ class CpuExecutable : public Executable {
   // Creates an Execution output holding ScopedShapedBuffer for holding the
   // result of the computation, moving buffers out of allocated_buffers and into
   // the result as appropriate.  The addresses are set according to buffer
-  // assignment.
+  // assignment. Outputs that reuse a donated argument buffer are returned to
+  // the caller if execution fails, except those in `copied_outputs`, whose
+  // argument buffers are copies made by CopyUndonatedAliasedArguments().
   StatusOr<ExecutionOutput> CreateResultShapedBuffer(
       const ServiceExecutableRunOptions* run_options,
       absl::Span<MaybeOwningDeviceMemory> buffers,
-      absl::Span<ExecutionInput> arguments);
+      absl::Span<ExecutionInput> arguments,
+      absl::Span<const ShapeIndex> copied_outputs);
 
   // Returns the instruction value set of the root instruction of the entry
   // computation. Uses dataflow analysis from buffer assignment.
   const InstructionValueSet& GetRootValueSet() const;
 
+  // Looks up the slices that hold the result of the computation in the buffer
+  // assignment, and stores them in result_slice_ and result_slices_.
+  Status ComputeResultSlices();
+
   // The JIT containing compiled modules.
   const std::unique_ptr<SimpleOrcJIT> jit_;
 
@@ -139,9 +158,21 @@ class CpuExecutable : public Executable {
 
   ComputeFunctionType compute_function_;
 
+  // The slices that hold the result, which the constructor looks up once so
+  // that each run doesn't search the buffer assignment for them. If they
+  // can't be determined, e.g. because the points-to set of the root is
+  // ambiguous, result_slices_status_ is the error that runs fail with.
+  Status result_slices_status_;
+  BufferAllocation::Slice result_slice_;
+  ShapeTree<BufferAllocation::Slice> result_slices_;
+
   // Entry function name for the computation.
   const string entry_function_name_;
 
+  // Records the profiled runs in the fusion profile, if the module sets
+  // xla_cpu_fusion_profile_path.
+  std::unique_ptr<FusionProfileRecorder> fusion_profile_recorder_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(CpuExecutable);
 };
 
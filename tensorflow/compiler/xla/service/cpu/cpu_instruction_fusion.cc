@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/cpu/cpu_instruction_fusion.h"
 
+#include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/fusion_node_indexing_evaluation.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
 #include "tensorflow/compiler/xla/service/llvm_ir/fused_ir_emitter.h"
@@ -49,6 +50,16 @@ bool IsNonComplexNonBatchedMatrixVectorDot(const HloInstruction* hlo) {
          hlo->dot_dimension_numbers().lhs_batch_dimensions_size() == 0;
 }
 
+// Returns true if `hlo` is a matrix-matrix dot that is lowered to the packed
+// GEMM emitter, which can add an addend to the product.
+bool IsNonBatchedPackedGemmDot(const HloInstruction* hlo) {
+  return hlo->opcode() == HloOpcode::kDot &&
+         hlo->dot_dimension_numbers().lhs_batch_dimensions_size() == 0 &&
+         PotentiallyImplementedAsPackedLlvmIrGemm(
+             hlo->GetModule()->config(), hlo->operand(0)->shape(),
+             hlo->operand(1)->shape(), hlo->shape());
+}
+
 bool HasExactlyOneUse(const HloInstruction& hlo_instr) {
   return hlo_instr.user_count() == 1 &&
          absl::c_count(hlo_instr.users().front()->operands(), &hlo_instr) == 1;
@@ -57,7 +68,8 @@ bool HasExactlyOneUse(const HloInstruction& hlo_instr) {
 bool CanBeOutputFused(const HloInstruction* producer,
                       const HloInstruction* consumer) {
   return consumer->opcode() == HloOpcode::kAdd &&
-         IsNonComplexNonBatchedMatrixVectorDot(producer) &&
+         (IsNonComplexNonBatchedMatrixVectorDot(producer) ||
+          IsNonBatchedPackedGemmDot(producer)) &&
          HasExactlyOneUse(*producer) == 1;
 }
 
@@ -66,6 +78,31 @@ bool CanBeOutputFusedIntoSomeOperand(const HloInstruction* consumer) {
          (CanBeOutputFused(consumer->operand(0), consumer) ||
           CanBeOutputFused(consumer->operand(1), consumer));
 }
+
+// Returns true if `consumer` is, or is a loop fusion rooted at, a dot or
+// convolution that can be lowered to the int8 runtime kernels, and all its
+// operands are S8 to S32 converts that are or can be fused into `consumer`.
+// Fusing the converts lets the kernels read the S8 operands directly.
+bool IsInt8KernelConsumer(const HloInstruction* consumer) {
+  const HloInstruction* root = consumer;
+  if (consumer->opcode() == HloOpcode::kFusion) {
+    if (!consumer->IsLoopFusion()) {
+      return false;
+    }
+    root = consumer->fused_expression_root();
+  }
+  if (!PotentiallyImplementedAsInt8Kernel(*root)) {
+    return false;
+  }
+  return absl::c_all_of(root->operands(), [&](const HloInstruction* operand) {
+    if (operand->opcode() == HloOpcode::kParameter) {
+      operand = consumer->operand(operand->parameter_number());
+    }
+    return IsS8ToS32Convert(*operand) &&
+           LayoutUtil::IsMonotonicWithDim0Major(
+               operand->operand(0)->shape().layout());
+  });
+}
 }  // namespace
 
 bool CpuInstructionFusion::ShouldFuse(HloInstruction* consumer,
@@ -87,6 +124,15 @@ bool CpuInstructionFusion::ShouldFuse(HloInstruction* consumer,
     return false;
   }
 
+  if (IsInt8KernelConsumer(consumer)) {
+    if (IsS8ToS32Convert(*producer)) {
+      VLOG(2) << "Fusing S8 to S32 convert into int8 dot or convolution.";
+      return true;
+    }
+    VLOG(2) << "Not fusing: int8 kernels only read S8 operands.";
+    return false;
+  }
+
   if (!CanBeLoopFused(*producer)) {
     VLOG(2) << "Producer is not fusible.";
     return false;
@@ -196,6 +242,26 @@ bool CpuInstructionFusion::ShouldFuse(HloInstruction* consumer,
   return false;
 }
 
+bool CpuInstructionFusion::IsExpensiveToDuplicate(
+    const HloInstruction& instruction) const {
+  // Recomputing an element pays off as long as it is cheaper than writing it
+  // to memory and reading it back, which takes about this many cycles when
+  // measured the same way.
+  constexpr double kMaxDuplicatedCyclesPerElement = 2.0;
+  if (fusion_profile_ != nullptr && instruction.shape().IsArray() &&
+      ShapeUtil::ElementsIn(instruction.shape()) > 0) {
+    absl::optional<double> cycles = fusion_profile_->AverageCycles(instruction);
+    if (cycles.has_value()) {
+      const double cycles_per_element =
+          *cycles / ShapeUtil::ElementsIn(instruction.shape());
+      VLOG(2) << "Profiled " << cycles_per_element
+              << " cycles per element for " << instruction.name();
+      return cycles_per_element > kMaxDuplicatedCyclesPerElement;
+    }
+  }
+  return InstructionFusion::IsExpensive(instruction);
+}
+
 HloInstruction::FusionKind CpuInstructionFusion::ChooseKind(
     const HloInstruction* producer, const HloInstruction* consumer) {
   return CanBeOutputFused(producer, consumer)
@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_CPU_INSTRUCTION_FUSION_H_
 
 #include "absl/container/flat_hash_map.h"
+#include "tensorflow/compiler/xla/service/cpu/fusion_profile.h"
 #include "tensorflow/compiler/xla/service/fusion_node_indexing_evaluation.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/instruction_fusion.h"
@@ -26,8 +27,14 @@ namespace cpu {
 
 class CpuInstructionFusion : public InstructionFusion {
  public:
-  CpuInstructionFusion()
-      : InstructionFusion(CpuInstructionFusion::IsExpensive) {}
+  // If 'fusion_profile' is not null, the cycles it measured for a producer,
+  // rather than its opcode, decide whether it is too expensive to duplicate
+  // into several consumers or into a consumer that reuses its elements.
+  explicit CpuInstructionFusion(const FusionProfile* fusion_profile = nullptr)
+      : InstructionFusion([this](const HloInstruction& instruction) {
+          return IsExpensiveToDuplicate(instruction);
+        }),
+        fusion_profile_(fusion_profile) {}
   ~CpuInstructionFusion() override = default;
 
   StatusOr<bool> Run(HloModule* module) override {
@@ -44,6 +51,10 @@ class CpuInstructionFusion : public InstructionFusion {
   HloInstruction* FuseInstruction(HloInstruction* fusion_instruction,
                                   HloInstruction* producer) override;
 
+  bool IsExpensiveToDuplicate(const HloInstruction& instruction) const;
+
+  const FusionProfile* fusion_profile_;
+
   // Keep track of the number of times each instruction inside a fusion node is
   // indexed with different index vectors.
   absl::flat_hash_map<const HloInstruction*, FusionNodeIndexingEvaluation>
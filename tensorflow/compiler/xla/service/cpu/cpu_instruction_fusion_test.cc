@@ -21,6 +21,7 @@ limitations under the License.
 
 #include "absl/strings/str_cat.h"
 #include "absl/types/span.h"
+#include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/hlo_matchers.h"
 #include "tensorflow/compiler/xla/service/transpose_folding.h"
 #include "tensorflow/compiler/xla/shape.h"
@@ -719,6 +720,54 @@ TEST_F(OpcodeFusionTest, DotAddOutputFusion_19x50x1_multi_use) {
               Not(op::Fusion()));
 }
 
+class PackedGemmFusionTest : public OpcodeFusionTest {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = OpcodeFusionTest::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_packed_gemm_max_dimension(64);
+    return debug_options;
+  }
+};
+
+TEST_F(PackedGemmFusionTest, DotAddOutputFusion_19x50x19) {
+  auto module = CreateNewVerifiedModule();
+  CreateComputationForDotAddOutputFusionTest(TestName(), module.get(), /*m=*/19,
+                                             /*k=*/50, /*n=*/19,
+                                             /*add_extra_use_for_dot=*/false);
+
+  RunFusionAndCheckOpcodesWereFused(
+      module.get(),
+      {HloOpcode::kDot, HloOpcode::kAdd, HloOpcode::kParameter,
+       HloOpcode::kParameter, HloOpcode::kParameter},
+      HloInstruction::FusionKind::kOutput);
+}
+
+TEST_F(PackedGemmFusionTest, DotAddOutputFusion_19x100x19) {
+  auto module = CreateNewVerifiedModule();
+  CreateComputationForDotAddOutputFusionTest(TestName(), module.get(), /*m=*/19,
+                                             /*k=*/100, /*n=*/19,
+                                             /*add_extra_use_for_dot=*/false);
+
+  TF_ASSERT_OK_AND_ASSIGN(bool fused_something,
+                          CpuInstructionFusion().Run(module.get()));
+  EXPECT_FALSE(fused_something);
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              Not(op::Fusion()));
+}
+
+TEST_F(PackedGemmFusionTest, DotAddOutputFusion_19x50x19_multi_use) {
+  auto module = CreateNewVerifiedModule();
+  CreateComputationForDotAddOutputFusionTest(TestName(), module.get(), /*m=*/19,
+                                             /*k=*/50, /*n=*/19,
+                                             /*add_extra_use_for_dot=*/true);
+
+  TF_ASSERT_OK_AND_ASSIGN(bool fused_something,
+                          CpuInstructionFusion().Run(module.get()));
+  EXPECT_FALSE(fused_something);
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              Not(op::Fusion()));
+}
+
 TEST_F(InstructionFusionTest,
        DotOperationFusion_DontOutputFuseDuplicateOperands) {
   absl::string_view module_string = R"(
@@ -741,6 +790,101 @@ ENTRY main {
               Not(op::Fusion()));
 }
 
+TEST_F(OpcodeFusionTest, Int8DotConvertFusion) {
+  absl::string_view module_string = R"(
+HloModule module
+
+ENTRY main {
+  a = s8[50,60]{1,0} parameter(0)
+  b = s8[60,40]{1,0} parameter(1)
+  a.s32 = s32[50,60]{1,0} convert(a)
+  b.s32 = s32[60,40]{1,0} convert(b)
+  ROOT dot = s32[50,40]{1,0} dot(a.s32, b.s32), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(module_string));
+  RunFusionAndCheckOpcodesWereFused(
+      module.get(),
+      {HloOpcode::kDot, HloOpcode::kConvert, HloOpcode::kConvert,
+       HloOpcode::kParameter, HloOpcode::kParameter});
+  EXPECT_TRUE(
+      IsInt8KernelFusion(*module->entry_computation()->root_instruction()));
+}
+
+TEST_F(OpcodeFusionTest, Int8ConvolutionConvertFusion) {
+  absl::string_view module_string = R"(
+HloModule module
+
+ENTRY main {
+  input = s8[1,8,8,4]{3,2,1,0} parameter(0)
+  kernel = s8[3,3,4,8]{3,2,1,0} parameter(1)
+  input.s32 = s32[1,8,8,4]{3,2,1,0} convert(input)
+  kernel.s32 = s32[3,3,4,8]{3,2,1,0} convert(kernel)
+  ROOT convolution = s32[1,6,6,8]{3,2,1,0} convolution(input.s32, kernel.s32),
+    window={size=3x3}, dim_labels=b01f_01io->b01f
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(module_string));
+  RunFusionAndCheckOpcodesWereFused(
+      module.get(),
+      {HloOpcode::kConvolution, HloOpcode::kConvert, HloOpcode::kConvert,
+       HloOpcode::kParameter, HloOpcode::kParameter});
+  EXPECT_TRUE(
+      IsInt8KernelFusion(*module->entry_computation()->root_instruction()));
+}
+
+TEST_F(InstructionFusionTest, Int8DotDontFuseProducersOfConverts) {
+  absl::string_view module_string = R"(
+HloModule module
+
+ENTRY main {
+  a = s8[50,60]{1,0} parameter(0)
+  b = s8[60,40]{1,0} parameter(1)
+  negate = s8[50,60]{1,0} negate(a)
+  a.s32 = s32[50,60]{1,0} convert(negate)
+  b.s32 = s32[60,40]{1,0} convert(b)
+  ROOT dot = s32[50,40]{1,0} dot(a.s32, b.s32), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(module_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool fused_something,
+                          CpuInstructionFusion().Run(module.get()));
+  EXPECT_TRUE(fused_something);
+  HloInstruction* root = module->entry_computation()->root_instruction();
+  EXPECT_THAT(root, op::Fusion(op::Negate(), op::Parameter()));
+  EXPECT_TRUE(IsInt8KernelFusion(*root));
+}
+
+TEST_F(InstructionFusionTest, Int8DotDontFuseMixedOperands) {
+  absl::string_view module_string = R"(
+HloModule module
+
+ENTRY main {
+  a = s8[50,60]{1,0} parameter(0)
+  b = s32[60,40]{1,0} parameter(1)
+  a.s32 = s32[50,60]{1,0} convert(a)
+  ROOT dot = s32[50,40]{1,0} dot(a.s32, b), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+}
+)";
+
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(module_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool fused_something,
+                          CpuInstructionFusion().Run(module.get()));
+  EXPECT_FALSE(fused_something);
+  EXPECT_THAT(module->entry_computation()->root_instruction(),
+              Not(op::Fusion()));
+}
+
 struct GatherLoopFusionTestSpec {
   string test_name;
   string hlo_computation_text;
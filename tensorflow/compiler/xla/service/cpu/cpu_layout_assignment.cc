@@ -102,6 +102,15 @@ static bool OperandsAndResultMustHaveRowMajorLayout(
   } else if (instr.opcode() == HloOpcode::kDot) {
     return DotOperandsAndResultMustHaveRowMajorLayout(instr,
                                                       target_machine_features);
+  } else if (instr.IsOutputFusion()) {
+    // Output fusions are emitted as their dot, with the other operand of the
+    // fused add as the addend.
+    const HloInstruction* root = instr.fused_expression_root();
+    const HloInstruction* dot = root->operand(0)->opcode() == HloOpcode::kDot
+                                    ? root->operand(0)
+                                    : root->operand(1);
+    return DotOperandsAndResultMustHaveRowMajorLayout(*dot,
+                                                      target_machine_features);
   }
   return false;
 }
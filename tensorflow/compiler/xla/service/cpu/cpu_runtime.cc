@@ -73,6 +73,8 @@ extern const char* const kEigenMatMulC128SymbolName =
     "__xla_cpu_runtime_EigenMatMulC128";
 extern const char* const kEigenMatMulS32SymbolName =
     "__xla_cpu_runtime_EigenMatMulS32";
+extern const char* const kEigenMatMulS8S32SymbolName =
+    "__xla_cpu_runtime_EigenMatMulS8S32";
 extern const char* const kMKLConvF32SymbolName = "__xla_cpu_runtime_MKLConvF32";
 extern const char* const kMKLMatMulF32SymbolName =
     "__xla_cpu_runtime_MKLMatMulF32";
@@ -86,6 +88,8 @@ extern const char* const kEigenConvF16SymbolName =
     "__xla_cpu_runtime_EigenConvF16";
 extern const char* const kEigenConvF32SymbolName =
     "__xla_cpu_runtime_EigenConvF32";
+extern const char* const kEigenConvS8S32SymbolName =
+    "__xla_cpu_runtime_EigenConvS8S32";
 extern const char* const kEigenFftSymbolName = "__xla_cpu_runtime_EigenFft";
 extern const char* const kEigenSingleThreadedFftSymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedFft";
@@ -101,10 +105,14 @@ extern const char* const kEigenSingleThreadedMatMulC128SymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedMatMulC128";
 extern const char* const kEigenSingleThreadedMatMulS32SymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedMatMulS32";
+extern const char* const kEigenSingleThreadedMatMulS8S32SymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedMatMulS8S32";
 extern const char* const kEigenSingleThreadedConvF16SymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedConvF16";
 extern const char* const kEigenSingleThreadedConvF32SymbolName =
     "__xla_cpu_runtime_EigenSingleThreadedConvF32";
+extern const char* const kEigenSingleThreadedConvS8S32SymbolName =
+    "__xla_cpu_runtime_EigenSingleThreadedConvS8S32";
 extern const char* const kAcquireInfeedBufferForDequeueSymbolName =
     "__xla_cpu_runtime_AcquireInfeedBufferForDequeue";
 extern const char* const kReleaseInfeedBufferAfterDequeueSymbolName =
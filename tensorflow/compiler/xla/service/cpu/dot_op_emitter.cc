@@ -98,6 +98,12 @@ enum class DotImplementationStrategy {
   // and the output have to be row major.
   kTiledLlvmIrGemm,
 
+  // The dot operation is lowered into LLVM IR that implements a cache-blocked
+  // Matrix*Matrix operation over packed copies of the inputs.  This strategy
+  // also allows fusing in a bias add into the dot.  The two inputs and the
+  // output have to be row major, but either input can be transposed.
+  kPackedLlvmIrGemm,
+
   // The dot operation is lowered into linalg.matmul op and lowered to LLVM IR.
   kLinalgMatmul,
 
@@ -175,6 +181,10 @@ class DotOpEmitter {
   // Lowers the dot operation as a tiled Matrix*Matrix loop.
   void EmitTiledLlvmIrGemm();
 
+  // Lowers the dot operation as a cache-blocked Matrix*Matrix loop over packed
+  // panels of the operands.
+  void EmitPackedLlvmIrGemm();
+
   // Lowers the dot operation through MLIR's linalg.matmul.
   Status EmitLinalgMatmul();
 
@@ -201,6 +211,12 @@ class DotOpEmitter {
         .value_or(kDefaultTileSize);
   }
 
+  // Returns the block sizes along M, K and N of the packed GEMM.  The packed
+  // panels of a block of the LHS and the RHS live on the stack.
+  std::tuple<int64, int64, int64> GetPackedGemmBlockSize() const {
+    return std::tuple<int64, int64, int64>(64, 128, 96);
+  }
+
   DotInfo dot_info_;
   string dot_hlo_name_;
   const llvm_ir::IrArray& target_array_;
@@ -298,6 +314,37 @@ void DotOpEmitter::EmitTiledLlvmIrGemm() {
       /*rhs=*/rhs, /*result=*/target, b_, hlo_module_config_);
 }
 
+void DotOpEmitter::EmitPackedLlvmIrGemm() {
+  PrimitiveType primitive_type = dot_info_.result_shape.element_type();
+  MatMultDims mat_mult_dims = GetMatMultDims();
+  CHECK(!mat_mult_dims.lhs_column_major && !mat_mult_dims.rhs_column_major);
+
+  int64 max_target_vector_width =
+      target_machine_features_.vector_register_num_elements(
+          *b_->GetInsertBlock()->getParent(), primitive_type);
+
+  // A [4, 3 * vector width] tile of the result takes up 12 vector registers,
+  // which leaves the rest for the broadcast LHS element and the RHS vector.
+  const int64 kTileSizeM = 4;
+  const int64 kTileSizeNInVectorWidth = 3;
+
+  int64 block_size_m, block_size_k, block_size_n;
+  std::tie(block_size_m, block_size_k, block_size_n) = GetPackedGemmBlockSize();
+
+  EmitPackedGemm(
+      /*scalar_type=*/primitive_type,
+      /*m=*/mat_mult_dims.m, /*k=*/mat_mult_dims.k, /*n=*/mat_mult_dims.n,
+      /*lhs_transposed=*/!mat_mult_dims.lhs_canonical,
+      /*rhs_transposed=*/!mat_mult_dims.rhs_canonical,
+      /*tile_size_m=*/kTileSizeM,
+      /*tile_size_n=*/kTileSizeNInVectorWidth * max_target_vector_width,
+      /*block_size_m=*/block_size_m, /*block_size_k=*/block_size_k,
+      /*block_size_n=*/block_size_n, /*lhs=*/lhs_array_.GetBasePointer(),
+      /*rhs=*/rhs_array_.GetBasePointer(),
+      /*addend=*/addend_array_ ? addend_array_->GetBasePointer() : nullptr,
+      /*result=*/target_array_.GetBasePointer(), b_, hlo_module_config_);
+}
+
 void DotOpEmitter::EmitTiledLlvmIrGemv() {
   PrimitiveType primitive_type = dot_info_.result_shape.element_type();
 
@@ -445,6 +492,14 @@ Status DotOpEmitter::Emit() {
     return EmitScalarDot();
   }
 
+  if (lhs_shape.element_type() == S8) {
+    // The S8 operands of an int8 x int8 -> int32 dot, which only the runtime
+    // implements (see IsInt8KernelFusion).
+    TF_RET_CHECK(rhs_shape.element_type() == S8 &&
+                 target_array_.GetShape().element_type() == S32);
+    return EmitCallToRuntime();
+  }
+
   switch (GetDotImplementationStrategy(hlo_module_config_, dot_info_,
                                        target_machine_features_)) {
     case DotImplementationStrategy::kNaiveLlvmIr:
@@ -459,6 +514,10 @@ Status DotOpEmitter::Emit() {
       EmitTiledLlvmIrGemm();
       return Status::OK();
 
+    case DotImplementationStrategy::kPackedLlvmIrGemm:
+      EmitPackedLlvmIrGemm();
+      return Status::OK();
+
     case DotImplementationStrategy::kLinalgMatmul:
       return EmitLinalgMatmul();
 
@@ -660,6 +719,8 @@ Status DotOpEmitter::EmitCallToRuntime() {
   llvm::Function* function = b_->GetInsertBlock()->getParent();
   llvm::Module* module = function->getParent();
   llvm::Type* float_type;
+  // The element type of the operands, if it differs from that of the result.
+  llvm::Type* operand_type = nullptr;
   const char* fn_name;
   switch (type) {
     case F16:
@@ -699,9 +760,16 @@ Status DotOpEmitter::EmitCallToRuntime() {
       float_type = llvm_ir::PrimitiveTypeToIrType(C128, module);
       break;
     case S32:
-      fn_name = multi_threaded
-                    ? runtime::kEigenMatMulS32SymbolName
-                    : runtime::kEigenSingleThreadedMatMulS32SymbolName;
+      if (lhs_array_.GetShape().element_type() == S8) {
+        fn_name = multi_threaded
+                      ? runtime::kEigenMatMulS8S32SymbolName
+                      : runtime::kEigenSingleThreadedMatMulS8S32SymbolName;
+        operand_type = b_->getInt8Ty();
+      } else {
+        fn_name = multi_threaded
+                      ? runtime::kEigenMatMulS32SymbolName
+                      : runtime::kEigenSingleThreadedMatMulS32SymbolName;
+      }
       float_type = b_->getInt32Ty();
       break;
     default:
@@ -710,12 +778,14 @@ Status DotOpEmitter::EmitCallToRuntime() {
   }
 
   llvm::Type* float_ptr_type = float_type->getPointerTo();
+  llvm::Type* operand_ptr_type =
+      operand_type ? operand_type->getPointerTo() : float_ptr_type;
   llvm::Type* int64_type = b_->getInt64Ty();
   llvm::Type* int32_type = b_->getInt32Ty();
   llvm::Type* int8_ptr_type = b_->getInt8Ty()->getPointerTo();
   llvm::FunctionType* matmul_type = llvm::FunctionType::get(
       b_->getVoidTy(),
-      {int8_ptr_type, float_ptr_type, float_ptr_type, float_ptr_type,
+      {int8_ptr_type, float_ptr_type, operand_ptr_type, operand_ptr_type,
        int64_type, int64_type, int64_type, int32_type, int32_type},
       /*isVarArg=*/false);
 
@@ -757,8 +827,8 @@ Status DotOpEmitter::EmitCallToRuntime() {
       matmul_func,
       {b_->CreateBitCast(executable_run_options_value_, int8_ptr_type),
        b_->CreateBitCast(target_array_.GetBasePointer(), float_ptr_type),
-       b_->CreateBitCast(lhs->GetBasePointer(), float_ptr_type),
-       b_->CreateBitCast(rhs->GetBasePointer(), float_ptr_type),
+       b_->CreateBitCast(lhs->GetBasePointer(), operand_ptr_type),
+       b_->CreateBitCast(rhs->GetBasePointer(), operand_ptr_type),
        b_->getInt64(mat_mult_dims.m), b_->getInt64(mat_mult_dims.n),
        b_->getInt64(mat_mult_dims.k), b_->getInt32(transpose_lhs),
        b_->getInt32(transpose_rhs)});
@@ -945,6 +1015,11 @@ DotImplementationStrategy GetDotImplementationStrategy(
   }
 
   if (IsAlignedGemm(dot_info, target_machine_features)) {
+    if (PotentiallyImplementedAsPackedLlvmIrGemm(
+            config, dot_info.lhs_shape, dot_info.rhs_shape,
+            dot_info.result_shape)) {
+      return DotImplementationStrategy::kPackedLlvmIrGemm;
+    }
     if (CanEmitTiledLlvmIrGemm(config, dot_info, target_machine_features)) {
       return options::UseLinalgForDot(config)
                  ? DotImplementationStrategy::kLinalgMatmul
@@ -1039,9 +1114,34 @@ llvm_ir::IrArray SliceOutInnerArray(llvm_ir::IrArray outer_array,
                           std::move(inner_shape));
 }
 
+// Returns the DotInfo of the non-batch dot operations that the batch dot 'dot'
+// is lowered into.
+DotInfo GetInnerDotInfo(const HloInstruction& dot) {
+  const int64 num_batch_dims =
+      dot.dot_dimension_numbers().lhs_batch_dimensions_size();
+  auto drop_batch_dims = [&](const Shape& shape) {
+    absl::Span<int64 const> dims(shape.dimensions());
+    dims.remove_prefix(num_batch_dims);
+    return ShapeUtil::MakeShapeWithDescendingLayout(shape.element_type(), dims);
+  };
+  DotInfo dot_info;
+  dot_info.lhs_shape = drop_batch_dims(dot.operand(0)->shape());
+  dot_info.rhs_shape = drop_batch_dims(dot.operand(1)->shape());
+  dot_info.result_shape = drop_batch_dims(dot.shape());
+  dot_info.dim_nums = dot.dot_dimension_numbers();
+  dot_info.dim_nums.clear_lhs_batch_dimensions();
+  dot_info.dim_nums.clear_rhs_batch_dimensions();
+  dot_info.dim_nums.set_lhs_contracting_dimensions(
+      0, dot_info.dim_nums.lhs_contracting_dimensions(0) - num_batch_dims);
+  dot_info.dim_nums.set_rhs_contracting_dimensions(
+      0, dot_info.dim_nums.rhs_contracting_dimensions(0) - num_batch_dims);
+  return dot_info;
+}
+
 Status EmitBatchDotOperation(
     const HloInstruction& dot, const llvm_ir::IrArray& target_array,
     const llvm_ir::IrArray& lhs_array, const llvm_ir::IrArray& rhs_array,
+    const DynamicLoopBounds* dynamic_loop_bounds,
     llvm::Value* executable_run_options_value, llvm::IRBuilder<>* b,
     mlir::MLIRContext* mlir_context, const HloModuleConfig& hlo_module_config,
     const TargetMachineFeatures& target_machine_features) {
@@ -1066,30 +1166,26 @@ Status EmitBatchDotOperation(
 
   int64 batch_count = lhs_array_reshaped.GetShape().dimensions(0);
 
+  // A parallel task computes the batches in its range of the outermost batch
+  // dimension, which are contiguous in the collapsed batch dimension.
+  llvm::Value* batch_start = b->getInt64(0);
+  llvm::Value* batch_end = b->getInt64(batch_count);
+  if (dynamic_loop_bounds != nullptr) {
+    TF_RET_CHECK(dynamic_loop_bounds->size() == 1);
+    const int64 inner_batch_count = batch_count / dot.shape().dimensions(0);
+    batch_start = b->CreateMul((*dynamic_loop_bounds)[0].first,
+                               b->getInt64(inner_batch_count));
+    batch_end = b->CreateMul((*dynamic_loop_bounds)[0].second,
+                             b->getInt64(inner_batch_count));
+  }
+
   KernelSupportLibrary ksl(b);
 
   return ksl.ForWithStatus(
-      llvm_ir::IrName(&dot, "bdot"), /*start=*/0, /*end=*/batch_count,
+      llvm_ir::IrName(&dot, "bdot"), batch_start, batch_end,
       /*step=*/1, [&](llvm::Value* indvar) {
-        DotDimensionNumbers adjusted_dim_numbers = dot.dot_dimension_numbers();
-        adjusted_dim_numbers.clear_lhs_batch_dimensions();
-        adjusted_dim_numbers.clear_rhs_batch_dimensions();
-
         // Create a DotInfo representing the "inner" non-batch dot operation.
-        DotInfo dot_info;
-        dot_info.lhs_shape = DropFirstDim(lhs_array_reshaped.GetShape());
-        dot_info.rhs_shape = DropFirstDim(rhs_array_reshaped.GetShape());
-        dot_info.result_shape = DropFirstDim(target_array_reshaped.GetShape());
-        dot_info.dim_nums = dot.dot_dimension_numbers();
-        dot_info.dim_nums.clear_lhs_batch_dimensions();
-        dot_info.dim_nums.clear_rhs_batch_dimensions();
-
-        dot_info.dim_nums.set_lhs_contracting_dimensions(
-            0,
-            dot_info.dim_nums.lhs_contracting_dimensions(0) - num_batch_dims);
-        dot_info.dim_nums.set_rhs_contracting_dimensions(
-            0,
-            dot_info.dim_nums.rhs_contracting_dimensions(0) - num_batch_dims);
+        DotInfo dot_info = GetInnerDotInfo(dot);
 
         llvm_ir::IrArray lhs_slice =
             SliceOutInnerArray(lhs_array_reshaped, /*batch_index=*/indvar, b);
@@ -1115,6 +1211,27 @@ bool IsBatchDot(const HloInstruction& instr) {
 }
 }  // namespace
 
+bool DotImplementationCanBeParallelized(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features) {
+  if (!IsBatchDot(dot_instr) || dot_instr.shape().dimensions(0) <= 1) {
+    return false;
+  }
+  // Eigen already runs on the intra-op thread pool, and can't be called from
+  // the tasks that run on it.
+  switch (GetDotImplementationStrategy(dot_instr.parent()->parent()->config(),
+                                       GetInnerDotInfo(dot_instr),
+                                       target_machine_features)) {
+    case DotImplementationStrategy::kNaiveLlvmIr:
+    case DotImplementationStrategy::kTiledLlvmIrGemv:
+    case DotImplementationStrategy::kTiledLlvmIrGemm:
+    case DotImplementationStrategy::kPackedLlvmIrGemm:
+      return true;
+    default:
+      return false;
+  }
+}
+
 bool DotImplementationCanHandleTranspose(
     const HloInstruction& dot_instr,
     const TargetMachineFeatures& target_machine_features) {
@@ -1124,6 +1241,7 @@ bool DotImplementationCanHandleTranspose(
 
   return impl_strategy == DotImplementationStrategy::kNaiveLlvmIr ||
          impl_strategy == DotImplementationStrategy::kTiledLlvmIrGemv ||
+         impl_strategy == DotImplementationStrategy::kPackedLlvmIrGemm ||
          impl_strategy == DotImplementationStrategy::kEigen;
 }
 
@@ -1142,6 +1260,7 @@ bool DotOperandsAndResultMustHaveRowMajorLayout(
                                    DotInfo(dot_instr), target_machine_features);
 
   return impl_strategy == DotImplementationStrategy::kTiledLlvmIrGemm ||
+         impl_strategy == DotImplementationStrategy::kPackedLlvmIrGemm ||
          impl_strategy == DotImplementationStrategy::kEigen;
 }
 
@@ -1150,20 +1269,24 @@ Status EmitDotOperation(const HloInstruction& dot,
                         const llvm_ir::IrArray& lhs_array,
                         const llvm_ir::IrArray& rhs_array,
                         const llvm_ir::IrArray* addend_array,
+                        const DynamicLoopBounds* dynamic_loop_bounds,
                         llvm::Value* executable_run_options_value,
                         llvm::IRBuilder<>* b, mlir::MLIRContext* mlir_context,
                         const HloModuleConfig& hlo_module_config,
                         const TargetMachineFeatures& target_machine_features) {
-  // This routine assumes that the dot operation is not in a parallelized
-  // enclosing computation.
-  CHECK(dot.parent()->root_instruction()->outer_dimension_partitions().empty());
+  // Only batch dots can be in a parallelized enclosing computation, and then
+  // they are given the bounds of their task.
+  CHECK(dynamic_loop_bounds != nullptr ||
+        dot.parent()->root_instruction()->outer_dimension_partitions().empty());
 
   if (IsBatchDot(dot)) {
     TF_RET_CHECK(addend_array == nullptr);
     return EmitBatchDotOperation(dot, target_array, lhs_array, rhs_array,
+                                 dynamic_loop_bounds,
                                  executable_run_options_value, b, mlir_context,
                                  hlo_module_config, target_machine_features);
   }
+  TF_RET_CHECK(dynamic_loop_bounds == nullptr);
 
   return EmitNonBatchDotOperation(DotInfo(dot), dot.name(), target_array,
                                   lhs_array, rhs_array, addend_array,
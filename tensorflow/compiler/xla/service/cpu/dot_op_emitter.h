@@ -20,6 +20,7 @@ limitations under the License.
 #include "llvm/IR/IRBuilder.h"
 #include "mlir/IR/MLIRContext.h"  // from @llvm-project
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
+#include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_module_config.h"
@@ -49,6 +50,14 @@ bool DotImplementationCanHandleTranspose(
 absl::optional<int64> ProfitableToMakeDotOperandColumnMajor(
     const HloInstruction& hlo);
 
+// Returns true if ParallelTaskAssigner can split `dot_instr` into parallel
+// tasks along its outermost batch dimension. Only batch dots whose inner dots
+// are lowered to LLVM IR can be split, as the Eigen runtime already uses the
+// intra-op thread pool.
+bool DotImplementationCanBeParallelized(
+    const HloInstruction& dot_instr,
+    const TargetMachineFeatures& target_machine_features);
+
 // Emit LLVM IR to perform the dot operation on lhs_array and rhs_array and
 // place the result in target_array. IR is emitted at current insert point of
 // the builder. Upon completion of the method, the insert point is set to the
@@ -57,12 +66,18 @@ absl::optional<int64> ProfitableToMakeDotOperandColumnMajor(
 // If `addend_array` is not nullptr then it must be an array of the same
 // dimensions as the result, and the result is computed as `addend_array` +
 // dot(`lhs_array`, `rhs_array`).  A non-null `addend_array` is only supported
-// for Matrix-vector products.
+// for Matrix-vector products and for Matrix-matrix products lowered to the
+// packed GEMM emitter (see PotentiallyImplementedAsPackedLlvmIrGemm).
+//
+// If `dynamic_loop_bounds` is not nullptr then `dot` is the root of a parallel
+// task, and only the part of the result within the bounds of its outermost
+// dimension is computed. This is only supported for batch dots.
 Status EmitDotOperation(const HloInstruction& dot,
                         const llvm_ir::IrArray& target_array,
                         const llvm_ir::IrArray& lhs_array,
                         const llvm_ir::IrArray& rhs_array,
                         const llvm_ir::IrArray* addend_array,
+                        const DynamicLoopBounds* dynamic_loop_bounds,
                         llvm::Value* executable_run_options_value,
                         llvm::IRBuilder<>* b, mlir::MLIRContext* mlir_context,
                         const HloModuleConfig& hlo_module_config,
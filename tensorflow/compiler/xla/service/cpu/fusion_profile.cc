@@ -0,0 +1,258 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/fusion_profile.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/service/cpu/fusion_profile.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/random.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Cost of a transcendental function relative to a flop, when attributing the
+// cycles of a fusion to its fused instructions.
+constexpr double kFlopsPerTranscendental = 20.0;
+
+// Printed by parallel task assignment, which doesn't change what an
+// instruction computes.
+constexpr absl::string_view kOuterDimensionPartitions =
+    ", outer_dimension_partitions={";
+
+}  // namespace
+
+StatusOr<FusionProfile> FusionProfile::Load(const string& path,
+                                            tensorflow::Env* env) {
+  FusionProfile profile;
+  if (!env->FileExists(path).ok()) {
+    return std::move(profile);
+  }
+  FusionProfileProto proto;
+  TF_RETURN_IF_ERROR(tensorflow::ReadBinaryProto(env, path, &proto));
+  for (const FusionProfileProto::Entry& entry_proto : proto.entries()) {
+    Entry& entry = profile.entries_[entry_proto.fingerprint()];
+    entry.total_cycles += entry_proto.total_cycles();
+    entry.sample_count += entry_proto.sample_count();
+  }
+  VLOG(1) << "Loaded " << profile.entries_.size()
+          << " XLA:CPU fusion profile entries from " << path;
+  return std::move(profile);
+}
+
+Status FusionProfile::Save(const string& path, tensorflow::Env* env) const {
+  std::vector<std::pair<uint64, Entry>> entries(entries_.begin(),
+                                                entries_.end());
+  std::sort(entries.begin(), entries.end(),
+            [](const std::pair<uint64, Entry>& lhs,
+               const std::pair<uint64, Entry>& rhs) {
+              return lhs.first < rhs.first;
+            });
+  FusionProfileProto proto;
+  for (const auto& fingerprint_and_entry : entries) {
+    FusionProfileProto::Entry* entry_proto = proto.add_entries();
+    entry_proto->set_fingerprint(fingerprint_and_entry.first);
+    entry_proto->set_total_cycles(fingerprint_and_entry.second.total_cycles);
+    entry_proto->set_sample_count(fingerprint_and_entry.second.sample_count);
+  }
+  // Compilations that read the profile concurrently only ever see a complete
+  // file.
+  const string temp_path =
+      absl::StrCat(path, ".", absl::Hex(tensorflow::random::New64()), ".tmp");
+  TF_RETURN_IF_ERROR(tensorflow::WriteBinaryProto(env, temp_path, proto));
+  Status status = env->RenameFile(temp_path, path);
+  if (!status.ok()) {
+    env->DeleteFile(temp_path).IgnoreError();
+  }
+  return status;
+}
+
+void FusionProfile::AddExecutionProfile(const HloModule& module,
+                                        const HloExecutionProfile& profile) {
+  // Instructions in while loops and conditionals run a data dependent number
+  // of times, so only the entry computation and the computations it calls are
+  // recorded.
+  std::vector<const HloComputation*> worklist = {module.entry_computation()};
+  while (!worklist.empty()) {
+    const HloComputation* computation = worklist.back();
+    worklist.pop_back();
+    for (const HloInstruction* instruction : computation->instructions()) {
+      switch (instruction->opcode()) {
+        case HloOpcode::kCall:
+          // Parallel task assignment outlines instructions into calls. The
+          // cycles of the outlined instruction add up those of all its tasks.
+          worklist.push_back(instruction->to_apply());
+          break;
+        case HloOpcode::kBitcast:
+        case HloOpcode::kConditional:
+        case HloOpcode::kConstant:
+        case HloOpcode::kGetTupleElement:
+        case HloOpcode::kParameter:
+        case HloOpcode::kTuple:
+        case HloOpcode::kWhile:
+          break;
+        default: {
+          const double cycles = profile.GetCyclesTakenBy(*instruction);
+          if (cycles <= 0) {
+            break;
+          }
+          AddCycles(*instruction, cycles);
+          if (instruction->opcode() == HloOpcode::kFusion) {
+            AddFusedCycles(*instruction, cycles);
+          }
+          break;
+        }
+      }
+    }
+  }
+}
+
+void FusionProfile::AddFusedCycles(const HloInstruction& fusion,
+                                   double cycles) {
+  HloCostAnalysis cost_analysis([](const Shape& shape) {
+    return ShapeUtil::ByteSizeOf(shape, sizeof(void*));
+  });
+  if (!fusion.fused_instructions_computation()->Accept(&cost_analysis).ok()) {
+    return;
+  }
+  std::vector<std::pair<const HloInstruction*, double>> weights;
+  double total_weight = 0;
+  for (const HloInstruction* fused : fusion.fused_instructions()) {
+    const double weight =
+        cost_analysis.flop_count(*fused) +
+        kFlopsPerTranscendental * cost_analysis.transcendental_count(*fused);
+    if (weight > 0) {
+      weights.emplace_back(fused, weight);
+      total_weight += weight;
+    }
+  }
+  for (const auto& fused_and_weight : weights) {
+    AddCycles(*fused_and_weight.first,
+              cycles * fused_and_weight.second / total_weight);
+  }
+}
+
+void FusionProfile::AddCycles(const HloInstruction& instruction,
+                              double cycles) {
+  Entry& entry = entries_[Fingerprint(instruction)];
+  entry.total_cycles += cycles;
+  ++entry.sample_count;
+}
+
+void FusionProfile::Merge(const FusionProfile& other) {
+  for (const auto& fingerprint_and_entry : other.entries_) {
+    Entry& entry = entries_[fingerprint_and_entry.first];
+    entry.total_cycles += fingerprint_and_entry.second.total_cycles;
+    entry.sample_count += fingerprint_and_entry.second.sample_count;
+  }
+}
+
+absl::optional<double> FusionProfile::AverageCycles(
+    const HloInstruction& instruction) const {
+  auto it = entries_.find(Fingerprint(instruction));
+  if (it == entries_.end() || it->second.sample_count == 0) {
+    return absl::nullopt;
+  }
+  return it->second.total_cycles / it->second.sample_count;
+}
+
+uint64 FusionProfile::Fingerprint(const HloInstruction& instruction) {
+  string text = instruction.ToString(HloPrintOptions::Fingerprint());
+  const size_t partitions_start = text.find(string(kOuterDimensionPartitions));
+  if (partitions_start != string::npos) {
+    const size_t partitions_end = text.find('}', partitions_start);
+    CHECK_NE(partitions_end, string::npos);
+    text.erase(partitions_start, partitions_end + 1 - partitions_start);
+  }
+  return tensorflow::Fingerprint64(text);
+}
+
+Status MergeIntoFusionProfileFile(const string& path,
+                                  const FusionProfile& profile,
+                                  tensorflow::Env* env) {
+  static tensorflow::mutex* mu = new tensorflow::mutex();
+  tensorflow::mutex_lock lock(*mu);
+  TF_ASSIGN_OR_RETURN(FusionProfile fusion_profile,
+                      FusionProfile::Load(path, env));
+  fusion_profile.Merge(profile);
+  return fusion_profile.Save(path, env);
+}
+
+constexpr int64 FusionProfileRecorder::kSecondsBetweenSaves;
+
+FusionProfileRecorder::FusionProfileRecorder(string path,
+                                             const HloModule* module,
+                                             int64 seconds_between_saves,
+                                             tensorflow::Env* env)
+    : path_(std::move(path)),
+      module_(module),
+      seconds_between_saves_(seconds_between_saves),
+      env_(env),
+      last_save_micros_(env->NowMicros()) {}
+
+FusionProfileRecorder::~FusionProfileRecorder() {
+  Status status = Save();
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to record XLA:CPU fusion profile in " << path_
+                 << ": " << status;
+  }
+}
+
+void FusionProfileRecorder::AddExecutionProfile(
+    const HloExecutionProfile& profile) {
+  {
+    tensorflow::mutex_lock lock(mu_);
+    unsaved_.AddExecutionProfile(*module_, profile);
+    if (env_->NowMicros() - last_save_micros_ <
+        seconds_between_saves_ * tensorflow::EnvTime::kSecondsToMicros) {
+      return;
+    }
+  }
+  Status status = Save();
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to record XLA:CPU fusion profile in " << path_
+                 << ": " << status;
+  }
+}
+
+Status FusionProfileRecorder::Save() {
+  FusionProfile unsaved;
+  {
+    tensorflow::mutex_lock lock(mu_);
+    if (unsaved_.empty()) {
+      return Status::OK();
+    }
+    std::swap(unsaved, unsaved_);
+    last_save_micros_ = env_->NowMicros();
+  }
+  // The file is read and rewritten without holding mu_, so that concurrent
+  // runs only wait to record their own profiles.
+  return MergeIntoFusionProfileFile(path_, unsaved, env_);
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,136 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_FUSION_PROFILE_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_FUSION_PROFILE_H_
+
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/service/hlo_execution_profile.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/statusor.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace xla {
+namespace cpu {
+
+// The average number of cycles that HLO instructions took in the profiled runs
+// of XLA:CPU executables, which later compilations use in place of static
+// cost estimates to tune fusion and parallel task assignment to the host.
+//
+// Instructions are identified by a fingerprint of their opcode, attributes and
+// operand and result shapes, so a measurement applies to every instruction
+// that computes the same thing, in any module. The cycles of a fusion are also
+// attributed to each fused instruction, in proportion to its flops, so that
+// the cost of a producer that was fused into its consumers is known as well.
+class FusionProfile {
+ public:
+  FusionProfile() = default;
+
+  // Reads the profile stored at 'path'. Returns an empty profile if there is
+  // no file at 'path'.
+  static StatusOr<FusionProfile> Load(
+      const string& path, tensorflow::Env* env = tensorflow::Env::Default());
+
+  // Writes the profile to 'path', replacing it atomically.
+  Status Save(const string& path,
+              tensorflow::Env* env = tensorflow::Env::Default()) const;
+
+  // Adds the cycles that 'profile', recorded by a run of the executable of
+  // 'module', measured for each instruction that runs once per execution.
+  void AddExecutionProfile(const HloModule& module,
+                           const HloExecutionProfile& profile);
+
+  // Adds one run of 'instruction' that took 'cycles'.
+  void AddCycles(const HloInstruction& instruction, double cycles);
+
+  // Adds the runs recorded in 'other'.
+  void Merge(const FusionProfile& other);
+
+  // Returns the average cycles of the runs of instructions with the same
+  // fingerprint as 'instruction', or nullopt if none was profiled.
+  absl::optional<double> AverageCycles(
+      const HloInstruction& instruction) const;
+
+  bool empty() const { return entries_.empty(); }
+
+  // Returns the fingerprint that the cycles of 'instruction' are stored under.
+  // It does not depend on names, nor on the parallel tasks the instruction is
+  // split into.
+  static uint64 Fingerprint(const HloInstruction& instruction);
+
+ private:
+  struct Entry {
+    double total_cycles = 0;
+    int64 sample_count = 0;
+  };
+
+  // Attributes 'cycles' of 'fusion' to its fused instructions.
+  void AddFusedCycles(const HloInstruction& fusion, double cycles);
+
+  absl::flat_hash_map<uint64, Entry> entries_;
+};
+
+// Adds the runs recorded in 'profile' to the FusionProfile stored at 'path'.
+// Serializes concurrent updates of the file within the process.
+Status MergeIntoFusionProfileFile(
+    const string& path, const FusionProfile& profile,
+    tensorflow::Env* env = tensorflow::Env::Default());
+
+// Records the profiled runs of the executable of one module in memory, and
+// adds them to the FusionProfile stored at 'path' at most once every
+// 'seconds_between_saves', and when it is destroyed, so that runs don't wait
+// for the file to be read and rewritten. Thread-safe.
+class FusionProfileRecorder {
+ public:
+  static constexpr int64 kSecondsBetweenSaves = 60;
+
+  FusionProfileRecorder(string path, const HloModule* module,
+                        int64 seconds_between_saves = kSecondsBetweenSaves,
+                        tensorflow::Env* env = tensorflow::Env::Default());
+  ~FusionProfileRecorder();
+
+  // Records the cycles that 'profile', recorded by a run of the executable,
+  // measured. Saves the runs recorded so far if the last save is at least
+  // 'seconds_between_saves' ago.
+  void AddExecutionProfile(const HloExecutionProfile& profile);
+
+  // Adds the runs recorded since the last save to the file.
+  Status Save();
+
+ private:
+  const string path_;
+  const HloModule* const module_;
+  const int64 seconds_between_saves_;
+  tensorflow::Env* const env_;
+
+  tensorflow::mutex mu_;
+  FusionProfile unsaved_ TF_GUARDED_BY(mu_);
+  uint64 last_save_micros_ TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FusionProfileRecorder);
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_FUSION_PROFILE_H_
@@ -0,0 +1,230 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/fusion_profile.h"
+
+#include <memory>
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_instruction_fusion.h"
+#include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
+#include "tensorflow/compiler/xla/service/hlo_execution_profile.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+using FusionProfileTest = HloTestBase;
+
+TEST_F(FusionProfileTest, FingerprintIgnoresNamesAndPartitions) {
+  const string hlo_string = R"(
+    HloModule m
+    ENTRY main {
+      x = f32[1024] parameter(0)
+      y = f32[1024] parameter(1)
+      exp.0 = f32[1024] exponential(x)
+      exp.1 = f32[1024] exponential(y)
+      negate = f32[1024] negate(x)
+      ROOT tuple = (f32[1024], f32[1024], f32[1024])
+        tuple(exp.0, exp.1, negate)
+    }
+  )";
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnVerifiedModule(hlo_string).ValueOrDie();
+  HloInstruction* exp0 = FindInstruction(module.get(), "exp.0");
+  HloInstruction* exp1 = FindInstruction(module.get(), "exp.1");
+  exp1->set_outer_dimension_partitions({4});
+  EXPECT_EQ(FusionProfile::Fingerprint(*exp0),
+            FusionProfile::Fingerprint(*exp1));
+  EXPECT_NE(FusionProfile::Fingerprint(*exp0),
+            FusionProfile::Fingerprint(
+                *FindInstruction(module.get(), "negate")));
+}
+
+TEST_F(FusionProfileTest, AttributesFusionCyclesByFlops) {
+  const string hlo_string = R"(
+    HloModule m
+    fused_computation {
+      p = f32[8] parameter(0)
+      exp = f32[8] exponential(p)
+      ROOT add = f32[8] add(exp, p)
+    }
+    ENTRY main {
+      x = f32[8] parameter(0)
+      ROOT fusion = f32[8] fusion(x), kind=kLoop, calls=fused_computation
+    }
+  )";
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnVerifiedModule(hlo_string).ValueOrDie();
+  HloProfileIndexMap index_map(*module);
+  HloCostAnalysis cost_analysis([](const Shape& shape) {
+    return ShapeUtil::ByteSizeOf(shape, sizeof(void*));
+  });
+  ASSERT_TRUE(module->entry_computation()->Accept(&cost_analysis).ok());
+  std::unique_ptr<HloProfilePrinterData> printer_data =
+      CreateHloProfilePrinterData(index_map, cost_analysis,
+                                  module->entry_computation()->name());
+  HloExecutionProfile profile(printer_data.get(), &index_map);
+  const HloInstruction* fusion =
+      module->entry_computation()->root_instruction();
+  profile.SetCyclesTakenBy(fusion, 1680);
+
+  FusionProfile fusion_profile;
+  fusion_profile.AddExecutionProfile(*module, profile);
+  fusion_profile.AddExecutionProfile(*module, profile);
+
+  EXPECT_EQ(fusion_profile.AverageCycles(*fusion), 1680);
+  // The exponential accounts for 8 transcendentals, which count as 20 flops
+  // each, and the add for 8 flops.
+  EXPECT_NEAR(*fusion_profile.AverageCycles(
+                  *FindInstruction(module.get(), "exp")),
+              1600, 1e-6);
+  EXPECT_NEAR(*fusion_profile.AverageCycles(
+                  *FindInstruction(module.get(), "add")),
+              80, 1e-6);
+  EXPECT_FALSE(fusion_profile
+                   .AverageCycles(*module->entry_computation()
+                                       ->parameter_instruction(0))
+                   .has_value());
+}
+
+TEST_F(FusionProfileTest, SaveAndLoad) {
+  const string hlo_string = R"(
+    HloModule m
+    ENTRY main {
+      x = f32[16] parameter(0)
+      ROOT negate = f32[16] negate(x)
+    }
+  )";
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnVerifiedModule(hlo_string).ValueOrDie();
+  const HloInstruction* negate =
+      module->entry_computation()->root_instruction();
+  const string path =
+      tensorflow::io::JoinPath(tensorflow::testing::TmpDir(), "fusion_profile");
+
+  FusionProfile missing = FusionProfile::Load(path + ".missing").ValueOrDie();
+  EXPECT_TRUE(missing.empty());
+
+  FusionProfile fusion_profile;
+  fusion_profile.AddCycles(*negate, 10);
+  fusion_profile.AddCycles(*negate, 30);
+  TF_ASSERT_OK(fusion_profile.Save(path));
+  FusionProfile loaded = FusionProfile::Load(path).ValueOrDie();
+  EXPECT_EQ(loaded.AverageCycles(*negate), 20);
+}
+
+TEST_F(FusionProfileTest, RecorderSavesPeriodicallyAndWhenDestroyed) {
+  const string hlo_string = R"(
+    HloModule m
+    ENTRY main {
+      x = f32[16] parameter(0)
+      ROOT negate = f32[16] negate(x)
+    }
+  )";
+  std::unique_ptr<HloModule> module =
+      ParseAndReturnVerifiedModule(hlo_string).ValueOrDie();
+  HloProfileIndexMap index_map(*module);
+  HloCostAnalysis cost_analysis([](const Shape& shape) {
+    return ShapeUtil::ByteSizeOf(shape, sizeof(void*));
+  });
+  ASSERT_TRUE(module->entry_computation()->Accept(&cost_analysis).ok());
+  std::unique_ptr<HloProfilePrinterData> printer_data =
+      CreateHloProfilePrinterData(index_map, cost_analysis,
+                                  module->entry_computation()->name());
+  const HloInstruction* negate =
+      module->entry_computation()->root_instruction();
+  HloExecutionProfile profile(printer_data.get(), &index_map);
+  profile.SetCyclesTakenBy(negate, 10);
+
+  const string path = tensorflow::io::JoinPath(tensorflow::testing::TmpDir(),
+                                               "fusion_profile_recorder");
+  tensorflow::Env::Default()->DeleteFile(path).IgnoreError();
+  {
+    FusionProfileRecorder recorder(path, module.get(),
+                                   /*seconds_between_saves=*/3600);
+    recorder.AddExecutionProfile(profile);
+    recorder.AddExecutionProfile(profile);
+    EXPECT_TRUE(FusionProfile::Load(path).ValueOrDie().empty());
+  }
+  FusionProfile loaded = FusionProfile::Load(path).ValueOrDie();
+  EXPECT_EQ(loaded.AverageCycles(*negate), 10);
+
+  profile.SetCyclesTakenBy(negate, 40);
+  FusionProfileRecorder recorder(path, module.get(),
+                                 /*seconds_between_saves=*/0);
+  recorder.AddExecutionProfile(profile);
+  loaded = FusionProfile::Load(path).ValueOrDie();
+  EXPECT_EQ(loaded.AverageCycles(*negate), 20);
+}
+
+class ProfileGuidedFusionTest : public HloTestBase {
+ protected:
+  // Runs CpuInstructionFusion on 'hlo_string' with a profile that measured
+  // 'cycles_per_element' for the instruction named "producer", and returns
+  // whether it was fused into its broadcast.
+  bool ProducerFused(const string& hlo_string,
+                     absl::optional<double> cycles_per_element) {
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnVerifiedModule(hlo_string).ValueOrDie();
+    const HloInstruction* producer = FindInstruction(module.get(), "producer");
+    FusionProfile fusion_profile;
+    if (cycles_per_element.has_value()) {
+      fusion_profile.AddCycles(
+          *producer,
+          *cycles_per_element * ShapeUtil::ElementsIn(producer->shape()));
+    }
+    CpuInstructionFusion(&fusion_profile).Run(module.get()).ValueOrDie();
+    return module->entry_computation()->root_instruction()->opcode() ==
+           HloOpcode::kFusion;
+  }
+};
+
+TEST_F(ProfileGuidedFusionTest, CheapTranscendentalIsDuplicated) {
+  const string hlo_string = R"(
+    HloModule m
+    ENTRY main {
+      x = f32[64] parameter(0)
+      producer = f32[64] exponential(x)
+      ROOT broadcast = f32[64,64] broadcast(producer), dimensions={0}
+    }
+  )";
+  EXPECT_FALSE(ProducerFused(hlo_string, absl::nullopt));
+  EXPECT_TRUE(ProducerFused(hlo_string, /*cycles_per_element=*/0.5));
+}
+
+TEST_F(ProfileGuidedFusionTest, ExpensiveArithmeticIsNotDuplicated) {
+  const string hlo_string = R"(
+    HloModule m
+    ENTRY main {
+      x = f32[64] parameter(0)
+      producer = f32[64] multiply(x, x)
+      ROOT broadcast = f32[64,64] broadcast(producer), dimensions={0}
+    }
+  )";
+  EXPECT_TRUE(ProducerFused(hlo_string, absl::nullopt));
+  EXPECT_FALSE(ProducerFused(hlo_string, /*cycles_per_element=*/20));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/cpu/ir_emission_utils.h"
 
+#include "absl/algorithm/container.h"
 #include "tensorflow/compiler/xla/layout_util.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
@@ -40,6 +41,85 @@ int64 GetMinimumAlignmentForArray(
       allocation_size_bytes);
 }
 
+bool PotentiallyImplementedAsPackedLlvmIrGemm(
+    const HloModuleConfig& config, const Shape& lhs_shape,
+    const Shape& rhs_shape, const Shape& result_shape) {
+  const int64 max_dimension =
+      config.debug_options().xla_cpu_packed_gemm_max_dimension();
+  if (max_dimension <= 0) {
+    return false;
+  }
+  if (lhs_shape.rank() != 2 || rhs_shape.rank() != 2 ||
+      result_shape.rank() != 2) {
+    return false;
+  }
+  if (result_shape.element_type() != F32 &&
+      result_shape.element_type() != F64) {
+    return false;
+  }
+  // Matrix-vector products are lowered to the tiled GEMV emitters instead.
+  if (result_shape.dimensions(0) <= 1 || result_shape.dimensions(1) <= 1) {
+    return false;
+  }
+  if (ShapeUtil::IsZeroElementArray(lhs_shape) ||
+      ShapeUtil::IsZeroElementArray(rhs_shape)) {
+    return false;
+  }
+  return absl::c_all_of(lhs_shape.dimensions(),
+                        [&](int64 dim) { return dim <= max_dimension; }) &&
+         absl::c_all_of(rhs_shape.dimensions(),
+                        [&](int64 dim) { return dim <= max_dimension; });
+}
+
+namespace {
+
+// Returns true if the window and dimension numbers of 'convolution' are those
+// the Eigen convolution runtime implements: a 1D or 2D convolution without
+// window reversal of an input in NHWC order with a kernel in HWIO order.
+bool HasEigenConvolutionWindowAndDimensions(
+    const HloInstruction& convolution) {
+  const Shape& input_shape = convolution.operand(0)->shape();
+  const Shape& kernel_shape = convolution.operand(1)->shape();
+  const Shape& output_shape = convolution.shape();
+
+  if (window_util::HasWindowReversal(convolution.window())) {
+    return false;
+  }
+
+  const ConvolutionDimensionNumbers& dnums =
+      convolution.convolution_dimension_numbers();
+  // Only 1D and 2D convolutions are supported at the moment.
+  // TODO(b/32897908): add an optimized implementation for 3D convolution.
+  const int64 num_spatial_dims = dnums.output_spatial_dimensions_size();
+  if (num_spatial_dims > 2) {
+    return false;
+  }
+
+  for (int64 i = 0; i < num_spatial_dims; ++i) {
+    if (dnums.input_spatial_dimensions(i) != i + 1) {
+      return false;
+    }
+    if (dnums.kernel_spatial_dimensions(i) != i) {
+      return false;
+    }
+    if (dnums.output_spatial_dimensions(i) != i + 1) {
+      return false;
+    }
+  }
+
+  return dnums.input_batch_dimension() == 0 &&
+         dnums.input_feature_dimension() == input_shape.dimensions_size() - 1 &&
+         dnums.output_batch_dimension() == 0 &&
+         dnums.output_feature_dimension() ==
+             output_shape.dimensions_size() - 1 &&
+         dnums.kernel_input_feature_dimension() ==
+             kernel_shape.dimensions_size() - 2 &&
+         dnums.kernel_output_feature_dimension() ==
+             kernel_shape.dimensions_size() - 1;
+}
+
+}  // namespace
+
 bool PotentiallyImplementedAsEigenConvolution(
     const HloInstruction& convolution,
     const TargetMachineFeatures& target_machine_features) {
@@ -76,40 +156,60 @@ bool PotentiallyImplementedAsEigenConvolution(
   if (primitive_type != F16 && primitive_type != F32) {
     return false;
   }
-  if (window_util::HasWindowReversal(convolution.window())) {
+  return HasEigenConvolutionWindowAndDimensions(convolution);
+}
+
+bool IsS8ToS32Convert(const HloInstruction& instruction) {
+  return instruction.opcode() == HloOpcode::kConvert &&
+         instruction.shape().element_type() == S32 &&
+         instruction.operand(0)->shape().element_type() == S8;
+}
+
+bool PotentiallyImplementedAsInt8Kernel(const HloInstruction& instruction) {
+  if (instruction.shape().element_type() != S32) {
     return false;
   }
-
-  const ConvolutionDimensionNumbers& dnums =
-      convolution.convolution_dimension_numbers();
-  // Only 1D and 2D convolutions are supported at the moment.
-  // TODO(b/32897908): add an optimized implementation for 3D convolution.
-  const int64 num_spatial_dims = dnums.output_spatial_dimensions_size();
-  if (num_spatial_dims > 2) {
+  const Shape& lhs_shape = instruction.operand(0)->shape();
+  const Shape& rhs_shape = instruction.operand(1)->shape();
+  const Shape& result_shape = instruction.shape();
+  if (ShapeUtil::IsZeroElementArray(lhs_shape) ||
+      ShapeUtil::IsZeroElementArray(rhs_shape)) {
     return false;
   }
-
-  for (int64 i = 0; i < num_spatial_dims; ++i) {
-    if (dnums.input_spatial_dimensions(i) != i + 1) {
-      return false;
-    }
-    if (dnums.kernel_spatial_dimensions(i) != i) {
-      return false;
-    }
-    if (dnums.output_spatial_dimensions(i) != i + 1) {
+  if (!LayoutUtil::IsMonotonicWithDim0Major(lhs_shape.layout()) ||
+      !LayoutUtil::IsMonotonicWithDim0Major(rhs_shape.layout()) ||
+      !LayoutUtil::IsMonotonicWithDim0Major(result_shape.layout())) {
+    return false;
+  }
+  switch (instruction.opcode()) {
+    case HloOpcode::kDot:
+      // Matrix-vector products are lowered to the tiled GEMV emitters instead.
+      return lhs_shape.rank() == 2 && rhs_shape.rank() == 2 &&
+             result_shape.rank() == 2 && result_shape.dimensions(0) > 1 &&
+             result_shape.dimensions(1) > 1;
+    case HloOpcode::kConvolution:
+      return instruction.feature_group_count() == 1 &&
+             instruction.batch_group_count() == 1 &&
+             HasEigenConvolutionWindowAndDimensions(instruction);
+    default:
       return false;
-    }
   }
+}
 
-  return dnums.input_batch_dimension() == 0 &&
-         dnums.input_feature_dimension() == input_shape.dimensions_size() - 1 &&
-         dnums.output_batch_dimension() == 0 &&
-         dnums.output_feature_dimension() ==
-             output_shape.dimensions_size() - 1 &&
-         dnums.kernel_input_feature_dimension() ==
-             kernel_shape.dimensions_size() - 2 &&
-         dnums.kernel_output_feature_dimension() ==
-             kernel_shape.dimensions_size() - 1;
+bool IsInt8KernelFusion(const HloInstruction& fusion) {
+  if (!fusion.IsLoopFusion()) {
+    return false;
+  }
+  const HloInstruction* root = fusion.fused_expression_root();
+  if (!PotentiallyImplementedAsInt8Kernel(*root)) {
+    return false;
+  }
+  return absl::c_all_of(root->operands(), [](const HloInstruction* operand) {
+    return IsS8ToS32Convert(*operand) &&
+           operand->operand(0)->opcode() == HloOpcode::kParameter &&
+           LayoutUtil::IsMonotonicWithDim0Major(
+               operand->operand(0)->shape().layout());
+  });
 }
 
 }  // namespace cpu
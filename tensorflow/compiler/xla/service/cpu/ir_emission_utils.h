@@ -19,6 +19,7 @@ limitations under the License.
 #include "llvm/IR/Value.h"
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features.h"
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
 
 namespace xla {
 namespace cpu {
@@ -27,6 +28,30 @@ bool PotentiallyImplementedAsEigenConvolution(
     const HloInstruction& convolution,
     const TargetMachineFeatures& target_machine_features);
 
+// Returns true if a non-batch dot of the given shapes is lowered to the packed
+// GEMM emitter (see EmitPackedGemm), i.e. if it is a matrix-matrix product of
+// F32 or F64 whose dimensions are all at most the
+// xla_cpu_packed_gemm_max_dimension debug option.
+bool PotentiallyImplementedAsPackedLlvmIrGemm(
+    const HloModuleConfig& config, const Shape& lhs_shape,
+    const Shape& rhs_shape, const Shape& result_shape);
+
+// Returns true if `instruction` is a convert from S8 to S32.
+bool IsS8ToS32Convert(const HloInstruction& instruction);
+
+// Returns true if `instruction` is an S32 dot or convolution that can be
+// lowered to the int8 runtime kernels when its operands are S8 arrays
+// converted to S32, as in the int8 x int8 -> int32 products of quantized
+// models. The dot must be a matrix-matrix product, the convolution must be one
+// the Eigen convolution runtime implements, and all layouts must be row-major.
+bool PotentiallyImplementedAsInt8Kernel(const HloInstruction& instruction);
+
+// Returns true if `fusion` is a loop fusion of a dot or convolution satisfying
+// PotentiallyImplementedAsInt8Kernel with the S8 to S32 converts of its
+// row-major operands, which is emitted as a call to the int8 runtime kernels
+// on the S8 operands of the fusion.
+bool IsInt8KernelFusion(const HloInstruction& fusion);
+
 // Computes the minimum alignment guaranteed for a tensor of shape `shape` on
 // the target machine.
 int64 GetMinimumAlignmentForArray(
@@ -47,6 +47,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/primitive_util.h"
 #include "tensorflow/compiler/xla/service/buffer_assignment.h"
 #include "tensorflow/compiler/xla/service/collective_ops_utils.h"
+#include "tensorflow/compiler/xla/service/cpu/backend_configs.pb.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_options.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
 #include "tensorflow/compiler/xla/service/cpu/dot_op_emitter.h"
@@ -624,14 +625,23 @@ Status IrEmitter::HandleSort(HloInstruction* hlo) {
     lower_dimensions *= normalized_keys_shape.dimensions(i);
   }
 
+  // PartialSortAssignment may have found that only the first elements of the
+  // sort dimension are read.
+  TF_ASSIGN_OR_RETURN(SortBackendConfig backend_config,
+                      sort->backend_config<SortBackendConfig>());
+  int64 num_sorted_elements = backend_config.num_sorted_elements() > 0
+                                  ? backend_config.num_sorted_elements()
+                                  : sort_dimension_elements;
+
   auto less_than_function = FindOrDie(emitted_functions_, sort->to_apply());
   CHECK(absl::c_binary_search(thread_local_computations_, sort->to_apply()));
   llvm::FunctionType* key_value_sort_type = llvm::FunctionType::get(
       b_.getVoidTy(),
       {b_.getInt64Ty(), b_.getInt64Ty(), b_.getInt64Ty(),
        b_.getInt8PtrTy()->getPointerTo(), b_.getInt32Ty(),
-       b_.getInt32Ty()->getPointerTo(), b_.getInt1Ty(), b_.getInt8PtrTy(),
-       b_.getInt64Ty()->getPointerTo(), less_than_function->getType()},
+       b_.getInt32Ty()->getPointerTo(), b_.getInt1Ty(), b_.getInt64Ty(),
+       b_.getInt8PtrTy(), b_.getInt64Ty()->getPointerTo(),
+       less_than_function->getType()},
       /*isVarArg=*/false);
   auto* key_value_sort_func = llvm::dyn_cast<llvm::Function>(
       module_
@@ -663,8 +673,9 @@ Status IrEmitter::HandleSort(HloInstruction* hlo) {
        {b_.getInt64(higher_dimensions), b_.getInt64(sort_dimension_elements),
         b_.getInt64(lower_dimensions), values,
         b_.getInt32(sort->operand_count()), sizes,
-        b_.getInt1(sort->is_stable()), GetExecutableRunOptionsArgument(),
-        GetProfileCountersArgument(), less_than_function});
+        b_.getInt1(sort->is_stable()), b_.getInt64(num_sorted_elements),
+        GetExecutableRunOptionsArgument(), GetProfileCountersArgument(),
+        less_than_function});
 
   if (sort->values_count() > 0) {
     llvm_ir::EmitTuple(GetIrArrayFor(sort), destination_addresses, &b_);
@@ -897,9 +908,17 @@ Status IrEmitter::HandleDot(HloInstruction* dot) {
   VLOG(2) << "  target: "
           << llvm_ir::DumpToString(*target_array.GetBasePointer());
 
+  // ParallelTaskAssigner may have split a batch dot into parallel tasks.
+  const bool is_parallel_task = ShouldEmitParallelLoopFor(*dot);
+  DynamicLoopBounds dynamic_loop_bounds;
+  if (is_parallel_task) {
+    dynamic_loop_bounds = compute_function_->GetDynamicLoopBounds();
+  }
+
   // Dot operation is complicated so we delegate to a helper class.
   return EmitDotOperation(*dot, target_array, lhs_array, rhs_array,
                           /*addend_array=*/nullptr,
+                          is_parallel_task ? &dynamic_loop_bounds : nullptr,
                           GetExecutableRunOptionsArgument(), &b_, mlir_context_,
                           hlo_module_config_, target_machine_features_);
 }
@@ -1042,6 +1061,11 @@ StatusOr<llvm::Value*> IrEmitter::EmitElementalConvolution(
                                        b_.getInt64Ty());
   TF_ASSIGN_OR_RETURN(llvm::Value* const kernel_value,
                       kernel_generator(kernel_index));
+  if (primitive_util::IsIntegralType(lhs_element_type)) {
+    Store(Add(Load(sum_address), Mul(input_value, kernel_value)), sum_address);
+    SetToFirstInsertPoint(loops.GetOuterLoopExitBasicBlock(), &b_);
+    return Load(sum_address);
+  }
   llvm::Value* product = FMul(input_value, kernel_value);
   llvm::Value* sum = FAdd(Load(sum_address), FPCast(product, accumulator_type));
   Store(sum, sum_address);
@@ -1050,12 +1074,165 @@ StatusOr<llvm::Value*> IrEmitter::EmitElementalConvolution(
   return FPCast(Load(sum_address), lhs_llvm_type);
 }
 
+Status IrEmitter::EmitCallToEigenConvolution(const HloInstruction& convolution,
+                                             llvm::Value* output_address,
+                                             llvm::Value* lhs_address,
+                                             llvm::Value* rhs_address,
+                                             PrimitiveType input_type) {
+  // We lower 1D convolutions into calls to the same Eigen function as 2D
+  // convolutions, except that we pretend that the 1D convolution is really
+  // a 2D convolution with the missing dimension set to 1.  We also adjust
+  // the padding, dilation parameters as needed.
+  bool one_dim_convolution =
+      convolution.operand(0)->shape().dimensions_size() == 3;
+
+  const ConvolutionDimensionNumbers& dnums =
+      convolution.convolution_dimension_numbers();
+
+  // Input tensor.
+  const Shape& input_shape = convolution.operand(0)->shape();
+  int64 input_batch = input_shape.dimensions(dnums.input_batch_dimension());
+  int64 input_rows = input_shape.dimensions(dnums.input_spatial_dimensions(0));
+  int64 input_cols =
+      one_dim_convolution
+          ? 1
+          : input_shape.dimensions(dnums.input_spatial_dimensions(1));
+  int64 input_channels =
+      input_shape.dimensions(dnums.input_feature_dimension());
+
+  // Kernel tensor.
+  const Shape& kernel_shape = convolution.operand(1)->shape();
+  int64 kernel_rows =
+      kernel_shape.dimensions(dnums.kernel_spatial_dimensions(0));
+  int64 kernel_cols =
+      one_dim_convolution
+          ? 1
+          : kernel_shape.dimensions(dnums.kernel_spatial_dimensions(1));
+  int64 kernel_channels =
+      kernel_shape.dimensions(dnums.kernel_input_feature_dimension());
+  int64 kernel_filters =
+      kernel_shape.dimensions(dnums.kernel_output_feature_dimension());
+
+  // Output tensor.
+  const Shape& convolution_shape = convolution.shape();
+  int64 output_rows =
+      convolution_shape.dimensions(dnums.output_spatial_dimensions(0));
+  int64 output_cols = one_dim_convolution
+                          ? 1
+                          : convolution_shape.dimensions(
+                                dnums.output_spatial_dimensions(1));
+
+  // Extract the window stride for the convolution.
+  const Window& window = convolution.window();
+  int64 row_stride = window.dimensions(0).stride();
+  int64 col_stride = one_dim_convolution ? 1 : window.dimensions(1).stride();
+
+  int64 padding_top = window.dimensions(0).padding_low();
+  int64 padding_bottom = window.dimensions(0).padding_high();
+  int64 padding_left =
+      one_dim_convolution ? 0 : window.dimensions(1).padding_low();
+  int64 padding_right =
+      one_dim_convolution ? 0 : window.dimensions(1).padding_high();
+
+  int64 lhs_row_dilation = window.dimensions(0).base_dilation();
+  int64 lhs_col_dilation =
+      one_dim_convolution ? 1 : window.dimensions(1).base_dilation();
+  int64 rhs_row_dilation = window.dimensions(0).window_dilation();
+  int64 rhs_col_dilation =
+      one_dim_convolution ? 1 : window.dimensions(1).window_dilation();
+
+  bool multi_threaded =
+      hlo_module_config_.debug_options().xla_cpu_multi_thread_eigen();
+  bool use_mkl_dnn = hlo_module_config_.debug_options().xla_cpu_use_mkl_dnn();
+
+  llvm::Type* input_ptr_type;
+  llvm::Type* output_ptr_type;
+  const char* fn_name;
+  switch (input_type) {
+    case F16:
+      input_ptr_type = output_ptr_type = b_.getHalfTy()->getPointerTo();
+      fn_name = multi_threaded
+                    ? runtime::kEigenConvF16SymbolName
+                    : runtime::kEigenSingleThreadedConvF16SymbolName;
+      break;
+    case F32:
+      input_ptr_type = output_ptr_type = b_.getFloatTy()->getPointerTo();
+      // TODO(b/78639006) Singlethread MKL conv2d is not implemented due to the
+      // potential race condition by setting the omp_num_threads.
+      fn_name = multi_threaded
+                    ? (use_mkl_dnn ? runtime::kMKLConvF32SymbolName
+                                   : runtime::kEigenConvF32SymbolName)
+                    : runtime::kEigenSingleThreadedConvF32SymbolName;
+      if (!multi_threaded && use_mkl_dnn) {
+        LOG(WARNING) << "Using Eigen instead of MKL-DNN for single-threaded "
+                        "conv2d function.";
+      }
+      break;
+    case S8:
+      // The int8 operands of an int8 x int8 -> int32 convolution, see
+      // IsInt8KernelFusion.
+      input_ptr_type = b_.getInt8Ty()->getPointerTo();
+      output_ptr_type = b_.getInt32Ty()->getPointerTo();
+      fn_name = multi_threaded
+                    ? runtime::kEigenConvS8S32SymbolName
+                    : runtime::kEigenSingleThreadedConvS8S32SymbolName;
+      break;
+    default:
+      return Unimplemented("Invalid type %s for Eigen convolution",
+                           PrimitiveType_Name(input_type));
+  }
+
+  llvm::Type* int64_type = b_.getInt64Ty();
+  llvm::Type* int8_ptr_type = b_.getInt8Ty()->getPointerTo();
+  llvm::FunctionType* conv_type = llvm::FunctionType::get(
+      b_.getVoidTy(),
+      {int8_ptr_type, output_ptr_type, input_ptr_type, input_ptr_type,
+       int64_type,    int64_type,      int64_type,     int64_type,
+       int64_type,    int64_type,      int64_type,     int64_type,
+       int64_type,    int64_type,      int64_type,     int64_type,
+       int64_type,    int64_type,      int64_type,     int64_type,
+       int64_type,    int64_type,      int64_type,     int64_type},
+      /*isVarArg=*/false);
+  llvm::Function* conv_func = llvm::dyn_cast<llvm::Function>(
+      module_->getOrInsertFunction(fn_name, conv_type).getCallee());
+  conv_func->setCallingConv(llvm::CallingConv::C);
+  conv_func->setDoesNotThrow();
+  conv_func->setOnlyAccessesArgMemory();
+  Call(conv_func, {
+                      GetExecutableRunOptionsArgument(),
+                      BitCast(output_address, output_ptr_type),
+                      BitCast(lhs_address, input_ptr_type),
+                      BitCast(rhs_address, input_ptr_type),
+                      b_.getInt64(input_batch),
+                      b_.getInt64(input_rows),
+                      b_.getInt64(input_cols),
+                      b_.getInt64(input_channels),
+                      b_.getInt64(kernel_rows),
+                      b_.getInt64(kernel_cols),
+                      b_.getInt64(kernel_channels),
+                      b_.getInt64(kernel_filters),
+                      b_.getInt64(output_rows),
+                      b_.getInt64(output_cols),
+                      b_.getInt64(row_stride),
+                      b_.getInt64(col_stride),
+                      b_.getInt64(padding_top),
+                      b_.getInt64(padding_bottom),
+                      b_.getInt64(padding_left),
+                      b_.getInt64(padding_right),
+                      b_.getInt64(lhs_row_dilation),
+                      b_.getInt64(lhs_col_dilation),
+                      b_.getInt64(rhs_row_dilation),
+                      b_.getInt64(rhs_col_dilation),
+                  });
+  return Status::OK();
+}
+
 Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
   auto lhs = convolution->operand(0);
   auto rhs = convolution->operand(1);
   TF_RETURN_IF_ERROR(ElementTypesSameAndSupported(
       /*instruction=*/*convolution, /*operands=*/{lhs, rhs},
-      /*supported_types=*/{F16, F32, F64, C64, C128}));
+      /*supported_types=*/{S32, F16, F32, F64, C64, C128}));
 
   // TODO(tonywy): Add PotentiallyImplementedAsMKLConvolution to support
   // different data layouts.
@@ -1068,139 +1245,11 @@ Status IrEmitter::HandleConvolution(HloInstruction* convolution) {
     if (LayoutUtil::IsMonotonicWithDim0Major(lhs_shape.layout()) &&
         LayoutUtil::IsMonotonicWithDim0Major(rhs_shape.layout()) &&
         LayoutUtil::IsMonotonicWithDim0Major(convolution_shape.layout())) {
-      // We lower 1D convolutions into calls to the same Eigen function as 2D
-      // convolutions, except that we pretend that the 1D convolution is really
-      // a 2D convolution with the missing dimension set to 1.  We also adjust
-      // the padding, dilation parameters as needed.
-      bool one_dim_convolution = lhs_shape.dimensions_size() == 3;
-      llvm::Value* lhs_address = GetEmittedValueFor(lhs);
-      llvm::Value* rhs_address = GetEmittedValueFor(rhs);
       TF_RETURN_IF_ERROR(EmitTargetAddressForOp(convolution));
-
-      const ConvolutionDimensionNumbers& dnums =
-          convolution->convolution_dimension_numbers();
-
-      // Input tensor.
-      const Shape& input_shape = convolution->operand(0)->shape();
-      int64 input_batch = input_shape.dimensions(dnums.input_batch_dimension());
-      int64 input_rows =
-          input_shape.dimensions(dnums.input_spatial_dimensions(0));
-      int64 input_cols =
-          one_dim_convolution
-              ? 1
-              : input_shape.dimensions(dnums.input_spatial_dimensions(1));
-      int64 input_channels =
-          input_shape.dimensions(dnums.input_feature_dimension());
-
-      // Kernel tensor.
-      const Shape& kernel_shape = convolution->operand(1)->shape();
-      int64 kernel_rows =
-          kernel_shape.dimensions(dnums.kernel_spatial_dimensions(0));
-      int64 kernel_cols =
-          one_dim_convolution
-              ? 1
-              : kernel_shape.dimensions(dnums.kernel_spatial_dimensions(1));
-      int64 kernel_channels =
-          kernel_shape.dimensions(dnums.kernel_input_feature_dimension());
-      int64 kernel_filters =
-          kernel_shape.dimensions(dnums.kernel_output_feature_dimension());
-
-      // Output tensor.
-      const Shape& convolution_shape = convolution->shape();
-      int64 output_rows =
-          convolution_shape.dimensions(dnums.output_spatial_dimensions(0));
-      int64 output_cols = one_dim_convolution
-                              ? 1
-                              : convolution_shape.dimensions(
-                                    dnums.output_spatial_dimensions(1));
-
-      // Extract the window stride for the convolution.
-      const Window& window = convolution->window();
-      int64 row_stride = window.dimensions(0).stride();
-      int64 col_stride =
-          one_dim_convolution ? 1 : window.dimensions(1).stride();
-
-      int64 padding_top = window.dimensions(0).padding_low();
-      int64 padding_bottom = window.dimensions(0).padding_high();
-      int64 padding_left =
-          one_dim_convolution ? 0 : window.dimensions(1).padding_low();
-      int64 padding_right =
-          one_dim_convolution ? 0 : window.dimensions(1).padding_high();
-
-      int64 lhs_row_dilation = window.dimensions(0).base_dilation();
-      int64 lhs_col_dilation =
-          one_dim_convolution ? 1 : window.dimensions(1).base_dilation();
-      int64 rhs_row_dilation = window.dimensions(0).window_dilation();
-      int64 rhs_col_dilation =
-          one_dim_convolution ? 1 : window.dimensions(1).window_dilation();
-
-      PrimitiveType primitive_type = lhs->shape().element_type();
-      llvm::Type* ir_ptr_type = primitive_type == F16
-                                    ? b_.getHalfTy()->getPointerTo()
-                                    : b_.getFloatTy()->getPointerTo();
-      llvm::Type* int64_type = b_.getInt64Ty();
-      llvm::Type* int8_ptr_type = b_.getInt8Ty()->getPointerTo();
-      llvm::FunctionType* conv_type = llvm::FunctionType::get(
-          b_.getVoidTy(),
-          {int8_ptr_type, ir_ptr_type, ir_ptr_type, ir_ptr_type, int64_type,
-           int64_type,    int64_type,  int64_type,  int64_type,  int64_type,
-           int64_type,    int64_type,  int64_type,  int64_type,  int64_type,
-           int64_type,    int64_type,  int64_type,  int64_type,  int64_type,
-           int64_type,    int64_type,  int64_type,  int64_type},
-          /*isVarArg=*/false);
-      bool multi_threaded =
-          hlo_module_config_.debug_options().xla_cpu_multi_thread_eigen();
-      bool use_mkl_dnn =
-          hlo_module_config_.debug_options().xla_cpu_use_mkl_dnn();
-
-      // TODO(b/78639006) Singlethread MKL conv2d is not implemented due to the
-      // potential race condition by setting the omp_num_threads.
-      const char* fn_name =
-          primitive_type == F16
-              ? (multi_threaded
-                     ? runtime::kEigenConvF16SymbolName
-                     : runtime::kEigenSingleThreadedConvF16SymbolName)
-              : (multi_threaded
-                     ? (use_mkl_dnn ? runtime::kMKLConvF32SymbolName
-                                    : runtime::kEigenConvF32SymbolName)
-                     : runtime::kEigenSingleThreadedConvF32SymbolName);
-      if (!multi_threaded && use_mkl_dnn) {
-        LOG(WARNING) << "Using Eigen instead of MKL-DNN for single-threaded "
-                        "conv2d function.";
-      }
-      llvm::Function* conv_func = llvm::dyn_cast<llvm::Function>(
-          module_->getOrInsertFunction(fn_name, conv_type).getCallee());
-      conv_func->setCallingConv(llvm::CallingConv::C);
-      conv_func->setDoesNotThrow();
-      conv_func->setOnlyAccessesArgMemory();
-      Call(conv_func, {
-                          GetExecutableRunOptionsArgument(),
-                          BitCast(GetEmittedValueFor(convolution), ir_ptr_type),
-                          BitCast(lhs_address, ir_ptr_type),
-                          BitCast(rhs_address, ir_ptr_type),
-                          b_.getInt64(input_batch),
-                          b_.getInt64(input_rows),
-                          b_.getInt64(input_cols),
-                          b_.getInt64(input_channels),
-                          b_.getInt64(kernel_rows),
-                          b_.getInt64(kernel_cols),
-                          b_.getInt64(kernel_channels),
-                          b_.getInt64(kernel_filters),
-                          b_.getInt64(output_rows),
-                          b_.getInt64(output_cols),
-                          b_.getInt64(row_stride),
-                          b_.getInt64(col_stride),
-                          b_.getInt64(padding_top),
-                          b_.getInt64(padding_bottom),
-                          b_.getInt64(padding_left),
-                          b_.getInt64(padding_right),
-                          b_.getInt64(lhs_row_dilation),
-                          b_.getInt64(lhs_col_dilation),
-                          b_.getInt64(rhs_row_dilation),
-                          b_.getInt64(rhs_col_dilation),
-                      });
-
-      return Status::OK();
+      return EmitCallToEigenConvolution(
+          *convolution, GetEmittedValueFor(convolution),
+          GetEmittedValueFor(lhs), GetEmittedValueFor(rhs),
+          lhs_shape.element_type());
     }
   }
 
@@ -2276,6 +2325,9 @@ Status IrEmitter::HandleFusion(HloInstruction* fusion) {
     return llvm_ir::EmitFusedDynamicUpdateSliceInPlace(
         fusion, GetGeneratorForOperandIrArrays(fusion), GetIrArrayFor(fusion),
         &elemental_emitter, &b_);
+  } else if (IsInt8KernelFusion(*fusion)) {
+    VLOG(3) << "HandleFusion int8 kernel";
+    return EmitInt8KernelFusion(fusion);
   } else if (fusion->IsLoopFusion()) {
     VLOG(3) << "HandleFusion kLoop";
     CpuElementalIrEmitter elemental_emitter(hlo_module_config_, this, module_);
@@ -2311,14 +2363,36 @@ Status IrEmitter::HandleFusion(HloInstruction* fusion) {
 
     TF_RETURN_IF_ERROR(EmitDotOperation(
         *dot, target_array, lhs_array, rhs_array, &addend_array,
-        GetExecutableRunOptionsArgument(), &b_, mlir_context_,
-        hlo_module_config_, target_machine_features_));
+        /*dynamic_loop_bounds=*/nullptr, GetExecutableRunOptionsArgument(), &b_,
+        mlir_context_, hlo_module_config_, target_machine_features_));
     return Status::OK();
   } else {
     return Unimplemented("Fusion kind not implemented on CPU");
   }
 }
 
+Status IrEmitter::EmitInt8KernelFusion(HloInstruction* fusion) {
+  const HloInstruction* root = fusion->fused_expression_root();
+  // The operands of the fusion that the converts fused into it read.
+  const HloInstruction* lhs =
+      fusion->operand(root->operand(0)->operand(0)->parameter_number());
+  const HloInstruction* rhs =
+      fusion->operand(root->operand(1)->operand(0)->parameter_number());
+  TF_RETURN_IF_ERROR(EmitTargetAddressForOp(fusion));
+
+  if (root->opcode() == HloOpcode::kConvolution) {
+    return EmitCallToEigenConvolution(*root, GetEmittedValueFor(fusion),
+                                      GetEmittedValueFor(lhs),
+                                      GetEmittedValueFor(rhs), S8);
+  }
+  TF_RET_CHECK(root->opcode() == HloOpcode::kDot);
+  return EmitDotOperation(*root, GetIrArrayFor(fusion), GetIrArrayFor(lhs),
+                          GetIrArrayFor(rhs), /*addend_array=*/nullptr,
+                          /*dynamic_loop_bounds=*/nullptr,
+                          GetExecutableRunOptionsArgument(), &b_, mlir_context_,
+                          hlo_module_config_, target_machine_features_);
+}
+
 Status IrEmitter::HandleCall(HloInstruction* call) {
   HloComputation* computation = call->to_apply();
   llvm::Function* call_ir_function = FindOrDie(emitted_functions_, computation);
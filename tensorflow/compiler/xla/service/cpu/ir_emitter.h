@@ -331,6 +331,21 @@ class IrEmitter : public DfsHloVisitorWithDefault,
   // calling GetIrArrayForOp or GetEmittedValueFor.
   Status EmitTargetAddressForOp(const HloInstruction* op);
 
+  // Emits a call to the Eigen convolution runtime that convolves the input at
+  // `lhs_address` with the kernel at `rhs_address` as specified by
+  // `convolution`, and writes the result to `output_address`. `input_type` is
+  // the element type of the input and kernel, which is S8 for the int8 x int8
+  // -> int32 convolutions of IsInt8KernelFusion.
+  Status EmitCallToEigenConvolution(const HloInstruction& convolution,
+                                    llvm::Value* output_address,
+                                    llvm::Value* lhs_address,
+                                    llvm::Value* rhs_address,
+                                    PrimitiveType input_type);
+
+  // Emits a fusion satisfying IsInt8KernelFusion as a call to the int8 runtime
+  // kernels on the S8 operands of the fusion.
+  Status EmitInt8KernelFusion(HloInstruction* fusion);
+
   // Structurizes "array_elements" into an MD array that represents "shape".
   // This is a recursive function, and "dimension_index" indicates the index of
   // the current dimension that the function is considering (0 means the
@@ -0,0 +1,145 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/llvm_module_splitter.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Internal functions with at most this many instructions are copied into
+// every part rather than assigned to one.
+constexpr int64 kMaxInstructionsOfCopiedFunction = 64;
+
+int64 NumInstructions(const llvm::Function& function) {
+  int64 num_instructions = 0;
+  for (const llvm::BasicBlock& block : function) {
+    num_instructions += block.size();
+  }
+  return num_instructions;
+}
+
+// Returns true if 'value' is defined in every part.
+bool IsCopiedIntoEveryPart(const llvm::GlobalValue& value) {
+  // Intrinsic globals like llvm.used can't be declared without a definition.
+  if (value.getName().startswith("llvm.")) {
+    return true;
+  }
+  const auto* function = llvm::dyn_cast<llvm::Function>(&value);
+  return function != nullptr && !function->isDeclaration() &&
+         function->hasLocalLinkage() &&
+         NumInstructions(*function) <= kMaxInstructionsOfCopiedFunction;
+}
+
+std::string ModuleToBitcode(const llvm::Module& module) {
+  std::string bitcode;
+  llvm::raw_string_ostream stream(bitcode);
+  llvm::WriteBitcodeToFile(module, stream);
+  stream.flush();
+  return bitcode;
+}
+
+}  // namespace
+
+std::vector<std::string> SplitModuleToBitcode(llvm::Module* module,
+                                              int max_num_parts) {
+  absl::flat_hash_set<const llvm::GlobalValue*> copied_values;
+  for (const llvm::GlobalValue& value : module->global_values()) {
+    if (IsCopiedIntoEveryPart(value)) {
+      copied_values.insert(&value);
+    }
+  }
+
+  // Functions that are defined in exactly one part, the largest first.
+  std::vector<std::pair<int64, llvm::Function*>> functions;
+  for (llvm::Function& function : *module) {
+    if (!function.isDeclaration() && !copied_values.contains(&function)) {
+      functions.emplace_back(NumInstructions(function), &function);
+    }
+  }
+  const int num_parts =
+      std::min<int64>(max_num_parts, static_cast<int64>(functions.size()));
+  if (num_parts <= 1) {
+    return {};
+  }
+  std::stable_sort(functions.begin(), functions.end(),
+                   [](const std::pair<int64, llvm::Function*>& a,
+                      const std::pair<int64, llvm::Function*>& b) {
+                     return a.first > b.first;
+                   });
+
+  // Assigns each function to the part with the fewest instructions so far.
+  absl::flat_hash_map<const llvm::GlobalValue*, int> part_of_function;
+  std::vector<int64> part_sizes(num_parts, 0);
+  for (const auto& size_and_function : functions) {
+    const int part =
+        std::min_element(part_sizes.begin(), part_sizes.end()) -
+        part_sizes.begin();
+    part_sizes[part] += size_and_function.first;
+    part_of_function[size_and_function.second] = part;
+  }
+
+  // Parts refer to the symbols defined in other parts by name, so those need
+  // to be external, and named.
+  for (llvm::GlobalValue& value : module->global_values()) {
+    if (!value.hasLocalLinkage() || copied_values.contains(&value)) {
+      continue;
+    }
+    if (!value.hasName()) {
+      value.setName("__xla_cpu_split");
+    }
+    value.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    value.setVisibility(llvm::GlobalValue::DefaultVisibility);
+  }
+
+  std::vector<std::string> parts;
+  parts.reserve(num_parts);
+  for (int part = 0; part < num_parts; ++part) {
+    llvm::ValueToValueMapTy value_map;
+    std::unique_ptr<llvm::Module> part_module = llvm::CloneModule(
+        *module, value_map, [&](const llvm::GlobalValue* value) {
+          if (copied_values.contains(value)) {
+            return true;
+          }
+          auto it = part_of_function.find(value);
+          return it == part_of_function.end() ? part == 0 : it->second == part;
+        });
+    part_module->setModuleIdentifier(
+        absl::StrCat(module->getModuleIdentifier(), ".part", part));
+    VLOG(2) << "Part " << part << " of " << module->getModuleIdentifier()
+            << " has " << part_sizes[part] << " instructions";
+    parts.push_back(ModuleToBitcode(*part_module));
+  }
+  return parts;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,47 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_LLVM_MODULE_SPLITTER_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_LLVM_MODULE_SPLITTER_H_
+
+#include <string>
+#include <vector>
+
+#include "llvm/IR/Module.h"
+
+namespace xla {
+namespace cpu {
+
+// Splits 'module' into at most 'max_num_parts' modules that can be optimized
+// and compiled to machine code independently, then linked together.
+//
+// The functions of the computations are assigned to the parts so that the
+// parts have about as many instructions each. Internal functions that are
+// small enough, like the reducers and comparators of reductions and sorts,
+// are instead copied into every part, so that they can still be inlined into
+// their callers. Global variables, which hold the constants, are defined in
+// the first part. Symbols that are referred to across parts are made
+// external, which changes 'module'.
+//
+// The parts are returned as bitcode, so that each can be parsed into its own
+// llvm::LLVMContext and compiled on its own thread. Returns no parts, and
+// leaves 'module' unchanged, if it has too few functions to be split.
+std::vector<std::string> SplitModuleToBitcode(llvm::Module* module,
+                                              int max_num_parts);
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_LLVM_MODULE_SPLITTER_H_
@@ -0,0 +1,146 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/llvm_module_splitter.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns the IR of an internal function that adds one to its argument
+// 'num_adds' times, reading the constant @table if 'reads_table'.
+std::string AddingFunction(const std::string& name, int num_adds,
+                           bool reads_table = false) {
+  std::string ir =
+      absl::StrCat("define internal i32 @", name, "(i32 %x) {\n  %v0 = ",
+                   reads_table ? "load i32, i32* getelementptr ([4 x i32], "
+                                 "[4 x i32]* @table, i32 0, i32 1)\n"
+                               : "add i32 %x, 0\n");
+  for (int i = 1; i <= num_adds; ++i) {
+    absl::StrAppend(&ir, "  %v", i, " = add i32 %v", i - 1, ", 1\n");
+  }
+  absl::StrAppend(&ir, "  ret i32 %v", num_adds, "\n}\n");
+  return ir;
+}
+
+class LlvmModuleSplitterTest : public ::testing::Test {
+ protected:
+  std::unique_ptr<llvm::Module> ParseModule(const std::string& ir) {
+    llvm::SMDiagnostic diagnostic;
+    std::unique_ptr<llvm::Module> module =
+        llvm::parseAssemblyString(ir, diagnostic, context_);
+    CHECK(module != nullptr) << diagnostic.getMessage().str();
+    return module;
+  }
+
+  std::unique_ptr<llvm::Module> ParsePart(const std::string& bitcode) {
+    std::unique_ptr<llvm::Module> part = llvm::cantFail(llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(bitcode, "part"), context_));
+    CHECK(!llvm::verifyModule(*part, &llvm::errs()));
+    return part;
+  }
+
+  // Returns true if 'part' has a definition of 'name'.
+  static bool Defines(const llvm::Module& part, const std::string& name) {
+    const llvm::GlobalValue* value = part.getNamedValue(name);
+    return value != nullptr && !value->isDeclaration();
+  }
+
+  llvm::LLVMContext context_;
+};
+
+TEST_F(LlvmModuleSplitterTest, SplitsFunctionsAcrossParts) {
+  std::unique_ptr<llvm::Module> module = ParseModule(absl::StrCat(
+      "@table = private constant [4 x i32] [i32 1, i32 2, i32 3, i32 4]\n",
+      AddingFunction("big", 200), AddingFunction("bigger", 300, true),
+      AddingFunction("small", 2),
+      "define i32 @entry(i32 %x) {\n"
+      "  %a = call i32 @big(i32 %x)\n"
+      "  %b = call i32 @bigger(i32 %a)\n"
+      "  %c = call i32 @small(i32 %b)\n"
+      "  ret i32 %c\n"
+      "}\n"));
+
+  std::vector<std::string> parts =
+      SplitModuleToBitcode(module.get(), /*max_num_parts=*/2);
+  ASSERT_EQ(parts.size(), 2);
+  std::unique_ptr<llvm::Module> part0 = ParsePart(parts[0]);
+  std::unique_ptr<llvm::Module> part1 = ParsePart(parts[1]);
+
+  // The largest function gets a part of its own, and the others share the
+  // other part.
+  EXPECT_TRUE(Defines(*part0, "bigger"));
+  EXPECT_FALSE(Defines(*part1, "bigger"));
+  EXPECT_TRUE(Defines(*part1, "big"));
+  EXPECT_TRUE(Defines(*part1, "entry"));
+  EXPECT_FALSE(Defines(*part0, "big"));
+  EXPECT_FALSE(Defines(*part0, "entry"));
+
+  // Functions called across parts are made external.
+  EXPECT_FALSE(part1->getFunction("bigger")->hasLocalLinkage());
+  EXPECT_FALSE(part0->getFunction("bigger")->hasLocalLinkage());
+
+  // Small functions are copied into every part and stay internal.
+  EXPECT_TRUE(Defines(*part1, "small"));
+  EXPECT_TRUE(part1->getFunction("small")->hasLocalLinkage());
+
+  // Constants are defined in the first part only.
+  EXPECT_TRUE(Defines(*part0, "table"));
+  EXPECT_FALSE(Defines(*part1, "table"));
+}
+
+TEST_F(LlvmModuleSplitterTest, DoesNotSplitModulesWithOneFunction) {
+  std::unique_ptr<llvm::Module> module =
+      ParseModule(absl::StrCat(AddingFunction("small", 2),
+                               "define i32 @entry(i32 %x) {\n"
+                               "  %a = call i32 @small(i32 %x)\n"
+                               "  ret i32 %a\n"
+                               "}\n"));
+  EXPECT_TRUE(SplitModuleToBitcode(module.get(), /*max_num_parts=*/4).empty());
+  EXPECT_TRUE(module->getFunction("small")->hasLocalLinkage());
+}
+
+TEST_F(LlvmModuleSplitterTest, MakesAtMostOnePartPerFunction) {
+  std::unique_ptr<llvm::Module> module = ParseModule(
+      absl::StrCat(AddingFunction("big", 200),
+                   "define i32 @entry(i32 %x) {\n"
+                   "  %a = call i32 @big(i32 %x)\n"
+                   "  ret i32 %a\n"
+                   "}\n"));
+  std::vector<std::string> parts =
+      SplitModuleToBitcode(module.get(), /*max_num_parts=*/8);
+  ASSERT_EQ(parts.size(), 2);
+  EXPECT_TRUE(Defines(*ParsePart(parts[0]), "big"));
+  EXPECT_TRUE(Defines(*ParsePart(parts[1]), "entry"));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -24,6 +24,9 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/hlo_instruction.h"
 #include "tensorflow/compiler/xla/service/hlo_opcode.h"
 #include "tensorflow/compiler/xla/service/llvm_ir/dynamic_update_slice_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla.pb.h"
+#include "tensorflow/core/platform/profile_utils/cpu_utils.h"
 
 namespace xla {
 namespace cpu {
@@ -106,20 +109,128 @@ class DefaultCostModel : public ParallelCostModel {
   const std::unique_ptr<HloCostAnalysis> cost_analysis_;
 };
 
+namespace {
+
+// Defaults for a recent x86 server core: vectorized arithmetic at ~2GHz, and
+// the memory bandwidth a single core gets in STREAM-like benchmarks.
+constexpr double kDefaultCoreFlopsPerNs = 16.0;
+constexpr double kDefaultCoreBytesPerNs = 10.0;
+// Cost of a transcendental function relative to a flop.
+constexpr double kFlopsPerTranscendental = 20.0;
+// Latency of waking up the threads of the pool and waiting for the slowest of
+// them, and cost of enqueuing each task, which the caller does serially.
+constexpr double kForkJoinLatencyNs = 5000.0;
+constexpr double kTaskOverheadNs = 500.0;
+
+}  // namespace
+
+// Estimates the wall time of an instruction from the throughput of the cores
+// and of memory, and picks the task count that minimizes it, counting the
+// overhead of forking and joining the tasks. If 'fusion_profile' measured the
+// instruction, its cycles replace the estimated compute time.
+class ThroughputCostModel : public ParallelCostModel {
+ public:
+  ThroughputCostModel(const int64 max_parallelism,
+                      const DebugOptions& debug_options,
+                      std::unique_ptr<HloCostAnalysis> cost_analysis,
+                      const FusionProfile* fusion_profile)
+      : max_parallelism_(max_parallelism),
+        core_flops_per_ns_(
+            debug_options.xla_cpu_parallel_task_core_gflops() > 0
+                ? debug_options.xla_cpu_parallel_task_core_gflops()
+                : kDefaultCoreFlopsPerNs),
+        core_bytes_per_ns_(
+            debug_options.xla_cpu_parallel_task_core_memory_bandwidth_gbs() > 0
+                ? debug_options
+                      .xla_cpu_parallel_task_core_memory_bandwidth_gbs()
+                : kDefaultCoreBytesPerNs),
+        memory_bytes_per_ns_(
+            debug_options.xla_cpu_parallel_task_memory_bandwidth_gbs()),
+        cost_analysis_(std::move(cost_analysis)),
+        fusion_profile_(fusion_profile) {}
+  ~ThroughputCostModel() override {}
+
+  int64 GetParallelTaskCount(HloInstruction* instruction) override {
+    const double compute_ns = ComputeNs(*instruction);
+    const double bytes_accessed = cost_analysis_->bytes_accessed(*instruction);
+    int64 best_task_count = 1;
+    double best_wall_time_ns =
+        EstimateWallTimeNs(/*task_count=*/1, compute_ns, bytes_accessed);
+    for (int64 task_count = 2; task_count <= max_parallelism_; ++task_count) {
+      const double wall_time_ns =
+          EstimateWallTimeNs(task_count, compute_ns, bytes_accessed);
+      if (wall_time_ns < best_wall_time_ns) {
+        best_task_count = task_count;
+        best_wall_time_ns = wall_time_ns;
+      }
+    }
+    return best_task_count;
+  }
+
+ private:
+  // Returns the time one core takes to run 'instruction'. The cycles that the
+  // profile measured include the time spent waiting for memory, which only
+  // makes the estimate more conservative.
+  double ComputeNs(const HloInstruction& instruction) const {
+    if (fusion_profile_ != nullptr) {
+      absl::optional<double> cycles =
+          fusion_profile_->AverageCycles(instruction);
+      const double cycles_per_second = static_cast<double>(
+          tensorflow::profile_utils::CpuUtils::GetCycleCounterFrequency());
+      if (cycles.has_value() && cycles_per_second > 0) {
+        return *cycles * 1e9 / cycles_per_second;
+      }
+    }
+    return (cost_analysis_->flop_count(instruction) +
+            kFlopsPerTranscendental *
+                cost_analysis_->transcendental_count(instruction)) /
+           core_flops_per_ns_;
+  }
+
+  double EstimateWallTimeNs(int64 task_count, double compute_ns,
+                            double bytes_accessed) const {
+    double bytes_per_ns = core_bytes_per_ns_ * task_count;
+    if (memory_bytes_per_ns_ > 0) {
+      bytes_per_ns = std::min<double>(bytes_per_ns, memory_bytes_per_ns_);
+    }
+    // Computation and memory accesses overlap, so the slower one of them
+    // determines the run time.
+    double wall_time_ns =
+        std::max(compute_ns / task_count, bytes_accessed / bytes_per_ns);
+    if (task_count > 1) {
+      wall_time_ns += kForkJoinLatencyNs + kTaskOverheadNs * task_count;
+    }
+    return wall_time_ns;
+  }
+
+  const int64 max_parallelism_;
+  const double core_flops_per_ns_;
+  const double core_bytes_per_ns_;
+  const int64 memory_bytes_per_ns_;
+  const std::unique_ptr<HloCostAnalysis> cost_analysis_;
+  const FusionProfile* fusion_profile_;
+};
+
 ParallelTaskAssignment::ParallelTaskAssignment(
     const int64 max_parallelism,
     const HloCostAnalysis::ShapeSizeFunction& shape_size, HloModule* module,
-    const TargetMachineFeatures* target_machine_features)
+    const TargetMachineFeatures* target_machine_features,
+    const FusionProfile* fusion_profile)
     : target_machine_features_(*target_machine_features) {
   VLOG(1) << "ParallelTaskAssignment max_parallelism: " << max_parallelism;
   // Run cost analysis on 'module'.
   auto cost_analysis = absl::make_unique<HloCostAnalysis>(shape_size);
   HloComputation* computation = module->entry_computation();
   Status status = computation->root_instruction()->Accept(cost_analysis.get());
-  if (status.ok()) {
+  const DebugOptions& debug_options = module->config().debug_options();
+  if (status.ok() && debug_options.xla_cpu_parallel_task_legacy_cost_model()) {
     // Set default cost model based on 'cost_analysis'.
     cost_model_.reset(new DefaultCostModel(max_parallelism, shape_size,
                                            std::move(cost_analysis)));
+  } else if (status.ok()) {
+    cost_model_.reset(new ThroughputCostModel(max_parallelism, debug_options,
+                                              std::move(cost_analysis),
+                                              fusion_profile));
   } else {
     // Fall back to a simple cost model based on hlo size and L2 cache size.
     // Note that HloCostAnalysis can returns an error status (likely because
@@ -132,7 +243,9 @@ int64 ParallelTaskAssignment::GetTargetParallelTaskCount(
     HloInstruction* instruction) {
   // Currently, we do not assign parallel tasks to instructions with at least
   // one of the following properties:
-  // *) Internal threading (library calls to kConv, kDot, kFft, kCustomCall).
+  // *) Internal threading (library calls to kConv, kDot, kFft, kCustomCall,
+  //    including int8 dots and convolutions fused with their converts).
+  //    Batch dots lowered to LLVM IR are split along their batch dimension.
   // *) Emit custom loops (kSelectAndScatter).
   // *) Operations that are not thread safe (like infeed and rng).
   // *) Tuple-shaped.
@@ -148,7 +261,8 @@ int64 ParallelTaskAssignment::GetTargetParallelTaskCount(
   }
 
   // Only allow known good instructions.
-  if (instruction->IsElementwise() || instruction->IsLoopFusion() ||
+  if (instruction->IsElementwise() ||
+      (instruction->IsLoopFusion() && !IsInt8KernelFusion(*instruction)) ||
       opcode == HloOpcode::kBroadcast || opcode == HloOpcode::kConcatenate ||
       opcode == HloOpcode::kDynamicSlice ||
       opcode == HloOpcode::kDynamicUpdateSlice ||
@@ -159,7 +273,10 @@ int64 ParallelTaskAssignment::GetTargetParallelTaskCount(
       opcode == HloOpcode::kTranspose ||
       (opcode == HloOpcode::kConvolution &&
        !PotentiallyImplementedAsEigenConvolution(*instruction,
-                                                 target_machine_features_))) {
+                                                 target_machine_features_)) ||
+      (opcode == HloOpcode::kDot &&
+       DotImplementationCanBeParallelized(*instruction,
+                                          target_machine_features_))) {
     // Consult 'cost_model_' to compute target parallel task count.
     return cost_model_->GetParallelTaskCount(instruction);
   }
@@ -217,7 +334,14 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
     // Get target parallel task count computed for 'instruction'.
     const int64 target_parallel_task_count = (*it).second;
     // Assign feasible dimension partitions (based on actual dimension sizes).
-    auto dim_partition_counts = ShapePartitionAssigner(instruction->shape())
+    // Dots are only partitioned along their outermost batch dimension.
+    const Shape partitioned_shape =
+        instruction->opcode() == HloOpcode::kDot
+            ? ShapeUtil::MakeShapeWithDescendingLayout(
+                  instruction->shape().element_type(),
+                  {instruction->shape().dimensions(0)})
+            : instruction->shape();
+    auto dim_partition_counts = ShapePartitionAssigner(partitioned_shape)
                                     .Run(target_parallel_task_count);
     const int64 total_partition_count =
         ShapePartitionAssigner::GetTotalPartitionCount(dim_partition_counts);
@@ -245,9 +369,9 @@ bool ParallelTaskAssigner::AssignParallelTasksHelper(
 
 void ParallelTaskAssigner::ComputeTargetParallelTasks(
     HloModule* module, HloToParallelTasks* hlo_to_parallel_tasks) {
-  ParallelTaskAssignment parallel_task_assignment(max_parallelism_,
-                                                  shape_size_function_, module,
-                                                  &target_machine_features_);
+  ParallelTaskAssignment parallel_task_assignment(
+      max_parallelism_, shape_size_function_, module, &target_machine_features_,
+      fusion_profile_);
 
   // Compute parallel task counts for all instructions in 'module'.
   for (auto* computation : module->MakeNonfusionComputations()) {
@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PARALLEL_TASK_ASSIGNMENT_H_
 
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features.h"
+#include "tensorflow/compiler/xla/service/cpu/fusion_profile.h"
 #include "tensorflow/compiler/xla/service/hlo_cost_analysis.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
@@ -32,16 +33,22 @@ class ParallelCostModel {
 };
 
 // ParallelTaskAssignment computes parallel task counts for HLOs in 'module'.
+// By default the counts minimize the wall time that a cost model estimates
+// from HloCostAnalysis and the throughput of the cores and memory of the host,
+// which the xla_cpu_parallel_task_* debug options describe. The compute time of
+// instructions that a FusionProfile has measured is taken from the profile.
 class ParallelTaskAssignment {
  public:
   // 'max_parallelism': the maximum parallel task count per instruction.
   // 'shape_size': shape size function used by HloCostAnalysis during parallel
   //               task assignment.
   // 'module': the containing HloModule.
+  // 'fusion_profile': measured cycles of instructions, or null.
   ParallelTaskAssignment(const int64 max_parallelism,
                          const HloCostAnalysis::ShapeSizeFunction& shape_size,
                          HloModule* module,
-                         const TargetMachineFeatures* target_machine_features);
+                         const TargetMachineFeatures* target_machine_features,
+                         const FusionProfile* fusion_profile = nullptr);
   ~ParallelTaskAssignment() {}
 
   // Computes and returns the target parallel task count for 'instruction'.
@@ -65,12 +72,15 @@ class ParallelTaskAssigner : public HloModulePass {
   // 'max_parallelism': the maximum parallel task count per instruction.
   // 'shape_size': shape size function used by HloCostAnalysis during parallel
   //               task assignment.
+  // 'fusion_profile': measured cycles of instructions, or null.
   ParallelTaskAssigner(const int64 max_parallelism,
                        const HloCostAnalysis::ShapeSizeFunction& shape_size,
-                       const TargetMachineFeatures* target_machine_features)
+                       const TargetMachineFeatures* target_machine_features,
+                       const FusionProfile* fusion_profile = nullptr)
       : max_parallelism_(max_parallelism),
         shape_size_function_(shape_size),
-        target_machine_features_(*target_machine_features) {}
+        target_machine_features_(*target_machine_features),
+        fusion_profile_(fusion_profile) {}
   ~ParallelTaskAssigner() override {}
 
   absl::string_view name() const override {
@@ -101,6 +111,7 @@ class ParallelTaskAssigner : public HloModulePass {
   int64 max_parallelism_;
   HloCostAnalysis::ShapeSizeFunction shape_size_function_;
   const TargetMachineFeatures& target_machine_features_;
+  const FusionProfile* fusion_profile_;
 };
 
 }  // namespace cpu
@@ -14,11 +14,17 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/compiler/xla/service/cpu/parallel_task_assignment.h"
+
+#include <cmath>
+#include <vector>
+
 #include "tensorflow/compiler/xla/service/cpu/cpu_executable.h"
+#include "tensorflow/compiler/xla/service/cpu/shape_partition.h"
 #include "tensorflow/compiler/xla/service/cpu/target_machine_features_fake.h"
 #include "tensorflow/compiler/xla/test.h"
 #include "tensorflow/compiler/xla/tests/hlo_test_base.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/cpu_info.h"
 
 namespace xla {
 namespace {
@@ -44,6 +50,16 @@ class ParallelTaskAssignmentTest : public HloTestBase {
                                      &target_machine_features_)
         .Run(module);
   }
+
+  // Returns the partitions assigned to the instruction that the entry
+  // computation of 'module' calls, or none if it calls nothing.
+  static std::vector<int64> AssignedPartitions(HloModule* module) {
+    const HloInstruction* root = module->entry_computation()->root_instruction();
+    if (root->opcode() != HloOpcode::kCall) {
+      return {};
+    }
+    return root->to_apply()->root_instruction()->outer_dimension_partitions();
+  }
 };
 
 TEST_F(ParallelTaskAssignmentTest, DotOperationNotParallelized) {
@@ -191,5 +207,107 @@ TEST_F(ParallelTaskAssignmentTest, AllReduceNotParallelized) {
   EXPECT_FALSE(changed);
 }
 
+TEST_F(ParallelTaskAssignmentTest, MemoryBoundElementwiseUsesAllThreads) {
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_add
+    ENTRY Add {
+      lhs = f32[4096,1024]{1,0} parameter(0)
+      rhs = f32[4096,1024]{1,0} parameter(1)
+      ROOT add = f32[4096,1024]{1,0} add(lhs, rhs)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(cpu::ShapePartitionAssigner::GetTotalPartitionCount(
+                AssignedPartitions(m.get())),
+            max_parallelism_);
+}
+
+TEST_F(ParallelTaskAssignmentTest, MemoryBoundElementwiseWithLegacyCostModel) {
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_add
+    ENTRY Add {
+      lhs = f32[4096,1024]{1,0} parameter(0)
+      rhs = f32[4096,1024]{1,0} parameter(1)
+      ROOT add = f32[4096,1024]{1,0} add(lhs, rhs)
+    }
+  )";
+
+  HloModuleConfig config = GetModuleConfigForTest();
+  DebugOptions debug_options = config.debug_options();
+  debug_options.set_xla_cpu_parallel_task_legacy_cost_model(true);
+  config.set_debug_options(debug_options);
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string, config));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_LE(cpu::ShapePartitionAssigner::GetTotalPartitionCount(
+                AssignedPartitions(m.get())),
+            std::ceil(std::sqrt(tensorflow::port::MaxParallelism())));
+}
+
+TEST_F(ParallelTaskAssignmentTest, MemoryBoundElementwiseLimitedByBandwidth) {
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_add
+    ENTRY Add {
+      lhs = f32[4096,1024]{1,0} parameter(0)
+      rhs = f32[4096,1024]{1,0} parameter(1)
+      ROOT add = f32[4096,1024]{1,0} add(lhs, rhs)
+    }
+  )";
+
+  // The memory of the host is saturated by 4 cores.
+  HloModuleConfig config = GetModuleConfigForTest();
+  DebugOptions debug_options = config.debug_options();
+  debug_options.set_xla_cpu_parallel_task_core_memory_bandwidth_gbs(10);
+  debug_options.set_xla_cpu_parallel_task_memory_bandwidth_gbs(40);
+  config.set_debug_options(debug_options);
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string, config));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(cpu::ShapePartitionAssigner::GetTotalPartitionCount(
+                AssignedPartitions(m.get())),
+            4);
+}
+
+TEST_F(ParallelTaskAssignmentTest, SmallElementwiseNotParallelized) {
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_add
+    ENTRY Add {
+      lhs = f32[64,64]{1,0} parameter(0)
+      rhs = f32[64,64]{1,0} parameter(1)
+      ROOT add = f32[64,64]{1,0} add(lhs, rhs)
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_FALSE(changed);
+}
+
+TEST_F(ParallelTaskAssignmentTest, BatchDotParallelizedAlongBatchDimension) {
+  const string hlo_string = R"(
+    HloModule TestTaskParallel_batch_dot
+    ENTRY BatchDot {
+      lhs = f32[64,512,512]{2,1,0} parameter(0)
+      rhs = f32[64,512,1]{2,1,0} parameter(1)
+      ROOT dot = f32[64,512,1]{2,1,0} dot(lhs, rhs),
+        lhs_batch_dims={0}, lhs_contracting_dims={2},
+        rhs_batch_dims={0}, rhs_contracting_dims={1}
+    }
+  )";
+
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> m,
+                          ParseAndReturnVerifiedModule(hlo_string));
+  TF_ASSERT_OK_AND_ASSIGN(bool changed, RunParallelTaskAssigner(m.get()));
+  EXPECT_TRUE(changed);
+  EXPECT_EQ(AssignedPartitions(m.get()), std::vector<int64>{max_parallelism_});
+}
+
 }  // namespace
 }  // namespace xla
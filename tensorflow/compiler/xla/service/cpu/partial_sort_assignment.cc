@@ -0,0 +1,134 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/partial_sort_assignment.h"
+
+#include <algorithm>
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/service/cpu/backend_configs.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_casting_utils.h"
+#include "tensorflow/compiler/xla/service/hlo_computation.h"
+#include "tensorflow/compiler/xla/service/hlo_instruction.h"
+#include "tensorflow/compiler/xla/service/hlo_instructions.h"
+#include "tensorflow/compiler/xla/service/hlo_opcode.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// A partial sort of k out of n elements only pays off over a full sort if k is
+// at most this fraction of n.
+constexpr int64 kMaxSortedElementsFraction = 4;
+
+// Returns the number of leading elements of 'dimension' of 'value' that its
+// users read, or nullopt if they may read all of them.
+absl::optional<int64> NumElementsRead(const HloInstruction* value,
+                                      int64 dimension) {
+  if (value->IsRoot() || value->user_count() == 0) {
+    return absl::nullopt;
+  }
+  int64 num_elements_read = 0;
+  for (const HloInstruction* user : value->users()) {
+    absl::optional<int64> num_elements_read_by_user;
+    switch (user->opcode()) {
+      case HloOpcode::kSlice:
+        if (user->slice_starts(dimension) == 0) {
+          num_elements_read_by_user = user->slice_limits(dimension);
+        }
+        break;
+      case HloOpcode::kFusion:
+        // Slices of the sort are usually fused into their users.
+        for (int64 i = 0; i < user->operand_count(); ++i) {
+          if (user->operand(i) != value) {
+            continue;
+          }
+          absl::optional<int64> num_elements_read_by_parameter =
+              NumElementsRead(user->fused_parameter(i), dimension);
+          if (!num_elements_read_by_parameter.has_value()) {
+            return absl::nullopt;
+          }
+          num_elements_read_by_user =
+              std::max(num_elements_read_by_user.value_or(0),
+                       *num_elements_read_by_parameter);
+        }
+        break;
+      default:
+        break;
+    }
+    if (!num_elements_read_by_user.has_value()) {
+      return absl::nullopt;
+    }
+    num_elements_read = std::max(num_elements_read, *num_elements_read_by_user);
+  }
+  return num_elements_read;
+}
+
+// Returns the number of leading elements of the sort dimension that the users
+// of 'sort' read, or nullopt if they may read all of them.
+absl::optional<int64> NumSortedElementsNeeded(const HloSortInstruction* sort) {
+  const int64 dimension = sort->sort_dimension();
+  if (!sort->shape().IsTuple()) {
+    return NumElementsRead(sort, dimension);
+  }
+  if (sort->IsRoot()) {
+    return absl::nullopt;
+  }
+  int64 num_elements_read = 0;
+  for (const HloInstruction* user : sort->users()) {
+    if (user->opcode() != HloOpcode::kGetTupleElement) {
+      return absl::nullopt;
+    }
+    absl::optional<int64> num_elements_read_by_user =
+        NumElementsRead(user, dimension);
+    if (!num_elements_read_by_user.has_value()) {
+      return absl::nullopt;
+    }
+    num_elements_read = std::max(num_elements_read, *num_elements_read_by_user);
+  }
+  return num_elements_read;
+}
+
+}  // namespace
+
+StatusOr<bool> PartialSortAssignment::Run(HloModule* module) {
+  bool changed = false;
+  for (HloComputation* computation : module->MakeNonfusionComputations()) {
+    for (HloInstruction* instruction : computation->instructions()) {
+      if (instruction->opcode() != HloOpcode::kSort) {
+        continue;
+      }
+      auto* sort = Cast<HloSortInstruction>(instruction);
+      const int64 num_elements =
+          sort->keys()->shape().dimensions(sort->sort_dimension());
+      absl::optional<int64> num_sorted_elements = NumSortedElementsNeeded(sort);
+      if (!num_sorted_elements.has_value() || *num_sorted_elements == 0 ||
+          *num_sorted_elements * kMaxSortedElementsFraction > num_elements) {
+        continue;
+      }
+      SortBackendConfig config;
+      config.set_num_sorted_elements(*num_sorted_elements);
+      TF_RETURN_IF_ERROR(sort->set_backend_config(config));
+      VLOG(2) << "Sorting the first " << *num_sorted_elements << " of "
+              << num_elements << " elements of " << sort->name();
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,43 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PARTIAL_SORT_ASSIGNMENT_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PARTIAL_SORT_ASSIGNMENT_H_
+
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_pass_interface.h"
+
+namespace xla {
+namespace cpu {
+
+// Finds sorts whose results are only read through slices of the first k
+// elements of the sort dimension, as in the sort+slice pattern of top-k, and
+// records k in their SortBackendConfig. The runtime then only sorts those k
+// elements, which is a partial sort of O(n log k) rather than O(n log n).
+//
+// Slices may read the sort directly, through get-tuple-element for sorts of
+// several operands, or as the parameters of fusions. Sorts are only annotated
+// when k is small enough compared to n for the partial sort to pay off.
+class PartialSortAssignment : public HloModulePass {
+ public:
+  absl::string_view name() const override { return "partial-sort-assignment"; }
+
+  StatusOr<bool> Run(HloModule* module) override;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PARTIAL_SORT_ASSIGNMENT_H_
@@ -0,0 +1,146 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/partial_sort_assignment.h"
+
+#include "tensorflow/compiler/xla/service/cpu/backend_configs.pb.h"
+#include "tensorflow/compiler/xla/test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+class PartialSortAssignmentTest : public HloTestBase {
+ protected:
+  // Runs the pass on 'hlo_string' and returns the number of sorted elements
+  // recorded for the instruction named "sort", or 0 if there is none.
+  int64 NumSortedElements(const string& hlo_string) {
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnVerifiedModule(hlo_string).ValueOrDie();
+    bool changed = PartialSortAssignment().Run(module.get()).ValueOrDie();
+    HloInstruction* sort = FindInstruction(module.get(), "sort");
+    CHECK(sort != nullptr);
+    SortBackendConfig config =
+        sort->backend_config<SortBackendConfig>().ValueOrDie();
+    EXPECT_EQ(changed, config.num_sorted_elements() != 0);
+    return config.num_sorted_elements();
+  }
+};
+
+TEST_F(PartialSortAssignmentTest, SortOfKeysAndIndicesFollowedBySlices) {
+  const string hlo_string = R"(
+    HloModule TopK
+    compare {
+      p.0.lhs = f32[] parameter(0)
+      p.0.rhs = f32[] parameter(1)
+      p.1.lhs = s32[] parameter(2)
+      p.1.rhs = s32[] parameter(3)
+      ROOT gt = pred[] compare(p.0.lhs, p.0.rhs), direction=GT
+    }
+    ENTRY main {
+      keys = f32[8,1024] parameter(0)
+      iota = s32[8,1024] iota(), iota_dimension=1
+      sort = (f32[8,1024], s32[8,1024]) sort(keys, iota), dimensions={1},
+        to_apply=compare
+      values = f32[8,1024] get-tuple-element(sort), index=0
+      indices = s32[8,1024] get-tuple-element(sort), index=1
+      top_values = f32[8,5] slice(values), slice={[0:8], [0:5]}
+      top_indices = s32[8,10] slice(indices), slice={[0:8], [0:10]}
+      ROOT result = (f32[8,5], s32[8,10]) tuple(top_values, top_indices)
+    }
+  )";
+  EXPECT_EQ(NumSortedElements(hlo_string), 10);
+}
+
+TEST_F(PartialSortAssignmentTest, SliceInsideFusion) {
+  const string hlo_string = R"(
+    HloModule TopK
+    compare {
+      p.0.lhs = f32[] parameter(0)
+      p.0.rhs = f32[] parameter(1)
+      ROOT gt = pred[] compare(p.0.lhs, p.0.rhs), direction=GT
+    }
+    fused_computation {
+      param = f32[1024] parameter(0)
+      slice = f32[16] slice(param), slice={[0:16]}
+      ROOT negate = f32[16] negate(slice)
+    }
+    ENTRY main {
+      keys = f32[1024] parameter(0)
+      sort = f32[1024] sort(keys), dimensions={0}, to_apply=compare
+      ROOT fusion = f32[16] fusion(sort), kind=kLoop, calls=fused_computation
+    }
+  )";
+  EXPECT_EQ(NumSortedElements(hlo_string), 16);
+}
+
+TEST_F(PartialSortAssignmentTest, SliceNotAtTheStart) {
+  const string hlo_string = R"(
+    HloModule TopK
+    compare {
+      p.0.lhs = f32[] parameter(0)
+      p.0.rhs = f32[] parameter(1)
+      ROOT gt = pred[] compare(p.0.lhs, p.0.rhs), direction=GT
+    }
+    ENTRY main {
+      keys = f32[1024] parameter(0)
+      sort = f32[1024] sort(keys), dimensions={0}, to_apply=compare
+      ROOT slice = f32[16] slice(sort), slice={[8:24]}
+    }
+  )";
+  EXPECT_EQ(NumSortedElements(hlo_string), 0);
+}
+
+TEST_F(PartialSortAssignmentTest, SortReadByOtherInstruction) {
+  const string hlo_string = R"(
+    HloModule TopK
+    compare {
+      p.0.lhs = f32[] parameter(0)
+      p.0.rhs = f32[] parameter(1)
+      ROOT gt = pred[] compare(p.0.lhs, p.0.rhs), direction=GT
+    }
+    ENTRY main {
+      keys = f32[1024] parameter(0)
+      sort = f32[1024] sort(keys), dimensions={0}, to_apply=compare
+      slice = f32[16] slice(sort), slice={[0:16]}
+      negate = f32[1024] negate(sort)
+      ROOT result = (f32[16], f32[1024]) tuple(slice, negate)
+    }
+  )";
+  EXPECT_EQ(NumSortedElements(hlo_string), 0);
+}
+
+TEST_F(PartialSortAssignmentTest, SliceOfMostElements) {
+  const string hlo_string = R"(
+    HloModule TopK
+    compare {
+      p.0.lhs = f32[] parameter(0)
+      p.0.rhs = f32[] parameter(1)
+      ROOT gt = pred[] compare(p.0.lhs, p.0.rhs), direction=GT
+    }
+    ENTRY main {
+      keys = f32[1024] parameter(0)
+      sort = f32[1024] sort(keys), dimensions={0}, to_apply=compare
+      ROOT slice = f32[512] slice(sort), slice={[0:512]}
+    }
+  )";
+  EXPECT_EQ(NumSortedElements(hlo_string), 0);
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,205 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/persistent_compilation_cache.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/xla.pb.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/public/version.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Bumped whenever the layout of the entries or the way the keys are computed
+// changes, so that stale entries are never loaded.
+constexpr int kFormatVersion = 1;
+
+constexpr char kEntrySuffix[] = ".xla_cpu";
+constexpr char kTempSuffix[] = ".tmp";
+
+}  // namespace
+
+PersistentCompilationCache::PersistentCompilationCache(string directory,
+                                                       int64 max_size_bytes,
+                                                       tensorflow::Env* env)
+    : directory_(std::move(directory)),
+      max_size_bytes_(max_size_bytes),
+      env_(env) {}
+
+/*static*/ string PersistentCompilationCache::ComputeKey(
+    const HloModule& module, const llvm::TargetMachine& target_machine) {
+  // Where the cache and the dumps are written doesn't change the code.
+  DebugOptions debug_options = module.config().debug_options();
+  debug_options.clear_xla_cpu_persistent_cache_dir();
+  debug_options.clear_xla_cpu_persistent_cache_max_size_bytes();
+  debug_options.clear_xla_dump_to();
+  debug_options.clear_xla_dump_hlo_module_re();
+  debug_options.clear_xla_dump_hlo_pass_re();
+  debug_options.clear_xla_dump_hlo_as_text();
+  debug_options.clear_xla_dump_hlo_as_proto();
+  debug_options.clear_xla_dump_hlo_as_dot();
+  debug_options.clear_xla_dump_hlo_as_url();
+  debug_options.clear_xla_dump_hlo_as_html();
+  debug_options.clear_xla_dump_hlo_snapshots();
+  debug_options.clear_xla_dump_include_timestamp();
+  debug_options.clear_xla_dump_max_hlo_modules();
+  string serialized_debug_options;
+  CHECK(tensorflow::SerializeToStringDeterministic(debug_options,
+                                                   &serialized_debug_options));
+
+  // The backend config holds the partitioning of the parallel loops, and the
+  // constants are embedded in the code.
+  const HloPrintOptions print_options = HloPrintOptions::Fingerprint()
+                                            .set_print_backend_config(true)
+                                            .set_print_large_constants(true);
+  const HloModuleConfig& config = module.config();
+  const string key_material = absl::StrCat(
+      kFormatVersion, "\n", tensorflow::tf_git_version(), "\n",
+      target_machine.getTargetTriple().str(), "\n",
+      target_machine.getTargetCPU().str(), "\n",
+      target_machine.getTargetFeatureString().str(), "\n",
+      config.replica_count(), ",", config.num_partitions(), ",",
+      config.intra_op_parallelism_threads(), "\n", serialized_debug_options,
+      "\n", module.ToString(print_options));
+  const tensorflow::Fprint128 fingerprint =
+      tensorflow::Fingerprint128(key_material);
+  return absl::StrFormat("%016x%016x", fingerprint.high64, fingerprint.low64);
+}
+
+/*static*/ uint64 PersistentCompilationCache::FingerprintBufferAssignment(
+    const BufferAssignment& assignment) {
+  uint64 fingerprint = 0;
+  for (const BufferAllocation& allocation : assignment.Allocations()) {
+    string serialized_allocation;
+    CHECK(tensorflow::SerializeToStringDeterministic(allocation.ToProto(),
+                                                     &serialized_allocation));
+    fingerprint = tensorflow::FingerprintCat64(
+        fingerprint, tensorflow::Fingerprint64(serialized_allocation));
+  }
+  return fingerprint;
+}
+
+string PersistentCompilationCache::EntryPath(const string& key) const {
+  return tensorflow::io::JoinPath(directory_, absl::StrCat(key, kEntrySuffix));
+}
+
+absl::optional<CompilationCacheEntryProto> PersistentCompilationCache::Lookup(
+    const string& key) {
+  const string path = EntryPath(key);
+  if (!env_->FileExists(path).ok()) {
+    return absl::nullopt;
+  }
+  CompilationCacheEntryProto entry;
+  Status status = tensorflow::ReadBinaryProto(env_, path, &entry);
+  if (status.ok() && (entry.key() != key || entry.object_files().empty() ||
+                      entry.entry_function_name().empty())) {
+    status = InternalError("Malformed entry");
+  }
+  if (!status.ok()) {
+    LOG(WARNING) << "Deleting unreadable XLA:CPU compilation cache entry "
+                 << path << ": " << status;
+    Remove(key);
+    return absl::nullopt;
+  }
+  return std::move(entry);
+}
+
+Status PersistentCompilationCache::Insert(
+    const CompilationCacheEntryProto& entry) {
+  TF_RETURN_IF_ERROR(env_->RecursivelyCreateDir(directory_));
+  const string path = EntryPath(entry.key());
+  // Readers only ever see complete entries, even if several processes insert
+  // the same one at once.
+  const string temp_path = absl::StrCat(
+      path, ".", absl::Hex(tensorflow::random::New64()), kTempSuffix);
+  TF_RETURN_IF_ERROR(tensorflow::WriteBinaryProto(env_, temp_path, entry));
+  Status status = env_->RenameFile(temp_path, path);
+  if (!status.ok()) {
+    env_->DeleteFile(temp_path).IgnoreError();
+    return status;
+  }
+  VLOG(1) << "Inserted " << entry.object_files_size()
+          << " object files in " << path;
+  return Evict(/*inserted_path=*/path);
+}
+
+void PersistentCompilationCache::Remove(const string& key) {
+  env_->DeleteFile(EntryPath(key)).IgnoreError();
+}
+
+Status PersistentCompilationCache::Evict(const string& inserted_path) {
+  std::vector<string> children;
+  TF_RETURN_IF_ERROR(env_->GetChildren(directory_, &children));
+
+  struct EntryFile {
+    int64 mtime_nsec;
+    int64 size;
+    string path;
+  };
+  std::vector<EntryFile> entry_files;
+  int64 total_size = 0;
+  for (const string& child : children) {
+    if (!absl::EndsWith(child, kEntrySuffix)) {
+      continue;
+    }
+    const string path = tensorflow::io::JoinPath(directory_, child);
+    tensorflow::FileStatistics stats;
+    // Another process may have evicted the entry in the meantime.
+    if (!env_->Stat(path, &stats).ok()) {
+      continue;
+    }
+    entry_files.push_back({stats.mtime_nsec, stats.length, path});
+    total_size += stats.length;
+  }
+  if (total_size <= max_size_bytes_) {
+    return Status::OK();
+  }
+
+  std::sort(entry_files.begin(), entry_files.end(),
+            [](const EntryFile& a, const EntryFile& b) {
+              return a.mtime_nsec < b.mtime_nsec;
+            });
+  for (const EntryFile& entry_file : entry_files) {
+    if (total_size <= max_size_bytes_) {
+      break;
+    }
+    // Modification times may only have a resolution of a second, so make
+    // sure not to evict the entry that was just inserted in favor of an older
+    // one.
+    if (entry_file.path == inserted_path) {
+      continue;
+    }
+    VLOG(1) << "Evicting " << entry_file.path;
+    env_->DeleteFile(entry_file.path).IgnoreError();
+    total_size -= entry_file.size;
+  }
+  return Status::OK();
+}
+
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,85 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PERSISTENT_COMPILATION_CACHE_H_
+#define TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PERSISTENT_COMPILATION_CACHE_H_
+
+#include <string>
+
+#include "absl/types/optional.h"
+#include "llvm/Target/TargetMachine.h"
+#include "tensorflow/compiler/xla/service/buffer_assignment.h"
+#include "tensorflow/compiler/xla/service/cpu/persistent_compilation_cache.pb.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/status.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace xla {
+namespace cpu {
+
+// An on-disk cache of the machine code compiled by the XLA:CPU JIT, which
+// outlives the process so that a restarted process loads the modules it
+// compiled before instead of running them through LLVM again.
+//
+// Each entry is a CompilationCacheEntryProto in its own file, named after a
+// key that covers everything the machine code depends on: the optimized and
+// scheduled HLO module, the target machine and the compiler flags. Entries
+// are written to a temporary file and renamed, so that several processes can
+// share a directory. Once the directory holds more than 'max_size_bytes', the
+// least recently written entries are deleted.
+class PersistentCompilationCache {
+ public:
+  PersistentCompilationCache(string directory, int64 max_size_bytes,
+                             tensorflow::Env* env = tensorflow::Env::Default());
+
+  // Returns the key that the machine code compiled for 'module', whose
+  // schedule is set, by 'target_machine' is stored under.
+  static string ComputeKey(const HloModule& module,
+                           const llvm::TargetMachine& target_machine);
+
+  // Returns a fingerprint of the buffer allocations of 'assignment'.
+  static uint64 FingerprintBufferAssignment(
+      const BufferAssignment& assignment);
+
+  // Returns the entry stored under 'key', or nullopt if there is none.
+  // Unreadable entries are deleted.
+  absl::optional<CompilationCacheEntryProto> Lookup(const string& key);
+
+  // Stores 'entry' under 'entry.key()', replacing any previous entry, then
+  // deletes the least recently written entries that don't fit in the cache.
+  Status Insert(const CompilationCacheEntryProto& entry);
+
+  // Deletes the entry stored under 'key', if any.
+  void Remove(const string& key);
+
+  const string& directory() const { return directory_; }
+
+ private:
+  string EntryPath(const string& key) const;
+
+  // Deletes the least recently written entries, other than the one at
+  // 'inserted_path', until the remaining ones fit in 'max_size_bytes_'.
+  Status Evict(const string& inserted_path);
+
+  const string directory_;
+  const int64 max_size_bytes_;
+  tensorflow::Env* const env_;
+};
+
+}  // namespace cpu
+}  // namespace xla
+
+#endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_PERSISTENT_COMPILATION_CACHE_H_
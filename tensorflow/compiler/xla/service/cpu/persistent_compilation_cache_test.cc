@@ -0,0 +1,177 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/xla/service/cpu/persistent_compilation_cache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/cpu/persistent_compilation_cache.pb.h"
+#include "tensorflow/compiler/xla/service/cpu/simple_orc_jit.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns an empty directory for the cache of the running test.
+string CacheDirectory() {
+  const string directory = tensorflow::io::JoinPath(
+      tensorflow::testing::TmpDir(),
+      ::testing::UnitTest::GetInstance()->current_test_info()->name());
+  tensorflow::Env* env = tensorflow::Env::Default();
+  if (env->FileExists(directory).ok()) {
+    int64 undeleted_files, undeleted_dirs;
+    TF_CHECK_OK(
+        env->DeleteRecursively(directory, &undeleted_files, &undeleted_dirs));
+  }
+  return directory;
+}
+
+int NumEntries(const string& directory) {
+  std::vector<string> children;
+  TF_CHECK_OK(tensorflow::Env::Default()->GetChildren(directory, &children));
+  return children.size();
+}
+
+CompilationCacheEntryProto MakeEntry(const string& key, int size) {
+  CompilationCacheEntryProto entry;
+  entry.set_key(key);
+  entry.set_entry_function_name(absl::StrCat("entry_", key));
+  entry.add_object_files(string(size, 'x'));
+  entry.set_buffer_assignment_fingerprint(42);
+  return entry;
+}
+
+TEST(PersistentCompilationCacheTest, InsertAndLookup) {
+  PersistentCompilationCache cache(CacheDirectory(),
+                                   /*max_size_bytes=*/1 << 20);
+  EXPECT_FALSE(cache.Lookup("a").has_value());
+
+  TF_ASSERT_OK(cache.Insert(MakeEntry("a", 100)));
+  absl::optional<CompilationCacheEntryProto> entry = cache.Lookup("a");
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(entry->key(), "a");
+  EXPECT_EQ(entry->entry_function_name(), "entry_a");
+  ASSERT_EQ(entry->object_files_size(), 1);
+  EXPECT_EQ(entry->object_files(0), string(100, 'x'));
+  EXPECT_EQ(entry->buffer_assignment_fingerprint(), 42);
+  EXPECT_FALSE(cache.Lookup("b").has_value());
+
+  cache.Remove("a");
+  EXPECT_FALSE(cache.Lookup("a").has_value());
+}
+
+TEST(PersistentCompilationCacheTest, DeletesMalformedEntries) {
+  const string directory = CacheDirectory();
+  PersistentCompilationCache cache(directory, /*max_size_bytes=*/1 << 20);
+  TF_ASSERT_OK(cache.Insert(MakeEntry("a", 100)));
+  std::vector<string> children;
+  TF_ASSERT_OK(tensorflow::Env::Default()->GetChildren(directory, &children));
+  ASSERT_EQ(children.size(), 1);
+  TF_ASSERT_OK(tensorflow::WriteStringToFile(
+      tensorflow::Env::Default(),
+      tensorflow::io::JoinPath(directory, children[0]), "not a proto"));
+
+  EXPECT_FALSE(cache.Lookup("a").has_value());
+  EXPECT_EQ(NumEntries(directory), 0);
+}
+
+TEST(PersistentCompilationCacheTest, EvictsOldestEntries) {
+  const string directory = CacheDirectory();
+  // Fits two entries but not three.
+  PersistentCompilationCache cache(directory, /*max_size_bytes=*/2500);
+  TF_ASSERT_OK(cache.Insert(MakeEntry("a", 1000)));
+  TF_ASSERT_OK(cache.Insert(MakeEntry("b", 1000)));
+  EXPECT_EQ(NumEntries(directory), 2);
+
+  TF_ASSERT_OK(cache.Insert(MakeEntry("c", 1000)));
+  EXPECT_EQ(NumEntries(directory), 2);
+  EXPECT_TRUE(cache.Lookup("c").has_value());
+}
+
+TEST(PersistentCompilationCacheTest, KeysDependOnTheModule) {
+  llvm::InitializeNativeTarget();
+  std::unique_ptr<llvm::TargetMachine> target_machine =
+      SimpleOrcJIT::InferTargetMachineForJIT(llvm::TargetOptions(),
+                                             llvm::CodeGenOpt::Default);
+  auto key_for_constant = [&](int constant) {
+    const string hlo_text = absl::StrCat(
+        "HloModule m\n"
+        "ENTRY main {\n"
+        "  p = f32[4] parameter(0)\n"
+        "  c = f32[4] constant({1, 2, 3, ",
+        constant,
+        "})\n"
+        "  ROOT add = f32[4] add(p, c)\n"
+        "}\n");
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnUnverifiedModule(hlo_text).ValueOrDie();
+    return PersistentCompilationCache::ComputeKey(*module, *target_machine);
+  };
+  EXPECT_EQ(key_for_constant(4), key_for_constant(4));
+  EXPECT_NE(key_for_constant(4), key_for_constant(5));
+}
+
+class CpuPersistentCompilationCacheTest : public HloTestBase {
+ protected:
+  DebugOptions GetDebugOptionsForTest() override {
+    DebugOptions debug_options = HloTestBase::GetDebugOptionsForTest();
+    debug_options.set_xla_cpu_persistent_cache_dir(cache_directory_);
+    return debug_options;
+  }
+
+  const string cache_directory_ = CacheDirectory();
+};
+
+TEST_F(CpuPersistentCompilationCacheTest, ReusesCompiledModules) {
+  const char* const kHlo = R"(
+HloModule m
+
+ENTRY main {
+  p = f32[4] parameter(0)
+  c = f32[4] constant({1, 2, 3, 4})
+  ROOT mul = f32[4] multiply(p, c)
+}
+)";
+  Literal argument = LiteralUtil::CreateR1<float>({1, 1, 2, 2});
+  Literal expected = LiteralUtil::CreateR1<float>({1, 2, 6, 8});
+
+  // The first run compiles the module and stores it, the second one loads it.
+  for (int run = 0; run < 2; ++run) {
+    SCOPED_TRACE(run);
+    TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<HloModule> module,
+                            ParseAndReturnVerifiedModule(kHlo));
+    Literal result = ExecuteAndTransfer(std::move(module), {&argument});
+    EXPECT_TRUE(LiteralTestUtil::Equal(expected, result));
+    EXPECT_EQ(NumEntries(cache_directory_), 1);
+  }
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -49,6 +49,22 @@ extern void __xla_cpu_runtime_EigenConvF16(
     tensorflow::int64 lhs_row_dilation, tensorflow::int64 lhs_col_dilation,
     tensorflow::int64 rhs_row_dilation, tensorflow::int64 rhs_col_dilation);
 
+// Convolves an int8 input with an int8 kernel with int32 accumulation, as in
+// the int8 x int8 -> int32 convolutions of quantized models.
+extern void __xla_cpu_runtime_EigenConvS8S32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    tensorflow::int32* out, tensorflow::int8* lhs, tensorflow::int8* rhs,
+    tensorflow::int64 input_batch, tensorflow::int64 input_rows,
+    tensorflow::int64 input_cols, tensorflow::int64 input_channels,
+    tensorflow::int64 kernel_rows, tensorflow::int64 kernel_cols,
+    tensorflow::int64 kernel_channels, tensorflow::int64 kernel_filters,
+    tensorflow::int64 output_rows, tensorflow::int64 output_cols,
+    tensorflow::int64 row_stride, tensorflow::int64 col_stride,
+    tensorflow::int64 padding_top, tensorflow::int64 padding_bottom,
+    tensorflow::int64 padding_left, tensorflow::int64 padding_right,
+    tensorflow::int64 lhs_row_dilation, tensorflow::int64 lhs_col_dilation,
+    tensorflow::int64 rhs_row_dilation, tensorflow::int64 rhs_col_dilation);
+
 }  // extern "C"
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_CONV2D_H_
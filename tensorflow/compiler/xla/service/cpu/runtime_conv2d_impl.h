@@ -24,31 +24,21 @@ limitations under the License.
 namespace tensorflow {
 namespace xla {
 
-template <typename EigenDevice, typename ScalarType>
-void EigenConvImpl(const EigenDevice& device, ScalarType* out, ScalarType* lhs,
-                   ScalarType* rhs, Eigen::Index input_batch,
-                   Eigen::Index input_rows, Eigen::Index input_cols,
-                   Eigen::Index input_channels, Eigen::Index kernel_rows,
-                   Eigen::Index kernel_cols, Eigen::Index kernel_channels,
-                   Eigen::Index kernel_filters, Eigen::Index output_rows,
-                   Eigen::Index output_cols, Eigen::Index row_stride,
-                   Eigen::Index col_stride, Eigen::Index padding_top,
-                   Eigen::Index padding_bottom, Eigen::Index padding_left,
-                   Eigen::Index padding_right, Eigen::Index lhs_row_dilation,
-                   Eigen::Index lhs_col_dilation, Eigen::Index rhs_row_dilation,
-                   Eigen::Index rhs_col_dilation) {
-  const Eigen::TensorMap<Eigen::Tensor<const ScalarType, 4, Eigen::RowMajor>,
-                         Eigen::Aligned>
-      input(lhs, input_batch, input_rows, input_cols, input_channels);
-
-  const Eigen::TensorMap<Eigen::Tensor<const ScalarType, 4, Eigen::RowMajor>,
-                         Eigen::Aligned>
-      kernel(rhs, kernel_rows, kernel_cols, kernel_channels, kernel_filters);
-
-  Eigen::TensorMap<Eigen::Tensor<ScalarType, 4, Eigen::RowMajor>,
-                   Eigen::Aligned>
-      output(out, input_batch, output_rows, output_cols, kernel_filters);
-
+// Convolves 'input' with 'kernel' into 'output', where 'input' and 'kernel'
+// are Eigen tensor expressions of rank 4 in NHWC and HWIO order respectively.
+template <typename EigenDevice, typename OutputMap, typename InputExpr,
+          typename KernelExpr>
+void EigenConvOfExpressions(
+    const EigenDevice& device, OutputMap& output, const InputExpr& input,
+    const KernelExpr& kernel, Eigen::Index input_batch,
+    Eigen::Index kernel_rows, Eigen::Index kernel_cols,
+    Eigen::Index kernel_channels, Eigen::Index kernel_filters,
+    Eigen::Index output_rows, Eigen::Index output_cols, Eigen::Index row_stride,
+    Eigen::Index col_stride, Eigen::Index padding_top,
+    Eigen::Index padding_bottom, Eigen::Index padding_left,
+    Eigen::Index padding_right, Eigen::Index lhs_row_dilation,
+    Eigen::Index lhs_col_dilation, Eigen::Index rhs_row_dilation,
+    Eigen::Index rhs_col_dilation) {
   Eigen::array<Eigen::IndexPair<int64>, 1> contract_dims;
   contract_dims[0] = Eigen::IndexPair<int64>(1, 0);
 
@@ -78,12 +68,81 @@ void EigenConvImpl(const EigenDevice& device, ScalarType* out, ScalarType* lhs,
                                  row_stride, rhs_col_dilation, rhs_row_dilation,
                                  lhs_col_dilation, lhs_row_dilation,
                                  padding_left, padding_right, padding_top,
-                                 padding_bottom, static_cast<ScalarType>(0.0f))
+                                 padding_bottom,
+                                 static_cast<typename OutputMap::Scalar>(0.0f))
           .reshape(pre_contract_dims)
           .contract(kernel.reshape(kernel_dims), contract_dims)
           .reshape(post_contract_dims);
 }
 
+template <typename EigenDevice, typename ScalarType>
+void EigenConvImpl(const EigenDevice& device, ScalarType* out, ScalarType* lhs,
+                   ScalarType* rhs, Eigen::Index input_batch,
+                   Eigen::Index input_rows, Eigen::Index input_cols,
+                   Eigen::Index input_channels, Eigen::Index kernel_rows,
+                   Eigen::Index kernel_cols, Eigen::Index kernel_channels,
+                   Eigen::Index kernel_filters, Eigen::Index output_rows,
+                   Eigen::Index output_cols, Eigen::Index row_stride,
+                   Eigen::Index col_stride, Eigen::Index padding_top,
+                   Eigen::Index padding_bottom, Eigen::Index padding_left,
+                   Eigen::Index padding_right, Eigen::Index lhs_row_dilation,
+                   Eigen::Index lhs_col_dilation, Eigen::Index rhs_row_dilation,
+                   Eigen::Index rhs_col_dilation) {
+  const Eigen::TensorMap<Eigen::Tensor<const ScalarType, 4, Eigen::RowMajor>,
+                         Eigen::Aligned>
+      input(lhs, input_batch, input_rows, input_cols, input_channels);
+
+  const Eigen::TensorMap<Eigen::Tensor<const ScalarType, 4, Eigen::RowMajor>,
+                         Eigen::Aligned>
+      kernel(rhs, kernel_rows, kernel_cols, kernel_channels, kernel_filters);
+
+  Eigen::TensorMap<Eigen::Tensor<ScalarType, 4, Eigen::RowMajor>,
+                   Eigen::Aligned>
+      output(out, input_batch, output_rows, output_cols, kernel_filters);
+
+  EigenConvOfExpressions(device, output, input, kernel, input_batch,
+                         kernel_rows, kernel_cols, kernel_channels,
+                         kernel_filters, output_rows, output_cols, row_stride,
+                         col_stride, padding_top, padding_bottom, padding_left,
+                         padding_right, lhs_row_dilation, lhs_col_dilation,
+                         rhs_row_dilation, rhs_col_dilation);
+}
+
+// Like EigenConvImpl, but for an input and kernel of the narrower type
+// 'InputType', which are widened to 'ScalarType' as the patches are extracted
+// and packed. None of the buffers need to be aligned.
+template <typename EigenDevice, typename ScalarType, typename InputType>
+void EigenWideningConvImpl(
+    const EigenDevice& device, ScalarType* out, InputType* lhs, InputType* rhs,
+    Eigen::Index input_batch, Eigen::Index input_rows, Eigen::Index input_cols,
+    Eigen::Index input_channels, Eigen::Index kernel_rows,
+    Eigen::Index kernel_cols, Eigen::Index kernel_channels,
+    Eigen::Index kernel_filters, Eigen::Index output_rows,
+    Eigen::Index output_cols, Eigen::Index row_stride, Eigen::Index col_stride,
+    Eigen::Index padding_top, Eigen::Index padding_bottom,
+    Eigen::Index padding_left, Eigen::Index padding_right,
+    Eigen::Index lhs_row_dilation, Eigen::Index lhs_col_dilation,
+    Eigen::Index rhs_row_dilation, Eigen::Index rhs_col_dilation) {
+  const Eigen::TensorMap<Eigen::Tensor<const InputType, 4, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+      input(lhs, input_batch, input_rows, input_cols, input_channels);
+
+  const Eigen::TensorMap<Eigen::Tensor<const InputType, 4, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+      kernel(rhs, kernel_rows, kernel_cols, kernel_channels, kernel_filters);
+
+  Eigen::TensorMap<Eigen::Tensor<ScalarType, 4, Eigen::RowMajor>,
+                   Eigen::Unaligned>
+      output(out, input_batch, output_rows, output_cols, kernel_filters);
+
+  EigenConvOfExpressions(
+      device, output, input.template cast<ScalarType>(),
+      kernel.template cast<ScalarType>(), input_batch, kernel_rows, kernel_cols,
+      kernel_channels, kernel_filters, output_rows, output_cols, row_stride,
+      col_stride, padding_top, padding_bottom, padding_left, padding_right,
+      lhs_row_dilation, lhs_col_dilation, rhs_row_dilation, rhs_col_dilation);
+}
+
 }  // namespace xla
 }  // namespace tensorflow
 
@@ -14,13 +14,18 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/compiler/xla/service/cpu/runtime_key_value_sort.h"
 
+#define EIGEN_USE_THREADS
+
 #include <algorithm>
 #include <cstring>
 #include <memory>
 #include <numeric>
-#include <string>
+#include <utility>
+#include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/compiler/xla/executable_run_options.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/dynamic_annotations.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
@@ -28,12 +33,271 @@ limitations under the License.
 namespace {
 using tensorflow::int32;
 using tensorflow::int64;
+
+using LessThanFunction = void (*)(char*, char*, char**, char**, int64*);
+
+// Sorts with fewer elements than this in total run on the calling thread.
+constexpr int64 kMinParallelSortElements = 1 << 14;
+
+// A single row is only split into shards of at least this many elements.
+constexpr int64 kMinShardElements = 1 << 12;
+
+// The arguments of a call to __xla_cpu_runtime_KeyValueSort.
+struct SortArguments {
+  int64 sort_dimension_elements;
+  int64 sort_dimension_offset;
+  char** values;
+  int32 values_count;
+  int32* values_primitive_type_size_in_bytes;
+  char* run_options;
+  int64* prof_counters;
+  LessThanFunction less_than;
+
+  // Returns the offset of the first element of the 'row'-th row to sort.
+  int64 BaseOffset(int64 row) const {
+    // 'row' can be split into two values which index into the 'c' dimension
+    // and the 'a' dimension, respectively. 'row' % 'c' is the index into the
+    // 'c' dimension, 'row' / 'c' is the index into the 'a' dimension. When
+    // calculating the base offset, we need to multiply the index into the 'a'
+    // dimension with 'b' * 'c'.
+    // 'row' / 'c' * 'c' * 'b' = ('row' - 'row' % 'c') * 'b'.
+    return row % sort_dimension_offset +
+           (row - row % sort_dimension_offset) * sort_dimension_elements;
+  }
+};
+
+// Compares the elements of a row by their index in it, using the less-than
+// function. It writes the arguments of the less-than function to
+// 'comparison_values', so it must not be used by several threads at once.
+class ElementLess {
+ public:
+  ElementLess(const SortArguments* args, int64 base_offset,
+              char** comparison_values)
+      : args_(args),
+        base_offset_(base_offset),
+        comparison_values_(comparison_values) {}
+
+  bool operator()(int64 lhs, int64 rhs) const {
+    for (int32 i = 0; i < args_->values_count; ++i) {
+      const int64 size = args_->values_primitive_type_size_in_bytes[i];
+      comparison_values_[i * 2] =
+          args_->values[i] +
+          (base_offset_ + lhs * args_->sort_dimension_offset) * size;
+      comparison_values_[i * 2 + 1] =
+          args_->values[i] +
+          (base_offset_ + rhs * args_->sort_dimension_offset) * size;
+    }
+    char result = 0;  // Overwritten by less_than.
+    args_->less_than(&result, args_->run_options, comparison_values_, nullptr,
+                     args_->prof_counters);
+    return result != 0u;
+  }
+
+ private:
+  const SortArguments* args_;
+  int64 base_offset_;
+  char** comparison_values_;
+};
+
+// Breaks the ties of ElementLess by the index of the elements, which makes
+// algorithms that aren't stable order the elements like a stable sort.
+class StableElementLess {
+ public:
+  explicit StableElementLess(ElementLess less) : less_(less) {}
+
+  bool operator()(int64 lhs, int64 rhs) const {
+    if (less_(lhs, rhs)) {
+      return true;
+    }
+    if (less_(rhs, lhs)) {
+      return false;
+    }
+    return lhs < rhs;
+  }
+
+ private:
+  ElementLess less_;
+};
+
+// Moves the first 'num_sorted_elements' indices in 'indices[0, num_indices)'
+// into sorted order.
+void SortIndices(ElementLess less, bool is_stable, int64 num_sorted_elements,
+                 int64* indices, int64 num_indices) {
+  if (num_sorted_elements < num_indices) {
+    if (is_stable) {
+      std::partial_sort(indices, indices + num_sorted_elements,
+                        indices + num_indices, StableElementLess(less));
+    } else {
+      std::partial_sort(indices, indices + num_sorted_elements,
+                        indices + num_indices, less);
+    }
+  } else if (is_stable) {
+    std::stable_sort(indices, indices + num_indices, less);
+  } else {
+    std::sort(indices, indices + num_indices, less);
+  }
+}
+
+// Runs 'fn(i)' for every i in [0, n), on the calling thread for i = 0 and on
+// 'thread_pool' for the others, and waits for all of them.
+template <typename Fn>
+void ForkJoin(const Eigen::ThreadPoolDevice* thread_pool, int64 n,
+              const Fn& fn) {
+  tensorflow::BlockingCounter counter(n - 1);
+  for (int64 i = 1; i < n; ++i) {
+    thread_pool->enqueueNoNotification([i, &fn, &counter]() {
+      fn(i);
+      counter.DecrementCount();
+    });
+  }
+  fn(0);
+  counter.Wait();
+}
+
+// The buffers needed to sort a row, which are reused across rows.
+class RowSorter {
+ public:
+  explicit RowSorter(const SortArguments* args)
+      : args_(args),
+        indices_(new int64[args->sort_dimension_elements]),
+        comparison_values_(new char*[2 * args->values_count]) {
+    int32 max_size = 0;
+    for (int32 i = 0; i < args->values_count; ++i) {
+      max_size =
+          std::max(max_size, args->values_primitive_type_size_in_bytes[i]);
+    }
+    reordered_values_.reset(
+        new char[args->sort_dimension_elements * max_size]);
+  }
+
+  // Sorts the 'row'-th row on the calling thread.
+  void Sort(int64 row, bool is_stable, int64 num_sorted_elements) {
+    const int64 base_offset = args_->BaseOffset(row);
+    std::iota(indices_.get(), indices_.get() + args_->sort_dimension_elements,
+              0);
+    SortIndices(ElementLess(args_, base_offset, comparison_values_.get()),
+                is_stable, num_sorted_elements, indices_.get(),
+                args_->sort_dimension_elements);
+    Reorder(base_offset);
+  }
+
+  // Sorts the 'row'-th row with 'num_shards' threads of 'thread_pool'. Each
+  // thread sorts a shard of the row, then the shards are merged pairwise, in
+  // parallel too. If only a prefix of the row needs to be sorted, each thread
+  // selects the prefix of its shard instead, and the prefix of the row is
+  // selected from theirs.
+  void SortInParallel(int64 row, bool is_stable, int64 num_sorted_elements,
+                      const Eigen::ThreadPoolDevice* thread_pool,
+                      int64 num_shards) {
+    const int64 base_offset = args_->BaseOffset(row);
+    const int64 n = args_->sort_dimension_elements;
+    int64* indices = indices_.get();
+    std::iota(indices, indices + n, 0);
+    auto shard_begin = [&](int64 shard) { return n * shard / num_shards; };
+    // Every task needs its own arguments for the less-than function.
+    auto less_for_task = [&](std::vector<char*>* comparison_values) {
+      comparison_values->resize(2 * args_->values_count);
+      return ElementLess(args_, base_offset, comparison_values->data());
+    };
+
+    ForkJoin(thread_pool, num_shards, [&](int64 shard) {
+      std::vector<char*> comparison_values;
+      const int64 begin = shard_begin(shard);
+      const int64 size = shard_begin(shard + 1) - begin;
+      SortIndices(less_for_task(&comparison_values), is_stable,
+                  std::min(num_sorted_elements, size), indices + begin, size);
+    });
+
+    if (num_sorted_elements < n) {
+      std::vector<int64> candidates;
+      for (int64 shard = 0; shard < num_shards; ++shard) {
+        const int64 begin = shard_begin(shard);
+        const int64 size = shard_begin(shard + 1) - begin;
+        candidates.insert(candidates.end(), indices + begin,
+                          indices + begin + std::min(num_sorted_elements, size));
+      }
+      std::vector<char*> comparison_values;
+      // The candidates are no longer in index order, so ties are always broken
+      // by index to keep the order of a stable sort.
+      std::partial_sort(
+          candidates.begin(), candidates.begin() + num_sorted_elements,
+          candidates.end(),
+          StableElementLess(less_for_task(&comparison_values)));
+      // The unsorted elements follow the sorted ones in index order.
+      std::vector<bool> is_sorted(n, false);
+      for (int64 i = 0; i < num_sorted_elements; ++i) {
+        indices[i] = candidates[i];
+        is_sorted[candidates[i]] = true;
+      }
+      int64 next = num_sorted_elements;
+      for (int64 i = 0; i < n; ++i) {
+        if (!is_sorted[i]) {
+          indices[next++] = i;
+        }
+      }
+    } else {
+      std::unique_ptr<int64[]> merged(new int64[n]);
+      int64* source = indices;
+      int64* destination = merged.get();
+      for (int64 width = 1; width < num_shards; width *= 2) {
+        const int64 num_merges = (num_shards + 2 * width - 1) / (2 * width);
+        ForkJoin(thread_pool, num_merges, [&](int64 merge) {
+          std::vector<char*> comparison_values;
+          const int64 first_shard = 2 * width * merge;
+          const int64 begin = shard_begin(first_shard);
+          const int64 middle =
+              shard_begin(std::min(first_shard + width, num_shards));
+          const int64 end =
+              shard_begin(std::min(first_shard + 2 * width, num_shards));
+          // std::merge takes the first of equal elements from the first range,
+          // which keeps the order of a stable sort.
+          std::merge(source + begin, source + middle, source + middle,
+                     source + end, destination + begin,
+                     less_for_task(&comparison_values));
+        });
+        std::swap(source, destination);
+      }
+      if (source != indices) {
+        std::copy(source, source + n, indices);
+      }
+    }
+    Reorder(base_offset);
+  }
+
+ private:
+  // Reorders the values of the row at 'base_offset' according to the order
+  // defined by 'indices_'.
+  void Reorder(int64 base_offset) {
+    for (int32 idx = 0; idx < args_->values_count; ++idx) {
+      const int64 size = args_->values_primitive_type_size_in_bytes[idx];
+      char* row_values = args_->values[idx];
+      for (int64 i = 0; i < args_->sort_dimension_elements; ++i) {
+        const int64 memory_index =
+            (base_offset + indices_[i] * args_->sort_dimension_offset) * size;
+        memcpy(reordered_values_.get() + i * size, row_values + memory_index,
+               size);
+      }
+      for (int64 i = 0; i < args_->sort_dimension_elements; ++i) {
+        const int64 memory_index =
+            (base_offset + i * args_->sort_dimension_offset) * size;
+        memcpy(row_values + memory_index, reordered_values_.get() + i * size,
+               size);
+      }
+    }
+  }
+
+  const SortArguments* args_;
+  std::unique_ptr<int64[]> indices_;
+  std::unique_ptr<char*[]> comparison_values_;
+  std::unique_ptr<char[]> reordered_values_;
+};
+
 }  // namespace
 
 TF_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
     int64 a, int64 b, int64 c, char** values, int32 values_count,
     int32* values_primitive_type_size_in_bytes, bool is_stable,
-    char* run_options, int64* prof_counters,
+    int64 num_sorted_elements, char* run_options, int64* prof_counters,
     void (*less_than)(char*, char*, char**, char**, tensorflow::int64*)) {
   // 'values' and 'values_primitive_type_size_in_bytes' are managed by the JIT
   // code, so msan can't tell they are initialized.
@@ -49,70 +313,62 @@ TF_ATTRIBUTE_NO_SANITIZE_MEMORY void __xla_cpu_runtime_KeyValueSort(
   // many rows that we need to sort. We iterate through these, calculate a
   // 'base_offset' value which points to the first element in that row, and add
   // i * c for accessing the 'i'-th element in that row.
+  const SortArguments args{b,
+                           c,
+                           values,
+                           values_count,
+                           values_primitive_type_size_in_bytes,
+                           run_options,
+                           prof_counters,
+                           less_than};
+  const int64 num_rows = a * c;
+  if (num_rows == 0 || b == 0) {
+    return;
+  }
+  if (num_sorted_elements <= 0 || num_sorted_elements > b) {
+    num_sorted_elements = b;
+  }
 
-  int64 sort_dimension_elements = b;
-  int64 num_iteration_elements = a * c;
-  int64 sort_dimension_offset = c;
-
-  std::unique_ptr<int64[]> indices(new int64[sort_dimension_elements]);
-  std::unique_ptr<char*[]> comparison_values(new char*[2 * values_count]);
-  std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
-  std::unique_ptr<std::string[]> reordered_values(
-      new std::string[sort_dimension_elements]);
-  for (int64 index = 0; index < num_iteration_elements; ++index) {
-    // If the sort should be stable, we have to reinitialize indices to iota to
-    // guarantee that we still keep the relative order in case of ties.
-    if (is_stable && index > 0) {
-      std::iota(indices.get(), indices.get() + sort_dimension_elements, 0);
-    }
-    // 'index' can be split into two values which index into the 'c' dimension
-    // and the 'a' dimension, respectively. 'index' % 'c' is the index into the
-    // 'c' dimension, 'index' / 'c' is the index into the 'a' dimension. When
-    // calculating the base offset, we need to multiply the index into the 'a'
-    // dimension with 'b' * 'c'.
-    // 'index' / 'c' * 'c' * 'b' = ('index' - 'index' % 'c') * 'b'.
-    int64 base_offset =
-        index % sort_dimension_offset +
-        (index - index % sort_dimension_offset) * sort_dimension_elements;
-    auto compare_function = [&](int64 a, int64 b) -> bool {
-      for (int32 i = 0; i < values_count; ++i) {
-        int64 memory_index_lhs = (base_offset + a * sort_dimension_offset) *
-                                 values_primitive_type_size_in_bytes[i];
-        int64 memory_index_rhs = (base_offset + b * sort_dimension_offset) *
-                                 values_primitive_type_size_in_bytes[i];
-        comparison_values[i * 2] = values[i] + memory_index_lhs;
-        comparison_values[i * 2 + 1] = values[i] + memory_index_rhs;
+  // The less-than function may update the profile counters, which must stay
+  // exact, so profiled sorts run on the calling thread.
+  const Eigen::ThreadPoolDevice* thread_pool =
+      run_options != nullptr && prof_counters == nullptr
+          ? reinterpret_cast<const xla::ExecutableRunOptions*>(run_options)
+                ->intra_op_thread_pool()
+          : nullptr;
+  const int64 max_parallelism =
+      thread_pool != nullptr && num_rows * b >= kMinParallelSortElements
+          ? thread_pool->numThreads() + 1
+          : 1;
+
+  if (num_rows >= max_parallelism) {
+    // Each thread sorts a range of rows.
+    const int64 num_shards = std::min(num_rows, max_parallelism);
+    auto sort_rows = [&](int64 shard) {
+      RowSorter sorter(&args);
+      for (int64 row = num_rows * shard / num_shards;
+           row < num_rows * (shard + 1) / num_shards; ++row) {
+        sorter.Sort(row, is_stable, num_sorted_elements);
       }
-      char result = 0;  // Overwritten by less_than.
-      less_than(&result, run_options, comparison_values.get(), nullptr,
-                prof_counters);
-      return result != 0u;
     };
-    if (is_stable) {
-      std::stable_sort(indices.get(), indices.get() + sort_dimension_elements,
-                       compare_function);
+    if (num_shards == 1) {
+      sort_rows(0);
     } else {
-      std::sort(indices.get(), indices.get() + sort_dimension_elements,
-                compare_function);
+      ForkJoin(thread_pool, num_shards, sort_rows);
     }
+    return;
+  }
 
-    // Reorder the values according to the order defined by 'indices'.
-    for (int32 idx = 0; idx < values_count; ++idx) {
-      for (int64 i = 0; i < sort_dimension_elements; ++i) {
-        int64 memory_index =
-            (base_offset + indices[i] * sort_dimension_offset) *
-            values_primitive_type_size_in_bytes[idx];
-
-        reordered_values[i] =
-            std::string(values[idx] + memory_index,
-                        values_primitive_type_size_in_bytes[idx]);
-      }
-      for (int64 i = 0; i < sort_dimension_elements; ++i) {
-        int64 memory_index = (base_offset + i * sort_dimension_offset) *
-                             values_primitive_type_size_in_bytes[idx];
-        memcpy(values[idx] + memory_index, reordered_values[i].c_str(),
-               values_primitive_type_size_in_bytes[idx]);
-      }
+  // There are fewer rows than threads, so the threads share each row.
+  const int64 num_shards =
+      std::min(max_parallelism, std::max<int64>(b / kMinShardElements, 1));
+  RowSorter sorter(&args);
+  for (int64 row = 0; row < num_rows; ++row) {
+    if (num_shards == 1) {
+      sorter.Sort(row, is_stable, num_sorted_elements);
+    } else {
+      sorter.SortInParallel(row, is_stable, num_sorted_elements, thread_pool,
+                            num_shards);
     }
   }
 }
@@ -27,7 +27,11 @@ extern "C" {
 // function. 'values_count' must be > 0 and specifies the number of entries in
 // 'values' and 'values_primitive_type_size_in_bytes'. The size of the primitive
 // type of the i-th shape has exactly 'values_primitive_type_size_in_bytes[i]'
-// bytes. 'is_stable' specifies whether the sorting should be stable.
+// bytes. 'is_stable' specifies whether the sorting should be stable. Only the
+// first 'num_sorted_elements' elements of the 'b' dimension need to be sorted,
+// the others are left in an unspecified order; values <= 0 sort all of them.
+// Large sorts run on the intra-op thread pool of 'run_options', if any: each
+// thread sorts different rows, or a shard of a row if there are few of them.
 // 'run_options' and 'prof_counters' are passed through to the less-than
 // function, which expects the following arguments:
 // - pointer to the return value buffer (char*)
@@ -39,7 +43,8 @@ extern void __xla_cpu_runtime_KeyValueSort(
     tensorflow::int64 a, tensorflow::int64 b, tensorflow::int64 c,
     char** values, tensorflow::int32 values_count,
     tensorflow::int32* values_primitive_type_size_in_bytes, bool is_stable,
-    char* run_options, tensorflow::int64* prof_counters,
+    tensorflow::int64 num_sorted_elements, char* run_options,
+    tensorflow::int64* prof_counters,
     void (*less_than)(char*, char*, char**, char**, tensorflow::int64*));
 }
 
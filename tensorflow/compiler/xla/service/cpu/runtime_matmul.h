@@ -64,6 +64,14 @@ extern void __xla_cpu_runtime_EigenMatMulS32(
     tensorflow::int64 m, tensorflow::int64 n, tensorflow::int64 k,
     tensorflow::int32 transpose_lhs, tensorflow::int32 transpose_rhs);
 
+// Multiplies two int8 matrices with int32 accumulation, as in the
+// int8 x int8 -> int32 dots of quantized models.
+extern void __xla_cpu_runtime_EigenMatMulS8S32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    tensorflow::int32* out, tensorflow::int8* lhs, tensorflow::int8* rhs,
+    tensorflow::int64 m, tensorflow::int64 n, tensorflow::int64 k,
+    tensorflow::int32 transpose_lhs, tensorflow::int32 transpose_rhs);
+
 }  // extern "C"
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_MATMUL_H_
@@ -25,6 +25,7 @@ limitations under the License.
 
 using tensorflow::int32;
 using tensorflow::int64;
+using tensorflow::int8;
 
 namespace {
 
@@ -65,6 +66,40 @@ void MatMul(const void* run_options_ptr, T* out, T* lhs, T* rhs, int64 m,
   C = A.contract(B, dims);
 }
 
+// Like MatMul, but for operands of the narrower type 'InputT'. The operands
+// are widened to T as the contraction packs them, so the widened matrices are
+// never materialized.
+template <typename T, typename InputT>
+void WideningMatMul(const void* run_options_ptr, T* out, InputT* lhs,
+                    InputT* rhs, int64 m, int64 n, int64 k, int32 transpose_lhs,
+                    int32 transpose_rhs) {
+  int64 lhs_rows = m;
+  int64 lhs_cols = k;
+  if (transpose_lhs) {
+    std::swap(lhs_rows, lhs_cols);
+  }
+
+  int64 rhs_rows = k;
+  int64 rhs_cols = n;
+  if (transpose_rhs) {
+    std::swap(rhs_rows, rhs_cols);
+  }
+
+  const Eigen::TensorMap<Eigen::Tensor<const InputT, 2>, Eigen::Unaligned> A(
+      lhs, lhs_rows, lhs_cols);
+  const Eigen::TensorMap<Eigen::Tensor<const InputT, 2>, Eigen::Unaligned> B(
+      rhs, rhs_rows, rhs_cols);
+  Eigen::TensorMap<Eigen::Tensor<T, 2>, Eigen::Unaligned> C(out, m, n);
+
+  typedef typename Eigen::Tensor<T, 2>::DimensionPair DimPair;
+  int lhs_contract_dim = transpose_lhs ? 0 : 1;
+  int rhs_contract_dim = transpose_rhs ? 1 : 0;
+  const Eigen::array<DimPair, 1> dims(
+      {DimPair(lhs_contract_dim, rhs_contract_dim)});
+
+  C = A.template cast<T>().contract(B.template cast<T>(), dims);
+}
+
 template <typename T>
 void SingleThreadedMatMulDispatch(const void* run_options_ptr, T* out, T* lhs,
                                   T* rhs, int64 m, int64 n, int64 k,
@@ -139,3 +174,13 @@ __xla_cpu_runtime_EigenSingleThreadedMatMulS32(const void* run_options_ptr,
   SingleThreadedMatMulDispatch<int32>(run_options_ptr, out, lhs, rhs, m, n, k,
                                       transpose_lhs, transpose_rhs);
 }
+
+TF_ATTRIBUTE_NO_SANITIZE_MEMORY void
+__xla_cpu_runtime_EigenSingleThreadedMatMulS8S32(const void* run_options_ptr,
+                                                 int32* out, int8* lhs,
+                                                 int8* rhs, int64 m, int64 n,
+                                                 int64 k, int32 transpose_lhs,
+                                                 int32 transpose_rhs) {
+  WideningMatMul<int32, int8>(run_options_ptr, out, lhs, rhs, m, n, k,
+                              transpose_lhs, transpose_rhs);
+}
@@ -66,6 +66,12 @@ extern void __xla_cpu_runtime_EigenSingleThreadedMatMulS32(
     tensorflow::int64 m, tensorflow::int64 n, tensorflow::int64 k,
     tensorflow::int32 transpose_lhs, tensorflow::int32 transpose_rhs);
 
+extern void __xla_cpu_runtime_EigenSingleThreadedMatMulS8S32(
+    const void* /* xla::ExecutableRunOptions* */ run_options_ptr,
+    tensorflow::int32* out, tensorflow::int8* lhs, tensorflow::int8* rhs,
+    tensorflow::int64 m, tensorflow::int64 n, tensorflow::int64 k,
+    tensorflow::int32 transpose_lhs, tensorflow::int32 transpose_rhs);
+
 }  // extern "C"
 
 #endif  // TENSORFLOW_COMPILER_XLA_SERVICE_CPU_RUNTIME_SINGLE_THREADED_MATMUL_H_
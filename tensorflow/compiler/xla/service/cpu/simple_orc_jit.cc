@@ -22,14 +22,18 @@ limitations under the License.
 #include <utility>
 
 #include "absl/memory/memory.h"
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Mangler.h"
 #include "llvm/IR/Operator.h"
+#include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/CodeGen.h"
 #include "llvm/Support/Host.h"
 #include "tensorflow/compiler/xla/service/cpu/cpu_runtime.h"
+#include "tensorflow/compiler/xla/service/cpu/llvm_module_splitter.h"
 #include "tensorflow/compiler/xla/service/cpu/orc_jit_memory_mapper.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_conv2d.h"
 #include "tensorflow/compiler/xla/service/cpu/runtime_conv2d_mkl.h"
@@ -46,6 +50,7 @@ limitations under the License.
 #include "tensorflow/compiler/xla/service/cpu/windows_compatibility.h"
 #include "tensorflow/compiler/xla/service/custom_call_target_registry.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/logging.h"
 
 namespace xla {
@@ -89,11 +94,25 @@ SimpleOrcJIT::SimpleOrcJIT(
     LLVMCompiler::ModuleHook pre_optimization_hook,
     LLVMCompiler::ModuleHook post_optimization_hook,
     std::function<void(const llvm::object::ObjectFile&)> post_codegen_hook)
-    : target_machine_(InferTargetMachineForJIT(target_options, opt_level)),
+    : target_options_(target_options),
+      opt_level_(opt_level),
+      make_compiler_functor_(
+          [=](llvm::TargetMachine* target_machine) {
+            return CompilerFunctor(target_machine, opt_level,
+                                   optimize_for_size, disable_expensive_passes,
+                                   fast_math_flags, pre_optimization_hook,
+                                   post_optimization_hook, post_codegen_hook);
+          }),
+      target_machine_(InferTargetMachineForJIT(target_options, opt_level)),
       data_layout_(target_machine_->createDataLayout()),
       symbol_resolver_(llvm::orc::createLegacyLookupResolver(
           execution_session_,
           [this](llvm::StringRef name) -> llvm::JITSymbol {
+            // The parts of a module added by AddModuleInParallel refer to
+            // each other.
+            if (auto symbol = this->FindCompiledSymbol(std::string(name))) {
+              return symbol;
+            }
             return this->ResolveRuntimeSymbol(std::string(name));
           },
           [](llvm::Error Err) {
@@ -119,13 +138,8 @@ SimpleOrcJIT::SimpleOrcJIT(
           [this](VModuleKeyT, const llvm::object::ObjectFile& object) {
             this->NotifyObjectFreed(object);
           }),
-      compile_layer_(
-          object_layer_,
-          CompilerFunctor(target_machine_.get(), opt_level, optimize_for_size,
-                          disable_expensive_passes, fast_math_flags,
-                          std::move(pre_optimization_hook),
-                          std::move(post_optimization_hook),
-                          std::move(post_codegen_hook))),
+      compile_layer_(object_layer_,
+                     make_compiler_functor_(target_machine_.get())),
       gdb_jit_event_listener_(
           llvm::JITEventListener::createGDBRegistrationListener()) {
   VLOG(1) << "CPU target: " << target_machine_->getTargetCPU().str()
@@ -180,6 +194,57 @@ SimpleOrcJIT::VModuleKeyT SimpleOrcJIT::AddModule(
   return key;
 }
 
+std::vector<SimpleOrcJIT::VModuleKeyT> SimpleOrcJIT::AddModuleInParallel(
+    std::unique_ptr<llvm::Module> module, int max_num_parts,
+    tensorflow::thread::ThreadPool* thread_pool) {
+  std::vector<std::string> parts =
+      SplitModuleToBitcode(module.get(), max_num_parts);
+  if (parts.empty()) {
+    return {AddModule(std::move(module))};
+  }
+  module.reset();
+
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> objects(parts.size());
+  tensorflow::BlockingCounter parts_compiled(parts.size());
+  for (int i = 0; i < parts.size(); ++i) {
+    thread_pool->Schedule([&, i]() {
+      // Neither LLVM contexts nor target machines can be used by several
+      // threads at once.
+      llvm::LLVMContext context;
+      std::unique_ptr<llvm::Module> part = cantFail(llvm::parseBitcodeFile(
+          llvm::MemoryBufferRef(parts[i], "part"), context));
+      std::unique_ptr<llvm::TargetMachine> target_machine =
+          InferTargetMachineForJIT(target_options_, opt_level_);
+      objects[i] = make_compiler_functor_(target_machine.get())(*part);
+      parts_compiled.DecrementCount();
+    });
+  }
+  parts_compiled.Wait();
+
+  std::vector<VModuleKeyT> keys;
+  for (std::unique_ptr<llvm::MemoryBuffer>& object : objects) {
+    keys.push_back(cantFail(AddObjectFile(std::move(object))));
+  }
+  return keys;
+}
+
+llvm::Expected<SimpleOrcJIT::VModuleKeyT> SimpleOrcJIT::AddObjectFile(
+    std::unique_ptr<llvm::MemoryBuffer> object) {
+  // The object layer only parses the object when it is finalized, so check it
+  // here to report malformed objects to the caller.
+  auto object_file =
+      llvm::object::ObjectFile::createObjectFile(object->getMemBufferRef());
+  if (!object_file) {
+    return object_file.takeError();
+  }
+  auto key = execution_session_.allocateVModule();
+  if (llvm::Error error = object_layer_.addObject(key, std::move(object))) {
+    return std::move(error);
+  }
+  module_keys_.push_back(key);
+  return key;
+}
+
 void SimpleOrcJIT::RemoveModule(SimpleOrcJIT::VModuleKeyT key) {
   module_keys_.erase(std::remove(module_keys_.begin(), module_keys_.end(), key),
                      module_keys_.end());
@@ -243,6 +308,7 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(MKLConvF32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenConvF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenConvF32);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenConvS8S32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenFft);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulF32);
@@ -250,12 +316,14 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulC64);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulC128);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulS32);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenMatMulS8S32);
   REGISTER_CPU_RUNTIME_SYMBOL(MKLMatMulF32);
   REGISTER_CPU_RUNTIME_SYMBOL(MKLMatMulF64);
   REGISTER_CPU_RUNTIME_SYMBOL(MKLSingleThreadedMatMulF32);
   REGISTER_CPU_RUNTIME_SYMBOL(MKLSingleThreadedMatMulF64);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedConvF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedConvF32);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedConvS8S32);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedFft);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulF16);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulF32);
@@ -263,6 +331,7 @@ bool RegisterKnownJITSymbols() {
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulC64);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulC128);
   REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulS32);
+  REGISTER_CPU_RUNTIME_SYMBOL(EigenSingleThreadedMatMulS8S32);
   REGISTER_CPU_RUNTIME_SYMBOL(ParallelForkJoin);
   REGISTER_CPU_RUNTIME_SYMBOL(ReleaseInfeedBufferAfterDequeue);
   REGISTER_CPU_RUNTIME_SYMBOL(ReleaseOutfeedBufferAfterPopulation);
@@ -27,9 +27,12 @@ limitations under the License.
 #include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/Orc/SymbolStringPool.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Target/TargetMachine.h"
 #include "tensorflow/compiler/xla/service/cpu/compiler_functor.h"
 #include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/core/platform/threadpool.h"
 
 namespace xla {
 namespace cpu {
@@ -39,7 +42,7 @@ namespace cpu {
 // This class wraps Orc's functionality into a single interface that only
 // exposes what we need for XLA.
 //
-// Supports JIT-ing multiple modules but without cross-module linking.
+// Supports JIT-ing multiple modules, whose symbols are visible to each other.
 // Implements eager compilation - the module is lowered to binary as soon as
 // it's added to the JIT.
 class SimpleOrcJIT {
@@ -73,6 +76,21 @@ class SimpleOrcJIT {
   // remove this module.
   VModuleKeyT AddModule(std::unique_ptr<llvm::Module> module);
 
+  // Splits 'module' into up to 'max_num_parts' modules, which are optimized
+  // and compiled concurrently on 'thread_pool', then adds them to the JIT like
+  // AddModule. Functions in different parts can't be inlined into each other.
+  // The hooks are invoked for every part, from the threads of 'thread_pool'.
+  // Returns the keys of the parts.
+  std::vector<VModuleKeyT> AddModuleInParallel(
+      std::unique_ptr<llvm::Module> module, int max_num_parts,
+      tensorflow::thread::ThreadPool* thread_pool);
+
+  // Add an object file that was compiled for this JIT's target machine, e.g.
+  // by a previous process. Returns an opaque key like AddModule, or an error
+  // if 'object' isn't a valid object file.
+  llvm::Expected<VModuleKeyT> AddObjectFile(
+      std::unique_ptr<llvm::MemoryBuffer> object);
+
   // Remove a module from the JIT and free the memory associated with it.
   void RemoveModule(VModuleKeyT key);
 
@@ -101,6 +119,12 @@ class SimpleOrcJIT {
   void NotifyObjectFreed(const llvm::object::ObjectFile& object);
 
   std::vector<VModuleKeyT> module_keys_;
+  const llvm::TargetOptions target_options_;
+  const llvm::CodeGenOpt::Level opt_level_;
+  // Returns a CompilerFunctor with the options and hooks of this JIT that
+  // compiles for the given target machine.
+  const std::function<CompilerFunctor(llvm::TargetMachine*)>
+      make_compiler_functor_;
   std::unique_ptr<llvm::TargetMachine> target_machine_;
   const llvm::DataLayout data_layout_;
   llvm::orc::ExecutionSession execution_session_;
@@ -0,0 +1,150 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/executable.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/maybe_owning_device_memory.h"
+#include "tensorflow/compiler/xla/service/service_executable_run_options.h"
+#include "tensorflow/compiler/xla/service/shaped_buffer.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+const char* const kMayAliasModule = R"(
+HloModule may_alias, input_output_alias={ {}: (0, {}, SYSTEM) }
+
+ENTRY main {
+  p0 = f32[4] parameter(0)
+  p1 = f32[4] parameter(1)
+  ROOT add = f32[4] add(p0, p1)
+}
+)";
+
+// Runs a computation whose output may alias its first parameter, with and
+// without donating the buffer of that parameter.
+class CpuBufferDonationTest : public HloTestBase {
+ protected:
+  // Runs kMayAliasModule and returns whether the output reused the buffer of
+  // parameter 0. Checks the result, and that an undonated parameter 0 is left
+  // unchanged.
+  //
+  // As XlaLaunch does, a donated buffer stays owned by the caller until the
+  // output is committed, and is then taken back from the output. If
+  // `commit` is false, the output is dropped as after a failed execution,
+  // which must leave the buffer to the caller.
+  bool RunAndCheck(bool donate, bool commit = true) {
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnVerifiedModule(kMayAliasModule).ValueOrDie();
+    std::unique_ptr<Executable> executable =
+        test_runner_
+            .CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+            .ValueOrDie();
+
+    se::DeviceMemoryAllocator* allocator = backend().memory_allocator();
+    auto stream = backend().BorrowStream(0).ValueOrDie();
+    Literal p0 = LiteralUtil::CreateR1<float>({1, 2, 3, 4});
+    Literal p1 = LiteralUtil::CreateR1<float>({10, 20, 30, 40});
+    std::vector<ScopedShapedBuffer> buffers;
+    for (const Literal* literal : {&p0, &p1}) {
+      buffers.push_back(
+          backend()
+              .transfer_manager()
+              ->AllocateScopedShapedBuffer(literal->shape(), allocator,
+                                           /*device_ordinal=*/0)
+              .ValueOrDie());
+      TF_CHECK_OK(backend().transfer_manager()->TransferLiteralToDevice(
+          stream.get(), *literal, buffers.back()));
+    }
+    se::DeviceMemoryBase p0_buffer = buffers[0].root_buffer();
+
+    std::vector<ExecutionInput> arguments;
+    for (int i = 0; i < buffers.size(); ++i) {
+      ExecutionInput argument(buffers[i].on_device_shape());
+      if (donate && i == 0) {
+        argument.SetUnownedBuffer(
+            {}, MaybeOwningDeviceMemory(se::OwningDeviceMemory(
+                    p0_buffer, /*device_ordinal=*/0, allocator)));
+      } else {
+        argument.SetBuffer({},
+                           MaybeOwningDeviceMemory(buffers[i].root_buffer()));
+      }
+      arguments.push_back(std::move(argument));
+    }
+
+    ExecutableRunOptions run_options;
+    run_options.set_stream(stream.get());
+    run_options.set_allocator(allocator);
+    ServiceExecutableRunOptions service_run_options(run_options);
+    ExecutionOutput output =
+        executable
+            ->ExecuteAsyncOnStream(&service_run_options, std::move(arguments),
+                                   /*hlo_execution_profile=*/nullptr)
+            .ValueOrDie();
+    TF_CHECK_OK(stream->BlockHostUntilDone());
+
+    Literal result = backend()
+                         .transfer_manager()
+                         ->TransferLiteralFromDevice(stream.get(),
+                                                     output.Result())
+                         .ValueOrDie();
+    EXPECT_TRUE(LiteralTestUtil::Equal(
+        LiteralUtil::CreateR1<float>({11, 22, 33, 44}), result));
+    if (!donate) {
+      Literal p0_after = backend()
+                             .transfer_manager()
+                             ->TransferLiteralFromDevice(stream.get(),
+                                                         buffers[0])
+                             .ValueOrDie();
+      EXPECT_TRUE(LiteralTestUtil::Equal(p0, p0_after));
+    }
+    const bool reused =
+        output.Result().root_buffer().opaque() == p0_buffer.opaque();
+    if (commit) {
+      output.Commit();
+      if (reused) {
+        output.MutableResult()->set_buffer(se::OwningDeviceMemory(), {});
+      }
+    }
+    return reused;
+  }
+};
+
+TEST_F(CpuBufferDonationTest, DonatedParameterIsReusedForOutput) {
+  EXPECT_TRUE(RunAndCheck(/*donate=*/true));
+}
+
+// The donated buffer is freed once, by the caller, when the output is not
+// committed.
+TEST_F(CpuBufferDonationTest, UncommittedOutputReturnsDonatedBuffer) {
+  EXPECT_TRUE(RunAndCheck(/*donate=*/true, /*commit=*/false));
+}
+
+TEST_F(CpuBufferDonationTest, UndonatedParameterIsNotOverwritten) {
+  EXPECT_FALSE(RunAndCheck(/*donate=*/false));
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,107 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+
+#include "tensorflow/compiler/xla/service/cpu/tests/cpu_codegen_test.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+const char* const kDot = R"(
+HloModule int8_dot
+
+ENTRY main {
+  lhs = s8[64,48] parameter(0)
+  rhs = s8[48,32] parameter(1)
+  lhs.s32 = s32[64,48] convert(lhs)
+  rhs.s32 = s32[48,32] convert(rhs)
+  ROOT dot = s32[64,32] dot(lhs.s32, rhs.s32), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+}
+)";
+
+const char* const kTransposedDot = R"(
+HloModule int8_transposed_dot
+
+ENTRY main {
+  lhs = s8[48,64] parameter(0)
+  rhs = s8[32,48] parameter(1)
+  lhs.s32 = s32[48,64] convert(lhs)
+  rhs.s32 = s32[32,48] convert(rhs)
+  ROOT dot = s32[64,32] dot(lhs.s32, rhs.s32), lhs_contracting_dims={0},
+    rhs_contracting_dims={1}
+}
+)";
+
+const char* const kConvolution = R"(
+HloModule int8_convolution
+
+ENTRY main {
+  input = s8[2,10,10,8] parameter(0)
+  kernel = s8[3,3,8,16] parameter(1)
+  input.s32 = s32[2,10,10,8] convert(input)
+  kernel.s32 = s32[3,3,8,16] convert(kernel)
+  ROOT convolution = s32[2,5,5,16] convolution(input.s32, kernel.s32),
+    window={size=3x3 stride=2x2 pad=1_1x1_1}, dim_labels=b01f_01io->b01f
+}
+)";
+
+const char* const kConvolution1D = R"(
+HloModule int8_convolution_1d
+
+ENTRY main {
+  input = s8[2,20,4] parameter(0)
+  kernel = s8[3,4,8] parameter(1)
+  input.s32 = s32[2,20,4] convert(input)
+  kernel.s32 = s32[3,4,8] convert(kernel)
+  ROOT convolution = s32[2,16,8] convolution(input.s32, kernel.s32),
+    window={size=3 rhs_dilate=2}, dim_labels=b0f_0io->b0f
+}
+)";
+
+using CpuInt8KernelTest = CpuCodegenTest;
+
+TEST_F(CpuInt8KernelTest, DotCallsInt8Runtime) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module, ParseAndReturnVerifiedModule(kDot));
+  CompileAndVerifyIr(std::move(module), R"(
+CHECK: call void @__xla_cpu_runtime_Eigen{{(SingleThreaded)?}}MatMulS8S32
+)",
+                     /*match_optimized_ir=*/false);
+}
+
+TEST_F(CpuInt8KernelTest, ConvolutionCallsInt8Runtime) {
+  TF_ASSERT_OK_AND_ASSIGN(auto module,
+                          ParseAndReturnVerifiedModule(kConvolution));
+  CompileAndVerifyIr(std::move(module), R"(
+CHECK: call void @__xla_cpu_runtime_Eigen{{(SingleThreaded)?}}ConvS8S32
+)",
+                     /*match_optimized_ir=*/false);
+}
+
+// Compares the results of the int8 runtime kernels with those of the
+// HloEvaluator on the interpreter.
+TEST_F(CpuInt8KernelTest, MatchesReference) {
+  for (const char* hlo :
+       {kDot, kTransposedDot, kConvolution, kConvolution1D}) {
+    EXPECT_TRUE(RunAndCompare(hlo, ErrorSpec{0, 0}));
+  }
+}
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
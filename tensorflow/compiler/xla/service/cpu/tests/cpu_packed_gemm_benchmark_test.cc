@@ -0,0 +1,147 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks the wall time of matrix-matrix dots that XLA:CPU lowers to a call
+// into Eigen (arg 0) and to the packed GEMM emitter (arg 1). The test checks
+// that both compute the right results.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/executable.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Dots with all dimensions at most this size use the packed GEMM emitter.
+constexpr int kPackedGemmMaxDimension = 256;
+
+const char* const kDot = R"(
+HloModule dot
+
+ENTRY main {
+  lhs = f32[256,256] parameter(0)
+  rhs = f32[256,256] parameter(1)
+  ROOT dot = f32[256,256] dot(lhs, rhs), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+}
+)";
+
+const char* const kDotWithBias = R"(
+HloModule dot_with_bias
+
+ENTRY main {
+  lhs = f32[128,256] parameter(0)
+  rhs = f32[256,100] parameter(1)
+  bias = f32[128,100] parameter(2)
+  dot = f32[128,100] dot(lhs, rhs), lhs_contracting_dims={1},
+    rhs_contracting_dims={0}
+  ROOT add = f32[128,100] add(dot, bias)
+}
+)";
+
+const char* const kTransposedDot = R"(
+HloModule transposed_dot
+
+ENTRY main {
+  lhs = f64[96,130] parameter(0)
+  rhs = f64[70,96] parameter(1)
+  ROOT dot = f64[130,70] dot(lhs, rhs), lhs_contracting_dims={0},
+    rhs_contracting_dims={1}
+}
+)";
+
+std::unique_ptr<HloModule> ParseModule(const string& hlo, bool packed_gemm) {
+  HloModuleConfig config;
+  DebugOptions debug_options = GetDebugOptionsFromFlags();
+  debug_options.set_xla_cpu_packed_gemm_max_dimension(
+      packed_gemm ? kPackedGemmMaxDimension : 0);
+  config.set_debug_options(debug_options);
+  return ParseAndReturnUnverifiedModule(hlo, config).ValueOrDie();
+}
+
+using CpuPackedGemmTest = HloTestBase;
+
+TEST_F(CpuPackedGemmTest, MatchesReferenceWithAndWithoutPacking) {
+  for (const char* hlo : {kDot, kDotWithBias, kTransposedDot}) {
+    for (const bool packed_gemm : {false, true}) {
+      EXPECT_TRUE(
+          RunAndCompare(ParseModule(hlo, packed_gemm), ErrorSpec{1e-3, 1e-3}));
+    }
+  }
+}
+
+// Compiles 'hlo' with or without the packed GEMM emitter, and measures the wall
+// time of running it on a single thread.
+void RunBenchmark(int num_iters, const string& hlo, int packed_gemm) {
+  tensorflow::testing::StopTiming();
+  se::Platform* platform = PlatformUtil::GetPlatform("cpu").ValueOrDie();
+  HloRunner runner(platform, /*intra_op_parallelism_threads=*/1);
+  std::unique_ptr<HloModule> module = ParseModule(hlo, packed_gemm != 0);
+  std::vector<Literal> arguments = MakeFakeArguments(module.get()).ValueOrDie();
+  std::vector<ScopedShapedBuffer> argument_buffers;
+  for (const Literal& argument : arguments) {
+    argument_buffers.push_back(
+        runner.TransferLiteralToDevice(argument).ValueOrDie());
+  }
+  std::unique_ptr<Executable> executable =
+      runner.CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+          .ValueOrDie();
+
+  // Warm up.
+  runner.ExecuteWithDeviceBuffers(executable.get(), argument_buffers)
+      .ValueOrDie();
+
+  tensorflow::testing::UseRealTime();
+  tensorflow::testing::StartTiming();
+  for (int i = 0; i < num_iters; ++i) {
+    runner.ExecuteWithDeviceBuffers(executable.get(), argument_buffers)
+        .ValueOrDie();
+  }
+  tensorflow::testing::StopTiming();
+}
+
+void BM_Dot(int num_iters, int packed_gemm) {
+  RunBenchmark(num_iters, kDot, packed_gemm);
+}
+
+void BM_DotWithBias(int num_iters, int packed_gemm) {
+  RunBenchmark(num_iters, kDotWithBias, packed_gemm);
+}
+
+void BM_TransposedDot(int num_iters, int packed_gemm) {
+  RunBenchmark(num_iters, kTransposedDot, packed_gemm);
+}
+
+BENCHMARK(BM_Dot)->Arg(0)->Arg(1);
+BENCHMARK(BM_DotWithBias)->Arg(0)->Arg(1);
+BENCHMARK(BM_TransposedDot)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
@@ -0,0 +1,187 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/array2d.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/service/cpu/cpu_compiler.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/literal_test_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+// Returns a module that runs 'num_loops' while loops one after the other, so
+// that its IR has a function per loop body and condition.
+string ModuleWithWhileLoops(int num_loops) {
+  string hlo = R"(
+HloModule while_loops
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+)";
+  for (int i = 0; i < num_loops; ++i) {
+    absl::StrAppend(&hlo, "\ncondition.", i, R"( {
+  state = (s32[], f32[32,32]) parameter(0)
+  iteration = s32[] get-tuple-element(state), index=0
+  limit = s32[] constant(3)
+  ROOT less = pred[] compare(iteration, limit), direction=LT
+}
+)",
+                    "\nbody.", i, R"( {
+  state = (s32[], f32[32,32]) parameter(0)
+  iteration = s32[] get-tuple-element(state), index=0
+  one = s32[] constant(1)
+  next_iteration = s32[] add(iteration, one)
+  x = f32[32,32] get-tuple-element(state), index=1
+  dot = f32[32,32] dot(x, x), lhs_contracting_dims={1}, rhs_contracting_dims={0}
+  tanh = f32[32,32] tanh(dot)
+  transpose = f32[32,32] transpose(tanh), dimensions={1,0}
+  exp = f32[32,32] exponential(transpose)
+  scale = f32[] constant()",
+                    i + 1, R"()
+  broadcast_scale = f32[32,32] broadcast(scale), dimensions={}
+  scaled = f32[32,32] multiply(exp, broadcast_scale)
+  zero = f32[] constant(0)
+  sum = f32[32] reduce(scaled, zero), dimensions={1}, to_apply=add
+  broadcast_sum = f32[32,32] broadcast(sum), dimensions={0}
+  next_x = f32[32,32] subtract(scaled, broadcast_sum)
+  ROOT next_state = (s32[], f32[32,32]) tuple(next_iteration, next_x)
+}
+)");
+  }
+  absl::StrAppend(&hlo, R"(
+ENTRY main {
+  x.0 = f32[32,32] parameter(0)
+  zero = s32[] constant(0)
+)");
+  for (int i = 0; i < num_loops; ++i) {
+    absl::StrAppend(&hlo, "  init.", i,
+                    " = (s32[], f32[32,32]) tuple(zero, x.", i, ")\n");
+    absl::StrAppend(&hlo, "  loop.", i, " = (s32[], f32[32,32]) while(init.",
+                    i, "), condition=condition.", i, ", body=body.", i, "\n");
+    absl::StrAppend(&hlo, "  x.", i + 1,
+                    " = f32[32,32] get-tuple-element(loop.", i, "), index=1\n");
+  }
+  absl::StrAppend(&hlo, "  ROOT result = f32[32,32] copy(x.", num_loops,
+                  ")\n}\n");
+  return hlo;
+}
+
+class CpuParallelCodegenTest : public HloTestBase {
+ protected:
+  Literal Run(const string& hlo, int split_count,
+              const string& persistent_cache_dir = "") {
+    HloModuleConfig config = GetModuleConfigForTest();
+    DebugOptions debug_options = config.debug_options();
+    debug_options.set_xla_cpu_parallel_codegen_split_count(split_count);
+    debug_options.set_xla_cpu_persistent_cache_dir(persistent_cache_dir);
+    config.set_debug_options(debug_options);
+    std::unique_ptr<HloModule> module =
+        ParseAndReturnVerifiedModule(hlo, config).ValueOrDie();
+    Literal argument = LiteralUtil::CreateR2FromArray2D<float>(
+        Array2D<float>(32, 32, 0.01f));
+    return ExecuteAndTransfer(std::move(module), {&argument});
+  }
+};
+
+TEST_F(CpuParallelCodegenTest, MatchesSequentialCodegen) {
+  const string hlo = ModuleWithWhileLoops(/*num_loops=*/4);
+  Literal expected = Run(hlo, /*split_count=*/1);
+  for (const int split_count : {2, 3, 8}) {
+    SCOPED_TRACE(split_count);
+    EXPECT_TRUE(LiteralTestUtil::Near(expected, Run(hlo, split_count),
+                                      ErrorSpec{1e-4, 1e-4}));
+  }
+}
+
+TEST_F(CpuParallelCodegenTest, StoresAllPartsInPersistentCache) {
+  const string cache_dir =
+      tensorflow::io::JoinPath(tensorflow::testing::TmpDir(), "parallel_cache");
+  tensorflow::Env* env = tensorflow::Env::Default();
+  if (env->FileExists(cache_dir).ok()) {
+    int64 undeleted_files, undeleted_dirs;
+    TF_ASSERT_OK(
+        env->DeleteRecursively(cache_dir, &undeleted_files, &undeleted_dirs));
+  }
+  const string hlo = ModuleWithWhileLoops(/*num_loops=*/2);
+  Literal expected = Run(hlo, /*split_count=*/1);
+  // The first run stores the parts, the second one loads them.
+  for (int run = 0; run < 2; ++run) {
+    SCOPED_TRACE(run);
+    EXPECT_TRUE(LiteralTestUtil::Near(expected,
+                                      Run(hlo, /*split_count=*/4, cache_dir),
+                                      ErrorSpec{1e-4, 1e-4}));
+  }
+  std::vector<string> entries;
+  TF_ASSERT_OK(env->GetChildren(cache_dir, &entries));
+  EXPECT_EQ(entries.size(), 1);
+}
+
+// Measures the time the CPU backend takes to compile a module with many
+// computations, with its IR split into 'split_count' parts.
+void BM_CompileModuleWithWhileLoops(int num_iters, int split_count) {
+  tensorflow::testing::StopTiming();
+  se::StreamExecutor* executor = PlatformUtil::GetPlatform("cpu")
+                                     .ValueOrDie()
+                                     ->ExecutorForDevice(0)
+                                     .ValueOrDie();
+  CpuCompiler compiler;
+  HloModuleConfig config;
+  DebugOptions debug_options = GetDebugOptionsFromFlags();
+  debug_options.set_xla_cpu_parallel_codegen_split_count(split_count);
+  config.set_debug_options(debug_options);
+  const string hlo = ModuleWithWhileLoops(/*num_loops=*/32);
+
+  for (int i = 0; i < num_iters; ++i) {
+    std::unique_ptr<HloModule> module =
+        compiler
+            .RunHloPasses(
+                ParseAndReturnUnverifiedModule(hlo, config).ValueOrDie(),
+                executor, /*device_allocator=*/nullptr)
+            .ValueOrDie();
+    tensorflow::testing::StartTiming();
+    compiler.RunBackend(std::move(module), executor,
+                        /*device_allocator=*/nullptr)
+        .ValueOrDie();
+    tensorflow::testing::StopTiming();
+  }
+}
+
+BENCHMARK(BM_CompileModuleWithWhileLoops)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
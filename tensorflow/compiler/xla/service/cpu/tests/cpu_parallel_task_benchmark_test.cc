@@ -0,0 +1,165 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks the wall time of instructions that XLA:CPU splits into parallel
+// tasks, with the throughput cost model (arg 0) and with the legacy flops per
+// byte heuristic (arg 1). The test checks that both compute the right results.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/service/executable.h"
+#include "tensorflow/compiler/xla/service/hlo_module.h"
+#include "tensorflow/compiler/xla/service/hlo_module_config.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/service/hlo_runner.h"
+#include "tensorflow/compiler/xla/service/platform_util.h"
+#include "tensorflow/compiler/xla/tests/hlo_test_base.h"
+#include "tensorflow/compiler/xla/tests/test_utils.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace xla {
+namespace cpu {
+namespace {
+
+const char* const kElementwiseFusion = R"(
+HloModule elementwise_fusion
+
+ENTRY main {
+  x = f32[2048,2048] parameter(0)
+  y = f32[2048,2048] parameter(1)
+  z = f32[2048,2048] parameter(2)
+  multiply = f32[2048,2048] multiply(x, y)
+  ROOT add = f32[2048,2048] add(multiply, z)
+}
+)";
+
+const char* const kTranscendentalFusion = R"(
+HloModule transcendental_fusion
+
+ENTRY main {
+  x = f32[1024,1024] parameter(0)
+  exp = f32[1024,1024] exponential(x)
+  ROOT tanh = f32[1024,1024] tanh(exp)
+}
+)";
+
+const char* const kRowReduction = R"(
+HloModule row_reduction
+
+add {
+  lhs = f32[] parameter(0)
+  rhs = f32[] parameter(1)
+  ROOT add = f32[] add(lhs, rhs)
+}
+
+ENTRY main {
+  x = f32[4096,1024] parameter(0)
+  zero = f32[] constant(0)
+  ROOT reduce = f32[4096] reduce(x, zero), dimensions={1}, to_apply=add
+}
+)";
+
+const char* const kBatchMatrixVector = R"(
+HloModule batch_matrix_vector
+
+ENTRY main {
+  lhs = f32[64,512,512] parameter(0)
+  rhs = f32[64,512,1] parameter(1)
+  ROOT dot = f32[64,512,1] dot(lhs, rhs), lhs_batch_dims={0},
+    lhs_contracting_dims={2}, rhs_batch_dims={0}, rhs_contracting_dims={1}
+}
+)";
+
+std::unique_ptr<HloModule> ParseModule(const string& hlo,
+                                       bool legacy_cost_model) {
+  HloModuleConfig config;
+  DebugOptions debug_options = GetDebugOptionsFromFlags();
+  debug_options.set_xla_cpu_parallel_task_legacy_cost_model(legacy_cost_model);
+  config.set_debug_options(debug_options);
+  return ParseAndReturnUnverifiedModule(hlo, config).ValueOrDie();
+}
+
+using CpuParallelTaskTest = HloTestBase;
+
+TEST_F(CpuParallelTaskTest, MatchesReferenceWithEitherCostModel) {
+  for (const char* hlo : {kElementwiseFusion, kTranscendentalFusion,
+                          kRowReduction, kBatchMatrixVector}) {
+    for (const bool legacy_cost_model : {false, true}) {
+      EXPECT_TRUE(RunAndCompare(ParseModule(hlo, legacy_cost_model),
+                                ErrorSpec{1e-4, 1e-4}));
+    }
+  }
+}
+
+// Compiles 'hlo' with the given cost model, and measures the wall time of
+// running it on a thread pool with a thread per core.
+void RunBenchmark(int num_iters, const string& hlo, int legacy_cost_model) {
+  tensorflow::testing::StopTiming();
+  se::Platform* platform = PlatformUtil::GetPlatform("cpu").ValueOrDie();
+  HloRunner runner(platform, tensorflow::port::MaxParallelism());
+  std::unique_ptr<HloModule> module = ParseModule(hlo, legacy_cost_model != 0);
+  std::vector<Literal> arguments = MakeFakeArguments(module.get()).ValueOrDie();
+  std::vector<ScopedShapedBuffer> argument_buffers;
+  for (const Literal& argument : arguments) {
+    argument_buffers.push_back(
+        runner.TransferLiteralToDevice(argument).ValueOrDie());
+  }
+  std::unique_ptr<Executable> executable =
+      runner.CreateExecutable(std::move(module), /*run_hlo_passes=*/true)
+          .ValueOrDie();
+
+  // Warm up.
+  runner.ExecuteWithDeviceBuffers(executable.get(), argument_buffers)
+      .ValueOrDie();
+
+  tensorflow::testing::UseRealTime();
+  tensorflow::testing::StartTiming();
+  for (int i = 0; i < num_iters; ++i) {
+    runner.ExecuteWithDeviceBuffers(executable.get(), argument_buffers)
+        .ValueOrDie();
+  }
+  tensorflow::testing::StopTiming();
+}
+
+void BM_ElementwiseFusion(int num_iters, int legacy_cost_model) {
+  RunBenchmark(num_iters, kElementwiseFusion, legacy_cost_model);
+}
+
+void BM_TranscendentalFusion(int num_iters, int legacy_cost_model) {
+  RunBenchmark(num_iters, kTranscendentalFusion, legacy_cost_model);
+}
+
+void BM_RowReduction(int num_iters, int legacy_cost_model) {
+  RunBenchmark(num_iters, kRowReduction, legacy_cost_model);
+}
+
+void BM_BatchMatrixVector(int num_iters, int legacy_cost_model) {
+  RunBenchmark(num_iters, kBatchMatrixVector, legacy_cost_model);
+}
+
+BENCHMARK(BM_ElementwiseFusion)->Arg(0)->Arg(1);
+BENCHMARK(BM_TranscendentalFusion)->Arg(0)->Arg(1);
+BENCHMARK(BM_RowReduction)->Arg(0)->Arg(1);
+BENCHMARK(BM_BatchMatrixVector)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace cpu
+}  // namespace xla
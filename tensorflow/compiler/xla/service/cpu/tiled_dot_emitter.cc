@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "tensorflow/compiler/xla/service/cpu/tiled_dot_emitter.h"
 
+#include <algorithm>
+
 #include "tensorflow/compiler/xla/service/cpu/vector_support_library.h"
 #include "tensorflow/compiler/xla/service/hlo_module.h"
 #include "tensorflow/compiler/xla/service/llvm_ir/kernel_support_library.h"
 #include "tensorflow/compiler/xla/service/llvm_ir/llvm_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/util.h"
 
 namespace xla {
 namespace cpu {
@@ -938,6 +942,385 @@ void TiledSmallGemmEmitter::EmitTiledGemm(
   });
 }
 
+// This class implements a cache-blocked matrix multiplication for matrices
+// that are too large for TiledSmallGemmEmitter, following "Goto, Kazushige, and
+// Robert A. Geijn. "Anatomy of high-performance matrix multiplication." ACM
+// Transactions on Mathematical Software (TOMS) 34.3 (2008): 12.".
+//
+// The loop structure is:
+//
+// Iterate over dimension N in blocks of block_size_n as n_block:
+//   Iterate over dimension K in blocks of block_size_k as k_block:
+//     Pack Rhs[k_block, n_block] into panels of tile_size_n columns
+//     Iterate over dimension M in blocks of block_size_m as m_block:
+//       Pack Lhs[m_block, k_block] into panels of tile_size_m rows
+//       Iterate over the Rhs panels as n_tile:
+//         Iterate over the Lhs panels as m_tile:
+//           Result[m_tile, n_tile] += Dot(LhsPanel[m_tile], RhsPanel[n_tile])
+//
+// A packed Rhs panel holds its [block_size_k, tile_size_n] tile row by row and
+// a packed Lhs panel holds its [tile_size_m, block_size_k] tile column by
+// column, so the microkernel reads both panels sequentially.  The packing step
+// also reads transposed operands and zero pads the panels at the edges of the
+// matrices.  The microkernel therefore always computes a full [tile_size_m,
+// tile_size_n] tile, held in tile_size_m vector registers of width
+// tile_size_n; tiles that stick out of the result are stored through a scratch
+// buffer.
+//
+// The result is row major.  It is initialized with the addend if there is one,
+// so a bias add fused into the dot costs no extra pass over the result.
+class PackedGemmEmitter {
+ public:
+  // Represents the configuration of the emitter.  The LLVM IR emitted by the
+  // emitter, modulo the LLVM values holding the input and output buffers, must
+  // be a function of the instance of `Config` passed to it.
+  //
+  // The Lhs is [m, k] or, if `lhs_transposed`, [k, m] in memory.  The Rhs is
+  // [k, n] or, if `rhs_transposed`, [n, k] in memory.
+  class Config {
+   public:
+    explicit Config(PrimitiveType scalar_type, int64 m, int64 k, int64 n,
+                    bool lhs_transposed, bool rhs_transposed, int64 tile_size_m,
+                    int64 tile_size_n, int64 block_size_m, int64 block_size_k,
+                    int64 block_size_n, bool has_addend)
+        : scalar_type_(scalar_type),
+          m_(m),
+          k_(k),
+          n_(n),
+          lhs_transposed_(lhs_transposed),
+          rhs_transposed_(rhs_transposed),
+          tile_size_m_(tile_size_m),
+          tile_size_n_(tile_size_n),
+          block_size_m_(block_size_m),
+          block_size_k_(block_size_k),
+          block_size_n_(block_size_n),
+          has_addend_(has_addend) {}
+
+    string GetCacheKey() const {
+      return absl::StrCat(
+          "packed_gemm_", PrimitiveType_Name(scalar_type()), "_", m(), "x", k(),
+          "x", n(), "_", lhs_transposed() ? "lhs_t" : "lhs",
+          rhs_transposed() ? "_rhs_t" : "_rhs", "_", tile_size_m(), "x",
+          tile_size_n(), "_", block_size_m(), "x", block_size_k(), "x",
+          block_size_n(), has_addend() ? "_with_addend" : "");
+    }
+
+    PrimitiveType scalar_type() const { return scalar_type_; }
+    int64 m() const { return m_; }
+    int64 k() const { return k_; }
+    int64 n() const { return n_; }
+    bool lhs_transposed() const { return lhs_transposed_; }
+    bool rhs_transposed() const { return rhs_transposed_; }
+    int64 tile_size_m() const { return tile_size_m_; }
+    int64 tile_size_n() const { return tile_size_n_; }
+    int64 block_size_m() const { return block_size_m_; }
+    int64 block_size_k() const { return block_size_k_; }
+    int64 block_size_n() const { return block_size_n_; }
+    bool has_addend() const { return has_addend_; }
+
+   private:
+    PrimitiveType scalar_type_;
+    int64 m_;
+    int64 k_;
+    int64 n_;
+    bool lhs_transposed_;
+    bool rhs_transposed_;
+    int64 tile_size_m_;
+    int64 tile_size_n_;
+    int64 block_size_m_;
+    int64 block_size_k_;
+    int64 block_size_n_;
+    bool has_addend_;
+  };
+
+  // Creates an instance of PackedGemmEmitter that matrix-multiplies `lhs` with
+  // `rhs`, adds `addend` if it is not null, and stores the result in `result`.
+  explicit PackedGemmEmitter(Config config, llvm::Value* lhs, llvm::Value* rhs,
+                             llvm::Value* addend, llvm::Value* result,
+                             llvm::IRBuilder<>* b)
+      : config_(config),
+        lhs_(lhs),
+        rhs_(rhs),
+        addend_(addend),
+        result_(result),
+        b_(b),
+        ksl_(b_),
+        vsl_(config.scalar_type(), /*vector_size=*/config.tile_size_n(), b_,
+             "packed_gemm") {
+    CHECK_EQ(addend_ != nullptr, config.has_addend());
+    CHECK_GT(tile_size_m(), 0);
+    CHECK_GT(tile_size_n(), 0);
+    CHECK_GT(block_size_k(), 0);
+    CHECK(block_size_m() > 0 && block_size_m() % tile_size_m() == 0);
+    CHECK(block_size_n() > 0 && block_size_n() % tile_size_n() == 0);
+  }
+
+  void Emit();
+
+ private:
+  // Packs Rhs[k_start : k_start + k_size, n_start : n_start + n_size] into
+  // `rhs_pack_`.
+  void PackRhs(llvm::Value* k_start, llvm::Value* k_size, llvm::Value* n_start,
+               llvm::Value* n_size);
+
+  // Packs Lhs[m_start : m_start + m_size, k_start : k_start + k_size] into
+  // `lhs_pack_`.
+  void PackLhs(llvm::Value* m_start, llvm::Value* m_size, llvm::Value* k_start,
+               llvm::Value* k_size);
+
+  // Adds the product of the packed panels `lhs_panel` and `rhs_panel`, of
+  // depth `k_size`, to the result tile at {m: `m_start`, n: `n_start`}.
+  void EmitMicroKernel(llvm::Value* lhs_panel, llvm::Value* rhs_panel,
+                       llvm::Value* k_size, llvm::Value* m_start,
+                       llvm::Value* n_start);
+
+  // Adds `tile` to the result tile at {m: `m_start`, n: `n_start`}, which may
+  // stick out of the result.
+  void AccumulateTile(absl::Span<llvm::Value* const> tile,
+                      llvm::Value* m_start, llvm::Value* n_start);
+
+  // Loads Lhs[`row`, `col`] and Rhs[`row`, `col`] in the logical [m, k] and
+  // [k, n] index spaces.
+  llvm::Value* LoadLhs(llvm::Value* row, llvm::Value* col);
+  llvm::Value* LoadRhs(llvm::Value* row, llvm::Value* col);
+
+  llvm::Value* GetInt64(int64 value) { return b_->getInt64(value); }
+  llvm::Value* Min(llvm::Value* lhs, llvm::Value* rhs) {
+    return b_->CreateSelect(b_->CreateICmpSLT(lhs, rhs), lhs, rhs);
+  }
+
+  const Config& config() const { return config_; }
+  int64 m() const { return config().m(); }
+  int64 k() const { return config().k(); }
+  int64 n() const { return config().n(); }
+  int64 tile_size_m() const { return config().tile_size_m(); }
+  int64 tile_size_n() const { return config().tile_size_n(); }
+  int64 block_size_m() const { return config().block_size_m(); }
+  int64 block_size_k() const { return config().block_size_k(); }
+  int64 block_size_n() const { return config().block_size_n(); }
+
+  Config config_;
+  llvm::Value* lhs_;
+  llvm::Value* rhs_;
+  llvm::Value* addend_;
+  llvm::Value* result_;
+
+  llvm::IRBuilder<>* b_;
+  KernelSupportLibrary ksl_;
+  VectorSupportLibrary vsl_;
+
+  // Stack buffers for the packed panels and for partial result tiles.
+  llvm::Value* lhs_pack_ = nullptr;
+  llvm::Value* rhs_pack_ = nullptr;
+  llvm::Value* tile_buffer_ = nullptr;
+};
+
+void PackedGemmEmitter::Emit() {
+  const int64 size_bytes =
+      m() * n() * ShapeUtil::ByteSizeOfPrimitiveType(config().scalar_type());
+  if (addend_ != nullptr) {
+    // The addend may share its buffer with the result.
+    b_->CreateMemMove(result_, /*DstAlign=*/llvm::MaybeAlign(1), addend_,
+                      /*SrcAlign=*/llvm::MaybeAlign(1), size_bytes);
+  } else {
+    b_->CreateMemSet(result_, b_->getInt8(0), /*Size=*/size_bytes,
+                     /*Align=*/llvm::MaybeAlign(1));
+  }
+
+  // Align the buffers to cache lines.
+  const int kBufferAlignment = 64;
+  lhs_pack_ = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
+      vsl_.scalar_type(), GetInt64(block_size_m() * block_size_k()),
+      "lhs_pack", b_, kBufferAlignment);
+  rhs_pack_ = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
+      vsl_.scalar_type(), GetInt64(block_size_k() * block_size_n()),
+      "rhs_pack", b_, kBufferAlignment);
+  tile_buffer_ = llvm_ir::EmitAllocaAtFunctionEntryWithCount(
+      vsl_.scalar_type(), GetInt64(tile_size_m() * tile_size_n()),
+      "tile_buffer", b_, kBufferAlignment);
+
+  ksl_.For("n_block", 0, n(), block_size_n(), [&](llvm::Value* n_block) {
+    llvm::Value* n_size =
+        Min(b_->CreateSub(GetInt64(n()), n_block), GetInt64(block_size_n()));
+    ksl_.For("k_block", 0, k(), block_size_k(), [&](llvm::Value* k_block) {
+      llvm::Value* k_size =
+          Min(b_->CreateSub(GetInt64(k()), k_block), GetInt64(block_size_k()));
+      PackRhs(k_block, k_size, n_block, n_size);
+      ksl_.For("m_block", 0, m(), block_size_m(), [&](llvm::Value* m_block) {
+        llvm::Value* m_size = Min(b_->CreateSub(GetInt64(m()), m_block),
+                                  GetInt64(block_size_m()));
+        PackLhs(m_block, m_size, k_block, k_size);
+        ksl_.For(
+            "n_tile", GetInt64(0), n_size, tile_size_n(),
+            [&](llvm::Value* n_tile) {
+              llvm::Value* rhs_panel = vsl_.ComputeOffsetPointer(
+                  rhs_pack_, b_->CreateMul(n_tile, k_size));
+              ksl_.For(
+                  "m_tile", GetInt64(0), m_size, tile_size_m(),
+                  [&](llvm::Value* m_tile) {
+                    llvm::Value* lhs_panel = vsl_.ComputeOffsetPointer(
+                        lhs_pack_, b_->CreateMul(m_tile, k_size));
+                    EmitMicroKernel(lhs_panel, rhs_panel, k_size,
+                                    b_->CreateAdd(m_block, m_tile),
+                                    b_->CreateAdd(n_block, n_tile));
+                  });
+            });
+      });
+    });
+  });
+}
+
+llvm::Value* PackedGemmEmitter::LoadLhs(llvm::Value* row, llvm::Value* col) {
+  llvm::Value* offset =
+      config().lhs_transposed()
+          ? b_->CreateAdd(b_->CreateMul(col, GetInt64(m())), row)
+          : b_->CreateAdd(b_->CreateMul(row, GetInt64(k())), col);
+  return vsl_.LoadScalar(lhs_, offset);
+}
+
+llvm::Value* PackedGemmEmitter::LoadRhs(llvm::Value* row, llvm::Value* col) {
+  llvm::Value* offset =
+      config().rhs_transposed()
+          ? b_->CreateAdd(b_->CreateMul(col, GetInt64(k())), row)
+          : b_->CreateAdd(b_->CreateMul(row, GetInt64(n())), col);
+  return vsl_.LoadScalar(rhs_, offset);
+}
+
+void PackedGemmEmitter::PackRhs(llvm::Value* k_start, llvm::Value* k_size,
+                                llvm::Value* n_start, llvm::Value* n_size) {
+  ksl_.For("pack_rhs.n", GetInt64(0), n_size, tile_size_n(),
+           [&](llvm::Value* n_tile) {
+             llvm::Value* panel = vsl_.ComputeOffsetPointer(
+                 rhs_pack_, b_->CreateMul(n_tile, k_size));
+             ksl_.For("pack_rhs.k", GetInt64(0), k_size, 1,
+                      [&](llvm::Value* k_i) {
+                        llvm::Value* row = b_->CreateAdd(k_start, k_i);
+                        for (int64 j = 0; j < tile_size_n(); j++) {
+                          // Columns past the block are padded with zeros.
+                          llvm::Value* col = b_->CreateAdd(n_tile, GetInt64(j));
+                          llvm::Value* in_bounds =
+                              b_->CreateICmpSLT(col, n_size);
+                          llvm::Value* value = LoadRhs(
+                              row, b_->CreateAdd(
+                                       n_start, b_->CreateSelect(
+                                                    in_bounds, col,
+                                                    GetInt64(0))));
+                          vsl_.StoreScalar(
+                              b_->CreateSelect(in_bounds, value,
+                                               vsl_.GetZeroScalar()),
+                              panel,
+                              b_->CreateAdd(
+                                  b_->CreateMul(k_i, GetInt64(tile_size_n())),
+                                  GetInt64(j)));
+                        }
+                      });
+           });
+}
+
+void PackedGemmEmitter::PackLhs(llvm::Value* m_start, llvm::Value* m_size,
+                                llvm::Value* k_start, llvm::Value* k_size) {
+  ksl_.For("pack_lhs.m", GetInt64(0), m_size, tile_size_m(),
+           [&](llvm::Value* m_tile) {
+             llvm::Value* panel = vsl_.ComputeOffsetPointer(
+                 lhs_pack_, b_->CreateMul(m_tile, k_size));
+             ksl_.For("pack_lhs.k", GetInt64(0), k_size, 1,
+                      [&](llvm::Value* k_i) {
+                        llvm::Value* col = b_->CreateAdd(k_start, k_i);
+                        for (int64 i = 0; i < tile_size_m(); i++) {
+                          // Rows past the block are padded with zeros.
+                          llvm::Value* row = b_->CreateAdd(m_tile, GetInt64(i));
+                          llvm::Value* in_bounds =
+                              b_->CreateICmpSLT(row, m_size);
+                          llvm::Value* value = LoadLhs(
+                              b_->CreateAdd(
+                                  m_start, b_->CreateSelect(in_bounds, row,
+                                                            GetInt64(0))),
+                              col);
+                          vsl_.StoreScalar(
+                              b_->CreateSelect(in_bounds, value,
+                                               vsl_.GetZeroScalar()),
+                              panel,
+                              b_->CreateAdd(
+                                  b_->CreateMul(k_i, GetInt64(tile_size_m())),
+                                  GetInt64(i)));
+                        }
+                      });
+           });
+}
+
+void PackedGemmEmitter::EmitMicroKernel(llvm::Value* lhs_panel,
+                                        llvm::Value* rhs_panel,
+                                        llvm::Value* k_size,
+                                        llvm::Value* m_start,
+                                        llvm::Value* n_start) {
+  TileVariable result_tile_var(
+      &vsl_, std::vector<llvm::Value*>(tile_size_m(), vsl_.GetZeroVector()));
+  ksl_.For("kernel.k", GetInt64(0), k_size, 1, [&](llvm::Value* k_i) {
+    llvm::Value* rhs_vector = vsl_.LoadVector(
+        rhs_panel, b_->CreateMul(k_i, GetInt64(tile_size_n())));
+    llvm::Value* lhs_offset = b_->CreateMul(k_i, GetInt64(tile_size_m()));
+    std::vector<llvm::Value*> result_tile = result_tile_var.Get();
+    for (int64 i = 0; i < tile_size_m(); i++) {
+      llvm::Value* lhs_broadcast = vsl_.LoadBroadcast(
+          lhs_panel, b_->CreateAdd(lhs_offset, GetInt64(i)));
+      result_tile[i] = vsl_.MulAdd(lhs_broadcast, rhs_vector, result_tile[i]);
+    }
+    result_tile_var.Set(result_tile);
+  });
+  AccumulateTile(result_tile_var.Get(), m_start, n_start);
+}
+
+void PackedGemmEmitter::AccumulateTile(absl::Span<llvm::Value* const> tile,
+                                       llvm::Value* m_start,
+                                       llvm::Value* n_start) {
+  llvm::Value* rows_left = b_->CreateSub(GetInt64(m()), m_start);
+  llvm::Value* cols_left = b_->CreateSub(GetInt64(n()), n_start);
+  llvm::Value* is_full_tile =
+      b_->CreateAnd(b_->CreateICmpSGE(rows_left, GetInt64(tile_size_m())),
+                    b_->CreateICmpSGE(cols_left, GetInt64(tile_size_n())));
+  auto result_offset = [&](llvm::Value* row, llvm::Value* col) {
+    return b_->CreateAdd(
+        b_->CreateMul(b_->CreateAdd(m_start, row), GetInt64(n())),
+        b_->CreateAdd(n_start, col));
+  };
+  ksl_.If(
+      "full_tile", is_full_tile,
+      /*true_block_generator=*/
+      [&]() {
+        for (int64 i = 0; i < tile_size_m(); i++) {
+          llvm::Value* pointer = vsl_.ComputeOffsetPointer(
+              result_, result_offset(GetInt64(i), GetInt64(0)));
+          vsl_.StoreVector(vsl_.Add(vsl_.LoadVector(pointer), tile[i]),
+                           pointer);
+        }
+      },
+      /*false_block_generator=*/
+      [&]() {
+        for (int64 i = 0; i < tile_size_m(); i++) {
+          vsl_.StoreVector(tile[i], tile_buffer_, i * tile_size_n());
+        }
+        ksl_.For(
+            "partial_tile.m", GetInt64(0),
+            Min(rows_left, GetInt64(tile_size_m())), 1,
+            [&](llvm::Value* row) {
+              ksl_.For("partial_tile.n", GetInt64(0),
+                       Min(cols_left, GetInt64(tile_size_n())), 1,
+                       [&](llvm::Value* col) {
+                         llvm::Value* pointer = vsl_.ComputeOffsetPointer(
+                             result_, result_offset(row, col));
+                         llvm::Value* tile_value = vsl_.LoadScalar(
+                             tile_buffer_,
+                             b_->CreateAdd(
+                                 b_->CreateMul(row, GetInt64(tile_size_n())),
+                                 col));
+                         vsl_.StoreScalar(
+                             vsl_.Add(vsl_.LoadScalar(pointer), tile_value),
+                             pointer);
+                       });
+            });
+      });
+}
+
 llvm::Type* GetPointerToElementType(llvm::Type* pointer_type) {
   llvm::Type* type =
       llvm::cast<llvm::PointerType>(pointer_type)->getElementType();
@@ -1065,5 +1448,41 @@ void EmitSmallGemm(PrimitiveType scalar_type, int64 m, int64 k, int64 n,
       });
 }
 
+void EmitPackedGemm(PrimitiveType scalar_type, int64 m, int64 k, int64 n,
+                    bool lhs_transposed, bool rhs_transposed,
+                    int64 tile_size_m, int64 tile_size_n, int64 block_size_m,
+                    int64 block_size_k, int64 block_size_n, llvm::Value* lhs,
+                    llvm::Value* rhs, llvm::Value* addend, llvm::Value* result,
+                    llvm::IRBuilder<>* b,
+                    const HloModuleConfig& module_config) {
+  // Blocks larger than the zero padded matrices would only waste stack space.
+  block_size_m = std::min(RoundUpToNearest(block_size_m, tile_size_m),
+                          RoundUpToNearest(m, tile_size_m));
+  block_size_k = std::min(block_size_k, k);
+  block_size_n = std::min(RoundUpToNearest(block_size_n, tile_size_n),
+                          RoundUpToNearest(n, tile_size_n));
+
+  PackedGemmEmitter::Config config(
+      /*scalar_type=*/scalar_type, /*m=*/m, /*k=*/k, /*n=*/n,
+      /*lhs_transposed=*/lhs_transposed, /*rhs_transposed=*/rhs_transposed,
+      /*tile_size_m=*/tile_size_m, /*tile_size_n=*/tile_size_n,
+      /*block_size_m=*/block_size_m, /*block_size_k=*/block_size_k,
+      /*block_size_n=*/block_size_n, /*has_addend=*/addend != nullptr);
+
+  GemvBuffersWithCanonicalType canonical_inputs =
+      GetGemvBuffersWithCanonicalType(lhs, rhs, addend, result, b);
+
+  KernelSupportLibrary::EmitAndCallOutlinedKernel(
+      module_config, b, config.GetCacheKey(),
+      canonical_inputs.lhs_canonicalized, canonical_inputs.rhs_canonicalized,
+      canonical_inputs.addend_canonicalized,
+      canonical_inputs.result_canonicalized,
+      [&config, b](llvm::Value* lhs, llvm::Value* rhs, llvm::Value* addend,
+                   llvm::Value* result) {
+        PackedGemmEmitter emitter(config, lhs, rhs, addend, result, b);
+        emitter.Emit();
+      });
+}
+
 }  // namespace cpu
 }  // namespace xla
@@ -49,6 +49,23 @@ void EmitSmallGemm(PrimitiveType scalar_type, tensorflow::int64 m,
                    llvm::Value* lhs, llvm::Value* rhs, llvm::Value* result,
                    llvm::IRBuilder<>* b, const HloModuleConfig& module_config);
 
+// Emits a cache-blocked GEMM that packs panels of `lhs` and `rhs` into stack
+// buffers, and computes [`tile_size_m`, `tile_size_n`] tiles of the result in
+// vector registers.  `lhs` is [m, k] in memory, or [k, m] if `lhs_transposed`,
+// and `rhs` is [k, n] in memory, or [n, k] if `rhs_transposed`.  `result` is
+// row major, and if `addend` is not null then it is a row major array that is
+// added to the product.
+void EmitPackedGemm(PrimitiveType scalar_type, tensorflow::int64 m,
+                    tensorflow::int64 k, tensorflow::int64 n,
+                    bool lhs_transposed, bool rhs_transposed,
+                    tensorflow::int64 tile_size_m,
+                    tensorflow::int64 tile_size_n,
+                    tensorflow::int64 block_size_m,
+                    tensorflow::int64 block_size_k,
+                    tensorflow::int64 block_size_n, llvm::Value* lhs,
+                    llvm::Value* rhs, llvm::Value* addend, llvm::Value* result,
+                    llvm::IRBuilder<>* b, const HloModuleConfig& module_config);
+
 }  // namespace cpu
 }  // namespace xla
 
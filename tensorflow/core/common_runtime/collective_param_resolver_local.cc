@@ -57,14 +57,42 @@ void CollectiveParamResolverLocal::CompleteGroupAsync(
                        "intended only for non-distributed deployment."));
 }
 
+constexpr int CollectiveParamResolverLocal::kMinLatencyBoundReductionGroupSize;
+constexpr int64 CollectiveParamResolverLocal::kMaxLatencyBoundReductionBytes;
+constexpr int64 CollectiveParamResolverLocal::kMaxTreeReductionBytes;
+
 namespace {
+// Picks the non-NCCL reduction for `cp`.  Every member of the group sees the
+// same shape, type and group, so they all pick the same one.
+const char* GetReductionName(const CollectiveParams* cp) {
+  // The latency-optimized algorithms are only picked for CPU devices, and not
+  // when the ring is explicitly requested.
+  if (cp->group.device_type != DEVICE_CPU ||
+      cp->instance.impl_details.communication_hint == "ring" ||
+      cp->group.group_size <
+          CollectiveParamResolverLocal::kMinLatencyBoundReductionGroupSize) {
+    return "RingReduce";
+  }
+  const int64 bytes =
+      cp->instance.shape.num_elements() * DataTypeSize(cp->instance.data_type);
+  if (bytes > CollectiveParamResolverLocal::kMaxLatencyBoundReductionBytes) {
+    return "RingReduce";
+  }
+  if (bytes <= CollectiveParamResolverLocal::kMaxTreeReductionBytes &&
+      cp->group.num_tasks > 1 &&
+      cp->group.group_size > cp->group.num_tasks) {
+    return "HierarchicalTreeReduce";
+  }
+  return "RecursiveHalvingDoublingReduce";
+}
+
 const char* GetCollectiveName(const CollectiveParams* cp, bool nccl) {
   switch (cp->instance.type) {
     case BROADCAST_COLLECTIVE:
       return "HierarchicalTreeBroadcast";
 
     case REDUCTION_COLLECTIVE:
-      return nccl ? "NcclReduce" : "RingReduce";
+      return nccl ? "NcclReduce" : GetReductionName(cp);
 
     case GATHER_COLLECTIVE:
       return "RingGather";
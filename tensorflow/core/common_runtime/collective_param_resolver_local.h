@@ -37,6 +37,22 @@ class DeviceMgr;
 // group leader for param resolution in a multi-task context.
 class CollectiveParamResolverLocal : public ParamResolverInterface {
  public:
+  // Thresholds for picking the reduction of CPU devices when NCCL is not
+  // used.  RingReduce takes 2*(n-1) sequential steps for a group of n
+  // devices, while RecursiveHalvingDoublingReduce takes 2*log2(n) steps and
+  // sends as many bytes.  From 8 devices on, that saves at least 8 of 14
+  // steps, which dominates for values of up to 256 KiB, whose per-step
+  // transfers are short next to the latency of a step.  Larger values keep
+  // the ring, which pipelines its chunks across subdivisions.
+  static constexpr int kMinLatencyBoundReductionGroupSize = 8;
+  static constexpr int64 kMaxLatencyBoundReductionBytes = 256 << 10;
+  // Among those reductions, HierarchicalTreeReduce is picked for values of
+  // up to 16 KiB over several tasks with several devices each.  It sends the
+  // whole value at each level of its trees, which costs about as much as an
+  // empty message for such values, but crosses task boundaries only once per
+  // task in each direction.
+  static constexpr int64 kMaxTreeReductionBytes = 16 << 10;
+
   CollectiveParamResolverLocal(const ConfigProto& config,
                                const DeviceMgr* dev_mgr,
                                DeviceResolverInterface* dev_resolver,
@@ -74,11 +74,70 @@ class CollectiveParamResolverLocalTest : public ::testing::Test {
     }
   }
 
+  // Returns the reduction picked for a value of `num_bytes` bytes.
+  string ReductionName(const DeviceType& device_type, int group_size,
+                       int num_tasks, int64 num_bytes,
+                       const string& communication_hint = "") {
+    CollectiveParams cp;
+    cp.group.device_type = device_type;
+    cp.group.group_size = group_size;
+    cp.group.num_tasks = num_tasks;
+    cp.instance.type = REDUCTION_COLLECTIVE;
+    cp.instance.data_type = DT_INT8;
+    cp.instance.shape = TensorShape({num_bytes});
+    cp.instance.impl_details.communication_hint = communication_hint;
+    prl_->AssignCollectiveType(&cp);
+    return cp.instance.impl_details.collective_name;
+  }
+
   std::unique_ptr<DeviceMgr> device_mgr_;
   std::unique_ptr<DeviceResolverLocal> drl_;
   std::unique_ptr<CollectiveParamResolverLocal> prl_;
 };
 
+TEST_F(CollectiveParamResolverLocalTest, ReductionForGroupSize) {
+  const DeviceType cpu("CPU");
+  const int min_group_size =
+      CollectiveParamResolverLocal::kMinLatencyBoundReductionGroupSize;
+  EXPECT_EQ("RingReduce", ReductionName(cpu, min_group_size - 1, 1, 1024));
+  EXPECT_EQ("RecursiveHalvingDoublingReduce",
+            ReductionName(cpu, min_group_size, 1, 1024));
+}
+
+TEST_F(CollectiveParamResolverLocalTest, ReductionForValueSize) {
+  const DeviceType cpu("CPU");
+  const int64 max_bytes =
+      CollectiveParamResolverLocal::kMaxLatencyBoundReductionBytes;
+  EXPECT_EQ("RecursiveHalvingDoublingReduce",
+            ReductionName(cpu, 16, 1, max_bytes));
+  EXPECT_EQ("RingReduce", ReductionName(cpu, 16, 1, max_bytes + 1));
+  // Several tasks with several devices each.
+  EXPECT_EQ("RecursiveHalvingDoublingReduce",
+            ReductionName(cpu, 16, 4, max_bytes));
+  EXPECT_EQ("RingReduce", ReductionName(cpu, 16, 4, max_bytes + 1));
+}
+
+TEST_F(CollectiveParamResolverLocalTest, TreeReductionForSmallValues) {
+  const DeviceType cpu("CPU");
+  const int64 max_bytes = CollectiveParamResolverLocal::kMaxTreeReductionBytes;
+  EXPECT_EQ("HierarchicalTreeReduce", ReductionName(cpu, 16, 4, max_bytes));
+  EXPECT_EQ("RecursiveHalvingDoublingReduce",
+            ReductionName(cpu, 16, 4, max_bytes + 1));
+  // A single task, or a single device per task.
+  EXPECT_EQ("RecursiveHalvingDoublingReduce",
+            ReductionName(cpu, 16, 1, max_bytes));
+  EXPECT_EQ("RecursiveHalvingDoublingReduce",
+            ReductionName(cpu, 16, 16, max_bytes));
+  // Below the group size for the latency-bound reductions.
+  EXPECT_EQ("RingReduce", ReductionName(cpu, 6, 2, max_bytes));
+}
+
+TEST_F(CollectiveParamResolverLocalTest, RingReductionWhenRequested) {
+  EXPECT_EQ("RingReduce", ReductionName(DeviceType("CPU"), 16, 4, 1024,
+                                        /*communication_hint=*/"ring"));
+  EXPECT_EQ("RingReduce", ReductionName(DeviceType("GPU"), 16, 4, 1024));
+}
+
 TEST_F(CollectiveParamResolverLocalTest, CompleteDefaultRanking) {
   constexpr int kNumGpus = 8;
   CollectiveParams cp;
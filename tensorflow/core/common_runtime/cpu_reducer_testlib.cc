@@ -0,0 +1,342 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/cpu_reducer_testlib.h"
+
+#include "absl/memory/memory.h"
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+static int64 kStepId = 123;
+
+// Wraps CollectiveRemoteAccessLocal with the ability to return an
+// error status to the N'th action.
+class FailTestRMA : public CollectiveRemoteAccessLocal {
+ public:
+  FailTestRMA(const DeviceMgr* dev_mgr, DeviceResolverInterface* dev_resolver,
+              std::shared_ptr<UnboundedWorkQueue> work_queue, int64 step_id,
+              int fail_after)
+      : CollectiveRemoteAccessLocal(dev_mgr, dev_resolver, work_queue, step_id),
+        fail_after_(fail_after) {}
+
+  bool MaybeFail(const StatusCallback& done) {
+    bool fail_now = false;
+    {
+      mutex_lock l(mu_);
+      if (fail_after_ > 0) {
+        fail_now = (--fail_after_ == 0);
+      }
+    }
+    if (fail_now) {
+      done(errors::Internal("Deliberate failure"));
+      return true;
+    }
+    return false;
+  }
+
+  void RecvFromPeer(const string& peer_device, const string& peer_task,
+                    bool peer_is_local, const string& key, Device* to_device,
+                    DeviceContext* to_device_ctx,
+                    const AllocatorAttributes& to_alloc_attr, Tensor* to_tensor,
+                    const DeviceLocality& client_locality,
+                    int dev_to_dev_stream_index,
+                    const StatusCallback& done) override {
+    if (MaybeFail(done)) return;
+    CollectiveRemoteAccessLocal::RecvFromPeer(
+        peer_device, peer_task, peer_is_local, key, to_device, to_device_ctx,
+        to_alloc_attr, to_tensor, client_locality, dev_to_dev_stream_index,
+        done);
+  }
+
+  void PostToPeer(const string& peer_device, const string& peer_task,
+                  const string& key, Device* from_device,
+                  DeviceContext* from_device_ctx,
+                  const AllocatorAttributes& from_alloc_attr,
+                  const Tensor* from_tensor,
+                  const DeviceLocality& client_locality,
+                  const StatusCallback& done) override {
+    if (MaybeFail(done)) return;
+    CollectiveRemoteAccessLocal::PostToPeer(
+        peer_device, peer_task, key, from_device, from_device_ctx,
+        from_alloc_attr, from_tensor, client_locality, done);
+  }
+
+  mutex mu_;
+  int fail_after_ TF_GUARDED_BY(mu_);
+};
+
+std::unique_ptr<OpKernel> GetKernel(const NodeDef& node, DeviceBase* device) {
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()), node,
+      TF_GRAPH_DEF_VERSION, &status);
+  if (!status.ok()) {
+    LOG(FATAL) << status;
+  }
+  return k;
+}
+
+std::unique_ptr<OpKernel> GetBinOp(const string& op, DataType dtype,
+                                   DeviceBase* device) {
+  NodeDef node_def;
+  NodeDefBuilder builder(strings::StrCat(op, "_node"), op);
+  TF_CHECK_OK(builder.Attr("T", dtype)
+                  .Input(FakeInput(dtype))
+                  .Input(FakeInput(dtype))
+                  .Finalize(&node_def));
+  return GetKernel(node_def, device);
+}
+
+}  // namespace
+
+CpuReducerTest::CpuReducerTest(const string& collective_name)
+    : collective_name_(collective_name) {}
+
+CpuReducerTest::~CpuReducerTest() {
+  for (auto i : instances_) delete i;
+  if (col_exec_) col_exec_->Unref();
+}
+
+void CpuReducerTest::Init(int num_workers, int num_devices, DataType dtype,
+                          int fail_after) {
+  std::vector<std::unique_ptr<Device>> local_devices;
+  SessionOptions sess_opts;
+  sess_opts.env = Env::Default();
+  Bytes mem_limit(4 << 20);
+  DeviceLocality dev_locality;
+  for (int wi = 0; wi < num_workers; ++wi) {
+    for (int di = 0; di < num_devices; ++di) {
+      string dev_name =
+          strings::StrCat("/job:worker/replica:0/task:", wi, "/cpu:", di);
+      local_devices.push_back(absl::make_unique<ThreadPoolDevice>(
+          sess_opts, dev_name, mem_limit, dev_locality, cpu_allocator()));
+    }
+  }
+  dev_mgr_ = absl::make_unique<StaticDeviceMgr>(std::move(local_devices));
+  dev_resolver_ = absl::make_unique<DeviceResolverLocal>(dev_mgr_.get());
+  work_queue_ = std::make_shared<UnboundedWorkQueue>(Env::Default(), "test");
+  rma_ = new FailTestRMA(dev_mgr_.get(), dev_resolver_.get(), work_queue_,
+                         kStepId, fail_after);
+  col_exec_ = new BaseCollectiveExecutor(&col_exec_mgr_, rma_, kStepId,
+                                         dev_mgr_.get(), &gpu_ring_order_);
+  col_params_.name = "test_collective";
+  col_params_.group.group_key = 5;
+  col_params_.group.device_type = DEVICE_CPU;
+  col_params_.group.group_size = num_workers * num_devices;
+  col_params_.group.num_tasks = num_workers;
+  col_params_.instance.instance_key = 17;
+  col_params_.instance.type = REDUCTION_COLLECTIVE;
+  col_params_.instance.impl_details.collective_name = collective_name_;
+  col_params_.instance.data_type = dtype;
+  for (int wi = 0; wi < num_workers; ++wi) {
+    string task_name = strings::StrCat("/job:worker/replica:0/task:", wi);
+    col_params_.instance.num_devices_per_task[task_name] = num_devices;
+    for (int di = 0; di < num_devices; ++di) {
+      col_params_.instance.device_names.push_back(
+          strings::StrCat(task_name, "/cpu:", di));
+      col_params_.instance.task_names.push_back(task_name);
+      // Normally each device would set is_local to its own perspective but
+      // this test runs in a single process so is_local is always true.
+      col_params_.task.is_local.push_back(true);
+    }
+  }
+  for (int rank = 0; rank < col_params_.group.group_size; ++rank) {
+    instances_.push_back(new DeviceInstance(rank, this));
+  }
+}
+
+void CpuReducerTest::Reduce() {
+  BlockingCounter counter(instances_.size());
+  for (DeviceInstance* di : instances_) {
+    SchedClosure([di, &counter] {
+      di->DoReduce();
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+}
+
+template <typename T>
+void CpuReducerTest::RunTypedTest(DataType dtype, int num_workers,
+                                  int num_devices, int tensor_len,
+                                  int fail_after) {
+  Init(num_workers, num_devices, dtype, fail_after);
+  std::vector<double> expected(tensor_len, 0.0);
+  for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+    instances_[di]->InitTensor(
+        dtype, TensorShape({tensor_len}), [&expected, di](Tensor* t) {
+          for (int i = 0; i < t->NumElements(); ++i) {
+            double value = di * 10 + i;
+            t->flat<T>()(i) = static_cast<T>(value);
+            expected[i] += value;
+          }
+        });
+  }
+  Reduce();
+  const int group_size = num_workers * num_devices;
+  for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+    if (fail_after > 0) {
+      // Confirm that every device terminated with the expected error.
+      EXPECT_NE(
+          instances_[di]->status_.error_message().find("Deliberate failure"),
+          string::npos)
+          << instances_[di]->status_;
+      continue;
+    }
+    // Confirm that every device computed the same correct reduction value.
+    TF_EXPECT_OK(instances_[di]->status_);
+    const Tensor& actual = instances_[di]->tensor_;
+    ASSERT_EQ(tensor_len, actual.NumElements());
+    for (int i = 0; i < tensor_len; ++i) {
+      EXPECT_EQ(static_cast<T>(static_cast<T>(expected[i]) / group_size),
+                actual.flat<T>()(i))
+          << "Mismatch at device " << di << " index " << i;
+    }
+  }
+}
+
+void CpuReducerTest::RunTest(DataType dtype, int num_workers, int num_devices,
+                             int tensor_len, int fail_after) {
+  switch (dtype) {
+    case DT_FLOAT:
+      RunTypedTest<float>(dtype, num_workers, num_devices, tensor_len,
+                          fail_after);
+      break;
+    case DT_DOUBLE:
+      RunTypedTest<double>(dtype, num_workers, num_devices, tensor_len,
+                           fail_after);
+      break;
+    case DT_INT32:
+      RunTypedTest<int32>(dtype, num_workers, num_devices, tensor_len,
+                          fail_after);
+      break;
+    case DT_INT64:
+      RunTypedTest<int64>(dtype, num_workers, num_devices, tensor_len,
+                          fail_after);
+      break;
+    default:
+      LOG(FATAL) << "Unimplemented";
+  }
+}
+
+std::unique_ptr<OpKernel> CpuReducerTest::GetCollectiveReduce(
+    const CollectiveParams& params, DeviceBase* device) {
+  mutex_lock l(mu_);
+  NodeDef node_def;
+  NodeDefBuilder builder(
+      strings::StrCat("collective_reduce_", reduce_counter_++),
+      "CollectiveReduce");
+  TF_CHECK_OK(builder.Attr("T", params.instance.data_type)
+                  .Attr("merge_op", "Add")
+                  .Attr("final_op", "Div")
+                  .Attr("group_size", params.group.group_size)
+                  .Attr("group_key", params.group.group_key)
+                  .Attr("instance_key", params.instance.instance_key)
+                  .Attr("subdiv_offsets", std::vector<int>{0})
+                  .Input(FakeInput(params.instance.data_type))
+                  .Finalize(&node_def));
+  return GetKernel(node_def, device);
+}
+
+CpuReducerTest::DeviceInstance::DeviceInstance(int rank,
+                                               CpuReducerTest* parent)
+    : parent_(parent) {
+  const string& dev_name = parent_->col_params_.instance.device_names[rank];
+  TF_CHECK_OK(parent_->dev_mgr_->LookupDevice(dev_name, &device_))
+      << "Couldn't find device " << dev_name
+      << " existing devices: " << parent_->dev_mgr_->DebugString();
+  col_params_.name = parent_->col_params_.name;
+  col_params_.group = parent_->col_params_.group;
+  col_params_.instance = parent_->col_params_.instance;
+  col_params_.task.is_local = parent_->col_params_.task.is_local;
+  col_params_.default_rank = rank;
+}
+
+void CpuReducerTest::DeviceInstance::InitTensor(
+    DataType dtype, const TensorShape& shape,
+    const std::function<void(Tensor*)>& init_f) {
+  tensor_ = Tensor(device_->GetAllocator(AllocatorAttributes()), dtype, shape);
+  init_f(&tensor_);
+}
+
+void CpuReducerTest::DeviceInstance::DoReduce() {
+  col_params_.merge_op =
+      GetBinOp("Add", col_params_.instance.data_type, device_);
+  col_params_.final_op =
+      GetBinOp("Div", col_params_.instance.data_type, device_);
+
+  // Prepare an OpKernelContext.
+  OpKernelContext::Params op_params;
+  op_params.step_id = kStepId;
+  op_params.device = device_;
+  gtl::InlinedVector<TensorValue, 4> inputs;
+  inputs.push_back(TensorValue(&tensor_));
+  op_params.inputs = &inputs;
+  gtl::InlinedVector<AllocatorAttributes, 4> input_aa({AllocatorAttributes()});
+  op_params.input_alloc_attrs = &input_aa;
+  DeviceContext* dev_ctx = new DeviceContext;
+  op_params.op_device_context = dev_ctx;
+  int forward_from = 0;
+  op_params.forward_from_array = &forward_from;
+  AllocatorAttributes generic_alloc_attr;
+  op_params.output_attr_array = &generic_alloc_attr;
+  std::unique_ptr<OpKernel> op =
+      parent_->GetCollectiveReduce(col_params_, device_);
+  op_params.op_kernel = op.get();
+  OpKernelContext ctx(&op_params, 1);
+
+  // We never actually execute the kernel, so we need to do the output
+  // allocation it would do, ourselves.
+  Tensor* output_tensor_ptr = nullptr;
+  TF_CHECK_OK(ctx.forward_input_or_allocate_output({0}, 0, tensor_.shape(),
+                                                   &output_tensor_ptr));
+  CHECK_EQ(output_tensor_ptr, ctx.mutable_output(0));
+
+  string exec_key = strings::StrCat(col_params_.instance.instance_key, ":0:0");
+  CollectiveImplementationInterface* reducer_ptr;
+  TF_CHECK_OK(CollectiveRegistry::Lookup(parent_->collective_name_,
+                                         &reducer_ptr));
+  std::unique_ptr<CollectiveImplementationInterface> reducer(reducer_ptr);
+  TF_CHECK_OK(reducer->InitializeCollectiveParams(&col_params_));
+  CollectiveContext col_ctx(parent_->col_exec_, parent_->dev_mgr_.get(), &ctx,
+                            &op_params, col_params_, exec_key, kStepId,
+                            &tensor_, &tensor_);
+  TF_CHECK_OK(reducer->InitializeCollectiveContext(&col_ctx));
+
+  // Run the all-reduce.
+  Notification note;
+  reducer->Run([this, &note](Status s) {
+    status_ = s;
+    note.Notify();
+  });
+  note.WaitForNotification();
+  if (status_.ok()) {
+    CHECK(tensor_.CopyFrom(*ctx.mutable_output(0), tensor_.shape()));
+  }
+  dev_ctx->Unref();
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,99 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_CPU_REDUCER_TESTLIB_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_CPU_REDUCER_TESTLIB_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/unbounded_work_queue.h"
+
+namespace tensorflow {
+
+// Fixture for the tests of a reduction CollectiveImplementationInterface on
+// CPU devices.  The devices of all tasks of the group live in this process
+// and exchange values through CollectiveRemoteAccessLocal.
+class CpuReducerTest : public ::testing::Test {
+ protected:
+  // `collective_name` is the name under which the reducer is registered.
+  explicit CpuReducerTest(const string& collective_name);
+  ~CpuReducerTest() override;
+
+  // Creates `num_workers` tasks with `num_devices` devices each, and fails
+  // the `fail_after`-th transfer between devices if it is positive.
+  void Init(int num_workers, int num_devices, DataType dtype, int fail_after);
+
+  // Runs the reduction on all devices concurrently and waits for all of them.
+  void Reduce();
+
+  // Checks that averaging a value of `tensor_len` elements over the group
+  // gives the same result on every device, or with a positive `fail_after`
+  // that every device fails.
+  void RunTest(DataType dtype, int num_workers, int num_devices,
+               int tensor_len, int fail_after);
+
+  class DeviceInstance {
+   public:
+    DeviceInstance(int rank, CpuReducerTest* parent);
+
+    void InitTensor(DataType dtype, const TensorShape& shape,
+                    const std::function<void(Tensor*)>& init_f);
+
+    void DoReduce();
+
+    CpuReducerTest* parent_;
+    Device* device_;
+    CollectiveParams col_params_;
+    Tensor tensor_;
+    Status status_;
+  };
+
+  const string collective_name_;
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  CollectiveExecutor* col_exec_ = nullptr;
+  CollectiveRemoteAccessLocal* rma_;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::shared_ptr<UnboundedWorkQueue> work_queue_;
+  std::vector<DeviceInstance*> instances_;
+  CollectiveParams col_params_;
+  std::unique_ptr<tensorflow::DeviceMgr> dev_mgr_;
+  string gpu_ring_order_;
+  mutex mu_;
+  int32 reduce_counter_ TF_GUARDED_BY(mu_) = 0;
+
+ private:
+  template <typename T>
+  void RunTypedTest(DataType dtype, int num_workers, int num_devices,
+                    int tensor_len, int fail_after);
+
+  std::unique_ptr<OpKernel> GetCollectiveReduce(const CollectiveParams& params,
+                                                DeviceBase* device);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_CPU_REDUCER_TESTLIB_H_
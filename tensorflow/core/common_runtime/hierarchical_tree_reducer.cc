@@ -0,0 +1,317 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_tree_reducer.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+namespace tensorflow {
+
+namespace {
+// Key to be used for BufRendezvous by HierarchicalTreeReducer.
+string TreeReduceBufKey(const string& exec_key, const string& phase,
+                        int src_rank, int dst_rank) {
+  return strings::StrCat(exec_key, ":", phase, ":", src_rank, ":", dst_rank);
+}
+
+// Returns the rank of the first device of each task, followed by the group
+// size.
+std::vector<int> TaskStarts(const CollectiveParams& cp) {
+  const std::vector<string>& task_names = cp.instance.task_names;
+  std::vector<int> starts;
+  for (int r = 0; r < cp.group.group_size; ++r) {
+    if (r == 0 || task_names[r] != task_names[r - 1]) starts.push_back(r);
+  }
+  starts.push_back(cp.group.group_size);
+  return starts;
+}
+
+// Returns the index of the task of the device at `rank`.
+int TaskIndex(const std::vector<int>& task_starts, int rank) {
+  return std::upper_bound(task_starts.begin(), task_starts.end(), rank) -
+         task_starts.begin() - 1;
+}
+}  // namespace
+
+HierarchicalTreeReducer::HierarchicalTreeReducer()
+    : col_ctx_(nullptr), col_params_(nullptr), rank_(-1) {}
+
+Status HierarchicalTreeReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  if (col_params->instance.type != REDUCTION_COLLECTIVE) {
+    return errors::Internal(
+        "HierarchicalTreeReduce expects a reduction collective, got "
+        "collective type ",
+        col_params->instance.type);
+  }
+  // The trees require all devices in the same task to be adjacent.
+  absl::flat_hash_set<string> seen_tasks;
+  const std::vector<string>& task_names = col_params->instance.task_names;
+  for (int r = 0; r < col_params->group.group_size; ++r) {
+    if ((r == 0 || task_names[r] != task_names[r - 1]) &&
+        !seen_tasks.insert(task_names[r]).second) {
+      return errors::Internal("HierarchicalTreeReduce expects the devices of ",
+                              task_names[r], " to be adjacent");
+    }
+  }
+  return Status::OK();
+}
+
+Status HierarchicalTreeReducer::InitializeCollectiveContext(
+    CollectiveContext* col_ctx) {
+  CHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = &col_ctx->col_params;
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+/* static */
+int HierarchicalTreeReducer::TreeParent(const CollectiveParams& cp, int rank) {
+  const std::vector<int> task_starts = TaskStarts(cp);
+  const int task = TaskIndex(task_starts, rank);
+  const int local_rank = rank - task_starts[task];
+  if (local_rank > 0) return task_starts[task] + (local_rank - 1) / 2;
+  if (task > 0) return task_starts[(task - 1) / 2];
+  return -1;
+}
+
+/* static */
+void HierarchicalTreeReducer::TreeChildren(const CollectiveParams& cp,
+                                           int rank,
+                                           std::vector<int>* children) {
+  children->clear();
+  const std::vector<int> task_starts = TaskStarts(cp);
+  const int num_tasks = static_cast<int>(task_starts.size()) - 1;
+  const int task = TaskIndex(task_starts, rank);
+  const int local_rank = rank - task_starts[task];
+  const int num_local = task_starts[task + 1] - task_starts[task];
+  for (int c = 2 * local_rank + 1; c <= 2 * local_rank + 2 && c < num_local;
+       ++c) {
+    children->push_back(task_starts[task] + c);
+  }
+  if (local_rank == 0) {
+    for (int c = 2 * task + 1; c <= 2 * task + 2 && c < num_tasks; ++c) {
+      children->push_back(task_starts[c]);
+    }
+  }
+}
+
+void HierarchicalTreeReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  // Like `RingReducer`, this doesn't require non-overlapping collectives, so
+  // unblock any collective that is blocked on this instance.
+  col_ctx_->col_exec->UnblockDependencies(*col_params_);
+  rank_ = col_params_->default_rank;
+
+  Status status = CopyInputToOutput();
+  if (status.ok()) {
+    AllocatorAttributes attr = col_ctx_->op_ctx->output_alloc_attr(0);
+    ca_.reset(MakeCollectiveAdapter(col_ctx_->output, /*num_chunks=*/1,
+                                    col_ctx_->device->GetAllocator(attr)));
+    status = RunReduce();
+    // Recover the output from the adapter.
+    ca_->ConsumeFinalValue(col_ctx_->output);
+  }
+  if (!status.ok()) {
+    LOG(ERROR) << "Aborting HierarchicalTreeReduce with " << status;
+    col_ctx_->col_exec->StartAbort(status);
+  }
+  VLOG(2) << "device=" << col_ctx_->device_name << " return status " << status;
+  done(status);
+}
+
+Status HierarchicalTreeReducer::RunReduce() {
+  // Aliases the flattened output.
+  Tensor value = ca_->Value();
+  const int parent = TreeParent(*col_params_, rank_);
+  std::vector<int> children;
+  TreeChildren(*col_params_, rank_, &children);
+  VLOG(1) << "HierarchicalTreeReducer::Run for device "
+          << col_ctx_->device_name << " rank " << rank_ << " parent "
+          << parent << " children " << absl::StrJoin(children, ",");
+
+  // Reduce the values of the children, which arrive concurrently, and pass
+  // the partial reduction up.
+  if (!children.empty()) {
+    profiler::TraceMe activity("ReduceChildren", profiler::TraceMeLevel::kInfo);
+    Allocator* allocator =
+        col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0));
+    std::vector<Tensor> incoming;
+    incoming.reserve(children.size());
+    for (int i = 0; i < children.size(); ++i) {
+      incoming.emplace_back(allocator, value.dtype(), value.shape());
+    }
+    const DeviceBase::GpuDeviceInfo* gpu_info =
+        col_ctx_->device->tensorflow_gpu_device_info();
+    if (gpu_info) {
+      // Wait for all currently queued events on the compute stream to
+      // complete, since the buffers allocated above aren't guaranteed to be
+      // valid (e.g. for RDMA write) before they do.
+      Notification note;
+      TF_RETURN_IF_ERROR(gpu_info->default_context->ThenExecute(
+          col_ctx_->device, gpu_info->stream, [&note]() { note.Notify(); }));
+      note.WaitForNotification();
+    }
+    TF_RETURN_IF_ERROR(Transfer("reduce", {}, nullptr, children, &incoming));
+    for (Tensor& child_value : incoming) {
+      TF_RETURN_IF_ERROR(collective_util::ComputeBinOp(
+          col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+          col_params_->merge_op.get(), &value, &child_value));
+    }
+  }
+
+  if (parent >= 0) {
+    TF_RETURN_IF_ERROR(Transfer("reduce", {parent}, &value, {}, nullptr));
+    // Wait for the result to come back down.
+    std::vector<Tensor> result = {value};
+    TF_RETURN_IF_ERROR(Transfer("broadcast", {}, nullptr, {parent}, &result));
+  } else if (col_params_->final_op) {
+    TF_RETURN_IF_ERROR(InitGroupSizeTensor());
+    TF_RETURN_IF_ERROR(collective_util::ComputeBinOp(
+        col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+        col_params_->final_op.get(), &value, &group_size_tensor_));
+  }
+
+  profiler::TraceMe activity("ForwardResult", profiler::TraceMeLevel::kInfo);
+  return Transfer("broadcast", children, &value, {}, nullptr);
+}
+
+Status HierarchicalTreeReducer::CopyInputToOutput() {
+  if (col_ctx_->input == col_ctx_->output ||
+      DMAHelper::base(col_ctx_->input) == DMAHelper::base(col_ctx_->output)) {
+    return Status::OK();
+  }
+  // We are running in a blockable thread and the callback can't block so just
+  // wait here on the copy.
+  Notification note;
+  Status status;
+  profiler::TraceMe activity("MemCpyAsync", profiler::TraceMeLevel::kInfo);
+  CollectiveRemoteAccessLocal::MemCpyAsync(
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+      col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+      col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+      col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+      [&note, &status](const Status& s) {
+        status.Update(s);
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+Status HierarchicalTreeReducer::InitGroupSizeTensor() {
+  Tensor group_size_val = ca_->Scalar(col_params_->group.group_size);
+  if (col_params_->group.device_type == "CPU") {
+    group_size_tensor_ = group_size_val;
+    return Status::OK();
+  }
+  group_size_tensor_ = ca_->Scalar(
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->input_alloc_attr(0)),
+      AllocationAttributes());
+  Notification note;
+  Status status;
+  col_ctx_->op_ctx->op_device_context()->CopyCPUTensorToDevice(
+      &group_size_val, col_ctx_->device, &group_size_tensor_,
+      [&note, &status](const Status& s) {
+        status = s;
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+Status HierarchicalTreeReducer::Transfer(const string& phase,
+                                         const std::vector<int>& send_ranks,
+                                         const Tensor* send_tensor,
+                                         const std::vector<int>& recv_ranks,
+                                         std::vector<Tensor>* recv_tensors) {
+  // Every device skips the transfers of an empty value alike.
+  if (ca_->Value().NumElements() == 0) return Status::OK();
+  const int num_transfers = send_ranks.size() + recv_ranks.size();
+  if (num_transfers == 0) return Status::OK();
+
+  mutex mu;
+  Status status;
+  BlockingCounter pending(num_transfers);
+  auto transfer_done = [this, &mu, &status, &pending](const Status& s) {
+    bool abort_started = false;
+    {
+      mutex_lock l(mu);
+      abort_started = status.ok() && !s.ok();
+      status.Update(s);
+    }
+    // Cancel the outstanding transfers, of this device and its peers.
+    if (abort_started) col_ctx_->col_exec->StartAbort(s);
+    pending.DecrementCount();
+  };
+  for (int dst_rank : send_ranks) {
+    VLOG(3) << "Send " << phase << " from " << rank_ << " to " << dst_rank;
+    col_ctx_->col_exec->PostToPeer(
+        col_params_->instance.device_names[dst_rank],
+        col_params_->instance.task_names[dst_rank],
+        TreeReduceBufKey(col_ctx_->exec_key, phase, rank_, dst_rank),
+        col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->output_alloc_attr(0), send_tensor,
+        col_ctx_->device_locality, transfer_done);
+  }
+  for (int i = 0; i < recv_ranks.size(); ++i) {
+    const int src_rank = recv_ranks[i];
+    VLOG(3) << "Recv " << phase << " from " << src_rank << " to " << rank_;
+    col_ctx_->col_exec->RecvFromPeer(
+        col_params_->instance.device_names[src_rank],
+        col_params_->instance.task_names[src_rank],
+        col_params_->task.is_local[src_rank],
+        TreeReduceBufKey(col_ctx_->exec_key, phase, src_rank, rank_),
+        col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->output_alloc_attr(0), &(*recv_tensors)[i],
+        col_ctx_->device_locality, 0 /*dev_to_dev_stream_index*/,
+        transfer_done);
+  }
+  pending.Wait();
+  mutex_lock l(mu);
+  return status;
+}
+
+namespace {
+REGISTER_COLLECTIVE(HierarchicalTreeReduce, HierarchicalTreeReducer);
+}  // namespace
+
+}  // namespace tensorflow
@@ -0,0 +1,93 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_TREE_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_TREE_REDUCER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+
+// Two-level tree-algorithm implementation of collective all-reduce.
+//
+// The devices of each task form a binary tree rooted at the first device of
+// the task, and these task roots form a binary tree across tasks rooted at the
+// first task.  Values are reduced up both trees to the first device of the
+// group, and the result is broadcast back down.  Only one device per task
+// sends and receives across tasks, and each device waits for at most
+// 2 * (log2(devices per task) + log2(tasks)) sequential transfers, which suits
+// small reductions over many tasks with several devices each.  Each transfer
+// moves the whole value, so large reductions should use the ring.
+class HierarchicalTreeReducer : public CollectiveImplementationInterface {
+ public:
+  HierarchicalTreeReducer();
+  ~HierarchicalTreeReducer() override = default;
+
+  // Checks that `col_params` describes a reduction.  The trees are derived
+  // from the task names, which are sorted so that all devices in the same task
+  // are adjacent.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(CollectiveContext* col_ctx) override;
+
+  // No-op for hierarchical tree reducer.
+  Status InitializeCollectiveGroupRuntimeDetails(
+      CollGroupRuntimeDetails*) override {
+    return Status::OK();
+  }
+
+  // Runs the reduction to completion before calling `done`.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+  // Returns the rank of the device that the device at `rank` sends its
+  // partial reduction to, -1 for the root of the group.
+  static int TreeParent(const CollectiveParams& cp, int rank);
+
+  // Populates `children` with the ranks of the devices whose partial
+  // reductions the device at `rank` merges.
+  static void TreeChildren(const CollectiveParams& cp, int rank,
+                           std::vector<int>* children);
+
+ private:
+  Status RunReduce();
+
+  // Copies the input to the output, unless the reduction runs in place.
+  Status CopyInputToOutput();
+
+  // Sets group_size_tensor_ to the group size on the device, for final_op.
+  Status InitGroupSizeTensor();
+
+  // Sends `send_tensor` to each of `send_ranks` and receives `recv_tensors[i]`
+  // from `recv_ranks[i]` concurrently, and waits for all of them.
+  Status Transfer(const string& phase, const std::vector<int>& send_ranks,
+                  const Tensor* send_tensor, const std::vector<int>& recv_ranks,
+                  std::vector<Tensor>* recv_tensors);
+
+  CollectiveContext* col_ctx_;          // Not owned
+  const CollectiveParams* col_params_;  // Not owned
+  std::unique_ptr<CollectiveAdapter> ca_;
+  Tensor group_size_tensor_;
+  int rank_;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_TREE_REDUCER_H_
@@ -0,0 +1,82 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_tree_reducer.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/cpu_reducer_testlib.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class HierarchicalTreeReducerTest : public CpuReducerTest {
+ protected:
+  HierarchicalTreeReducerTest() : CpuReducerTest("HierarchicalTreeReduce") {}
+};
+
+TEST_F(HierarchicalTreeReducerTest, TreeTopology) {
+  // 3 tasks with 4 devices each.  Device 0 is the root of the group, devices
+  // 4 and 8 are the roots of their tasks.
+  Init(/*num_workers=*/3, /*num_devices=*/4, DT_FLOAT, /*fail_after=*/0);
+  const std::vector<int> expected_parents = {-1, 0, 0, 1, 0, 4,
+                                             4,  5, 0, 8, 8, 9};
+  const std::vector<std::vector<int>> expected_children = {
+      {1, 2, 4, 8}, {3}, {}, {}, {5, 6}, {7}, {}, {}, {9, 10}, {11}, {}, {}};
+  for (int rank = 0; rank < col_params_.group.group_size; ++rank) {
+    EXPECT_EQ(expected_parents[rank],
+              HierarchicalTreeReducer::TreeParent(col_params_, rank))
+        << "rank " << rank;
+    std::vector<int> children;
+    HierarchicalTreeReducer::TreeChildren(col_params_, rank, &children);
+    EXPECT_EQ(expected_children[rank], children) << "rank " << rank;
+  }
+}
+
+TEST_F(HierarchicalTreeReducerTest, RejectsNonAdjacentTasks) {
+  Init(/*num_workers=*/2, /*num_devices=*/2, DT_FLOAT, /*fail_after=*/0);
+  std::swap(col_params_.instance.task_names[1],
+            col_params_.instance.task_names[2]);
+  HierarchicalTreeReducer reducer;
+  EXPECT_FALSE(reducer.InitializeCollectiveParams(&col_params_).ok());
+}
+
+#define DEF_TEST(B, W, D, L, A)                                              \
+  TEST_F(HierarchicalTreeReducerTest,                                        \
+         DaTy##B##_Wkr##W##_Dev##D##_Len##L##_Abrt##A) {                     \
+    RunTest(DT_##B, W, D, L, A);                                             \
+  }
+
+// Success tests.  Groups with a single task only use the intra-task tree,
+// groups with a single device per task only use the inter-task tree.
+DEF_TEST(FLOAT, 1, 2, 1, 0)
+DEF_TEST(FLOAT, 1, 2, 1001, 0)
+DEF_TEST(FLOAT, 1, 7, 1001, 0)
+DEF_TEST(FLOAT, 5, 1, 4096, 0)
+DEF_TEST(FLOAT, 2, 3, 17, 0)
+DEF_TEST(FLOAT, 3, 4, 9408, 0)
+DEF_TEST(FLOAT, 8, 8, 128, 0)
+DEF_TEST(DOUBLE, 3, 2, 1001, 0)
+DEF_TEST(INT32, 2, 5, 4095, 0)
+DEF_TEST(INT64, 4, 3, 1001, 0)
+
+// Failure tests
+DEF_TEST(FLOAT, 2, 4, 9408, 1)
+DEF_TEST(FLOAT, 2, 4, 9408, 7)
+DEF_TEST(FLOAT, 3, 2, 9408, 4)
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,349 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/recursive_halving_doubling_reducer.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/profiler/lib/traceme.h"
+
+namespace tensorflow {
+
+namespace {
+// Key to be used for BufRendezvous by RecursiveHalvingDoublingReducer.
+string HalvingDoublingBufKey(const string& exec_key, const string& phase,
+                             int step, int src_rank, int dst_rank) {
+  return strings::StrCat(exec_key, ":", phase, ":", step, ":", src_rank, ":",
+                         dst_rank);
+}
+}  // namespace
+
+RecursiveHalvingDoublingReducer::RecursiveHalvingDoublingReducer()
+    : col_ctx_(nullptr),
+      col_params_(nullptr),
+      rank_(-1),
+      num_active_(0),
+      num_extra_(0),
+      chunk_elts_(0) {}
+
+/* static */
+int RecursiveHalvingDoublingReducer::NumActiveDevices(int group_size) {
+  int num_active = 1;
+  while (num_active * 2 <= group_size) num_active *= 2;
+  return num_active;
+}
+
+Status RecursiveHalvingDoublingReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  if (col_params->instance.type != REDUCTION_COLLECTIVE) {
+    return errors::Internal(
+        "RecursiveHalvingDoublingReduce expects a reduction collective, got "
+        "collective type ",
+        col_params->instance.type);
+  }
+  return Status::OK();
+}
+
+Status RecursiveHalvingDoublingReducer::InitializeCollectiveContext(
+    CollectiveContext* col_ctx) {
+  CHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = &col_ctx->col_params;
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+void RecursiveHalvingDoublingReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  // Like `RingReducer`, this doesn't require non-overlapping collectives, so
+  // unblock any collective that is blocked on this instance.
+  col_ctx_->col_exec->UnblockDependencies(*col_params_);
+
+  rank_ = col_params_->default_rank;
+  num_active_ = NumActiveDevices(col_params_->group.group_size);
+  num_extra_ = col_params_->group.group_size - num_active_;
+  VLOG(1) << "RecursiveHalvingDoublingReducer::Run for device "
+          << col_ctx_->device_name << " rank " << rank_ << " active devices "
+          << num_active_ << " extra devices " << num_extra_;
+
+  Status status = CopyInputToOutput();
+  if (status.ok()) {
+    AllocatorAttributes attr = col_ctx_->op_ctx->output_alloc_attr(0);
+    ca_.reset(MakeCollectiveAdapter(col_ctx_->output, num_active_,
+                                    col_ctx_->device->GetAllocator(attr)));
+    chunk_elts_ = CollectiveAdapter::AlignedChunkElts(
+        DataTypeSize(ca_->Value().dtype()), ca_->Value().NumElements(),
+        num_active_);
+    status = RunReduce();
+    // Recover the output from the adapter.
+    ca_->ConsumeFinalValue(col_ctx_->output);
+  }
+  if (!status.ok()) {
+    LOG(ERROR) << "Aborting RecursiveHalvingDoublingReduce with " << status;
+    col_ctx_->col_exec->StartAbort(status);
+  }
+  VLOG(2) << "device=" << col_ctx_->device_name << " return status " << status;
+  done(status);
+}
+
+Status RecursiveHalvingDoublingReducer::RunReduce() {
+  // Aliases the flattened output.
+  Tensor value = ca_->Value();
+  if (rank_ < 2 * num_extra_ && rank_ % 2 == 1) {
+    // Only lend the value to the even device before this one, which takes
+    // part in the halving and doubling on behalf of both.
+    TF_RETURN_IF_ERROR(Exchange("fold", 0, rank_ - 1, &value, nullptr));
+    return Exchange("unfold", 0, rank_ - 1, nullptr, &value);
+  }
+
+  // Holds incoming values before they are merged.  No step receives more than
+  // the whole value.
+  Tensor incoming(
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0)),
+      value.dtype(), value.shape());
+  const DeviceBase::GpuDeviceInfo* gpu_info =
+      col_ctx_->device->tensorflow_gpu_device_info();
+  if (gpu_info) {
+    // Wait for all currently queued events on the compute stream to complete,
+    // since the buffer allocated above isn't guaranteed to be valid (e.g. for
+    // RDMA write) before they do.
+    Notification note;
+    TF_RETURN_IF_ERROR(gpu_info->default_context->ThenExecute(
+        col_ctx_->device, gpu_info->stream, [&note]() { note.Notify(); }));
+    note.WaitForNotification();
+  }
+
+  int active_rank = rank_ - num_extra_;
+  if (rank_ < 2 * num_extra_) {
+    // Fold in the value of the odd device after this one.
+    TF_RETURN_IF_ERROR(Exchange("fold", 0, rank_ + 1, nullptr, &incoming));
+    TF_RETURN_IF_ERROR(Merge(&value, &incoming));
+    active_rank = rank_ / 2;
+  }
+
+  // Reduce-scatter by recursive halving.  At each step this device keeps the
+  // half of its chunk range selected by its bit in `mask`, and exchanges the
+  // other half with the peer that differs in that bit.  Afterwards it holds
+  // the fully reduced chunk `active_rank`.
+  int lo = 0;
+  int hi = num_active_;
+  int step = 0;
+  for (int mask = num_active_ / 2; mask > 0; mask /= 2, ++step) {
+    profiler::TraceMe activity(
+        [&] { return strings::StrCat("Halving:", step); },
+        profiler::TraceMeLevel::kInfo);
+    const int mid = lo + (hi - lo) / 2;
+    const bool keep_upper = (active_rank & mask) != 0;
+    Tensor keep = keep_upper ? ChunkRange(mid, hi) : ChunkRange(lo, mid);
+    Tensor give = keep_upper ? ChunkRange(lo, mid) : ChunkRange(mid, hi);
+    Tensor recv = incoming.Slice(0, keep.NumElements());
+    TF_RETURN_IF_ERROR(Exchange("halving", step,
+                                ActiveToGroupRank(active_rank ^ mask), &give,
+                                &recv));
+    if (keep.NumElements() > 0) {
+      TF_RETURN_IF_ERROR(Merge(&keep, &recv));
+    }
+    if (keep_upper) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if (col_params_->final_op) {
+    Tensor chunk = ChunkRange(lo, hi);
+    if (chunk.NumElements() > 0) {
+      TF_RETURN_IF_ERROR(InitGroupSizeTensor());
+      TF_RETURN_IF_ERROR(collective_util::ComputeBinOp(
+          col_ctx_->op_ctx, col_ctx_->op_params, col_ctx_->device,
+          col_params_->final_op.get(), &chunk, &group_size_tensor_));
+    }
+  }
+
+  // All-gather by recursive doubling, visiting the peers in reverse order.
+  step = 0;
+  for (int mask = 1; mask < num_active_; mask *= 2, ++step) {
+    profiler::TraceMe activity(
+        [&] { return strings::StrCat("Doubling:", step); },
+        profiler::TraceMeLevel::kInfo);
+    const int width = hi - lo;
+    const int peer_lo = (active_rank & mask) != 0 ? lo - width : hi;
+    Tensor mine = ChunkRange(lo, hi);
+    Tensor theirs = ChunkRange(peer_lo, peer_lo + width);
+    TF_RETURN_IF_ERROR(Exchange("doubling", step,
+                                ActiveToGroupRank(active_rank ^ mask), &mine,
+                                &theirs));
+    lo = std::min(lo, peer_lo);
+    hi = lo + 2 * width;
+  }
+
+  if (rank_ < 2 * num_extra_) {
+    TF_RETURN_IF_ERROR(Exchange("unfold", 0, rank_ + 1, &value, nullptr));
+  }
+  return Status::OK();
+}
+
+Status RecursiveHalvingDoublingReducer::CopyInputToOutput() {
+  if (col_ctx_->input == col_ctx_->output ||
+      DMAHelper::base(col_ctx_->input) == DMAHelper::base(col_ctx_->output)) {
+    return Status::OK();
+  }
+  // We are running in a blockable thread and the callback can't block so just
+  // wait here on the copy.
+  Notification note;
+  Status status;
+  profiler::TraceMe activity("MemCpyAsync", profiler::TraceMeLevel::kInfo);
+  CollectiveRemoteAccessLocal::MemCpyAsync(
+      col_ctx_->op_ctx->op_device_context(),
+      col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+      col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+      col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+      col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+      [&note, &status](const Status& s) {
+        status.Update(s);
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+Status RecursiveHalvingDoublingReducer::InitGroupSizeTensor() {
+  Tensor group_size_val = ca_->Scalar(col_params_->group.group_size);
+  if (col_params_->group.device_type == "CPU") {
+    group_size_tensor_ = group_size_val;
+    return Status::OK();
+  }
+  group_size_tensor_ = ca_->Scalar(
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->input_alloc_attr(0)),
+      AllocationAttributes());
+  Notification note;
+  Status status;
+  col_ctx_->op_ctx->op_device_context()->CopyCPUTensorToDevice(
+      &group_size_val, col_ctx_->device, &group_size_tensor_,
+      [&note, &status](const Status& s) {
+        status = s;
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+Tensor RecursiveHalvingDoublingReducer::ChunkRange(int lo, int hi) const {
+  const Tensor& value = ca_->Value();
+  const int64 num_elements = value.NumElements();
+  const int64 start = std::min(num_elements, lo * chunk_elts_);
+  const int64 limit = std::min(num_elements, hi * chunk_elts_);
+  // As in CollectiveAdapter::ChunkAlias, an empty range is taken from the
+  // front of the value to avoid an illegal offset.
+  return start < limit ? value.Slice(start, limit) : value.Slice(0, 0);
+}
+
+int RecursiveHalvingDoublingReducer::ActiveToGroupRank(int active_rank) const {
+  return active_rank < num_extra_ ? 2 * active_rank : active_rank + num_extra_;
+}
+
+Status RecursiveHalvingDoublingReducer::Exchange(const string& phase, int step,
+                                                 int peer_rank,
+                                                 const Tensor* send_tensor,
+                                                 Tensor* recv_tensor) {
+  // Both peers compute the same range sizes, so they agree on which empty
+  // transfers to skip.
+  if (send_tensor != nullptr && send_tensor->NumElements() == 0) {
+    send_tensor = nullptr;
+  }
+  if (recv_tensor != nullptr && recv_tensor->NumElements() == 0) {
+    recv_tensor = nullptr;
+  }
+  const int num_transfers =
+      (send_tensor != nullptr ? 1 : 0) + (recv_tensor != nullptr ? 1 : 0);
+  if (num_transfers == 0) return Status::OK();
+
+  const string& peer_device = col_params_->instance.device_names[peer_rank];
+  const string& peer_task = col_params_->instance.task_names[peer_rank];
+  mutex mu;
+  Status status;
+  BlockingCounter pending(num_transfers);
+  auto transfer_done = [this, &mu, &status, &pending](const Status& s) {
+    bool abort_started = false;
+    {
+      mutex_lock l(mu);
+      abort_started = status.ok() && !s.ok();
+      status.Update(s);
+    }
+    // Cancel the outstanding transfers, of this device and its peers.
+    if (abort_started) col_ctx_->col_exec->StartAbort(s);
+    pending.DecrementCount();
+  };
+  if (send_tensor != nullptr) {
+    VLOG(3) << "Send " << phase << ":" << step << " from " << rank_ << " to "
+            << peer_rank << " " << send_tensor->NumElements() << " elements";
+    col_ctx_->col_exec->PostToPeer(
+        peer_device, peer_task,
+        HalvingDoublingBufKey(col_ctx_->exec_key, phase, step, rank_,
+                              peer_rank),
+        col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->output_alloc_attr(0), send_tensor,
+        col_ctx_->device_locality, transfer_done);
+  }
+  if (recv_tensor != nullptr) {
+    VLOG(3) << "Recv " << phase << ":" << step << " from " << peer_rank
+            << " to " << rank_ << " " << recv_tensor->NumElements()
+            << " elements";
+    col_ctx_->col_exec->RecvFromPeer(
+        peer_device, peer_task, col_params_->task.is_local[peer_rank],
+        HalvingDoublingBufKey(col_ctx_->exec_key, phase, step, peer_rank,
+                              rank_),
+        col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->output_alloc_attr(0), recv_tensor,
+        col_ctx_->device_locality, 0 /*dev_to_dev_stream_index*/,
+        transfer_done);
+  }
+  pending.Wait();
+  mutex_lock l(mu);
+  return status;
+}
+
+Status RecursiveHalvingDoublingReducer::Merge(Tensor* output, Tensor* input) {
+  return collective_util::ComputeBinOp(col_ctx_->op_ctx, col_ctx_->op_params,
+                                       col_ctx_->device,
+                                       col_params_->merge_op.get(), output,
+                                       input);
+}
+
+namespace {
+REGISTER_COLLECTIVE(RecursiveHalvingDoublingReduce,
+                    RecursiveHalvingDoublingReducer);
+}  // namespace
+
+}  // namespace tensorflow
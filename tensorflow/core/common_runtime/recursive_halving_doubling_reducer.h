@@ -0,0 +1,102 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_RECURSIVE_HALVING_DOUBLING_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_RECURSIVE_HALVING_DOUBLING_REDUCER_H_
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+
+// Recursive halving-doubling implementation of collective all-reduce.
+//
+// A reduce-scatter by recursive halving is followed by an all-gather by
+// recursive doubling.  For a group of n devices this takes 2 * log2(n)
+// sequential transfers instead of the 2 * (n - 1) of the ring, while moving
+// the same number of bytes per device, so it suits reductions that are bound
+// by latency rather than bandwidth.
+//
+// If n is not a power of two, with p the largest power of two below n, the
+// first 2 * (n - p) devices pair up before the halving: each odd device sends
+// its value to the even one before it, and receives the result from it at the
+// end.  Only p devices take part in the halving and doubling.
+class RecursiveHalvingDoublingReducer
+    : public CollectiveImplementationInterface {
+ public:
+  RecursiveHalvingDoublingReducer();
+  ~RecursiveHalvingDoublingReducer() override = default;
+
+  // Checks that `col_params` describes a reduction.  No subdivs are needed,
+  // each device derives its peers from its default rank.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(CollectiveContext* col_ctx) override;
+
+  // No-op for recursive halving-doubling reducer.
+  Status InitializeCollectiveGroupRuntimeDetails(
+      CollGroupRuntimeDetails*) override {
+    return Status::OK();
+  }
+
+  // Runs the reduction to completion before calling `done`.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+  // Returns the largest power of two that is at most `group_size`, i.e. the
+  // number of devices that take part in the halving and doubling.
+  static int NumActiveDevices(int group_size);
+
+ private:
+  Status RunReduce();
+
+  // Copies the input to the output, unless the reduction runs in place.
+  Status CopyInputToOutput();
+
+  // Sets group_size_tensor_ to the group size on the device, for final_op.
+  Status InitGroupSizeTensor();
+
+  // Returns the range of the flattened value that covers chunks [lo, hi),
+  // out of one chunk per active device.
+  Tensor ChunkRange(int lo, int hi) const;
+
+  // Maps the rank among the active devices to the rank in the group.
+  int ActiveToGroupRank(int active_rank) const;
+
+  // Sends `send_tensor` to and receives `recv_tensor` from the device at
+  // `peer_rank` concurrently, and waits for both.  Either may be null, and
+  // empty tensors are not transferred.
+  Status Exchange(const string& phase, int step, int peer_rank,
+                  const Tensor* send_tensor, Tensor* recv_tensor);
+
+  // Reduces `input` into `output` with merge_op.
+  Status Merge(Tensor* output, Tensor* input);
+
+  CollectiveContext* col_ctx_;          // Not owned
+  const CollectiveParams* col_params_;  // Not owned
+  std::unique_ptr<CollectiveAdapter> ca_;
+  Tensor group_size_tensor_;
+  int rank_;
+  int num_active_;  // Devices taking part in the halving and doubling.
+  int num_extra_;   // Devices folded into a neighbour beforehand.
+  int64 chunk_elts_;
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_RECURSIVE_HALVING_DOUBLING_REDUCER_H_
@@ -0,0 +1,74 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/recursive_halving_doubling_reducer.h"
+
+#include "tensorflow/core/common_runtime/cpu_reducer_testlib.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class RecursiveHalvingDoublingReducerTest : public CpuReducerTest {
+ protected:
+  RecursiveHalvingDoublingReducerTest() : CpuReducerTest("RecursiveHalvingDoublingReduce") {}
+};
+
+TEST_F(RecursiveHalvingDoublingReducerTest, NumActiveDevices) {
+  EXPECT_EQ(1, RecursiveHalvingDoublingReducer::NumActiveDevices(1));
+  EXPECT_EQ(2, RecursiveHalvingDoublingReducer::NumActiveDevices(2));
+  EXPECT_EQ(2, RecursiveHalvingDoublingReducer::NumActiveDevices(3));
+  EXPECT_EQ(8, RecursiveHalvingDoublingReducer::NumActiveDevices(8));
+  EXPECT_EQ(8, RecursiveHalvingDoublingReducer::NumActiveDevices(15));
+  EXPECT_EQ(64, RecursiveHalvingDoublingReducer::NumActiveDevices(100));
+}
+
+TEST_F(RecursiveHalvingDoublingReducerTest, RejectsNonReduction) {
+  CollectiveParams cp;
+  cp.instance.type = GATHER_COLLECTIVE;
+  RecursiveHalvingDoublingReducer reducer;
+  EXPECT_FALSE(reducer.InitializeCollectiveParams(&cp).ok());
+}
+
+#define DEF_TEST(B, W, D, L, A)                                              \
+  TEST_F(RecursiveHalvingDoublingReducerTest,                                \
+         DaTy##B##_Wkr##W##_Dev##D##_Len##L##_Abrt##A) {                     \
+    RunTest(DT_##B, W, D, L, A);                                             \
+  }
+
+// Success tests.  Groups of size 3, 5, 6 and 7 exercise the folding of the
+// extra devices, and lengths below the group size leave some chunks empty.
+DEF_TEST(FLOAT, 1, 2, 1, 0)
+DEF_TEST(FLOAT, 1, 2, 1001, 0)
+DEF_TEST(FLOAT, 1, 3, 1001, 0)
+DEF_TEST(FLOAT, 1, 4, 4096, 0)
+DEF_TEST(FLOAT, 1, 5, 3, 0)
+DEF_TEST(FLOAT, 1, 7, 9408, 0)
+DEF_TEST(FLOAT, 2, 3, 17, 0)
+DEF_TEST(FLOAT, 2, 4, 128, 0)
+DEF_TEST(FLOAT, 2, 8, 1001, 0)
+DEF_TEST(FLOAT, 4, 4, 65536, 0)
+DEF_TEST(DOUBLE, 1, 6, 1001, 0)
+DEF_TEST(INT32, 1, 2, 1001, 0)
+DEF_TEST(INT32, 2, 5, 4095, 0)
+DEF_TEST(INT64, 1, 2, 1001, 0)
+DEF_TEST(INT64, 2, 8, 4095, 0)
+
+// Failure tests
+DEF_TEST(FLOAT, 2, 4, 9408, 1)
+DEF_TEST(FLOAT, 2, 4, 9408, 7)
+DEF_TEST(FLOAT, 1, 6, 9408, 3)
+
+}  // namespace
+}  // namespace tensorflow
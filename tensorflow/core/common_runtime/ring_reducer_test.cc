@@ -31,9 +31,11 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/platform/unbounded_work_queue.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/public/version.h"
@@ -700,6 +702,57 @@ DEF_TEST(INT64, CPU, 2, 8, 3, 4095, 0)
 DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 1)
 DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 7)
 DEF_TEST(FLOAT, CPU, 2, 8, 2, 9408, 11)
+
+class RingReducerBenchmark : public RingReducerTest {
+ public:
+  void TestBody() override {}
+
+  void Init(int num_devices, int64 tensor_len) {
+    RingReducerTest::Init(/*num_workers=*/1, num_devices, DT_FLOAT, DEVICE_CPU,
+                          /*num_subdivs=*/1, /*fail_after=*/0);
+    for (DeviceInstance* di : instances_) {
+      di->InitTensor(DT_FLOAT, TensorShape({tensor_len}),
+                     [](Tensor* t) { t->flat<float>().setConstant(1.0f); });
+    }
+  }
+
+  // Runs one all-reduce on all devices and waits for it. Each call needs its
+  // own instance key, so that consecutive all-reduces don't share keys.
+  void ReduceOnce(int32 instance_key) {
+    BlockingCounter counter(instances_.size());
+    for (DeviceInstance* di : instances_) {
+      di->col_params_.instance.instance_key = instance_key;
+      SchedClosure([di, &counter] {
+        di->DoReduce();
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+};
+
+// All-reduces the same number of bytes as num_tensors separate collectives,
+// as issued for many small gradients that aren't fused into one buffer.
+static void BM_RingReduceSplit(int iters, int num_tensors) {
+  testing::StopTiming();
+  const int kNumDevices = 4;
+  const int64 kNumElements = 1 << 16;
+  RingReducerBenchmark bench;
+  bench.Init(kNumDevices, kNumElements / num_tensors);
+  int32 instance_key = 0;
+
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * kNumElements *
+                          sizeof(float));
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    for (int t = 0; t < num_tensors; ++t) {
+      bench.ReduceOnce(++instance_key);
+    }
+  }
+  testing::StopTiming();
+}
+BENCHMARK(BM_RingReduceSplit)->Arg(1)->Arg(16)->Arg(256);
 #endif
 
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
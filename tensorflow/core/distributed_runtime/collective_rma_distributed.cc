@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/distributed_runtime/cancellable_call.h"
+#include "tensorflow/core/distributed_runtime/recv_buf_shared_memory.h"
 #include "tensorflow/core/distributed_runtime/request_id.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/platform/protobuf_internal.h"
@@ -38,6 +39,7 @@ class RecvBufCall : public CancellableCall {
               const AllocatorAttributes& to_alloc_attr, Tensor* to_tensor,
               const DeviceLocality& client_locality,
               const DeviceAttributes& server_attributes,
+              const SharedMemorySegment* segment,
               CancellationManager* cancel_mgr, WorkerCacheInterface* wc)
       : CancellableCall(cancel_mgr, peer_task, wc) {
     req_.set_step_id(step_id);
@@ -50,6 +52,9 @@ class RecvBufCall : public CancellableCall {
     req_.set_src_incarnation(server_attributes.incarnation());
     req_.set_dst_device(to_device->name());
     req_.set_request_id(GetUniqueRequestId());
+    if (segment != nullptr) {
+      SetSharedMemoryInRecvBufReq(*segment, &req_);
+    }
   }
 
   ~RecvBufCall() override {}
@@ -63,8 +68,13 @@ class RecvBufCall : public CancellableCall {
 };
 
 void PopulateTensorFromExtra(const RecvBufRespExtra& extra,
+                             const SharedMemorySegment* segment,
                              Tensor* cpu_tensor) {
   char* head = reinterpret_cast<char*>(DMAHelper::base(cpu_tensor));
+  if (extra.in_shared_memory()) {
+    memcpy(head, segment->data(), cpu_tensor->TotalBytes());
+    return;
+  }
   for (const auto& tensor_content_chunk : extra.tensor_content()) {
     memcpy(head, std::string(tensor_content_chunk).data(),
            tensor_content_chunk.size());
@@ -92,6 +102,9 @@ void CollectiveRemoteAccessDistributed::RecvFromPeer(
   struct State {
     DeviceAttributes server_attributes;
     std::unique_ptr<RecvBufCall> call;
+    // Shared-memory segment offered to the server, if any.  It is reused
+    // only after a successful call, since the server may still write to it.
+    std::unique_ptr<SharedMemorySegment> segment;
   };
   State* state = new State;
 
@@ -101,13 +114,35 @@ void CollectiveRemoteAccessDistributed::RecvFromPeer(
                             done](const Status& s) {
     if (s.ok()) {
       // In this generic implementation the bytes come back in the
-      // RPC response protobuf rather than via RDMA so we need to copy
-      // them into the destination tensor here.
+      // RPC response protobuf, or in shared memory from a peer on the
+      // same host, rather than via RDMA so we need to copy them into the
+      // destination tensor here.
       RecvBufRespExtra extra;
       state->call->resp_.transport_options().UnpackTo(&extra);
       int64 num_bytes = 0;
-      for (const auto& chunk : extra.tensor_content()) {
-        num_bytes += chunk.size();
+      if (extra.in_shared_memory()) {
+        num_bytes = state->call->resp_.num_bytes();
+        if (state->segment == nullptr || num_bytes > state->segment->size()) {
+          done(errors::Internal("RecvBufResponse refers to ", num_bytes,
+                                " bytes of shared memory that were not "
+                                "offered"));
+          delete state;
+          return;
+        }
+      } else {
+        for (const auto& chunk : extra.tensor_content()) {
+          num_bytes += chunk.size();
+        }
+        if (state->segment != nullptr) {
+          if (state->segment->linked()) {
+            // The peer is on another host or cannot map our segments.
+            mutex_lock l(mu_);
+            shm_unreachable_tasks_.insert(peer_task);
+          }
+          // A reused segment that the peer no longer has mapped cannot be
+          // opened again, so it is dropped.
+          state->segment.reset();
+        }
       }
       if (num_bytes != to_tensor->TotalBytes()) {
         done(errors::Internal("RecvBufResponse returned ", num_bytes,
@@ -135,7 +170,10 @@ void CollectiveRemoteAccessDistributed::RecvFromPeer(
             step_id_, "dynamic", to_tensor->dtype(), &to_tensor->shape());
         Tensor* cpu_tensor = new Tensor(cpu_dev->GetAllocator(cpu_attr),
                                         to_tensor->dtype(), to_tensor->shape());
-        PopulateTensorFromExtra(extra, cpu_tensor);
+        PopulateTensorFromExtra(extra, state->segment.get(), cpu_tensor);
+        if (state->segment != nullptr) {
+          ReleaseRecvBufSegment(peer_task, std::move(state->segment));
+        }
         // Then copy it to the GPU.
         CopyTensor::ViaDMA("",  // edge name (non-existent)
                            nullptr /*send_dev_ctx*/, to_device_ctx, cpu_dev,
@@ -151,7 +189,10 @@ void CollectiveRemoteAccessDistributed::RecvFromPeer(
         return;
       } else {
         // CPU device
-        PopulateTensorFromExtra(extra, to_tensor);
+        PopulateTensorFromExtra(extra, state->segment.get(), to_tensor);
+        if (state->segment != nullptr) {
+          ReleaseRecvBufSegment(peer_task, std::move(state->segment));
+        }
       }
     }
     if (!s.ok() && errors::IsFailedPrecondition(s)) {
@@ -171,10 +212,13 @@ void CollectiveRemoteAccessDistributed::RecvFromPeer(
     if (!s.ok()) {
       recv_buf_callback(s);
     } else {
+      if (OfferSharedMemory(peer_task)) {
+        state->segment = AcquireRecvBufSegment(peer_task, to_tensor->TotalBytes());
+      }
       state->call.reset(new RecvBufCall(
           step_id_, peer_device, peer_task, key, to_device, to_device_ctx,
           to_alloc_attr, to_tensor, client_locality, state->server_attributes,
-          &cancel_mgr_, worker_cache_));
+          state->segment.get(), &cancel_mgr_, worker_cache_));
       state->call->Start(recv_buf_callback);
     }
   };
@@ -184,6 +228,12 @@ void CollectiveRemoteAccessDistributed::RecvFromPeer(
                                           dev_attributes_callback);
 }
 
+bool CollectiveRemoteAccessDistributed::OfferSharedMemory(
+    const string& peer_task) {
+  mutex_lock l(mu_);
+  return !shm_unreachable_tasks_.contains(peer_task);
+}
+
 void CollectiveRemoteAccessDistributed::StartAbort(const Status& s) {
   CollectiveRemoteAccessLocal::StartAbort(s);
   cancel_mgr_.StartCancel();
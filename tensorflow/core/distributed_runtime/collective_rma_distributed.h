@@ -15,14 +15,21 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_COLLECTIVE_RMA_DISTRIBUTED_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_COLLECTIVE_RMA_DISTRIBUTED_H_
 
+#include "absl/container/flat_hash_set.h"
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/unbounded_work_queue.h"
 
 namespace tensorflow {
 class WorkerCacheInterface;
 
 // Extend CollectiveRemoteAccessLocal with access to remote peers.
+//
+// Values from peers in other processes on the same host are passed through
+// shared memory instead of in the RecvBuf response, see
+// recv_buf_shared_memory.h.  Each RecvFromPeer from a peer task offers a
+// segment until the peer has once answered without using it.
 class CollectiveRemoteAccessDistributed : public CollectiveRemoteAccessLocal {
  public:
   CollectiveRemoteAccessDistributed(
@@ -45,8 +52,14 @@ class CollectiveRemoteAccessDistributed : public CollectiveRemoteAccessLocal {
   void StartAbort(const Status& s) override;
 
  protected:
+  // Returns whether to offer a shared-memory segment to `peer_task`.
+  bool OfferSharedMemory(const string& peer_task);
+
   WorkerCacheInterface* worker_cache_;  // Not owned
   CancellationManager cancel_mgr_;
+  mutex mu_;
+  // Tasks that answered a RecvBuf call without using the offered segment.
+  absl::flat_hash_set<string> shm_unreachable_tasks_ TF_GUARDED_BY(mu_);
 };
 
 }  // namespace tensorflow
@@ -15,11 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/collective_rma_distributed.h"
 
+#include <atomic>
+
 #include "google/protobuf/any.pb.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/distributed_runtime/device_resolver_distributed.h"
+#include "tensorflow/core/distributed_runtime/recv_buf_shared_memory.h"
 #include "tensorflow/core/distributed_runtime/test_utils.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/lib/core/notification.h"
@@ -28,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/transport_options.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 #include "tensorflow/core/util/device_name_utils.h"
@@ -73,6 +77,20 @@ class FakeWorker : public TestWorkerInterface {
   // worker is supposed to have.
   BufRendezvous* buf_rendezvous() { return &buf_rendezvous_; }
 
+  // Whether to write values to shared-memory segments offered by the
+  // client, like a worker on the same host.
+  void set_use_shared_memory(bool use_shared_memory) {
+    use_shared_memory_ = use_shared_memory;
+  }
+
+  // Number of requests that offered a shared-memory segment.
+  int num_shared_memory_offers() const { return num_shared_memory_offers_; }
+
+  // Number of values that were written to shared memory.
+  int num_shared_memory_responses() const {
+    return num_shared_memory_responses_;
+  }
+
   void GetStatusAsync(const GetStatusRequest* request,
                       GetStatusResponse* response, bool fail_fast,
                       StatusCallback done) override {
@@ -97,23 +115,33 @@ class FakeWorker : public TestWorkerInterface {
         buf_rendezvous_.StartAbort(errors::Internal("Cancelled"));
       });
     });
+    if (request->has_transport_options()) {
+      ++num_shared_memory_offers_;
+    }
     VLOG(2) << "ConsumeBuf key=" << request->buf_rendezvous_key()
             << " src_device=" << request->src_device()
             << " src_incarnation=" << request->src_incarnation();
     buf_rendezvous_.ConsumeBuf(
         request->buf_rendezvous_key(), request->src_device(),
         request->src_incarnation(),
-        [opts, response, done](const Status& s, BufRendezvous::Hook* h) {
+        [this, opts, request, response, done](const Status& s,
+                                              BufRendezvous::Hook* h) {
           if (s.ok()) {
             opts->ClearCancelCallback();
-            // Since this is not really RDMA into pre-allocated memory send the
-            // bytes in the response.
-            RecvBufRespExtra extra;
-            int64 num_bytes = h->prod_value->TotalBytes();
-            extra.add_tensor_content(string(
-                reinterpret_cast<const char*>(DMAHelper::base(h->prod_value)),
-                num_bytes));
-            response->mutable_transport_options()->PackFrom(extra);
+            if (use_shared_memory_ &&
+                SetTensorInRecvBufRespSharedMemory(*request, *h->prod_value,
+                                                   response)) {
+              ++num_shared_memory_responses_;
+            } else {
+              // Since this is not really RDMA into pre-allocated memory send
+              // the bytes in the response.
+              RecvBufRespExtra extra;
+              int64 num_bytes = h->prod_value->TotalBytes();
+              extra.add_tensor_content(string(
+                  reinterpret_cast<const char*>(DMAHelper::base(h->prod_value)),
+                  num_bytes));
+              response->mutable_transport_options()->PackFrom(extra);
+            }
           }
           done(s);
           if (h) BufRendezvous::DoneWithHook(h);
@@ -125,6 +153,9 @@ class FakeWorker : public TestWorkerInterface {
   DeviceMgr* device_mgr_;
   DeviceResolverDistributed* device_resolver_;
   BufRendezvous buf_rendezvous_;
+  bool use_shared_memory_ = true;
+  std::atomic<int> num_shared_memory_offers_{0};
+  std::atomic<int> num_shared_memory_responses_{0};
 };
 
 class FakeCache : public TestWorkerCache {
@@ -247,6 +278,51 @@ class CollRMADistTest : public ::testing::Test {
     DefineWorker(worker_name, device_type, num_devices);
   }
 
+  // Sets the value that worker 1 provides to `num_elts` floats.
+  void SetValueSize(int64 num_elts) {
+    expected_value_ = Tensor(DT_FLOAT, {num_elts});
+    to_tensor_ = Tensor(DT_FLOAT, {num_elts});
+    auto exp_alias = expected_value_.flat<float>();
+    auto to_alias = to_tensor_.flat<float>();
+    for (int64 i = 0; i < num_elts; ++i) {
+      exp_alias(i) = i;
+      to_alias(i) = -1;
+    }
+  }
+
+  // Provides the value on worker 1 under `buf_key` and receives it on
+  // worker 0.
+  Status ProvideAndRecv(const string& buf_key) {
+    Notification consumer_note;
+    Notification producer_note;
+    Status consumer_status;
+    Status producer_status;
+    workers_[1]->buf_rendezvous()->ProvideBuf(
+        buf_key, nullptr /*device*/, nullptr /*dev_ctx*/, &expected_value_,
+        AllocatorAttributes(),
+        [&producer_note, &producer_status](const Status& s) {
+          producer_status.Update(s);
+          producer_note.Notify();
+        });
+    Device* dst_device = nullptr;
+    string dev_name = "CPU:0";
+    TF_CHECK_OK(device_mgrs_[0]->LookupDevice(dev_name, &dst_device));
+    rma_->RecvFromPeer(
+        "/job:worker/replica:0/task:1/device:" + dev_name,  // peer_dev
+        "/job:worker/replica:0/task:1",                     // peer_task
+        false,                                              // peer_is_local
+        buf_key, dst_device, nullptr /*to_device_ctx*/, alloc_attr_,
+        &to_tensor_, device_locality_, 0 /*dev_to_dev_stream_index*/,
+        [&consumer_status, &consumer_note](const Status& s) {
+          consumer_status = s;
+          consumer_note.Notify();
+        });
+    consumer_note.WaitForNotification();
+    producer_note.WaitForNotification();
+    consumer_status.Update(producer_status);
+    return consumer_status;
+  }
+
   void ValidateResultTensor() {
     ASSERT_EQ(expected_value_.NumElements(), to_tensor_.NumElements());
     for (int i = 0; i < to_tensor_.NumElements(); ++i) {
@@ -417,5 +493,87 @@ TEST_F(CollRMADistTest, WorkerRestart) {
   EXPECT_TRUE(errors::IsFailedPrecondition(consumer_status));
 }
 
+TEST_F(CollRMADistTest, SharedMemoryOK) {
+  SetValueSize(1 << 16);
+  TF_EXPECT_OK(ProvideAndRecv("fake_buf_key"));
+  ValidateResultTensor();
+  EXPECT_EQ(1, workers_[1]->num_shared_memory_offers());
+  EXPECT_EQ(1, workers_[1]->num_shared_memory_responses());
+
+  // Segments are reused across values.
+  SetValueSize(1 << 16);
+  TF_EXPECT_OK(ProvideAndRecv("fake_buf_key_2"));
+  ValidateResultTensor();
+  EXPECT_EQ(2, workers_[1]->num_shared_memory_responses());
+}
+
+TEST_F(CollRMADistTest, SmallValueInResponse) {
+  TF_EXPECT_OK(ProvideAndRecv("fake_buf_key"));
+  ValidateResultTensor();
+  EXPECT_EQ(0, workers_[1]->num_shared_memory_offers());
+}
+
+TEST_F(CollRMADistTest, SharedMemoryUnreachable) {
+  // Worker 1 acts as if it was on another host.
+  workers_[1]->set_use_shared_memory(false);
+  SetValueSize(1 << 16);
+  TF_EXPECT_OK(ProvideAndRecv("fake_buf_key"));
+  ValidateResultTensor();
+  EXPECT_EQ(1, workers_[1]->num_shared_memory_offers());
+
+  // Once the peer has ignored a segment, none are offered to it anymore.
+  SetValueSize(1 << 16);
+  TF_EXPECT_OK(ProvideAndRecv("fake_buf_key_2"));
+  ValidateResultTensor();
+  EXPECT_EQ(1, workers_[1]->num_shared_memory_offers());
+  EXPECT_EQ(0, workers_[1]->num_shared_memory_responses());
+}
+
+class CollRMADistBenchmark : public CollRMADistTest {
+ public:
+  void TestBody() override {}
+
+  void Init(int64 num_elts, bool use_shared_memory) {
+    SetUp();
+    SetValueSize(num_elts);
+    workers_[1]->set_use_shared_memory(use_shared_memory);
+  }
+
+  void Recv(int iter) {
+    TF_CHECK_OK(ProvideAndRecv(strings::StrCat("buf_key_", iter)));
+  }
+};
+
+// Measures the transfer of a value between two workers in the same
+// process, which use shared memory like workers on the same host, or else
+// send the value in the RecvBuf response.
+static void BM_RecvFromPeer(int iters, int num_elts, bool use_shared_memory) {
+  testing::StopTiming();
+  CollRMADistBenchmark bm;
+  bm.Init(num_elts, use_shared_memory);
+  bm.Recv(-1);  // Warm up the segment pool.
+  testing::BytesProcessed(static_cast<int64>(iters) * num_elts *
+                          sizeof(float));
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    bm.Recv(i);
+  }
+  testing::StopTiming();
+}
+
+static void BM_RecvFromPeerSharedMemory(int iters, int num_elts) {
+  BM_RecvFromPeer(iters, num_elts, /*use_shared_memory=*/true);
+}
+
+static void BM_RecvFromPeerResponse(int iters, int num_elts) {
+  BM_RecvFromPeer(iters, num_elts, /*use_shared_memory=*/false);
+}
+
+BENCHMARK(BM_RecvFromPeerSharedMemory)
+    ->Arg(1 << 12)
+    ->Arg(1 << 16)
+    ->Arg(1 << 20);
+BENCHMARK(BM_RecvFromPeerResponse)->Arg(1 << 12)->Arg(1 << 16)->Arg(1 << 20);
+
 }  // namespace
 }  // namespace tensorflow
@@ -0,0 +1,385 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/recv_buf_shared_memory.h"
+
+#if !defined(PLATFORM_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/host_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Prefix of the names of the segments created here.  Servers only write to
+// segments with this prefix.
+constexpr char kSegmentPrefix[] = "/tf_recvbuf_";
+
+// Default for TF_COLLECTIVE_SHARED_MEMORY_MIN_BYTES.  Smaller values are
+// cheap to send in the response.
+constexpr int64 kDefaultMinBytes = 16 << 10;
+
+// Segment sizes are powers of two of at least this many bytes, so that
+// segments can be reused for values of similar sizes.
+constexpr int64 kMinSegmentBytes = 4 << 10;
+
+// Bytes of idle segments that a client keeps for reuse.
+constexpr int64 kMaxIdleBytes = 256 << 20;
+
+// Number of client segments that a server keeps mapped.
+constexpr int kMaxMappedSegments = 256;
+
+int64 MinSharedMemoryBytes() {
+  static const int64 min_bytes = [] {
+    int64 value;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_COLLECTIVE_SHARED_MEMORY_MIN_BYTES",
+                                    kDefaultMinBytes, &value));
+    return value;
+  }();
+  return min_bytes;
+}
+
+int64 SegmentBytes(int64 num_bytes) {
+  int64 bytes = kMinSegmentBytes;
+  while (bytes < num_bytes) bytes <<= 1;
+  return bytes;
+}
+
+// Idle segments of a client, by peer and size.  They are all unlinked, so
+// the pool leaves nothing behind when the process exits.
+class SegmentPool {
+ public:
+  static SegmentPool* Global() {
+    static SegmentPool* pool = new SegmentPool;
+    return pool;
+  }
+
+  std::unique_ptr<SharedMemorySegment> Acquire(const string& peer_task,
+                                               int64 num_bytes) {
+    const int64 bytes = SegmentBytes(num_bytes);
+    {
+      mutex_lock l(mu_);
+      auto it = idle_.find(std::make_pair(peer_task, bytes));
+      if (it != idle_.end() && !it->second.empty()) {
+        std::unique_ptr<SharedMemorySegment> segment =
+            std::move(it->second.back());
+        it->second.pop_back();
+        idle_bytes_ -= bytes;
+        return segment;
+      }
+    }
+    std::unique_ptr<SharedMemorySegment> segment;
+    Status s = SharedMemorySegment::Create(bytes, &segment);
+    if (!s.ok()) {
+      VLOG(1) << "Sending RecvBuf values in the response: " << s;
+      return nullptr;
+    }
+    return segment;
+  }
+
+  void Release(const string& peer_task,
+               std::unique_ptr<SharedMemorySegment> segment) {
+    segment->Unlink();
+    mutex_lock l(mu_);
+    if (idle_bytes_ + segment->size() > kMaxIdleBytes) {
+      return;
+    }
+    idle_bytes_ += segment->size();
+    idle_[std::make_pair(peer_task, segment->size())].push_back(
+        std::move(segment));
+  }
+
+ private:
+  mutex mu_;
+  absl::flat_hash_map<std::pair<string, int64>,
+                      std::vector<std::unique_ptr<SharedMemorySegment>>>
+      idle_ TF_GUARDED_BY(mu_);
+  int64 idle_bytes_ TF_GUARDED_BY(mu_) = 0;
+};
+
+// Client segments that a server has mapped.  Clients reuse their segments, so
+// these are kept mapped until they are among the oldest kMaxMappedSegments.
+// Segment names are never reused, so a mapping is never stale.
+class MappedSegments {
+ public:
+  static MappedSegments* Global() {
+    static MappedSegments* segments = new MappedSegments;
+    return segments;
+  }
+
+  Status Get(const string& name, int64 num_bytes,
+             std::shared_ptr<SharedMemorySegment>* segment) {
+    {
+      mutex_lock l(mu_);
+      auto it = segments_.find(name);
+      if (it != segments_.end() && it->second->size() >= num_bytes) {
+        *segment = it->second;
+        return Status::OK();
+      }
+    }
+    std::unique_ptr<SharedMemorySegment> opened;
+    TF_RETURN_IF_ERROR(SharedMemorySegment::Open(name, num_bytes, &opened));
+    *segment = std::move(opened);
+    mutex_lock l(mu_);
+    if (segments_.insert_or_assign(name, *segment).second) {
+      order_.push_back(name);
+      if (order_.size() > kMaxMappedSegments) {
+        segments_.erase(order_.front());
+        order_.pop_front();
+      }
+    }
+    return Status::OK();
+  }
+
+ private:
+  mutex mu_;
+  absl::flat_hash_map<string, std::shared_ptr<SharedMemorySegment>> segments_
+      TF_GUARDED_BY(mu_);
+  std::deque<string> order_ TF_GUARDED_BY(mu_);
+};
+
+#if !defined(PLATFORM_WINDOWS)
+
+// Names of the segments created by this process that are still linked.  They
+// are unlinked when the process exits, e.g. while a RecvBuf call is pending.
+class LinkedSegmentNames {
+ public:
+  static LinkedSegmentNames* Global() {
+    static LinkedSegmentNames* names = [] {
+      LinkedSegmentNames* names = new LinkedSegmentNames;
+      atexit([] { Global()->UnlinkAll(); });
+      return names;
+    }();
+    return names;
+  }
+
+  void Add(const string& name) {
+    mutex_lock l(mu_);
+    names_.insert(name);
+  }
+
+  void Unlink(const string& name) {
+    mutex_lock l(mu_);
+    if (names_.erase(name) > 0) {
+      shm_unlink(name.c_str());
+    }
+  }
+
+ private:
+  void UnlinkAll() {
+    mutex_lock l(mu_);
+    for (const string& name : names_) {
+      shm_unlink(name.c_str());
+    }
+    names_.clear();
+  }
+
+  mutex mu_;
+  absl::flat_hash_set<string> names_ TF_GUARDED_BY(mu_);
+};
+
+#endif  // !defined(PLATFORM_WINDOWS)
+
+}  // namespace
+
+SharedMemorySegment::SharedMemorySegment(const string& name, char* data,
+                                         int64 size, bool linked)
+    : name_(name), data_(data), size_(size), linked_(linked) {}
+
+#if defined(PLATFORM_WINDOWS)
+
+Status SharedMemorySegment::Create(
+    int64 num_bytes, std::unique_ptr<SharedMemorySegment>* segment) {
+  return errors::Unimplemented("Shared memory segments are not supported");
+}
+
+Status SharedMemorySegment::Open(
+    const string& name, int64 num_bytes,
+    std::unique_ptr<SharedMemorySegment>* segment) {
+  return errors::Unimplemented("Shared memory segments are not supported");
+}
+
+SharedMemorySegment::~SharedMemorySegment() {}
+
+void SharedMemorySegment::Unlink() {}
+
+#else
+
+Status SharedMemorySegment::Create(
+    int64 num_bytes, std::unique_ptr<SharedMemorySegment>* segment) {
+  // Servers keep segments mapped by name, so names include a random nonce to
+  // never repeat, even across processes that reuse a pid.
+  static const uint64 nonce = random::New64();
+  static std::atomic<int64> next_id(0);
+  const string name = strings::StrCat(kSegmentPrefix, getpid(), "_",
+                                      strings::Hex(nonce), "_", next_id++);
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    return errors::Unavailable("shm_open(", name,
+                               ") failed: ", strerror(errno));
+  }
+  LinkedSegmentNames::Global()->Add(name);
+  // Reserve the pages now, so that running out of shared memory fails here
+  // rather than raising SIGBUS on a later write.
+#if defined(__linux__)
+  int err = posix_fallocate(fd, 0, num_bytes);
+#else
+  int err = ftruncate(fd, num_bytes) == 0 ? 0 : errno;
+#endif
+  void* data = MAP_FAILED;
+  if (err == 0) {
+    data = mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) err = errno;
+  }
+  close(fd);
+  if (err != 0) {
+    LinkedSegmentNames::Global()->Unlink(name);
+    return errors::Unavailable("Allocating ", num_bytes,
+                               " bytes of shared memory for ", name,
+                               " failed: ", strerror(err));
+  }
+  segment->reset(new SharedMemorySegment(name, static_cast<char*>(data),
+                                         num_bytes, /*linked=*/true));
+  return Status::OK();
+}
+
+Status SharedMemorySegment::Open(
+    const string& name, int64 num_bytes,
+    std::unique_ptr<SharedMemorySegment>* segment) {
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return errors::Unavailable("shm_open(", name,
+                               ") failed: ", strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < num_bytes) {
+    close(fd);
+    return errors::InvalidArgument("Shared memory segment ", name,
+                                   " is smaller than ", num_bytes, " bytes");
+  }
+  void* data =
+      mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const int err = errno;
+  close(fd);
+  if (data == MAP_FAILED) {
+    return errors::Unavailable("mmap(", name, ") failed: ", strerror(err));
+  }
+  segment->reset(new SharedMemorySegment(name, static_cast<char*>(data),
+                                         st.st_size, /*linked=*/false));
+  return Status::OK();
+}
+
+SharedMemorySegment::~SharedMemorySegment() {
+  munmap(data_, size_);
+  Unlink();
+}
+
+void SharedMemorySegment::Unlink() {
+  if (linked_) {
+    LinkedSegmentNames::Global()->Unlink(name_);
+    linked_ = false;
+  }
+}
+
+#endif  // defined(PLATFORM_WINDOWS)
+
+const string& SharedMemoryHostId() {
+  static const string* host_id = [] {
+    // The boot id tells apart hosts that have the same hostname.
+    string boot_id;
+    ReadFileToString(Env::Default(), "/proc/sys/kernel/random/boot_id",
+                     &boot_id)
+        .IgnoreError();
+    return new string(strings::StrCat(port::Hostname(), "/",
+                                      absl::StripAsciiWhitespace(boot_id)));
+  }();
+  return *host_id;
+}
+
+std::unique_ptr<SharedMemorySegment> AcquireRecvBufSegment(
+    const string& peer_task, int64 num_bytes) {
+  const int64 min_bytes = MinSharedMemoryBytes();
+  if (min_bytes < 0 || num_bytes < min_bytes || num_bytes == 0) {
+    return nullptr;
+  }
+  return SegmentPool::Global()->Acquire(peer_task, num_bytes);
+}
+
+void ReleaseRecvBufSegment(const string& peer_task,
+                           std::unique_ptr<SharedMemorySegment> segment) {
+  SegmentPool::Global()->Release(peer_task, std::move(segment));
+}
+
+void SetSharedMemoryInRecvBufReq(const SharedMemorySegment& segment,
+                                 RecvBufRequest* request) {
+  RecvBufReqExtra extra;
+  extra.set_host_id(SharedMemoryHostId());
+  extra.set_shm_name(segment.name());
+  request->mutable_transport_options()->PackFrom(extra);
+}
+
+bool SetTensorInRecvBufRespSharedMemory(const RecvBufRequest& request,
+                                        const Tensor& tensor,
+                                        RecvBufResponse* response) {
+  RecvBufReqExtra req_extra;
+  if (!request.has_transport_options() ||
+      !request.transport_options().UnpackTo(&req_extra) ||
+      req_extra.host_id() != SharedMemoryHostId() ||
+      !absl::StartsWith(req_extra.shm_name(), kSegmentPrefix)) {
+    return false;
+  }
+  const int64 num_bytes = tensor.TotalBytes();
+  std::shared_ptr<SharedMemorySegment> segment;
+  Status s = MappedSegments::Global()->Get(req_extra.shm_name(), num_bytes,
+                                           &segment);
+  if (!s.ok()) {
+    VLOG(1) << "Sending RecvBuf value in the response: " << s;
+    return false;
+  }
+  memcpy(segment->data(), DMAHelper::base(&tensor), num_bytes);
+  RecvBufRespExtra extra;
+  extra.set_in_shared_memory(true);
+  response->mutable_transport_options()->PackFrom(extra);
+  response->set_num_bytes(num_bytes);
+  return true;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,110 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RECV_BUF_SHARED_MEMORY_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RECV_BUF_SHARED_MEMORY_H_
+
+#include <memory>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+// Support for passing RecvBuf values between worker processes on the same
+// host through POSIX shared memory.  The client of a RecvBuf call offers a
+// segment in RecvBufRequest.transport_options, and a server on the same host
+// copies the value into the segment instead of into the RecvBufResponse, so
+// that the value is not serialized into the RPC.  Servers on other hosts, or
+// that cannot map the segment, ignore the offer and respond as usual.
+
+namespace tensorflow {
+
+// A POSIX shared-memory segment mapped into this process.
+class SharedMemorySegment {
+ public:
+  // Creates a segment of `num_bytes` bytes with a name unique to this
+  // process.  The segment is unlinked when the returned object is destroyed,
+  // or when the process exits, but stays valid for other processes that have
+  // it mapped.
+  static Status Create(int64 num_bytes,
+                       std::unique_ptr<SharedMemorySegment>* segment);
+
+  // Maps the existing segment `name`, which must have at least `num_bytes`
+  // bytes.
+  static Status Open(const string& name, int64 num_bytes,
+                     std::unique_ptr<SharedMemorySegment>* segment);
+
+  ~SharedMemorySegment();
+
+  // Unlinks a segment created by this process, so that its memory is freed
+  // once no process maps it.  Processes that have it mapped keep using it,
+  // but it can no longer be opened.
+  void Unlink();
+
+  const string& name() const { return name_; }
+  char* data() const { return data_; }
+  int64 size() const { return size_; }
+  // Whether the segment was created by this process and is not unlinked.
+  bool linked() const { return linked_; }
+
+ private:
+  SharedMemorySegment(const string& name, char* data, int64 size, bool linked);
+
+  const string name_;
+  char* const data_;
+  const int64 size_;
+  bool linked_;  // Whether to unlink the segment on destruction.
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedMemorySegment);
+};
+
+// Returns an identifier of this host, made of its hostname and boot id.
+const string& SharedMemoryHostId();
+
+// Returns a segment that can hold a RecvBuf value of `num_bytes` bytes from
+// `peer_task`, or nullptr if the value should be sent in the
+// RecvBufResponse.  That is the case for values of less than
+// TF_COLLECTIVE_SHARED_MEMORY_MIN_BYTES bytes (16KiB by default, a negative
+// value disables shared memory), and when no segment can be created.
+// Segments are reused across calls to the same peer.  A reused segment is
+// unlinked, and only the peer that keeps it mapped can write to it.
+std::unique_ptr<SharedMemorySegment> AcquireRecvBufSegment(
+    const string& peer_task, int64 num_bytes);
+
+// Returns `segment`, into which `peer_task` has written a RecvBuf value, for
+// reuse by AcquireRecvBufSegment() with the same peer, and unlinks it: the
+// peer keeps it mapped, so nothing is left in the shared-memory file system
+// for other processes or after a crash.  Only segments whose RecvBuf call
+// completed successfully may be returned, since the server may otherwise
+// still write to them.
+void ReleaseRecvBufSegment(const string& peer_task,
+                           std::unique_ptr<SharedMemorySegment> segment);
+
+// Offers `segment` to the server of `request` for the value.
+void SetSharedMemoryInRecvBufReq(const SharedMemorySegment& segment,
+                                 RecvBufRequest* request);
+
+// If `request` offers a segment created on this host, copies `tensor` into it,
+// sets `response` to refer to it and returns true.  Otherwise returns false
+// without changing `response`.
+bool SetTensorInRecvBufRespSharedMemory(const RecvBufRequest& request,
+                                        const Tensor& tensor,
+                                        RecvBufResponse* response);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RECV_BUF_SHARED_MEMORY_H_
@@ -0,0 +1,184 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/recv_buf_shared_memory.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kPeerTask[] = "/job:worker/replica:0/task:1";
+
+Tensor MakeValue(int64 num_elements) {
+  Tensor value(DT_FLOAT, TensorShape({num_elements}));
+  auto flat = value.flat<float>();
+  for (int64 i = 0; i < num_elements; ++i) {
+    flat(i) = i;
+  }
+  return value;
+}
+
+TEST(SharedMemorySegmentTest, OpenSharesCreatedSegment) {
+  std::unique_ptr<SharedMemorySegment> created;
+  TF_ASSERT_OK(SharedMemorySegment::Create(4096, &created));
+  EXPECT_EQ(4096, created->size());
+  memset(created->data(), 7, created->size());
+
+  std::unique_ptr<SharedMemorySegment> opened;
+  TF_ASSERT_OK(SharedMemorySegment::Open(created->name(), 4096, &opened));
+  EXPECT_EQ(4096, opened->size());
+  EXPECT_EQ(7, opened->data()[4095]);
+  opened->data()[0] = 3;
+  EXPECT_EQ(3, created->data()[0]);
+
+  EXPECT_FALSE(SharedMemorySegment::Open(created->name(), 8192, &opened).ok());
+  const string name = created->name();
+  created.reset();
+  EXPECT_FALSE(SharedMemorySegment::Open(name, 4096, &opened).ok());
+}
+
+TEST(SharedMemorySegmentTest, NamesAreNotReused) {
+  std::unique_ptr<SharedMemorySegment> first;
+  TF_ASSERT_OK(SharedMemorySegment::Create(4096, &first));
+  const string name = first->name();
+  first.reset();
+  std::unique_ptr<SharedMemorySegment> second;
+  TF_ASSERT_OK(SharedMemorySegment::Create(4096, &second));
+  EXPECT_NE(name, second->name());
+  // Names carry a nonce besides the pid and a counter.
+  EXPECT_EQ(4, std::count(name.begin(), name.end(), '_'));
+}
+
+TEST(SharedMemorySegmentTest, UnlinkKeepsMapping) {
+  std::unique_ptr<SharedMemorySegment> created;
+  TF_ASSERT_OK(SharedMemorySegment::Create(4096, &created));
+  EXPECT_TRUE(created->linked());
+  std::unique_ptr<SharedMemorySegment> opened;
+  TF_ASSERT_OK(SharedMemorySegment::Open(created->name(), 4096, &opened));
+  EXPECT_FALSE(opened->linked());
+
+  created->Unlink();
+  EXPECT_FALSE(created->linked());
+  std::unique_ptr<SharedMemorySegment> reopened;
+  EXPECT_FALSE(
+      SharedMemorySegment::Open(created->name(), 4096, &reopened).ok());
+  opened->data()[0] = 3;
+  EXPECT_EQ(3, created->data()[0]);
+}
+
+TEST(RecvBufSharedMemoryTest, SmallValuesUseResponse) {
+  EXPECT_EQ(nullptr, AcquireRecvBufSegment(kPeerTask, 0));
+  EXPECT_EQ(nullptr, AcquireRecvBufSegment(kPeerTask, 1024));
+}
+
+TEST(RecvBufSharedMemoryTest, ValueInSharedMemory) {
+  const Tensor value = MakeValue(100000);
+  std::unique_ptr<SharedMemorySegment> segment =
+      AcquireRecvBufSegment(kPeerTask, value.TotalBytes());
+  ASSERT_NE(nullptr, segment);
+  EXPECT_TRUE(segment->linked());
+  EXPECT_GE(segment->size(), value.TotalBytes());
+
+  RecvBufRequest request;
+  request.set_num_bytes(value.TotalBytes());
+  SetSharedMemoryInRecvBufReq(*segment, &request);
+  RecvBufResponse response;
+  ASSERT_TRUE(SetTensorInRecvBufRespSharedMemory(request, value, &response));
+
+  RecvBufRespExtra extra;
+  ASSERT_TRUE(response.transport_options().UnpackTo(&extra));
+  EXPECT_TRUE(extra.in_shared_memory());
+  EXPECT_EQ(0, extra.tensor_content_size());
+  EXPECT_EQ(value.TotalBytes(), response.num_bytes());
+  Tensor received(DT_FLOAT, value.shape());
+  memcpy(received.flat<float>().data(), segment->data(), value.TotalBytes());
+  test::ExpectTensorEqual<float>(value, received);
+
+  // The released segment is unlinked, and reused for a value of similar size
+  // from the same peer, which still has it mapped.
+  const string name = segment->name();
+  ReleaseRecvBufSegment(kPeerTask, std::move(segment));
+  std::unique_ptr<SharedMemorySegment> opened;
+  EXPECT_FALSE(SharedMemorySegment::Open(name, 4096, &opened).ok());
+  std::unique_ptr<SharedMemorySegment> other_peer_segment =
+      AcquireRecvBufSegment("/job:worker/replica:0/task:2", value.TotalBytes());
+  ASSERT_NE(nullptr, other_peer_segment);
+  EXPECT_NE(name, other_peer_segment->name());
+  segment = AcquireRecvBufSegment(kPeerTask, value.TotalBytes() - 4);
+  ASSERT_NE(nullptr, segment);
+  EXPECT_EQ(name, segment->name());
+  EXPECT_FALSE(segment->linked());
+
+  const Tensor next_value = MakeValue(99999);
+  request.set_num_bytes(next_value.TotalBytes());
+  SetSharedMemoryInRecvBufReq(*segment, &request);
+  ASSERT_TRUE(
+      SetTensorInRecvBufRespSharedMemory(request, next_value, &response));
+  memcpy(received.flat<float>().data(), segment->data(),
+         next_value.TotalBytes());
+  test::ExpectTensorEqual<float>(
+      next_value, received.Slice(0, next_value.NumElements()));
+}
+
+TEST(RecvBufSharedMemoryTest, IgnoresOtherHosts) {
+  const Tensor value = MakeValue(100000);
+  std::unique_ptr<SharedMemorySegment> segment =
+      AcquireRecvBufSegment(kPeerTask, value.TotalBytes());
+  ASSERT_NE(nullptr, segment);
+  RecvBufRequest request;
+  RecvBufReqExtra extra;
+  extra.set_host_id("some_other_host");
+  extra.set_shm_name(segment->name());
+  request.mutable_transport_options()->PackFrom(extra);
+  RecvBufResponse response;
+  EXPECT_FALSE(SetTensorInRecvBufRespSharedMemory(request, value, &response));
+  EXPECT_FALSE(response.has_transport_options());
+}
+
+TEST(RecvBufSharedMemoryTest, IgnoresUnknownSegments) {
+  const Tensor value = MakeValue(100000);
+  RecvBufRequest request;
+  RecvBufReqExtra extra;
+  extra.set_host_id(SharedMemoryHostId());
+  extra.set_shm_name("/not_a_recvbuf_segment");
+  request.mutable_transport_options()->PackFrom(extra);
+  RecvBufResponse response;
+  EXPECT_FALSE(SetTensorInRecvBufRespSharedMemory(request, value, &response));
+
+  // A request without a segment.
+  EXPECT_FALSE(
+      SetTensorInRecvBufRespSharedMemory(RecvBufRequest(), value, &response));
+  EXPECT_FALSE(response.has_transport_options());
+}
+
+TEST(RecvBufSharedMemoryTest, RejectsValueLargerThanSegment) {
+  std::unique_ptr<SharedMemorySegment> segment =
+      AcquireRecvBufSegment(kPeerTask, 32768);
+  ASSERT_NE(nullptr, segment);
+  const Tensor value = MakeValue(segment->size());  // 4 bytes per element.
+  RecvBufRequest request;
+  SetSharedMemoryInRecvBufReq(*segment, &request);
+  RecvBufResponse response;
+  EXPECT_FALSE(SetTensorInRecvBufRespSharedMemory(request, value, &response));
+}
+
+}  // namespace
+}  // namespace tensorflow
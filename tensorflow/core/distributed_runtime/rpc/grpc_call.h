@@ -16,6 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CALL_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CALL_H_
 
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
 #include "grpcpp/completion_queue.h"
 #include "grpcpp/impl/service_type.h"
 #include "grpcpp/server_builder.h"
@@ -25,6 +30,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/refcount.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
 
@@ -517,6 +523,341 @@ class ServerBidirectionalStreamingCall
   EnqueueFunction enqueue_function_;
 };
 
+// Represents a server-side bidirectional streaming call whose requests are
+// handled concurrently, and whose responses are written as soon as they are
+// ready.
+//
+// ServerBidirectionalStreamingCall reads the next request only after the
+// response to the previous one has been sent, so a request that can only
+// complete once a later request on the same call has run (e.g. two steps of
+// one graph in flight on a worker) would never complete. This call instead
+// keeps reading while earlier requests are being handled, and gives each
+// request its own Exchange. Responses are written in the order in which they
+// become ready, not in request order, so the response message must identify
+// the request it answers.
+//
+// The handler is called for one request at a time, and the next request is
+// read only once it returns, so it must not block. It must then either call
+// SendResponse() or FinishWithoutResponse() exactly once for the exchange,
+// from any thread. A handler may register a cancel callback for an exchange
+// under an id, so that a later request on the same call can cancel it with
+// CancelRequest().
+//
+// Lifetime: each tag owns a reference on the call while it is in the
+// completion queue, and each exchange owns one from the time its request is
+// received until it is finished. The call is finished with an OK status once
+// the client stops sending requests and all responses have been written.
+//
+// Thread-safe.
+template <class Service, class GrpcService, class RequestMessage,
+          class ResponseMessage>
+class ServerPipelinedStreamingCall : public core::RefCounted {
+ public:
+  // Represents the generic signature of a generated
+  // `GrpcService::RequestFoo()` method, where `Foo` is the name of a
+  // bidirectional streaming RPC method.
+  using EnqueueFunction = void (GrpcService::*)(
+      ::grpc::ServerContext*,
+      ::grpc::ServerAsyncReaderWriter<ResponseMessage, RequestMessage>*,
+      ::grpc::CompletionQueue*, ::grpc::ServerCompletionQueue*, void*);
+
+  // One request received on this call, and the response that answers it.
+  class Exchange {
+   public:
+    RequestMessage request;
+    ResponseMessage response;
+
+   private:
+    friend class ServerPipelinedStreamingCall;
+    // Both are guarded by the `mu_` of the call.
+    int64 cancel_id_ = 0;
+    std::function<void()> cancel_callback_;
+  };
+
+  // Represents the generic signature of a `Service::HandleFoo()`
+  // method, where `Foo` is the name of an RPC method.
+  using HandleRequestFunction = void (Service::*)(
+      ServerPipelinedStreamingCall<Service, GrpcService, RequestMessage,
+                                   ResponseMessage>*,
+      Exchange*);
+
+  ~ServerPipelinedStreamingCall() override {
+    VLOG(3) << "Destroying ServerPipelinedStreamingCall " << this;
+  }
+
+  // Writes the response of `exchange` as soon as no other write is
+  // outstanding. `exchange` must not be used afterwards.
+  void SendResponse(Exchange* exchange) {
+    {
+      mutex_lock l(mu_);
+      ClearCancelCallbackLocked(exchange);
+      auto it = handling_.find(exchange);
+      ready_.push_back(std::move(it->second));
+      handling_.erase(it);
+      MaybeWriteLocked();
+    }
+    this->Unref();  // Ref acquired when the request was received.
+  }
+
+  // Drops `exchange` without answering its request, e.g. because the
+  // request only cancelled another one. `exchange` must not be used
+  // afterwards.
+  void FinishWithoutResponse(Exchange* exchange) {
+    {
+      mutex_lock l(mu_);
+      ClearCancelCallbackLocked(exchange);
+      handling_.erase(exchange);
+      MaybeFinishLocked();
+    }
+    this->Unref();  // Ref acquired when the request was received.
+  }
+
+  // Registers `callback` as the function that should be called if and when
+  // the client cancels this call, or cancels `exchange` alone by calling
+  // CancelRequest(`id`), while `exchange` is being handled. `id` must not
+  // be used by any other exchange of this call that is being handled.
+  void SetCancelCallback(Exchange* exchange, int64 id,
+                         std::function<void()> callback) {
+    mutex_lock l(mu_);
+    ClearCancelCallbackLocked(exchange);
+    exchange->cancel_id_ = id;
+    exchange->cancel_callback_ = std::move(callback);
+    cancellable_[id] = exchange;
+  }
+
+  // Clears any cancellation callback that has been registered for `exchange`.
+  void ClearCancelCallback(Exchange* exchange) {
+    mutex_lock l(mu_);
+    ClearCancelCallbackLocked(exchange);
+  }
+
+  // Calls the cancellation callback registered under `id`, if any. The
+  // other exchanges of the call are not affected.
+  void CancelRequest(int64 id) {
+    mutex_lock l(mu_);
+    auto it = cancellable_.find(id);
+    if (it != cancellable_.end()) {
+      it->second->cancel_callback_();
+    }
+  }
+
+  // Enqueues a new request for the given service on the given
+  // completion queue, using the given `enqueue_function`.
+  //
+  // The requests of the call will be handled by the given
+  // `handle_request_function`.
+  static void EnqueueRequest(GrpcService* grpc_service,
+                             ::grpc::ServerCompletionQueue* cq,
+                             EnqueueFunction enqueue_function,
+                             HandleRequestFunction handle_request_function) {
+    auto call = new ServerPipelinedStreamingCall<Service, GrpcService,
+                                                 RequestMessage,
+                                                 ResponseMessage>(
+        handle_request_function, grpc_service, cq, enqueue_function);
+
+    // Ref for grpc; released in Tag callback. Must be requested before the
+    // call is enqueued on the completion queue.
+    call->Ref();
+    call->ctx_.AsyncNotifyWhenDone(&call->cancelled_tag_);
+
+    // Initial ref for call handed to grpc; released in Tag callback.
+    (grpc_service->*enqueue_function)(&call->ctx_, &call->stream_, cq, cq,
+                                      &call->call_open_tag_);
+  }
+
+ private:
+  ServerPipelinedStreamingCall(HandleRequestFunction handle_request_function,
+                               GrpcService* grpc_service,
+                               ::grpc::ServerCompletionQueue* cq,
+                               EnqueueFunction enqueue_function)
+      : handle_request_function_(handle_request_function),
+        stream_(&ctx_),
+        grpc_service_(grpc_service),
+        cq_(cq),
+        enqueue_function_(enqueue_function) {
+    VLOG(3) << "Creating ServerPipelinedStreamingCall " << this;
+  }
+
+  // Associates a tag in a `::grpc::CompletionQueue` with a callback.
+  // An active Tag owns a reference on the corresponding call object.
+  class Tag : public GrpcCallTag<Service> {
+   public:
+    // One enum value per supported callback.
+    enum class TagType {
+      kCallOpen,
+      kRequestReceived,
+      kResponseSent,
+      kServerFinished,
+      kCancelled,
+    };
+
+    Tag(ServerPipelinedStreamingCall* call, TagType cb)
+        : call_(call), callback_(cb) {}
+
+    // Calls the callback associated with this tag and Unrefs this->call_.
+    void OnCompleted(Service* service, bool ok) override {
+      switch (callback_) {
+        case TagType::kCallOpen:
+          // Non-ok value indicates that the server has been shutdown before
+          // we received a message for this call type.
+          if (ok) {
+            call_->CallOpen();
+          }
+          break;
+        case TagType::kRequestReceived:
+          call_->RequestReceived(service, ok);
+          break;
+        case TagType::kResponseSent:
+          call_->ResponseSent(ok);
+          break;
+        case TagType::kServerFinished:
+          // Nothing to do, whether or not the status went on the wire.
+          break;
+        case TagType::kCancelled:
+          call_->CallDone();
+          break;
+      }
+      call_->Unref();  // Ref acquired when tag was handed to grpc.
+    }
+
+   private:
+    ServerPipelinedStreamingCall* const call_;  // `this` owns one reference.
+    TagType callback_;
+  };
+
+  void CallOpen() {
+    // Let gRPC know that we can accept another call.
+    EnqueueRequest(grpc_service_, cq_, enqueue_function_,
+                   handle_request_function_);
+    mutex_lock l(mu_);
+    RequestReadLocked();
+  }
+
+  void RequestReadLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    this->Ref();  // Ref for grpc; released in Tag callback.
+    reading_.reset(new Exchange);
+    stream_.Read(&reading_->request, &request_received_tag_);
+  }
+
+  void RequestReceived(Service* service, bool ok) {
+    Exchange* exchange;
+    {
+      mutex_lock l(mu_);
+      if (!ok) {
+        // The client will not send more requests, e.g. it called WritesDone
+        // or cancelled the call.
+        reading_.reset();
+        reads_done_ = true;
+        MaybeFinishLocked();
+        return;
+      }
+      exchange = reading_.get();
+      handling_.emplace(exchange, std::move(reading_));
+      this->Ref();  // Released when the exchange is finished.
+    }
+    (service->*handle_request_function_)(this, exchange);
+    // Read the next request only once the handler has returned, so that a
+    // request may cancel any request received before it.
+    mutex_lock l(mu_);
+    RequestReadLocked();
+  }
+
+  void ResponseSent(bool ok) {
+    mutex_lock l(mu_);
+    writing_ = false;
+    if (!ok) {
+      // The call is dead (e.g. cancelled, or the client dropped the channel).
+      // The responses that are still being handled are dropped.
+      call_dead_ = true;
+    }
+    MaybeWriteLocked();
+  }
+
+  void CallDone() {
+    if (ctx_.IsCancelled()) {
+      mutex_lock l(mu_);
+      for (const auto& exchange : handling_) {
+        if (exchange.second->cancel_callback_) {
+          exchange.second->cancel_callback_();
+        }
+      }
+    }
+  }
+
+  void ClearCancelCallbackLocked(Exchange* exchange)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (exchange->cancel_callback_) {
+      cancellable_.erase(exchange->cancel_id_);
+      exchange->cancel_callback_ = nullptr;
+    }
+  }
+
+  // Writes the oldest ready response if no other write is outstanding, as
+  // gRPC allows at most one.
+  void MaybeWriteLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    while (!writing_ && !ready_.empty()) {
+      std::unique_ptr<Exchange> exchange = std::move(ready_.front());
+      ready_.pop_front();
+      if (call_dead_) {
+        continue;
+      }
+      writing_ = true;
+      this->Ref();  // Ref for grpc; released in Tag callback.
+      // stream_.Write does not save references to the response, so the
+      // exchange can be deleted as soon as Write returns.
+      stream_.Write(exchange->response, &response_sent_tag_);
+    }
+    MaybeFinishLocked();
+  }
+
+  void MaybeFinishLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (!reads_done_ || writing_ || !handling_.empty() || !ready_.empty() ||
+        finish_issued_) {
+      return;
+    }
+    finish_issued_ = true;
+    if (!call_dead_) {
+      this->Ref();  // Ref for grpc; released in Tag callback.
+      stream_.Finish(::grpc::Status::OK, &server_finished_tag_);
+    }
+  }
+
+  HandleRequestFunction handle_request_function_;
+  ::grpc::ServerContext ctx_;
+  ::grpc::ServerAsyncReaderWriter<ResponseMessage, RequestMessage> stream_;
+
+  mutex mu_;
+  // The exchange whose request is being read.
+  std::unique_ptr<Exchange> reading_ TF_GUARDED_BY(mu_);
+  // Exchanges whose requests are being handled.
+  std::unordered_map<Exchange*, std::unique_ptr<Exchange>> handling_
+      TF_GUARDED_BY(mu_);
+  // Exchanges being handled that have a cancel callback, by cancel id.
+  std::unordered_map<int64, Exchange*> cancellable_ TF_GUARDED_BY(mu_);
+  // Exchanges whose responses are waiting to be written, in the order in
+  // which they became ready.
+  std::deque<std::unique_ptr<Exchange>> ready_ TF_GUARDED_BY(mu_);
+  bool writing_ TF_GUARDED_BY(mu_) = false;
+  bool reads_done_ TF_GUARDED_BY(mu_) = false;
+  bool call_dead_ TF_GUARDED_BY(mu_) = false;
+  bool finish_issued_ TF_GUARDED_BY(mu_) = false;
+
+  // Used as void* completion markers from grpc to indicate different
+  // events of interest for the call. At most one tag of each kind is given
+  // to gRPC at any one time.
+  Tag call_open_tag_{this, Tag::TagType::kCallOpen};
+  Tag request_received_tag_{this, Tag::TagType::kRequestReceived};
+  Tag response_sent_tag_{this, Tag::TagType::kResponseSent};
+  Tag server_finished_tag_{this, Tag::TagType::kServerFinished};
+  Tag cancelled_tag_{this, Tag::TagType::kCancelled};
+
+  // These fields are used only to spawn another instance of this to accept
+  // more streaming calls.
+  GrpcService* grpc_service_;
+  ::grpc::ServerCompletionQueue* cq_;
+  EnqueueFunction enqueue_function_;
+};
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CALL_H_
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_remote_worker.h"
 
+#include <atomic>
 #include <utility>
 
 #include "grpcpp/generic/generic_stub.h"
@@ -35,11 +36,29 @@ limitations under the License.
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/protobuf/transport_options.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
 const int kMaxWorkerRpcRetries = 10;
 
+namespace {
+
+// Returns whether RunGraph requests are sent over one StreamingRunGraph call
+// per remote worker, which the TF_GRPC_WORKER_STREAMING_RUN_GRAPH environment
+// variable enables. The default sends one RunGraph RPC per request.
+bool StreamingRunGraphFromEnv() {
+  static const bool streaming = [] {
+    bool value;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_GRPC_WORKER_STREAMING_RUN_GRAPH",
+                                   /*default_val=*/false, &value));
+    return value;
+  }();
+  return streaming;
+}
+
+}  // namespace
+
 class GrpcRemoteWorker : public WorkerInterface {
  public:
   explicit GrpcRemoteWorker(SharedGrpcChannelPtr channel,
@@ -66,10 +85,14 @@ class GrpcRemoteWorker : public WorkerInterface {
         instancesource_(Method(GrpcWorkerMethod::kCompleteInstance)),
         getstepsequence_(Method(GrpcWorkerMethod::kGetStepSequence)),
         markrecvfinished_(Method(GrpcWorkerMethod::kMarkRecvFinished)),
+        recvtensorbatch_(Method(GrpcWorkerMethod::kRecvTensorBatch)),
+        streaming_rungraph_(StreamingRunGraphFromEnv()),
+        rungraph_dispatcher_(&stub_, cq_,
+                             Method(GrpcWorkerMethod::kStreamingRunGraph)),
         logger_(logger),
         target_(target) {}
 
-  ~GrpcRemoteWorker() override {}
+  ~GrpcRemoteWorker() override { rungraph_dispatcher_.CancelCall(); }
 
   void GetStatusAsync(const GetStatusRequest* request,
                       GetStatusResponse* response, bool fail_fast,
@@ -106,13 +129,19 @@ class GrpcRemoteWorker : public WorkerInterface {
 
   void RunGraphAsync(CallOptions* call_opts, const RunGraphRequest* request,
                      RunGraphResponse* response, StatusCallback done) override {
+    // Responses on the StreamingRunGraph call are matched by request id, so
+    // requests without one are sent as RunGraph RPCs.
+    if (streaming_rungraph_ && request->request_id() != 0) {
+      StreamRunGraph(call_opts, request, response, std::move(done));
+      return;
+    }
     IssueRequest(request, response, rungraph_, std::move(done), call_opts);
   }
   void RunGraphAsync(CallOptions* call_opts, RunGraphRequestWrapper* request,
                      MutableRunGraphResponseWrapper* response,
                      StatusCallback done) override {
-    IssueRequest(&request->ToProto(), get_proto_from_wrapper(response),
-                 rungraph_, std::move(done), call_opts);
+    RunGraphAsync(call_opts, &request->ToProto(),
+                  get_proto_from_wrapper(response), std::move(done));
   }
 
   void CleanupGraphAsync(const CleanupGraphRequest* request,
@@ -255,6 +284,16 @@ class GrpcRemoteWorker : public WorkerInterface {
     IssueRequest(request, response, recvtensor_, callback, call_opts);
   }
 
+  void RecvTensorBatchAsync(CallOptions* call_opts,
+                            const RecvTensorBatchRequest* request,
+                            RecvTensorBatchResponse* response,
+                            StatusCallback done) override {
+    VLOG(1) << "RecvTensorBatchAsync req: " << request->requests_size()
+            << " tensors";
+    IssueRequest(request, response, recvtensorbatch_, std::move(done),
+                 call_opts);
+  }
+
   void LoggingAsync(const LoggingRequest* request, LoggingResponse* response,
                     StatusCallback done) override {
     IssueRequest(request, response, logging_, done);
@@ -266,6 +305,72 @@ class GrpcRemoteWorker : public WorkerInterface {
   }
 
  private:
+  // Sends `request` over the StreamingRunGraph call to this worker, which is
+  // started by the first request and kept open for the following ones. The
+  // worker answers each step as soon as it is done, and the response is
+  // matched to `request` by its request_id. The worker returns the errors of
+  // a step in the response body; unless `request` asks for that too, they are
+  // returned through `done`.
+  //
+  // Cancelling `call_opts` cancels this step alone: `done` is invoked at once
+  // and the worker is told to abort the step, while the other steps in
+  // flight on the call keep running.
+  void StreamRunGraph(CallOptions* call_opts, const RunGraphRequest* request,
+                      RunGraphResponse* response, StatusCallback done) {
+    const int64 request_id = request->request_id();
+    if (call_opts) {
+      call_opts->SetCancelCallback([this, request_id]() {
+        StreamingRunGraphRequest cancel;
+        cancel.set_cancel_request_id(request_id);
+        rungraph_dispatcher_.Cancel(request_id, cancel);
+      });
+    }
+    // Wrap `request` without copying it; it is serialized before
+    // SendRequest() returns.
+    StreamingRunGraphRequest streaming_request;
+    streaming_request.set_allocated_run_graph(
+        const_cast<RunGraphRequest*>(request));
+    rungraph_dispatcher_.SendRequest(
+        request_id, streaming_request, response,
+        [this, call_opts, request, response,
+         done = std::move(done)](const Status& s) mutable {
+          // This runs on the completion queue thread, or within
+          // CallOptions::StartCancel() when the step is cancelled, where
+          // the cancel callback cannot be cleared.
+          auto fn = [this, call_opts, request, response, s,
+                     done = std::move(done)]() mutable {
+            if (call_opts) {
+              call_opts->ClearCancelCallback();
+            }
+            if (errors::IsUnimplemented(s)) {
+              // The worker predates StreamingRunGraph. Nothing has run, so
+              // send this and all later requests as RunGraph RPCs.
+              LOG_FIRST_N(INFO, 1) << "Worker " << target_
+                                   << " does not support StreamingRunGraph";
+              streaming_rungraph_ = false;
+              IssueRequest(request, response, rungraph_, std::move(done),
+                           call_opts);
+              return;
+            }
+            Status status = s;
+            if (status.ok() && !request->store_errors_in_response_body() &&
+                response->status_code() != error::OK) {
+              status = Status(response->status_code(),
+                              response->status_error_message());
+              response->clear_status_code();
+              response->clear_status_error_message();
+            }
+            done(status);
+          };
+          if (callback_threadpool_) {
+            callback_threadpool_->Schedule(std::move(fn));
+          } else {
+            Env::Default()->SchedClosure(std::move(fn));
+          }
+        });
+    streaming_request.release_run_graph();
+  }
+
   // Utility method for issuing a generic asynchronous request. The
   // given callback, `done`, will be called when the RPC completes.
   void IssueRequest(const protobuf::Message* request,
@@ -320,6 +425,11 @@ class GrpcRemoteWorker : public WorkerInterface {
   const ::grpc::string instancesource_;
   const ::grpc::string getstepsequence_;
   const ::grpc::string markrecvfinished_;
+  const ::grpc::string recvtensorbatch_;
+
+  // Whether RunGraph requests are sent over `rungraph_dispatcher_`.
+  std::atomic<bool> streaming_rungraph_;
+  UnorderedStreamingRPCDispatcher<RunGraphResponse> rungraph_dispatcher_;
 
   // Support for logging.
   WorkerCacheLogger* logger_;
@@ -22,12 +22,18 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/graph/default_device.h"
 #include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/init_main.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/notification.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/error_codes.pb.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/util/port.h"
@@ -525,6 +531,218 @@ TEST(GrpcSessionTest, LargeTensorSend) {
   TF_CHECK_OK(session->Close());
 }
 
+// Builds a graph whose fetches are computed on the second task of the
+// cluster: "small" (1 float), "large" (64K floats) and, if `error` is set, a
+// node that fails with "fantasia!".
+static void CreateRemoteFetchGraph(const test::TestCluster& cluster,
+                                   bool error, GraphDef* gdef,
+                                   std::vector<string>* fetches) {
+  const string& dev_a = cluster.devices()[0].name();
+  const string& dev_b = cluster.devices()[1].name();
+  Graph g(OpRegistry::Global());
+  Tensor one(DT_FLOAT, TensorShape({}));
+  one.scalar<float>()() = 1.0;
+  Node* a = test::graph::Constant(&g, one);
+  a->set_assigned_device_name(dev_a);
+  Node* small = test::graph::Add(&g, a, a);
+  small->set_assigned_device_name(dev_b);
+  fetches->push_back(small->name());
+
+  Tensor values(DT_FLOAT, TensorShape({1 << 16}));
+  values.flat<float>().setConstant(2.0);
+  Node* b = test::graph::Constant(&g, values);
+  b->set_assigned_device_name(dev_b);
+  Node* large = test::graph::Add(&g, b, small);
+  large->set_assigned_device_name(dev_b);
+  fetches->push_back(large->name());
+
+  if (error) {
+    Node* err = test::graph::Error(&g, a, "fantasia!");
+    err->set_assigned_device_name(dev_b);
+    fetches->push_back(err->name());
+  }
+  test::graph::ToGraphDef(&g, gdef);
+}
+
+TEST(GrpcSessionTest, StreamingRunGraph) {
+  // Read by the master of the test cluster, which runs in another process.
+  setenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH", "true", 1);
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+  unsetenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH");
+
+  GraphDef gdef;
+  std::vector<string> fetches;
+  CreateRemoteFetchGraph(*cluster, /*error=*/false, &gdef, &fetches);
+  std::unique_ptr<Session> session(
+      NewRemote(Options(cluster->targets()[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(gdef));
+
+  // Steps in flight at the same time share the call to the second task.
+  thread::ThreadPool pool(Env::Default(), "steps", 4);
+  BlockingCounter steps(16);
+  for (int i = 0; i < 16; ++i) {
+    pool.Schedule([&session, &fetches, &steps]() {
+      std::vector<Tensor> outputs;
+      TF_EXPECT_OK(session->Run({}, fetches, {}, &outputs));
+      EXPECT_EQ(2, outputs.size());
+      if (outputs.size() == 2) {
+        IsSingleFloatValue(outputs[0], 2.0);
+        EXPECT_EQ(outputs[1].NumElements(), 1 << 16);
+        EXPECT_EQ(outputs[1].flat<float>()(0), 4.0);
+        EXPECT_EQ(outputs[1].flat<float>()((1 << 16) - 1), 4.0);
+      }
+      steps.DecrementCount();
+    });
+  }
+  steps.Wait();
+  TF_CHECK_OK(session->Close());
+}
+
+TEST(GrpcSessionTest, StreamingRunGraphError) {
+  setenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH", "true", 1);
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+  unsetenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH");
+
+  GraphDef gdef;
+  std::vector<string> fetches;
+  CreateRemoteFetchGraph(*cluster, /*error=*/true, &gdef, &fetches);
+  std::unique_ptr<Session> session(
+      NewRemote(Options(cluster->targets()[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(gdef));
+  for (int i = 0; i < 2; ++i) {
+    Status status = session->Run({}, fetches, {}, nullptr);
+    EXPECT_FALSE(status.ok());
+    EXPECT_NE(status.ToString().find("fantasia!"), string::npos) << status;
+  }
+
+  // A failed step leaves the call usable for the next ones.
+  std::vector<Tensor> outputs;
+  fetches.pop_back();
+  TF_CHECK_OK(session->Run({}, fetches, {}, &outputs));
+  ASSERT_EQ(2, outputs.size());
+  IsSingleFloatValue(outputs[0], 2.0);
+  TF_CHECK_OK(session->Close());
+}
+
+// A step whose response is ready must not wait for an earlier step on the
+// same call: here the dequeue of two elements only completes once the second
+// enqueue runs, which is only issued after the first one has returned.
+TEST(GrpcSessionTest, StreamingRunGraphOutOfOrder) {
+  setenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH", "true", 1);
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+  unsetenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH");
+
+  const string& dev_b = cluster->devices()[1].name();
+  Graph g(OpRegistry::Global());
+  Node* queue;
+  TF_CHECK_OK(NodeBuilder(g.NewName("queue"), "FIFOQueueV2")
+                  .Attr("component_types", {DT_FLOAT})
+                  .Finalize(&g, &queue));
+  queue->set_assigned_device_name(dev_b);
+  Tensor one(DT_FLOAT, TensorShape({}));
+  one.scalar<float>()() = 1.0;
+  Node* value = test::graph::Constant(&g, one);
+  value->set_assigned_device_name(dev_b);
+  Node* enqueue;
+  TF_CHECK_OK(NodeBuilder(g.NewName("enqueue"), "QueueEnqueueV2")
+                  .Input(queue)
+                  .Input({NodeBuilder::NodeOut(value)})
+                  .Finalize(&g, &enqueue));
+  enqueue->set_assigned_device_name(dev_b);
+  Node* num_elements = test::graph::Constant(&g, test::AsScalar<int32>(2));
+  num_elements->set_assigned_device_name(dev_b);
+  Node* dequeue;
+  TF_CHECK_OK(NodeBuilder(g.NewName("dequeue"), "QueueDequeueManyV2")
+                  .Input(queue)
+                  .Input(num_elements)
+                  .Attr("component_types", {DT_FLOAT})
+                  .Finalize(&g, &dequeue));
+  dequeue->set_assigned_device_name(dev_b);
+  GraphDef gdef;
+  test::graph::ToGraphDef(&g, &gdef);
+
+  std::unique_ptr<Session> session(
+      NewRemote(Options(cluster->targets()[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(gdef));
+
+  thread::ThreadPool pool(Env::Default(), "steps", 1);
+  Notification dequeued;
+  pool.Schedule([&session, dequeue, &dequeued]() {
+    std::vector<Tensor> outputs;
+    TF_EXPECT_OK(session->Run({}, {dequeue->name()}, {}, &outputs));
+    EXPECT_EQ(1, outputs.size());
+    if (outputs.size() == 1) {
+      EXPECT_EQ(outputs[0].NumElements(), 2);
+    }
+    dequeued.Notify();
+  });
+  // Give the dequeue time to reach the worker first.
+  Env::Default()->SleepForMicroseconds(100000);
+  TF_CHECK_OK(session->Run({}, {}, {enqueue->name()}, nullptr));
+  TF_CHECK_OK(session->Run({}, {}, {enqueue->name()}, nullptr));
+  dequeued.WaitForNotification();
+  TF_CHECK_OK(session->Close());
+}
+
+// When one partition of a step fails, the master cancels the others; that
+// cancels the failed step alone, and the other steps in flight on the same
+// call complete.
+TEST(GrpcSessionTest, StreamingRunGraphCancelOneStep) {
+  setenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH", "true", 1);
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+  unsetenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH");
+
+  const string& dev_a = cluster->devices()[0].name();
+  const string& dev_b = cluster->devices()[1].name();
+  Graph g(OpRegistry::Global());
+  Tensor one(DT_FLOAT, TensorShape({}));
+  one.scalar<float>()() = 1.0;
+  Node* a = test::graph::Constant(&g, one);
+  a->set_assigned_device_name(dev_a);
+  Node* err = test::graph::Error(&g, a, "fantasia!");
+  err->set_assigned_device_name(dev_a);
+  Node* b = test::graph::Constant(&g, one);
+  b->set_assigned_device_name(dev_b);
+  Node* short_delay = test::graph::Delay(&g, b, Microseconds(1000000));
+  short_delay->set_assigned_device_name(dev_b);
+  Node* long_delay = test::graph::Delay(&g, b, Microseconds(3000000));
+  long_delay->set_assigned_device_name(dev_b);
+  GraphDef gdef;
+  test::graph::ToGraphDef(&g, &gdef);
+
+  std::unique_ptr<Session> session(
+      NewRemote(Options(cluster->targets()[0], 1)));
+  ASSERT_TRUE(session != nullptr);
+  TF_CHECK_OK(session->Create(gdef));
+
+  thread::ThreadPool pool(Env::Default(), "steps", 1);
+  Notification done;
+  pool.Schedule([&session, short_delay, &done]() {
+    std::vector<Tensor> outputs;
+    TF_EXPECT_OK(session->Run({}, {short_delay->name()}, {}, &outputs));
+    EXPECT_EQ(1, outputs.size());
+    if (outputs.size() == 1) {
+      IsSingleFloatValue(outputs[0], 1.0);
+    }
+    done.Notify();
+  });
+  // Give the first step time to reach the worker.
+  Env::Default()->SleepForMicroseconds(100000);
+  Status status =
+      session->Run({}, {err->name(), long_delay->name()}, {}, nullptr);
+  EXPECT_FALSE(status.ok());
+  EXPECT_NE(status.ToString().find("fantasia!"), string::npos) << status;
+  done.WaitForNotification();
+  TF_CHECK_OK(session->Close());
+}
+
 TEST(GrpcSessionTest, MultiDevices_String) {
   std::unique_ptr<test::TestCluster> cluster;
   TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 1), 2, &cluster));
@@ -1531,4 +1749,33 @@ TEST(GrpcSessionTest, ErrorAggregationThreeWorkerRaceVariant2) {
   Env::Default()->SleepForMicroseconds(2000000);
 }
 
+// Runs steps that fetch a small and a 256KB tensor from another task, with
+// one RunGraph RPC per step (0) or over a StreamingRunGraph call (1).
+static void BM_RemoteFetch(int iters, int streaming) {
+  testing::StopTiming();
+  setenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH", streaming ? "true" : "false",
+         1);
+  std::unique_ptr<test::TestCluster> cluster;
+  TF_CHECK_OK(test::TestCluster::MakeTestCluster(Devices(1, 0), 2, &cluster));
+  unsetenv("TF_GRPC_WORKER_STREAMING_RUN_GRAPH");
+
+  GraphDef gdef;
+  std::vector<string> fetches;
+  CreateRemoteFetchGraph(*cluster, /*error=*/false, &gdef, &fetches);
+  std::unique_ptr<Session> session(
+      NewRemote(Options(cluster->targets()[0], 1)));
+  TF_CHECK_OK(session->Create(gdef));
+  std::vector<Tensor> outputs;
+  // Warm up, which also starts the streaming call.
+  TF_CHECK_OK(session->Run({}, fetches, {}, &outputs));
+
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(session->Run({}, fetches, {}, &outputs));
+  }
+  testing::StopTiming();
+  TF_CHECK_OK(session->Close());
+}
+BENCHMARK(BM_RemoteFetch)->Arg(0)->Arg(1);
+
 }  // namespace tensorflow
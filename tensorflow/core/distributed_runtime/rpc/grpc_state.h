@@ -16,7 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_STATE_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_STATE_H_
 
+#include <deque>
 #include <queue>
+#include <unordered_map>
 #include <utility>
 
 #include "grpcpp/generic/generic_stub.h"
@@ -698,6 +700,361 @@ class StreamingRPCDispatcher {
   core::RefCountPtr<StreamingRPCState<Response>> state_ TF_GUARDED_BY(mu_);
 };
 
+// Represents state associated with one streaming RPC call whose responses may
+// arrive in any order. Unlike StreamingRPCState, which matches each response
+// to the oldest outstanding request, each request is given a non-zero id
+// that the server copies into its response as `request_id`, and responses are
+// matched by it. This lets the server answer a request as soon as it is done,
+// so that a request that waits on a later one does not block it.
+//
+// A single request can be cancelled without affecting the others: its `done`
+// callback is invoked immediately, and a cancel message is sent to the server
+// so that it can stop the work. A late response to it is dropped.
+//
+// Thread-safe.
+template <class Response>
+class UnorderedStreamingRPCState : public UntypedStreamingRPCState {
+ public:
+  UnorderedStreamingRPCState(
+      std::unique_ptr<grpc::GenericClientAsyncReaderWriter> call,
+      const std::shared_ptr<::grpc::ClientContext>& context)
+      : context_(context), call_(std::move(call)), call_state_(State::kActive) {
+    Ref();
+    VLOG(3) << "Created new UnorderedStreamingRPCState " << this;
+    call_->StartCall(&call_started_tag_);
+  }
+
+  ~UnorderedStreamingRPCState() override {
+    VLOG(3) << "Destructing UnorderedStreamingRPCState " << this;
+  }
+
+  // Attempts to send `request`, whose id is `id`. `done` is invoked when
+  // `response` has been filled with the data from the server, or if there is
+  // an error. `done` can be invoked before SendRequest returns. Returns
+  // `true` if the call is alive and the `done` callback has or will be
+  // invoked. If the call is dead, returns `false`, and `done` is not invoked.
+  bool SendRequest(int64 id, const protobuf::Message& request,
+                   Response* response, StatusCallback done) {
+    ::grpc::ByteBuffer request_buf;
+    ::grpc::Status s = GrpcMaybeUnparseProto(request, &request_buf);
+    if (!s.ok()) {
+      Status status = FromGrpcStatus(s);
+      LOG(ERROR) << "GrpcMaybeUnparseProto returned with non-ok status: "
+                 << status.ToString();
+      done(status);
+      return true;
+    }
+
+    mutex_lock l(mu_);
+    if (call_state_ != State::kActive) {
+      // `done` is not invoked intentionally.
+      return false;
+    }
+    pending_[id] = {response, std::move(done)};
+    writes_.push_back(std::move(request_buf));
+    MaybeIssueRequestWriteLocked();
+    return true;
+  }
+
+  // If the request with id `id` is still waiting for its response, invokes
+  // its `done` callback with a CANCELLED status and sends `cancel_request`
+  // to the server. Does nothing otherwise.
+  void Cancel(int64 id, const protobuf::Message& cancel_request) {
+    StatusCallback done;
+    {
+      mutex_lock l(mu_);
+      auto it = pending_.find(id);
+      if (it == pending_.end()) {
+        return;
+      }
+      done = std::move(it->second.done);
+      pending_.erase(it);
+      ::grpc::ByteBuffer request_buf;
+      if (call_state_ == State::kActive &&
+          GrpcMaybeUnparseProto(cancel_request, &request_buf).ok()) {
+        writes_.push_back(std::move(request_buf));
+        MaybeIssueRequestWriteLocked();
+      }
+    }
+    done(errors::Cancelled("RPC Request was cancelled"));
+  }
+
+  void CallStarted(bool ok) override {
+    VLOG(3) << "UnorderedStreamingRPCState(" << this
+            << ")::CallStarted(ok=" << ok << ")";
+    mu_.lock();
+    if (!ok) {
+      // unlocks mu_
+      MarkDoneAndCompletePending(
+          errors::Unavailable("Failed to start the streaming call"));
+      return;
+    }
+    call_started_ = true;
+    // A read is outstanding for as long as the call is active, since any
+    // request may be answered next.
+    IssueResponseReadLocked();
+    MaybeIssueRequestWriteLocked();
+    mu_.unlock();
+  }
+
+  void RequestWriteCompleted(bool ok) override {
+    VLOG(3) << "UnorderedStreamingRPCState(" << this
+            << ")::RequestWriteCompleted(ok=" << ok << ")";
+    mutex_lock l(mu_);
+    writing_ = false;
+    if (call_state_ != State::kActive) {
+      return;
+    }
+    writes_.pop_front();
+    // If the write failed, so will the outstanding read, which finishes the
+    // call.
+    if (ok) {
+      MaybeIssueRequestWriteLocked();
+    }
+  }
+
+  void ResponseReadCompleted(bool ok) override {
+    VLOG(3) << "UnorderedStreamingRPCState(" << this
+            << ")::ResponseReadCompleted(ok=" << ok << ")";
+    ::grpc::ByteBuffer response_buf;
+    {
+      mutex_lock l(mu_);
+      if (call_state_ != State::kActive) {
+        return;
+      }
+      if (!ok) {
+        IssueCallFinishLocked();
+        return;
+      }
+      response_buf.Swap(&response_buf_);
+      IssueResponseReadLocked();
+    }
+
+    Response response;
+    if (!GrpcMaybeParseProto(&response_buf, &response)) {
+      // The request that this answers is unknown, so fail them all.
+      LOG(ERROR) << "Could not parse streaming rpc response";
+      context_->TryCancel();
+      return;
+    }
+    Pending pending;
+    {
+      mutex_lock l(mu_);
+      auto it = pending_.find(response.request_id());
+      if (it == pending_.end()) {
+        // The request has been cancelled.
+        return;
+      }
+      pending = std::move(it->second);
+      pending_.erase(it);
+    }
+    // Invoke the callback without holding the lock because user's callback
+    // can call back into this RPC code resulting in a deadlock.
+    pending.response->Swap(&response);
+    pending.done(Status::OK());
+  }
+
+  void CallFinished(bool ok) override {
+    VLOG(3) << "UnorderedStreamingRPCState(" << this
+            << ")::CallFinished(ok=" << ok << ")";
+    mu_.lock();
+    DCHECK(call_state_ != State::kActive);
+    if (call_state_ != State::kFinishing) {
+      mu_.unlock();
+      return;
+    }
+
+    Status s = FromGrpcStatus(call_status_);
+    if (s.ok() && !ok) {
+      s.Update(
+          errors::Internal("GRPC status is okay but CompletionQueueStatus is "
+                           "not.  This should never happen.",
+                           context_->debug_error_string()));
+    }
+    if (s.ok()) {
+      // The server does not end the call before answering every request.
+      s = errors::Internal("Streaming call ended without a response");
+    }
+    // unlocks mu_
+    MarkDoneAndCompletePending(s);
+  }
+
+  string DebugString() const override {
+    mutex_lock l(mu_);
+    return strings::StrCat("pending requests: ", pending_.size(),
+                           ", queued writes: ", writes_.size());
+  }
+
+ private:
+  enum class State {
+    kActive,
+    kFinishing,
+    kDone,
+  };
+
+  // A request waiting for its response.
+  struct Pending {
+    Response* response = nullptr;
+    StatusCallback done;
+  };
+
+  void MarkDoneAndCompletePending(Status status)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) TF_UNLOCK_FUNCTION(mu_) {
+    call_state_ = State::kDone;
+    VLOG(2) << "Ending gRPC streaming call on the client side due to "
+            << status.ToString();
+    std::unordered_map<int64, Pending> pending;
+    pending_.swap(pending);
+    mu_.unlock();
+    for (auto& p : pending) {
+      p.second.done(status);
+    }
+  }
+
+  void MaybeIssueRequestWriteLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (!call_started_ || writing_ || writes_.empty()) {
+      return;
+    }
+    writing_ = true;
+    Ref();
+    VLOG(3) << "UnorderedStreamingRPCState(" << this << ") calling grpc::Write";
+    call_->Write(writes_.front(), &request_write_completed_tag_);
+  }
+
+  void IssueResponseReadLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    Ref();
+    VLOG(3) << "UnorderedStreamingRPCState(" << this << ") calling grpc::Read";
+    call_->Read(&response_buf_, &response_read_completed_tag_);
+  }
+
+  void IssueCallFinishLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    call_state_ = State::kFinishing;
+    Ref();
+    VLOG(3) << "UnorderedStreamingRPCState(" << this
+            << ") calling grpc::Finish";
+    call_->Finish(&call_status_, &finished_tag_);
+  }
+
+  typedef typename UntypedStreamingRPCState::Tag Tag;
+
+  // Order of context_ and call_ is important because context_ must outlive
+  // call_.
+  const std::shared_ptr<::grpc::ClientContext> context_;
+  std::unique_ptr<grpc::GenericClientAsyncReaderWriter> call_;
+
+  mutable mutex mu_;
+  // Requests waiting for their responses, by id.
+  std::unordered_map<int64, Pending> pending_ TF_GUARDED_BY(mu_);
+  // Messages to write, in order. The front one is being written if
+  // `writing_` is true.
+  std::deque<::grpc::ByteBuffer> writes_ TF_GUARDED_BY(mu_);
+  ::grpc::ByteBuffer response_buf_ TF_GUARDED_BY(mu_);
+  bool call_started_ TF_GUARDED_BY(mu_) = false;
+  bool writing_ TF_GUARDED_BY(mu_) = false;
+  State call_state_ TF_GUARDED_BY(mu_);
+  ::grpc::Status call_status_ TF_GUARDED_BY(mu_);
+
+  // At most one Read and one Write are outstanding at any one time.
+  Tag call_started_tag_{this, Tag::TagType::kCallStarted};
+  Tag request_write_completed_tag_{this, Tag::TagType::kRequestWriteCompleted};
+  Tag response_read_completed_tag_{this, Tag::TagType::kResponseReadCompleted};
+  Tag finished_tag_{this, Tag::TagType::kCallFinished};
+};
+
+// Creates streaming calls whose responses may arrive in any order, and
+// dispatches requests to them. Like StreamingRPCDispatcher, a call is started
+// by the first request, and a new one replaces it once it has failed.
+//
+// Thread-safe.
+template <class Response>
+class UnorderedStreamingRPCDispatcher {
+ public:
+  UnorderedStreamingRPCDispatcher(::grpc::GenericStub* stub,
+                                  ::grpc::CompletionQueue* cq,
+                                  const ::grpc::string& method)
+      : stub_(stub), cq_(cq), method_(method) {}
+
+  // Sends `request`, whose id is `id`, on the active streaming call, starting
+  // one if there is none. `done` is invoked when `response` has been filled
+  // with the data from the server, or if there is an error. `done` can be
+  // invoked before SendRequest returns.
+  void SendRequest(int64 id, const protobuf::Message& request,
+                   Response* response, StatusCallback done) {
+    mutex_lock l(mu_);
+    if (state_ == nullptr) {
+      CreateStreamingState();
+    }
+
+    bool is_call_alive = state_->SendRequest(id, request, response, done);
+    if (is_call_alive) {
+      return;
+    }
+
+    // The attempt to send failed because the call was dead, create a new
+    // call and try again. When the call is dead SendRequest does not call
+    // `done`.
+    CreateStreamingState();
+
+    is_call_alive = state_->SendRequest(id, request, response, done);
+    if (!is_call_alive) {
+      done(errors::Unknown("gRPC call failed right after it was created"));
+    }
+  }
+
+  // Cancels the request with id `id` alone, if it is still waiting for its
+  // response on the active call. Non-blocking.
+  void Cancel(int64 id, const protobuf::Message& cancel_request) {
+    core::RefCountPtr<UnorderedStreamingRPCState<Response>> state;
+    {
+      mutex_lock l(mu_);
+      if (state_ == nullptr) {
+        return;
+      }
+      state_->Ref();
+      state.reset(state_.get());
+    }
+    state->Cancel(id, cancel_request);
+  }
+
+  // Request to cancel the current streaming call. Non-blocking.
+  void CancelCall() {
+    mutex_lock l(mu_);
+    if (state_ == nullptr) {
+      return;
+    }
+    context_->TryCancel();
+    state_ = nullptr;
+  }
+
+ private:
+  void CreateStreamingState() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    // ClientContext cannot be reused across calls.
+    context_ = std::make_shared<::grpc::ClientContext>();
+    // Don't immediately fail StartCall if the channel is not ready. Wait for
+    // the channel to become ready.
+    context_->set_wait_for_ready(true);
+
+    std::unique_ptr<grpc::GenericClientAsyncReaderWriter> call =
+        stub_->PrepareCall(context_.get(), method_, cq_);
+
+    state_.reset(
+        new UnorderedStreamingRPCState<Response>(std::move(call), context_));
+  }
+
+  mutable mutex mu_;
+
+  // Both are thread-safe
+  ::grpc::GenericStub* const stub_;
+  ::grpc::CompletionQueue* const cq_;
+
+  // Does not need synchronization since it is constant.
+  const ::grpc::string method_;
+
+  std::shared_ptr<::grpc::ClientContext> context_ TF_GUARDED_BY(mu_);
+  core::RefCountPtr<UnorderedStreamingRPCState<Response>> state_
+      TF_GUARDED_BY(mu_);
+};
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_STATE_H_
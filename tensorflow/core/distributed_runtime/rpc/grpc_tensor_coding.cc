@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 
+#include <utility>
+#include <vector>
+
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
 #include "absl/flags/flag.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_reference.h"
@@ -26,6 +30,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/io/proto_encode_helper.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/named_tensor.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 // (Omitted internal-only flag)
@@ -138,6 +143,7 @@ static void EncodeSkeleton(const Tensor& val, io::ProtoEncodeHelper* e) {
 }
 
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
+                              RecvTensorCompression compression,
                               ::grpc::ByteBuffer* result) {
   const int kLargeTensorBytes = 1024;
   RecvTensorResponse response;
@@ -161,7 +167,17 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
     io::ProtoEncodeHelper e_skeleton(skeleton.data(), skeleton.size());
     EncodeSkeleton(val, &e_skeleton);
 
+    // If the receiver accepts a compression for this dtype, "tdata" is the
+    // compressed representation of the tensor data, which the receiver
+    // decodes according to "RecvTensorResponse::compression".
     StringPiece tdata = val.tensor_data();
+    string compressed;
+    const RecvTensorCompression applied_compression =
+        CompressTensorContent(val, compression, &compressed);
+    if (applied_compression != RECV_TENSOR_COMPRESSION_NONE) {
+      response.set_compression(applied_compression);
+      tdata = compressed;
+    }
     uint32 overall_tensor_proto_bytesize =
         (e_skeleton.size() +
          VarLengthEncodingSize(TensorProto::kTensorContentFieldNumber,
@@ -182,8 +198,10 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
     // backing store, with appropriate reference counts to keep the
     // backing store alive as needed.
     //
-    // We enable this behavior if the tensor is large.
-    bool share_tensor_slice_memory = (tdata.size() > kLargeTensorBytes);
+    // We enable this behavior if the tensor is large and was not compressed.
+    bool share_tensor_slice_memory =
+        (applied_compression == RECV_TENSOR_COMPRESSION_NONE &&
+         tdata.size() > kLargeTensorBytes);
 
     // (Omitted internal-only conditional)
 
@@ -245,5 +263,126 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
   }
 }
 
+// The recvs of "response" with small or non-memcpy-able tensors are added to
+// a RunGraphResponse that holds all its other fields, and are encoded by the
+// generated code into the first grpc::Slice. Each recv with a large tensor is
+// hand-encoded as a NamedTensorProto after that, using the same scheme as
+// EncodeTensorToByteBuffer():
+//
+// B1:  <tag encoding for RunGraphResponse::recv>
+// B2:  <varint32 length of the NamedTensorProto sub message>
+// C1:  <tag encoding, length and data of NamedTensorProto::name>
+// C2:  <tag encoding and varint32 length of NamedTensorProto::tensor>
+// C3:  <protocol buffer encoding of the tensor except for tensor_content>
+// D1:  <tag encoding for TensorProto::tensor_content>
+// D2:  <varint32 length of the tensor data>
+// E:   <actual data for the tensor, in a grpc::Slice that shares the backing
+//       store of the tensor>
+void EncodeRunGraphResponseToByteBuffer(
+    MutableRunGraphResponseWrapper* response, int64 request_id,
+    ::grpc::ByteBuffer* result) {
+  const int kLargeTensorBytes = 1024;
+  RunGraphResponse proto;
+  proto.set_request_id(request_id);
+  if (response->mutable_step_stats()->dev_stats_size() > 0) {
+    proto.mutable_step_stats()->Swap(response->mutable_step_stats());
+  }
+  if (response->mutable_cost_graph()->node_size() > 0) {
+    proto.mutable_cost_graph()->Swap(response->mutable_cost_graph());
+  }
+  for (size_t i = 0; i < response->num_partition_graphs(); ++i) {
+    proto.add_partition_graph()->Swap(response->mutable_partition_graph(i));
+  }
+  if (response->status_code() != error::OK) {
+    proto.set_status_code(response->status_code());
+    proto.set_status_error_message(response->status_error_message());
+  }
+
+  std::vector<std::pair<const string*, Tensor>> large_recvs;
+  for (size_t i = 0; i < response->num_recvs(); ++i) {
+    Tensor val;
+    Status s = response->RecvValue(i, &val);
+    if (!s.ok()) {
+      proto.set_status_code(s.code());
+      proto.set_status_error_message(s.error_message());
+      break;
+    }
+    if (DataTypeCanUseMemcpy(val.dtype()) &&
+        val.TotalBytes() > kLargeTensorBytes) {
+      large_recvs.emplace_back(&response->recv_key(i), std::move(val));
+    } else {
+      NamedTensorProto* recv = proto.add_recv();
+      recv->set_name(response->recv_key(i));
+      val.AsProtoTensorContent(recv->mutable_tensor());
+    }
+  }
+
+  std::vector<::grpc::Slice> slices;
+  slices.reserve(1 + 2 * large_recvs.size());
+  {
+    ::grpc::Slice slice(proto.ByteSizeLong());
+    proto.SerializeWithCachedSizesToArray(
+        const_cast<uint8*>(reinterpret_cast<const uint8*>(slice.begin())));
+    slices.push_back(std::move(slice));
+  }
+  for (const auto& recv : large_recvs) {
+    const string& name = *recv.first;
+    const Tensor& val = recv.second;
+    const StringPiece tdata = val.tensor_data();
+
+    gtl::InlinedVector<char, 128> skeleton(SkeletonEncodingSizeUpperBound(val));
+    io::ProtoEncodeHelper e_skeleton(skeleton.data(), skeleton.size());
+    EncodeSkeleton(val, &e_skeleton);
+
+    const uint32 tensor_proto_bytes =
+        e_skeleton.size() +
+        VarLengthEncodingSize(TensorProto::kTensorContentFieldNumber,
+                              tdata.size());
+    const uint32 named_tensor_proto_bytes =
+        VarLengthEncodingSize(NamedTensorProto::kNameFieldNumber,
+                              name.size()) +
+        VarLengthEncodingSize(NamedTensorProto::kTensorFieldNumber,
+                              tensor_proto_bytes);
+    const size_t encoder_size =
+        VarLengthEncodingSize(RunGraphResponse::kRecvFieldNumber,
+                              named_tensor_proto_bytes) -
+        tdata.size();
+
+    // Encode all but the actual "tdata", but including the tag and
+    // varlength header for the "tdata"
+    ::grpc::Slice header(encoder_size);
+    io::ProtoEncodeHelper e(
+        const_cast<char*>(reinterpret_cast<const char*>(header.begin())),
+        header.size());
+    // (B1) & (B2)
+    e.WriteVarlengthBeginning(RunGraphResponse::kRecvFieldNumber,
+                              named_tensor_proto_bytes);
+    // (C1)
+    e.WriteString(NamedTensorProto::kNameFieldNumber, name);
+    // (C2)
+    e.WriteVarlengthBeginning(NamedTensorProto::kTensorFieldNumber,
+                              tensor_proto_bytes);
+    // (C3)
+    e.WriteRawBytes(StringPiece(e_skeleton.data(), e_skeleton.size()));
+    // (D1) & (D2)
+    e.WriteVarlengthBeginning(TensorProto::kTensorContentFieldNumber,
+                              tdata.size());
+    CHECK_EQ(e.size(), encoder_size);
+    slices.push_back(std::move(header));
+
+    // (E) Encode tensor data, but by sharing backing store
+    const TensorBuffer* buf = DMAHelper::buffer(&val);
+    buf->Ref();
+    slices.push_back(::grpc::Slice(
+        const_cast<void*>(static_cast<const void*>(tdata.data())),
+        tdata.size(),
+        [](void* backing) { static_cast<TensorBuffer*>(backing)->Unref(); },
+        const_cast<TensorBuffer*>(buf)));
+  }
+
+  ::grpc::ByteBuffer tmp(slices.data(), slices.size());
+  result->Swap(&tmp);
+}
+
 }  // namespace grpc
 }  // namespace tensorflow
@@ -17,10 +17,11 @@ limitations under the License.
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_TENSOR_CODING_H_
 
 #include "grpcpp/impl/codegen/byte_buffer.h"
+#include "tensorflow/core/distributed_runtime/message_wrappers.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
 class Tensor;
-class RecvTensorResponse;
 
 // TODO(jeff,sanjay): this should not be grpc specific.  Instead of
 // grpc::ByteBuffer*, it should accept an object of an interface type
@@ -45,10 +46,29 @@ void EncodeRecvTensorResponseToByteBuffer(const RecvTensorResponse& proto,
 //
 // "val" holds the tensor value to be encoded.
 //
+// "compression" is the compression that the receiver accepts. The contents of
+// "val" are compressed if it applies to the dtype of "val", and the
+// compression that was applied is encoded as "RecvTensorResponse::compression".
+//
 // Discards original contents of *result.
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
+                              RecvTensorCompression compression,
                               ::grpc::ByteBuffer* result);
 
+// Encode the contents of "response" into a byte buffer in a format that is
+// parseable as a RunGraphResponse protocol buffer. As in
+// EncodeTensorToByteBuffer(), the data of large recv tensors is not copied:
+// the byte buffer shares their backing store. The recvs may be encoded in a
+// different order than "response" holds them. The encoded response holds
+// "request_id" as its request_id.
+//
+// Performs a destructive read of "response".
+//
+// Discards original contents of *result.
+void EncodeRunGraphResponseToByteBuffer(
+    MutableRunGraphResponseWrapper* response, int64 request_id,
+    ::grpc::ByteBuffer* result);
+
 }  // namespace grpc
 }  // namespace tensorflow
 
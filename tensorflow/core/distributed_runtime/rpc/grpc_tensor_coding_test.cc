@@ -15,13 +15,19 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 
+#include <map>
+
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
+#include "tensorflow/core/distributed_runtime/message_wrappers.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
@@ -31,7 +37,8 @@ class GrpcTensorCodingTest : public ::testing::Test {
   void Validate(const Tensor& t, bool is_dead) {
     // Check by encoding to a ByteBuffer
     ::grpc::ByteBuffer buf;
-    grpc::EncodeTensorToByteBuffer(is_dead, t, false, &buf);
+    grpc::EncodeTensorToByteBuffer(is_dead, t, false,
+                                   RECV_TENSOR_COMPRESSION_NONE, &buf);
 
     // Make a string
     std::vector<::grpc::Slice> slices;
@@ -100,4 +107,128 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(GrpcTensorCodingTest, CompressedTensor) {
+  Tensor t(DT_INT32, TensorShape({64, 64}));
+  auto flat = t.flat<int32>();
+  for (int i = 0; i < flat.size(); ++i) {
+    flat(i) = i % 10;
+  }
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeTensorToByteBuffer(/*is_dead=*/false, t, /*require_ack=*/false,
+                                 RECV_TENSOR_COMPRESSION_LOSSLESS, &buf);
+  std::vector<::grpc::Slice> slices;
+  (void)buf.Dump(&slices);
+  string tmp;
+  for (const auto& s : slices) {
+    tmp.append(reinterpret_cast<const char*>(s.begin()), s.size());
+  }
+  EXPECT_LT(tmp.size(), t.TotalBytes());
+
+  RecvTensorResponse response;
+  ASSERT_TRUE(response.ParseFromString(tmp));
+  EXPECT_EQ(response.compression(), RECV_TENSOR_COMPRESSION_LOSSLESS);
+  EXPECT_EQ(response.tensor().dtype(), DT_INT32);
+  Tensor result(DT_INT32, TensorShape(response.tensor().tensor_shape()));
+  ASSERT_TRUE(DecompressTensorContent(response.compression(),
+                                      response.tensor().tensor_content(),
+                                      &result));
+  test::ExpectTensorEqual<int32>(t, result);
+}
+
+// Returns the contents of "buf" as one string.
+static string Flatten(const ::grpc::ByteBuffer& buf) {
+  std::vector<::grpc::Slice> slices;
+  (void)buf.Dump(&slices);
+  string tmp;
+  for (const auto& s : slices) {
+    tmp.append(reinterpret_cast<const char*>(s.begin()), s.size());
+  }
+  return tmp;
+}
+
+TEST_F(GrpcTensorCodingTest, RunGraphResponse) {
+  Tensor small(DT_FLOAT, TensorShape({2, 3}));
+  test::FillIota<float>(&small, 1.0f);
+  Tensor large(DT_INT64, TensorShape({16, 64}));
+  test::FillIota<int64>(&large, 7);
+  Tensor str(DT_STRING, TensorShape({2}));
+  test::FillValues<tstring>(&str, {"hello", "world"});
+
+  InMemoryRunGraphResponse response;
+  response.AddRecv("small", small);
+  response.AddRecv("large", large);
+  response.AddRecv("str", str);
+  response.mutable_step_stats()->add_dev_stats()->set_device("/cpu:0");
+  response.AddPartitionGraph(GraphDef());
+  response.set_status(errors::Internal("fantasia!"));
+
+  ::grpc::ByteBuffer buf;
+  grpc::EncodeRunGraphResponseToByteBuffer(&response, 42, &buf);
+  // The data of "large" is shared rather than copied.
+  std::vector<::grpc::Slice> slices;
+  (void)buf.Dump(&slices);
+  EXPECT_EQ(slices.size(), 3);
+
+  RunGraphResponse proto;
+  ASSERT_TRUE(proto.ParseFromString(Flatten(buf)));
+  ASSERT_EQ(proto.recv_size(), 3);
+  std::map<string, Tensor> recvs;
+  for (const NamedTensorProto& recv : proto.recv()) {
+    Tensor t;
+    ASSERT_TRUE(t.FromProto(recv.tensor()));
+    recvs[recv.name()] = t;
+  }
+  test::ExpectTensorEqual<float>(small, recvs["small"]);
+  test::ExpectTensorEqual<int64>(large, recvs["large"]);
+  test::ExpectTensorEqual<tstring>(str, recvs["str"]);
+  ASSERT_EQ(proto.step_stats().dev_stats_size(), 1);
+  EXPECT_EQ(proto.step_stats().dev_stats(0).device(), "/cpu:0");
+  EXPECT_FALSE(proto.has_cost_graph());
+  EXPECT_EQ(proto.partition_graph_size(), 1);
+  EXPECT_EQ(proto.status_code(), error::INTERNAL);
+  EXPECT_EQ(proto.status_error_message(), "fantasia!");
+  EXPECT_EQ(proto.request_id(), 42);
+}
+
+// Encodes a RunGraphResponse with 4 float tensors of "num_elems" elements,
+// with the generated protocol buffer code as the RunGraph handler does (0), or
+// with EncodeRunGraphResponseToByteBuffer() (1).
+static void BM_EncodeRunGraphResponse(int iters, int num_elems, int zero_copy) {
+  testing::StopTiming();
+  const int kNumRecvs = 4;
+  Tensor val(DT_FLOAT, TensorShape({num_elems}));
+  val.flat<float>().setConstant(1.0f);
+  testing::BytesProcessed(static_cast<int64>(iters) * kNumRecvs *
+                          val.TotalBytes());
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    ::grpc::ByteBuffer buf;
+    if (zero_copy) {
+      InMemoryRunGraphResponse response;
+      for (int j = 0; j < kNumRecvs; ++j) {
+        response.AddRecv(strings::StrCat("recv", j), val);
+      }
+      grpc::EncodeRunGraphResponseToByteBuffer(&response, i + 1, &buf);
+    } else {
+      RunGraphResponse proto;
+      NonOwnedProtoRunGraphResponse response(&proto);
+      for (int j = 0; j < kNumRecvs; ++j) {
+        response.AddRecv(strings::StrCat("recv", j), val);
+      }
+      ::grpc::Slice slice(proto.ByteSizeLong());
+      proto.SerializeWithCachedSizesToArray(
+          const_cast<uint8*>(reinterpret_cast<const uint8*>(slice.begin())));
+      ::grpc::ByteBuffer tmp(&slice, 1);
+      buf.Swap(&tmp);
+    }
+  }
+}
+BENCHMARK(BM_EncodeRunGraphResponse)
+    ->ArgPair(16, 0)
+    ->ArgPair(16, 1)
+    ->ArgPair(4096, 0)
+    ->ArgPair(4096, 1)
+    ->ArgPair(262144, 0)
+    ->ArgPair(262144, 1);
+
 }  // namespace tensorflow
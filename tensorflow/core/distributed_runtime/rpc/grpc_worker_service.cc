@@ -32,6 +32,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 #include "tensorflow/core/distributed_runtime/graph_mgr.h"
+#include "tensorflow/core/distributed_runtime/recv_buf_shared_memory.h"
 #include "tensorflow/core/distributed_runtime/rendezvous_mgr_interface.h"
 #include "tensorflow/core/distributed_runtime/rpc/async_service_interface.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_call.h"
@@ -39,6 +40,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service_impl.h"
+#include "tensorflow/core/distributed_runtime/tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/worker.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/distributed_runtime/worker_session.h"
@@ -147,6 +149,7 @@ class GrpcWorkerServiceThread {
     SETUP_FOR_REQUEST(RunGraph, 100, true);
     SETUP_FOR_REQUEST(CleanupGraph, 100, false);
     SETUP_FOR_REQUEST(MarkRecvFinished, 10, false);
+    SETUP_FOR_REQUEST(RecvTensorBatch, 100, true);
 
     // TODO(ncteisen): Determine a better policy for enqueuing the
     // appropriate number of each request type.
@@ -158,12 +161,16 @@ class GrpcWorkerServiceThread {
       EnqueueRecvTensorRequestRaw();
     }
 
+    // Each StreamingRunGraph call carries any number of steps, and accepting
+    // one enqueues the request for the next call.
+    EnqueueStreamingRunGraphRequest();
+
     void* tag;
     bool ok;
 
     while (cq_->Next(&tag, &ok)) {
-      UntypedCall<GrpcWorkerServiceThread>::Tag* callback_tag =
-          static_cast<UntypedCall<GrpcWorkerServiceThread>::Tag*>(tag);
+      GrpcCallTag<GrpcWorkerServiceThread>* callback_tag =
+          static_cast<GrpcCallTag<GrpcWorkerServiceThread>*>(tag);
       CHECK(callback_tag);
       callback_tag->OnCompleted(this, ok);
     }
@@ -263,6 +270,60 @@ class GrpcWorkerServiceThread {
     ENQUEUE_REQUEST(RunGraph, true);
   }
 
+  using StreamingRunGraphCall =
+      ServerPipelinedStreamingCall<GrpcWorkerServiceThread,
+                                   grpc::WorkerService::AsyncService,
+                                   StreamingRunGraphRequest,
+                                   ::grpc::ByteBuffer>;
+
+  // Handles one message of a StreamingRunGraph call. Steps of the same call
+  // run concurrently, as they would over separate RunGraph calls, and each
+  // response is sent as soon as its step is done. The response is encoded
+  // without copying the fetched tensors, and errors are returned in it so
+  // that a failed step does not end the call for the other steps. A cancel
+  // message cancels one step and leaves the others running.
+  void StreamingRunGraphHandler(StreamingRunGraphCall* call,
+                                StreamingRunGraphCall::Exchange* exchange) {
+    if (exchange->request.request_case() ==
+        StreamingRunGraphRequest::kCancelRequestId) {
+      call->CancelRequest(exchange->request.cancel_request_id());
+      call->FinishWithoutResponse(exchange);
+      return;
+    }
+    RunGraphRequest* request = exchange->request.mutable_run_graph();
+    const int64 request_id = request->request_id();
+    CallOptions* call_opts = new CallOptions;
+    // Registered before returning, so that a cancel message read after this
+    // request finds the step.
+    call->SetCancelCallback(exchange, request_id,
+                            [call_opts]() { call_opts->StartCancel(); });
+    Schedule([this, call, exchange, request, request_id, call_opts]() {
+      request->set_store_errors_in_response_body(true);
+      ProtoRunGraphRequest* wrapped_request = new ProtoRunGraphRequest(request);
+      InMemoryRunGraphResponse* wrapped_response = new InMemoryRunGraphResponse;
+      worker_->RunGraphAsync(
+          call_opts, wrapped_request, wrapped_response,
+          [call, exchange, request_id, call_opts, wrapped_request,
+           wrapped_response](const Status& s) {
+            VLOG(1) << "StreamingRunGraph::Done";
+            call->ClearCancelCallback(exchange);
+            if (!s.ok()) {
+              wrapped_response->set_status(s);
+            }
+            if (wrapped_response->status_code() != error::OK) {
+              VLOG(1) << "Bad response from StreamingRunGraph: "
+                      << wrapped_response->status_error_message();
+            }
+            delete call_opts;
+            delete wrapped_request;
+            grpc::EncodeRunGraphResponseToByteBuffer(
+                wrapped_response, request_id, &exchange->response);
+            delete wrapped_response;
+            call->SendResponse(exchange);
+          });
+    });
+  }
+
   void RecvTensorHandlerRaw(
       WorkerCall<RecvTensorRequest, ::grpc::ByteBuffer>* call) {
     Schedule([this, call]() {
@@ -300,6 +361,21 @@ class GrpcWorkerServiceThread {
     ENQUEUE_REQUEST(RecvBuf, true);
   }
 
+  void RecvTensorBatchHandler(
+      WorkerCall<RecvTensorBatchRequest, RecvTensorBatchResponse>* call) {
+    Schedule([this, call]() {
+      CallOptions* call_opts = new CallOptions;
+      call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
+      worker_->RecvTensorBatchAsync(call_opts, &call->request, &call->response,
+                                    [call, call_opts](const Status& s) {
+                                      call->ClearCancelCallback();
+                                      delete call_opts;
+                                      call->SendResponse(ToGrpcStatus(s));
+                                    });
+    });
+    ENQUEUE_REQUEST(RecvTensorBatch, true);
+  }
+
   void CompleteGroupHandler(
       WorkerCall<CompleteGroupRequest, CompleteGroupResponse>* call) {
     Schedule([this, call]() {
@@ -339,6 +415,16 @@ class GrpcWorkerServiceThread {
   }
 #undef ENQUEUE_REQUEST
 
+  void EnqueueStreamingRunGraphRequest() {
+    mutex_lock l(shutdown_mu_);
+    if (!is_shutdown_) {
+      StreamingRunGraphCall::EnqueueRequest(
+          worker_service_, cq_.get(),
+          &grpc::WorkerService::AsyncService::RequestStreamingRunGraph,
+          &GrpcWorkerServiceThread::StreamingRunGraphHandler);
+    }
+  }
+
   void EnqueueRecvTensorRequestRaw() {
     mutex_lock l(shutdown_mu_);
     if (!is_shutdown_) {
@@ -446,12 +532,14 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
   const int64 step_id = request->step_id();
 
   bool cache_enabled = (response_cache_ != nullptr && request_id != 0);
+  const RecvTensorCompression compression = request->compression();
 
-  auto do_response = [response, done, cache_enabled](const Tensor& tensor,
-                                                     bool is_dead,
-                                                     const Status& status) {
+  auto do_response = [response, done, cache_enabled, compression](
+                         const Tensor& tensor, bool is_dead,
+                         const Status& status) {
     if (status.ok()) {
-      grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled, response);
+      grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled,
+                                     compression, response);
     }
     done(status);
   };
@@ -476,18 +564,38 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
     }
   };
 
-  auto fail = [&rendezvous_done](const Status& status) {
-    rendezvous_done(Tensor(), false, status);
-  };
+  // Request the tensor associated with the rendezvous key.
+  // Note that we log the cancellation here but do not abort the current step.
+  // gRPC can generate cancellations in response to transient network failures,
+  // and aborting the step eliminates the opportunity for client side retries.
+  // Repeated client failures will eventually cause the step to be aborted by
+  // the client.
+  opts->SetCancelCallback(
+      [step_id]() { LOG(WARNING) << "RecvTensor cancelled for " << step_id; });
+  RecvLocalTensorAsync(*request, [opts, rendezvous_done](const Tensor& tensor,
+                                                         bool is_dead,
+                                                         const Status& status) {
+    opts->ClearCancelCallback();
+    rendezvous_done(tensor, is_dead, status);
+  });
+}
+
+// Receives the tensor of "request" from the local rendezvous, copying it to
+// the host first if it is on an accelerator.
+void GrpcWorker::RecvLocalTensorAsync(
+    const RecvTensorRequest& request,
+    GrpcResponseCache::FinishResponseCB done) {
+  const int64 step_id = request.step_id();
+  auto fail = [&done](const Status& status) { done(Tensor(), false, status); };
 
   Status s = recent_request_ids_.TrackUnique(
-      request_id, "RecvTensor (GrpcWorker)", *request);
+      request.request_id(), "RecvTensor (GrpcWorker)", request);
   if (!s.ok()) {
     fail(s);
     return;
   }
 
-  const string& key = request->rendezvous_key();
+  const string& key = request.rendezvous_key();
   TRACEPRINTF("RecvTensor: %lld %s", step_id, key.c_str());
   Rendezvous::ParsedKey parsed;
   s = Rendezvous::ParseKey(key, &parsed);
@@ -500,21 +608,14 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
     return;
   }
 
-  // Request the tensor associated with the rendezvous key.
-  // Note that we log the cancellation here but do not abort the current step.
-  // gRPC can generate cancellations in response to transient network failures,
-  // and aborting the step eliminates the opportunity for client side retries.
-  // Repeated client failures will eventually cause the step to be aborted by
-  // the client.
-  opts->SetCancelCallback(
-      [step_id]() { LOG(WARNING) << "RecvTensor cancelled for " << step_id; });
+  // The callback may run after the request is gone, so it keeps a copy of the
+  // key.
   env_->rendezvous_mgr->RecvLocalAsync(
       step_id, parsed,
-      [opts, rendezvous_done, src_dev, request](
-          const Status& status, const Rendezvous::Args& send_args,
-          const Rendezvous::Args& recv_args, const Tensor& val,
-          const bool is_dead) {
-        opts->ClearCancelCallback();
+      [done, src_dev, key](const Status& status,
+                           const Rendezvous::Args& send_args,
+                           const Rendezvous::Args& recv_args, const Tensor& val,
+                           const bool is_dead) {
         if (status.ok()) {
           // DMA can only be used for Tensors that do not fall into
           // the following three odd edge cases: 1) a zero-size
@@ -537,24 +638,194 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
                   << " gpu_info: " << src_dev->tensorflow_gpu_device_info();
               // "val" is on an accelerator device. Uses the device_context to
               // fill the copy on host.
-              StatusCallback copy_ready = [rendezvous_done, copy,
+              StatusCallback copy_ready = [done, copy,
                                            is_dead](const Status& s) {
                 // The value is now ready to be returned on the wire.
-                rendezvous_done(*copy, is_dead, s);
+                done(*copy, is_dead, s);
                 delete copy;
               };
 
-              CopyDeviceToHost(&val, alloc, alloc, request->rendezvous_key(),
-                               src_dev, copy, send_dev_context, copy_ready);
+              CopyDeviceToHost(&val, alloc, alloc, key, src_dev, copy,
+                               send_dev_context, copy_ready);
               return;
             }
           }
         }
 
-        rendezvous_done(val, is_dead, status);
+        done(val, is_dead, status);
       });
 }
 
+namespace {
+
+// Fills "response" with a tensor received for a RecvTensorBatch, compressed
+// with "compression" if it applies to the tensor.
+void FillRecvTensorResponse(const Tensor& val, bool is_dead,
+                            RecvTensorCompression compression,
+                            RecvTensorResponse* response) {
+  if (is_dead) {
+    response->set_is_dead(is_dead);
+  }
+  response->set_send_start_micros(Env::Default()->NowMicros());
+  string compressed;
+  const RecvTensorCompression applied_compression =
+      CompressTensorContent(val, compression, &compressed);
+  if (applied_compression == RECV_TENSOR_COMPRESSION_NONE) {
+    val.AsProtoTensorContent(response->mutable_tensor());
+    return;
+  }
+  response->set_compression(applied_compression);
+  TensorProto* proto = response->mutable_tensor();
+  proto->set_dtype(val.dtype());
+  val.shape().AsProto(proto->mutable_tensor_shape());
+  proto->set_tensor_content(std::move(compressed));
+}
+
+// Collects the tensors of a RecvTensorBatch into its response, and sends the
+// response once all of them are available or, after the partial response
+// deadline has passed, once at least one is. Tensors that become available
+// after that are dropped here, and wait in the worker's batch cache until the
+// receiver requests them again.
+class RecvTensorBatchState {
+ public:
+  RecvTensorBatchState(const RecvTensorBatchRequest* request,
+                       RecvTensorBatchResponse* response, StatusCallback done)
+      : request_(request),
+        response_(response),
+        done_(std::move(done)),
+        ready_(request->requests_size(), false) {
+    for (int i = 0; i < request->requests_size(); ++i) {
+      response->add_responses();
+    }
+  }
+
+  void AddTensor(int index, const Tensor& val, bool is_dead,
+                 const Status& status) {
+    {
+      mutex_lock l(mu_);
+      if (responded_) {
+        return;
+      }
+      if (status.ok()) {
+        FillRecvTensorResponse(val, is_dead,
+                               request_->requests(index).compression(),
+                               response_->mutable_responses(index));
+        ready_[index] = true;
+        ++num_ready_;
+        if (!ShouldRespond()) {
+          return;
+        }
+      }
+      PrepareResponse();
+    }
+    done_(status);
+  }
+
+  void DeadlinePassed() {
+    {
+      mutex_lock l(mu_);
+      deadline_passed_ = true;
+      if (responded_ || !ShouldRespond()) {
+        return;
+      }
+      PrepareResponse();
+    }
+    done_(Status::OK());
+  }
+
+ private:
+  bool ShouldRespond() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return num_ready_ == static_cast<int>(ready_.size()) ||
+           (deadline_passed_ && num_ready_ > 0);
+  }
+
+  void PrepareResponse() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    responded_ = true;
+    for (int i = 0; i < ready_.size(); ++i) {
+      if (!ready_[i]) {
+        response_->add_pending(i);
+      }
+    }
+  }
+
+  const RecvTensorBatchRequest* const request_;  // Not owned.
+  RecvTensorBatchResponse* const response_;      // Not owned.
+  const StatusCallback done_;
+
+  mutex mu_;
+  std::vector<bool> ready_ TF_GUARDED_BY(mu_);
+  int num_ready_ TF_GUARDED_BY(mu_) = 0;
+  bool deadline_passed_ TF_GUARDED_BY(mu_) = false;
+  bool responded_ TF_GUARDED_BY(mu_) = false;
+};
+
+}  // namespace
+
+void GrpcWorker::RecvTensorBatchAsync(CallOptions* opts,
+                                      const RecvTensorBatchRequest* request,
+                                      RecvTensorBatchResponse* response,
+                                      StatusCallback done) {
+  for (const RecvTensorRequest& tensor_request : request->requests()) {
+    if (tensor_request.request_id() == 0) {
+      done(errors::InvalidArgument(
+          "RecvTensorBatch requires a request_id for each tensor"));
+      return;
+    }
+  }
+  if (request->requests().empty()) {
+    done(Status::OK());
+    return;
+  }
+
+  // The tensors that were sent are removed from the cache. The pending ones
+  // stay until they are requested again, or until the step is cleaned up.
+  auto batch_done = [this, request, response, done](const Status& status) {
+    if (status.ok()) {
+      std::vector<bool> pending(request->requests_size(), false);
+      for (int index : response->pending()) {
+        pending[index] = true;
+      }
+      for (int i = 0; i < request->requests_size(); ++i) {
+        if (!pending[i]) {
+          recv_tensor_batch_cache_.EraseRequestId(
+              request->requests(i).request_id());
+        }
+      }
+    } else {
+      VLOG(1) << "Bad response from RecvTensorBatch: " << status;
+    }
+    done(status);
+  };
+  auto state =
+      std::make_shared<RecvTensorBatchState>(request, response, batch_done);
+
+  for (int i = 0; i < request->requests_size(); ++i) {
+    const RecvTensorRequest& tensor_request = request->requests(i);
+    const int64 request_id = tensor_request.request_id();
+    auto add_tensor = [state, i](const Tensor& val, bool is_dead,
+                                 const Status& status) {
+      state->AddTensor(i, val, is_dead, status);
+    };
+    // A request that is already in the cache was sent in an earlier batch
+    // that returned before its tensor was available.
+    if (recv_tensor_batch_cache_.QueueRequest(
+            request_id, tensor_request.step_id(), add_tensor)) {
+      continue;
+    }
+    RecvLocalTensorAsync(tensor_request, [this, request_id](
+                                             const Tensor& val, bool is_dead,
+                                             const Status& status) {
+      recv_tensor_batch_cache_.OnRequestFinished(request_id, val, is_dead,
+                                                 status);
+    });
+  }
+
+  if (request->partial_response_micros() > 0) {
+    env_->env->SchedClosureAfter(request->partial_response_micros(),
+                                 [state]() { state->DeadlinePassed(); });
+  }
+}
+
 namespace {
 // If RecvBufRespExtra.tensor_content is a single large string, then gRPC
 // can stall on the recv side when the string buffer needs to be enlarged,
@@ -589,10 +860,11 @@ void GrpcWorker::RecvBufAsync(CallOptions* opts, const RecvBufRequest* request,
   const int64 step_id = request->step_id();
   bool cache_enabled = (response_cache_ != nullptr && request_id != 0);
 
-  auto do_response = [this, response, done, cache_enabled](
+  auto do_response = [this, request, response, done, cache_enabled](
                          const Tensor& tensor, bool is_dead,
                          const Status& status) {
-    if (status.ok()) {
+    if (status.ok() &&
+        !SetTensorInRecvBufRespSharedMemory(*request, tensor, response)) {
       SetTensorInRecvBufResp(recv_buf_max_chunk_, &tensor, response);
     }
     response->set_send_start_micros(env_->env->NowMicros());
@@ -734,6 +1006,7 @@ void GrpcWorker::CleanupGraphAsync(const CleanupGraphRequest* request,
     // a worker crashes before acking a request.
     response_cache_->CleanEntriesForStep(request->step_id());
   }
+  recv_tensor_batch_cache_.CleanEntriesForStep(request->step_id());
   Worker::CleanupGraphAsync(request, response, done);
 }
 
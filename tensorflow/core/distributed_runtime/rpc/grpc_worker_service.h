@@ -46,6 +46,11 @@ class GrpcWorker : public Worker {
                                    ::grpc::ByteBuffer* response,
                                    StatusCallback done);
 
+  void RecvTensorBatchAsync(CallOptions* opts,
+                            const RecvTensorBatchRequest* request,
+                            RecvTensorBatchResponse* response,
+                            StatusCallback done) override;
+
   void LoggingAsync(const LoggingRequest* request, LoggingResponse* response,
                     StatusCallback done) override;
 
@@ -63,7 +68,13 @@ class GrpcWorker : public Worker {
   void RemoveCacheEntryForId(int64 request_id);
 
  private:
+  void RecvLocalTensorAsync(const RecvTensorRequest& request,
+                            GrpcResponseCache::FinishResponseCB done);
+
   std::unique_ptr<GrpcResponseCache> response_cache_;
+  // Holds the tensors of RecvTensorBatch requests that were still pending when
+  // their batch returned, until the receiver requests them again.
+  GrpcResponseCache recv_tensor_batch_cache_;
   const int32 recv_buf_max_chunk_;
 };
 
@@ -86,10 +86,12 @@ enum class GrpcWorkerMethod {
   kCompleteInstance,
   kGetStepSequence,
   kMarkRecvFinished,
+  kRecvTensorBatch,
+  kStreamingRunGraph,
 };
 
 static const int kGrpcNumWorkerMethods =
-    static_cast<int>(GrpcWorkerMethod::kMarkRecvFinished) + 1;
+    static_cast<int>(GrpcWorkerMethod::kStreamingRunGraph) + 1;
 
 const char* GrpcWorkerMethodName(GrpcWorkerMethod id);
 
@@ -108,6 +110,19 @@ class WorkerService final {
 
     // Make RequestAsyncUnary public for grpc_call.h
     using ::grpc::Service::RequestAsyncUnary;
+
+    // The responses carry a RunGraphResponse that is encoded by hand, so
+    // that large tensors are not copied (see grpc_tensor_coding.h).
+    void RequestStreamingRunGraph(
+        ::grpc::ServerContext* context,
+        ::grpc::ServerAsyncReaderWriter<::grpc::ByteBuffer,
+                                        StreamingRunGraphRequest>* stream,
+        ::grpc::CompletionQueue* new_call_cq,
+        ::grpc::ServerCompletionQueue* notification_cq, void* tag) {
+      ::grpc::Service::RequestAsyncBidiStreaming(
+          static_cast<int>(GrpcWorkerMethod::kStreamingRunGraph), context,
+          stream, new_call_cq, notification_cq, tag);
+    }
   };
 };
 
@@ -0,0 +1,223 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
+#include "tensorflow/core/distributed_runtime/test_utils.h"
+#include "tensorflow/core/distributed_runtime/worker_env.h"
+#include "tensorflow/core/distributed_runtime/worker_session.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/control_flow.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/worker.pb.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kWorkerName[] = "/job:worker/replica:0/task:0";
+constexpr char kSrcDevice[] = "/job:worker/replica:0/task:0/device:CPU:0";
+constexpr char kDstDevice[] = "/job:worker/replica:0/task:1/device:CPU:0";
+
+std::unique_ptr<DeviceMgr> CreateDeviceMgr() {
+  class FakeDevice : public Device {
+   public:
+    explicit FakeDevice(const DeviceAttributes& attr) : Device(nullptr, attr) {}
+    Status Sync() override { return Status::OK(); }
+    Allocator* GetAllocator(AllocatorAttributes) override {
+      return cpu_allocator();
+    }
+  };
+  DeviceAttributes attr;
+  attr.set_name(kSrcDevice);
+  attr.set_device_type("CPU");
+  std::vector<std::unique_ptr<Device>> devices;
+  devices.emplace_back(new FakeDevice(attr));
+  return std::unique_ptr<DeviceMgr>(new StaticDeviceMgr(std::move(devices)));
+}
+
+Rendezvous::ParsedKey MakeKey(const string& name) {
+  Rendezvous::ParsedKey key;
+  TF_CHECK_OK(Rendezvous::ParseKey(
+      Rendezvous::CreateKey(kSrcDevice, 0, kDstDevice, name,
+                            FrameAndIter(0, 0)),
+      &key));
+  return key;
+}
+
+Tensor V(float value) {
+  Tensor tensor(DT_FLOAT, TensorShape({}));
+  tensor.scalar<float>()() = value;
+  return tensor;
+}
+
+float V(const RecvTensorResponse& response) {
+  Tensor tensor;
+  CHECK(tensor.FromProto(response.tensor()));
+  return tensor.scalar<float>()();
+}
+
+class GrpcWorkerTest : public ::testing::Test {
+ protected:
+  static constexpr int64 kStepId = 123;
+
+  GrpcWorkerTest()
+      : device_mgr_(CreateDeviceMgr()),
+        rmgr_(&env_),
+        worker_session_("worker_session", kWorkerName,
+                        std::unique_ptr<WorkerCacheInterface>(
+                            new TestWorkerCache),
+                        CreateDeviceMgr(), std::unique_ptr<GraphMgr>(),
+                        nullptr) {
+    env_.env = Env::Default();
+    env_.device_mgr = device_mgr_.get();
+    env_.rendezvous_mgr = &rmgr_;
+    worker_.reset(new GrpcWorker(&env_, ConfigProto()));
+
+    RemoteRendezvous* rendez = rmgr_.Find(kStepId);
+    TF_CHECK_OK(rendez->Initialize(&worker_session_));
+    rendez->Unref();
+  }
+
+  ~GrpcWorkerTest() override { rmgr_.Cleanup(kStepId); }
+
+  // Sends "value" as the tensor "name" of the step.
+  void Send(const string& name, float value) {
+    RemoteRendezvous* rendez = rmgr_.Find(kStepId);
+    core::ScopedUnref unref(rendez);
+    TF_ASSERT_OK(
+        rendez->Send(MakeKey(name), Rendezvous::Args(), V(value), false));
+  }
+
+  // Adds a request for the tensor "name" of the step to "request".
+  static void AddRequest(const string& name, int64 request_id,
+                         RecvTensorBatchRequest* request) {
+    RecvTensorRequest* tensor_request = request->add_requests();
+    tensor_request->set_step_id(kStepId);
+    tensor_request->set_rendezvous_key(string(MakeKey(name).FullKey()));
+    tensor_request->set_request_id(request_id);
+  }
+
+  Status RecvTensorBatch(const RecvTensorBatchRequest& request,
+                         RecvTensorBatchResponse* response) {
+    CallOptions opts;
+    Status status;
+    Notification n;
+    worker_->RecvTensorBatchAsync(&opts, &request, response,
+                                  [&status, &n](const Status& s) {
+                                    status = s;
+                                    n.Notify();
+                                  });
+    n.WaitForNotification();
+    return status;
+  }
+
+  WorkerEnv env_;
+  std::unique_ptr<DeviceMgr> device_mgr_;
+  RpcRendezvousMgr rmgr_;
+  WorkerSession worker_session_;
+  std::unique_ptr<GrpcWorker> worker_;
+};
+
+TEST_F(GrpcWorkerTest, RecvTensorBatchReturnsAllTensors) {
+  Send("a", 1.0f);
+  Send("b", 2.0f);
+  RecvTensorBatchRequest request;
+  AddRequest("a", 1, &request);
+  AddRequest("b", 2, &request);
+  RecvTensorBatchResponse response;
+  TF_ASSERT_OK(RecvTensorBatch(request, &response));
+  ASSERT_EQ(response.responses_size(), 2);
+  EXPECT_EQ(V(response.responses(0)), 1.0f);
+  EXPECT_EQ(V(response.responses(1)), 2.0f);
+  EXPECT_EQ(response.pending_size(), 0);
+}
+
+TEST_F(GrpcWorkerTest, RecvTensorBatchWaitsForAllTensors) {
+  RecvTensorBatchRequest request;
+  AddRequest("a", 1, &request);
+  AddRequest("b", 2, &request);
+  Notification sent;
+  Env::Default()->SchedClosureAfter(10 * 1000, [this, &sent]() {
+    Send("a", 1.0f);
+    Env::Default()->SleepForMicroseconds(10 * 1000);
+    Send("b", 2.0f);
+    sent.Notify();
+  });
+  RecvTensorBatchResponse response;
+  TF_ASSERT_OK(RecvTensorBatch(request, &response));
+  sent.WaitForNotification();
+  ASSERT_EQ(response.responses_size(), 2);
+  EXPECT_EQ(V(response.responses(0)), 1.0f);
+  EXPECT_EQ(V(response.responses(1)), 2.0f);
+  EXPECT_EQ(response.pending_size(), 0);
+}
+
+TEST_F(GrpcWorkerTest, RecvTensorBatchReturnsPartialResponse) {
+  Send("a", 1.0f);
+  RecvTensorBatchRequest request;
+  AddRequest("a", 1, &request);
+  AddRequest("b", 2, &request);
+  request.set_partial_response_micros(1000);
+  RecvTensorBatchResponse response;
+  TF_ASSERT_OK(RecvTensorBatch(request, &response));
+  ASSERT_EQ(response.responses_size(), 2);
+  EXPECT_EQ(V(response.responses(0)), 1.0f);
+  ASSERT_EQ(response.pending_size(), 1);
+  EXPECT_EQ(response.pending(0), 1);
+
+  // The pending tensor is received under its original request id.
+  Send("b", 2.0f);
+  RecvTensorBatchRequest pending_request;
+  AddRequest("b", 2, &pending_request);
+  RecvTensorBatchResponse pending_response;
+  TF_ASSERT_OK(RecvTensorBatch(pending_request, &pending_response));
+  ASSERT_EQ(pending_response.responses_size(), 1);
+  EXPECT_EQ(V(pending_response.responses(0)), 2.0f);
+  EXPECT_EQ(pending_response.pending_size(), 0);
+}
+
+TEST_F(GrpcWorkerTest, RecvTensorBatchFailsIfATensorFails) {
+  Send("a", 1.0f);
+  RecvTensorBatchRequest request;
+  AddRequest("a", 1, &request);
+  RecvTensorRequest* bad_request = request.add_requests();
+  bad_request->set_step_id(kStepId);
+  bad_request->set_rendezvous_key("not a rendezvous key");
+  bad_request->set_request_id(2);
+  RecvTensorBatchResponse response;
+  EXPECT_TRUE(errors::IsInvalidArgument(RecvTensorBatch(request, &response)));
+}
+
+TEST_F(GrpcWorkerTest, RecvTensorBatchRequiresRequestIds) {
+  RecvTensorBatchRequest request;
+  AddRequest("a", 0, &request);
+  RecvTensorBatchResponse response;
+  EXPECT_TRUE(errors::IsInvalidArgument(RecvTensorBatch(request, &response)));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,7 +15,12 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
+
+#include "absl/memory/memory.h"
 
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
@@ -33,15 +38,230 @@ limitations under the License.
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/notification.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
 namespace {
 
+// Returns the compression that RecvTensor requests accept for the tensors in
+// their responses, which the TF_RECV_TENSOR_COMPRESSION environment variable
+// sets to "none" (the default), "lossless" or "bfloat16". See
+// RecvTensorCompression in worker.proto.
+RecvTensorCompression RecvTensorCompressionFromEnv() {
+  static const RecvTensorCompression compression = [] {
+    string value;
+    TF_CHECK_OK(
+        ReadStringFromEnvVar("TF_RECV_TENSOR_COMPRESSION", "none", &value));
+    if (value == "lossless") return RECV_TENSOR_COMPRESSION_LOSSLESS;
+    if (value == "bfloat16") return RECV_TENSOR_COMPRESSION_BFLOAT16;
+    if (value != "none") {
+      LOG(WARNING) << "Ignoring unknown TF_RECV_TENSOR_COMPRESSION: " << value;
+    }
+    return RECV_TENSOR_COMPRESSION_NONE;
+  }();
+  return compression;
+}
+
+// Returns the window in which the RecvTensor requests of a step to the same
+// worker are coalesced into one RecvTensorBatch RPC, which the
+// TF_RECV_TENSOR_BATCH_WINDOW_MICROS environment variable sets. Zero, the
+// default, sends one RecvTensor RPC per tensor.
+int64 RecvTensorBatchWindowMicrosFromEnv() {
+  static const int64 window_micros = [] {
+    int64 value;
+    TF_CHECK_OK(ReadInt64FromEnvVar("TF_RECV_TENSOR_BATCH_WINDOW_MICROS",
+                                    /*default_val=*/0, &value));
+    return value;
+  }();
+  return window_micros;
+}
+
+// How long a worker that answers a RecvTensorBatch waits for all of its
+// tensors before it returns the ones that are available. See
+// RecvTensorBatchRequest in worker.proto.
+constexpr int64 kRecvTensorBatchPartialResponseMicros = 1000;
+
+// Coalesces the RecvTensor requests that a step sends to the same worker
+// within a short window into one RecvTensorBatch RPC, which saves the per-RPC
+// overhead when a step exchanges many small tensors. Falls back to a
+// RecvTensor RPC per tensor if the worker doesn't support RecvTensorBatch.
+class RecvTensorBatcher {
+ public:
+  RecvTensorBatcher(Env* env, int64 window_micros)
+      : env_(env), window_micros_(window_micros) {}
+
+  // Receives the tensor of "request" from "src_worker", as
+  // `wi->RecvTensorAsync()` would. All of "wi", "opts", "request" and
+  // "response" must stay alive until "done" is called.
+  void RecvTensorAsync(const string& src_worker, WorkerInterface* wi,
+                       CallOptions* opts, const RecvTensorRequest* request,
+                       TensorResponse* response, StatusCallback done) {
+    bool start_window = false;
+    {
+      mutex_lock l(mu_);
+      std::shared_ptr<Batch>& batch = pending_[src_worker];
+      if (batch == nullptr) {
+        batch = std::make_shared<Batch>();
+        start_window = true;
+      }
+      batch->Add({wi, opts, request, response, std::move(done)});
+    }
+    if (start_window) {
+      env_->SchedClosureAfter(window_micros_,
+                              [this, src_worker]() { Flush(src_worker); });
+    }
+  }
+
+ private:
+  struct Entry {
+    WorkerInterface* wi;  // Not owned.
+    CallOptions* opts;    // Not owned.
+    const RecvTensorRequest* request;
+    TensorResponse* response;
+    StatusCallback done;
+  };
+
+  // The RecvTensorBatch RPC for some of the tensors from one worker. Aborting
+  // any of their calls cancels it as a whole, like the abort of a rendezvous
+  // does anyway.
+  class Batch {
+   public:
+    ~Batch() {
+      for (const Entry& entry : entries_) {
+        entry.opts->ClearCancelCallback();
+      }
+    }
+
+    void Add(Entry entry) {
+      entry.opts->SetCancelCallback([this]() { StartCancel(); });
+      *request_.add_requests() = *entry.request;
+      entries_.push_back(std::move(entry));
+    }
+
+    // Sends the RPC, and sends a new batch for the tensors that the response
+    // leaves pending.
+    static void Start(std::shared_ptr<Batch> batch) {
+      Batch* b = batch.get();
+      b->request_.set_partial_response_micros(
+          kRecvTensorBatchPartialResponseMicros);
+      b->entries_[0].wi->RecvTensorBatchAsync(
+          &b->opts_, &b->request_, &b->response_,
+          [batch](const Status& s) { batch->Done(s); });
+      // A cancellation that arrived before the RPC registered with "opts_" is
+      // applied now.
+      bool cancelled;
+      {
+        mutex_lock l(b->mu_);
+        cancelled = b->cancelled_;
+      }
+      if (cancelled) {
+        b->opts_.StartCancel();
+      }
+    }
+
+   private:
+    void StartCancel() {
+      {
+        mutex_lock l(mu_);
+        cancelled_ = true;
+      }
+      opts_.StartCancel();
+    }
+
+    void Done(Status s) {
+      for (const Entry& entry : entries_) {
+        entry.opts->ClearCancelCallback();
+      }
+      std::vector<Entry> entries = std::move(entries_);
+      entries_.clear();
+      if (errors::IsUnimplemented(s)) {
+        for (Entry& entry : entries) {
+          entry.wi->RecvTensorAsync(entry.opts, entry.request, entry.response,
+                                    std::move(entry.done));
+        }
+        return;
+      }
+      const int num_entries = entries.size();
+      if (s.ok() && response_.responses_size() != num_entries) {
+        s = errors::Internal("RecvTensorBatch returned ",
+                             response_.responses_size(), " responses for ",
+                             num_entries, " requests");
+      }
+      if (!s.ok()) {
+        for (Entry& entry : entries) {
+          entry.done(s);
+        }
+        return;
+      }
+      std::vector<bool> pending(num_entries, false);
+      for (int index : response_.pending()) {
+        if (index >= 0 && index < num_entries) {
+          pending[index] = true;
+        }
+      }
+      std::shared_ptr<Batch> pending_batch;
+      for (int i = 0; i < num_entries; ++i) {
+        if (pending[i]) {
+          if (pending_batch == nullptr) {
+            pending_batch = std::make_shared<Batch>();
+          }
+          pending_batch->Add(std::move(entries[i]));
+        }
+      }
+      // The callbacks may delete the calls of the other entries, so all
+      // pending entries are moved out first.
+      for (int i = 0; i < num_entries; ++i) {
+        if (!pending[i]) {
+          entries[i].done(
+              entries[i].response->InitFrom(response_.mutable_responses(i)));
+        }
+      }
+      if (pending_batch != nullptr) {
+        Start(std::move(pending_batch));
+      }
+    }
+
+    CallOptions opts_;
+    RecvTensorBatchRequest request_;
+    RecvTensorBatchResponse response_;
+    std::vector<Entry> entries_;
+
+    mutex mu_;
+    bool cancelled_ TF_GUARDED_BY(mu_) = false;
+  };
+
+  void Flush(const string& src_worker) {
+    std::shared_ptr<Batch> batch;
+    {
+      mutex_lock l(mu_);
+      auto it = pending_.find(src_worker);
+      batch = std::move(it->second);
+      pending_.erase(it);
+    }
+    Batch::Start(std::move(batch));
+  }
+
+  Env* const env_;
+  const int64 window_micros_;
+
+  mutex mu_;
+  std::unordered_map<string, std::shared_ptr<Batch>> pending_
+      TF_GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RecvTensorBatcher);
+};
+
 class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  public:
-  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id)
-      : BaseRemoteRendezvous(env, step_id) {}
+  RpcRemoteRendezvous(const WorkerEnv* env, int64 step_id,
+                      int64 batch_window_micros)
+      : BaseRemoteRendezvous(env, step_id) {
+    if (batch_window_micros > 0) {
+      batcher_ = absl::make_unique<RecvTensorBatcher>(env->env,
+                                                      batch_window_micros);
+    }
+  }
 
  protected:
   void RecvFromRemoteAsync(const Rendezvous::ParsedKey& parsed,
@@ -51,18 +271,24 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  private:
   ~RpcRemoteRendezvous() override {}
 
+  // Coalesces the RecvTensor RPCs of the step if batching is enabled.
+  std::unique_ptr<RecvTensorBatcher> batcher_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
 // Used only to retrieve tensors from remote processes.
 class RpcRecvTensorCall : public BaseRecvTensorCall {
  public:
-  RpcRecvTensorCall() : wi_(nullptr), dst_device_(nullptr) {}
+  RpcRecvTensorCall()
+      : wi_(nullptr), batcher_(nullptr), dst_device_(nullptr) {}
 
-  void Init(WorkerInterface* wi, int64 step_id, StringPiece key,
-            AllocatorAttributes alloc_attrs, Device* dst_device,
-            const Rendezvous::Args& recv_args, Rendezvous::DoneCallback done) {
+  void Init(WorkerInterface* wi, RecvTensorBatcher* batcher, int64 step_id,
+            StringPiece key, AllocatorAttributes alloc_attrs,
+            Device* dst_device, const Rendezvous::Args& recv_args,
+            Rendezvous::DoneCallback done) {
     wi_ = wi;
+    batcher_ = batcher;
     alloc_attrs_ = alloc_attrs;
     dst_device_ = dst_device;
     recv_args_ = recv_args;
@@ -70,6 +296,7 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     req_.set_step_id(step_id);
     req_.set_rendezvous_key(key.data(), key.size());
     req_.set_request_id(GetUniqueRequestId());
+    req_.set_compression(RecvTensorCompressionFromEnv());
   }
 
   void Reset() {
@@ -78,6 +305,7 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     DCHECK_EQ(static_cast<WorkerInterface*>(nullptr), wi_)
         << "Leaking WorkerInterface in RpcRecvTensorCall::Reset().";
 
+    batcher_ = nullptr;
     alloc_attrs_ = AllocatorAttributes();
     dst_device_ = nullptr;
     // We don't clear opts_ and assume that Init will set up the state for
@@ -149,7 +377,12 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
       }
       recv_done();
     };
-    wi_->RecvTensorAsync(&opts_, &req_, &resp_, std::move(cb));
+    if (batcher_ != nullptr) {
+      batcher_->RecvTensorAsync(src_worker_, wi_, &opts_, &req_, &resp_,
+                                std::move(cb));
+    } else {
+      wi_->RecvTensorAsync(&opts_, &req_, &resp_, std::move(cb));
+    }
 
     // NOTE: Check if the rendezvous was aborted after sending out the RPC. The
     // ordering is important because `StartAbort` could be called right before
@@ -170,7 +403,8 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
 
   string src_worker_;
   string src_rel_device_;
-  WorkerInterface* wi_;  // Not owned.
+  WorkerInterface* wi_;         // Not owned.
+  RecvTensorBatcher* batcher_;  // Not owned.
   AllocatorAttributes alloc_attrs_;
   Device* dst_device_;
   CallOptions opts_;
@@ -269,8 +503,8 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
     return;
   }
 
-  call->Init(rwi, step_id_, parsed.FullKey(), recv_args.alloc_attrs, dst_device,
-             recv_args, std::move(done));
+  call->Init(rwi, batcher_.get(), step_id_, parsed.FullKey(),
+             recv_args.alloc_attrs, dst_device, recv_args, std::move(done));
 
   // Record "call" in active_ so that it can be aborted cleanly.
   RegisterCall(call, recv_args);
@@ -307,11 +541,17 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
 }  // namespace
 
 RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env)
-    : BaseRendezvousMgr(env) {}
+    : RpcRendezvousMgr(env, RecvTensorBatchWindowMicrosFromEnv()) {}
+
+RpcRendezvousMgr::RpcRendezvousMgr(const WorkerEnv* env,
+                                   int64 recv_tensor_batch_window_micros)
+    : BaseRendezvousMgr(env),
+      recv_tensor_batch_window_micros_(recv_tensor_batch_window_micros) {}
 
 BaseRemoteRendezvous* RpcRendezvousMgr::Create(int64 step_id,
                                                const WorkerEnv* worker_env) {
-  return new RpcRemoteRendezvous(worker_env, step_id);
+  return new RpcRemoteRendezvous(worker_env, step_id,
+                                 recv_tensor_batch_window_micros_);
 }
 
 }  // end namespace tensorflow
@@ -46,10 +46,18 @@ class RpcRendezvousMgr : public BaseRendezvousMgr {
  public:
   explicit RpcRendezvousMgr(const WorkerEnv* env);
 
+  // Coalesces the RecvTensor RPCs that a step sends to the same worker within
+  // "recv_tensor_batch_window_micros" into RecvTensorBatch RPCs. Zero sends
+  // one RecvTensor RPC per tensor. The constructor above reads the window
+  // from the TF_RECV_TENSOR_BATCH_WINDOW_MICROS environment variable.
+  RpcRendezvousMgr(const WorkerEnv* env, int64 recv_tensor_batch_window_micros);
+
  protected:
   BaseRemoteRendezvous* Create(int64 step_id, const WorkerEnv* worker_env);
 
  private:
+  const int64 recv_tensor_batch_window_micros_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRendezvousMgr);
 };
 
@@ -15,8 +15,11 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <vector>
+
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/distributed_runtime/test_utils.h"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/control_flow.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -25,7 +28,9 @@ limitations under the License.
 #include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/platform/strcat.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -100,7 +105,9 @@ static Device* CreateDevice(const char* type, const char* name) {
    public:
     explicit FakeDevice(const DeviceAttributes& attr) : Device(nullptr, attr) {}
     Status Sync() override { return Status::OK(); }
-    Allocator* GetAllocator(AllocatorAttributes) override { return nullptr; }
+    Allocator* GetAllocator(AllocatorAttributes) override {
+      return cpu_allocator();
+    }
   };
   DeviceAttributes attr;
   attr.set_name(name);
@@ -342,4 +349,360 @@ TEST_F(RpcRendezvousMgrTest, RemoteRecvAsyncMany) {
   rmgr_.Cleanup(step_id);
 }
 
+namespace {
+// A worker that answers RecvTensor and RecvTensorBatch requests with the
+// rendezvous key of each tensor as its value, and records the request ids of
+// the batches it receives.
+class BatchWorker : public TestWorkerInterface {
+ public:
+  enum class Mode {
+    // Returns all the tensors of each batch.
+    kRespond,
+    // Leaves all but the first tensor of the first batch pending.
+    kPartial,
+    // Fails each batch.
+    kFail,
+    // Fails each batch with Cancelled once it is cancelled.
+    kWaitForCancel,
+    // Fails each batch with Unimplemented, as a worker without
+    // RecvTensorBatch does.
+    kUnimplemented,
+  };
+
+  void set_mode(Mode mode) { mode_ = mode; }
+
+  void RecvTensorAsync(CallOptions* opts, const RecvTensorRequest* request,
+                       TensorResponse* response, StatusCallback done) override {
+    {
+      mutex_lock l(mu_);
+      ++num_recv_tensor_calls_;
+    }
+    SchedClosure([request, response, done = std::move(done)]() {
+      RecvTensorResponse proto;
+      FillResponse(*request, &proto);
+      done(response->InitFrom(&proto));
+    });
+  }
+
+  void RecvTensorBatchAsync(CallOptions* opts,
+                            const RecvTensorBatchRequest* request,
+                            RecvTensorBatchResponse* response,
+                            StatusCallback done) override {
+    int batch_index;
+    {
+      mutex_lock l(mu_);
+      batch_index = batches_.size();
+      batches_.emplace_back();
+      for (const RecvTensorRequest& tensor_request : request->requests()) {
+        batches_.back().push_back(tensor_request.request_id());
+      }
+      cv_.notify_all();
+    }
+    switch (mode_) {
+      case Mode::kRespond:
+      case Mode::kPartial:
+        SchedClosure([this, batch_index, request, response,
+                      done = std::move(done)]() {
+          for (int i = 0; i < request->requests_size(); ++i) {
+            RecvTensorResponse* tensor_response = response->add_responses();
+            if (mode_ == Mode::kPartial && batch_index == 0 && i > 0) {
+              response->add_pending(i);
+            } else {
+              FillResponse(request->requests(i), tensor_response);
+            }
+          }
+          done(Status::OK());
+        });
+        return;
+      case Mode::kFail:
+        SchedClosure([done = std::move(done)]() {
+          done(errors::Internal("RecvTensorBatch failed"));
+        });
+        return;
+      case Mode::kWaitForCancel:
+        // Like an RPC, the call completes asynchronously after cancellation.
+        opts->SetCancelCallback(
+            [done = std::move(done), cancelled = false]() mutable {
+              if (cancelled) return;
+              cancelled = true;
+              SchedClosure(
+                  [done]() { done(errors::Cancelled("RecvTensorBatch")); });
+            });
+        return;
+      case Mode::kUnimplemented:
+        done(errors::Unimplemented("RecvTensorBatchAsync()"));
+        return;
+    }
+  }
+
+  // Waits until at least "num_batches" batches have been received.
+  void WaitForBatches(int num_batches) {
+    mutex_lock l(mu_);
+    while (static_cast<int>(batches_.size()) < num_batches) {
+      cv_.wait(l);
+    }
+  }
+
+  // The request ids of each batch received so far.
+  std::vector<std::vector<int64>> batches() {
+    mutex_lock l(mu_);
+    return batches_;
+  }
+
+  int num_recv_tensor_calls() {
+    mutex_lock l(mu_);
+    return num_recv_tensor_calls_;
+  }
+
+ private:
+  static void FillResponse(const RecvTensorRequest& request,
+                           RecvTensorResponse* response) {
+    V(request.rendezvous_key()).AsProtoField(response->mutable_tensor());
+  }
+
+  Mode mode_ = Mode::kRespond;
+
+  mutex mu_;
+  condition_variable cv_;
+  std::vector<std::vector<int64>> batches_ TF_GUARDED_BY(mu_);
+  int num_recv_tensor_calls_ TF_GUARDED_BY(mu_) = 0;
+};
+
+// Returns the same BatchWorker for every target.
+class BatchWorkerCache : public WorkerCacheInterface {
+ public:
+  explicit BatchWorkerCache(BatchWorker* worker) : worker_(worker) {}
+
+  void ListWorkers(std::vector<string>* workers) const override {}
+  void ListWorkersInJob(const string& job_name,
+                        std::vector<string>* workers) const override {}
+  WorkerInterface* GetOrCreateWorker(const string& target) override {
+    return worker_;
+  }
+  void ReleaseWorker(const string& target, WorkerInterface* worker) override {}
+  Status GetEagerClientCache(
+      std::unique_ptr<eager::EagerClientCache>* eager_client_cache) override {
+    return errors::Unimplemented("Unimplemented.");
+  }
+  bool GetDeviceLocalityNonBlocking(const string& device,
+                                    DeviceLocality* locality) override {
+    return false;
+  }
+  void GetDeviceLocalityAsync(const string& device, DeviceLocality* locality,
+                              StatusCallback done) override {}
+
+ private:
+  BatchWorker* const worker_;  // Not owned.
+};
+
+struct RecvResult {
+  Status status;
+  string value;
+};
+}  // namespace
+
+class RpcRendezvousMgrBatchTest : public ::testing::Test {
+ protected:
+  static constexpr int64 kBatchWindowMicros = 100 * 1000;
+
+  RpcRendezvousMgrBatchTest()
+      : worker_session_("rpc_session", "/job:mnist/replica:1/task:2",
+                        std::unique_ptr<WorkerCacheInterface>(
+                            new BatchWorkerCache(&worker_)),
+                        std::unique_ptr<DeviceMgr>(CreateDeviceMgr()),
+                        std::unique_ptr<GraphMgr>(), nullptr),
+        rmgr_(&env_, kBatchWindowMicros) {
+    env_.env = Env::Default();
+  }
+
+  // Returns the keys of "num_keys" tensors sent by the remote worker.
+  static std::vector<Rendezvous::ParsedKey> RemoteKeys(int num_keys,
+                                                       int first = 0) {
+    std::vector<Rendezvous::ParsedKey> keys;
+    for (int i = first; i < first + num_keys; ++i) {
+      keys.push_back(MakeKey(Rendezvous::CreateKey(
+          "/job:worker/replica:1/task:2/cpu:0", 7890,
+          "/job:mnist/replica:1/task:2/cpu:1", strings::StrCat("foo", i),
+          FrameAndIter(0, 0))));
+    }
+    return keys;
+  }
+
+  // Starts receiving each of "keys" with "args". Stores the outcome of each
+  // receive in "results", and then decrements "counter".
+  static void RecvAsync(RemoteRendezvous* rendez,
+                        const std::vector<Rendezvous::ParsedKey>& keys,
+                        const Rendezvous::Args& args,
+                        std::vector<RecvResult>* results,
+                        BlockingCounter* counter) {
+    results->resize(keys.size());
+    for (int i = 0; i < keys.size(); ++i) {
+      RecvResult* result = &(*results)[i];
+      rendez->RecvAsync(
+          keys[i], args,
+          [result, counter](const Status& s, const Rendezvous::Args&,
+                            const Rendezvous::Args&, const Tensor& val,
+                            const bool) {
+            result->status = s;
+            if (s.ok()) {
+              result->value = V(val);
+            }
+            counter->DecrementCount();
+          });
+    }
+  }
+
+  static void ExpectReceived(const std::vector<Rendezvous::ParsedKey>& keys,
+                             const std::vector<RecvResult>& results) {
+    ASSERT_EQ(keys.size(), results.size());
+    for (int i = 0; i < keys.size(); ++i) {
+      TF_EXPECT_OK(results[i].status);
+      EXPECT_EQ(results[i].value, string(keys[i].FullKey()));
+    }
+  }
+
+  BatchWorker worker_;
+  WorkerEnv env_;
+
+  WorkerSession worker_session_;
+  RpcRendezvousMgr rmgr_;
+};
+
+TEST_F(RpcRendezvousMgrBatchTest, CoalescesReceives) {
+  const int64 step_id = 123;
+  const std::vector<Rendezvous::ParsedKey> keys = RemoteKeys(4);
+  std::vector<RecvResult> results;
+  {
+    RemoteRendezvous* rendez = rmgr_.Find(step_id);
+    core::ScopedUnref unref(rendez);
+    TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+    BlockingCounter counter(keys.size());
+    RecvAsync(rendez, keys, Rendezvous::Args(), &results, &counter);
+    counter.Wait();
+  }
+  ExpectReceived(keys, results);
+  const std::vector<std::vector<int64>> batches = worker_.batches();
+  ASSERT_EQ(batches.size(), 1);
+  EXPECT_EQ(batches[0].size(), keys.size());
+  EXPECT_EQ(worker_.num_recv_tensor_calls(), 0);
+  rmgr_.Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, RequestsPendingTensorsAgain) {
+  worker_.set_mode(BatchWorker::Mode::kPartial);
+  const int64 step_id = 123;
+  const std::vector<Rendezvous::ParsedKey> keys = RemoteKeys(3);
+  std::vector<RecvResult> results;
+  {
+    RemoteRendezvous* rendez = rmgr_.Find(step_id);
+    core::ScopedUnref unref(rendez);
+    TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+    BlockingCounter counter(keys.size());
+    RecvAsync(rendez, keys, Rendezvous::Args(), &results, &counter);
+    counter.Wait();
+  }
+  ExpectReceived(keys, results);
+  // The second batch asks again for the tensors the first one left pending,
+  // with the same request ids.
+  const std::vector<std::vector<int64>> batches = worker_.batches();
+  ASSERT_EQ(batches.size(), 2);
+  ASSERT_EQ(batches[0].size(), 3);
+  EXPECT_EQ(batches[1],
+            std::vector<int64>(batches[0].begin() + 1, batches[0].end()));
+  rmgr_.Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, ErrorCompletesAllReceives) {
+  worker_.set_mode(BatchWorker::Mode::kFail);
+  const int64 step_id = 123;
+  const std::vector<Rendezvous::ParsedKey> keys = RemoteKeys(3);
+  std::vector<RecvResult> results;
+  {
+    RemoteRendezvous* rendez = rmgr_.Find(step_id);
+    core::ScopedUnref unref(rendez);
+    TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+    BlockingCounter counter(keys.size());
+    RecvAsync(rendez, keys, Rendezvous::Args(), &results, &counter);
+    counter.Wait();
+  }
+  for (const RecvResult& result : results) {
+    EXPECT_TRUE(errors::IsInternal(result.status)) << result.status;
+  }
+  EXPECT_EQ(worker_.batches().size(), 1);
+  rmgr_.Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, AbortCompletesAllReceives) {
+  worker_.set_mode(BatchWorker::Mode::kWaitForCancel);
+  const int64 step_id = 123;
+  const std::vector<Rendezvous::ParsedKey> keys = RemoteKeys(3);
+  std::vector<RecvResult> results;
+  {
+    RemoteRendezvous* rendez = rmgr_.Find(step_id);
+    core::ScopedUnref unref(rendez);
+    TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+    BlockingCounter counter(keys.size());
+    RecvAsync(rendez, keys, Rendezvous::Args(), &results, &counter);
+    worker_.WaitForBatches(1);
+    rendez->StartAbort(errors::Aborted("step aborted"));
+    counter.Wait();
+  }
+  for (const RecvResult& result : results) {
+    EXPECT_TRUE(errors::IsAborted(result.status)) << result.status;
+  }
+  EXPECT_EQ(worker_.batches().size(), 1);
+  rmgr_.Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, CancelBeforeFlush) {
+  worker_.set_mode(BatchWorker::Mode::kWaitForCancel);
+  const int64 step_id = 123;
+  const std::vector<Rendezvous::ParsedKey> keys = RemoteKeys(1);
+  const std::vector<Rendezvous::ParsedKey> cancelled_keys =
+      RemoteKeys(1, /*first=*/1);
+  std::vector<RecvResult> results;
+  std::vector<RecvResult> cancelled_results;
+  CancellationManager cm;
+  {
+    RemoteRendezvous* rendez = rmgr_.Find(step_id);
+    core::ScopedUnref unref(rendez);
+    TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+    BlockingCounter counter(keys.size() + cancelled_keys.size());
+    RecvAsync(rendez, keys, Rendezvous::Args(), &results, &counter);
+    Rendezvous::Args args;
+    args.cancellation_manager = &cm;
+    RecvAsync(rendez, cancelled_keys, args, &cancelled_results, &counter);
+    // The batch is still waiting for its window to pass.
+    cm.StartCancel();
+    counter.Wait();
+  }
+  // Cancelling one receive cancels the batch it belongs to.
+  EXPECT_TRUE(errors::IsCancelled(cancelled_results[0].status))
+      << cancelled_results[0].status;
+  EXPECT_TRUE(errors::IsCancelled(results[0].status)) << results[0].status;
+  const std::vector<std::vector<int64>> batches = worker_.batches();
+  ASSERT_EQ(batches.size(), 1);
+  EXPECT_EQ(batches[0].size(), 2);
+  rmgr_.Cleanup(step_id);
+}
+
+TEST_F(RpcRendezvousMgrBatchTest, FallsBackToRecvTensor) {
+  worker_.set_mode(BatchWorker::Mode::kUnimplemented);
+  const int64 step_id = 123;
+  const std::vector<Rendezvous::ParsedKey> keys = RemoteKeys(3);
+  std::vector<RecvResult> results;
+  {
+    RemoteRendezvous* rendez = rmgr_.Find(step_id);
+    core::ScopedUnref unref(rendez);
+    TF_ASSERT_OK(rendez->Initialize(&worker_session_));
+    BlockingCounter counter(keys.size());
+    RecvAsync(rendez, keys, Rendezvous::Args(), &results, &counter);
+    counter.Wait();
+  }
+  ExpectReceived(keys, results);
+  EXPECT_EQ(worker_.batches().size(), 1);
+  EXPECT_EQ(worker_.num_recv_tensor_calls(), keys.size());
+  rmgr_.Cleanup(step_id);
+}
+
 }  // namespace tensorflow
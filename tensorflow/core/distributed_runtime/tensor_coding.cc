@@ -18,11 +18,59 @@ limitations under the License.
 #include "google/protobuf/any.pb.h"
 
 #include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/bfloat16.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/snappy.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Tensors smaller than this aren't worth the time to compress.
+constexpr size_t kMinCompressedTensorBytes = 1024;
+
+bool IsLosslessCompressible(DataType dtype) {
+  switch (dtype) {
+    case DT_BOOL:
+    case DT_INT8:
+    case DT_INT16:
+    case DT_INT32:
+    case DT_INT64:
+    case DT_UINT8:
+    case DT_UINT16:
+    case DT_UINT32:
+    case DT_UINT64:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Replaces the compressed content of "*tensor_proto" with the raw content, for
+// the paths that parse the whole RecvTensorResponse before building the tensor.
+Status DecompressTensorProto(RecvTensorCompression compression,
+                             TensorProto* tensor_proto) {
+  if (compression == RECV_TENSOR_COMPRESSION_NONE) {
+    return Status::OK();
+  }
+  if (!TensorShape::IsValid(tensor_proto->tensor_shape())) {
+    return errors::InvalidArgument("Cannot parse tensor from response");
+  }
+  Tensor tensor(tensor_proto->dtype(),
+                TensorShape(tensor_proto->tensor_shape()));
+  if (!DecompressTensorContent(compression, tensor_proto->tensor_content(),
+                               &tensor)) {
+    return errors::InvalidArgument("Cannot decompress tensor from response");
+  }
+  tensor_proto->set_tensor_content(tensor.tensor_data().data(),
+                                   tensor.tensor_data().size());
+  return Status::OK();
+}
+
+}  // namespace
+
 TensorResponse::Source::~Source() {}
 
 void TensorResponse::Clear() {
@@ -53,6 +101,8 @@ void TensorResponse::InitAlloc(DeviceBase* d, const AllocatorAttributes& aa) {
 Status TensorResponse::InitFrom(RecvTensorResponse* response) {
   Status s;
   meta_.Swap(response);
+  TF_RETURN_IF_ERROR(
+      DecompressTensorProto(meta_.compression(), meta_.mutable_tensor()));
   if (on_host_) {
     if (!tensor_.FromProto(allocator_, meta_.tensor())) {
       s = errors::InvalidArgument("Cannot parse tensor from response");
@@ -88,6 +138,8 @@ Status TensorResponse::ParseFrom(Source* source) {
     if (!meta_.ParseFromCodedStream(&input) || !input.ConsumedEntireMessage()) {
       return errors::InvalidArgument("Cannot parse tensor from response");
     }
+    TF_RETURN_IF_ERROR(
+        DecompressTensorProto(meta_.compression(), meta_.mutable_tensor()));
     Status s =
         device_->MakeTensorFromProto(meta_.tensor(), alloc_attrs_, &tensor_);
     // Reduce memory usage for big tensors.
@@ -197,6 +249,17 @@ bool TensorResponse::ParseTensorSubmessage(
         seen_tensor_content = true;
         TensorShape shape(tensor_meta->tensor_shape());
         Tensor t(allocator_, tensor_meta->dtype(), shape);
+        if (meta_.compression() != RECV_TENSOR_COMPRESSION_NONE) {
+          // The compression field precedes the tensor in the encodings that
+          // the fast path accepts.
+          string compressed;
+          if (!input->ReadString(&compressed, num_bytes) ||
+              !DecompressTensorContent(meta_.compression(), compressed, &t)) {
+            return false;
+          }
+          tensor_ = std::move(t);
+          break;
+        }
         StringPiece buf = t.tensor_data();
         if (static_cast<size_t>(num_bytes) != buf.size()) return false;
         // TODO(jeff,sanjay): Figure out a way to avoid this copy if
@@ -267,6 +330,13 @@ bool TensorResponse::ParseFast(Source* source) {
         meta_.set_require_ack(v != 0);
         break;
       }
+      case RecvTensorResponse::kCompressionFieldNumber: {
+        uint32 v;
+        if ((wt != WIRETYPE_VARINT) || !input.ReadVarint32(&v)) return false;
+        if (meta_.has_tensor()) return false;
+        meta_.set_compression(static_cast<RecvTensorCompression>(v));
+        break;
+      }
       default: {
         // Unknown tag, so don't handle we can't handle on the fast path
         return false;
@@ -281,6 +351,10 @@ bool TensorResponse::ParseSlow(Source* source) {
   if (!meta_.ParseFromZeroCopyStream(source->contents())) {
     return false;
   }
+  if (!DecompressTensorProto(meta_.compression(), meta_.mutable_tensor())
+           .ok()) {
+    return false;
+  }
 
   Tensor parsed(meta_.tensor().dtype());
   if (!parsed.FromProto(allocator_, meta_.tensor())) {
@@ -298,4 +372,71 @@ bool TensorResponse::ParseSlow(Source* source) {
   return true;
 }
 
+RecvTensorCompression CompressTensorContent(const Tensor& val,
+                                            RecvTensorCompression accepted,
+                                            string* compressed) {
+  const StringPiece content = val.tensor_data();
+  if (accepted == RECV_TENSOR_COMPRESSION_NONE ||
+      content.size() < kMinCompressedTensorBytes) {
+    return RECV_TENSOR_COMPRESSION_NONE;
+  }
+  if (accepted == RECV_TENSOR_COMPRESSION_BFLOAT16 &&
+      val.dtype() == DT_FLOAT) {
+    const int64 num_elements = val.NumElements();
+    compressed->resize(num_elements * sizeof(bfloat16));
+    const float* src = val.flat<float>().data();
+    bfloat16* dst = reinterpret_cast<bfloat16*>(&(*compressed)[0]);
+    for (int64 i = 0; i < num_elements; ++i) {
+      dst[i] = bfloat16(src[i]);
+    }
+    return RECV_TENSOR_COMPRESSION_BFLOAT16;
+  }
+  if (IsLosslessCompressible(val.dtype()) &&
+      port::Snappy_Compress(content.data(), content.size(), compressed) &&
+      compressed->size() < content.size()) {
+    return RECV_TENSOR_COMPRESSION_LOSSLESS;
+  }
+  return RECV_TENSOR_COMPRESSION_NONE;
+}
+
+bool DecompressTensorContent(RecvTensorCompression compression,
+                             StringPiece content, Tensor* tensor) {
+  StringPiece buf = tensor->tensor_data();
+  switch (compression) {
+    case RECV_TENSOR_COMPRESSION_NONE:
+      if (content.size() != buf.size()) return false;
+      memcpy(const_cast<char*>(buf.data()), content.data(), content.size());
+      return true;
+    case RECV_TENSOR_COMPRESSION_LOSSLESS: {
+      if (!IsLosslessCompressible(tensor->dtype())) return false;
+      size_t uncompressed_size;
+      if (!port::Snappy_GetUncompressedLength(content.data(), content.size(),
+                                              &uncompressed_size) ||
+          uncompressed_size != buf.size()) {
+        return false;
+      }
+      return port::Snappy_Uncompress(content.data(), content.size(),
+                                     const_cast<char*>(buf.data()));
+    }
+    case RECV_TENSOR_COMPRESSION_BFLOAT16: {
+      const int64 num_elements = tensor->NumElements();
+      if (tensor->dtype() != DT_FLOAT ||
+          content.size() != num_elements * sizeof(bfloat16)) {
+        return false;
+      }
+      // The content of a protocol buffer needn't be aligned for bfloat16.
+      const char* src = content.data();
+      float* dst = tensor->flat<float>().data();
+      for (int64 i = 0; i < num_elements; ++i) {
+        bfloat16 value;
+        memcpy(&value, src + i * sizeof(bfloat16), sizeof(bfloat16));
+        dst[i] = static_cast<float>(value);
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
 }  // namespace tensorflow
@@ -106,6 +106,20 @@ class TensorResponse {
   RecvTensorResponse meta_;
 };
 
+// Compresses the contents of "val" into "*compressed" with the compression
+// that "accepted" allows for the dtype of "val". Returns the compression that
+// was applied, which is RECV_TENSOR_COMPRESSION_NONE if none applies, or if
+// "val" is too small or doesn't compress.
+RecvTensorCompression CompressTensorContent(const Tensor& val,
+                                            RecvTensorCompression accepted,
+                                            string* compressed);
+
+// Decodes "content", the contents of a tensor compressed with "compression",
+// into "*tensor", which must already have the dtype and shape of the tensor.
+// Returns false if "content" is not a valid encoding of such a tensor.
+bool DecompressTensorContent(RecvTensorCompression compression,
+                             StringPiece content, Tensor* tensor);
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_TENSOR_CODING_H_
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
@@ -156,6 +157,93 @@ TEST_F(TensorResponseTest, Simple) {
 
 TEST_F(TensorResponseTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+// Encodes "src" compressed with "compression" as a RecvTensorResponse, and
+// returns the tensor that TensorResponse decodes from it. If
+// "compression_first", the compression field precedes the tensor, as in the
+// gRPC encoding, which TensorResponse parses on its fast path.
+Tensor EncodeAndDecodeCompressed(const Tensor& src,
+                                 RecvTensorCompression compression,
+                                 bool compression_first) {
+  string compressed;
+  EXPECT_EQ(compression, CompressTensorContent(src, compression, &compressed));
+  RecvTensorResponse meta;
+  meta.set_send_start_micros(123456);
+  meta.set_compression(compression);
+  RecvTensorResponse tensor;
+  src.AsProtoTensorContent(tensor.mutable_tensor());
+  tensor.mutable_tensor()->set_tensor_content(compressed);
+  string encoded;
+  if (compression_first) {
+    meta.AppendToString(&encoded);
+    tensor.AppendToString(&encoded);
+  } else {
+    tensor.MergeFrom(meta);
+    tensor.AppendToString(&encoded);
+  }
+
+  StringSource source(&encoded, 1024);
+  TensorResponse response;
+  DummyDevice cpu_device(Env::Default());
+  response.InitAlloc(&cpu_device, AllocatorAttributes());
+  TF_EXPECT_OK(response.ParseFrom(&source));
+  EXPECT_EQ(response.metadata().send_start_micros(), 123456);
+  EXPECT_EQ(response.metadata().compression(), compression);
+  return response.tensor();
+}
+
+TEST_F(TensorResponseTest, LosslessCompression) {
+  Tensor src(DT_INT32, TensorShape({64, 64}));
+  auto flat = src.flat<int32>();
+  for (int i = 0; i < flat.size(); ++i) {
+    flat(i) = i % 10;
+  }
+  for (bool compression_first : {false, true}) {
+    test::ExpectTensorEqual<int32>(
+        src, EncodeAndDecodeCompressed(src, RECV_TENSOR_COMPRESSION_LOSSLESS,
+                                       compression_first));
+  }
+}
+
+TEST_F(TensorResponseTest, Bfloat16Compression) {
+  Tensor src(DT_FLOAT, TensorShape({64, 64}));
+  auto flat = src.flat<float>();
+  for (int i = 0; i < flat.size(); ++i) {
+    flat(i) = 0.001f * i - 1.0f;
+  }
+  for (bool compression_first : {false, true}) {
+    Tensor result = EncodeAndDecodeCompressed(
+        src, RECV_TENSOR_COMPRESSION_BFLOAT16, compression_first);
+    test::ExpectClose(src, result, /*atol=*/0, /*rtol=*/1.0 / 256);
+  }
+}
+
+TEST_F(TensorResponseTest, CompressionAppliesPerDtype) {
+  string compressed;
+  Tensor small_ints(DT_INT32, TensorShape({16}));
+  small_ints.flat<int32>().setZero();
+  EXPECT_EQ(RECV_TENSOR_COMPRESSION_NONE,
+            CompressTensorContent(
+                small_ints, RECV_TENSOR_COMPRESSION_LOSSLESS, &compressed));
+
+  Tensor ints(DT_INT64, TensorShape({1024}));
+  ints.flat<int64>().setZero();
+  EXPECT_EQ(RECV_TENSOR_COMPRESSION_LOSSLESS,
+            CompressTensorContent(ints, RECV_TENSOR_COMPRESSION_BFLOAT16,
+                                  &compressed));
+
+  Tensor floats(DT_FLOAT, TensorShape({1024}));
+  floats.flat<float>().setZero();
+  EXPECT_EQ(RECV_TENSOR_COMPRESSION_NONE,
+            CompressTensorContent(floats, RECV_TENSOR_COMPRESSION_LOSSLESS,
+                                  &compressed));
+
+  Tensor doubles(DT_DOUBLE, TensorShape({1024}));
+  doubles.flat<double>().setZero();
+  EXPECT_EQ(RECV_TENSOR_COMPRESSION_NONE,
+            CompressTensorContent(doubles, RECV_TENSOR_COMPRESSION_BFLOAT16,
+                                  &compressed));
+}
+
 string MakeFloatTensorTestCase(int num_elems) {
   std::vector<int8> v(num_elems);
   for (int i = 0; i < num_elems; i++) {
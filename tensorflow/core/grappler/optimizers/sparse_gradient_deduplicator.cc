@@ -0,0 +1,258 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/sparse_gradient_deduplicator.h"
+
+#include <unordered_set>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/costs/graph_properties.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/mutable_graph_view.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+constexpr char kUniqueSegmentSum[] = "_UniqueSegmentSum";
+
+bool IsSupportedType(DataType dtype) {
+  return dtype == DT_HALF || dtype == DT_BFLOAT16 || dtype == DT_FLOAT ||
+         dtype == DT_DOUBLE;
+}
+
+// Returns whether a gradient computed on `gradient_device` is sent over the
+// network to `consumer_device`, and _UniqueSegmentSum can run on
+// `gradient_device`.
+bool IsRemoteGradientOnCpu(const string& gradient_device,
+                           const string& consumer_device) {
+  DeviceNameUtils::ParsedName parsed;
+  if (gradient_device.empty() || consumer_device.empty() ||
+      !DeviceNameUtils::ParseFullName(gradient_device, &parsed) ||
+      !parsed.has_type || parsed.type != DEVICE_CPU) {
+    return false;
+  }
+  return !DeviceNameUtils::IsSameAddressSpace(gradient_device,
+                                              consumer_device);
+}
+
+// A _UniqueSegmentSum to insert on the device of the gradient.
+struct Deduplication {
+  // The node whose inputs are the sparse gradient.
+  const NodeDef* consumer;
+  string data;
+  string indices;
+  string device;
+  DataType dtype;
+  DataType index_type;
+  // For Unique followed by UnsortedSegmentSum, the Unique, which is replaced
+  // along with the UnsortedSegmentSum `consumer`.  Otherwise nullptr.
+  const NodeDef* unique = nullptr;
+};
+
+// ResourceScatterAdd and ResourceScatterSub are linear in their updates, so
+// summing duplicate updates first only changes the order of the additions.
+// The shapes of the indices and updates are checked once they are inferred.
+bool FindScatterDeduplication(const MutableGraphView& graph,
+                              const NodeDef& node,
+                              Deduplication* deduplication) {
+  if (node.op() != "ResourceScatterAdd" && node.op() != "ResourceScatterSub") {
+    return false;
+  }
+  const NodeDef* indices = graph.GetNode(NodeName(node.input(1)));
+  const NodeDef* updates = graph.GetNode(NodeName(node.input(2)));
+  if (indices == nullptr || updates == nullptr ||
+      updates->op() == kUniqueSegmentSum ||
+      indices->device() != updates->device() ||
+      !IsRemoteGradientOnCpu(updates->device(), node.device()) ||
+      !IsSupportedType(node.attr().at("dtype").type())) {
+    return false;
+  }
+  deduplication->consumer = &node;
+  deduplication->data = node.input(2);
+  deduplication->indices = node.input(1);
+  deduplication->device = updates->device();
+  deduplication->dtype = node.attr().at("dtype").type();
+  deduplication->index_type = node.attr().at("Tindices").type();
+  return true;
+}
+
+// Matches UnsortedSegmentSum(data, Unique(indices):1, num_segments) next to
+// the consumer of the gradient, with data and indices from another host.
+bool FindSegmentSumDeduplication(const MutableGraphView& graph,
+                                 const NodeDef& node,
+                                 Deduplication* deduplication) {
+  if (node.op() != "UnsortedSegmentSum") {
+    return false;
+  }
+  int unique_port;
+  const NodeDef* unique =
+      graph.GetNode(ParseNodeName(node.input(1), &unique_port));
+  if (unique == nullptr || !IsUnique(*unique) || unique_port != 1 ||
+      unique->device() != node.device()) {
+    return false;
+  }
+  const NodeDef* data = graph.GetNode(NodeName(node.input(0)));
+  const NodeDef* indices = graph.GetNode(NodeName(unique->input(0)));
+  if (data == nullptr || indices == nullptr ||
+      data->device() != indices->device() ||
+      !IsRemoteGradientOnCpu(data->device(), node.device()) ||
+      !IsSupportedType(node.attr().at("T").type())) {
+    return false;
+  }
+  deduplication->consumer = &node;
+  deduplication->data = node.input(0);
+  deduplication->indices = unique->input(0);
+  deduplication->device = data->device();
+  deduplication->dtype = node.attr().at("T").type();
+  deduplication->index_type = unique->attr().at("T").type();
+  deduplication->unique = unique;
+  return true;
+}
+
+// Moves the consumers of `from` to `to`.
+Status UpdateFanouts(MutableGraphView* graph, const NodeDef* from_node,
+                     int from_port, const string& to_node, int to_port) {
+  const auto fanouts =
+      graph->GetFanout(MutableGraphView::OutputPort(from_node, from_port));
+  // Copy the fanouts, since updating them invalidates the set.
+  const std::vector<MutableGraphView::InputPort> inputs(fanouts.begin(),
+                                                        fanouts.end());
+  for (const MutableGraphView::InputPort& input : inputs) {
+    TF_RETURN_IF_ERROR(graph->UpdateRegularFaninByPort(
+        input.node->name(), input.port_id, {to_node, to_port}));
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+Status SparseGradientDeduplicator::Optimize(Cluster* cluster,
+                                            const GrapplerItem& item,
+                                            GraphDef* optimized_graph) {
+  *optimized_graph = item.graph;
+  MutableGraphView graph(optimized_graph);
+
+  std::vector<Deduplication> deduplications;
+  for (const NodeDef& node : optimized_graph->node()) {
+    Deduplication deduplication;
+    if (FindScatterDeduplication(graph, node, &deduplication) ||
+        FindSegmentSumDeduplication(graph, node, &deduplication)) {
+      deduplications.push_back(deduplication);
+    }
+  }
+  if (deduplications.empty()) {
+    return errors::Aborted("Nothing to do.");
+  }
+
+  // _UniqueSegmentSum takes a vector of indices and one row of data per index,
+  // which is always the case for the inputs of Unique and UnsortedSegmentSum,
+  // but not for a scatter: its indices may have any rank, and a scalar update
+  // is added to the row of every index.
+  GraphProperties properties(item);
+  bool inferred_properties = false;
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  auto is_preserved = [&nodes_to_preserve](const NodeDef* node) {
+    return nodes_to_preserve.find(node->name()) != nodes_to_preserve.end();
+  };
+  absl::flat_hash_set<string> nodes_to_delete;
+
+  for (const Deduplication& deduplication : deduplications) {
+    const NodeDef& consumer = *deduplication.consumer;
+    if (deduplication.unique == nullptr) {
+      if (!inferred_properties) {
+        TF_RETURN_IF_ERROR(properties.InferStatically(
+            /*assume_valid_feeds=*/false,
+            /*aggressive_shape_inference=*/false,
+            /*include_tensor_values=*/false));
+        inferred_properties = true;
+      }
+      const auto& inputs = properties.GetInputProperties(consumer.name());
+      if (inputs.size() < 3 || inputs[1].shape().unknown_rank() ||
+          inputs[1].shape().dim_size() != 1 ||
+          inputs[2].shape().unknown_rank() ||
+          inputs[2].shape().dim_size() < 1) {
+        continue;
+      }
+      // Unknown dimensions are numbered symbolically, so that two equal ones
+      // have the same negative size.
+      const int64 num_indices = inputs[1].shape().dim(0).size();
+      if (num_indices == -1 ||
+          inputs[2].shape().dim(0).size() != num_indices) {
+        continue;
+      }
+    }
+
+    NodeDef dedup;
+    dedup.set_name(AddPrefixToNodeName(consumer.name(), "SparseGradientDedup"));
+    if (graph.GetNode(dedup.name()) != nullptr) {
+      continue;
+    }
+    dedup.set_op(kUniqueSegmentSum);
+    dedup.set_device(deduplication.device);
+    dedup.add_input(deduplication.data);
+    dedup.add_input(deduplication.indices);
+    (*dedup.mutable_attr())["T"].set_type(deduplication.dtype);
+    (*dedup.mutable_attr())["Tindices"].set_type(deduplication.index_type);
+    const string dedup_name = graph.AddNode(std::move(dedup))->name();
+    VLOG(2) << "Deduplicating the sparse gradient of " << consumer.name()
+            << " with " << dedup_name;
+
+    if (deduplication.unique == nullptr) {
+      // ResourceScatterAdd(resource, indices, updates).
+      TF_RETURN_IF_ERROR(
+          graph.UpdateRegularFaninByPort(consumer.name(), 1, {dedup_name, 0}));
+      TF_RETURN_IF_ERROR(
+          graph.UpdateRegularFaninByPort(consumer.name(), 2, {dedup_name, 1}));
+      continue;
+    }
+    // Unique(indices) and UnsortedSegmentSum(data, ...) are replaced, and
+    // deleted unless something else depends on them.
+    const NodeDef* unique = deduplication.unique;
+    TF_RETURN_IF_ERROR(UpdateFanouts(&graph, &consumer, 0, dedup_name, 1));
+    TF_RETURN_IF_ERROR(UpdateFanouts(&graph, unique, 0, dedup_name, 0));
+    if (is_preserved(&consumer) ||
+        !graph.GetFanouts(consumer, /*include_controlled_nodes=*/true)
+             .empty()) {
+      continue;
+    }
+    nodes_to_delete.insert(consumer.name());
+    bool unique_has_other_fanouts = false;
+    for (const MutableGraphView::InputPort& fanout :
+         graph.GetFanouts(*unique, /*include_controlled_nodes=*/true)) {
+      if (fanout.node != &consumer) {
+        unique_has_other_fanouts = true;
+        break;
+      }
+    }
+    if (!is_preserved(unique) && !unique_has_other_fanouts) {
+      nodes_to_delete.insert(unique->name());
+    }
+  }
+
+  return graph.DeleteNodes(nodes_to_delete);
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,55 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_SPARSE_GRADIENT_DEDUPLICATOR_H_
+#define TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_SPARSE_GRADIENT_DEDUPLICATOR_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+#include "tensorflow/core/protobuf/rewriter_config.pb.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Sums the duplicate rows of sparse gradients on the device that computes
+// them, before they are sent to the device of the variable, e.g. from a worker
+// to a parameter server.  Each rewrite inserts a _UniqueSegmentSum on the
+// device of the gradient, which must be a CPU:
+//
+// - The updates and indices of a ResourceScatterAdd or ResourceScatterSub
+//   from another device are replaced with their deduplicated values.
+// - Unique followed by UnsortedSegmentSum, which optimizers use to
+//   deduplicate the gradient of a ResourceSparseApply* op next to the
+//   variable, is moved to the device of the gradient.
+class SparseGradientDeduplicator : public GraphOptimizer {
+ public:
+  SparseGradientDeduplicator() = default;
+  explicit SparseGradientDeduplicator(RewriterConfig::Toggle opt_level) {}
+  ~SparseGradientDeduplicator() override = default;
+
+  string name() const override { return "sparse_gradient_deduplicator"; };
+
+  bool UsesFunctionLibrary() const override { return false; }
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override {}
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_OPTIMIZERS_SPARSE_GRADIENT_DEDUPLICATOR_H_
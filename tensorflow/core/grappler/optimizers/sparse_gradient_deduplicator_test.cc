@@ -0,0 +1,214 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/sparse_gradient_deduplicator.h"
+
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+using test::function::NDef;
+
+constexpr char kWorker[] = "/job:worker/replica:0/task:0/device:CPU:0";
+constexpr char kWorkerGpu[] = "/job:worker/replica:0/task:0/device:GPU:0";
+constexpr char kPs[] = "/job:ps/replica:0/task:0/device:CPU:0";
+
+class SparseGradientDeduplicatorTest : public GrapplerTest {
+ protected:
+  // A ResourceScatterAdd on the parameter server, to a variable of shape
+  // [10, 4], of updates computed on `gradient_device`.
+  GraphDef ScatterAddGraph(
+      const string& gradient_device, const PartialTensorShape& indices_shape,
+      const PartialTensorShape& updates_shape = PartialTensorShape({-1, 4})) {
+    return test::function::GDef(
+        {NDef("var", "VarHandleOp", {},
+              {{"dtype", DT_FLOAT},
+               {"shape", PartialTensorShape({10, 4})},
+               {"container", ""},
+               {"shared_name", "var"}},
+              kPs),
+         NDef("indices", "Placeholder", {},
+              {{"dtype", DT_INT64}, {"shape", indices_shape}}, gradient_device),
+         NDef("updates", "Placeholder", {},
+              {{"dtype", DT_FLOAT}, {"shape", updates_shape}},
+              gradient_device),
+         NDef("scatter", "ResourceScatterAdd", {"var", "indices", "updates"},
+              {{"dtype", DT_FLOAT}, {"Tindices", DT_INT64}}, kPs)},
+        {});
+  }
+
+  const NodeDef* FindNode(const GraphDef& graph, const string& name) {
+    for (const NodeDef& node : graph.node()) {
+      if (node.name() == name) return &node;
+    }
+    return nullptr;
+  }
+};
+
+TEST_F(SparseGradientDeduplicatorTest, ScatterAddFromAnotherTask) {
+  GrapplerItem item;
+  item.graph = ScatterAddGraph(kWorker, PartialTensorShape({-1}));
+
+  SparseGradientDeduplicator optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(output.node_size(), 5);
+  const NodeDef* dedup = FindNode(output, "SparseGradientDedup/scatter");
+  ASSERT_NE(dedup, nullptr);
+  EXPECT_EQ(dedup->op(), "_UniqueSegmentSum");
+  EXPECT_EQ(dedup->device(), kWorker);
+  ASSERT_EQ(dedup->input_size(), 2);
+  EXPECT_EQ(dedup->input(0), "updates");
+  EXPECT_EQ(dedup->input(1), "indices");
+  EXPECT_EQ(dedup->attr().at("T").type(), DT_FLOAT);
+  EXPECT_EQ(dedup->attr().at("Tindices").type(), DT_INT64);
+
+  const NodeDef* scatter = FindNode(output, "scatter");
+  ASSERT_NE(scatter, nullptr);
+  ASSERT_EQ(scatter->input_size(), 3);
+  EXPECT_EQ(scatter->input(0), "var");
+  EXPECT_EQ(scatter->input(1), "SparseGradientDedup/scatter");
+  EXPECT_EQ(scatter->input(2), "SparseGradientDedup/scatter:1");
+}
+
+TEST_F(SparseGradientDeduplicatorTest, ScatterAddWithMatrixIndices) {
+  GrapplerItem item;
+  item.graph = ScatterAddGraph(kWorker, PartialTensorShape({-1, 2}),
+                               PartialTensorShape({-1, 2, 4}));
+
+  SparseGradientDeduplicator optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+TEST_F(SparseGradientDeduplicatorTest, ScatterAddWithScalarUpdates) {
+  GrapplerItem item;
+  item.graph = ScatterAddGraph(kWorker, PartialTensorShape({-1}),
+                               PartialTensorShape({}));
+
+  SparseGradientDeduplicator optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  CompareGraphs(item.graph, output);
+}
+
+TEST_F(SparseGradientDeduplicatorTest, ScatterAddFromSameTask) {
+  GrapplerItem item;
+  item.graph = ScatterAddGraph(kPs, PartialTensorShape({-1}));
+
+  SparseGradientDeduplicator optimizer;
+  GraphDef output;
+  Status status = optimizer.Optimize(nullptr, item, &output);
+  EXPECT_TRUE(errors::IsAborted(status)) << status;
+}
+
+TEST_F(SparseGradientDeduplicatorTest, ScatterAddFromGpu) {
+  GrapplerItem item;
+  item.graph = ScatterAddGraph(kWorkerGpu, PartialTensorShape({-1}));
+
+  SparseGradientDeduplicator optimizer;
+  GraphDef output;
+  Status status = optimizer.Optimize(nullptr, item, &output);
+  EXPECT_TRUE(errors::IsAborted(status)) << status;
+}
+
+TEST_F(SparseGradientDeduplicatorTest, UniqueSegmentSumMovedToAnotherTask) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("indices", "Placeholder", {}, {{"dtype", DT_INT64}}, kWorker),
+       NDef("updates", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kWorker),
+       NDef("unique", "Unique", {"indices"},
+            {{"T", DT_INT64}, {"out_idx", DT_INT32}}, kPs),
+       NDef("num_segments", "Size", {"unique"},
+            {{"T", DT_INT64}, {"out_type", DT_INT32}}, kPs),
+       NDef("sum", "UnsortedSegmentSum",
+            {"updates", "unique:1", "num_segments"},
+            {{"T", DT_FLOAT},
+             {"Tindices", DT_INT32},
+             {"Tnumsegments", DT_INT32}},
+            kPs),
+       NDef("apply_updates", "Identity", {"sum"}, {{"T", DT_FLOAT}}, kPs),
+       NDef("apply_indices", "Identity", {"unique"}, {{"T", DT_INT64}}, kPs)},
+      {});
+  item.fetch = {"apply_updates", "apply_indices"};
+
+  SparseGradientDeduplicator optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(FindNode(output, "unique"), nullptr);
+  EXPECT_EQ(FindNode(output, "sum"), nullptr);
+  const NodeDef* dedup = FindNode(output, "SparseGradientDedup/sum");
+  ASSERT_NE(dedup, nullptr);
+  EXPECT_EQ(dedup->op(), "_UniqueSegmentSum");
+  EXPECT_EQ(dedup->device(), kWorker);
+  ASSERT_EQ(dedup->input_size(), 2);
+  EXPECT_EQ(dedup->input(0), "updates");
+  EXPECT_EQ(dedup->input(1), "indices");
+
+  const NodeDef* num_segments = FindNode(output, "num_segments");
+  ASSERT_NE(num_segments, nullptr);
+  EXPECT_EQ(num_segments->input(0), "SparseGradientDedup/sum");
+  const NodeDef* apply_updates = FindNode(output, "apply_updates");
+  ASSERT_NE(apply_updates, nullptr);
+  EXPECT_EQ(apply_updates->input(0), "SparseGradientDedup/sum:1");
+  const NodeDef* apply_indices = FindNode(output, "apply_indices");
+  ASSERT_NE(apply_indices, nullptr);
+  EXPECT_EQ(apply_indices->input(0), "SparseGradientDedup/sum");
+}
+
+TEST_F(SparseGradientDeduplicatorTest, PreservedUniqueIsKept) {
+  GrapplerItem item;
+  item.graph = test::function::GDef(
+      {NDef("indices", "Placeholder", {}, {{"dtype", DT_INT64}}, kWorker),
+       NDef("updates", "Placeholder", {}, {{"dtype", DT_FLOAT}}, kWorker),
+       NDef("unique", "Unique", {"indices"},
+            {{"T", DT_INT64}, {"out_idx", DT_INT32}}, kPs),
+       NDef("num_segments", "Placeholder", {}, {{"dtype", DT_INT32}}, kPs),
+       NDef("sum", "UnsortedSegmentSum",
+            {"updates", "unique:1", "num_segments"},
+            {{"T", DT_FLOAT},
+             {"Tindices", DT_INT32},
+             {"Tnumsegments", DT_INT32}},
+            kPs),
+       NDef("apply_updates", "Identity", {"sum"}, {{"T", DT_FLOAT}}, kPs)},
+      {});
+  item.fetch = {"apply_updates", "unique"};
+
+  SparseGradientDeduplicator optimizer;
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_NE(FindNode(output, "unique"), nullptr);
+  EXPECT_EQ(FindNode(output, "sum"), nullptr);
+  const NodeDef* apply_updates = FindNode(output, "apply_updates");
+  ASSERT_NE(apply_updates, nullptr);
+  EXPECT_EQ(apply_updates->input(0), "SparseGradientDedup/sum:1");
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -0,0 +1,354 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/lookup_ops.cc.
+
+#include <cmath>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/hash_embedding_variable.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/refcount.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Returns keys.shape + [embedding_dim].
+TensorShape EmbeddingShape(const Tensor& keys, int64 embedding_dim) {
+  TensorShape shape = keys.shape();
+  shape.AddDim(embedding_dim);
+  return shape;
+}
+
+}  // namespace
+
+template <typename T>
+class HashEmbeddingVariableOp : public OpKernel {
+ public:
+  explicit HashEmbeddingVariableOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("container", &container_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("shared_name", &name_));
+    if (name_.empty()) {
+      name_ = name();
+    }
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr("embedding_dim", &options_.embedding_dim));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_slots", &options_.num_slots));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("slot_initial_value",
+                                     &options_.slot_initial_value));
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr("min_frequency", &options_.min_frequency));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("ttl_steps", &options_.ttl_steps));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("max_size", &options_.max_size));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const string container = container_.empty()
+                                 ? ctx->resource_manager()->default_container()
+                                 : container_;
+    HashEmbeddingVariable<T>* variable;
+    OP_REQUIRES_OK(
+        ctx, ctx->resource_manager()->LookupOrCreate<HashEmbeddingVariable<T>>(
+                 container, name_, &variable,
+                 [this](HashEmbeddingVariable<T>** ret) {
+                   *ret = new HashEmbeddingVariable<T>(options_);
+                   return Status::OK();
+                 }));
+    core::ScopedUnref unref(variable);
+    OP_REQUIRES(
+        ctx,
+        variable->options().embedding_dim == options_.embedding_dim &&
+            variable->options().num_slots == options_.num_slots,
+        errors::InvalidArgument(
+            "HashEmbeddingVariable ", name_, " already exists with ",
+            "embedding_dim ", variable->options().embedding_dim,
+            " and num_slots ", variable->options().num_slots));
+
+    AllocatorAttributes attr;
+    attr.set_on_host(true);
+    Tensor* handle;
+    OP_REQUIRES_OK(ctx,
+                   ctx->allocate_output(0, TensorShape({}), &handle, attr));
+    handle->scalar<ResourceHandle>()() =
+        MakeResourceHandle<HashEmbeddingVariable<T>>(ctx, container, name_);
+  }
+
+  bool IsExpensive() override { return false; }
+
+ private:
+  string container_;
+  string name_;
+  HashEmbeddingOptions options_;
+};
+
+template <typename T>
+class HashEmbeddingGatherOp : public OpKernel {
+ public:
+  explicit HashEmbeddingGatherOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("insert_missing", &insert_missing_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    core::RefCountPtr<HashEmbeddingVariable<T>> variable;
+    OP_REQUIRES_OK(ctx,
+                   LookupResource(ctx, HandleFromInput(ctx, 0), &variable));
+    const Tensor& keys = ctx->input(1);
+    const Tensor& default_value = ctx->input(2);
+    const int64 dim = variable->options().embedding_dim;
+    const TensorShape output_shape = EmbeddingShape(keys, dim);
+    const bool default_per_key = default_value.shape() == output_shape;
+    OP_REQUIRES(
+        ctx,
+        default_per_key || default_value.shape() == TensorShape({dim}),
+        errors::InvalidArgument(
+            "default_value must have shape [", dim, "] or ",
+            output_shape.DebugString(), ", got ",
+            default_value.shape().DebugString()));
+
+    Tensor* output;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, output_shape, &output));
+    if (keys.NumElements() == 0) {
+      return;
+    }
+    variable->Gather(*ctx->device()->tensorflow_cpu_worker_threads(),
+                     keys.flat<int64>().data(), keys.NumElements(),
+                     insert_missing_, default_value.flat<T>().data(),
+                     default_per_key, output->flat<T>().data());
+  }
+
+ private:
+  bool insert_missing_;
+};
+
+// Validates the inputs of a sparse apply op, and calls `update(value, slots,
+// grad, embedding_dim)` for the row of each of its keys, where `grad` is the
+// gradient of the key.
+template <typename T, typename Update>
+void HashEmbeddingSparseApply(OpKernelContext* ctx, int64 min_slots,
+                              int64 cost_per_element, const Update& update) {
+  core::RefCountPtr<HashEmbeddingVariable<T>> variable;
+  OP_REQUIRES_OK(ctx, LookupResource(ctx, HandleFromInput(ctx, 0), &variable));
+  const Tensor& keys = ctx->input(1);
+  const Tensor& grad = ctx->input(2);
+  const int64 dim = variable->options().embedding_dim;
+  OP_REQUIRES(ctx, variable->options().num_slots >= min_slots,
+              errors::InvalidArgument("The variable must have at least ",
+                                      min_slots, " slots, got ",
+                                      variable->options().num_slots));
+  OP_REQUIRES(ctx, grad.shape() == EmbeddingShape(keys, dim),
+              errors::InvalidArgument(
+                  "grad must have shape ",
+                  EmbeddingShape(keys, dim).DebugString(), ", got ",
+                  grad.shape().DebugString()));
+  if (keys.NumElements() == 0) {
+    return;
+  }
+  const T* grad_ptr = grad.flat<T>().data();
+  variable->Update(*ctx->device()->tensorflow_cpu_worker_threads(),
+                   keys.flat<int64>().data(), keys.NumElements(),
+                   cost_per_element * dim,
+                   [&](int64 i, T* value, T* slots) {
+                     update(value, slots, grad_ptr + i * dim, dim);
+                   });
+}
+
+template <typename T>
+class HashEmbeddingSparseApplyGradientDescentOp : public OpKernel {
+ public:
+  using OpKernel::OpKernel;
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& lr = ctx->input(3);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(lr.shape()),
+                errors::InvalidArgument("lr is not a scalar: ",
+                                        lr.shape().DebugString()));
+    const T lr_scalar = lr.scalar<T>()();
+    HashEmbeddingSparseApply<T>(
+        ctx, /*min_slots=*/0, /*cost_per_element=*/2,
+        [lr_scalar](T* value, T* slots, const T* grad, int64 dim) {
+          for (int64 j = 0; j < dim; ++j) {
+            value[j] -= lr_scalar * grad[j];
+          }
+        });
+  }
+};
+
+template <typename T>
+class HashEmbeddingSparseApplyAdagradOp : public OpKernel {
+ public:
+  using OpKernel::OpKernel;
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& lr = ctx->input(3);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(lr.shape()),
+                errors::InvalidArgument("lr is not a scalar: ",
+                                        lr.shape().DebugString()));
+    const T lr_scalar = lr.scalar<T>()();
+    // The first slot is the accumulator.
+    HashEmbeddingSparseApply<T>(
+        ctx, /*min_slots=*/1, /*cost_per_element=*/6,
+        [lr_scalar](T* value, T* slots, const T* grad, int64 dim) {
+          for (int64 j = 0; j < dim; ++j) {
+            slots[j] += grad[j] * grad[j];
+            value[j] -= lr_scalar * grad[j] / std::sqrt(slots[j]);
+          }
+        });
+  }
+};
+
+template <typename T>
+class HashEmbeddingEvictOp : public OpKernel {
+ public:
+  using OpKernel::OpKernel;
+
+  void Compute(OpKernelContext* ctx) override {
+    core::RefCountPtr<HashEmbeddingVariable<T>> variable;
+    OP_REQUIRES_OK(ctx,
+                   LookupResource(ctx, HandleFromInput(ctx, 0), &variable));
+    Tensor* num_evicted;
+    OP_REQUIRES_OK(ctx,
+                   ctx->allocate_output(0, TensorShape({}), &num_evicted));
+    num_evicted->scalar<int64>()() = variable->Evict();
+  }
+};
+
+template <typename T>
+class HashEmbeddingSizeOp : public OpKernel {
+ public:
+  using OpKernel::OpKernel;
+
+  void Compute(OpKernelContext* ctx) override {
+    core::RefCountPtr<HashEmbeddingVariable<T>> variable;
+    OP_REQUIRES_OK(ctx,
+                   LookupResource(ctx, HandleFromInput(ctx, 0), &variable));
+    Tensor* size;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({}), &size));
+    size->scalar<int64>()() = variable->size();
+  }
+
+  bool IsExpensive() override { return false; }
+};
+
+template <typename T>
+class HashEmbeddingExportOp : public OpKernel {
+ public:
+  using OpKernel::OpKernel;
+
+  void Compute(OpKernelContext* ctx) override {
+    core::RefCountPtr<HashEmbeddingVariable<T>> variable;
+    OP_REQUIRES_OK(ctx,
+                   LookupResource(ctx, HandleFromInput(ctx, 0), &variable));
+    const int64 dim = variable->options().embedding_dim;
+    const int64 num_slots = variable->options().num_slots;
+    OP_REQUIRES_OK(
+        ctx,
+        variable->Export(
+            [ctx, dim, num_slots](
+                int64 num_rows,
+                typename HashEmbeddingVariable<T>::ExportBuffers* buffers) {
+              Tensor* keys;
+              TF_RETURN_IF_ERROR(ctx->allocate_output(
+                  0, TensorShape({num_rows}), &keys));
+              Tensor* values;
+              TF_RETURN_IF_ERROR(ctx->allocate_output(
+                  1, TensorShape({num_rows, dim}), &values));
+              Tensor* slots;
+              TF_RETURN_IF_ERROR(ctx->allocate_output(
+                  2, TensorShape({num_rows, num_slots, dim}), &slots));
+              Tensor* frequencies;
+              TF_RETURN_IF_ERROR(ctx->allocate_output(
+                  3, TensorShape({num_rows}), &frequencies));
+              Tensor* last_steps;
+              TF_RETURN_IF_ERROR(ctx->allocate_output(
+                  4, TensorShape({num_rows}), &last_steps));
+              buffers->keys = keys->flat<int64>().data();
+              buffers->values = values->flat<T>().data();
+              buffers->slots = slots->flat<T>().data();
+              buffers->frequencies = frequencies->flat<int64>().data();
+              buffers->last_steps = last_steps->flat<int64>().data();
+              return Status::OK();
+            }));
+  }
+};
+
+template <typename T>
+class HashEmbeddingImportOp : public OpKernel {
+ public:
+  using OpKernel::OpKernel;
+
+  void Compute(OpKernelContext* ctx) override {
+    core::RefCountPtr<HashEmbeddingVariable<T>> variable;
+    OP_REQUIRES_OK(ctx,
+                   LookupResource(ctx, HandleFromInput(ctx, 0), &variable));
+    const Tensor& keys = ctx->input(1);
+    const Tensor& values = ctx->input(2);
+    const Tensor& slots = ctx->input(3);
+    const Tensor& frequencies = ctx->input(4);
+    const Tensor& last_steps = ctx->input(5);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(keys.shape()),
+                errors::InvalidArgument("keys must be a vector, got shape ",
+                                        keys.shape().DebugString()));
+    const int64 num_rows = keys.dim_size(0);
+    const int64 dim = variable->options().embedding_dim;
+    const int64 num_slots = variable->options().num_slots;
+    OP_REQUIRES(ctx, values.shape() == TensorShape({num_rows, dim}),
+                errors::InvalidArgument("values must have shape [", num_rows,
+                                        ", ", dim, "], got ",
+                                        values.shape().DebugString()));
+    OP_REQUIRES(
+        ctx, slots.shape() == TensorShape({num_rows, num_slots, dim}),
+        errors::InvalidArgument("slots must have shape [", num_rows, ", ",
+                                num_slots, ", ", dim, "], got ",
+                                slots.shape().DebugString()));
+    OP_REQUIRES(ctx,
+                frequencies.shape() == keys.shape() &&
+                    last_steps.shape() == keys.shape(),
+                errors::InvalidArgument(
+                    "frequencies and last_steps must have the shape of keys ",
+                    keys.shape().DebugString(), ", got ",
+                    frequencies.shape().DebugString(), " and ",
+                    last_steps.shape().DebugString()));
+    variable->Import(keys.flat<int64>().data(), values.flat<T>().data(),
+                     slots.flat<T>().data(), frequencies.flat<int64>().data(),
+                     last_steps.flat<int64>().data(), num_rows);
+  }
+};
+
+#define REGISTER_KERNEL(op, T) \
+  REGISTER_KERNEL_BUILDER(     \
+      Name(#op).Device(DEVICE_CPU).TypeConstraint<T>("dtype"), op##Op<T>)
+
+#define REGISTER_KERNELS(T)                                    \
+  REGISTER_KERNEL(HashEmbeddingVariable, T);                   \
+  REGISTER_KERNEL(HashEmbeddingGather, T);                     \
+  REGISTER_KERNEL(HashEmbeddingSparseApplyGradientDescent, T); \
+  REGISTER_KERNEL(HashEmbeddingSparseApplyAdagrad, T);         \
+  REGISTER_KERNEL(HashEmbeddingEvict, T);                      \
+  REGISTER_KERNEL(HashEmbeddingSize, T);                       \
+  REGISTER_KERNEL(HashEmbeddingExport, T);                     \
+  REGISTER_KERNEL(HashEmbeddingImport, T);
+
+TF_CALL_float(REGISTER_KERNELS);
+TF_CALL_double(REGISTER_KERNELS);
+
+#undef REGISTER_KERNELS
+#undef REGISTER_KERNEL
+
+}  // namespace tensorflow
@@ -0,0 +1,421 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/hash_embedding_variable.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// The outputs of HashEmbeddingVariable::Export.
+struct Exported {
+  std::vector<int64> keys;
+  std::vector<float> values;
+  std::vector<float> slots;
+  std::vector<int64> frequencies;
+  std::vector<int64> last_steps;
+};
+
+Exported ExportAll(HashEmbeddingVariable<float>* variable) {
+  const int64 dim = variable->options().embedding_dim;
+  const int64 num_slots = variable->options().num_slots;
+  Exported exported;
+  TF_CHECK_OK(variable->Export(
+      [&](int64 num_rows, HashEmbeddingVariable<float>::ExportBuffers* b) {
+        exported.keys.resize(num_rows);
+        exported.values.resize(num_rows * dim);
+        exported.slots.resize(num_rows * num_slots * dim);
+        exported.frequencies.resize(num_rows);
+        exported.last_steps.resize(num_rows);
+        b->keys = exported.keys.data();
+        b->values = exported.values.data();
+        b->slots = exported.slots.data();
+        b->frequencies = exported.frequencies.data();
+        b->last_steps = exported.last_steps.data();
+        return Status::OK();
+      }));
+  return exported;
+}
+
+class HashEmbeddingVariableTest : public ::testing::Test {
+ protected:
+  HashEmbeddingVariableTest() : pool_(Env::Default(), "test", 4) {
+    workers_.num_threads = 4;
+    workers_.workers = &pool_;
+  }
+
+  std::vector<float> Gather(HashEmbeddingVariable<float>* variable,
+                            const std::vector<int64>& keys,
+                            const std::vector<float>& default_value,
+                            bool insert_missing = true) {
+    const int64 dim = variable->options().embedding_dim;
+    std::vector<float> output(keys.size() * dim);
+    variable->Gather(workers_, keys.data(), keys.size(), insert_missing,
+                     default_value.data(),
+                     default_value.size() == output.size() && keys.size() > 1,
+                     output.data());
+    return output;
+  }
+
+  // Adds `delta` to the embedding of each of `keys`.
+  void Add(HashEmbeddingVariable<float>* variable,
+           const std::vector<int64>& keys, float delta) {
+    const int64 dim = variable->options().embedding_dim;
+    variable->Update(workers_, keys.data(), keys.size(), dim,
+                     [dim, delta](int64 i, float* value, float* slots) {
+                       for (int64 j = 0; j < dim; ++j) value[j] += delta;
+                     });
+  }
+
+  thread::ThreadPool pool_;
+  DeviceBase::CpuWorkerThreads workers_;
+};
+
+HashEmbeddingVariable<float>* NewVariable(int64 dim, int64 num_slots = 0) {
+  HashEmbeddingOptions options;
+  options.embedding_dim = dim;
+  options.num_slots = num_slots;
+  return new HashEmbeddingVariable<float>(options);
+}
+
+TEST_F(HashEmbeddingVariableTest, GatherInsertsMissingKeys) {
+  core::RefCountPtr<HashEmbeddingVariable<float>> variable(NewVariable(2));
+  EXPECT_EQ(Gather(variable.get(), {3, -7, 3}, {1, 2}),
+            std::vector<float>({1, 2, 1, 2, 1, 2}));
+  EXPECT_EQ(variable->size(), 2);
+
+  Add(variable.get(), {3, 3}, 1.0f);
+  EXPECT_EQ(Gather(variable.get(), {3, -7, 5}, {0, 0, 0, 0, 0, 0},
+                   /*insert_missing=*/false),
+            std::vector<float>({3, 4, 1, 2, 0, 0}));
+  EXPECT_EQ(variable->size(), 2);
+}
+
+TEST_F(HashEmbeddingVariableTest, MinFrequency) {
+  HashEmbeddingOptions options;
+  options.embedding_dim = 1;
+  options.min_frequency = 3;
+  core::RefCountPtr<HashEmbeddingVariable<float>> variable(
+      new HashEmbeddingVariable<float>(options));
+
+  Gather(variable.get(), {1, 1, 2}, {5});
+  EXPECT_EQ(variable->size(), 0);
+  // Updates skip the keys without a row.
+  Add(variable.get(), {1, 2}, 1.0f);
+  EXPECT_EQ(Gather(variable.get(), {1, 2}, {7, 8}),
+            std::vector<float>({7, 8}));
+  EXPECT_EQ(variable->size(), 1);
+  Add(variable.get(), {1, 2}, 1.0f);
+  EXPECT_EQ(Gather(variable.get(), {1, 2}, {0}, /*insert_missing=*/false),
+            std::vector<float>({8, 0}));
+}
+
+TEST_F(HashEmbeddingVariableTest, MinFrequencyBoundsCountingKeys) {
+  HashEmbeddingOptions options;
+  options.embedding_dim = 1;
+  options.min_frequency = 3;
+  options.max_counting_keys = 4 * HashEmbeddingVariable<float>::kNumShards;
+  core::RefCountPtr<HashEmbeddingVariable<float>> variable(
+      new HashEmbeddingVariable<float>(options));
+
+  // Gathers a key twice, and then many distinct keys once.
+  const int64 kFrequentKey = -1;
+  Gather(variable.get(), {kFrequentKey, kFrequentKey}, {0});
+  for (int64 batch = 0; batch < 20; ++batch) {
+    std::vector<int64> keys(1000);
+    for (int64 i = 0; i < keys.size(); ++i) {
+      keys[i] = batch * 1000 + i;
+    }
+    Gather(variable.get(), keys, {0});
+    EXPECT_LE(variable->num_counting_keys(), options.max_counting_keys);
+  }
+  EXPECT_EQ(variable->size(), 0);
+
+  // The more frequent key is still counted.
+  Gather(variable.get(), {kFrequentKey}, {0});
+  EXPECT_EQ(ExportAll(variable.get()).keys, std::vector<int64>({kFrequentKey}));
+}
+
+TEST_F(HashEmbeddingVariableTest, EvictExpiredKeys) {
+  HashEmbeddingOptions options;
+  options.embedding_dim = 1;
+  options.ttl_steps = 2;
+  core::RefCountPtr<HashEmbeddingVariable<float>> variable(
+      new HashEmbeddingVariable<float>(options));
+
+  Gather(variable.get(), {1, 2, 3}, {0});
+  Add(variable.get(), {1}, 1.0f);
+  Add(variable.get(), {2}, 1.0f);
+  EXPECT_EQ(variable->Evict(), 0);
+  Add(variable.get(), {2}, 1.0f);
+  // Key 3 was inserted 3 steps ago, and key 1 updated 2 steps ago.
+  EXPECT_EQ(variable->Evict(), 1);
+  Add(variable.get(), {2}, 1.0f);
+  EXPECT_EQ(variable->Evict(), 1);
+  EXPECT_EQ(variable->size(), 1);
+  EXPECT_EQ(Gather(variable.get(), {1, 2, 3}, {-1}, /*insert_missing=*/false),
+            std::vector<float>({-1, 3, -1}));
+}
+
+TEST_F(HashEmbeddingVariableTest, EvictLeastFrequentKeys) {
+  HashEmbeddingOptions options;
+  options.embedding_dim = 1;
+  options.max_size = HashEmbeddingVariable<float>::kNumShards;
+  core::RefCountPtr<HashEmbeddingVariable<float>> variable(
+      new HashEmbeddingVariable<float>(options));
+
+  // Gathers each key once, and the even keys a second time.
+  std::vector<int64> keys(1000);
+  std::vector<int64> even_keys;
+  for (int64 i = 0; i < keys.size(); ++i) {
+    keys[i] = i;
+    if (i % 2 == 0) even_keys.push_back(i);
+  }
+  Gather(variable.get(), keys, {0});
+  Gather(variable.get(), even_keys, {0});
+  EXPECT_EQ(variable->size(), 1000);
+
+  const int64 num_evicted = variable->Evict();
+  EXPECT_EQ(variable->size(), 1000 - num_evicted);
+  EXPECT_LE(variable->size(), options.max_size);
+  // Each shard keeps one of its most frequent keys.
+  for (int64 frequency : ExportAll(variable.get()).frequencies) {
+    EXPECT_EQ(frequency, 2);
+  }
+}
+
+TEST_F(HashEmbeddingVariableTest, ExportImport) {
+  core::RefCountPtr<HashEmbeddingVariable<float>> variable(NewVariable(2, 1));
+  Gather(variable.get(), {10, 20, 30, 20}, {1, 2});
+  Add(variable.get(), {20}, 1.0f);
+
+  const Exported exported = ExportAll(variable.get());
+  ASSERT_EQ(exported.keys.size(), 3);
+
+  core::RefCountPtr<HashEmbeddingVariable<float>> restored(NewVariable(2, 1));
+  restored->Import(exported.keys.data(), exported.values.data(),
+                   exported.slots.data(), exported.frequencies.data(),
+                   exported.last_steps.data(), exported.keys.size());
+  EXPECT_EQ(restored->size(), 3);
+  EXPECT_EQ(Gather(restored.get(), {10, 20, 30}, {0, 0},
+                   /*insert_missing=*/false),
+            std::vector<float>({1, 2, 2, 3, 1, 2}));
+}
+
+class HashEmbeddingOpsTest : public OpsTestBase {
+ protected:
+  void MakeGatherOp(bool insert_missing) {
+    TF_ASSERT_OK(NodeDefBuilder("gather", "HashEmbeddingGather")
+                     .Input(FakeInput(DT_RESOURCE))
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("insert_missing", insert_missing)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  void MakeSparseApplyOp(const string& op) {
+    TF_ASSERT_OK(NodeDefBuilder("apply", op)
+                     .Input(FakeInput(DT_RESOURCE))
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  void MakeVariableOp(const string& op) {
+    TF_ASSERT_OK(NodeDefBuilder("op", op)
+                     .Input(FakeInput(DT_RESOURCE))
+                     .Attr("dtype", DT_FLOAT)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Returns a variable with rows for `keys`, each set to `value`.
+  HashEmbeddingVariable<float>* NewVariableWithKeys(
+      const HashEmbeddingOptions& options, const std::vector<int64>& keys,
+      const std::vector<float>& value) {
+    auto* variable = new HashEmbeddingVariable<float>(options);
+    std::vector<float> output(keys.size() * options.embedding_dim);
+    variable->Gather(*device_->tensorflow_cpu_worker_threads(), keys.data(),
+                     keys.size(), /*insert_missing=*/true, value.data(),
+                     /*default_per_key=*/false, output.data());
+    return variable;
+  }
+};
+
+TEST_F(HashEmbeddingOpsTest, Gather) {
+  MakeGatherOp(/*insert_missing=*/true);
+  AddResourceInput("", "var", NewVariableWithKeys(HashEmbeddingOptions(),
+                                                   {1, 2}, {5}));
+  AddInputFromArray<int64>(TensorShape({2, 2}), {1, 3, 3, 2});
+  AddInputFromArray<float>(TensorShape({1}), {7});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2, 1}));
+  test::FillValues<float>(&expected, {5, 7, 7, 5});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(HashEmbeddingOpsTest, GatherWithDefaultPerKey) {
+  MakeGatherOp(/*insert_missing=*/false);
+  HashEmbeddingOptions options;
+  options.embedding_dim = 2;
+  AddResourceInput("", "var", NewVariableWithKeys(options, {1}, {5, 6}));
+  AddInputFromArray<int64>(TensorShape({2}), {2, 1});
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {1, 2, 5, 6});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(HashEmbeddingOpsTest, GatherWithBadDefaultValue) {
+  MakeGatherOp(/*insert_missing=*/true);
+  HashEmbeddingOptions options;
+  options.embedding_dim = 2;
+  AddResourceInput("", "var", new HashEmbeddingVariable<float>(options));
+  AddInputFromArray<int64>(TensorShape({2}), {1, 2});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST_F(HashEmbeddingOpsTest, SparseApplyGradientDescent) {
+  MakeSparseApplyOp("HashEmbeddingSparseApplyGradientDescent");
+  HashEmbeddingOptions options;
+  options.embedding_dim = 2;
+  HashEmbeddingVariable<float>* variable =
+      NewVariableWithKeys(options, {1, 2}, {1, 1});
+  variable->Ref();
+  core::RefCountPtr<HashEmbeddingVariable<float>> ref(variable);
+  AddResourceInput("", "var", variable);
+  AddInputFromArray<int64>(TensorShape({3}), {1, 3, 1});
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<float>(TensorShape({}), {0.5});
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<int64> keys = {1, 2, 3};
+  std::vector<float> output(6);
+  std::vector<float> default_value = {0, 0};
+  variable->Gather(*device_->tensorflow_cpu_worker_threads(), keys.data(), 3,
+                   /*insert_missing=*/false, default_value.data(),
+                   /*default_per_key=*/false, output.data());
+  EXPECT_EQ(output, std::vector<float>({-2, -3, 1, 1, 0, 0}));
+}
+
+TEST_F(HashEmbeddingOpsTest, SparseApplyAdagrad) {
+  MakeSparseApplyOp("HashEmbeddingSparseApplyAdagrad");
+  HashEmbeddingOptions options;
+  options.embedding_dim = 1;
+  options.num_slots = 1;
+  options.slot_initial_value = 0.1f;
+  HashEmbeddingVariable<float>* variable =
+      NewVariableWithKeys(options, {1}, {1});
+  variable->Ref();
+  core::RefCountPtr<HashEmbeddingVariable<float>> ref(variable);
+  AddResourceInput("", "var", variable);
+  AddInputFromArray<int64>(TensorShape({1}), {1});
+  AddInputFromArray<float>(TensorShape({1, 1}), {2});
+  AddInputFromArray<float>(TensorShape({}), {0.5});
+  TF_ASSERT_OK(RunOpKernel());
+
+  const Exported exported = ExportAll(variable);
+  ASSERT_EQ(exported.keys.size(), 1);
+  EXPECT_NEAR(exported.slots[0], 4.1f, 1e-6);
+  EXPECT_NEAR(exported.values[0], 1.0f - 0.5f * 2.0f / std::sqrt(4.1f), 1e-6);
+  EXPECT_EQ(exported.last_steps[0], 1);
+}
+
+TEST_F(HashEmbeddingOpsTest, SparseApplyAdagradWithoutSlots) {
+  MakeSparseApplyOp("HashEmbeddingSparseApplyAdagrad");
+  AddResourceInput("", "var",
+                   NewVariableWithKeys(HashEmbeddingOptions(), {1}, {1}));
+  AddInputFromArray<int64>(TensorShape({1}), {1});
+  AddInputFromArray<float>(TensorShape({1, 1}), {2});
+  AddInputFromArray<float>(TensorShape({}), {0.5});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST_F(HashEmbeddingOpsTest, Export) {
+  MakeVariableOp("HashEmbeddingExport");
+  HashEmbeddingOptions options;
+  options.embedding_dim = 2;
+  options.num_slots = 1;
+  options.slot_initial_value = 0.5f;
+  AddResourceInput("", "var", NewVariableWithKeys(options, {4}, {1, 2}));
+  TF_ASSERT_OK(RunOpKernel());
+
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({4}), *GetOutput(0));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1, 2}, TensorShape({1, 2})), *GetOutput(1));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0.5, 0.5}, TensorShape({1, 1, 2})),
+      *GetOutput(2));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({1}), *GetOutput(3));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({0}), *GetOutput(4));
+}
+
+TEST_F(HashEmbeddingOpsTest, Size) {
+  MakeVariableOp("HashEmbeddingSize");
+  AddResourceInput("", "var", NewVariableWithKeys(HashEmbeddingOptions(),
+                                                   {1, 2, 3, 2}, {0}));
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<int64>(test::AsScalar<int64>(3), *GetOutput(0));
+}
+
+static void BM_HashEmbeddingGather(int iters, int num_keys) {
+  testing::StopTiming();
+  thread::ThreadPool pool(Env::Default(), "bench", 8);
+  DeviceBase::CpuWorkerThreads workers;
+  workers.num_threads = 8;
+  workers.workers = &pool;
+  HashEmbeddingOptions options;
+  options.embedding_dim = 64;
+  core::RefCountPtr<HashEmbeddingVariable<float>> variable(
+      new HashEmbeddingVariable<float>(options));
+  std::vector<int64> keys(num_keys);
+  for (int64 i = 0; i < num_keys; ++i) {
+    keys[i] = (i * 7919) % (4 * num_keys);
+  }
+  std::vector<float> default_value(options.embedding_dim, 0.0f);
+  std::vector<float> output(num_keys * options.embedding_dim);
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_keys);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    variable->Gather(workers, keys.data(), num_keys, /*insert_missing=*/true,
+                     default_value.data(), /*default_per_key=*/false,
+                     output.data());
+  }
+}
+BENCHMARK(BM_HashEmbeddingGather)->Arg(1024)->Arg(65536);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,498 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_HASH_EMBEDDING_VARIABLE_H_
+#define TENSORFLOW_CORE_KERNELS_HASH_EMBEDDING_VARIABLE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// The attrs of a HashEmbeddingVariable op.
+struct HashEmbeddingOptions {
+  // Number of elements of an embedding row.
+  int64 embedding_dim = 1;
+  // Number of optimizer slots of each row, each of `embedding_dim` elements.
+  int64 num_slots = 0;
+  // Value of the slots of new rows.
+  float slot_initial_value = 0.0f;
+  // Number of gathers of a key before it gets a row.
+  int64 min_frequency = 0;
+  // Number of sparse updates of the variable after which a key that was not
+  // updated is evicted, or 0 to keep keys forever.
+  int64 ttl_steps = 0;
+  // Number of rows above which the least frequently gathered keys are
+  // evicted, or 0 for no limit.
+  int64 max_size = 0;
+  // Number of keys without a row that are counted towards `min_frequency`.
+  // Above it, Gather forgets the least frequently gathered of them.
+  int64 max_counting_keys = 1 << 20;
+};
+
+namespace hash_embedding {
+
+// Allocates rows of `row_size` elements from slabs of about 1MB, and reuses
+// the rows that are freed.  Not thread-safe.
+template <typename T>
+class SlabArena {
+ public:
+  explicit SlabArena(int64 row_size)
+      : row_size_(row_size),
+        rows_per_slab_(
+            std::max<int64>(1, kSlabBytes / (row_size * sizeof(T)))) {}
+
+  T* Allocate() {
+    if (!free_rows_.empty()) {
+      T* row = free_rows_.back();
+      free_rows_.pop_back();
+      return row;
+    }
+    if (slabs_.empty() || next_row_ == rows_per_slab_) {
+      slabs_.emplace_back(new T[rows_per_slab_ * row_size_]);
+      next_row_ = 0;
+    }
+    return slabs_.back().get() + row_size_ * next_row_++;
+  }
+
+  void Free(T* row) { free_rows_.push_back(row); }
+
+  void Clear() {
+    slabs_.clear();
+    free_rows_.clear();
+    next_row_ = 0;
+  }
+
+  int64 MemoryUsed() const {
+    return slabs_.size() * rows_per_slab_ * row_size_ * sizeof(T) +
+           free_rows_.capacity() * sizeof(T*);
+  }
+
+ private:
+  static constexpr int64 kSlabBytes = 1 << 20;
+
+  const int64 row_size_;
+  const int64 rows_per_slab_;
+  std::vector<std::unique_ptr<T[]>> slabs_;
+  // Number of rows of the last slab that were allocated.
+  int64 next_row_ = 0;
+  std::vector<T*> free_rows_;
+};
+
+// A key of a HashEmbeddingVariable.
+template <typename T>
+struct Entry {
+  // The embedding followed by the slots, or nullptr until the key has been
+  // gathered `min_frequency` times.
+  T* row = nullptr;
+  // Number of gathers of the key.
+  int64 frequency = 0;
+  // Step of the variable when the key was last inserted or updated.
+  int64 last_step = 0;
+};
+
+// The keys of a HashEmbeddingVariable with the same hash.
+template <typename T>
+struct KeyShard {
+  explicit KeyShard(int64 row_size) : arena(row_size) {}
+
+  mutex mu;
+  absl::flat_hash_map<int64, Entry<T>> entries TF_GUARDED_BY(mu);
+  SlabArena<T> arena TF_GUARDED_BY(mu);
+  // Number of entries with a row.
+  int64 num_rows TF_GUARDED_BY(mu) = 0;
+};
+
+}  // namespace hash_embedding
+
+// A resource that maps int64 keys to embedding rows with optimizer slots,
+// for unbounded key spaces.  Rows are inserted when their key is gathered,
+// optionally only once the key was seen `min_frequency` times, and evicted
+// when they were not updated in `ttl_steps` or when the variable has more
+// than `max_size` rows.
+//
+// The keys are split into kNumShards shards by hash, each with its own lock,
+// hash map and arena of rows.  The keys of a batch are grouped by shard, and
+// the shards are processed in parallel, each in the order of the batch, so
+// that results do not depend on the number of threads.
+template <typename T>
+class HashEmbeddingVariable : public ResourceBase {
+ public:
+  static constexpr int kLogNumShards = 6;
+  static constexpr int kNumShards = 1 << kLogNumShards;
+
+  // Pointers to the outputs of Export, with room for `num_rows` rows.
+  struct ExportBuffers {
+    int64* keys = nullptr;
+    T* values = nullptr;
+    T* slots = nullptr;
+    int64* frequencies = nullptr;
+    int64* last_steps = nullptr;
+  };
+
+  explicit HashEmbeddingVariable(const HashEmbeddingOptions& options)
+      : options_(options),
+        row_size_(options.embedding_dim * (1 + options.num_slots)) {
+    shards_.reserve(kNumShards);
+    for (int i = 0; i < kNumShards; ++i) {
+      shards_.emplace_back(new hash_embedding::KeyShard<T>(row_size_));
+    }
+  }
+
+  const HashEmbeddingOptions& options() const { return options_; }
+
+  string DebugString() const override {
+    return strings::StrCat("HashEmbeddingVariable with ", size(),
+                           " rows of dimension ", options_.embedding_dim,
+                           " and ", num_counting_keys(), " counting keys");
+  }
+
+  int64 MemoryUsed() const override {
+    int64 bytes = 0;
+    for (const auto& shard : shards_) {
+      tf_shared_lock l(shard->mu);
+      bytes += shard->arena.MemoryUsed() +
+               shard->entries.capacity() *
+                   (sizeof(std::pair<int64, hash_embedding::Entry<T>>) + 1);
+    }
+    return bytes;
+  }
+
+  // Returns the number of rows.
+  int64 size() const {
+    int64 num_rows = 0;
+    for (const auto& shard : shards_) {
+      tf_shared_lock l(shard->mu);
+      num_rows += shard->num_rows;
+    }
+    return num_rows;
+  }
+
+  // Returns the number of keys whose gathers are counted but that have no
+  // row yet.
+  int64 num_counting_keys() const {
+    int64 num_keys = 0;
+    for (const auto& shard : shards_) {
+      tf_shared_lock l(shard->mu);
+      num_keys += static_cast<int64>(shard->entries.size()) - shard->num_rows;
+    }
+    return num_keys;
+  }
+
+  // Copies the embeddings of `keys` to `output`, with `embedding_dim`
+  // elements per key.  Keys without a row get their default value, which is
+  // `default_values` or, if `default_per_key`, its `i`-th row for the `i`-th
+  // key.  If `insert_missing`, the frequencies of the keys are counted, and
+  // keys that reach `min_frequency` get a row starting from their default
+  // value.  Each shard counts at most `max_counting_keys / kNumShards` keys
+  // without a row, rounded up.
+  void Gather(const DeviceBase::CpuWorkerThreads& workers, const int64* keys,
+              int64 num_keys, bool insert_missing, const T* default_values,
+              bool default_per_key, T* output) {
+    const int64 dim = options_.embedding_dim;
+    const int64 step = step_.load(std::memory_order_relaxed);
+    const int64 max_counting_keys_per_shard =
+        std::max<int64>(1, (options_.max_counting_keys + kNumShards - 1) /
+                               kNumShards);
+    ForEachShard(
+        workers, keys, num_keys, /*cost_per_key=*/dim,
+        [&](hash_embedding::KeyShard<T>* shard, const int64* positions,
+            int64 num_positions) {
+          if (!insert_missing) {
+            tf_shared_lock l(shard->mu);
+            for (int64 p = 0; p < num_positions; ++p) {
+              const int64 i = positions[p];
+              const T* row = default_values + (default_per_key ? i * dim : 0);
+              auto it = shard->entries.find(keys[i]);
+              if (it != shard->entries.end() && it->second.row != nullptr) {
+                row = it->second.row;
+              }
+              std::copy(row, row + dim, output + i * dim);
+            }
+            return;
+          }
+          mutex_lock l(shard->mu);
+          for (int64 p = 0; p < num_positions; ++p) {
+            const int64 i = positions[p];
+            const T* default_value =
+                default_values + (default_per_key ? i * dim : 0);
+            hash_embedding::Entry<T>& entry = shard->entries[keys[i]];
+            if (entry.frequency++ == 0) {
+              entry.last_step = step;
+            }
+            if (entry.row == nullptr &&
+                entry.frequency >= options_.min_frequency) {
+              entry.row = NewRow(shard, default_value);
+              entry.last_step = step;
+            }
+            const T* row = entry.row != nullptr ? entry.row : default_value;
+            std::copy(row, row + dim, output + i * dim);
+            if (static_cast<int64>(shard->entries.size()) - shard->num_rows >
+                max_counting_keys_per_shard) {
+              ForgetCountingKeys(shard, max_counting_keys_per_shard / 2);
+            }
+          }
+        });
+  }
+
+  // Calls `update(i, value, slots)` for each of `keys` that has a row, where
+  // `i` is the position of the key in `keys`, `value` its embedding and
+  // `slots` its `num_slots` slots.  The updates of a key run in the order of
+  // `keys`.  Advances the step of the variable.
+  void Update(const DeviceBase::CpuWorkerThreads& workers, const int64* keys,
+              int64 num_keys, int64 cost_per_key,
+              const std::function<void(int64, T*, T*)>& update) {
+    const int64 dim = options_.embedding_dim;
+    const int64 step = step_.fetch_add(1, std::memory_order_relaxed) + 1;
+    ForEachShard(
+        workers, keys, num_keys, cost_per_key,
+        [&](hash_embedding::KeyShard<T>* shard, const int64* positions,
+            int64 num_positions) {
+          mutex_lock l(shard->mu);
+          for (int64 p = 0; p < num_positions; ++p) {
+            const int64 i = positions[p];
+            auto it = shard->entries.find(keys[i]);
+            if (it == shard->entries.end() || it->second.row == nullptr) {
+              continue;
+            }
+            it->second.last_step = step;
+            update(i, it->second.row, it->second.row + dim);
+          }
+        });
+  }
+
+  // Evicts the keys that were not updated in `ttl_steps`, and then the least
+  // frequently gathered keys of the shards with more than `max_size /
+  // kNumShards` rows, rounded up.  Returns the number of evicted rows.
+  int64 Evict() {
+    const int64 step = step_.load(std::memory_order_relaxed);
+    const int64 max_rows_per_shard =
+        (options_.max_size + kNumShards - 1) / kNumShards;
+    int64 num_evicted = 0;
+    for (const auto& shard : shards_) {
+      mutex_lock l(shard->mu);
+      if (options_.ttl_steps > 0) {
+        for (auto it = shard->entries.begin(); it != shard->entries.end();) {
+          if (step - it->second.last_step > options_.ttl_steps) {
+            num_evicted += EraseEntry(shard.get(), it++);
+          } else {
+            ++it;
+          }
+        }
+      }
+      if (options_.max_size > 0 && shard->num_rows > max_rows_per_shard) {
+        // Evict the least frequent rows, and the oldest among equally
+        // frequent rows.
+        std::vector<std::tuple<int64, int64, int64>> rows;
+        rows.reserve(shard->num_rows);
+        for (const auto& entry : shard->entries) {
+          if (entry.second.row != nullptr) {
+            rows.emplace_back(entry.second.frequency, entry.second.last_step,
+                              entry.first);
+          }
+        }
+        const int64 num_to_evict = shard->num_rows - max_rows_per_shard;
+        std::nth_element(rows.begin(), rows.begin() + num_to_evict,
+                         rows.end());
+        for (int64 r = 0; r < num_to_evict; ++r) {
+          num_evicted += EraseEntry(
+              shard.get(), shard->entries.find(std::get<2>(rows[r])));
+        }
+      }
+    }
+    return num_evicted;
+  }
+
+  // Exports the keys that have a row, in an unspecified order.  Calls
+  // `allocate` once with the number of rows to get the output buffers.
+  Status Export(const std::function<Status(int64, ExportBuffers*)>& allocate)
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    for (const auto& shard : shards_) shard->mu.lock();
+    Status status = ExportLocked(allocate);
+    for (const auto& shard : shards_) shard->mu.unlock();
+    return status;
+  }
+
+  // Replaces the contents of the variable with `num_rows` rows in the format
+  // of Export.
+  void Import(const int64* keys, const T* values, const T* slots,
+              const int64* frequencies, const int64* last_steps,
+              int64 num_rows) TF_NO_THREAD_SAFETY_ANALYSIS {
+    const int64 dim = options_.embedding_dim;
+    const int64 slots_size = options_.num_slots * dim;
+    for (const auto& shard : shards_) shard->mu.lock();
+    int64 max_step = 0;
+    for (const auto& shard : shards_) {
+      shard->entries.clear();
+      shard->arena.Clear();
+      shard->num_rows = 0;
+    }
+    for (int64 i = 0; i < num_rows; ++i) {
+      hash_embedding::KeyShard<T>* shard = shards_[ShardIndex(keys[i])].get();
+      hash_embedding::Entry<T>& entry = shard->entries[keys[i]];
+      if (entry.row == nullptr) {
+        entry.row = shard->arena.Allocate();
+        ++shard->num_rows;
+      }
+      std::copy(values + i * dim, values + (i + 1) * dim, entry.row);
+      std::copy(slots + i * slots_size, slots + (i + 1) * slots_size,
+                entry.row + dim);
+      entry.frequency = frequencies[i];
+      entry.last_step = last_steps[i];
+      max_step = std::max(max_step, last_steps[i]);
+    }
+    step_.store(max_step, std::memory_order_relaxed);
+    for (const auto& shard : shards_) shard->mu.unlock();
+  }
+
+ private:
+  static int ShardIndex(int64 key) {
+    return (static_cast<uint64>(key) * 0x9E3779B97F4A7C15ull) >>
+           (64 - kLogNumShards);
+  }
+
+  // Groups the positions of `keys` by shard, and calls
+  // `fn(shard, positions, num_positions)` for each shard with keys, in
+  // parallel.
+  template <typename Fn>
+  void ForEachShard(const DeviceBase::CpuWorkerThreads& workers,
+                    const int64* keys, int64 num_keys, int64 cost_per_key,
+                    const Fn& fn) {
+    std::vector<int64> starts(kNumShards + 1, 0);
+    for (int64 i = 0; i < num_keys; ++i) {
+      ++starts[ShardIndex(keys[i]) + 1];
+    }
+    for (int s = 0; s < kNumShards; ++s) {
+      starts[s + 1] += starts[s];
+    }
+    std::vector<int64> positions(num_keys);
+    std::vector<int64> next(starts.begin(), starts.end() - 1);
+    for (int64 i = 0; i < num_keys; ++i) {
+      positions[next[ShardIndex(keys[i])]++] = i;
+    }
+    const int64 cost_per_shard =
+        std::max<int64>(1, num_keys / kNumShards) * cost_per_key;
+    Shard(workers.num_threads, workers.workers, kNumShards, cost_per_shard,
+          [&](int64 start, int64 limit) {
+            for (int64 s = start; s < limit; ++s) {
+              if (starts[s] == starts[s + 1]) continue;
+              fn(shards_[s].get(), positions.data() + starts[s],
+                 starts[s + 1] - starts[s]);
+            }
+          });
+  }
+
+  T* NewRow(hash_embedding::KeyShard<T>* shard, const T* value)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    const int64 dim = options_.embedding_dim;
+    T* row = shard->arena.Allocate();
+    std::copy(value, value + dim, row);
+    std::fill(row + dim, row + row_size_,
+              static_cast<T>(options_.slot_initial_value));
+    ++shard->num_rows;
+    return row;
+  }
+
+  // Erases the least frequently gathered keys without a row of `shard`, and
+  // the oldest among equally frequent keys, until `num_keys` are left.
+  void ForgetCountingKeys(hash_embedding::KeyShard<T>* shard, int64 num_keys)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    std::vector<std::tuple<int64, int64, int64>> counting_keys;
+    counting_keys.reserve(shard->entries.size() - shard->num_rows);
+    for (const auto& entry : shard->entries) {
+      if (entry.second.row == nullptr) {
+        // Newer keys sort last, so that they survive among equally frequent
+        // keys.
+        counting_keys.emplace_back(entry.second.frequency,
+                                   entry.second.last_step, entry.first);
+      }
+    }
+    const int64 num_to_forget =
+        static_cast<int64>(counting_keys.size()) - num_keys;
+    if (num_to_forget <= 0) return;
+    std::nth_element(counting_keys.begin(),
+                     counting_keys.begin() + num_to_forget,
+                     counting_keys.end());
+    for (int64 k = 0; k < num_to_forget; ++k) {
+      shard->entries.erase(std::get<2>(counting_keys[k]));
+    }
+  }
+
+  // Erases the entry at `it`, and returns the number of rows freed.
+  int64 EraseEntry(
+      hash_embedding::KeyShard<T>* shard,
+      typename absl::flat_hash_map<int64, hash_embedding::Entry<T>>::iterator
+          it) TF_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    T* row = it->second.row;
+    shard->entries.erase(it);
+    if (row == nullptr) return 0;
+    shard->arena.Free(row);
+    --shard->num_rows;
+    return 1;
+  }
+
+  Status ExportLocked(
+      const std::function<Status(int64, ExportBuffers*)>& allocate)
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    const int64 dim = options_.embedding_dim;
+    const int64 slots_size = options_.num_slots * dim;
+    int64 num_rows = 0;
+    for (const auto& shard : shards_) num_rows += shard->num_rows;
+    ExportBuffers buffers;
+    TF_RETURN_IF_ERROR(allocate(num_rows, &buffers));
+    int64 i = 0;
+    for (const auto& shard : shards_) {
+      for (const auto& entry : shard->entries) {
+        const T* row = entry.second.row;
+        if (row == nullptr) continue;
+        buffers.keys[i] = entry.first;
+        std::copy(row, row + dim, buffers.values + i * dim);
+        std::copy(row + dim, row + dim + slots_size,
+                  buffers.slots + i * slots_size);
+        buffers.frequencies[i] = entry.second.frequency;
+        buffers.last_steps[i] = entry.second.last_step;
+        ++i;
+      }
+    }
+    return Status::OK();
+  }
+
+  const HashEmbeddingOptions options_;
+  const int64 row_size_;
+  std::vector<std::unique_ptr<hash_embedding::KeyShard<T>>> shards_;
+  // Number of calls to Update.
+  std::atomic<int64> step_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(HashEmbeddingVariable);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_HASH_EMBEDDING_VARIABLE_H_
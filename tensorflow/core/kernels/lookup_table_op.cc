@@ -16,16 +16,25 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/variant.h"
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace lookup {
@@ -309,9 +318,90 @@ TensorShape MaybeVectorizeShape(const TensorShape& shape) {
   return shape;
 }
 
+// The control bytes of MutableDenseHashTable, one per bucket.  A full bucket
+// holds the H2 of the hash of its key, which is in [0, 128), and the other
+// buckets one of these negative values.
+constexpr int8 kCtrlEmpty = -128;
+constexpr int8 kCtrlDeleted = -2;
+// Pads the control bytes of tables with fewer buckets than a group.
+constexpr int8 kCtrlSentinel = -1;
+
+// Number of buckets whose control bytes are compared at once.
+constexpr int64 kGroupWidth = 16;
+
+// Number of keys of a lookup whose first group is prefetched together.
+constexpr int64 kFindBlockSize = 16;
+
+// The control bytes of an aligned group of kGroupWidth buckets.  The Match
+// methods return a mask with bit i set if bucket i of the group matches.
+class CtrlGroup {
+ public:
+#ifdef __SSE2__
+  explicit CtrlGroup(const int8* ctrl)
+      : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+
+  uint32 Match(int8 h2) const {
+    return static_cast<uint32>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_)));
+  }
+
+  uint32 MatchEmpty() const { return Match(kCtrlEmpty); }
+
+  uint32 MatchEmptyOrDeleted() const {
+    return static_cast<uint32>(_mm_movemask_epi8(
+        _mm_cmpgt_epi8(_mm_set1_epi8(kCtrlSentinel), ctrl_)));
+  }
+
+ private:
+  __m128i ctrl_;
+#else
+  explicit CtrlGroup(const int8* ctrl) : ctrl_(ctrl) {}
+
+  uint32 Match(int8 h2) const {
+    uint32 mask = 0;
+    for (int i = 0; i < kGroupWidth; ++i) {
+      mask |= static_cast<uint32>(ctrl_[i] == h2) << i;
+    }
+    return mask;
+  }
+
+  uint32 MatchEmpty() const { return Match(kCtrlEmpty); }
+
+  uint32 MatchEmptyOrDeleted() const {
+    uint32 mask = 0;
+    for (int i = 0; i < kGroupWidth; ++i) {
+      mask |= static_cast<uint32>(ctrl_[i] < kCtrlSentinel) << i;
+    }
+    return mask;
+  }
+
+ private:
+  const int8* ctrl_;
+#endif
+};
+
+// Returns the position of the lowest bit set in a non-zero mask.
+inline int LowestBit(uint32 mask) { return Log2Floor(mask & (~mask + 1)); }
+
+// HashScalar is the identity for integers, so the hash of a key is mixed
+// before it is split into the group of the key (H1) and its control byte (H2).
+inline uint64 MixHash(uint64 hash) {
+  hash *= 0x9E3779B97F4A7C15ull;
+  return hash ^ (hash >> 32);
+}
+
+inline uint64 H1(uint64 mixed_hash) { return mixed_hash >> 7; }
+
+inline int8 H2(uint64 mixed_hash) { return mixed_hash & 0x7F; }
+
 }  // namespace
 
-// Modeled after densehashtable in https://github.com/sparsehash/sparsehash
+// Modeled after densehashtable in https://github.com/sparsehash/sparsehash,
+// with the probing of SwissTable: a control byte per bucket holds 7 bits of
+// the hash of its key, and the control bytes of a group of 16 buckets are
+// compared with the key at once, so that most probes compare a single key.
+// The keys and values are still stored in tensors, which are exported as
+// they are.
 template <class K, class V>
 class MutableDenseHashTable final : public LookupInterface {
  public:
@@ -405,48 +495,67 @@ class MutableDenseHashTable final : public LookupInterface {
         empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
     const auto deleted_key_matrix =
         deleted_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
-    const int64 bit_mask = num_buckets_ - 1;
-    // TODO(andreasst): parallelize using work_sharder
-    for (int64 i = 0; i < num_elements; ++i) {
-      const uint64 key_hash = HashKey(key_matrix, i);
-      if (empty_key_hash_ == key_hash &&
-          IsEqualKey(empty_key_matrix, 0, key_matrix, i)) {
-        return errors::InvalidArgument(
-            "Using the empty_key as a table key is not allowed");
-      }
-      if (deleted_key_hash_ == key_hash &&
-          IsEqualKey(deleted_key_matrix, 0, key_matrix, i)) {
-        return errors::InvalidArgument(
-            "Using the deleted_key as a table key is not allowed");
-      }
-      int64 bucket_index = key_hash & bit_mask;
-      int64 num_probes = 0;
-      while (true) {
-        if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, i)) {
-          for (int64 j = 0; j < value_size; ++j) {
-            // TODO(andreasst): check if we can get rid of SubtleMustCopy
-            // here and elsewhere in this file.
-            value_matrix(i, j) =
-                SubtleMustCopyIfIntegral(value_buckets_matrix(bucket_index, j));
-          }
-          break;
+    const int8* ctrl = ctrl_.data();
+    const int64 num_groups = num_groups_;
+    const K* key_buckets_data = key_buckets_matrix.data();
+
+    mutex error_mu;
+    Status error;
+    // Hashes a block of keys and prefetches their first group before probing
+    // them, so that the cache misses of the keys of a block overlap.
+    auto find_keys = [&](int64 start, int64 limit) {
+      uint64 hashes[kFindBlockSize];
+      for (int64 block = start; block < limit; block += kFindBlockSize) {
+        const int64 block_size = std::min(kFindBlockSize, limit - block);
+        for (int64 b = 0; b < block_size; ++b) {
+          hashes[b] = HashKey(key_matrix, block + b);
+          const int64 bucket =
+              (H1(MixHash(hashes[b])) & (num_groups - 1)) * kGroupWidth;
+          port::prefetch<port::PREFETCH_HINT_T0>(ctrl + bucket);
+          port::prefetch<port::PREFETCH_HINT_T0>(key_buckets_data +
+                                                 bucket * key_size);
         }
-        if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_matrix, 0)) {
-          for (int64 j = 0; j < value_size; ++j) {
-            value_matrix(i, j) = SubtleMustCopyIfIntegral(default_flat(j));
+        for (int64 b = 0; b < block_size; ++b) {
+          const int64 i = block + b;
+          const uint64 key_hash = hashes[b];
+          if (empty_key_hash_ == key_hash &&
+              IsEqualKey(empty_key_matrix, 0, key_matrix, i)) {
+            mutex_lock l(error_mu);
+            error = errors::InvalidArgument(
+                "Using the empty_key as a table key is not allowed");
+            return;
+          }
+          if (deleted_key_hash_ == key_hash &&
+              IsEqualKey(deleted_key_matrix, 0, key_matrix, i)) {
+            mutex_lock l(error_mu);
+            error = errors::InvalidArgument(
+                "Using the deleted_key as a table key is not allowed");
+            return;
+          }
+          const int64 bucket =
+              FindBucket(ctrl, num_groups, key_buckets_matrix, key_matrix, i,
+                         MixHash(key_hash));
+          if (bucket >= 0) {
+            for (int64 j = 0; j < value_size; ++j) {
+              // TODO(andreasst): check if we can get rid of SubtleMustCopy
+              // here and elsewhere in this file.
+              value_matrix(i, j) =
+                  SubtleMustCopyIfIntegral(value_buckets_matrix(bucket, j));
+            }
+          } else {
+            for (int64 j = 0; j < value_size; ++j) {
+              value_matrix(i, j) = SubtleMustCopyIfIntegral(default_flat(j));
+            }
           }
-          break;
-        }
-        ++num_probes;
-        bucket_index =
-            (bucket_index + num_probes) & bit_mask;  // quadratic probing
-        if (num_probes >= num_buckets_) {
-          return errors::Internal(
-              "Internal error in MutableDenseHashTable lookup");
         }
       }
-    }
-    return Status::OK();
+    };
+    // A lookup is dominated by the cache misses on its group and key.
+    const int64 cost_per_key = 200 + 10 * (key_size + value_size);
+    const auto* worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_elements,
+          cost_per_key, find_keys);
+    return error;
   }
 
   Status Insert(OpKernelContext* ctx, const Tensor& key,
@@ -491,28 +600,13 @@ class MutableDenseHashTable final : public LookupInterface {
   Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
                       const Tensor& values) override TF_LOCKS_EXCLUDED(mu_) {
     mutex_lock l(mu_);
-    num_buckets_ = keys.dim_size(0);
-    key_buckets_ = PersistentTensor(keys);
-    value_buckets_ = PersistentTensor(values);
-    // Count the number of keys that are not the empty_key or deleted_key.
-    // This requires iterating through the whole table but that is OK as we
-    // only execute it during checkpoint restore.
-    num_entries_ = 0;
-    const auto empty_key_tensor =
-        empty_key_.AccessTensor(ctx)->template shaped<K, 2>(
-            {1, key_shape_.num_elements()});
-    const auto deleted_key_tensor =
-        deleted_key_.AccessTensor(ctx)->template shaped<K, 2>(
-            {1, key_shape_.num_elements()});
-    const auto key_buckets_tensor =
-        key_buckets_.AccessTensor(ctx)->template matrix<K>();
-    for (int64 i = 0; i < num_buckets_; ++i) {
-      if (!IsEqualKey(key_buckets_tensor, i, empty_key_tensor, 0) &&
-          !IsEqualKey(key_buckets_tensor, i, deleted_key_tensor, 0)) {
-        ++num_entries_;
-      }
-    }
-    return Status::OK();
+    // The keys are inserted again rather than adopted with their buckets, as
+    // the control bytes are not exported and checkpoints written before them
+    // placed keys by quadratic probing.  This requires iterating through the
+    // whole table but that is OK as we only execute it during checkpoint
+    // restore.
+    TF_RETURN_IF_ERROR(AllocateBuckets(ctx, keys.dim_size(0)));
+    return DoInsert(ctx, keys, values, true);
   }
 
   Status ExportValues(OpKernelContext* ctx) override TF_LOCKS_EXCLUDED(mu_) {
@@ -560,7 +654,8 @@ class MutableDenseHashTable final : public LookupInterface {
   int64 MemoryUsed() const override {
     tf_shared_lock l(mu_);
     return sizeof(MutableDenseHashTable) + key_buckets_.AllocatedBytes() +
-           value_buckets_.AllocatedBytes() + empty_key_.AllocatedBytes();
+           value_buckets_.AllocatedBytes() + empty_key_.AllocatedBytes() +
+           ctrl_.capacity();
   }
 
  private:
@@ -581,7 +676,6 @@ class MutableDenseHashTable final : public LookupInterface {
         empty_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
     const auto deleted_key_tensor =
         deleted_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
-    const int64 bit_mask = num_buckets_ - 1;
     for (int64 i = 0; i < num_elements; ++i) {
       const uint64 key_hash = HashKey(key_matrix, i);
       if (empty_key_hash_ == key_hash &&
@@ -600,37 +694,25 @@ class MutableDenseHashTable final : public LookupInterface {
         return errors::InvalidArgument(
             "Using the deleted_key as a table key is not allowed");
       }
-      int64 bucket_index = key_hash & bit_mask;
-      int64 num_probes = 0;
-      while (true) {
-        if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, i)) {
-          for (int64 j = 0; j < value_size; ++j) {
-            value_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(value_matrix(i, j));
-          }
-          break;
-        }
-        if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_tensor, 0) ||
-            IsEqualKey(key_buckets_matrix, bucket_index, deleted_key_tensor,
-                       0)) {
-          ++num_entries_;
-          for (int64 j = 0; j < key_size; ++j) {
-            key_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(key_matrix(i, j));
-          }
-          for (int64 j = 0; j < value_size; ++j) {
-            value_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(value_matrix(i, j));
-          }
-          break;
-        }
-        ++num_probes;
-        bucket_index =
-            (bucket_index + num_probes) & bit_mask;  // quadratic probing
-        if (num_probes >= num_buckets_) {
+      const uint64 mixed_hash = MixHash(key_hash);
+      int64 bucket = FindBucket(ctrl_.data(), num_groups_, key_buckets_matrix,
+                                key_matrix, i, mixed_hash);
+      if (bucket < 0) {
+        bucket = FindFreeBucket(mixed_hash);
+        if (bucket < 0) {
           return errors::Internal(
               "Internal error in MutableDenseHashTable insert");
         }
+        ++num_entries_;
+        ctrl_[bucket] = H2(mixed_hash);
+        for (int64 j = 0; j < key_size; ++j) {
+          key_buckets_matrix(bucket, j) =
+              SubtleMustCopyIfIntegral(key_matrix(i, j));
+        }
+      }
+      for (int64 j = 0; j < value_size; ++j) {
+        value_buckets_matrix(bucket, j) =
+            SubtleMustCopyIfIntegral(value_matrix(i, j));
       }
     }
     return Status::OK();
@@ -650,7 +732,6 @@ class MutableDenseHashTable final : public LookupInterface {
         deleted_key_.AccessTensor(ctx)->template shaped<K, 2>({1, key_size});
     const auto deleted_key_flat =
         deleted_key_.AccessTensor(ctx)->template flat<K>();
-    const int64 bit_mask = num_buckets_ - 1;
     for (int64 i = 0; i < num_elements; ++i) {
       const uint64 key_hash = HashKey(key_matrix, i);
       if (empty_key_hash_ == key_hash &&
@@ -663,26 +744,15 @@ class MutableDenseHashTable final : public LookupInterface {
         return errors::InvalidArgument(
             "Using the deleted_key as a table key is not allowed");
       }
-      int64 bucket_index = key_hash & bit_mask;
-      int64 num_probes = 0;
-      while (true) {
-        if (IsEqualKey(key_buckets_matrix, bucket_index, key_matrix, i)) {
-          --num_entries_;
-          for (int64 j = 0; j < key_size; ++j) {
-            key_buckets_matrix(bucket_index, j) =
-                SubtleMustCopyIfIntegral(deleted_key_flat(j));
-          }
-          break;
-        }
-        if (IsEqualKey(key_buckets_matrix, bucket_index, empty_key_tensor, 0)) {
-          break;
-        }
-        ++num_probes;
-        bucket_index =
-            (bucket_index + num_probes) & bit_mask;  // quadratic probing
-        if (num_probes >= num_buckets_) {
-          return errors::Internal(
-              "Internal error in MutableDenseHashTable remove");
+      const int64 bucket =
+          FindBucket(ctrl_.data(), num_groups_, key_buckets_matrix, key_matrix,
+                     i, MixHash(key_hash));
+      if (bucket >= 0) {
+        --num_entries_;
+        ctrl_[bucket] = kCtrlDeleted;
+        for (int64 j = 0; j < key_size; ++j) {
+          key_buckets_matrix(bucket, j) =
+              SubtleMustCopyIfIntegral(deleted_key_flat(j));
         }
       }
     }
@@ -699,6 +769,9 @@ class MutableDenseHashTable final : public LookupInterface {
     }
     num_buckets_ = new_num_buckets;
     num_entries_ = 0;
+    ctrl_.assign(std::max(num_buckets_, kGroupWidth), kCtrlSentinel);
+    std::fill(ctrl_.begin(), ctrl_.begin() + num_buckets_, kCtrlEmpty);
+    num_groups_ = ctrl_.size() / kGroupWidth;
 
     const int64 key_size = key_shape_.num_elements();
     Tensor* key_buckets_tensor;
@@ -738,6 +811,50 @@ class MutableDenseHashTable final : public LookupInterface {
     return DoInsert(ctx, old_key_buckets, old_value_buckets, true);
   }
 
+  // Returns the bucket of the `index`-th key of `key_matrix`, or -1 if the
+  // key is not in the table.  The arguments are the members they are named
+  // after, so that lookups can run on other threads.
+  template <typename MT2>
+  int64 FindBucket(const int8* ctrl, int64 num_groups,
+                   typename TTypes<K>::Matrix key_buckets_matrix,
+                   MT2 key_matrix, int64 index, uint64 mixed_hash) const {
+    const int8 h2 = H2(mixed_hash);
+    const int64 group_mask = num_groups - 1;
+    int64 group = H1(mixed_hash) & group_mask;
+    // Triangular probing visits every group, as num_groups is a power of 2.
+    for (int64 num_probes = 1; num_probes <= num_groups; ++num_probes) {
+      const CtrlGroup ctrl_group(ctrl + group * kGroupWidth);
+      for (uint32 mask = ctrl_group.Match(h2); mask != 0; mask &= mask - 1) {
+        const int64 bucket = group * kGroupWidth + LowestBit(mask);
+        if (IsEqualKey(key_buckets_matrix, bucket, key_matrix, index)) {
+          return bucket;
+        }
+      }
+      if (ctrl_group.MatchEmpty() != 0) {
+        return -1;
+      }
+      group = (group + num_probes) & group_mask;
+    }
+    return -1;
+  }
+
+  // Returns the first empty or deleted bucket in the probe sequence of
+  // `mixed_hash`, or -1 if there is none.
+  int64 FindFreeBucket(uint64 mixed_hash) const
+      TF_SHARED_LOCKS_REQUIRED(mu_) {
+    const int64 group_mask = num_groups_ - 1;
+    int64 group = H1(mixed_hash) & group_mask;
+    for (int64 num_probes = 1; num_probes <= num_groups_; ++num_probes) {
+      const uint32 mask =
+          CtrlGroup(ctrl_.data() + group * kGroupWidth).MatchEmptyOrDeleted();
+      if (mask != 0) {
+        return group * kGroupWidth + LowestBit(mask);
+      }
+      group = (group + num_probes) & group_mask;
+    }
+    return -1;
+  }
+
   uint64 HashKey(typename TTypes<K>::ConstMatrix key, int64 index) const {
     if (key_shape_.num_elements() == 1) {
       return HashScalar(key(index, 0));
@@ -768,6 +885,10 @@ class MutableDenseHashTable final : public LookupInterface {
   mutable mutex mu_;
   int64 num_entries_ TF_GUARDED_BY(mu_);
   int64 num_buckets_ TF_GUARDED_BY(mu_);
+  // The control bytes of the buckets, padded with kCtrlSentinel to at least
+  // one group.
+  std::vector<int8> ctrl_ TF_GUARDED_BY(mu_);
+  int64 num_groups_ TF_GUARDED_BY(mu_);
   PersistentTensor key_buckets_ TF_GUARDED_BY(mu_);
   PersistentTensor value_buckets_ TF_GUARDED_BY(mu_);
   PersistentTensor empty_key_;
@@ -0,0 +1,109 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+
+// A MutableDenseHashTableV2 if `dense`, and otherwise a MutableHashTableV2,
+// from int64 to float.  Tables with the same `shared_name` are the same table.
+static Node* Table(Graph* g, bool dense, const string& shared_name) {
+  Node* table;
+  if (dense) {
+    TF_CHECK_OK(
+        NodeBuilder(g->NewName("table"), "MutableDenseHashTableV2")
+            .Input(test::graph::Constant(g, test::AsScalar<int64>(-1)))
+            .Input(test::graph::Constant(g, test::AsScalar<int64>(-2)))
+            .Attr("value_dtype", DT_FLOAT)
+            .Attr("shared_name", shared_name)
+            .Finalize(g, &table));
+  } else {
+    TF_CHECK_OK(NodeBuilder(g->NewName("table"), "MutableHashTableV2")
+                    .Attr("key_dtype", DT_INT64)
+                    .Attr("value_dtype", DT_FLOAT)
+                    .Attr("shared_name", shared_name)
+                    .Finalize(g, &table));
+  }
+  return table;
+}
+
+// Returns `n` random keys in [0, `max_key`).
+static Tensor RandomKeys(int64 n, int64 max_key, uint64 seed) {
+  random::PhiloxRandom philox(seed);
+  random::SimplePhilox rnd(&philox);
+  Tensor keys(DT_INT64, TensorShape({n}));
+  for (int64 i = 0; i < n; ++i) {
+    keys.flat<int64>()(i) = rnd.Uniform64(max_key);
+  }
+  return keys;
+}
+
+// Inserts `num_keys` keys into a table, and looks up `batch_size` keys, about
+// half of which are in the table.
+static void TableFind(int iters, bool dense, int num_keys, int batch_size,
+                      int num_threads) {
+  testing::StopTiming();
+  const string shared_name = strings::StrCat("table_", dense, "_", num_keys);
+  Graph* init = new Graph(OpRegistry::Global());
+  {
+    Tensor values(DT_FLOAT, TensorShape({num_keys}));
+    values.flat<float>().setConstant(1.0f);
+    TF_CHECK_OK(NodeBuilder(init->NewName("insert"), "LookupTableInsertV2")
+                    .Input(Table(init, dense, shared_name))
+                    .Input(test::graph::Constant(
+                        init, RandomKeys(num_keys, 2 * num_keys, 1)))
+                    .Input(test::graph::Constant(init, values))
+                    .Finalize(init, nullptr));
+  }
+  Graph* g = new Graph(OpRegistry::Global());
+  TF_CHECK_OK(
+      NodeBuilder(g->NewName("find"), "LookupTableFindV2")
+          .Input(Table(g, dense, shared_name))
+          .Input(test::graph::Constant(
+              g, RandomKeys(batch_size, 2 * num_keys, 2)))
+          .Input(test::graph::Constant(g, test::AsScalar<float>(0.0f)))
+          .Finalize(g, nullptr));
+  SessionOptions options;
+  options.config.set_intra_op_parallelism_threads(num_threads);
+  options.config.set_inter_op_parallelism_threads(1);
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch_size);
+  testing::StartTiming();
+  test::Benchmark("cpu", g, &options, init).Run(iters);
+}
+
+#define BM_TableFind(DENSE, KEYS, BATCH, THREADS)                             \
+  static void BM_TableFind_##DENSE##_##KEYS##_##BATCH##_##THREADS(int iters) { \
+    TableFind(iters, DENSE, KEYS, BATCH, THREADS);                            \
+  }                                                                           \
+  BENCHMARK(BM_TableFind_##DENSE##_##KEYS##_##BATCH##_##THREADS);
+
+// MutableHashTable (false) versus MutableDenseHashTable (true).
+BM_TableFind(false, 1000000, 4096, 1);
+BM_TableFind(true, 1000000, 4096, 1);
+BM_TableFind(false, 1000000, 4096, 8);
+BM_TableFind(true, 1000000, 4096, 8);
+BM_TableFind(true, 10000, 4096, 1);
+BM_TableFind(true, 10000000, 4096, 1);
+BM_TableFind(true, 10000000, 4096, 8);
+
+}  // end namespace tensorflow
@@ -15,10 +15,63 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/training_op_helpers.h"
 
+#include <atomic>
+
+#include "tensorflow/core/util/env_var.h"
 #include "tensorflow/core/util/ptr_util.h"
 
 namespace tensorflow {
 
+namespace {
+
+// The number of row stripes is 1 << kLogNumRowStripes.
+constexpr int kLogNumRowStripes = 12;
+
+// The mutex of a row stripe, padded so that no two stripes share a cache
+// line.
+struct RowStripe {
+  mutex mu;
+  char padding[64];
+};
+
+std::atomic<bool>* StripedRowLocksEnabled() {
+  static std::atomic<bool>* enabled = [] {
+    bool value;
+    TF_CHECK_OK(ReadBoolFromEnvVar("TF_SPARSE_APPLY_STRIPED_LOCKS",
+                                   /*default_val=*/false, &value));
+    return new std::atomic<bool>(value);
+  }();
+  return enabled;
+}
+
+}  // namespace
+
+bool UseStripedRowLocks(OpKernelContext* ctx,
+                        const std::vector<int>& input_ids) {
+  if (!StripedRowLocksEnabled()->load(std::memory_order_relaxed)) {
+    return false;
+  }
+  for (int input : input_ids) {
+    if (ctx->input_dtype(input) != DT_RESOURCE) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SetStripedRowLocksEnabled(bool enabled) {
+  StripedRowLocksEnabled()->store(enabled);
+}
+
+mutex* StripedRowMutex(const void* row) {
+  static RowStripe* stripes = new RowStripe[1 << kLogNumRowStripes];
+  // Fibonacci hashing spreads the rows of a variable, which are evenly spaced,
+  // over all the stripes.
+  const uint64 hash =
+      static_cast<uint64>(reinterpret_cast<uintptr_t>(row)) *
+      0x9E3779B97F4A7C15ull;
+  return &stripes[hash >> (64 - kLogNumRowStripes)].mu;
+}
 
 void MaybeForwardRefInputToRefOutput(OpKernelContext* ctx, int input,
                                      int output) {
@@ -188,6 +188,41 @@ VariableInputLockHolder MaybeLockVariableInputMutexesInOrder(
                                  std::move(shared_locks));
 }
 
+// Returns whether a sparse update of the variables `input_ids` uses striped
+// row locks.  The variables are then only locked in shared mode, even with
+// `use_locking`, and each row update holds the mutex of the stripe of the row
+// instead (see StripedRowLock), so that concurrent sparse updates of a
+// variable, e.g. from many workers on a parameter server, run in parallel.
+// Striped row locks are enabled with TF_SPARSE_APPLY_STRIPED_LOCKS=1, and only
+// apply to resource variables.
+bool UseStripedRowLocks(OpKernelContext* ctx,
+                        const std::vector<int>& input_ids);
+
+// Overrides TF_SPARSE_APPLY_STRIPED_LOCKS, e.g. in benchmarks.
+void SetStripedRowLocksEnabled(bool enabled);
+
+// Returns the mutex of the stripe of the variable row starting at `row`.
+mutex* StripedRowMutex(const void* row);
+
+// Holds the mutex of the stripe of a variable row while the row is updated,
+// if `enabled`.  Rows are hashed by address, so that the updates of a row by
+// concurrent ops, and by the shards of one op, use the same stripe.
+class StripedRowLock {
+ public:
+  StripedRowLock(bool enabled, const void* row) TF_NO_THREAD_SAFETY_ANALYSIS
+      : mu_(enabled ? StripedRowMutex(row) : nullptr) {
+    if (mu_ != nullptr) mu_->lock();
+  }
+  ~StripedRowLock() TF_NO_THREAD_SAFETY_ANALYSIS {
+    if (mu_ != nullptr) mu_->unlock();
+  }
+
+ private:
+  mutex* const mu_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StripedRowLock);
+};
+
 void MaybeForwardRefInputToRefOutput(OpKernelContext* ctx, int input,
                                      int output);
 
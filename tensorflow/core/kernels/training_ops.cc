@@ -1635,8 +1635,9 @@ class SparseApplyAdagradOp : public OpKernel {
 
   void Compute(OpKernelContext* ctx) override TF_NO_THREAD_SAFETY_ANALYSIS {
     const bool sparse = true;
+    const bool striped_row_locks = UseStripedRowLocks(ctx, {0, 1});
     auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
-        ctx, use_exclusive_lock_, sparse, {0, 1});
+        ctx, use_exclusive_lock_ && !striped_row_locks, sparse, {0, 1});
     Tensor var;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
                             ctx, 0, use_exclusive_lock_, sparse, &var));
@@ -1714,6 +1715,7 @@ class SparseApplyAdagradOp : public OpKernel {
         const auto shard = [&](Tindex start_idx, Tindex end_idx) -> void {
           for (Tindex i = start_idx; i < end_idx; ++i) {
             const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+            StripedRowLock row_lock(striped_row_locks, &var_flat(index, 0));
             auto a = accum_flat.template chip<0>(index);
             auto g = grad_flat.template chip<0>(i);
             auto v = var_flat.template chip<0>(index);
@@ -1745,6 +1747,7 @@ class SparseApplyAdagradOp : public OpKernel {
         const auto shard = [&](Tindex start_idx, Tindex end_idx) -> void {
           for (Tindex i = start_idx; i < end_idx; ++i) {
             const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+            StripedRowLock row_lock(striped_row_locks, &var_flat(index));
             T& a = accum_flat(index);
             const T& g = grad_flat(i);
             if (update_slots_) {
@@ -1798,8 +1801,9 @@ class SparseApplyAdagradV2Op : public OpKernel {
 
   void Compute(OpKernelContext* ctx) override TF_NO_THREAD_SAFETY_ANALYSIS {
     const bool sparse = true;
+    const bool striped_row_locks = UseStripedRowLocks(ctx, {0, 1});
     auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
-        ctx, use_exclusive_lock_, sparse, {0, 1});
+        ctx, use_exclusive_lock_ && !striped_row_locks, sparse, {0, 1});
     Tensor var;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
                             ctx, 0, use_exclusive_lock_, sparse, &var));
@@ -1882,6 +1886,7 @@ class SparseApplyAdagradV2Op : public OpKernel {
         const auto shard = [&](Tindex start_idx, Tindex end_idx) -> void {
           for (Tindex i = start_idx; i < end_idx; ++i) {
             const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+            StripedRowLock row_lock(striped_row_locks, &var_flat(index, 0));
             auto a = accum_flat.template chip<0>(index);
             auto g = grad_flat.template chip<0>(i);
             auto v = var_flat.template chip<0>(index);
@@ -1915,6 +1920,7 @@ class SparseApplyAdagradV2Op : public OpKernel {
         const auto shard = [&](Tindex start_idx, Tindex end_idx) -> void {
           for (Tindex i = start_idx; i < end_idx; ++i) {
             const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+            StripedRowLock row_lock(striped_row_locks, &var_flat(index));
             T& a = accum_flat(index);
             const T& g = grad_flat(i);
             if (update_slots_) {
@@ -3076,8 +3082,9 @@ class SparseApplyMomentumOp : public OpKernel {
 
   void Compute(OpKernelContext* ctx) override TF_NO_THREAD_SAFETY_ANALYSIS {
     const bool sparse = true;
+    const bool striped_row_locks = UseStripedRowLocks(ctx, {0, 1});
     auto locks = MaybeLockVariableInputMutexesInOrder<CPUDevice, T>(
-        ctx, use_exclusive_lock_, sparse, {0, 1});
+        ctx, use_exclusive_lock_ && !striped_row_locks, sparse, {0, 1});
 
     Tensor var;
     OP_REQUIRES_OK(ctx, GetInputTensorFromVariable<CPUDevice, T>(
@@ -3141,6 +3148,13 @@ class SparseApplyMomentumOp : public OpKernel {
                     errors::InvalidArgument(
                         strings::StrCat("Index ", index, " at offset ", i,
                                         " in indices is out of range")));
+      }
+
+      const int64 inner_dim = var_flat.dimension(1);
+      const auto update = [&](Tindex i) -> void {
+        const Tindex index = internal::SubtleMustCopy(indices_vec(i));
+        StripedRowLock row_lock(striped_row_locks,
+                                var_flat.data() + index * inner_dim);
         auto a = accum_flat.template chip<0>(index);
         auto g = grad_flat.template chip<0>(i);
         auto v = var_flat.template chip<0>(index);
@@ -3151,6 +3165,50 @@ class SparseApplyMomentumOp : public OpKernel {
         } else {
           v -= a.constant(lr_scalar) * a;
         }
+      };
+
+      if (striped_row_locks) {
+        // The updates are split by row rather than by position, so that the
+        // updates of a duplicate index are applied by one task in the order
+        // of `indices`, as in the sequential loop.  Rows are assigned to
+        // partitions by index, and each partition keeps the order of its
+        // positions.
+        const int64 num_partitions = std::min<int64>(
+            N,
+            4 * ctx->device()->tensorflow_cpu_worker_threads()->num_threads);
+        std::vector<int64> starts(num_partitions + 1, 0);
+        for (Tindex i = 0; i < N; i++) {
+          const int64 index = internal::SubtleMustCopy(indices_vec(i));
+          ++starts[index % num_partitions + 1];
+        }
+        for (int64 p = 0; p < num_partitions; p++) {
+          starts[p + 1] += starts[p];
+        }
+        std::vector<Tindex> positions(N);
+        std::vector<int64> next(starts.begin(), starts.end() - 1);
+        for (Tindex i = 0; i < N; i++) {
+          const int64 index = internal::SubtleMustCopy(indices_vec(i));
+          positions[next[index % num_partitions]++] = i;
+        }
+
+        const int in_bytes = inner_dim * sizeof(T) * 3;
+        const int out_bytes = inner_dim * sizeof(T) * 2;
+        const int cycles =
+            inner_dim * (Eigen::TensorOpCost::AddCost<T>() * 2 +
+                         Eigen::TensorOpCost::MulCost<T>() * 3);
+        const Eigen::TensorOpCost cost(in_bytes, out_bytes, cycles);
+        ctx->eigen_cpu_device().parallelFor(
+            num_partitions, cost * (static_cast<double>(N) / num_partitions),
+            [&](int64 start_partition, int64 end_partition) {
+              for (int64 k = starts[start_partition];
+                   k < starts[end_partition]; k++) {
+                update(positions[k]);
+              }
+            });
+      } else {
+        for (Tindex i = 0; i < N; i++) {
+          update(i);
+        }
       }
     }
 
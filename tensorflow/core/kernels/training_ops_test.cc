@@ -15,7 +15,10 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/kernels/training_op_helpers.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
@@ -185,6 +188,114 @@ BENCHMARK(BM_SparseAdagrad)
     ->ArgPair(128, 32 << 10)
     ->ArgPair(128, 128 << 10);
 
+static Node* ResourceVar(Graph* g, const string& name, int m, int n) {
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "VarHandleOp")
+                  .Attr("dtype", DT_FLOAT)
+                  .Attr("shape", TensorShape({m, n}))
+                  .Attr("shared_name", name)
+                  .Finalize(g, &ret));
+  return ret;
+}
+
+static void AssignResourceVar(Graph* g, Node* var, Node* value) {
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "AssignVariableOp")
+                  .Input(var)
+                  .Input(value)
+                  .Finalize(g, &ret));
+}
+
+static Node* RandomIndices(Graph* g, int n, int max_index, int seed) {
+  Tensor data(DT_INT32, TensorShape({n}));
+  random::PhiloxRandom philox(seed, 17);
+  random::SimplePhilox rnd(&philox);
+  int32* base = data.flat<int32>().data();
+  for (int i = 0; i < n; ++i) base[i] = rnd.Uniform(max_index);
+  return test::graph::Constant(g, data);
+}
+
+// `num_updaters` `op` nodes concurrently apply sparse gradients of `n` random
+// rows of an `m` x 64 resource variable, as on a parameter server that serves
+// many workers.
+static void ConcurrentSparseApply(const string& op, int32 num_updaters,
+                                  int32 m, int32 n, Graph** init_g,
+                                  Graph** train_g) {
+  const int kRowSize = 64;
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto zero = Zeros(g, m, kRowSize);
+    AssignResourceVar(g, ResourceVar(g, "var", m, kRowSize), zero);
+    AssignResourceVar(g, ResourceVar(g, "accum", m, kRowSize), zero);
+    *init_g = g;
+  }
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto var = ResourceVar(g, "var", m, kRowSize);
+    auto accum = ResourceVar(g, "accum", m, kRowSize);
+    auto lr = Scalar(g, 0.01);
+    auto momentum = Scalar(g, 0.01);
+    for (int i = 0; i < num_updaters; ++i) {
+      NodeBuilder builder(g->NewName("n"), op);
+      builder.Input(var)
+          .Input(accum)
+          .Input(lr)
+          .Input(Random(g, n, kRowSize))
+          .Input(RandomIndices(g, n, m, /*seed=*/i));
+      if (op == "ResourceSparseApplyMomentum") {
+        builder.Input(momentum);
+      }
+      Node* apply;
+      TF_CHECK_OK(builder.Attr("use_locking", true).Finalize(g, &apply));
+    }
+    *train_g = g;
+  }
+}
+
+// `striped_row_locks` selects striped row locks instead of exclusive locks of
+// the variables.
+static void BM_ConcurrentSparseApply(int iters, const string& op,
+                                     int num_updaters, int striped_row_locks) {
+  const int32 kRows = 1 << 18;
+  const int32 kIndices = 4096;
+  const int64 tot = static_cast<int64>(iters) * num_updaters * kIndices * 64;
+  testing::UseRealTime();
+  testing::ItemsProcessed(tot);
+  testing::BytesProcessed(tot * sizeof(float));
+  SetStripedRowLocksEnabled(striped_row_locks != 0);
+  Graph* init;
+  Graph* train;
+  ConcurrentSparseApply(op, num_updaters, kRows, kIndices, &init, &train);
+  test::Benchmark("cpu", train, GetMultiThreadedOptions(), init).Run(iters);
+  SetStripedRowLocksEnabled(false);
+}
+
+static void BM_ConcurrentSparseAdagrad(int iters, int num_updaters,
+                                       int striped_row_locks) {
+  BM_ConcurrentSparseApply(iters, "ResourceSparseApplyAdagrad", num_updaters,
+                           striped_row_locks);
+}
+BENCHMARK(BM_ConcurrentSparseAdagrad)
+    ->ArgPair(1, 0)
+    ->ArgPair(4, 0)
+    ->ArgPair(16, 0)
+    ->ArgPair(1, 1)
+    ->ArgPair(4, 1)
+    ->ArgPair(16, 1);
+
+static void BM_ConcurrentSparseMomentum(int iters, int num_updaters,
+                                        int striped_row_locks) {
+  BM_ConcurrentSparseApply(iters, "ResourceSparseApplyMomentum", num_updaters,
+                           striped_row_locks);
+}
+BENCHMARK(BM_ConcurrentSparseMomentum)
+    ->ArgPair(1, 0)
+    ->ArgPair(4, 0)
+    ->ArgPair(16, 0)
+    ->ArgPair(1, 1)
+    ->ArgPair(4, 1)
+    ->ArgPair(16, 1);
+
 static void Momentum(int32 n, Graph** init_g, Graph** train_g) {
   TensorShape shape({n});
   {
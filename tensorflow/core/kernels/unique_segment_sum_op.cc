@@ -0,0 +1,155 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace {
+
+// `UniqueSegmentSumOp` sums the rows of a sparse gradient that have the same
+// index.
+//
+// * `T` is the element type of the rows.
+// * `Index` is the type of the indices, either `int32` or `int64`.
+//
+// The indices are numbered in the order of their first occurrence, and the
+// rows are grouped by index with a counting sort.  The rows of each index are
+// then summed in their input order, independently of the other indices, so
+// that the indices can be summed in parallel with a deterministic result.
+template <typename T, typename Index>
+class UniqueSegmentSumOp : public OpKernel {
+ public:
+  explicit UniqueSegmentSumOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& data = context->input(0);
+    const Tensor& indices = context->input(1);
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(indices.shape()),
+                errors::InvalidArgument("indices must be a vector, got shape ",
+                                        indices.shape().DebugString()));
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsVectorOrHigher(data.shape()) &&
+                    data.dim_size(0) == indices.dim_size(0),
+                errors::InvalidArgument(
+                    "data.shape[0] must equal the size of indices, got data "
+                    "shape ",
+                    data.shape().DebugString(), " and indices shape ",
+                    indices.shape().DebugString()));
+
+    const int64 num_rows = indices.NumElements();
+    const auto indices_flat = indices.flat<Index>();
+
+    // The segment of each row, numbering the indices in the order of their
+    // first occurrence.
+    std::vector<Index> unique_indices;
+    std::vector<int64> segment_ids(num_rows);
+    absl::flat_hash_map<Index, int64> segment_of_index;
+    segment_of_index.reserve(num_rows);
+    for (int64 i = 0; i < num_rows; ++i) {
+      const Index index = indices_flat(i);
+      auto it = segment_of_index.try_emplace(index, unique_indices.size());
+      if (it.second) {
+        unique_indices.push_back(index);
+      }
+      segment_ids[i] = it.first->second;
+    }
+    const int64 num_segments = unique_indices.size();
+
+    Tensor* unique_indices_out = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({num_segments}),
+                                            &unique_indices_out));
+    std::copy(unique_indices.begin(), unique_indices.end(),
+              unique_indices_out->flat<Index>().data());
+
+    TensorShape output_shape = data.shape();
+    output_shape.set_dim(0, num_segments);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(1, output_shape, &output));
+    if (num_rows == 0 || data.NumElements() == 0) {
+      return;
+    }
+
+    // Group the rows by segment, keeping their input order within a segment.
+    // The rows of segment `s` are rows[row_starts[s]:row_starts[s + 1]].
+    std::vector<int64> row_starts(num_segments + 1, 0);
+    for (int64 i = 0; i < num_rows; ++i) {
+      ++row_starts[segment_ids[i] + 1];
+    }
+    for (int64 s = 0; s < num_segments; ++s) {
+      row_starts[s + 1] += row_starts[s];
+    }
+    std::vector<int64> rows(num_rows);
+    std::vector<int64> next_row(row_starts.begin(), row_starts.end() - 1);
+    for (int64 i = 0; i < num_rows; ++i) {
+      rows[next_row[segment_ids[i]]++] = i;
+    }
+
+    const int64 row_size = data.NumElements() / num_rows;
+    const T* data_ptr = data.flat<T>().data();
+    T* output_ptr = output->flat<T>().data();
+    auto sum_segments = [&](int64 start, int64 limit) {
+      for (int64 s = start; s < limit; ++s) {
+        T* out = output_ptr + s * row_size;
+        const T* first = data_ptr + rows[row_starts[s]] * row_size;
+        std::copy(first, first + row_size, out);
+        for (int64 r = row_starts[s] + 1; r < row_starts[s + 1]; ++r) {
+          const T* row = data_ptr + rows[r] * row_size;
+          for (int64 j = 0; j < row_size; ++j) {
+            out[j] += row[j];
+          }
+        }
+      }
+    };
+    const int64 cost_per_segment = (num_rows / num_segments) * row_size;
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+          cost_per_segment, sum_segments);
+  }
+};
+
+#define REGISTER_UNIQUE_SEGMENT_SUM(type, index_type)                  \
+  REGISTER_KERNEL_BUILDER(Name("_UniqueSegmentSum")                    \
+                              .Device(DEVICE_CPU)                      \
+                              .TypeConstraint<type>("T")               \
+                              .TypeConstraint<index_type>("Tindices"), \
+                          UniqueSegmentSumOp<type, index_type>)
+
+#define REGISTER_UNIQUE_SEGMENT_SUM_ALL_INDICES(type) \
+  REGISTER_UNIQUE_SEGMENT_SUM(type, int32);           \
+  REGISTER_UNIQUE_SEGMENT_SUM(type, int64)
+
+TF_CALL_half(REGISTER_UNIQUE_SEGMENT_SUM_ALL_INDICES);
+TF_CALL_bfloat16(REGISTER_UNIQUE_SEGMENT_SUM_ALL_INDICES);
+TF_CALL_float(REGISTER_UNIQUE_SEGMENT_SUM_ALL_INDICES);
+TF_CALL_double(REGISTER_UNIQUE_SEGMENT_SUM_ALL_INDICES);
+
+#undef REGISTER_UNIQUE_SEGMENT_SUM_ALL_INDICES
+#undef REGISTER_UNIQUE_SEGMENT_SUM
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,168 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class UniqueSegmentSumOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(DataType index_type) {
+    TF_ASSERT_OK(NodeDefBuilder("unique_segment_sum", "_UniqueSegmentSum")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(index_type))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(UniqueSegmentSumOpTest, SumsDuplicatesInFirstOccurrenceOrder) {
+  MakeOp(DT_INT64);
+  AddInputFromArray<float>(TensorShape({5, 2}),
+                           {1, 2, 10, 20, 3, 4, 100, 200, 5, 6});
+  AddInputFromArray<int64>(TensorShape({5}), {7, 3, 7, 9, 7});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_indices(DT_INT64, TensorShape({3}));
+  test::FillValues<int64>(&expected_indices, {7, 3, 9});
+  test::ExpectTensorEqual<int64>(expected_indices, *GetOutput(0));
+  Tensor expected_sums(DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected_sums, {9, 12, 10, 20, 100, 200});
+  test::ExpectTensorEqual<float>(expected_sums, *GetOutput(1));
+}
+
+TEST_F(UniqueSegmentSumOpTest, VectorData) {
+  MakeOp(DT_INT32);
+  AddInputFromArray<float>(TensorShape({4}), {1, 2, 3, 4});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, -1, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_indices(DT_INT32, TensorShape({2}));
+  test::FillValues<int32>(&expected_indices, {0, -1});
+  test::ExpectTensorEqual<int32>(expected_indices, *GetOutput(0));
+  Tensor expected_sums(DT_FLOAT, TensorShape({2}));
+  test::FillValues<float>(&expected_sums, {7, 3});
+  test::ExpectTensorEqual<float>(expected_sums, *GetOutput(1));
+}
+
+TEST_F(UniqueSegmentSumOpTest, Empty) {
+  MakeOp(DT_INT32);
+  AddInputFromArray<float>(TensorShape({0, 3}), {});
+  AddInputFromArray<int32>(TensorShape({0}), {});
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(TensorShape({0}), GetOutput(0)->shape());
+  EXPECT_EQ(TensorShape({0, 3}), GetOutput(1)->shape());
+}
+
+TEST_F(UniqueSegmentSumOpTest, MismatchedSizes) {
+  MakeOp(DT_INT32);
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+// Compares against Unique followed by UnsortedSegmentSum on a gradient large
+// enough to be summed by several threads.
+TEST_F(UniqueSegmentSumOpTest, MatchesUnsortedSegmentSum) {
+  MakeOp(DT_INT64);
+  const int kNumRows = 10000;
+  const int kRowSize = 16;
+  const int kNumIndices = 100;
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> indices(kNumRows);
+  std::vector<float> data(kNumRows * kRowSize);
+  for (int i = 0; i < kNumRows; ++i) {
+    indices[i] = rnd.Uniform(kNumIndices) * 1000;
+  }
+  for (float& value : data) {
+    value = rnd.RandFloat();
+  }
+  AddInputFromArray<float>(TensorShape({kNumRows, kRowSize}), data);
+  AddInputFromArray<int64>(TensorShape({kNumRows}), indices);
+  TF_ASSERT_OK(RunOpKernel());
+
+  std::vector<int64> unique_indices;
+  std::vector<float> sums;
+  for (int i = 0; i < kNumRows; ++i) {
+    auto it = std::find(unique_indices.begin(), unique_indices.end(),
+                        indices[i]);
+    const int segment = it - unique_indices.begin();
+    if (it == unique_indices.end()) {
+      unique_indices.push_back(indices[i]);
+      sums.resize(sums.size() + kRowSize, 0.0f);
+    }
+    for (int j = 0; j < kRowSize; ++j) {
+      sums[segment * kRowSize + j] += data[i * kRowSize + j];
+    }
+  }
+  const int64 num_unique = unique_indices.size();
+  Tensor expected_indices(DT_INT64, TensorShape({num_unique}));
+  test::FillValues<int64>(&expected_indices, unique_indices);
+  test::ExpectTensorEqual<int64>(expected_indices, *GetOutput(0));
+  Tensor expected_sums(DT_FLOAT, TensorShape({num_unique, kRowSize}));
+  test::FillValues<float>(&expected_sums, sums);
+  // The rows are added in the same order, so the sums are exactly equal.
+  test::ExpectTensorEqual<float>(expected_sums, *GetOutput(1));
+}
+
+static Graph* UniqueSegmentSum(int num_rows, int row_size, int num_indices) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor data(DT_FLOAT, TensorShape({num_rows, row_size}));
+  data.flat<float>().setRandom();
+  Tensor indices(DT_INT64, TensorShape({num_rows}));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  for (int i = 0; i < num_rows; ++i) {
+    indices.flat<int64>()(i) = rnd.Uniform(num_indices);
+  }
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_UniqueSegmentSum")
+                  .Input(test::graph::Constant(g, data))
+                  .Input(test::graph::Constant(g, indices))
+                  .Finalize(g, &node));
+  return g;
+}
+
+// The number of rows is fixed, and the arg is the number of distinct
+// indices, so smaller args have more duplicates.
+static void BM_UniqueSegmentSum(int iters, int num_indices) {
+  const int kNumRows = 65536;
+  const int kRowSize = 64;
+  testing::ItemsProcessed(static_cast<int64>(iters) * kNumRows * kRowSize);
+  test::Benchmark("cpu", UniqueSegmentSum(kNumRows, kRowSize, num_indices))
+      .Run(iters);
+}
+BENCHMARK(BM_UniqueSegmentSum)->Arg(256)->Arg(4096)->Arg(65536);
+
+}  // namespace
+}  // namespace tensorflow
@@ -515,4 +515,141 @@ REGISTER_OP("InitializeTableFromDataset")
       return Status::OK();
     });
 
+// --------------------------------------------------------------------------
+
+namespace {
+
+// Returns the shape of keys followed by the embedding dimension, which is the
+// last dimension of `embedding`.
+Status EmbeddingShape(InferenceContext* c, ShapeHandle keys,
+                      ShapeHandle embedding, ShapeHandle* out) {
+  DimensionHandle dim = c->UnknownDim();
+  if (c->RankKnown(embedding) && c->Rank(embedding) > 0) {
+    dim = c->Dim(embedding, -1);
+  }
+  return c->Concatenate(keys, c->Vector(dim), out);
+}
+
+Status HashEmbeddingSparseApplyShape(InferenceContext* c) {
+  ShapeHandle handle;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+  ShapeHandle grad;
+  TF_RETURN_IF_ERROR(EmbeddingShape(c, c->input(1), c->input(2), &grad));
+  TF_RETURN_IF_ERROR(c->Merge(grad, c->input(2), &grad));
+  ShapeHandle lr;
+  return c->WithRank(c->input(3), 0, &lr);
+}
+
+}  // namespace
+
+REGISTER_OP("HashEmbeddingVariable")
+    .Output("resource: resource")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .Attr("dtype: {float, double}")
+    .Attr("embedding_dim: int >= 1")
+    .Attr("num_slots: int >= 0 = 0")
+    .Attr("slot_initial_value: float = 0.0")
+    .Attr("min_frequency: int >= 0 = 0")
+    .Attr("ttl_steps: int >= 0 = 0")
+    .Attr("max_size: int >= 0 = 0")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::ScalarShape);
+
+REGISTER_OP("HashEmbeddingGather")
+    .Input("resource: resource")
+    .Input("keys: int64")
+    .Input("default_value: dtype")
+    .Output("output: dtype")
+    .Attr("dtype: {float, double}")
+    .Attr("insert_missing: bool = true")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+      ShapeHandle output;
+      TF_RETURN_IF_ERROR(EmbeddingShape(c, c->input(1), c->input(2), &output));
+      c->set_output(0, output);
+      return Status::OK();
+    });
+
+REGISTER_OP("HashEmbeddingSparseApplyGradientDescent")
+    .Input("resource: resource")
+    .Input("keys: int64")
+    .Input("grad: dtype")
+    .Input("lr: dtype")
+    .Attr("dtype: {float, double}")
+    .SetShapeFn(HashEmbeddingSparseApplyShape);
+
+REGISTER_OP("HashEmbeddingSparseApplyAdagrad")
+    .Input("resource: resource")
+    .Input("keys: int64")
+    .Input("grad: dtype")
+    .Input("lr: dtype")
+    .Attr("dtype: {float, double}")
+    .SetShapeFn(HashEmbeddingSparseApplyShape);
+
+REGISTER_OP("HashEmbeddingEvict")
+    .Input("resource: resource")
+    .Output("num_evicted: int64")
+    .Attr("dtype: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    });
+
+REGISTER_OP("HashEmbeddingSize")
+    .Input("resource: resource")
+    .Output("size: int64")
+    .Attr("dtype: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    });
+
+REGISTER_OP("HashEmbeddingExport")
+    .Input("resource: resource")
+    .Output("keys: int64")
+    .Output("values: dtype")
+    .Output("slots: dtype")
+    .Output("frequencies: int64")
+    .Output("last_steps: int64")
+    .Attr("dtype: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+      DimensionHandle num_rows = c->UnknownDim();
+      c->set_output(0, c->Vector(num_rows));
+      c->set_output(1, c->Matrix(num_rows, c->UnknownDim()));
+      c->set_output(2, c->MakeShape({num_rows, c->UnknownDim(),
+                                     c->UnknownDim()}));
+      c->set_output(3, c->Vector(num_rows));
+      c->set_output(4, c->Vector(num_rows));
+      return Status::OK();
+    });
+
+REGISTER_OP("HashEmbeddingImport")
+    .Input("resource: resource")
+    .Input("keys: int64")
+    .Input("values: dtype")
+    .Input("slots: dtype")
+    .Input("frequencies: int64")
+    .Input("last_steps: int64")
+    .Attr("dtype: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle handle;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &handle));
+      ShapeHandle keys;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &keys));
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 3, &unused));
+      TF_RETURN_IF_ERROR(c->Merge(keys, c->input(4), &unused));
+      TF_RETURN_IF_ERROR(c->Merge(keys, c->input(5), &unused));
+      return Status::OK();
+    });
+
 }  // namespace tensorflow
@@ -1293,6 +1293,40 @@ REGISTER_OP("UnsortedSegmentSum")
     .Attr("Tnumsegments: {int32,int64} = DT_INT32")
     .SetShapeFn(shape_inference::UnsortedSegmentReductionShapeFn);
 
+REGISTER_OP("_UniqueSegmentSum")
+    .Input("data: T")
+    .Input("indices: Tindices")
+    .Output("unique_indices: Tindices")
+    .Output("output: T")
+    .Attr("T: {half, bfloat16, float, double}")
+    .Attr("Tindices: {int32,int64}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle indices;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &indices));
+      ShapeHandle data;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &data));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(data, 0), c->Dim(indices, 0), &unused));
+      ShapeHandle row_shape;
+      TF_RETURN_IF_ERROR(c->Subshape(data, 1, &row_shape));
+      ShapeHandle output;
+      TF_RETURN_IF_ERROR(c->Concatenate(
+          c->Vector(InferenceContext::kUnknownDim), row_shape, &output));
+      c->set_output(0, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(1, output);
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Sums the rows of `data` that have the same index.
+
+`unique_indices` holds the distinct values of `indices` in the order of their
+first occurrence, and `output[i]` is the sum of the rows `data[j]` with
+`indices[j] == unique_indices[i]`, added in the order of `j`.  This is
+`Unique` followed by `UnsortedSegmentSum`, fused so that the duplicate rows
+of a sparse gradient are aggregated before it is sent to another device.
+)doc");
+
 REGISTER_OP("UnsortedSegmentMax")
     .Input("data: T")
     .Input("segment_ids: Tindices")
@@ -31,14 +31,16 @@ constexpr int32_t kNodeNotAssigned = std::numeric_limits<int32_t>::max();
 ArenaPlanner::ArenaPlanner(TfLiteContext* context,
                            std::unique_ptr<GraphInfo> graph_info,
                            bool preserve_inputs, bool preserve_intermediates,
-                           int tensor_alignment)
+                           int tensor_alignment,
+                           ArenaPlanningStrategy strategy)
     : context_(context),
       graph_info_(std::move(graph_info)),
       arena_(kDefaultArenaAlignment),
       persistent_arena_(kDefaultArenaAlignment),
       preserve_inputs_(preserve_inputs),
       preserve_intermediates_(preserve_intermediates),
-      tensor_alignment_(tensor_alignment) {}
+      tensor_alignment_(tensor_alignment),
+      strategy_(strategy) {}
 
 ArenaPlanner::~ArenaPlanner() {}
 
@@ -253,6 +255,10 @@ bool ArenaPlanner::HasNonPersistentMemory() {
   return arena_.GetBufferSize() != 0;
 }
 
+size_t ArenaPlanner::GetNonPersistentMemorySize() {
+  return arena_.RequiredBufferSize();
+}
+
 TfLiteStatus ArenaPlanner::Commit() {
   TF_LITE_ENSURE_STATUS(arena_.Commit(context_));
   TF_LITE_ENSURE_STATUS(persistent_arena_.Commit(context_));
@@ -297,9 +303,84 @@ std::vector<int32_t> ArenaPlanner::CreateTensorAllocationVector(int first_node,
   // Indices of tensors in order their allocation offsets will be calculated.
   std::sort(tensor_order.begin(), tensor_order.end(), tensor_compare);
 
+  // Tensors that live through the whole inference now form a prefix of
+  // `tensor_order`, and only the order of the remaining ones depends on the
+  // strategy.
+  auto others_begin = std::find_if(
+      tensor_order.begin(), tensor_order.end(), [this](int32_t idx) {
+        return this->alloc_node_[idx] != 0 ||
+               this->dealloc_node_[idx] != kNodeNotAssigned;
+      });
+  switch (strategy_) {
+    case ArenaPlanningStrategy::kGreedyBySize:
+      break;
+    case ArenaPlanningStrategy::kGreedyByBreadth:
+      OrderTensorsByBreadth(others_begin, tensor_order.end());
+      break;
+    case ArenaPlanningStrategy::kExecutionOrder:
+      std::sort(others_begin, tensor_order.end(),
+                [this](int32_t idx1, int32_t idx2) {
+                  if (this->alloc_node_[idx1] != this->alloc_node_[idx2]) {
+                    return this->alloc_node_[idx1] < this->alloc_node_[idx2];
+                  }
+                  return idx1 < idx2;
+                });
+      break;
+  }
+
   return tensor_order;
 }
 
+void ArenaPlanner::OrderTensorsByBreadth(std::vector<int32_t>::iterator begin,
+                                         std::vector<int32_t>::iterator end) {
+  const int num_nodes = static_cast<int>(graph_info_->num_nodes());
+  if (num_nodes == 0 || begin == end) return;
+
+  // Graph outputs are never deallocated, so they stay alive until the last
+  // node.
+  auto last_use = [this, num_nodes](int32_t idx) {
+    return std::min(this->dealloc_node_[idx], num_nodes - 1);
+  };
+
+  // The breadth of a node is the total size of the arena tensors that are
+  // alive while it executes.
+  std::vector<size_t> breadth(num_nodes, 0);
+  for (auto it = begin; it != end; ++it) {
+    const TfLiteTensor& tensor = *graph_info_->tensor(*it);
+    if (tensor.allocation_type != kTfLiteArenaRw) continue;
+    for (int node = alloc_node_[*it]; node <= last_use(*it); ++node) {
+      breadth[node] += tensor.bytes;
+    }
+  }
+  std::vector<int> nodes(num_nodes);
+  for (int i = 0; i < num_nodes; ++i) nodes[i] = i;
+  std::stable_sort(nodes.begin(), nodes.end(), [&breadth](int a, int b) {
+    return breadth[a] > breadth[b];
+  });
+
+  // Visit the nodes from the widest to the narrowest and append the tensors
+  // alive at each of them. Since the input is sorted by size, the tensors of
+  // a node are appended largest first.
+  std::vector<int32_t> unordered(begin, end);
+  std::vector<int32_t> ordered;
+  ordered.reserve(unordered.size());
+  std::vector<bool> visited(unordered.size(), false);
+  for (int node : nodes) {
+    for (size_t i = 0; i < unordered.size(); ++i) {
+      const int32_t idx = unordered[i];
+      if (!visited[i] && alloc_node_[idx] <= node && node <= last_use(idx)) {
+        ordered.push_back(idx);
+        visited[i] = true;
+      }
+    }
+  }
+  // Tensors that are not alive at any node keep their size order at the end.
+  for (size_t i = 0; i < unordered.size(); ++i) {
+    if (!visited[i]) ordered.push_back(unordered[i]);
+  }
+  std::copy(ordered.begin(), ordered.end(), begin);
+}
+
 TfLiteStatus ArenaPlanner::CalculateAllocations(int first_node, int last_node) {
   // Indices of tensors in order their allocation offsets will be calculated.
   const std::vector<int32_t> tensor_order =
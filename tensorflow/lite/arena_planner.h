@@ -32,6 +32,24 @@ constexpr const int kDefaultTensorAlignment = 64;
 
 struct AllocationInfo;
 
+// Determines the order in which the ArenaPlanner assigns arena offsets to
+// non-persistent tensors. Each tensor is placed in the best-fitting gap left by
+// the tensors already placed, so the visiting order decides how tightly the
+// tensors get packed and therefore the peak size of the arena.
+enum class ArenaPlanningStrategy {
+  // Tensors are visited in non-increasing order of their size. This is the
+  // default, and usually yields the smallest arena.
+  kGreedyBySize,
+  // Nodes are visited in non-increasing order of their breadth, i.e. the total
+  // size of the tensors live while the node executes. The unplaced tensors of
+  // each node are visited largest first. This favors the nodes that determine
+  // the peak memory usage of the graph.
+  kGreedyByBreadth,
+  // Tensors are visited in the order they are first used. This is the naive
+  // strategy, mostly useful as a baseline.
+  kExecutionOrder,
+};
+
 // A memory planner that makes all the allocations using arenas.
 //
 // Before a model is executed by the interpreter, this class determines when
@@ -50,10 +68,13 @@ class ArenaPlanner : public MemoryPlanner {
   // Ownership of 'context' is not taken and it must remain util the
   // ArenaPlanner is destroyed. If 'preserve_inputs' is true the inputs to the
   // graph will not share memory with any other tensor, effectively preserving
-  // them until the end of inference.
+  // them until the end of inference. 'strategy' selects the order in which
+  // tensors are assigned their offsets in the arena.
   ArenaPlanner(TfLiteContext* context, std::unique_ptr<GraphInfo> graph_info,
                bool preserve_inputs, bool preserve_intermediates,
-               int tensor_alignment = kDefaultTensorAlignment);
+               int tensor_alignment = kDefaultTensorAlignment,
+               ArenaPlanningStrategy strategy =
+                   ArenaPlanningStrategy::kGreedyBySize);
   ~ArenaPlanner() override;
   ArenaPlanner(const ArenaPlanner&) = delete;
   ArenaPlanner& operator=(const ArenaPlanner&) = delete;
@@ -65,6 +86,7 @@ class ArenaPlanner : public MemoryPlanner {
   TfLiteStatus ReleaseNonPersistentMemory() override;
   TfLiteStatus AcquireNonPersistentMemory() override;
   bool HasNonPersistentMemory() override;
+  size_t GetNonPersistentMemorySize() override;
 
   // Returns the base arena location for a given allocation type.
   std::intptr_t BasePointer(TfLiteAllocationType type);
@@ -78,12 +100,19 @@ class ArenaPlanner : public MemoryPlanner {
   // Comparator to sort tensors for the allocation algorithm:
   // - Tensors that have lifespan through the whole model inference time go
   // first;
-  // - Other tensors (e.g. intermediate and temporary ones) are sorted in
+  // - Other tensors (e.g. intermediate and temporary ones) are ordered
+  // according to `strategy_`. For kGreedyBySize they are sorted in
   // non-increasing order of their size. If sizes of two tensors are equal, the
   // one that needs to be allocated earlier goes first.
   std::vector<int32_t> CreateTensorAllocationVector(int first_node,
                                                     int last_node);
 
+  // Reorders the tensors in [begin, end), which must already be sorted by
+  // size, so that the tensors of the nodes with the largest breadth come
+  // first.
+  void OrderTensorsByBreadth(std::vector<int32_t>::iterator begin,
+                             std::vector<int32_t>::iterator end);
+
   // Traverse the allocation queue and reserve space in the appropriate arena
   // for all tensors affected by ops in the interval [first_node, last_node].
   TfLiteStatus CalculateAllocations(int first_node, int last_node);
@@ -133,6 +162,9 @@ class ArenaPlanner : public MemoryPlanner {
 
   // Number of bytes that tensor buffers should be aligned to.
   int tensor_alignment_;
+
+  // Order in which tensors are assigned their offsets in `arena_`.
+  ArenaPlanningStrategy strategy_;
 };
 
 }  // namespace tflite
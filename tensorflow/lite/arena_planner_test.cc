@@ -163,12 +163,15 @@ void ReportError(TfLiteContext* context, const char* format, ...) {
 
 class ArenaPlannerTest : public ::testing::Test {
  protected:
-  void SetGraph(TestGraph* graph, bool preserve_inputs = false) {
+  void SetGraph(TestGraph* graph, bool preserve_inputs = false,
+                ArenaPlanningStrategy strategy =
+                    ArenaPlanningStrategy::kGreedyBySize) {
     graph_ = graph;
     context_.ReportError = ReportError;
     planner_.reset(new ArenaPlanner(
         &context_, std::unique_ptr<GraphInfo>(new TestGraphInfo(graph)),
-        preserve_inputs, /*preserve intermediates*/ false, kTensorAlignment));
+        preserve_inputs, /*preserve intermediates*/ false, kTensorAlignment,
+        strategy));
     CHECK(planner_->ResetAllocations() == kTfLiteOk);
     CHECK(planner_->PlanAllocations() == kTfLiteOk);
   }
@@ -667,6 +670,126 @@ TEST_F(ArenaPlannerTest, ComplexGraph) {
   EXPECT_EQ(GetOffset(8), 0);
 }
 
+TEST_F(ArenaPlannerTest, ComplexGraphGreedyByBreadth) {
+  TestGraph graph({0},
+                  {
+                      /* in, out, tmp */
+                      {{0}, {1}, {}},
+                      {{1}, {2}, {}},
+                      {{1}, {3}, {}},
+                      {{1}, {4}, {}},
+                      {{2, 3, 4}, {5}, {}},
+                      {{5}, {6}, {}},
+                      {{5}, {7}, {}},
+                      {{6, 7}, {8}, {}},
+                  },
+                  {8});
+  (*graph.tensors())[0].bytes = 32;
+  (*graph.tensors())[1].bytes = 28;
+  (*graph.tensors())[2].bytes = 36;
+  (*graph.tensors())[3].bytes = 16;
+  (*graph.tensors())[4].bytes = 8;
+  (*graph.tensors())[5].bytes = 64;
+  (*graph.tensors())[6].bytes = 10;
+  (*graph.tensors())[7].bytes = 40;
+  SetGraph(&graph, /*preserve_inputs=*/false,
+           ArenaPlanningStrategy::kGreedyByBreadth);
+  Execute(0, 10);
+
+  // Alloc(+) and dealloc(-) order: +0 +1 -0 +2 +3 +4 -1 +5 -2 -3 -4 +6 +7 -5 +8
+  // The widest node is the fifth one, so its tensors (5, 2, 3, 4) are placed
+  // first, followed by the ones of the seventh node (7, 6).
+  EXPECT_EQ(GetOffset(5), 0);
+  EXPECT_EQ(GetOffset(2), GetOffsetAfter(5));
+  EXPECT_EQ(GetOffset(3), GetOffsetAfter(2));
+  EXPECT_EQ(GetOffset(4), GetOffsetAfter(3));
+  EXPECT_EQ(GetOffset(7), GetOffsetAfter(5));
+  EXPECT_EQ(GetOffset(6), GetOffsetAfter(7));
+  EXPECT_EQ(GetOffset(1), 0);
+  EXPECT_EQ(GetOffset(0), GetOffsetAfter(1));
+  EXPECT_EQ(GetOffset(8), 0);
+}
+
+TEST_F(ArenaPlannerTest, ComplexGraphExecutionOrder) {
+  TestGraph graph({0},
+                  {
+                      /* in, out, tmp */
+                      {{0}, {1}, {}},
+                      {{1}, {2}, {}},
+                      {{1}, {3}, {}},
+                      {{1}, {4}, {}},
+                      {{2, 3, 4}, {5}, {}},
+                      {{5}, {6}, {}},
+                      {{5}, {7}, {}},
+                      {{6, 7}, {8}, {}},
+                  },
+                  {8});
+  (*graph.tensors())[0].bytes = 32;
+  (*graph.tensors())[1].bytes = 28;
+  (*graph.tensors())[2].bytes = 36;
+  (*graph.tensors())[3].bytes = 16;
+  (*graph.tensors())[4].bytes = 8;
+  (*graph.tensors())[5].bytes = 64;
+  (*graph.tensors())[6].bytes = 10;
+  (*graph.tensors())[7].bytes = 40;
+  SetGraph(&graph, /*preserve_inputs=*/false,
+           ArenaPlanningStrategy::kExecutionOrder);
+  Execute(0, 10);
+
+  // Alloc(+) and dealloc(-) order: +0 +1 -0 +2 +3 +4 -1 +5 -2 -3 -4 +6 +7 -5 +8
+  EXPECT_EQ(GetOffset(0), 0);
+  EXPECT_EQ(GetOffset(1), GetOffsetAfter(0));
+  EXPECT_EQ(GetOffset(2), GetOffsetAfter(1));
+  EXPECT_EQ(GetOffset(3), 0);
+  EXPECT_EQ(GetOffset(4), GetOffsetAfter(3));
+  EXPECT_EQ(GetOffset(5), GetOffsetAfter(2));
+  EXPECT_EQ(GetOffset(6), 0);
+  EXPECT_EQ(GetOffset(7), GetOffsetAfter(6));
+  EXPECT_EQ(GetOffset(8), GetOffsetAfter(7));
+}
+
+TEST_F(ArenaPlannerTest, ArenaSizeDependsOnStrategy) {
+  TestGraph graph({0},
+                  {
+                      /* in, out, tmp */
+                      {{0}, {1}, {}},
+                      {{1}, {2}, {}},
+                      {{1}, {3}, {}},
+                      {{1}, {4}, {}},
+                      {{2, 3, 4}, {5}, {}},
+                      {{5}, {6}, {}},
+                      {{5}, {7}, {}},
+                      {{6, 7}, {8}, {}},
+                  },
+                  {8});
+  (*graph.tensors())[0].bytes = 32;
+  (*graph.tensors())[1].bytes = 28;
+  (*graph.tensors())[2].bytes = 36;
+  (*graph.tensors())[3].bytes = 16;
+  (*graph.tensors())[4].bytes = 8;
+  (*graph.tensors())[5].bytes = 64;
+  (*graph.tensors())[6].bytes = 10;
+  (*graph.tensors())[7].bytes = 40;
+  SetGraph(&graph, /*preserve_inputs=*/false,
+           ArenaPlanningStrategy::kGreedyBySize);
+  Execute(0, 10);
+  const size_t greedy_by_size = planner_->GetNonPersistentMemorySize();
+
+  SetGraph(&graph, /*preserve_inputs=*/false,
+           ArenaPlanningStrategy::kGreedyByBreadth);
+  Execute(0, 10);
+  const size_t greedy_by_breadth = planner_->GetNonPersistentMemorySize();
+
+  SetGraph(&graph, /*preserve_inputs=*/false,
+           ArenaPlanningStrategy::kExecutionOrder);
+  Execute(0, 10);
+  const size_t execution_order = planner_->GetNonPersistentMemorySize();
+
+  // The widest node needs 124 bytes, which both greedy strategies achieve.
+  EXPECT_EQ(greedy_by_size, greedy_by_breadth);
+  EXPECT_LT(greedy_by_size, execution_order);
+}
+
 TEST_F(ArenaPlannerTest, GraphWithIntermediates) {
   TestGraph graph({0, 1},
                   {
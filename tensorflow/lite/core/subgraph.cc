@@ -797,6 +797,17 @@ TfLiteStatus Subgraph::ResizeInputTensorStrict(int tensor_index,
   return ResizeInputTensor(tensor_index, dims);
 }
 
+void Subgraph::SetArenaPlanningStrategy(ArenaPlanningStrategy strategy) {
+  if (strategy == arena_planning_strategy_) return;
+  arena_planning_strategy_ = strategy;
+  // The planner is recreated with the new strategy, and all tensors are
+  // reallocated, on the next call to AllocateTensors().
+  if (memory_planner_) {
+    memory_planner_.reset();
+    state_ = kStateUninvokable;
+  }
+}
+
 TfLiteStatus Subgraph::ReleaseNonPersistentMemory() {
   if (memory_planner_) {
     TF_LITE_ENSURE_STATUS(memory_planner_->ReleaseNonPersistentMemory());
@@ -859,7 +870,8 @@ TfLiteStatus Subgraph::PrepareOpsAndTensors() {
   if (!memory_planner_) {
     memory_planner_.reset(new ArenaPlanner(
         &context_, std::unique_ptr<GraphInfo>(new InterpreterInfo(this)),
-        /*preserve_inputs=*/true, /*preserve_intermediates*/ false));
+        /*preserve_inputs=*/true, /*preserve_intermediates*/ false,
+        kDefaultTensorAlignment, arena_planning_strategy_));
     memory_planner_->PlanAllocations();
   }
 
@@ -22,6 +22,7 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/lite/allocation.h"
+#include "tensorflow/lite/arena_planner.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/core/api/profiler.h"
 #include "tensorflow/lite/core/macros.h"
@@ -267,6 +268,19 @@ class Subgraph {
     return context_.allow_fp32_relax_to_fp16;
   }
 
+  // Selects the order in which the arena planner assigns memory offsets to the
+  // non-persistent tensors. Takes effect on the next call to AllocateTensors().
+  // WARNING: This is an experimental API and subject to change.
+  void SetArenaPlanningStrategy(ArenaPlanningStrategy strategy);
+
+  // Returns the size in bytes of the arena holding the non-persistent tensors,
+  // as planned by the last call to AllocateTensors(), or 0 if no allocation
+  // has been planned yet.
+  // WARNING: This is an experimental API and subject to change.
+  size_t GetNonPersistentArenaSize() const {
+    return memory_planner_ ? memory_planner_->GetNonPersistentMemorySize() : 0;
+  }
+
   // Sets the cancellation function pointer in order to cancel a request in the
   // middle of a call to Invoke(). The interpreter queries this function during
   // inference, between op invocations; when it returns true, the interpreter
@@ -674,6 +688,10 @@ class Subgraph {
 
   std::unique_ptr<MemoryPlanner> memory_planner_;
 
+  // Order used by `memory_planner_` to assign offsets to arena tensors.
+  ArenaPlanningStrategy arena_planning_strategy_ =
+      ArenaPlanningStrategy::kGreedyBySize;
+
   // Tracking bit for whether a tensor was resized in the course of an op
   // invocation. This is a useful hint to ensure that dynamic tensor outputs
   // trigger downstream reallocation after op invocation.
@@ -0,0 +1,445 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/experimental/batching/batched_invoker.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "tensorflow/lite/builtin_ops.h"
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/interpreter_builder.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+namespace batching {
+namespace {
+
+// Reads the values of a constant 1-D or 2-D int32 or int64 tensor.
+bool GetConstantValues(const Interpreter& interpreter, int tensor_index,
+                       std::vector<int64_t>* values) {
+  if (tensor_index < 0) return false;
+  const TfLiteTensor* tensor = interpreter.tensor(tensor_index);
+  if (tensor->allocation_type != kTfLiteMmapRo) return false;
+  const int num_values = NumElements(tensor);
+  values->clear();
+  if (tensor->type == kTfLiteInt32) {
+    values->assign(tensor->data.i32, tensor->data.i32 + num_values);
+  } else if (tensor->type == kTfLiteInt64) {
+    values->assign(tensor->data.i64, tensor->data.i64 + num_values);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+int NumDimensions(const Interpreter& interpreter, int tensor_index) {
+  return interpreter.tensor(tensor_index)->dims->size;
+}
+
+// Returns true if 'axis', which may count from the end of a tensor of rank
+// 'rank', refers to the batch dimension.
+bool IsBatchAxis(int64_t axis, int rank) {
+  return axis == 0 || axis + rank == 0;
+}
+
+bool HasBatchAxis(const std::vector<int64_t>& axes, int rank) {
+  for (const int64_t axis : axes) {
+    if (IsBatchAxis(axis, rank)) return true;
+  }
+  return false;
+}
+
+// Returns an empty string if the node computes every batch element of its
+// outputs from the same batch element of its inputs only, or describes why it
+// doesn't.
+std::string CheckNodeIsBatchSafe(const Interpreter& interpreter,
+                                 const TfLiteNode& node,
+                                 const TfLiteRegistration& registration) {
+  const int input_rank = node.inputs->size > 0 && node.inputs->data[0] >= 0
+                             ? NumDimensions(interpreter, node.inputs->data[0])
+                             : 0;
+  const int second_input =
+      node.inputs->size > 1 ? node.inputs->data[1] : kTfLiteOptionalTensor;
+  std::vector<int64_t> values;
+
+  switch (registration.builtin_code) {
+    // Element-wise ops, whose other operands are broadcast constants or have
+    // the same batch size.
+    case kTfLiteBuiltinAbs:
+    case kTfLiteBuiltinAdd:
+    case kTfLiteBuiltinCast:
+    case kTfLiteBuiltinDequantize:
+    case kTfLiteBuiltinDiv:
+    case kTfLiteBuiltinElu:
+    case kTfLiteBuiltinExp:
+    case kTfLiteBuiltinHardSwish:
+    case kTfLiteBuiltinLeakyRelu:
+    case kTfLiteBuiltinLog:
+    case kTfLiteBuiltinLogistic:
+    case kTfLiteBuiltinMaximum:
+    case kTfLiteBuiltinMinimum:
+    case kTfLiteBuiltinMul:
+    case kTfLiteBuiltinNeg:
+    case kTfLiteBuiltinPrelu:
+    case kTfLiteBuiltinQuantize:
+    case kTfLiteBuiltinRelu:
+    case kTfLiteBuiltinRelu6:
+    case kTfLiteBuiltinReluN1To1:
+    case kTfLiteBuiltinRsqrt:
+    case kTfLiteBuiltinSqrt:
+    case kTfLiteBuiltinSquare:
+    case kTfLiteBuiltinSquaredDifference:
+    case kTfLiteBuiltinSub:
+    case kTfLiteBuiltinTanh:
+    // Ops working on each batch element of an NHWC tensor.
+    case kTfLiteBuiltinAveragePool2d:
+    case kTfLiteBuiltinConv2d:
+    case kTfLiteBuiltinDepthToSpace:
+    case kTfLiteBuiltinDepthwiseConv2d:
+    case kTfLiteBuiltinL2Pool2d:
+    case kTfLiteBuiltinLocalResponseNormalization:
+    case kTfLiteBuiltinMaxPool2d:
+    case kTfLiteBuiltinResizeBilinear:
+    case kTfLiteBuiltinResizeNearestNeighbor:
+    case kTfLiteBuiltinSpaceToDepth:
+    // Flattens its input into rows as deep as the weights, one or more per
+    // batch element.
+    case kTfLiteBuiltinFullyConnected:
+      return "";
+
+    // Ops working along the last dimension.
+    case kTfLiteBuiltinL2Normalization:
+    case kTfLiteBuiltinLogSoftmax:
+    case kTfLiteBuiltinSoftmax:
+      if (input_rank < 2) return "works along the batch dimension";
+      return "";
+
+    case kTfLiteBuiltinConcatenation: {
+      const auto* params =
+          reinterpret_cast<const TfLiteConcatenationParams*>(node.builtin_data);
+      if (IsBatchAxis(params->axis, input_rank)) {
+        return "concatenates along the batch dimension";
+      }
+      return "";
+    }
+
+    case kTfLiteBuiltinArgMax:
+    case kTfLiteBuiltinArgMin:
+    case kTfLiteBuiltinMean:
+    case kTfLiteBuiltinReduceMax:
+    case kTfLiteBuiltinReduceMin:
+    case kTfLiteBuiltinReduceProd:
+    case kTfLiteBuiltinSum:
+      if (!GetConstantValues(interpreter, second_input, &values)) {
+        return "has non-constant axes";
+      }
+      if (HasBatchAxis(values, input_rank)) {
+        return "reduces along the batch dimension";
+      }
+      return "";
+
+    case kTfLiteBuiltinMirrorPad:
+    case kTfLiteBuiltinPad:
+    case kTfLiteBuiltinPadv2:
+      // The paddings are a [rank, 2] tensor, whose first row pads the batch.
+      if (!GetConstantValues(interpreter, second_input, &values) ||
+          values.size() < 2) {
+        return "has non-constant paddings";
+      }
+      if (values[0] != 0 || values[1] != 0) {
+        return "pads the batch dimension";
+      }
+      return "";
+
+    case kTfLiteBuiltinReshape: {
+      // Only a new shape that leaves its first dimension to be inferred, and
+      // no other one, keeps the batch in place.
+      if (second_input != kTfLiteOptionalTensor &&
+          NumDimensions(interpreter, second_input) == 1) {
+        if (!GetConstantValues(interpreter, second_input, &values)) {
+          return "has a non-constant shape";
+        }
+      } else {
+        const auto* params =
+            reinterpret_cast<const TfLiteReshapeParams*>(node.builtin_data);
+        values.assign(params->shape, params->shape + params->num_dimensions);
+      }
+      if (values.size() < 2 || values[0] != -1) {
+        return "doesn't infer the batch dimension of its new shape";
+      }
+      for (int i = 1; i < values.size(); ++i) {
+        if (values[i] == -1) {
+          return "infers more than the batch dimension of its new shape";
+        }
+      }
+      return "";
+    }
+
+    case kTfLiteBuiltinSqueeze: {
+      const auto* params =
+          reinterpret_cast<const TfLiteSqueezeParams*>(node.builtin_data);
+      // Without explicit dimensions, all the dimensions of size 1, including
+      // a batch of 1, are squeezed.
+      if (params->num_squeeze_dims == 0) {
+        return "squeezes all dimensions of size 1";
+      }
+      for (int i = 0; i < params->num_squeeze_dims; ++i) {
+        if (IsBatchAxis(params->squeeze_dims[i], input_rank)) {
+          return "squeezes the batch dimension";
+        }
+      }
+      return "";
+    }
+
+    case kTfLiteBuiltinTranspose:
+      if (!GetConstantValues(interpreter, second_input, &values) ||
+          values.empty()) {
+        return "has a non-constant permutation";
+      }
+      if (values[0] != 0) return "moves the batch dimension";
+      return "";
+
+    case kTfLiteBuiltinSlice: {
+      std::vector<int64_t> sizes;
+      if (!GetConstantValues(interpreter, second_input, &values) ||
+          !GetConstantValues(interpreter, node.inputs->data[2], &sizes) ||
+          values.empty() || sizes.empty()) {
+        return "has a non-constant begin or size";
+      }
+      if (values[0] != 0 || sizes[0] != -1) {
+        return "slices the batch dimension";
+      }
+      return "";
+    }
+
+    case kTfLiteBuiltinStridedSlice: {
+      const auto* params =
+          reinterpret_cast<const TfLiteStridedSliceParams*>(node.builtin_data);
+      std::vector<int64_t> strides;
+      if (!GetConstantValues(interpreter, node.inputs->data[3], &strides) ||
+          strides.empty()) {
+        return "has non-constant strides";
+      }
+      if (params->ellipsis_mask != 0 || params->new_axis_mask != 0 ||
+          (params->shrink_axis_mask & 1) || !(params->begin_mask & 1) ||
+          !(params->end_mask & 1) || strides[0] != 1) {
+        return "slices the batch dimension";
+      }
+      return "";
+    }
+
+    default:
+      return "isn't known to be batch-safe";
+  }
+}
+
+std::string GetOpName(const TfLiteRegistration& registration) {
+  if (registration.builtin_code == BuiltinOperator_CUSTOM) {
+    return registration.custom_name ? registration.custom_name : "CUSTOM";
+  }
+  return EnumNameBuiltinOperator(
+      static_cast<BuiltinOperator>(registration.builtin_code));
+}
+
+bool IsBatchOfOne(const TfLiteTensor* tensor) {
+  return tensor->dims->size > 0 && tensor->dims->data[0] == 1;
+}
+
+}  // namespace
+
+bool IsBatchSafe(const Interpreter& interpreter, std::string* reason) {
+  for (const int index : interpreter.inputs()) {
+    const TfLiteTensor* tensor = interpreter.tensor(index);
+    if (!IsBatchOfOne(tensor) || tensor->type == kTfLiteString) {
+      *reason = std::string("Input ") + tensor->name +
+                " isn't a fixed-size tensor with a batch dimension of 1.";
+      return false;
+    }
+  }
+  for (const int index : interpreter.outputs()) {
+    const TfLiteTensor* tensor = interpreter.tensor(index);
+    if (!IsBatchOfOne(tensor) || tensor->type == kTfLiteString ||
+        tensor->allocation_type == kTfLiteDynamic) {
+      *reason = std::string("Output ") + tensor->name +
+                " isn't a fixed-size tensor with a batch dimension of 1.";
+      return false;
+    }
+  }
+  // Variable tensors hold state shared by all the batch elements.
+  for (size_t i = 0; i < interpreter.tensors_size(); ++i) {
+    if (interpreter.tensor(i)->is_variable) {
+      *reason = std::string("Tensor ") + interpreter.tensor(i)->name +
+                " is a variable.";
+      return false;
+    }
+  }
+  for (const int node_index : interpreter.execution_plan()) {
+    const auto* node_and_registration =
+        interpreter.node_and_registration(node_index);
+    const std::string node_reason =
+        CheckNodeIsBatchSafe(interpreter, node_and_registration->first,
+                             node_and_registration->second);
+    if (!node_reason.empty()) {
+      *reason = "Node " + std::to_string(node_index) + " (" +
+                GetOpName(node_and_registration->second) + ") " + node_reason +
+                ".";
+      return false;
+    }
+  }
+  return true;
+}
+
+BatchedInvoker::BatchedInvoker(const FlatBufferModel& model,
+                               const OpResolver& op_resolver,
+                               const Options& options,
+                               ErrorReporter* error_reporter)
+    : model_(model),
+      op_resolver_(op_resolver),
+      options_(options),
+      error_reporter_(error_reporter) {}
+
+std::unique_ptr<BatchedInvoker> BatchedInvoker::Create(
+    const FlatBufferModel& model, const OpResolver& op_resolver,
+    const Options& options, ErrorReporter* error_reporter) {
+  if (options.max_batch_size < 1 || options.max_cached_batch_sizes < 1) {
+    error_reporter->Report(
+        "max_batch_size and max_cached_batch_sizes must be positive.");
+    return nullptr;
+  }
+  std::unique_ptr<BatchedInvoker> invoker(
+      new BatchedInvoker(model, op_resolver, options, error_reporter));
+
+  std::unique_ptr<Interpreter> interpreter;
+  if (invoker->BuildInterpreter(&interpreter) != kTfLiteOk ||
+      interpreter->AllocateTensors() != kTfLiteOk) {
+    error_reporter->Report("Failed to build the batch-1 interpreter.");
+    return nullptr;
+  }
+  std::string reason;
+  if (!IsBatchSafe(*interpreter, &reason)) {
+    error_reporter->Report("The model isn't batch-safe: %s", reason.c_str());
+    return nullptr;
+  }
+
+  for (const int index : interpreter->inputs()) {
+    const TfLiteTensor* tensor = interpreter->tensor(index);
+    invoker->input_shapes_.emplace_back(
+        tensor->dims->data, tensor->dims->data + tensor->dims->size);
+    invoker->input_bytes_.push_back(tensor->bytes);
+  }
+  for (const int index : interpreter->outputs()) {
+    invoker->output_bytes_.push_back(interpreter->tensor(index)->bytes);
+  }
+  invoker->interpreters_.emplace_front(1, std::move(interpreter));
+  return invoker;
+}
+
+TfLiteStatus BatchedInvoker::BuildInterpreter(
+    std::unique_ptr<Interpreter>* interpreter) {
+  TF_LITE_ENSURE_STATUS(InterpreterBuilder(model_, op_resolver_)(
+      interpreter, options_.num_threads));
+  if (!*interpreter) return kTfLiteError;
+  return kTfLiteOk;
+}
+
+Interpreter* BatchedInvoker::GetInterpreter(int batch_size) {
+  for (auto it = interpreters_.begin(); it != interpreters_.end(); ++it) {
+    if (it->first == batch_size) {
+      interpreters_.splice(interpreters_.begin(), interpreters_, it);
+      return it->second.get();
+    }
+  }
+
+  std::unique_ptr<Interpreter> interpreter;
+  if (BuildInterpreter(&interpreter) != kTfLiteOk) return nullptr;
+  for (int i = 0; i < input_shapes_.size(); ++i) {
+    std::vector<int> shape = input_shapes_[i];
+    shape[0] = batch_size;
+    if (interpreter->ResizeInputTensor(interpreter->inputs()[i], shape) !=
+        kTfLiteOk) {
+      return nullptr;
+    }
+  }
+  if (interpreter->AllocateTensors() != kTfLiteOk) return nullptr;
+  // Double-check that the outputs grew with the batch, which is what the
+  // batch-safety check is meant to guarantee.
+  for (int i = 0; i < output_bytes_.size(); ++i) {
+    const TfLiteTensor* tensor = interpreter->output_tensor(i);
+    if (tensor->dims->size == 0 || tensor->dims->data[0] != batch_size ||
+        tensor->bytes != output_bytes_[i] * batch_size) {
+      error_reporter_->Report("Output %s doesn't have a batch of %d.",
+                              tensor->name, batch_size);
+      return nullptr;
+    }
+  }
+
+  if (interpreters_.size() >= options_.max_cached_batch_sizes) {
+    interpreters_.pop_back();
+  }
+  interpreters_.emplace_front(batch_size, std::move(interpreter));
+  return interpreters_.front().second.get();
+}
+
+TfLiteStatus BatchedInvoker::Invoke(
+    const std::vector<std::vector<const void*>>& inputs,
+    const std::vector<std::vector<void*>>& outputs) {
+  const int batch_size = inputs.size();
+  if (batch_size < 1 || batch_size > options_.max_batch_size) {
+    error_reporter_->Report("Batch size %d isn't between 1 and %d.",
+                            batch_size, options_.max_batch_size);
+    return kTfLiteError;
+  }
+  if (outputs.size() != inputs.size()) {
+    error_reporter_->Report("Got %d requests but %d sets of outputs.",
+                            batch_size, static_cast<int>(outputs.size()));
+    return kTfLiteError;
+  }
+  for (int k = 0; k < batch_size; ++k) {
+    if (inputs[k].size() != num_inputs() ||
+        outputs[k].size() != num_outputs()) {
+      error_reporter_->Report(
+          "Request %d has %d inputs and %d outputs instead of %d and %d.", k,
+          static_cast<int>(inputs[k].size()),
+          static_cast<int>(outputs[k].size()), static_cast<int>(num_inputs()),
+          static_cast<int>(num_outputs()));
+      return kTfLiteError;
+    }
+  }
+
+  Interpreter* interpreter = GetInterpreter(batch_size);
+  if (interpreter == nullptr) {
+    error_reporter_->Report("Failed to prepare a batch of %d.", batch_size);
+    return kTfLiteError;
+  }
+
+  for (int i = 0; i < num_inputs(); ++i) {
+    char* data = interpreter->input_tensor(i)->data.raw;
+    for (int k = 0; k < batch_size; ++k) {
+      std::memcpy(data + k * input_bytes_[i], inputs[k][i], input_bytes_[i]);
+    }
+  }
+  TF_LITE_ENSURE_STATUS(interpreter->Invoke());
+  for (int o = 0; o < num_outputs(); ++o) {
+    const char* data = interpreter->output_tensor(o)->data.raw;
+    for (int k = 0; k < batch_size; ++k) {
+      std::memcpy(outputs[k][o], data + k * output_bytes_[o], output_bytes_[o]);
+    }
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace batching
+}  // namespace tflite
@@ -0,0 +1,127 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_EXPERIMENTAL_BATCHING_BATCHED_INVOKER_H_
+#define TENSORFLOW_LITE_EXPERIMENTAL_BATCHING_BATCHED_INVOKER_H_
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/api/error_reporter.h"
+#include "tensorflow/lite/core/api/op_resolver.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/model_builder.h"
+
+namespace tflite {
+namespace batching {
+
+// Runs K independent requests to a model whose inputs and outputs all have a
+// batch dimension of 1 with a single Invoke(), by resizing the model to a
+// batch of K, gathering the inputs of the requests into the batched input
+// tensors and scattering the batched outputs back to the requests.
+//
+// Only models whose ops never mix values along the batch dimension can be run
+// this way, which is checked when the BatchedInvoker is created.
+//
+// Example:
+//
+//   auto invoker = BatchedInvoker::Create(*model, resolver);
+//   // inputs[k][i] holds input i of request k, outputs[k][o] receives
+//   // output o of request k.
+//   invoker->Invoke(inputs, outputs);
+//
+// Interpreters planned for the most recently used batch sizes are kept, so
+// that serving a recurring batch size doesn't resize and reallocate tensors.
+//
+// Not thread-safe.
+class BatchedInvoker {
+ public:
+  struct Options {
+    // Largest number of requests that a single Invoke() accepts.
+    int max_batch_size = 64;
+    // Number of batch sizes for which a planned interpreter is kept.
+    int max_cached_batch_sizes = 4;
+    // Number of threads of each interpreter, -1 lets TFLite decide.
+    int num_threads = -1;
+  };
+
+  // Returns nullptr, and reports why through 'error_reporter', if the model
+  // can't be built or isn't batch-safe. 'model' and 'op_resolver' must
+  // outlive the returned BatchedInvoker.
+  static std::unique_ptr<BatchedInvoker> Create(
+      const FlatBufferModel& model, const OpResolver& op_resolver,
+      const Options& options = Options(),
+      ErrorReporter* error_reporter = DefaultErrorReporter());
+
+  BatchedInvoker(const BatchedInvoker&) = delete;
+  BatchedInvoker& operator=(const BatchedInvoker&) = delete;
+
+  // Runs 'inputs.size()' requests at once. inputs[k][i] points to the data of
+  // input i of request k, laid out as in the batch-1 input tensor, and
+  // outputs[k][o] points to the 'output_bytes(o)' bytes that receive output o
+  // of request k.
+  TfLiteStatus Invoke(const std::vector<std::vector<const void*>>& inputs,
+                      const std::vector<std::vector<void*>>& outputs);
+
+  size_t num_inputs() const { return input_bytes_.size(); }
+  size_t num_outputs() const { return output_bytes_.size(); }
+
+  // Size in bytes of input 'index', respectively output 'index', of a single
+  // request.
+  size_t input_bytes(int index) const { return input_bytes_[index]; }
+  size_t output_bytes(int index) const { return output_bytes_[index]; }
+
+  // Number of batch sizes currently holding a planned interpreter.
+  size_t num_cached_batch_sizes() const { return interpreters_.size(); }
+
+ private:
+  BatchedInvoker(const FlatBufferModel& model, const OpResolver& op_resolver,
+                 const Options& options, ErrorReporter* error_reporter);
+
+  // Builds an interpreter for the model as it is stored.
+  TfLiteStatus BuildInterpreter(std::unique_ptr<Interpreter>* interpreter);
+
+  // Returns an interpreter whose inputs are resized to 'batch_size' and whose
+  // tensors are allocated, or nullptr on failure.
+  Interpreter* GetInterpreter(int batch_size);
+
+  const FlatBufferModel& model_;
+  const OpResolver& op_resolver_;
+  const Options options_;
+  ErrorReporter* const error_reporter_;
+
+  // Shapes and per-request sizes of the batch-1 inputs and outputs.
+  std::vector<std::vector<int>> input_shapes_;
+  std::vector<size_t> input_bytes_;
+  std::vector<size_t> output_bytes_;
+
+  // Planned interpreters by batch size, the most recently used first.
+  std::list<std::pair<int, std::unique_ptr<Interpreter>>> interpreters_;
+};
+
+// Returns true if the ops of 'interpreter', whose inputs have a batch
+// dimension of 1 and whose tensors are allocated, compute every batch element
+// independently of the others. Otherwise returns false and describes the
+// first offending tensor or node in 'reason'.
+bool IsBatchSafe(const Interpreter& interpreter, std::string* reason);
+
+}  // namespace batching
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_EXPERIMENTAL_BATCHING_BATCHED_INVOKER_H_
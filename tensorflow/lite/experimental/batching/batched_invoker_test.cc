@@ -0,0 +1,178 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/experimental/batching/batched_invoker.h"
+
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "tensorflow/lite/kernels/register.h"
+#include "tensorflow/lite/model.h"
+#include "tensorflow/lite/testing/util.h"
+
+namespace tflite {
+namespace batching {
+namespace {
+
+using ::testing::ElementsAreArray;
+using ::testing::HasSubstr;
+
+// Both models have float inputs and outputs of shape [1, 8, 8, 3].
+constexpr int kNumValues = 8 * 8 * 3;
+
+class BatchedInvokerTest : public ::testing::Test {
+ protected:
+  std::unique_ptr<BatchedInvoker> CreateInvoker(
+      const char* model_path,
+      const BatchedInvoker::Options& options = BatchedInvoker::Options()) {
+    model_ = FlatBufferModel::BuildFromFile(model_path);
+    EXPECT_NE(model_, nullptr);
+    return BatchedInvoker::Create(*model_, resolver_, options,
+                                  &error_reporter_);
+  }
+
+  // Returns the values of a request, that differ across requests.
+  static std::vector<float> RequestValues(int request, float scale = 1.0f) {
+    std::vector<float> values(kNumValues);
+    for (int i = 0; i < kNumValues; ++i) {
+      values[i] = scale * (request * kNumValues + i);
+    }
+    return values;
+  }
+
+  // Runs 'batch_size' requests to the add.bin model, whose output is three
+  // times its input, and checks that every request gets its own output.
+  void RunAddRequests(BatchedInvoker* invoker, int batch_size) {
+    std::vector<std::vector<float>> input_values;
+    std::vector<std::vector<float>> output_values(
+        batch_size, std::vector<float>(kNumValues));
+    std::vector<std::vector<const void*>> inputs;
+    std::vector<std::vector<void*>> outputs;
+    for (int k = 0; k < batch_size; ++k) {
+      input_values.push_back(RequestValues(k));
+    }
+    for (int k = 0; k < batch_size; ++k) {
+      inputs.push_back({input_values[k].data()});
+      outputs.push_back({output_values[k].data()});
+    }
+    ASSERT_EQ(invoker->Invoke(inputs, outputs), kTfLiteOk);
+    for (int k = 0; k < batch_size; ++k) {
+      EXPECT_THAT(output_values[k], ElementsAreArray(RequestValues(k, 3.0f)));
+    }
+  }
+
+  std::unique_ptr<FlatBufferModel> model_;
+  ops::builtin::BuiltinOpResolver resolver_;
+  TestErrorReporter error_reporter_;
+};
+
+TEST_F(BatchedInvokerTest, RunsSingleInputModel) {
+  auto invoker = CreateInvoker("tensorflow/lite/testdata/add.bin");
+  ASSERT_NE(invoker, nullptr);
+  EXPECT_EQ(invoker->num_inputs(), 1);
+  EXPECT_EQ(invoker->num_outputs(), 1);
+  EXPECT_EQ(invoker->input_bytes(0), kNumValues * sizeof(float));
+  EXPECT_EQ(invoker->output_bytes(0), kNumValues * sizeof(float));
+
+  for (const int batch_size : {1, 5, 2, 5}) {
+    SCOPED_TRACE(batch_size);
+    RunAddRequests(invoker.get(), batch_size);
+  }
+}
+
+TEST_F(BatchedInvokerTest, RunsMultipleInputModel) {
+  auto invoker = CreateInvoker("tensorflow/lite/testdata/multi_add.bin");
+  ASSERT_NE(invoker, nullptr);
+  ASSERT_EQ(invoker->num_inputs(), 4);
+  ASSERT_EQ(invoker->num_outputs(), 2);
+
+  // The outputs are a + b + c and b + c + d.
+  const int batch_size = 3;
+  std::vector<std::vector<float>> input_values;
+  std::vector<std::vector<float>> output_values;
+  std::vector<std::vector<const void*>> inputs(batch_size);
+  std::vector<std::vector<void*>> outputs(batch_size);
+  for (int k = 0; k < batch_size; ++k) {
+    for (int i = 0; i < 4; ++i) {
+      input_values.push_back(RequestValues(k, i + 1.0f));
+    }
+    output_values.resize(output_values.size() + 2,
+                         std::vector<float>(kNumValues));
+  }
+  for (int k = 0; k < batch_size; ++k) {
+    for (int i = 0; i < 4; ++i) {
+      inputs[k].push_back(input_values[k * 4 + i].data());
+    }
+    for (int o = 0; o < 2; ++o) {
+      outputs[k].push_back(output_values[k * 2 + o].data());
+    }
+  }
+  ASSERT_EQ(invoker->Invoke(inputs, outputs), kTfLiteOk);
+  for (int k = 0; k < batch_size; ++k) {
+    EXPECT_THAT(output_values[k * 2], ElementsAreArray(RequestValues(k, 6.0f)));
+    EXPECT_THAT(output_values[k * 2 + 1],
+                ElementsAreArray(RequestValues(k, 9.0f)));
+  }
+}
+
+TEST_F(BatchedInvokerTest, CachesRecentBatchSizes) {
+  BatchedInvoker::Options options;
+  options.max_cached_batch_sizes = 2;
+  auto invoker = CreateInvoker("tensorflow/lite/testdata/add.bin", options);
+  ASSERT_NE(invoker, nullptr);
+  // The batch-1 interpreter used for validation is kept.
+  EXPECT_EQ(invoker->num_cached_batch_sizes(), 1);
+
+  RunAddRequests(invoker.get(), 4);
+  EXPECT_EQ(invoker->num_cached_batch_sizes(), 2);
+  RunAddRequests(invoker.get(), 3);
+  RunAddRequests(invoker.get(), 4);
+  RunAddRequests(invoker.get(), 1);
+  EXPECT_EQ(invoker->num_cached_batch_sizes(), 2);
+}
+
+TEST_F(BatchedInvokerTest, RejectsInvalidRequests) {
+  BatchedInvoker::Options options;
+  options.max_batch_size = 2;
+  auto invoker = CreateInvoker("tensorflow/lite/testdata/add.bin", options);
+  ASSERT_NE(invoker, nullptr);
+
+  std::vector<float> input(kNumValues);
+  std::vector<float> output(kNumValues);
+  EXPECT_EQ(invoker->Invoke({}, {}), kTfLiteError);
+  EXPECT_EQ(invoker->Invoke({{input.data()}, {input.data()}, {input.data()}},
+                            {{output.data()}, {output.data()}, {output.data()}}),
+            kTfLiteError);
+  EXPECT_EQ(invoker->Invoke({{input.data()}}, {}), kTfLiteError);
+  EXPECT_EQ(invoker->Invoke({{input.data(), input.data()}}, {{output.data()}}),
+            kTfLiteError);
+}
+
+TEST_F(BatchedInvokerTest, RejectsModelWithoutBatchSafeOps) {
+  EXPECT_EQ(CreateInvoker("tensorflow/lite/testdata/lstm.bin"), nullptr);
+  EXPECT_THAT(error_reporter_.error_messages(),
+              HasSubstr("The model isn't batch-safe"));
+}
+
+}  // namespace
+}  // namespace batching
+}  // namespace tflite
+
+int main(int argc, char** argv) {
+  ::tflite::LogToStderr();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -328,6 +328,20 @@ void Interpreter::SetCancellationFunction(void* data,
 
 bool Interpreter::IsCancelled() { return primary_subgraph().IsCancelled(); }
 
+void Interpreter::SetArenaPlanningStrategy(ArenaPlanningStrategy strategy) {
+  for (auto& subgraph : subgraphs_) {
+    subgraph->SetArenaPlanningStrategy(strategy);
+  }
+}
+
+size_t Interpreter::GetNonPersistentArenaSize() const {
+  size_t total_size = 0;
+  for (const auto& subgraph : subgraphs_) {
+    total_size += subgraph->GetNonPersistentArenaSize();
+  }
+  return total_size;
+}
+
 TfLiteStatus Interpreter::ModifyGraphWithDelegate(TfLiteDelegate* delegate) {
   TfLiteStatus status = kTfLiteOk;
   for (auto& subgraph : subgraphs_) {
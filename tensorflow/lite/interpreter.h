@@ -391,6 +391,18 @@ class Interpreter {
   /// WARNING: This is an experimental API and subject to change.
   void SetCancellationFunction(void* data, bool (*check_cancelled_func)(void*));
 
+  /// Selects the order in which the arena planner of every subgraph assigns
+  /// memory offsets to non-persistent tensors, which determines the peak size
+  /// of the arena. AllocateTensors() must be called before the next
+  /// invocation for the new strategy to take effect.
+  /// WARNING: This is an experimental API and subject to change.
+  void SetArenaPlanningStrategy(ArenaPlanningStrategy strategy);
+
+  /// Returns the total size in bytes of the arenas holding the non-persistent
+  /// tensors of all subgraphs, as planned by the last AllocateTensors().
+  /// WARNING: This is an experimental API and subject to change.
+  size_t GetNonPersistentArenaSize() const;
+
   /// Allow a delegate to look at the graph and modify the graph to handle
   /// parts of the graph themselves. After this is called, the graph may
   /// contain new nodes that replace 1 more nodes.
@@ -455,6 +455,72 @@ void FullyConnectedInt8(const OpData* data, const TfLiteTensor* input,
 }
 }  // namespace
 
+namespace {
+template <KernelType kernel_type>
+TfLiteStatus FullyConnectedSparseInt8(TfLiteContext* context,
+                                      const OpData* data,
+                                      const TfLiteTensor* input,
+                                      const TfLiteTensor* filter,
+                                      const TfLiteTensor* bias,
+                                      TfLiteTensor* output) {
+  const auto& sparsity = *filter->sparsity;
+  if (!SupportedSparsityFormat(sparsity)) {
+    TF_LITE_KERNEL_LOG(context,
+                       "Unsupported sparse fully-connected weight format.");
+    return kTfLiteError;
+  }
+  // The optimized sparse kernels only handle symmetric weights, which is what
+  // the int8 quantization spec requires anyway.
+  TF_LITE_ENSURE_EQ(context, filter->params.zero_point, 0);
+
+  FullyConnectedParams op_params;
+  op_params.input_offset = -input->params.zero_point;
+  op_params.weights_offset = 0;
+  op_params.output_offset = output->params.zero_point;
+  op_params.output_multiplier = data->output_multiplier;
+  op_params.output_shift = data->output_shift;
+  op_params.quantized_activation_min = data->output_activation_min;
+  op_params.quantized_activation_max = data->output_activation_max;
+  if (kernel_type == kReference) {
+    reference_ops::FullyConnectedSparseWeight(
+        sparsity, op_params, GetTensorShape(input),
+        GetTensorData<int8_t>(input), GetTensorShape(filter),
+        GetTensorData<int8_t>(filter), GetTensorShape(bias),
+        GetTensorData<int32_t>(bias), GetTensorShape(output),
+        GetTensorData<int8_t>(output));
+  } else if (sparsity.dim_metadata_size == kDimMetadataSizeBlockSparse &&
+             sparsity.dim_metadata[2].dense_size == 4) {
+    // Block sparse with block size of 1x4.
+    optimized_ops::FullyConnectedSparseWeight1x4(
+        sparsity, op_params, GetTensorShape(input),
+        GetTensorData<int8_t>(input), GetTensorShape(filter),
+        GetTensorData<int8_t>(filter), GetTensorShape(bias),
+        GetTensorData<int32_t>(bias), GetTensorShape(output),
+        GetTensorData<int8_t>(output),
+        CpuBackendContext::GetFromContext(context));
+  } else if (sparsity.dim_metadata_size == kDimMetadataSizeBlockSparse &&
+             sparsity.dim_metadata[2].dense_size == 16) {
+    // Block sparse with block size of 1x16.
+    optimized_ops::FullyConnectedSparseWeight1x16(
+        sparsity, op_params, GetTensorShape(input),
+        GetTensorData<int8_t>(input), GetTensorShape(filter),
+        GetTensorData<int8_t>(filter), GetTensorShape(bias),
+        GetTensorData<int32_t>(bias), GetTensorShape(output),
+        GetTensorData<int8_t>(output),
+        CpuBackendContext::GetFromContext(context));
+  } else {
+    // Random sparse int8 weights have no optimized kernel; densify instead.
+    reference_ops::FullyConnectedSparseWeight(
+        sparsity, op_params, GetTensorShape(input),
+        GetTensorData<int8_t>(input), GetTensorShape(filter),
+        GetTensorData<int8_t>(filter), GetTensorShape(bias),
+        GetTensorData<int32_t>(bias), GetTensorShape(output),
+        GetTensorData<int8_t>(output));
+  }
+  return kTfLiteOk;
+}
+}  // namespace
+
 namespace {
 template <KernelType kernel_type>
 void FullyConnectedInt16(const OpData* data, const TfLiteTensor* input,
@@ -522,6 +588,10 @@ TfLiteStatus EvalQuantized(TfLiteContext* context, TfLiteNode* node,
         }
         break;
       case kTfLiteInt8:
+        if (filter->sparsity != nullptr) {
+          return FullyConnectedSparseInt8<kernel_type>(context, data, input,
+                                                       filter, bias, output);
+        }
         FullyConnectedInt8<kernel_type>(
             data, input, filter, bias, output,
             CpuBackendContext::GetFromContext(context));
@@ -1346,6 +1346,126 @@ TEST_P(SparseFullyConnectedOpTest, Simple1x4TestMultiThreadedMoreBatches) {
                                            ));
   }
 }
+class SparseQuantizedFullyConnectedOpModel : public SingleOpModel {
+ public:
+  SparseQuantizedFullyConnectedOpModel(
+      TfLiteRegistration* registration, int units, int batches,
+      const TensorData& input, const TensorData& weights,
+      std::initializer_list<int8_t> weights_data, const TensorData& output,
+      int num_threads = 1)
+      : batches_(batches), units_(units) {
+    input_ = AddInput(input);
+    weights_ = AddConstSparseInput(weights, weights_data);
+
+    // The scale of 'bias' depends on the scales of input and filter.
+    TensorData bias{TensorType_INT32, {units_}, 0, 0,
+                    GetScale(input_) * weights.scale};
+    bias_ = AddInput(bias);
+
+    output_ = AddOutput(output);
+
+    SetBuiltinOp(
+        BuiltinOperator_FULLY_CONNECTED, BuiltinOptions_FullyConnectedOptions,
+        CreateFullyConnectedOptions(builder_, ActivationFunctionType_RELU)
+            .Union());
+    resolver_ = absl::make_unique<SingleOpResolver>(
+        BuiltinOperator_FULLY_CONNECTED, registration);
+    BuildInterpreter({GetShape(input_), GetShape(weights_), GetShape(bias_)},
+                     num_threads, /*allow_fp32_relax_to_fp16=*/false,
+                     /*apply_delegate=*/false);
+  }
+  void SetBias(const std::vector<float>& data) {
+    QuantizeAndPopulate<int32_t>(bias_, data);
+  }
+  void SetInput(const std::vector<float>& data) {
+    QuantizeAndPopulate<int8_t>(input_, data);
+  }
+  std::vector<int8_t> GetOutput() { return ExtractVector<int8_t>(output_); }
+  std::vector<float> GetDequantizedOutput() {
+    return Dequantize<int8_t>(ExtractVector<int8_t>(output_),
+                              GetScale(output_), GetZeroPoint(output_));
+  }
+  std::vector<int> GetOutputShape() { return GetTensorShape(output_); }
+
+ protected:
+  int input_;
+  int weights_;
+  int bias_;
+  int output_;
+
+  int batches_;
+  int units_;
+};
+
+TEST_P(SparseFullyConnectedOpTest, SimpleQuantizedInt8_1x4Test) {
+  std::initializer_list<int8_t> weight_data = {
+      1, 2, 3, 4, 0, 0, 0, 0, 1, 1, 1, 1,  // u = 0
+      0, 0, 0, 0, 1, 2, 3, 4, 0, 0, 0, 0,  // u = 1
+      1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  // u = 2
+  };
+  TensorData weight = {};
+  weight.type = TensorType_INT8;
+  weight.shape = {3, 12};
+  weight.scale = 1.0;
+  weight.traversal_order = {0, 1, 2};
+  weight.format = {kTfLiteDimDense, kTfLiteDimSparseCSR};
+  weight.block_map = {1};
+  weight.block_size = {4};
+  for (int num_threads = 1; num_threads <= 4; num_threads++) {
+    SparseQuantizedFullyConnectedOpModel m(
+        GetRegistration(), /*units=*/3, /*batches=*/2,
+        /*input=*/{TensorType_INT8, {2, 12}, -63.5, 64}, weight, weight_data,
+        /*output=*/{TensorType_INT8, {}, -127, 128}, num_threads);
+    m.SetBias({1, 2, 3});
+
+    m.SetInput({
+        1, 2, 3, 4, 5, 6, 7, 8,  -9, -10, 11,  12,  // b = 0
+        1, 2, 3, 4, 5, 6, 7, -8, 9,  -10, -11, 12,  // b = 1
+    });
+
+    m.Invoke();
+
+    EXPECT_THAT(m.GetOutputShape(), ElementsAre(2, 3));
+    EXPECT_THAT(m.GetDequantizedOutput(),
+                ElementsAreArray(ArrayFloatNear({35, 72, 43, 31, 8, 23})));
+    EXPECT_THAT(m.GetOutput(), ElementsAre(34, 71, 42, 30, 7, 22));
+  }
+}
+
+TEST_P(SparseFullyConnectedOpTest, SimpleQuantizedInt8_1x16Test) {
+  std::initializer_list<int8_t> weight_data = {
+      1, 1, 1, 1, 1, 1, 1, 1, 1, 1,  1,  1,  1,  1,  1,  1,   // u = 0
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0,  0,  0,  0,  0,  0,   // u = 0
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0,  0,  0,  0,  0,  0,   // u = 1
+      1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,  // u = 1
+  };
+  TensorData weight = {};
+  weight.type = TensorType_INT8;
+  weight.shape = {2, 32};
+  weight.scale = 1.0;
+  weight.traversal_order = {0, 1, 2};
+  weight.format = {kTfLiteDimDense, kTfLiteDimSparseCSR};
+  weight.block_map = {1};
+  weight.block_size = {16};
+  SparseQuantizedFullyConnectedOpModel m(
+      GetRegistration(), /*units=*/2, /*batches=*/1,
+      /*input=*/{TensorType_INT8, {1, 32}, -63.5, 64}, weight, weight_data,
+      /*output=*/{TensorType_INT8, {}, -127, 128});
+  m.SetBias({1, 2});
+
+  m.SetInput({
+      1,  1, 1,  1, 1,  1, 1,  1, 1,  1, 1,  1, 1,  1, 1,  1,  // b = 0
+      -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1,  // b = 0
+  });
+
+  m.Invoke();
+
+  EXPECT_THAT(m.GetOutputShape(), ElementsAre(1, 2));
+  EXPECT_THAT(m.GetDequantizedOutput(),
+              ElementsAreArray(ArrayFloatNear({17, 10})));
+  EXPECT_THAT(m.GetOutput(), ElementsAre(16, 9));
+}
+
 // TODO(b/148391360): Add tests for unsupported sparsity format.
 // TEST_P(SparseFullyConnectedOpTest, TestUnsupportedSparsityFormat)
 
@@ -0,0 +1,235 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/kernels/internal/optimized/avx_tensor_utils_impl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
+#include "tensorflow/lite/kernels/internal/reference/portable_tensor_utils_impl.h"
+#include "tensorflow/lite/kernels/test_util.h"
+
+#ifdef TFLITE_X86_AVX_TENSOR_UTILS
+
+namespace tflite {
+namespace tensor_utils {
+namespace {
+
+using ::testing::ElementsAreArray;
+
+// The kernels may fuse the multiplications and additions of the scaled dot
+// products, so they are compared with a tolerance relative to the results.
+std::vector<::testing::Matcher<float>> ArrayFloatNearResults(
+    const std::vector<float>& values) {
+  float max_abs_value = 0.0f;
+  for (const float value : values) {
+    max_abs_value = std::max(max_abs_value, std::abs(value));
+  }
+  return ArrayFloatNear(values, 1e-6f * max_abs_value + 1e-5f);
+}
+
+// Signature shared by the AVX2 and AVX-512 dense kernels.
+using MatrixBatchVectorMultiplyAccumulateFn = void (*)(
+    const int8_t* matrix, int m_rows, int m_cols, const int8_t* vectors,
+    const float* scaling_factors, int n_batch, float* result,
+    const float* per_channel_scale, const int32_t* input_offset,
+    const int32_t* row_sums);
+
+using SparseMatrixBatchVectorMultiplyAccumulateFn = void (*)(
+    const int8_t* matrix, const uint8_t* ledger, int m_rows, int m_cols,
+    const int8_t* vectors, const float* scaling_factors, int n_batch,
+    float* result);
+
+using ReductionSumVectorFn = void (*)(const int8_t* input_vector,
+                                      int32_t* output_vector, int output_size,
+                                      int reduction_size);
+
+struct AvxKernels {
+  const char* name;
+  bool (*is_supported)();
+  MatrixBatchVectorMultiplyAccumulateFn matrix_batch_vector_multiply_acc;
+  SparseMatrixBatchVectorMultiplyAccumulateFn
+      sparse_matrix_batch_vector_multiply_acc;
+  ReductionSumVectorFn reduction_sum_vector;
+};
+
+class AvxTensorUtilsTest : public ::testing::TestWithParam<AvxKernels> {
+ protected:
+  void SetUp() override {
+    if (!GetParam().is_supported()) {
+      GTEST_SKIP() << GetParam().name << " is not supported by this CPU.";
+    }
+  }
+
+  std::vector<int8_t> RandomInt8(int size) {
+    // Symmetrically quantized values don't include -128.
+    std::uniform_int_distribution<int> distribution(-127, 127);
+    std::vector<int8_t> values(size);
+    for (auto& value : values) value = distribution(random_engine_);
+    return values;
+  }
+
+  std::vector<float> RandomScales(int size) {
+    std::uniform_real_distribution<float> distribution(0.001f, 0.1f);
+    std::vector<float> values(size);
+    for (auto& value : values) value = distribution(random_engine_);
+    return values;
+  }
+
+  std::minstd_rand random_engine_;
+};
+
+// Column counts exercising the full-width loops and all their postambles.
+constexpr int kNumCols[] = {1, 3, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 257};
+
+TEST_P(AvxTensorUtilsTest, MatrixBatchVectorMultiplyAccumulate) {
+  for (const int m_cols : kNumCols) {
+    for (const int m_rows : {1, 3, 4, 9}) {
+      for (const int n_batch : {1, 2, 5}) {
+        SCOPED_TRACE(testing::Message() << m_rows << "x" << m_cols << " * "
+                                        << n_batch);
+        const std::vector<int8_t> matrix = RandomInt8(m_rows * m_cols);
+        const std::vector<int8_t> vectors = RandomInt8(n_batch * m_cols);
+        const std::vector<float> scaling_factors = RandomScales(n_batch);
+        std::vector<float> expected(n_batch * m_rows, 1.0f);
+        std::vector<float> result(expected);
+        PortableMatrixBatchVectorMultiplyAccumulate(
+            matrix.data(), m_rows, m_cols, vectors.data(),
+            scaling_factors.data(), n_batch, expected.data());
+        GetParam().matrix_batch_vector_multiply_acc(
+            matrix.data(), m_rows, m_cols, vectors.data(),
+            scaling_factors.data(), n_batch, result.data(),
+            /*per_channel_scale=*/nullptr, /*input_offset=*/nullptr,
+            /*row_sums=*/nullptr);
+        EXPECT_THAT(result, ElementsAreArray(ArrayFloatNearResults(expected)));
+      }
+    }
+  }
+}
+
+TEST_P(AvxTensorUtilsTest, MatrixBatchVectorMultiplyAccumulateAsymmetric) {
+  for (const int m_cols : kNumCols) {
+    for (const int m_rows : {1, 4, 7}) {
+      const int n_batch = 3;
+      SCOPED_TRACE(testing::Message() << m_rows << "x" << m_cols);
+      const std::vector<int8_t> matrix = RandomInt8(m_rows * m_cols);
+      const std::vector<int8_t> vectors = RandomInt8(n_batch * m_cols);
+      const std::vector<float> scaling_factors = RandomScales(n_batch);
+      const std::vector<float> per_channel_scale = RandomScales(m_rows);
+      const std::vector<int32_t> input_offset = {-3, 0, 17};
+      std::vector<int32_t> row_sums(m_rows);
+      bool compute_row_sums = true;
+      std::vector<float> expected(n_batch * m_rows, 1.0f);
+      std::vector<float> result(expected);
+      PortableMatrixBatchVectorMultiplyAccumulate(
+          matrix.data(), m_rows, m_cols, vectors.data(),
+          scaling_factors.data(), n_batch, expected.data(),
+          per_channel_scale.data(), input_offset.data(), /*scratch=*/nullptr,
+          row_sums.data(), &compute_row_sums, /*context=*/nullptr);
+      GetParam().matrix_batch_vector_multiply_acc(
+          matrix.data(), m_rows, m_cols, vectors.data(),
+          scaling_factors.data(), n_batch, result.data(),
+          per_channel_scale.data(), input_offset.data(), row_sums.data());
+      EXPECT_THAT(result, ElementsAreArray(ArrayFloatNearResults(expected)));
+    }
+  }
+}
+
+TEST_P(AvxTensorUtilsTest, SparseMatrixBatchVectorMultiplyAccumulate) {
+  constexpr int kBlockSize = 16;
+  for (const int num_blocks : {1, 2, 3, 5, 8}) {
+    for (const int n_batch : {1, 4, 5}) {
+      const int m_rows = 6;
+      const int m_cols = num_blocks * kBlockSize;
+      SCOPED_TRACE(testing::Message() << m_rows << "x" << m_cols << " * "
+                                      << n_batch);
+      // Every other block is zero, starting with the first one on odd rows.
+      std::vector<int8_t> dense_matrix(m_rows * m_cols, 0);
+      std::vector<int8_t> sparse_matrix;
+      std::vector<uint8_t> ledger;
+      for (int row = 0; row < m_rows; ++row) {
+        const int num_nonzero_blocks_index = ledger.size();
+        ledger.push_back(0);
+        for (int block = row % 2; block < num_blocks; block += 2) {
+          ++ledger[num_nonzero_blocks_index];
+          ledger.push_back(block);
+          const std::vector<int8_t> values = RandomInt8(kBlockSize);
+          sparse_matrix.insert(sparse_matrix.end(), values.begin(),
+                               values.end());
+          std::copy(values.begin(), values.end(),
+                    dense_matrix.begin() + row * m_cols + block * kBlockSize);
+        }
+      }
+      const std::vector<int8_t> vectors = RandomInt8(n_batch * m_cols);
+      const std::vector<float> scaling_factors = RandomScales(n_batch);
+      std::vector<float> expected(n_batch * m_rows, 1.0f);
+      std::vector<float> result(expected);
+      PortableMatrixBatchVectorMultiplyAccumulate(
+          dense_matrix.data(), m_rows, m_cols, vectors.data(),
+          scaling_factors.data(), n_batch, expected.data());
+      GetParam().sparse_matrix_batch_vector_multiply_acc(
+          sparse_matrix.data(), ledger.data(), m_rows, m_cols, vectors.data(),
+          scaling_factors.data(), n_batch, result.data());
+      EXPECT_THAT(result, ElementsAreArray(ArrayFloatNearResults(expected)));
+    }
+  }
+}
+
+TEST_P(AvxTensorUtilsTest, ReductionSumVector) {
+  for (const int reduction_size : kNumCols) {
+    const int output_size = 3;
+    SCOPED_TRACE(testing::Message() << "reduction_size: " << reduction_size);
+    std::vector<int8_t> input = RandomInt8(output_size * reduction_size);
+    std::vector<int32_t> expected(output_size, 7);
+    std::vector<int32_t> output(expected);
+    PortableReductionSumVector(input.data(), expected.data(), output_size,
+                               reduction_size);
+    GetParam().reduction_sum_vector(input.data(), output.data(), output_size,
+                                    reduction_size);
+    EXPECT_THAT(output, ElementsAreArray(expected));
+  }
+}
+
+TEST_P(AvxTensorUtilsTest, ReductionSumVectorDoesntOverflow) {
+  const int reduction_size = 4096;
+  std::vector<int8_t> input(reduction_size, -128);
+  std::vector<int32_t> output(1, 0);
+  GetParam().reduction_sum_vector(input.data(), output.data(),
+                                  /*output_size=*/1, reduction_size);
+  EXPECT_EQ(output[0], -128 * reduction_size);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    AvxTensorUtilsTest, AvxTensorUtilsTest,
+    ::testing::Values(
+        AvxKernels{"AVX2", DetectX86Avx2,
+                   Avx2MatrixBatchVectorMultiplyAccumulate,
+                   Avx2SparseMatrixBatchVectorMultiplyAccumulate,
+                   Avx2ReductionSumVector},
+        AvxKernels{"AVX-512 VNNI", DetectX86Avx512Vnni,
+                   Avx512VnniMatrixBatchVectorMultiplyAccumulate,
+                   Avx512VnniSparseMatrixBatchVectorMultiplyAccumulate,
+                   Avx512VnniReductionSumVector}));
+
+}  // namespace
+}  // namespace tensor_utils
+}  // namespace tflite
+
+#endif  // TFLITE_X86_AVX_TENSOR_UTILS
@@ -0,0 +1,499 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/kernels/internal/optimized/avx_tensor_utils_impl.h"
+
+#ifdef TFLITE_X86_AVX_TENSOR_UTILS
+
+#include <immintrin.h>
+
+#include <cstdint>
+
+#include "tensorflow/lite/kernels/internal/compatibility.h"
+
+#define TFLITE_AVX2_TARGET __attribute__((target("avx2")))
+#define TFLITE_AVX512_VNNI_TARGET \
+  __attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni")))
+
+namespace tflite {
+namespace tensor_utils {
+namespace {
+
+// Adds the product of row 'row' of the matrix with the current batch's vector,
+// 'dotprod', to 'result', applying the scaling and asymmetric quantization
+// parameters the same way as the SSE and portable implementations do.
+inline void AccumulateRowDotProd(int32_t dotprod, int row,
+                                 float batch_scaling_factor,
+                                 int32_t batch_offset,
+                                 const float* per_channel_scale,
+                                 const int32_t* row_sums,
+                                 float* __restrict__ result) {
+  if (row_sums && batch_offset) {
+    dotprod -= batch_offset * row_sums[row];
+  }
+  const float row_scale =
+      per_channel_scale ? per_channel_scale[row] * batch_scaling_factor
+                        : batch_scaling_factor;
+  result[row] += dotprod * row_scale;
+}
+
+// AVX2
+
+// Dot product of eight int8 vectors of 4 elements packed into a YMM register.
+// Result is eight int32 scalars packed into a YMM register.
+// int8x4x8 · int8x4x8 => int32x8
+TFLITE_AVX2_TARGET inline __m256i DotProdInt8x4x8(__m256i a_8x32,
+                                                  __m256i b_8x32) {
+  // Transfer sign from 'a' to 'b', as _mm256_maddubs_epi16 treats 'a'
+  // unsigned.
+  b_8x32 = _mm256_sign_epi8(b_8x32, a_8x32);
+  a_8x32 = _mm256_abs_epi8(a_8x32);
+  // sumprod[i] = a[2*i]*b[2*i] + a[2*i+1]*b[2*i+1] (i = 0..15)
+  const __m256i sumprod_16x16 = _mm256_maddubs_epi16(a_8x32, b_8x32);
+  // sumprod[i] = sumprod[2*i]*1 + sumprod[2*i+1]*1 (i = 0..7)
+  return _mm256_madd_epi16(sumprod_16x16, _mm256_set1_epi16(1));
+}
+
+// Returns the sum of the 32 int8 values packed into a YMM register, as eight
+// int32 partial sums.
+TFLITE_AVX2_TARGET inline __m256i SumInt8x32(__m256i a_8x32) {
+  const __m256i sum_16x16 = _mm256_maddubs_epi16(_mm256_set1_epi8(1), a_8x32);
+  return _mm256_madd_epi16(sum_16x16, _mm256_set1_epi16(1));
+}
+
+// Loads 16 int8 values into the low half of a YMM register, and zeros into its
+// high half.
+TFLITE_AVX2_TARGET inline __m256i LoadInt8x16ToInt8x32(const int8_t* ptr) {
+  return _mm256_inserti128_si256(
+      _mm256_setzero_si256(),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)), 0);
+}
+
+// Loads two blocks of 16 int8 values into the two halves of a YMM register.
+TFLITE_AVX2_TARGET inline __m256i LoadInt8x16x2(const int8_t* lo,
+                                                const int8_t* hi) {
+  return _mm256_inserti128_si256(
+      _mm256_castsi128_si256(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo))),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi)), 1);
+}
+
+// Horizontally add 8 int32 values stored in a single YMM register to int32_t.
+TFLITE_AVX2_TARGET inline int32_t ReduceInt32x8(__m256i acc) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc),
+                              _mm256_extracti128_si256(acc, 1));
+  sum = _mm_add_epi32(sum, _mm_unpackhi_epi64(sum, sum));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+// Horizontally add each of 4 YMM registers with 8 int32 values, pack result
+// into a single XMM register.
+TFLITE_AVX2_TARGET inline __m128i ReduceInt32x8x4(__m256i a, __m256i b,
+                                                  __m256i c, __m256i d) {
+  // [a01, a23, b01, b23 | a45, a67, b45, b67]
+  const __m256i a_b = _mm256_hadd_epi32(a, b);
+  // [c01, c23, d01, d23 | c45, c67, d45, d67]
+  const __m256i c_d = _mm256_hadd_epi32(c, d);
+  // [a0123, b0123, c0123, d0123 | a4567, b4567, c4567, d4567]
+  const __m256i a_b_c_d = _mm256_hadd_epi32(a_b, c_d);
+  return _mm_add_epi32(_mm256_castsi256_si128(a_b_c_d),
+                       _mm256_extracti128_si256(a_b_c_d, 1));
+}
+
+// AVX-512
+
+// Accumulates into 'acc' the dot product of sixteen int8 vectors of 4 elements
+// packed into a ZMM register. As _mm512_dpbusd_epi32 treats its first operand
+// as unsigned, 'a' is given as its absolute values 'abs_a' and the mask of its
+// negative values 'a_neg', which is moved to 'b'. This lets callers compute
+// them once for several 'b'.
+TFLITE_AVX512_VNNI_TARGET inline __m512i DotProdInt8x4x16(__m512i acc,
+                                                          __m512i abs_a,
+                                                          __mmask64 a_neg,
+                                                          __m512i b) {
+  b = _mm512_mask_sub_epi8(b, a_neg, _mm512_setzero_si512(), b);
+  return _mm512_dpbusd_epi32(acc, abs_a, b);
+}
+
+TFLITE_AVX512_VNNI_TARGET inline __m512i DotProdInt8x4x16(__m512i acc,
+                                                          __m512i a,
+                                                          __m512i b) {
+  return DotProdInt8x4x16(acc, _mm512_abs_epi8(a), _mm512_movepi8_mask(a), b);
+}
+
+// Same as above, for four int8 vectors of 4 elements in XMM registers.
+TFLITE_AVX512_VNNI_TARGET inline __m128i DotProdInt8x4x4(__m128i acc,
+                                                         __m128i a, __m128i b) {
+  b = _mm_sign_epi8(b, a);
+  return _mm_dpbusd_epi32(acc, _mm_abs_epi8(a), b);
+}
+
+// Returns the mask of the first 'size' bytes of a ZMM register, 'size' being
+// at most 64.
+inline __mmask64 FirstBytesMask(int size) {
+  return size >= 64 ? ~static_cast<__mmask64>(0)
+                    : (static_cast<__mmask64>(1) << size) - 1;
+}
+
+TFLITE_AVX512_VNNI_TARGET inline __m512i MaskLoadInt8x64(__mmask64 mask,
+                                                         const int8_t* ptr) {
+  return _mm512_maskz_loadu_epi8(mask, ptr);
+}
+
+// Loads four blocks of 16 int8 values into the four quarters of a ZMM
+// register.
+TFLITE_AVX512_VNNI_TARGET inline __m512i LoadInt8x16x4(const int8_t* b0,
+                                                       const int8_t* b1,
+                                                       const int8_t* b2,
+                                                       const int8_t* b3) {
+  __m512i result = _mm512_castsi128_si512(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(b0)));
+  result = _mm512_inserti32x4(
+      result, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b1)), 1);
+  result = _mm512_inserti32x4(
+      result, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b2)), 2);
+  return _mm512_inserti32x4(
+      result, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b3)), 3);
+}
+
+// Horizontally add 4 int32 values stored in a single XMM register to int32_t.
+TFLITE_AVX512_VNNI_TARGET inline int32_t ReduceInt32x4(__m128i acc) {
+  acc = _mm_add_epi32(acc, _mm_unpackhi_epi64(acc, acc));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(acc);
+}
+
+}  // namespace
+
+TFLITE_AVX2_TARGET void Avx2MatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const int m_rows, const int m_cols,
+    const int8_t* __restrict__ vectors,
+    const float* __restrict__ scaling_factors, int n_batch,
+    float* __restrict__ result, const float* per_channel_scale,
+    const int32_t* input_offset, const int32_t* row_sums) {
+  // Number of rows that share the loads of the vector.
+  static constexpr int kRowBlockSize = 4;
+  const int m_cols_rounddown_32 = m_cols & ~31;
+  const int m_cols_rounddown_16 = m_cols & ~15;
+  for (int batch = 0; batch < n_batch; ++batch) {
+    const float batch_scaling_factor = scaling_factors[batch];
+    const int32_t batch_offset = input_offset ? input_offset[batch] : 0;
+    const int8_t* __restrict__ vector = vectors + batch * m_cols;
+    float* __restrict__ batch_result = result + batch * m_rows;
+    int row = 0;
+    for (; row + kRowBlockSize <= m_rows; row += kRowBlockSize) {
+      const int8_t* __restrict__ row0_ptr = matrix + (row + 0) * m_cols;
+      const int8_t* __restrict__ row1_ptr = matrix + (row + 1) * m_cols;
+      const int8_t* __restrict__ row2_ptr = matrix + (row + 2) * m_cols;
+      const int8_t* __restrict__ row3_ptr = matrix + (row + 3) * m_cols;
+      __m256i dp0_32x8 = _mm256_setzero_si256();
+      __m256i dp1_32x8 = _mm256_setzero_si256();
+      __m256i dp2_32x8 = _mm256_setzero_si256();
+      __m256i dp3_32x8 = _mm256_setzero_si256();
+      int col = 0;
+      for (; col < m_cols_rounddown_32; col += 32) {
+        const __m256i vec_8x32 =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector + col));
+        // dpN += vec · rowN
+        dp0_32x8 = _mm256_add_epi32(
+            dp0_32x8,
+            DotProdInt8x4x8(vec_8x32, _mm256_loadu_si256(
+                                          reinterpret_cast<const __m256i*>(
+                                              row0_ptr + col))));
+        dp1_32x8 = _mm256_add_epi32(
+            dp1_32x8,
+            DotProdInt8x4x8(vec_8x32, _mm256_loadu_si256(
+                                          reinterpret_cast<const __m256i*>(
+                                              row1_ptr + col))));
+        dp2_32x8 = _mm256_add_epi32(
+            dp2_32x8,
+            DotProdInt8x4x8(vec_8x32, _mm256_loadu_si256(
+                                          reinterpret_cast<const __m256i*>(
+                                              row2_ptr + col))));
+        dp3_32x8 = _mm256_add_epi32(
+            dp3_32x8,
+            DotProdInt8x4x8(vec_8x32, _mm256_loadu_si256(
+                                          reinterpret_cast<const __m256i*>(
+                                              row3_ptr + col))));
+      }
+      // Postamble for 16x 8-bit inputs.
+      if (col < m_cols_rounddown_16) {
+        const __m256i vec_8x32 = LoadInt8x16ToInt8x32(vector + col);
+        dp0_32x8 = _mm256_add_epi32(
+            dp0_32x8,
+            DotProdInt8x4x8(vec_8x32, LoadInt8x16ToInt8x32(row0_ptr + col)));
+        dp1_32x8 = _mm256_add_epi32(
+            dp1_32x8,
+            DotProdInt8x4x8(vec_8x32, LoadInt8x16ToInt8x32(row1_ptr + col)));
+        dp2_32x8 = _mm256_add_epi32(
+            dp2_32x8,
+            DotProdInt8x4x8(vec_8x32, LoadInt8x16ToInt8x32(row2_ptr + col)));
+        dp3_32x8 = _mm256_add_epi32(
+            dp3_32x8,
+            DotProdInt8x4x8(vec_8x32, LoadInt8x16ToInt8x32(row3_ptr + col)));
+        col += 16;
+      }
+      int32_t dotprod[kRowBlockSize];
+      _mm_storeu_si128(
+          reinterpret_cast<__m128i*>(dotprod),
+          ReduceInt32x8x4(dp0_32x8, dp1_32x8, dp2_32x8, dp3_32x8));
+      // Postamble loop for <16x remaining 8-bit inputs.
+      for (; col < m_cols; ++col) {
+        dotprod[0] += row0_ptr[col] * vector[col];
+        dotprod[1] += row1_ptr[col] * vector[col];
+        dotprod[2] += row2_ptr[col] * vector[col];
+        dotprod[3] += row3_ptr[col] * vector[col];
+      }
+      for (int i = 0; i < kRowBlockSize; ++i) {
+        AccumulateRowDotProd(dotprod[i], row + i, batch_scaling_factor,
+                             batch_offset, per_channel_scale, row_sums,
+                             batch_result);
+      }
+    }  // for row
+    for (; row < m_rows; ++row) {
+      const int8_t* __restrict__ row_ptr = matrix + row * m_cols;
+      __m256i dp_32x8 = _mm256_setzero_si256();
+      int col = 0;
+      for (; col < m_cols_rounddown_32; col += 32) {
+        const __m256i vec_8x32 =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector + col));
+        const __m256i row_8x32 =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_ptr + col));
+        dp_32x8 =
+            _mm256_add_epi32(dp_32x8, DotProdInt8x4x8(vec_8x32, row_8x32));
+      }
+      if (col < m_cols_rounddown_16) {
+        dp_32x8 = _mm256_add_epi32(
+            dp_32x8, DotProdInt8x4x8(LoadInt8x16ToInt8x32(vector + col),
+                                     LoadInt8x16ToInt8x32(row_ptr + col)));
+        col += 16;
+      }
+      int32_t dotprod = ReduceInt32x8(dp_32x8);
+      for (; col < m_cols; ++col) {
+        dotprod += row_ptr[col] * vector[col];
+      }
+      AccumulateRowDotProd(dotprod, row, batch_scaling_factor, batch_offset,
+                           per_channel_scale, row_sums, batch_result);
+    }  // for row
+  }    // for batch
+}
+
+TFLITE_AVX2_TARGET void Avx2SparseMatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const uint8_t* __restrict__ ledger,
+    const int m_rows, const int m_cols, const int8_t* __restrict__ vectors,
+    const float* __restrict__ scaling_factors, int n_batch,
+    float* __restrict__ results) {
+  static constexpr int kBlockSize = 16;
+  TFLITE_DCHECK_EQ(m_cols % kBlockSize, 0);
+  for (int batch = 0; batch < n_batch; ++batch) {
+    const int8_t* __restrict__ matrix_ptr = matrix;
+    const uint8_t* __restrict__ ledger_ptr = ledger;
+    const int8_t* __restrict__ vector = vectors + batch * m_cols;
+    for (int row = 0; row < m_rows; ++row) {
+      __m256i dp_32x8 = _mm256_setzero_si256();
+      const int num_nonzero_blocks = *ledger_ptr++;
+      int i = 0;
+      // The non-zero blocks of a row are stored contiguously, so two of them
+      // are loaded at once and matched with the corresponding input blocks.
+      for (; i + 2 <= num_nonzero_blocks; i += 2) {
+        const __m256i vec_8x32 =
+            LoadInt8x16x2(vector + ledger_ptr[0] * kBlockSize,
+                          vector + ledger_ptr[1] * kBlockSize);
+        const __m256i row_8x32 =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(matrix_ptr));
+        dp_32x8 =
+            _mm256_add_epi32(dp_32x8, DotProdInt8x4x8(vec_8x32, row_8x32));
+        ledger_ptr += 2;
+        matrix_ptr += 2 * kBlockSize;
+      }
+      if (i < num_nonzero_blocks) {
+        dp_32x8 = _mm256_add_epi32(
+            dp_32x8,
+            DotProdInt8x4x8(
+                LoadInt8x16ToInt8x32(vector + *ledger_ptr++ * kBlockSize),
+                LoadInt8x16ToInt8x32(matrix_ptr)));
+        matrix_ptr += kBlockSize;
+      }
+      results[batch * m_rows + row] +=
+          ReduceInt32x8(dp_32x8) * scaling_factors[batch];
+    }  // for row
+  }    // for batch
+}
+
+TFLITE_AVX2_TARGET void Avx2ReductionSumVector(const int8_t* input_vector,
+                                               int32_t* output_vector,
+                                               const int output_size,
+                                               const int reduction_size) {
+  const int reduction_size_rounddown_32 = reduction_size & ~31;
+  for (int row = 0; row < output_size; ++row) {
+    const int8_t* __restrict__ row_ptr = input_vector + row * reduction_size;
+    // Partial sums are widened to int32 at every step, so that there is no
+    // overflow whatever 'reduction_size'.
+    __m256i row_sum_32x8 = _mm256_setzero_si256();
+    int col = 0;
+    for (; col < reduction_size_rounddown_32; col += 32) {
+      const __m256i row_8x32 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row_ptr + col));
+      row_sum_32x8 = _mm256_add_epi32(row_sum_32x8, SumInt8x32(row_8x32));
+    }
+    if (col < (reduction_size & ~15)) {
+      row_sum_32x8 = _mm256_add_epi32(
+          row_sum_32x8, SumInt8x32(LoadInt8x16ToInt8x32(row_ptr + col)));
+      col += 16;
+    }
+    int32_t row_sum = ReduceInt32x8(row_sum_32x8);
+    for (; col < reduction_size; ++col) {
+      row_sum += row_ptr[col];
+    }
+    output_vector[row] += row_sum;
+  }
+}
+
+TFLITE_AVX512_VNNI_TARGET void Avx512VnniMatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const int m_rows, const int m_cols,
+    const int8_t* __restrict__ vectors,
+    const float* __restrict__ scaling_factors, int n_batch,
+    float* __restrict__ result, const float* per_channel_scale,
+    const int32_t* input_offset, const int32_t* row_sums) {
+  // Number of rows that share the loads of the vector.
+  static constexpr int kRowBlockSize = 4;
+  for (int batch = 0; batch < n_batch; ++batch) {
+    const float batch_scaling_factor = scaling_factors[batch];
+    const int32_t batch_offset = input_offset ? input_offset[batch] : 0;
+    const int8_t* __restrict__ vector = vectors + batch * m_cols;
+    float* __restrict__ batch_result = result + batch * m_rows;
+    int row = 0;
+    for (; row + kRowBlockSize <= m_rows; row += kRowBlockSize) {
+      const int8_t* __restrict__ row0_ptr = matrix + (row + 0) * m_cols;
+      const int8_t* __restrict__ row1_ptr = matrix + (row + 1) * m_cols;
+      const int8_t* __restrict__ row2_ptr = matrix + (row + 2) * m_cols;
+      const int8_t* __restrict__ row3_ptr = matrix + (row + 3) * m_cols;
+      __m512i dp0_32x16 = _mm512_setzero_si512();
+      __m512i dp1_32x16 = _mm512_setzero_si512();
+      __m512i dp2_32x16 = _mm512_setzero_si512();
+      __m512i dp3_32x16 = _mm512_setzero_si512();
+      // The remaining columns are loaded with a mask, which zeros the
+      // elements past the end of the rows without accessing them.
+      for (int col = 0; col < m_cols; col += 64) {
+        const __mmask64 mask = FirstBytesMask(m_cols - col);
+        const __m512i vec_8x64 = MaskLoadInt8x64(mask, vector + col);
+        const __m512i abs_vec_8x64 = _mm512_abs_epi8(vec_8x64);
+        const __mmask64 vec_neg = _mm512_movepi8_mask(vec_8x64);
+        // dpN += vec · rowN
+        dp0_32x16 = DotProdInt8x4x16(dp0_32x16, abs_vec_8x64, vec_neg,
+                                     MaskLoadInt8x64(mask, row0_ptr + col));
+        dp1_32x16 = DotProdInt8x4x16(dp1_32x16, abs_vec_8x64, vec_neg,
+                                     MaskLoadInt8x64(mask, row1_ptr + col));
+        dp2_32x16 = DotProdInt8x4x16(dp2_32x16, abs_vec_8x64, vec_neg,
+                                     MaskLoadInt8x64(mask, row2_ptr + col));
+        dp3_32x16 = DotProdInt8x4x16(dp3_32x16, abs_vec_8x64, vec_neg,
+                                     MaskLoadInt8x64(mask, row3_ptr + col));
+      }
+      AccumulateRowDotProd(_mm512_reduce_add_epi32(dp0_32x16), row + 0,
+                           batch_scaling_factor, batch_offset,
+                           per_channel_scale, row_sums, batch_result);
+      AccumulateRowDotProd(_mm512_reduce_add_epi32(dp1_32x16), row + 1,
+                           batch_scaling_factor, batch_offset,
+                           per_channel_scale, row_sums, batch_result);
+      AccumulateRowDotProd(_mm512_reduce_add_epi32(dp2_32x16), row + 2,
+                           batch_scaling_factor, batch_offset,
+                           per_channel_scale, row_sums, batch_result);
+      AccumulateRowDotProd(_mm512_reduce_add_epi32(dp3_32x16), row + 3,
+                           batch_scaling_factor, batch_offset,
+                           per_channel_scale, row_sums, batch_result);
+    }  // for row
+    for (; row < m_rows; ++row) {
+      const int8_t* __restrict__ row_ptr = matrix + row * m_cols;
+      __m512i dp_32x16 = _mm512_setzero_si512();
+      for (int col = 0; col < m_cols; col += 64) {
+        const __mmask64 mask = FirstBytesMask(m_cols - col);
+        dp_32x16 =
+            DotProdInt8x4x16(dp_32x16, MaskLoadInt8x64(mask, vector + col),
+                             MaskLoadInt8x64(mask, row_ptr + col));
+      }
+      AccumulateRowDotProd(_mm512_reduce_add_epi32(dp_32x16), row,
+                           batch_scaling_factor, batch_offset,
+                           per_channel_scale, row_sums, batch_result);
+    }  // for row
+  }    // for batch
+}
+
+TFLITE_AVX512_VNNI_TARGET void
+Avx512VnniSparseMatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const uint8_t* __restrict__ ledger,
+    const int m_rows, const int m_cols, const int8_t* __restrict__ vectors,
+    const float* __restrict__ scaling_factors, int n_batch,
+    float* __restrict__ results) {
+  static constexpr int kBlockSize = 16;
+  TFLITE_DCHECK_EQ(m_cols % kBlockSize, 0);
+  for (int batch = 0; batch < n_batch; ++batch) {
+    const int8_t* __restrict__ matrix_ptr = matrix;
+    const uint8_t* __restrict__ ledger_ptr = ledger;
+    const int8_t* __restrict__ vector = vectors + batch * m_cols;
+    for (int row = 0; row < m_rows; ++row) {
+      __m512i dp_32x16 = _mm512_setzero_si512();
+      __m128i dp_32x4 = _mm_setzero_si128();
+      const int num_nonzero_blocks = *ledger_ptr++;
+      int i = 0;
+      // The non-zero blocks of a row are stored contiguously, so four of them
+      // are loaded at once and matched with the corresponding input blocks.
+      for (; i + 4 <= num_nonzero_blocks; i += 4) {
+        const __m512i vec_8x64 =
+            LoadInt8x16x4(vector + ledger_ptr[0] * kBlockSize,
+                          vector + ledger_ptr[1] * kBlockSize,
+                          vector + ledger_ptr[2] * kBlockSize,
+                          vector + ledger_ptr[3] * kBlockSize);
+        dp_32x16 = DotProdInt8x4x16(dp_32x16, vec_8x64,
+                                    _mm512_loadu_si512(matrix_ptr));
+        ledger_ptr += 4;
+        matrix_ptr += 4 * kBlockSize;
+      }
+      for (; i < num_nonzero_blocks; ++i) {
+        const int8_t* vector_block_ptr = vector + *ledger_ptr++ * kBlockSize;
+        const __m128i vec_8x16 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(vector_block_ptr));
+        const __m128i row_8x16 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(matrix_ptr));
+        dp_32x4 = DotProdInt8x4x4(dp_32x4, vec_8x16, row_8x16);
+        matrix_ptr += kBlockSize;
+      }
+      const int32_t dotprod =
+          _mm512_reduce_add_epi32(dp_32x16) + ReduceInt32x4(dp_32x4);
+      results[batch * m_rows + row] += dotprod * scaling_factors[batch];
+    }  // for row
+  }    // for batch
+}
+
+TFLITE_AVX512_VNNI_TARGET void Avx512VnniReductionSumVector(
+    const int8_t* input_vector, int32_t* output_vector, const int output_size,
+    const int reduction_size) {
+  const __m512i ones_8x64 = _mm512_set1_epi8(1);
+  for (int row = 0; row < output_size; ++row) {
+    const int8_t* __restrict__ row_ptr = input_vector + row * reduction_size;
+    __m512i row_sum_32x16 = _mm512_setzero_si512();
+    for (int col = 0; col < reduction_size; col += 64) {
+      const __mmask64 mask = FirstBytesMask(reduction_size - col);
+      // row_sum += 1 · row
+      row_sum_32x16 = _mm512_dpbusd_epi32(row_sum_32x16, ones_8x64,
+                                          MaskLoadInt8x64(mask, row_ptr + col));
+    }
+    output_vector[row] += _mm512_reduce_add_epi32(row_sum_32x16);
+  }
+}
+
+}  // namespace tensor_utils
+}  // namespace tflite
+
+#endif  // TFLITE_X86_AVX_TENSOR_UTILS
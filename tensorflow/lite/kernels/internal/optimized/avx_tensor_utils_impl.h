@@ -0,0 +1,80 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_AVX_TENSOR_UTILS_IMPL_H_
+#define TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_AVX_TENSOR_UTILS_IMPL_H_
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#define __restrict__ __restrict
+#endif
+
+// The AVX2 and AVX-512 functions below are compiled with function-level target
+// attributes, so that they can be built into a binary targeting an older x86
+// CPU and only be called after DetectX86Avx2() or DetectX86Avx512Vnni() has
+// told that the CPU running it supports them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TFLITE_X86_AVX_TENSOR_UTILS
+#endif
+
+namespace tflite {
+namespace tensor_utils {
+
+#ifdef TFLITE_X86_AVX_TENSOR_UTILS
+
+// Matrix multiplication for quantized values using symmetric quantization,
+// and asymmetric quantization if 'input_offset' and 'row_sums' are not null.
+// 'per_channel_scale' is optional as well.
+void Avx2MatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const int m_rows, const int m_cols,
+    const int8_t* __restrict__ vectors,
+    const float* __restrict__ scaling_factors, int n_batch,
+    float* __restrict__ result, const float* per_channel_scale,
+    const int32_t* input_offset, const int32_t* row_sums);
+
+void Avx512VnniMatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const int m_rows, const int m_cols,
+    const int8_t* __restrict__ vectors,
+    const float* __restrict__ scaling_factors, int n_batch,
+    float* __restrict__ result, const float* per_channel_scale,
+    const int32_t* input_offset, const int32_t* row_sums);
+
+// Matrix multiplication for quantized values using symmetric quantization.
+// Sparse version.
+void Avx2SparseMatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const uint8_t* __restrict__ ledger,
+    const int m_rows, const int m_cols, const int8_t* __restrict__ vectors,
+    const float* __restrict__ scaling_factors, int n_batch,
+    float* __restrict__ result);
+
+void Avx512VnniSparseMatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const uint8_t* __restrict__ ledger,
+    const int m_rows, const int m_cols, const int8_t* __restrict__ vectors,
+    const float* __restrict__ scaling_factors, int n_batch,
+    float* __restrict__ result);
+
+void Avx2ReductionSumVector(const int8_t* input_vector, int32_t* output_vector,
+                            const int output_size, const int reduction_size);
+
+void Avx512VnniReductionSumVector(const int8_t* input_vector,
+                                  int32_t* output_vector, const int output_size,
+                                  const int reduction_size);
+
+#endif  // TFLITE_X86_AVX_TENSOR_UTILS
+
+}  // namespace tensor_utils
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_KERNELS_INTERNAL_OPTIMIZED_AVX_TENSOR_UTILS_IMPL_H_
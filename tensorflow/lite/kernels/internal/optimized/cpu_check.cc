@@ -19,6 +19,14 @@ limitations under the License.
 #include <sys/auxv.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#define TFLITE_X86_CPUID
+#include <cpuid.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#define TFLITE_X86_CPUID
+#include <intrin.h>
+#endif
+
 namespace tflite {
 
 namespace {
@@ -37,6 +45,52 @@ bool DetectDotprodByLinuxAuxvMethod() {
 }
 #endif
 
+#ifdef TFLITE_X86_CPUID
+// Bits of the registers returned by CPUID leaf 1 and leaf 7, subleaf 0.
+constexpr unsigned int kCpuidLeaf1EcxOsxsave = 1u << 27;
+constexpr unsigned int kCpuidLeaf1EcxAvx = 1u << 28;
+constexpr unsigned int kCpuidLeaf7EbxAvx2 = 1u << 5;
+constexpr unsigned int kCpuidLeaf7EbxAvx512f = 1u << 16;
+constexpr unsigned int kCpuidLeaf7EbxAvx512bw = 1u << 30;
+constexpr unsigned int kCpuidLeaf7EbxAvx512vl = 1u << 31;
+constexpr unsigned int kCpuidLeaf7EcxAvx512vnni = 1u << 11;
+
+// Bits of XCR0 telling that the OS saves the SSE and AVX registers, and the
+// AVX-512 opmask and upper ZMM registers, on context switches.
+constexpr unsigned int kXcr0SseAvxState = 0x6;
+constexpr unsigned int kXcr0Avx512State = 0xe0;
+
+// Returns the EAX, EBX, ECX and EDX registers of the CPUID 'leaf' and
+// 'subleaf' in 'regs', or zeros if the leaf is not supported.
+void Cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4]) {
+  regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#ifdef _MSC_VER
+  int max_leaf_regs[4];
+  __cpuid(max_leaf_regs, 0);
+  if (static_cast<unsigned int>(max_leaf_regs[0]) < leaf) return;
+  __cpuidex(reinterpret_cast<int*>(regs), leaf, subleaf);
+#else
+  if (__get_cpuid_max(0, nullptr) < leaf) return;
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Returns the low 32 bits of XCR0, or zero if the OS doesn't enable XGETBV.
+unsigned int GetXcr0() {
+  unsigned int regs[4];
+  Cpuid(1, 0, regs);
+  const unsigned int kAvxBits = kCpuidLeaf1EcxOsxsave | kCpuidLeaf1EcxAvx;
+  if ((regs[2] & kAvxBits) != kAvxBits) return 0;
+#ifdef _MSC_VER
+  return static_cast<unsigned int>(_xgetbv(0));
+#else
+  unsigned int eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return eax;
+#endif
+}
+#endif  // TFLITE_X86_CPUID
+
 }  // namespace
 
 bool DetectArmNeonDotprod() {
@@ -47,4 +101,30 @@ bool DetectArmNeonDotprod() {
   return false;
 }
 
+bool DetectX86Avx2() {
+#ifdef TFLITE_X86_CPUID
+  if ((GetXcr0() & kXcr0SseAvxState) != kXcr0SseAvxState) return false;
+  unsigned int regs[4];
+  Cpuid(7, 0, regs);
+  return regs[1] & kCpuidLeaf7EbxAvx2;
+#else
+  return false;
+#endif
+}
+
+bool DetectX86Avx512Vnni() {
+#ifdef TFLITE_X86_CPUID
+  const unsigned int kXcr0Bits = kXcr0SseAvxState | kXcr0Avx512State;
+  if ((GetXcr0() & kXcr0Bits) != kXcr0Bits) return false;
+  unsigned int regs[4];
+  Cpuid(7, 0, regs);
+  const unsigned int kEbxBits =
+      kCpuidLeaf7EbxAvx512f | kCpuidLeaf7EbxAvx512bw | kCpuidLeaf7EbxAvx512vl;
+  return (regs[1] & kEbxBits) == kEbxBits &&
+         (regs[2] & kCpuidLeaf7EcxAvx512vnni);
+#else
+  return false;
+#endif
+}
+
 }  // namespace tflite
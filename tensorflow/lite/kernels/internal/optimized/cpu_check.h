@@ -27,6 +27,16 @@ namespace tflite {
 // On other architectures, returns false unconditionally.
 bool DetectArmNeonDotprod();
 
+// On x86, returns true if both the CPU and the OS support AVX2.
+// On other architectures, returns false unconditionally.
+bool DetectX86Avx2();
+
+// On x86, returns true if both the CPU and the OS support the AVX-512
+// Foundation, Byte and Word, Vector Length and Vector Neural Network
+// Instructions extensions.
+// On other architectures, returns false unconditionally.
+bool DetectX86Avx512Vnni();
+
 struct CpuFlags {
   bool neon_dotprod = false;
 };
@@ -1980,6 +1980,127 @@ void NeonSparseMatrixBatchVectorMultiplyAccumulate1x4(
   }
 }
 
+namespace {
+// Applies the input offset, bias and output requantization of the sparse int8
+// fully connected kernels to a single row accumulator.
+inline int8_t RequantizeSparseRow(int32_t dot_prod, int32_t row_sum,
+                                  int32_t bias, int32_t input_offset,
+                                  int32_t output_multiplier,
+                                  int32_t output_shift, int32_t output_offset,
+                                  int32_t output_activation_min,
+                                  int32_t output_activation_max) {
+  int32_t acc = dot_prod + row_sum * input_offset + bias;
+  acc = MultiplyByQuantizedMultiplier(acc, output_multiplier, output_shift);
+  acc += output_offset;
+  acc = std::max(acc, output_activation_min);
+  acc = std::min(acc, output_activation_max);
+  return static_cast<int8_t>(acc);
+}
+
+// Multiplies 16 int8 weights with 16 int8 activations and accumulates the
+// products and the weights into the given int32 accumulators.
+inline void MultiplyAccumulateInt8x16(const int8x16_t matrix_s8x16,
+                                      const int8x16_t vector_s8x16,
+                                      int32x4_t* dotprod_32x4,
+                                      int32x4_t* row_sum_32x4) {
+  int16x8_t prod_16x8 =
+      vmull_s8(vget_low_s8(matrix_s8x16), vget_low_s8(vector_s8x16));
+  prod_16x8 = vmlal_s8(prod_16x8, vget_high_s8(matrix_s8x16),
+                       vget_high_s8(vector_s8x16));
+  *dotprod_32x4 = vpadalq_s16(*dotprod_32x4, prod_16x8);
+  *row_sum_32x4 = vpadalq_s16(*row_sum_32x4, vpaddlq_s8(matrix_s8x16));
+}
+}  // namespace
+
+void NeonSparseMatrixBatchVectorMultiplyAccumulate1x4(
+    const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
+    int n_batch, const int32_t input_offset, const int32_t output_multiplier,
+    const int32_t output_shift, const int32_t output_offset,
+    const int32_t output_activation_min, const int32_t output_activation_max,
+    int8_t* __restrict__ result) {
+  const int kBlockSize = 4;
+  const int kBlocksPerNeonVector = kInt8ValuesPerNeonVector / kBlockSize;
+  TFLITE_DCHECK_EQ(m_cols % kBlockSize, 0);
+
+  for (int batch = 0; batch < n_batch; batch++) {
+    const int8_t* matrix_ptr = matrix;
+    const int8_t* vector_in_batch = vector + batch * m_cols;
+    for (int row = 0; row < m_rows; row++) {
+      int32x4_t dotprod_32x4 = vmovq_n_s32(0);
+      int32x4_t row_sum_32x4 = vmovq_n_s32(0);
+      int i = segments[row];
+      const int segment_end = segments[row + 1];
+      // The non-zero blocks of a row are stored contiguously, so four of them
+      // are loaded at once and matched with a gather of the input blocks.
+      for (; i + kBlocksPerNeonVector <= segment_end;
+           i += kBlocksPerNeonVector) {
+        int32_t vector_blocks[kBlocksPerNeonVector];
+        for (int b = 0; b < kBlocksPerNeonVector; b++) {
+          memcpy(&vector_blocks[b],
+                 vector_in_batch + indices[i + b] * kBlockSize,
+                 sizeof(int32_t));
+        }
+        const int8x16_t vector_s8x16 =
+            vreinterpretq_s8_s32(vld1q_s32(vector_blocks));
+        const int8x16_t matrix_s8x16 = vld1q_s8(matrix_ptr);
+        MultiplyAccumulateInt8x16(matrix_s8x16, vector_s8x16, &dotprod_32x4,
+                                  &row_sum_32x4);
+        matrix_ptr += kInt8ValuesPerNeonVector;
+      }
+      int32_t dot_prod = AccumulateNeonLane(dotprod_32x4);
+      int32_t row_sum = AccumulateNeonLane(row_sum_32x4);
+      for (; i < segment_end; i++) {
+        const int8_t* vector_block_ptr =
+            vector_in_batch + indices[i] * kBlockSize;
+        for (int c = 0; c < kBlockSize; c++) {
+          dot_prod += *matrix_ptr * *vector_block_ptr++;
+          row_sum += *matrix_ptr++;
+        }
+      }
+      result[batch * m_rows + row] = RequantizeSparseRow(
+          dot_prod, row_sum, bias_vector ? bias_vector[row] : 0, input_offset,
+          output_multiplier, output_shift, output_offset,
+          output_activation_min, output_activation_max);
+    }
+  }
+}
+
+void NeonSparseMatrixBatchVectorMultiplyAccumulate1x16(
+    const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
+    int n_batch, const int32_t input_offset, const int32_t output_multiplier,
+    const int32_t output_shift, const int32_t output_offset,
+    const int32_t output_activation_min, const int32_t output_activation_max,
+    int8_t* __restrict__ result) {
+  const int kBlockSize = kInt8ValuesPerNeonVector;
+  TFLITE_DCHECK_EQ(m_cols % kBlockSize, 0);
+
+  for (int batch = 0; batch < n_batch; batch++) {
+    const int8_t* matrix_ptr = matrix;
+    const int8_t* vector_in_batch = vector + batch * m_cols;
+    for (int row = 0; row < m_rows; row++) {
+      int32x4_t dotprod_32x4 = vmovq_n_s32(0);
+      int32x4_t row_sum_32x4 = vmovq_n_s32(0);
+      for (int i = segments[row]; i < segments[row + 1]; i++) {
+        const int8x16_t vector_s8x16 =
+            vld1q_s8(vector_in_batch + indices[i] * kBlockSize);
+        const int8x16_t matrix_s8x16 = vld1q_s8(matrix_ptr);
+        MultiplyAccumulateInt8x16(matrix_s8x16, vector_s8x16, &dotprod_32x4,
+                                  &row_sum_32x4);
+        matrix_ptr += kBlockSize;
+      }
+      result[batch * m_rows + row] = RequantizeSparseRow(
+          AccumulateNeonLane(dotprod_32x4), AccumulateNeonLane(row_sum_32x4),
+          bias_vector ? bias_vector[row] : 0, input_offset, output_multiplier,
+          output_shift, output_offset, output_activation_min,
+          output_activation_max);
+    }
+  }
+}
+
 void NeonSparseMatrixBatchVectorMultiplyAccumulate(
     const float* __restrict__ matrix, const uint8_t* __restrict__ ledger,
     int m_rows, int m_cols, const float* __restrict__ vector, int n_batch,
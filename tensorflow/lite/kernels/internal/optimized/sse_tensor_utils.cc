@@ -22,15 +22,34 @@ limitations under the License.
 #include <smmintrin.h>  // SSE4.1
 #endif
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 
 #include "tensorflow/lite/kernels/cpu_backend_context.h"
+#include "tensorflow/lite/kernels/internal/common.h"
 #include "tensorflow/lite/kernels/internal/compatibility.h"
+#include "tensorflow/lite/kernels/internal/optimized/avx_tensor_utils_impl.h"
+#include "tensorflow/lite/kernels/internal/optimized/cpu_check.h"
 
 namespace tflite {
 namespace tensor_utils {
 namespace {
 
+#ifdef TFLITE_X86_AVX_TENSOR_UTILS
+// The AVX-512 VNNI implementations are preferred over the AVX2 ones, which are
+// preferred over the SSE ones below, when the CPU supports them.
+bool HasAvx2() {
+  static const bool has_avx2 = DetectX86Avx2();
+  return has_avx2;
+}
+
+bool HasAvx512Vnni() {
+  static const bool has_avx512_vnni = DetectX86Avx512Vnni();
+  return has_avx512_vnni;
+}
+#endif
+
 // Dot product of four int8 vectors of 4 elements packed into a XMM register.
 // Result is four int32 scalars packed into a XMM register.
 // int8x4x4 · int8x4x4 => int32x4
@@ -78,6 +97,34 @@ static inline __m128i ReduceInt32x4x4(__m128i a, __m128i b, __m128i c,
   return _mm_add_epi32(all_evns, all_odds);    // [a0123, b0123, c0123, d0123]
 }
 
+// Returns the sum of the 16 int8 values packed into a XMM register, as four
+// int32 partial sums.
+static inline __m128i SumInt8x16(__m128i a_8x16) {
+  const __m128i sum_16x8 = _mm_maddubs_epi16(_mm_set1_epi8(1), a_8x16);
+  return _mm_madd_epi16(sum_16x8, _mm_set1_epi16(1));
+}
+
+// Loads four unaligned int8 values as a single int32.
+static inline int32_t LoadInt8x4(const int8_t* ptr) {
+  int32_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+// Applies the input offset, bias and output requantization of the sparse int8
+// fully connected kernels to a single row accumulator.
+static inline int8_t RequantizeSparseRow(
+    int32_t dot_prod, int32_t row_sum, int32_t bias, int32_t input_offset,
+    int32_t output_multiplier, int32_t output_shift, int32_t output_offset,
+    int32_t output_activation_min, int32_t output_activation_max) {
+  int32_t acc = dot_prod + row_sum * input_offset + bias;
+  acc = MultiplyByQuantizedMultiplier(acc, output_multiplier, output_shift);
+  acc += output_offset;
+  acc = std::max(acc, output_activation_min);
+  acc = std::min(acc, output_activation_max);
+  return static_cast<int8_t>(acc);
+}
+
 // Returns the ith element of a XMM register holding float numbers.
 template <int i>
 float GetFloatVectorElement(__m128 v) {
@@ -96,6 +143,20 @@ void SseMatrixBatchVectorMultiplyAccumulateImpl(
     const float* __restrict__ scaling_factors, int n_batch,
     float* __restrict__ result, const float* per_channel_scale,
     const int32_t* input_offset, const int32_t* row_sums) {
+#ifdef TFLITE_X86_AVX_TENSOR_UTILS
+  if (HasAvx512Vnni()) {
+    Avx512VnniMatrixBatchVectorMultiplyAccumulate(
+        matrix, m_rows, m_cols, vectors, scaling_factors, n_batch, result,
+        per_channel_scale, input_offset, row_sums);
+    return;
+  }
+  if (HasAvx2()) {
+    Avx2MatrixBatchVectorMultiplyAccumulate(
+        matrix, m_rows, m_cols, vectors, scaling_factors, n_batch, result,
+        per_channel_scale, input_offset, row_sums);
+    return;
+  }
+#endif
   for (std::intptr_t batch = 0; batch < n_batch; ++batch) {
     const float batch_scaling_factor = scaling_factors[batch];
     const int32_t batch_offset = input_offset ? input_offset[batch] : 0;
@@ -309,6 +370,21 @@ void SseSparseMatrixBatchVectorMultiplyAccumulate(
     const int m_rows, const int m_cols, const int8_t* __restrict__ vectors,
     const float* __restrict__ scaling_factors, int n_batch,
     float* __restrict__ results) {
+#ifdef TFLITE_X86_AVX_TENSOR_UTILS
+  if (HasAvx512Vnni()) {
+    Avx512VnniSparseMatrixBatchVectorMultiplyAccumulate(
+        matrix, ledger, m_rows, m_cols, vectors, scaling_factors, n_batch,
+        results);
+    return;
+  }
+  if (HasAvx2()) {
+    Avx2SparseMatrixBatchVectorMultiplyAccumulate(matrix, ledger, m_rows,
+                                                  m_cols, vectors,
+                                                  scaling_factors, n_batch,
+                                                  results);
+    return;
+  }
+#endif
   int batch = 0;
   const int kBatchSize4 = 4;
   const int n_batch_rounddown_to_batchsize_4 = n_batch & ~(kBatchSize4 - 1);
@@ -330,8 +406,111 @@ void SseSparseMatrixBatchVectorMultiplyAccumulate(
   }  // for batch
 }
 
+void SseSparseMatrixBatchVectorMultiplyAccumulate1x4(
+    const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
+    int n_batch, const int32_t input_offset, const int32_t output_multiplier,
+    const int32_t output_shift, const int32_t output_offset,
+    const int32_t output_activation_min, const int32_t output_activation_max,
+    int8_t* __restrict__ result) {
+  static const int kBlockSize = 4;
+  // Number of 1x4 blocks that fit into a single XMM register.
+  static const int kBlocksPerRegister = 4;
+  TFLITE_DCHECK_EQ(m_cols % kBlockSize, 0);
+  for (int batch = 0; batch < n_batch; ++batch) {
+    const int8_t* __restrict__ matrix_ptr = matrix;
+    const int8_t* __restrict__ vector_in_batch = vector + batch * m_cols;
+    for (int row = 0; row < m_rows; ++row) {
+      __m128i dotprod_32x4 = _mm_setzero_si128();
+      __m128i row_sum_32x4 = _mm_setzero_si128();
+      int i = segments[row];
+      const int segment_end = segments[row + 1];
+      // The non-zero blocks of a row are stored contiguously, so four of them
+      // are loaded at once and matched with a gather of the input blocks.
+      for (; i + kBlocksPerRegister <= segment_end; i += kBlocksPerRegister) {
+        const __m128i row_8x16 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(matrix_ptr));
+        const __m128i vec_8x16 = _mm_setr_epi32(
+            LoadInt8x4(vector_in_batch + indices[i] * kBlockSize),
+            LoadInt8x4(vector_in_batch + indices[i + 1] * kBlockSize),
+            LoadInt8x4(vector_in_batch + indices[i + 2] * kBlockSize),
+            LoadInt8x4(vector_in_batch + indices[i + 3] * kBlockSize));
+        // The vector goes first: DotProdInt8x4x4 takes the absolute value of
+        // its first argument, which is safe for -128 activations.
+        dotprod_32x4 =
+            _mm_add_epi32(dotprod_32x4, DotProdInt8x4x4(vec_8x16, row_8x16));
+        row_sum_32x4 = _mm_add_epi32(row_sum_32x4, SumInt8x16(row_8x16));
+        matrix_ptr += kBlocksPerRegister * kBlockSize;
+      }
+      int32_t dot_prod = ReduceInt32x4(dotprod_32x4);
+      int32_t row_sum = ReduceInt32x4(row_sum_32x4);
+      for (; i < segment_end; ++i) {
+        const int8_t* vector_block_ptr =
+            vector_in_batch + indices[i] * kBlockSize;
+        for (int c = 0; c < kBlockSize; ++c) {
+          dot_prod += *matrix_ptr * *vector_block_ptr++;
+          row_sum += *matrix_ptr++;
+        }
+      }
+      result[batch * m_rows + row] = RequantizeSparseRow(
+          dot_prod, row_sum, bias_vector ? bias_vector[row] : 0, input_offset,
+          output_multiplier, output_shift, output_offset,
+          output_activation_min, output_activation_max);
+    }  // for row
+  }    // for batch
+}
+
+void SseSparseMatrixBatchVectorMultiplyAccumulate1x16(
+    const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
+    int n_batch, const int32_t input_offset, const int32_t output_multiplier,
+    const int32_t output_shift, const int32_t output_offset,
+    const int32_t output_activation_min, const int32_t output_activation_max,
+    int8_t* __restrict__ result) {
+  static const int kBlockSize = 16;
+  TFLITE_DCHECK_EQ(m_cols % kBlockSize, 0);
+  for (int batch = 0; batch < n_batch; ++batch) {
+    const int8_t* __restrict__ matrix_ptr = matrix;
+    const int8_t* __restrict__ vector_in_batch = vector + batch * m_cols;
+    for (int row = 0; row < m_rows; ++row) {
+      __m128i dotprod_32x4 = _mm_setzero_si128();
+      __m128i row_sum_32x4 = _mm_setzero_si128();
+      for (int i = segments[row]; i < segments[row + 1]; ++i) {
+        const __m128i row_8x16 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(matrix_ptr));
+        const __m128i vec_8x16 =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                vector_in_batch + indices[i] * kBlockSize));
+        dotprod_32x4 =
+            _mm_add_epi32(dotprod_32x4, DotProdInt8x4x4(vec_8x16, row_8x16));
+        row_sum_32x4 = _mm_add_epi32(row_sum_32x4, SumInt8x16(row_8x16));
+        matrix_ptr += kBlockSize;
+      }
+      result[batch * m_rows + row] = RequantizeSparseRow(
+          ReduceInt32x4(dotprod_32x4), ReduceInt32x4(row_sum_32x4),
+          bias_vector ? bias_vector[row] : 0, input_offset, output_multiplier,
+          output_shift, output_offset, output_activation_min,
+          output_activation_max);
+    }  // for row
+  }    // for batch
+}
+
 void SseReductionSumVector(const int8_t* input_vector, int32_t* output_vector,
                            const int output_size, const int reduction_size) {
+#ifdef TFLITE_X86_AVX_TENSOR_UTILS
+  if (HasAvx512Vnni()) {
+    Avx512VnniReductionSumVector(input_vector, output_vector, output_size,
+                                 reduction_size);
+    return;
+  }
+  if (HasAvx2()) {
+    Avx2ReductionSumVector(input_vector, output_vector, output_size,
+                           reduction_size);
+    return;
+  }
+#endif
   static constexpr std::intptr_t kBlockSize = 16;
   for (std::intptr_t row = 0; row < output_size; ++row) {
     const int8_t* __restrict__ row_ptr = input_vector + row * reduction_size;
@@ -199,6 +199,36 @@ void SparseMatrixBatchVectorMultiplyAccumulate(
     const float* __restrict__ scaling_factors, int n_batch,
     float* __restrict__ result);
 
+// Same as the float SparseMatrixBatchVectorMultiplyAccumulate1x4, but for int8
+// weights and int8 activations. The matrix must be symmetrically quantized
+// (zero point 0). For each row the int32 dot product is corrected by
+// input_offset, added to bias_vector (which may be null), requantized with
+// output_multiplier and output_shift, shifted by output_offset and clamped to
+// [output_activation_min, output_activation_max]. Unlike the float version,
+// the int8 result is overwritten rather than accumulated into.
+// This function assumes that m_cols is a multiple of the block size (4 in
+// this case) so that there's no incomplete block.
+void SparseMatrixBatchVectorMultiplyAccumulate1x4(
+    const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
+    int n_batch, const int32_t input_offset, const int32_t output_multiplier,
+    const int32_t output_shift, const int32_t output_offset,
+    const int32_t output_activation_min, const int32_t output_activation_max,
+    int8_t* __restrict__ result);
+
+// Same as the function above, but with block pattern 1x16. The segments and
+// indices arrays follow the same block CSR layout as the 1x4 version.
+// This function assumes that m_cols is a multiple of 16.
+void SparseMatrixBatchVectorMultiplyAccumulate1x16(
+    const int8_t* __restrict__ matrix, const int32_t* __restrict__ segments,
+    const int32_t* __restrict__ indices, int m_rows, int m_cols,
+    const int8_t* __restrict__ vector, const int32_t* __restrict__ bias_vector,
+    int n_batch, const int32_t input_offset, const int32_t output_multiplier,
+    const int32_t output_shift, const int32_t output_offset,
+    const int32_t output_activation_min, const int32_t output_activation_max,
+    int8_t* __restrict__ result);
+
 // Multiplies a matrix by a "batched" vector (i.e. a matrix with a batch
 // dimension composed by input vectors independent from each other). The result
 // of the multiplication is accumulated to the passed result buffer.
@@ -16,6 +16,10 @@ limitations under the License.
 
 #include <math.h>
 
+#include <algorithm>
+#include <random>
+#include <vector>
+
 #include <gmock/gmock.h>
 #include "tensorflow/lite/c/builtin_op_data.h"
 #include "tensorflow/lite/kernels/cpu_backend_context.h"
@@ -1618,6 +1622,105 @@ TEST(uKernels,
 }
 #endif  // __ANDROID__
 
+namespace {
+// Builds a random int8 block sparse matrix in the block CSR layout used by the
+// int8 SparseMatrixBatchVectorMultiplyAccumulate1x4/1x16 kernels, along with
+// its dense equivalent.
+void MakeRandomBlockSparseMatrix(int rows, int cols, int block_size,
+                                 std::vector<int8_t>* dense,
+                                 std::vector<int8_t>* values,
+                                 std::vector<int32_t>* segments,
+                                 std::vector<int32_t>* indices) {
+  std::mt19937 random_engine(rows * cols + block_size);
+  std::uniform_int_distribution<int> value_distribution(-127, 127);
+  std::uniform_int_distribution<int> block_distribution(0, 2);
+  dense->assign(rows * cols, 0);
+  segments->assign(1, 0);
+  for (int row = 0; row < rows; ++row) {
+    for (int block = 0; block < cols / block_size; ++block) {
+      // Roughly one in three blocks is non-zero.
+      if (block_distribution(random_engine) != 0) continue;
+      indices->push_back(block);
+      for (int c = 0; c < block_size; ++c) {
+        const int8_t value = value_distribution(random_engine);
+        (*dense)[row * cols + block * block_size + c] = value;
+        values->push_back(value);
+      }
+    }
+    segments->push_back(indices->size());
+  }
+}
+
+void TestInt8BlockSparseMatrixBatchVectorMultiply(int block_size) {
+  const int kRow = 7;
+  const int kCol = 96;
+  const int kBatch = 3;
+  const int32_t kInputOffset = 3;
+  const int32_t kOutputOffset = -5;
+  const int32_t kActivationMin = -100;
+  const int32_t kActivationMax = 110;
+  int32_t output_multiplier;
+  int output_shift;
+  QuantizeMultiplier(0.0005, &output_multiplier, &output_shift);
+
+  std::vector<int8_t> dense_matrix, matrix_values;
+  std::vector<int32_t> segments, indices;
+  MakeRandomBlockSparseMatrix(kRow, kCol, block_size, &dense_matrix,
+                              &matrix_values, &segments, &indices);
+  std::mt19937 random_engine(42);
+  std::uniform_int_distribution<int> input_distribution(-128, 127);
+  std::vector<int8_t> input(kBatch * kCol);
+  for (int8_t& value : input) {
+    value = input_distribution(random_engine);
+  }
+  std::vector<int32_t> bias(kRow);
+  for (int row = 0; row < kRow; ++row) {
+    bias[row] = 100 * row - 300;
+  }
+
+  // Dense reference computation.
+  std::vector<int8_t> expected(kBatch * kRow);
+  for (int batch = 0; batch < kBatch; ++batch) {
+    for (int row = 0; row < kRow; ++row) {
+      int32_t acc = bias[row];
+      for (int col = 0; col < kCol; ++col) {
+        acc += dense_matrix[row * kCol + col] *
+               (input[batch * kCol + col] + kInputOffset);
+      }
+      acc = MultiplyByQuantizedMultiplier(acc, output_multiplier,
+                                          output_shift) +
+            kOutputOffset;
+      acc = std::min(std::max(acc, kActivationMin), kActivationMax);
+      expected[batch * kRow + row] = static_cast<int8_t>(acc);
+    }
+  }
+
+  std::vector<int8_t> output(kBatch * kRow);
+  if (block_size == 4) {
+    SparseMatrixBatchVectorMultiplyAccumulate1x4(
+        matrix_values.data(), segments.data(), indices.data(), kRow, kCol,
+        input.data(), bias.data(), kBatch, kInputOffset, output_multiplier,
+        output_shift, kOutputOffset, kActivationMin, kActivationMax,
+        output.data());
+  } else {
+    SparseMatrixBatchVectorMultiplyAccumulate1x16(
+        matrix_values.data(), segments.data(), indices.data(), kRow, kCol,
+        input.data(), bias.data(), kBatch, kInputOffset, output_multiplier,
+        output_shift, kOutputOffset, kActivationMin, kActivationMax,
+        output.data());
+  }
+  EXPECT_THAT(output, ElementsAreArray(expected));
+}
+}  // namespace
+
+TEST(uKernels, Int8SparseMatrixBatchVectorMultiply1x4Test) {
+  TestInt8BlockSparseMatrixBatchVectorMultiply(/*block_size=*/4);
+}
+
+TEST(uKernels, Int8SparseMatrixBatchVectorMultiply1x16Test) {
+  TestInt8BlockSparseMatrixBatchVectorMultiply(/*block_size=*/16);
+}
+
 TEST(uKernels, VectorVectorCwiseProductTest) {
   constexpr int kVectorSize = 10;
   static float input1[kVectorSize] = {0.0,  -0.5, 1.0,  -1.5, 2.0,
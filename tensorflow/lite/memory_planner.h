@@ -15,6 +15,8 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MEMORY_PLANNER_H_
 #define TENSORFLOW_LITE_MEMORY_PLANNER_H_
 
+#include <cstddef>
+
 #include "tensorflow/lite/c/common.h"
 
 namespace tflite {
@@ -59,6 +61,11 @@ class MemoryPlanner {
 
   // Returns true if the non-persistent memory is available.
   virtual bool HasNonPersistentMemory() = 0;
+
+  // Returns the number of bytes the current plan needs for non-persistent
+  // tensors (inputs, outputs, intermediates). Only meaningful after
+  // ExecuteAllocations() has been called.
+  virtual size_t GetNonPersistentMemorySize() = 0;
 };
 
 }  // namespace tflite
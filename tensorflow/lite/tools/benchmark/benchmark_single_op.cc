@@ -0,0 +1,278 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/tools/benchmark/benchmark_single_op.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+#include "tensorflow/lite/tools/benchmark/benchmark_utils.h"
+#include "tensorflow/lite/tools/benchmark/single_op_model_builder.h"
+#include "tensorflow/lite/tools/logging.h"
+
+namespace tflite {
+namespace benchmark {
+
+BenchmarkParams BenchmarkSingleOpModel::DefaultParams() {
+  BenchmarkParams default_params = BenchmarkTfLiteModel::DefaultParams();
+  default_params.AddParam("op", BenchmarkParam::Create<std::string>("CONV_2D"));
+  default_params.AddParam("op_dtype",
+                          BenchmarkParam::Create<std::string>("float32"));
+  default_params.AddParam("op_input_shape",
+                          BenchmarkParam::Create<std::string>("1,56,56,64"));
+  return default_params;
+}
+
+BenchmarkSingleOpModel::BenchmarkSingleOpModel(BenchmarkParams params)
+    : BenchmarkTfLiteModel(std::move(params)) {}
+
+std::vector<Flag> BenchmarkSingleOpModel::GetFlags() {
+  std::vector<Flag> flags = BenchmarkTfLiteModel::GetFlags();
+  std::vector<Flag> specific_flags = {
+      CreateFlag<std::string>("op", &params_,
+                              "builtin op to benchmark, e.g. CONV_2D"),
+      CreateFlag<std::string>("op_dtype", &params_,
+                              "type of the op's activations: float32, int8 "
+                              "or uint8"),
+      CreateFlag<std::string>(
+          "op_input_shape", &params_,
+          "comma-separated shape of the op's input, NHWC for spatial ops")};
+  flags.insert(flags.end(), specific_flags.begin(), specific_flags.end());
+  return flags;
+}
+
+void BenchmarkSingleOpModel::LogParams() {
+  BenchmarkTfLiteModel::LogParams();
+  TFLITE_LOG(INFO) << "Op: [" << params_.Get<std::string>("op") << "]";
+  TFLITE_LOG(INFO) << "Op dtype: [" << params_.Get<std::string>("op_dtype")
+                   << "]";
+  TFLITE_LOG(INFO) << "Op input shape: ["
+                   << params_.Get<std::string>("op_input_shape") << "]";
+}
+
+TfLiteStatus BenchmarkSingleOpModel::ValidateParams() {
+  const std::vector<std::string> supported_ops = GetSupportedSingleOps();
+  const std::string op = params_.Get<std::string>("op");
+  if (std::find(supported_ops.begin(), supported_ops.end(), op) ==
+      supported_ops.end()) {
+    TFLITE_LOG(ERROR) << "Benchmarking the " << op << " op is not supported.";
+    return kTfLiteError;
+  }
+  TensorType type;
+  if (!ParseSingleOpTensorType(params_.Get<std::string>("op_dtype"), &type)) {
+    TFLITE_LOG(ERROR) << "Unsupported --op_dtype: "
+                      << params_.Get<std::string>("op_dtype");
+    return kTfLiteError;
+  }
+  std::vector<int32_t> input_shape;
+  if (!util::SplitAndParse(params_.Get<std::string>("op_input_shape"), ',',
+                           &input_shape) ||
+      input_shape.empty()) {
+    TFLITE_LOG(ERROR) << "Cannot parse --op_input_shape: "
+                      << params_.Get<std::string>("op_input_shape");
+    return kTfLiteError;
+  }
+
+  // The model is built here rather than in LoadModel() so that its size is
+  // known before Init(). The interpreter and model of a previous run refer to
+  // 'model_buffer_', so release them before the buffer is overwritten.
+  interpreter_.reset();
+  model_.reset();
+  TF_LITE_ENSURE_STATUS(
+      BuildSingleOpModel(op, type, input_shape, &model_buffer_));
+  return ValidateNonModelParams();
+}
+
+int64_t BenchmarkSingleOpModel::MayGetModelFileSize() {
+  return model_buffer_.size();
+}
+
+TfLiteStatus BenchmarkSingleOpModel::LoadModel() {
+  const std::string op = params_.Get<std::string>("op");
+  model_ = tflite::FlatBufferModel::BuildFromBuffer(model_buffer_.data(),
+                                                    model_buffer_.size());
+  if (!model_) {
+    TFLITE_LOG(ERROR) << "Failed to build the " << op << " model.";
+    return kTfLiteError;
+  }
+  TFLITE_LOG(INFO) << "Built a single " << op << " op model";
+  return kTfLiteOk;
+}
+
+std::string SingleOpStatsRecorder::PerfOptionName(
+    const BenchmarkParams& params) const {
+  std::stringstream sstm;
+  sstm << params.Get<std::string>("op") << " "
+       << params.Get<std::string>("op_dtype") << " ["
+       << params.Get<std::string>("op_input_shape") << "] "
+       << MultiRunStatsRecorder::PerfOptionName(params);
+  return sstm.str();
+}
+
+void SingleOpStatsRecorder::OutputStats() {
+  MultiRunStatsRecorder::OutputStats();
+
+  std::stringstream csv;
+  csv << "op,dtype,input_shape,num_threads,use_xnnpack,completed,count,"
+         "avg_us,std_deviation_us,min_us,max_us\n";
+  for (const auto& run_stats : results_) {
+    const BenchmarkParams& params = *run_stats.params;
+    const auto& inference_time_us = run_stats.metrics.inference_time_us();
+    csv << params.Get<std::string>("op") << ","
+        << params.Get<std::string>("op_dtype") << ",\""
+        << params.Get<std::string>("op_input_shape") << "\","
+        << params.Get<int32_t>("num_threads") << ","
+        << params.Get<bool>("use_xnnpack") << "," << run_stats.completed << ","
+        << inference_time_us.count() << "," << inference_time_us.avg() << ","
+        << inference_time_us.std_deviation() << "," << inference_time_us.min()
+        << "," << inference_time_us.max() << "\n";
+  }
+
+  if (output_csv_file_.empty()) {
+    TFLITE_LOG(INFO) << csv.str();
+    return;
+  }
+  std::ofstream output_file(output_csv_file_);
+  if (!output_file.good()) {
+    TFLITE_LOG(ERROR) << "Failed to open " << output_csv_file_;
+    TFLITE_LOG(INFO) << csv.str();
+    return;
+  }
+  output_file << csv.str();
+}
+
+BenchmarkSingleOpSuite::BenchmarkSingleOpSuite(
+    BenchmarkSingleOpModel* single_op_run)
+    : BenchmarkSingleOpSuite(single_op_run, new SingleOpStatsRecorder()) {}
+
+BenchmarkSingleOpSuite::BenchmarkSingleOpSuite(
+    BenchmarkSingleOpModel* single_op_run,
+    SingleOpStatsRecorder* stats_recorder)
+    : BenchmarkPerformanceOptions(
+          DefaultParams(), single_op_run,
+          std::unique_ptr<MultiRunStatsRecorder>(stats_recorder)),
+      stats_recorder_(stats_recorder) {}
+
+BenchmarkParams BenchmarkSingleOpSuite::DefaultParams() {
+  BenchmarkParams params = BenchmarkPerformanceOptions::DefaultParams();
+  // Keep the runs in a stable order so that results are easy to compare.
+  params.Set<bool>("random_shuffle_benchmark_runs", false);
+  params.AddParam("op_list", BenchmarkParam::Create<std::string>("all"));
+  params.AddParam("op_dtype_list",
+                  BenchmarkParam::Create<std::string>("float32,int8,uint8"));
+  params.AddParam("op_input_shape_list",
+                  BenchmarkParam::Create<std::string>(
+                      "1,16,16,32:1,56,56,64:1,112,112,32"));
+  params.AddParam("op_num_threads_list",
+                  BenchmarkParam::Create<std::string>("1,2,4"));
+  params.AddParam("op_results_csv_file",
+                  BenchmarkParam::Create<std::string>(""));
+  return params;
+}
+
+std::vector<Flag> BenchmarkSingleOpSuite::GetFlags() {
+  std::vector<Flag> flags = BenchmarkPerformanceOptions::GetFlags();
+  std::vector<Flag> specific_flags = {
+      CreateFlag<std::string>(
+          "op_list", &params_,
+          "A comma-separated list of builtin ops to benchmark, or 'all'."),
+      CreateFlag<std::string>(
+          "op_dtype_list", &params_,
+          "A comma-separated list of activation types to benchmark each op "
+          "with, among float32, int8 and uint8."),
+      CreateFlag<std::string>(
+          "op_input_shape_list", &params_,
+          "A colon-separated list of comma-separated input shapes to "
+          "benchmark each op with, e.g. '1,16,16,32:1,56,56,64'."),
+      CreateFlag<std::string>(
+          "op_num_threads_list", &params_,
+          "A comma-separated list of thread counts to benchmark each op with."),
+      CreateFlag<std::string>(
+          "op_results_csv_file", &params_,
+          "File path to export the results of all runs as CSV, if not set "
+          "prints to stdout."),
+  };
+  flags.insert(flags.end(), specific_flags.begin(), specific_flags.end());
+  return flags;
+}
+
+std::vector<std::string> BenchmarkSingleOpSuite::GetValidPerfOptions() const {
+  return {"all", "cpu", "xnnpack", "none"};
+}
+
+void BenchmarkSingleOpSuite::CreatePerformanceOptions() {
+  stats_recorder_->set_output_csv_file(
+      params_.Get<std::string>("op_results_csv_file"));
+  if (HasOption("none")) {
+    BenchmarkPerformanceOptions::CreatePerformanceOptions();
+    return;
+  }
+
+  std::vector<std::string> ops;
+  std::vector<std::string> dtypes;
+  std::vector<std::string> input_shapes;
+  std::vector<int32_t> num_threads;
+  if (params_.Get<std::string>("op_list") == "all") {
+    ops = GetSupportedSingleOps();
+  } else if (!util::SplitAndParse(params_.Get<std::string>("op_list"), ',',
+                                  &ops)) {
+    TFLITE_LOG(ERROR) << "Cannot parse --op_list.";
+    return;
+  }
+  if (!util::SplitAndParse(params_.Get<std::string>("op_dtype_list"), ',',
+                           &dtypes) ||
+      !util::SplitAndParse(params_.Get<std::string>("op_input_shape_list"),
+                           ':', &input_shapes) ||
+      !util::SplitAndParse(params_.Get<std::string>("op_num_threads_list"),
+                           ',', &num_threads)) {
+    TFLITE_LOG(ERROR) << "Cannot parse the op benchmark lists.";
+    return;
+  }
+
+  const bool benchmark_all = HasOption("all");
+  for (const auto& op : ops) {
+    for (const auto& dtype : dtypes) {
+      std::vector<bool> use_xnnpack;
+      if (benchmark_all || HasOption("cpu")) use_xnnpack.push_back(false);
+      // The XNNPACK delegate only handles float ops.
+      if ((benchmark_all || HasOption("xnnpack")) && dtype == "float32") {
+        use_xnnpack.push_back(true);
+      }
+      for (const auto& input_shape : input_shapes) {
+        for (const int32_t count : num_threads) {
+          for (const bool xnnpack : use_xnnpack) {
+            BenchmarkParams params;
+            params.AddParam("op", BenchmarkParam::Create<std::string>(op));
+            params.AddParam("op_dtype",
+                            BenchmarkParam::Create<std::string>(dtype));
+            params.AddParam("op_input_shape",
+                            BenchmarkParam::Create<std::string>(input_shape));
+            params.AddParam("num_threads",
+                            BenchmarkParam::Create<int32_t>(count));
+            params.AddParam("use_xnnpack",
+                            BenchmarkParam::Create<bool>(xnnpack));
+            all_run_params_.emplace_back(std::move(params));
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace benchmark
+}  // namespace tflite
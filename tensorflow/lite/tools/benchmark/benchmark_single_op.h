@@ -0,0 +1,94 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_TOOLS_BENCHMARK_BENCHMARK_SINGLE_OP_H_
+#define TENSORFLOW_LITE_TOOLS_BENCHMARK_BENCHMARK_SINGLE_OP_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/tools/benchmark/benchmark_performance_options.h"
+#include "tensorflow/lite/tools/benchmark/benchmark_tflite_model.h"
+
+namespace tflite {
+namespace benchmark {
+
+// Benchmarks a model made of a single builtin op, which is built in memory
+// from the --op, --op_dtype and --op_input_shape parameters instead of being
+// loaded from --graph.
+class BenchmarkSingleOpModel : public BenchmarkTfLiteModel {
+ public:
+  explicit BenchmarkSingleOpModel(BenchmarkParams params = DefaultParams());
+
+  std::vector<Flag> GetFlags() override;
+  void LogParams() override;
+  TfLiteStatus ValidateParams() override;
+  static BenchmarkParams DefaultParams();
+
+ protected:
+  int64_t MayGetModelFileSize() override;
+  TfLiteStatus LoadModel() override;
+
+ private:
+  // Serialized model that 'model_' is built upon.
+  std::vector<char> model_buffer_;
+};
+
+// Records the results of all single-op runs, and writes them as CSV so that
+// they can be compared across TFLite versions.
+class SingleOpStatsRecorder : public MultiRunStatsRecorder {
+ public:
+  // If empty, the CSV is logged instead of written to a file.
+  void set_output_csv_file(const std::string& output_csv_file) {
+    output_csv_file_ = output_csv_file;
+  }
+
+  void OutputStats() override;
+
+ protected:
+  std::string PerfOptionName(const BenchmarkParams& params) const override;
+
+ private:
+  std::string output_csv_file_;
+};
+
+// Benchmarks every combination of op, data type, input shape, number of
+// threads and use of the XNNPACK delegate given by its parameters, by
+// repeatedly invoking a 'BenchmarkSingleOpModel'.
+class BenchmarkSingleOpSuite : public BenchmarkPerformanceOptions {
+ public:
+  // Doesn't own the memory of 'single_op_run'.
+  explicit BenchmarkSingleOpSuite(BenchmarkSingleOpModel* single_op_run);
+
+ protected:
+  static BenchmarkParams DefaultParams();
+
+  std::vector<Flag> GetFlags() override;
+  std::vector<std::string> GetValidPerfOptions() const override;
+  void CreatePerformanceOptions() override;
+
+ private:
+  BenchmarkSingleOpSuite(BenchmarkSingleOpModel* single_op_run,
+                         SingleOpStatsRecorder* stats_recorder);
+
+  // Owned by the base class.
+  SingleOpStatsRecorder* const stats_recorder_;
+};
+
+}  // namespace benchmark
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_TOOLS_BENCHMARK_BENCHMARK_SINGLE_OP_H_
@@ -28,7 +28,9 @@ limitations under the License.
 #include "tensorflow/lite/string_util.h"
 #include "tensorflow/lite/testing/util.h"
 #include "tensorflow/lite/tools/benchmark/benchmark_performance_options.h"
+#include "tensorflow/lite/tools/benchmark/benchmark_single_op.h"
 #include "tensorflow/lite/tools/benchmark/benchmark_tflite_model.h"
+#include "tensorflow/lite/tools/benchmark/single_op_model_builder.h"
 #include "tensorflow/lite/tools/command_line_flags.h"
 #include "tensorflow/lite/tools/delegates/delegate_provider.h"
 #include "tensorflow/lite/tools/logging.h"
@@ -88,6 +90,9 @@ BenchmarkParams CreateParams(int32_t num_runs, float min_secs, float max_secs,
                   BenchmarkParam::Create<std::string>(""));
   params.AddParam("enable_platform_tracing",
                   BenchmarkParam::Create<bool>(false));
+  params.AddParam("arena_planning_strategy",
+                  BenchmarkParam::Create<std::string>("greedy_by_size"));
+  params.AddParam("report_arena_sizes", BenchmarkParam::Create<bool>(false));
 
   for (const auto& delegate_provider :
        tools::GetRegisteredDelegateProviders()) {
@@ -450,6 +455,57 @@ TEST(BenchmarkTest, ParametersArePopulatedWhenInputShapeIsNotSpecified) {
                            input_tensor->data.raw + input_tensor->bytes));
 }
 
+BenchmarkParams CreateSingleOpParams(const std::string& op,
+                                     const std::string& dtype) {
+  BenchmarkParams params = BenchmarkSingleOpModel::DefaultParams();
+  params.Set<int32_t>("num_runs", 2);
+  params.Set<float>("min_secs", 1.0f);
+  params.Set<float>("max_secs", 150.0f);
+  params.Set<int32_t>("warmup_runs", 1);
+  params.Set<std::string>("op", op);
+  params.Set<std::string>("op_dtype", dtype);
+  params.Set<std::string>("op_input_shape", "1,8,8,16");
+  return params;
+}
+
+TEST(BenchmarkTest, DoesntCrashSingleOpModels) {
+  for (const auto& op : GetSupportedSingleOps()) {
+    for (const std::string dtype : {"float32", "int8", "uint8"}) {
+      SCOPED_TRACE(op + " " + dtype);
+      BenchmarkSingleOpModel benchmark(CreateSingleOpParams(op, dtype));
+      EXPECT_EQ(kTfLiteOk, benchmark.Run());
+    }
+  }
+}
+
+TEST(BenchmarkTest, RunSingleOpWithUnsupportedOp) {
+  BenchmarkSingleOpModel benchmark(CreateSingleOpParams("WHILE", "float32"));
+  EXPECT_EQ(kTfLiteError, benchmark.Run());
+}
+
+TEST(BenchmarkTest, SingleOpSuiteWritesCsvResults) {
+  const std::string csv_file = CreateFilePath("single_op_results.csv");
+  BenchmarkSingleOpModel benchmark(CreateSingleOpParams("ADD", "float32"));
+  BenchmarkSingleOpSuite suite(&benchmark);
+  ScopedCommandlineArgs scoped_argv(
+      {"--op_list=ADD,CONV_2D", "--op_dtype_list=float32,int8",
+       "--op_input_shape_list=1,8,8,16:1,4,4,8", "--op_num_threads_list=1",
+       "--perf_options_list=cpu", "--option_benchmark_run_delay=0",
+       "--op_results_csv_file=" + csv_file});
+  suite.Run(scoped_argv.argc(), scoped_argv.argv());
+
+  std::ifstream csv(csv_file);
+  ASSERT_TRUE(csv.good());
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(csv, line);) lines.push_back(line);
+  // A header, then one line per op, dtype and input shape.
+  ASSERT_EQ(9, lines.size());
+  EXPECT_EQ(0, lines[0].find("op,dtype,input_shape,num_threads,use_xnnpack"));
+  for (int i = 1; i < lines.size(); ++i) {
+    EXPECT_THAT(lines[i], testing::HasSubstr(",1,0,1,"));
+  }
+}
+
 }  // namespace
 }  // namespace benchmark
 }  // namespace tflite
@@ -246,6 +246,28 @@ CreateProfileSummaryFormatter(bool format_as_csv) {
              : std::make_shared<profiling::ProfileSummaryDefaultFormatter>();
 }
 
+struct ArenaPlanningStrategyName {
+  ArenaPlanningStrategy strategy;
+  const char* name;
+};
+
+constexpr ArenaPlanningStrategyName kArenaPlanningStrategyNames[] = {
+    {ArenaPlanningStrategy::kGreedyBySize, "greedy_by_size"},
+    {ArenaPlanningStrategy::kGreedyByBreadth, "greedy_by_breadth"},
+    {ArenaPlanningStrategy::kExecutionOrder, "execution_order"},
+};
+
+bool ParseArenaPlanningStrategy(const std::string& name,
+                                ArenaPlanningStrategy* strategy) {
+  for (const auto& entry : kArenaPlanningStrategyNames) {
+    if (name == entry.name) {
+      *strategy = entry.strategy;
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 BenchmarkParams BenchmarkTfLiteModel::DefaultParams() {
@@ -273,6 +295,11 @@ BenchmarkParams BenchmarkTfLiteModel::DefaultParams() {
                           BenchmarkParam::Create<std::string>(""));
   default_params.AddParam("enable_platform_tracing",
                           BenchmarkParam::Create<bool>(false));
+  default_params.AddParam(
+      "arena_planning_strategy",
+      BenchmarkParam::Create<std::string>("greedy_by_size"));
+  default_params.AddParam("report_arena_sizes",
+                          BenchmarkParam::Create<bool>(false));
 
   for (const auto& delegate_provider :
        tools::GetRegisteredDelegateProviders()) {
@@ -331,7 +358,14 @@ std::vector<Flag> BenchmarkTfLiteModel::GetFlags() {
           "prints to stdout."),
       CreateFlag<bool>("enable_platform_tracing", &params_,
                        "enable platform-wide tracing, only meaningful when "
-                       "--enable_op_profiling is set to true.")};
+                       "--enable_op_profiling is set to true."),
+      CreateFlag<std::string>(
+          "arena_planning_strategy", &params_,
+          "order in which tensors are assigned their offsets in the memory "
+          "arena: greedy_by_size, greedy_by_breadth or execution_order"),
+      CreateFlag<bool>("report_arena_sizes", &params_,
+                       "report the arena size planned by every arena "
+                       "planning strategy")};
 
   flags.insert(flags.end(), specific_flags.begin(), specific_flags.end());
 
@@ -375,6 +409,11 @@ void BenchmarkTfLiteModel::LogParams() {
                    << "]";
   TFLITE_LOG(INFO) << "Enable platform-wide tracing: ["
                    << params_.Get<bool>("enable_platform_tracing") << "]";
+  TFLITE_LOG(INFO) << "Arena planning strategy: ["
+                   << params_.Get<std::string>("arena_planning_strategy")
+                   << "]";
+  TFLITE_LOG(INFO) << "Report arena sizes: ["
+                   << params_.Get<bool>("report_arena_sizes") << "]";
 
   for (const auto& delegate_provider :
        tools::GetRegisteredDelegateProviders()) {
@@ -388,6 +427,17 @@ TfLiteStatus BenchmarkTfLiteModel::ValidateParams() {
         << "Please specify the name of your TF Lite input file with --graph";
     return kTfLiteError;
   }
+  return ValidateNonModelParams();
+}
+
+TfLiteStatus BenchmarkTfLiteModel::ValidateNonModelParams() {
+  ArenaPlanningStrategy strategy;
+  if (!ParseArenaPlanningStrategy(
+          params_.Get<std::string>("arena_planning_strategy"), &strategy)) {
+    TFLITE_LOG(ERROR) << "Unknown arena planning strategy: "
+                      << params_.Get<std::string>("arena_planning_strategy");
+    return kTfLiteError;
+  }
 
   return PopulateInputLayerInfo(
       params_.Get<std::string>("input_layer"),
@@ -703,6 +753,25 @@ TfLiteStatus BenchmarkTfLiteModel::Init() {
     }
   }
 
+  ArenaPlanningStrategy strategy = ArenaPlanningStrategy::kGreedyBySize;
+  ParseArenaPlanningStrategy(
+      params_.Get<std::string>("arena_planning_strategy"), &strategy);
+
+  if (params_.Get<bool>("report_arena_sizes")) {
+    for (const auto& entry : kArenaPlanningStrategyNames) {
+      interpreter_->SetArenaPlanningStrategy(entry.strategy);
+      if (interpreter_->AllocateTensors() != kTfLiteOk) {
+        TFLITE_LOG(ERROR) << "Failed to allocate tensors with the "
+                          << entry.name << " arena planning strategy!";
+        return kTfLiteError;
+      }
+      TFLITE_LOG(INFO) << "Arena size with " << entry.name << " strategy: "
+                       << interpreter_->GetNonPersistentArenaSize() / 1024.0
+                       << " KB";
+    }
+  }
+
+  interpreter_->SetArenaPlanningStrategy(strategy);
   if (interpreter_->AllocateTensors() != kTfLiteOk) {
     TFLITE_LOG(ERROR) << "Failed to allocate tensors!";
     return kTfLiteError;
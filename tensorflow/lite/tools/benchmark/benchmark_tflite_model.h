@@ -69,6 +69,10 @@ class BenchmarkTfLiteModel : public BenchmarkModel {
 
   int64_t MayGetModelFileSize() override;
 
+  // Validates all parameters but the ones identifying the model, i.e. 'graph',
+  // for subclasses that get their model from elsewhere.
+  TfLiteStatus ValidateNonModelParams();
+
   virtual TfLiteStatus LoadModel();
 
   // Allow subclasses to create a customized Op resolver during init.
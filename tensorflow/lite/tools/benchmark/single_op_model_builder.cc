@@ -0,0 +1,382 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/lite/tools/benchmark/single_op_model_builder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "flatbuffers/flatbuffers.h"  // from @flatbuffers
+#include "tensorflow/lite/tools/logging.h"
+#include "tensorflow/lite/version.h"
+
+namespace tflite {
+namespace benchmark {
+namespace {
+
+// Seed for the constant operands, so that every build of a given model
+// produces the same weights.
+constexpr uint32_t kConstantDataSeed = 42;
+
+// Quantization parameters of a tensor. Ignored for float models.
+struct QuantParams {
+  float scale;
+  int64_t zero_point;
+};
+
+// Builds the tensors, buffers and the single operator of a model whose
+// activations are of a given type.
+class SingleOpModelBuilder {
+ public:
+  explicit SingleOpModelBuilder(TensorType type)
+      : type_(type), rng_(kConstantDataSeed) {
+    // Buffer 0 is the empty buffer of all non-constant tensors.
+    buffers_.push_back(CreateBuffer(builder_, builder_.CreateVector({})));
+  }
+
+  flatbuffers::FlatBufferBuilder* builder() { return &builder_; }
+
+  // Default quantization of activations.
+  QuantParams ActivationParams() const {
+    return {0.05f, type_ == TensorType_UINT8 ? 128 : 0};
+  }
+
+  // Quantization of outputs in [0, 1), as required by LOGISTIC and SOFTMAX.
+  QuantParams UnitIntervalParams() const {
+    return {1.0f / 256, type_ == TensorType_UINT8 ? 0 : -128};
+  }
+
+  // Quantization of outputs in [-1, 1), as used by TANH.
+  QuantParams SymmetricUnitParams() const {
+    return {1.0f / 128, type_ == TensorType_UINT8 ? 128 : 0};
+  }
+
+  // Quantization of constant filters.
+  QuantParams FilterParams() const {
+    return {0.01f, type_ == TensorType_UINT8 ? 128 : 0};
+  }
+
+  // Adds a non-constant tensor of the model's type.
+  int AddActivation(const std::vector<int32_t>& shape,
+                    const QuantParams& params) {
+    return AddTensor(shape, type_, /*buffer=*/0, params);
+  }
+
+  // Adds a constant tensor of the model's type filled with random values.
+  int AddFilter(const std::vector<int32_t>& shape) {
+    const int num_elements = NumElements(shape);
+    std::vector<uint8_t> data;
+    if (type_ == TensorType_FLOAT32) {
+      std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+      std::vector<float> values(num_elements);
+      for (float& value : values) value = distribution(rng_);
+      data = ToBytes(values);
+    } else {
+      // std::uniform_int_distribution is specified not to support char types.
+      std::uniform_int_distribution<int32_t> distribution(0, 254);
+      const int32_t offset = type_ == TensorType_INT8 ? -127 : 0;
+      data.resize(num_elements);
+      for (uint8_t& value : data) {
+        value = static_cast<uint8_t>(distribution(rng_) + offset);
+      }
+    }
+    return AddTensor(shape, type_, AddBuffer(data), FilterParams());
+  }
+
+  // Adds a constant bias vector, which is int32 for quantized models.
+  int AddBias(int size, float input_scale) {
+    if (type_ == TensorType_FLOAT32) {
+      std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+      std::vector<float> values(size);
+      for (float& value : values) value = distribution(rng_);
+      return AddTensor({size}, TensorType_FLOAT32, AddBuffer(ToBytes(values)),
+                       {});
+    }
+    std::uniform_int_distribution<int32_t> distribution(-1000, 1000);
+    std::vector<int32_t> values(size);
+    for (int32_t& value : values) value = distribution(rng_);
+    return AddTensor({size}, TensorType_INT32, AddBuffer(ToBytes(values)),
+                     {input_scale * FilterParams().scale, 0});
+  }
+
+  // Adds a constant int32 tensor with the given values.
+  int AddInt32Constant(const std::vector<int32_t>& shape,
+                       const std::vector<int32_t>& values) {
+    return AddTensor(shape, TensorType_INT32, AddBuffer(ToBytes(values)), {});
+  }
+
+  // Adds the single operator of the model and serializes the model into
+  // 'model_buffer'. All non-constant inputs of the operator become inputs of
+  // the model.
+  void Finish(BuiltinOperator op, BuiltinOptions options_type,
+              flatbuffers::Offset<void> options,
+              const std::vector<int32_t>& op_inputs,
+              const std::vector<int32_t>& graph_inputs, int32_t op_output,
+              std::vector<char>* model_buffer) {
+    const std::vector<int32_t> op_outputs = {op_output};
+    const flatbuffers::Offset<OperatorCode> operator_code =
+        CreateOperatorCode(builder_, op);
+    const flatbuffers::Offset<Operator> op_offset = CreateOperator(
+        builder_, /*opcode_index=*/0, builder_.CreateVector(op_inputs),
+        builder_.CreateVector(op_outputs), options_type, options);
+    const flatbuffers::Offset<SubGraph> subgraph = CreateSubGraph(
+        builder_, builder_.CreateVector(tensors_),
+        builder_.CreateVector(graph_inputs), builder_.CreateVector(op_outputs),
+        builder_.CreateVector(&op_offset, 1));
+    const flatbuffers::Offset<Model> model = CreateModel(
+        builder_, TFLITE_SCHEMA_VERSION,
+        builder_.CreateVector(&operator_code, 1),
+        builder_.CreateVector(&subgraph, 1),
+        builder_.CreateString(std::string(EnumNameBuiltinOperator(op)) +
+                              " benchmark model"),
+        builder_.CreateVector(buffers_));
+    builder_.Finish(model);
+    model_buffer->assign(builder_.GetBufferPointer(),
+                         builder_.GetBufferPointer() + builder_.GetSize());
+  }
+
+ private:
+  static int NumElements(const std::vector<int32_t>& shape) {
+    int num_elements = 1;
+    for (int32_t dim : shape) num_elements *= dim;
+    return num_elements;
+  }
+
+  template <typename T>
+  static std::vector<uint8_t> ToBytes(const std::vector<T>& values) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(values.data());
+    return std::vector<uint8_t>(data, data + values.size() * sizeof(T));
+  }
+
+  int AddBuffer(const std::vector<uint8_t>& data) {
+    buffers_.push_back(CreateBuffer(builder_, builder_.CreateVector(data)));
+    return buffers_.size() - 1;
+  }
+
+  int AddTensor(const std::vector<int32_t>& shape, TensorType type,
+                int buffer, const QuantParams& params) {
+    flatbuffers::Offset<QuantizationParameters> quantization = 0;
+    if (type != TensorType_FLOAT32 && params.scale != 0) {
+      quantization = CreateQuantizationParameters(
+          builder_, /*min=*/0, /*max=*/0,
+          builder_.CreateVector<float>({params.scale}),
+          builder_.CreateVector<int64_t>({params.zero_point}));
+    }
+    tensors_.push_back(CreateTensor(builder_, builder_.CreateVector(shape),
+                                    type, buffer, /*name=*/0, quantization));
+    return tensors_.size() - 1;
+  }
+
+  const TensorType type_;
+  std::mt19937 rng_;
+  flatbuffers::FlatBufferBuilder builder_;
+  std::vector<flatbuffers::Offset<Buffer>> buffers_;
+  std::vector<flatbuffers::Offset<Tensor>> tensors_;
+};
+
+const char* const kSupportedSingleOps[] = {
+    "ADD",           "SUB",
+    "MUL",           "RELU",
+    "RELU6",         "LOGISTIC",
+    "TANH",          "HARD_SWISH",
+    "SOFTMAX",       "MEAN",
+    "CONCATENATION", "AVERAGE_POOL_2D",
+    "MAX_POOL_2D",   "CONV_2D",
+    "DEPTHWISE_CONV_2D", "FULLY_CONNECTED",
+};
+
+}  // namespace
+
+std::vector<std::string> GetSupportedSingleOps() {
+  return std::vector<std::string>(std::begin(kSupportedSingleOps),
+                                  std::end(kSupportedSingleOps));
+}
+
+bool ParseSingleOpTensorType(const std::string& name, TensorType* type) {
+  if (name == "float32") {
+    *type = TensorType_FLOAT32;
+  } else if (name == "int8") {
+    *type = TensorType_INT8;
+  } else if (name == "uint8") {
+    *type = TensorType_UINT8;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+TfLiteStatus BuildSingleOpModel(const std::string& op, TensorType type,
+                                const std::vector<int32_t>& input_shape,
+                                std::vector<char>* model_buffer) {
+  if (input_shape.empty() ||
+      std::any_of(input_shape.begin(), input_shape.end(),
+                  [](int32_t dim) { return dim <= 0; })) {
+    TFLITE_LOG(ERROR) << "Invalid input shape for the " << op << " model.";
+    return kTfLiteError;
+  }
+  const bool is_4d = input_shape.size() == 4;
+  const int32_t depth = input_shape.back();
+
+  SingleOpModelBuilder model(type);
+  flatbuffers::FlatBufferBuilder* fbb = model.builder();
+  const QuantParams input_params = model.ActivationParams();
+  const int input = model.AddActivation(input_shape, input_params);
+
+  if (op == "ADD" || op == "SUB" || op == "MUL") {
+    const int input2 = model.AddActivation(input_shape, input_params);
+    const int output = model.AddActivation(input_shape, input_params);
+    if (op == "ADD") {
+      model.Finish(BuiltinOperator_ADD, BuiltinOptions_AddOptions,
+                   CreateAddOptions(*fbb).Union(), {input, input2},
+                   {input, input2}, output, model_buffer);
+    } else if (op == "SUB") {
+      model.Finish(BuiltinOperator_SUB, BuiltinOptions_SubOptions,
+                   CreateSubOptions(*fbb).Union(), {input, input2},
+                   {input, input2}, output, model_buffer);
+    } else {
+      model.Finish(BuiltinOperator_MUL, BuiltinOptions_MulOptions,
+                   CreateMulOptions(*fbb).Union(), {input, input2},
+                   {input, input2}, output, model_buffer);
+    }
+    return kTfLiteOk;
+  }
+
+  if (op == "RELU" || op == "RELU6" || op == "HARD_SWISH") {
+    const int output = model.AddActivation(input_shape, input_params);
+    const BuiltinOperator builtin =
+        op == "RELU" ? BuiltinOperator_RELU
+                     : op == "RELU6" ? BuiltinOperator_RELU6
+                                     : BuiltinOperator_HARD_SWISH;
+    model.Finish(builtin, BuiltinOptions_NONE, 0, {input}, {input}, output,
+                 model_buffer);
+    return kTfLiteOk;
+  }
+
+  if (op == "LOGISTIC" || op == "TANH") {
+    const bool is_logistic = op == "LOGISTIC";
+    const int output = model.AddActivation(
+        input_shape, is_logistic ? model.UnitIntervalParams()
+                                 : model.SymmetricUnitParams());
+    model.Finish(is_logistic ? BuiltinOperator_LOGISTIC : BuiltinOperator_TANH,
+                 BuiltinOptions_NONE, 0, {input}, {input}, output,
+                 model_buffer);
+    return kTfLiteOk;
+  }
+
+  if (op == "SOFTMAX") {
+    const int output =
+        model.AddActivation(input_shape, model.UnitIntervalParams());
+    model.Finish(BuiltinOperator_SOFTMAX, BuiltinOptions_SoftmaxOptions,
+                 CreateSoftmaxOptions(*fbb, /*beta=*/1.0f).Union(), {input},
+                 {input}, output, model_buffer);
+    return kTfLiteOk;
+  }
+
+  if (op == "CONCATENATION") {
+    const int input2 = model.AddActivation(input_shape, input_params);
+    std::vector<int32_t> output_shape = input_shape;
+    output_shape.back() *= 2;
+    const int output = model.AddActivation(output_shape, input_params);
+    const int32_t axis = static_cast<int32_t>(input_shape.size()) - 1;
+    model.Finish(BuiltinOperator_CONCATENATION,
+                 BuiltinOptions_ConcatenationOptions,
+                 CreateConcatenationOptions(*fbb, axis).Union(),
+                 {input, input2}, {input, input2}, output, model_buffer);
+    return kTfLiteOk;
+  }
+
+  if (op == "FULLY_CONNECTED") {
+    const int filter = model.AddFilter({depth, depth});
+    const int bias = model.AddBias(depth, input_params.scale);
+    const int32_t batches =
+        std::accumulate(input_shape.begin(), input_shape.end() - 1, 1,
+                        std::multiplies<int32_t>());
+    const int output = model.AddActivation({batches, depth}, input_params);
+    model.Finish(BuiltinOperator_FULLY_CONNECTED,
+                 BuiltinOptions_FullyConnectedOptions,
+                 CreateFullyConnectedOptions(*fbb).Union(),
+                 {input, filter, bias}, {input}, output, model_buffer);
+    return kTfLiteOk;
+  }
+
+  if (!is_4d) {
+    TFLITE_LOG(ERROR) << "The " << op << " model needs a 4D NHWC input shape.";
+    return kTfLiteError;
+  }
+  const int32_t batches = input_shape[0];
+  const int32_t height = input_shape[1];
+  const int32_t width = input_shape[2];
+
+  if (op == "MEAN") {
+    const int axis = model.AddInt32Constant({2}, {1, 2});
+    const int output =
+        model.AddActivation({batches, 1, 1, depth}, input_params);
+    model.Finish(BuiltinOperator_MEAN, BuiltinOptions_ReducerOptions,
+                 CreateReducerOptions(*fbb, /*keep_dims=*/true).Union(),
+                 {input, axis}, {input}, output, model_buffer);
+    return kTfLiteOk;
+  }
+
+  if (op == "AVERAGE_POOL_2D" || op == "MAX_POOL_2D") {
+    const int output = model.AddActivation(
+        {batches, (height + 1) / 2, (width + 1) / 2, depth}, input_params);
+    model.Finish(op == "AVERAGE_POOL_2D" ? BuiltinOperator_AVERAGE_POOL_2D
+                                         : BuiltinOperator_MAX_POOL_2D,
+                 BuiltinOptions_Pool2DOptions,
+                 CreatePool2DOptions(*fbb, Padding_SAME, /*stride_w=*/2,
+                                     /*stride_h=*/2, /*filter_width=*/2,
+                                     /*filter_height=*/2)
+                     .Union(),
+                 {input}, {input}, output, model_buffer);
+    return kTfLiteOk;
+  }
+
+  if (op == "CONV_2D" || op == "DEPTHWISE_CONV_2D") {
+    const bool is_depthwise = op == "DEPTHWISE_CONV_2D";
+    const int filter = is_depthwise ? model.AddFilter({1, 3, 3, depth})
+                                    : model.AddFilter({depth, 3, 3, depth});
+    const int bias = model.AddBias(depth, input_params.scale);
+    const int output = model.AddActivation(input_shape, input_params);
+    if (is_depthwise) {
+      model.Finish(BuiltinOperator_DEPTHWISE_CONV_2D,
+                   BuiltinOptions_DepthwiseConv2DOptions,
+                   CreateDepthwiseConv2DOptions(*fbb, Padding_SAME,
+                                                /*stride_w=*/1, /*stride_h=*/1,
+                                                /*depth_multiplier=*/1)
+                       .Union(),
+                   {input, filter, bias}, {input}, output, model_buffer);
+    } else {
+      model.Finish(BuiltinOperator_CONV_2D, BuiltinOptions_Conv2DOptions,
+                   CreateConv2DOptions(*fbb, Padding_SAME, /*stride_w=*/1,
+                                       /*stride_h=*/1)
+                       .Union(),
+                   {input, filter, bias}, {input}, output, model_buffer);
+    }
+    return kTfLiteOk;
+  }
+
+  TFLITE_LOG(ERROR) << "Building a benchmark model for " << op
+                    << " is not supported.";
+  return kTfLiteError;
+}
+
+}  // namespace benchmark
+}  // namespace tflite
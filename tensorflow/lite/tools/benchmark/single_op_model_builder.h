@@ -0,0 +1,56 @@
+/* Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_TOOLS_BENCHMARK_SINGLE_OP_MODEL_BUILDER_H_
+#define TENSORFLOW_LITE_TOOLS_BENCHMARK_SINGLE_OP_MODEL_BUILDER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace tflite {
+namespace benchmark {
+
+// Returns the names of the builtin operators BuildSingleOpModel() knows how to
+// build a model for, e.g. "CONV_2D".
+std::vector<std::string> GetSupportedSingleOps();
+
+// Parses one of "float32", "int8" or "uint8" into the corresponding tensor
+// type. Returns false if 'name' is none of them.
+bool ParseSingleOpTensorType(const std::string& name, TensorType* type);
+
+// Serializes into 'model_buffer' a model that consists of a single builtin
+// operator 'op' whose activations have the given 'type', and whose (first)
+// input has 'input_shape'. For quantized types, activations and constant
+// operands are given fixed quantization parameters that satisfy the
+// constraints of the op's kernel.
+//
+// Constant operands, e.g. filters and biases, are filled from a fixed-seed
+// pseudo-random generator so that the same arguments always produce the same
+// model. Ops with spatial semantics (pooling, convolutions, MEAN) expect a 4D
+// NHWC 'input_shape'; their operand shapes are derived from it: 2x2 pooling
+// with stride 2, 3x3 convolutions keeping the number of channels, and a
+// FULLY_CONNECTED layer whose number of units equals the input depth.
+TfLiteStatus BuildSingleOpModel(const std::string& op, TensorType type,
+                                const std::vector<int32_t>& input_shape,
+                                std::vector<char>* model_buffer);
+
+}  // namespace benchmark
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_TOOLS_BENCHMARK_SINGLE_OP_MODEL_BUILDER_H_
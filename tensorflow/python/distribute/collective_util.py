@@ -53,7 +53,8 @@ class Hints(object):
     Args:
       bytes_per_pack: A non-negative integer. Breaks collective operations into
         packs of certain size. If it's zero, the value is determined
-        automatically. This only applies to all-reduce with
+        automatically: ring all-reduces, and all-reduces on CPUs, are packed
+        into about 32MB each. This only applies to all-reduce with
         `MultiWorkerMirroredStrategy` currently.
 
     Raises:
@@ -928,11 +928,19 @@ class CollectiveCommunication(enum.Enum):
 
 
 # TODO(yuefengz): support in-graph collective all-reduce.
+# Pack size used by `CollectiveAllReduce` for ring all-reduces when no
+# `bytes_per_pack` hint is given.
+_DEFAULT_RING_BYTES_PER_PACK = 32 * 1024 * 1024
+
+
 class CollectiveAllReduce(CrossDeviceOps):
   """All-reduce cross device ops using collective ops.
 
   In the between-graph replicated training, it will still do all-reduces across
   all workers and then put results on the right destinations.
+
+  Dense all-reduces that use RING communication, or that run on CPUs only, are
+  fused into packs of about 32MB unless a `bytes_per_pack` hint says otherwise.
   """
 
   def __init__(self,
@@ -1064,8 +1072,16 @@ class CollectiveAllReduce(CrossDeviceOps):
     # queuing time due to concurrent intense computation.
     #
     # TODO(b/147393503): explore solutions for optimal ordering.
+    bytes_per_pack = experimental_hints.bytes_per_pack
+    if (bytes_per_pack == 0 and
+        communication != CollectiveCommunication.NCCL.value and
+        (self._communication == CollectiveCommunication.RING or
+         self._num_gpus_per_worker == 0)):
+      # Without a hint, ring all-reduces are still fused into packs, since
+      # nothing else merges them in eager mode.
+      bytes_per_pack = _DEFAULT_RING_BYTES_PER_PACK
     packs = cross_device_utils.pack_by_size(
-        list(reversed(per_replica_values)), experimental_hints.bytes_per_pack)
+        list(reversed(per_replica_values)), bytes_per_pack)
 
     if batch_size > 1:
       logging.info(
@@ -1080,6 +1096,18 @@ class CollectiveAllReduce(CrossDeviceOps):
 
     reduced_values = []
     for pack in packs:
+      if (bytes_per_pack > 0 and len(pack) > 1 and
+          communication != CollectiveCommunication.NCCL.value):
+        # Fuse the values of the pack into a buffer per dtype, so that each
+        # pack is sent with as few collectives as possible in both graph and
+        # eager mode.
+        with self._lock, ops.name_scope("allreduce"):
+          reduced_values.extend(
+              cross_device_utils.build_packed_collective_reduce(
+                  [per_replica.values for per_replica in pack],
+                  self._num_workers, self._collective_keys, "Add", "Id",
+                  communication, executors=self._executors))
+        continue
       # By placing all CollectiveReduce ops in a pack under single name scope,
       # we ensure they will be picked up by the `ScopedAllocator` grappler
       # optimizer and packed into a single all-reduce.
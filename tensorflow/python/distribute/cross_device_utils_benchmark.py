@@ -0,0 +1,94 @@
+# Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Local CPU benchmarks for packed collective all-reduces."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import time
+
+import numpy as np
+
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.client import session
+from tensorflow.python.distribute import cross_device_utils
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import ops
+from tensorflow.python.platform import test
+
+
+class PackedCollectiveReduceBenchmark(test.Benchmark):
+  """Benchmarks for all-reducing many small values on local CPU devices."""
+
+  def _run(self, num_values, num_elements, num_devices, packed):
+    config = config_pb2.ConfigProto(device_count={"CPU": num_devices})
+    with ops.Graph().as_default(), session.Session(config=config) as sess:
+      collective_keys = cross_device_utils.CollectiveKeys()
+      packs = []
+      for _ in range(num_values):
+        values = []
+        for device in range(num_devices):
+          with ops.device("CPU:{}".format(device)):
+            values.append(
+                constant_op.constant(np.ones(num_elements, np.float32)))
+        packs.append(values)
+      if packed:
+        outputs = cross_device_utils.build_packed_collective_reduce(
+            packs, num_workers=1, collective_keys=collective_keys)
+      else:
+        outputs = [
+            cross_device_utils.build_collective_reduce(
+                values, num_workers=1, collective_keys=collective_keys)
+            for values in packs
+        ]
+      # Use a C++ callable to minimize the Python overhead in the benchmark.
+      callable_opts = config_pb2.CallableOptions()
+      for output in outputs:
+        callable_opts.target.extend(t.name for t in output)
+      op_callable = sess._make_callable_from_options(callable_opts)  # pylint: disable=protected-access
+
+      # Run five steps to warm up the session caches and do collective param
+      # resolution before taking the first measurement.
+      for _ in range(5):
+        op_callable()
+      deltas = []
+      overall_start = time.time()
+      # Run at least five repetitions and for at least five seconds.
+      while len(deltas) < 5 or time.time() - overall_start < 5.0:
+        start = time.time()
+        for _ in range(10):
+          op_callable()
+        end = time.time()
+        deltas.append(end - start)
+      del op_callable
+
+    self.report_benchmark(
+        iters=len(deltas) * 10,
+        wall_time=np.median(deltas) / 10.0,
+        name="num_values_{}_num_elements_{}_num_devices_{}_{}".format(
+            num_values, num_elements, num_devices,
+            "packed" if packed else "unpacked"))
+
+  def benchmark_packed_collective_reduce(self):
+    """Compares one collective per value with one per pack of values."""
+    for num_values, num_elements in [(16, 1024), (256, 64), (256, 1024)]:
+      for num_devices in [2, 4]:
+        for packed in [False, True]:
+          self._run(num_values, num_elements, num_devices, packed)
+
+
+if __name__ == "__main__":
+  test.main()
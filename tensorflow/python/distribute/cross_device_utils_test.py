@@ -218,5 +218,29 @@ class PackBySizeTest(test.TestCase):
     self.assertEqual(packs[0], per_replica_values)
 
 
+class BuildPackedCollectiveReduceTest(test.TestCase):
+
+  def testSplitsFusedValuesBack(self):
+    with ops.Graph().as_default():
+      values = [
+          constant_op.constant([[1., 2.], [3., 4.]]),
+          constant_op.constant([5, 6], dtype=dtypes.int32),
+          constant_op.constant([7.]),
+          constant_op.constant([[8, 9, 10]], dtype=dtypes.int32),
+      ]
+      # With a single device and worker the collective is skipped, which
+      # leaves the packing and splitting to be checked.
+      outputs = cross_device_utils.build_packed_collective_reduce(
+          [[v] for v in values],
+          num_workers=1,
+          collective_keys=cross_device_utils.CollectiveKeys())
+      self.assertLen(outputs, len(values))
+      for value, output in zip(values, outputs):
+        self.assertLen(output, 1)
+        self.assertEqual(value.dtype, output[0].dtype)
+        self.assertEqual(value.shape, output[0].shape)
+        self.assertAllEqual(self.evaluate(value), self.evaluate(output[0]))
+
+
 if __name__ == "__main__":
   test.main()
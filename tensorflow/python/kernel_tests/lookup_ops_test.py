@@ -41,6 +41,7 @@ from tensorflow.python.framework import sparse_tensor
 from tensorflow.python.framework import test_util
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import control_flow_ops
+from tensorflow.python.ops import gen_lookup_ops
 from tensorflow.python.ops import lookup_ops
 from tensorflow.python.ops import map_fn
 from tensorflow.python.ops import string_ops
@@ -1776,6 +1777,47 @@ class DenseHashTableOpTest(test.TestCase):
       result = self.evaluate(output)
       self.assertAllEqual([-1, 51, 52, 53, -1, 54, 55, 56, -1], result)
 
+  def testManyKeys(self):
+    with self.cached_session():
+      keys = np.arange(1, 1001, dtype=np.int64)
+      table = lookup_ops.DenseHashTable(
+          dtypes.int64,
+          dtypes.int64,
+          default_value=-1,
+          empty_key=0,
+          deleted_key=-1,
+          initial_num_buckets=16)
+      self.evaluate(table.insert(keys, keys * 10))
+      self.evaluate(table.remove(keys[::3]))
+      self.assertAllEqual(666, self.evaluate(table.size()))
+
+      expected = keys * 10
+      expected[::3] = -1
+      self.assertAllEqual(expected, self.evaluate(table.lookup(keys)))
+
+  def testImportBucketsInAnyOrder(self):
+    with self.cached_session():
+      table = lookup_ops.DenseHashTable(
+          dtypes.int64,
+          dtypes.int64,
+          default_value=-1,
+          empty_key=0,
+          deleted_key=-1,
+          initial_num_buckets=8)
+      # Buckets exported by a table that placed its keys differently.
+      keys = constant_op.constant([[0], [13], [-1], [11], [0], [0], [12], [0]],
+                                  dtypes.int64)
+      values = constant_op.constant([[0], [3], [9], [1], [0], [0], [2], [0]],
+                                    dtypes.int64)
+      self.evaluate(
+          gen_lookup_ops.lookup_table_import_v2(table.resource_handle, keys,
+                                                values))
+      self.assertAllEqual(3, self.evaluate(table.size()))
+
+      output = table.lookup(
+          constant_op.constant([10, 11, 12, 13, -2], dtypes.int64))
+      self.assertAllEqual([-1, 1, 2, 3, -1], self.evaluate(output))
+
   def testCustomEmptyKey(self):
     with self.cached_session():
       keys = constant_op.constant([11, 0, 13], dtypes.int64)